@@ -0,0 +1,171 @@
+/*
+ * $Id$
+ */
+
+/*
+ * throughput of callout_schedule() and callout_stop() of gfmd
+ * by concurrent threads.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+#include "timer.h"
+
+#include "config.h"
+
+#include "subr.h"
+#include "callout.h"
+
+static char *program_name = "callout-bench";
+
+#define GETOPT_ARG	"n:p:s:?"
+#define HELPOPT		"[-n <count>] [-p <nthreads>] [-s <nshards>]"
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s " HELPOPT "\n", program_name);
+	exit(EXIT_FAILURE);
+}
+
+static void
+no_memory(void)
+{
+	fprintf(stderr, "%s: no memory\n", program_name);
+	exit(EXIT_FAILURE);
+}
+
+struct bench {
+	pthread_t thread;
+	int count;
+	double schedule_sec, reschedule_sec, stop_sec;
+};
+
+static void *
+bench_thread(void *arg)
+{
+	struct bench *b = arg;
+	struct callout **callouts;
+	gfarm_timerval_t t0, t1, t2, t3;
+	int i;
+
+	GFARM_MALLOC_ARRAY(callouts, b->count);
+	if (callouts == NULL)
+		no_memory();
+	for (i = 0; i < b->count; i++) {
+		if ((callouts[i] = callout_new()) == NULL)
+			no_memory();
+	}
+
+	/*
+	 * spread the callouts over 10 .. 2009 seconds to use all levels,
+	 * none of them fires during the benchmark.
+	 */
+	gfarm_gettimerval(&t0);
+	for (i = 0; i < b->count; i++)
+		callout_schedule(callouts[i],
+		    (10 + i % 2000) * GFARM_SECOND_BY_MICROSEC);
+	gfarm_gettimerval(&t1);
+	for (i = 0; i < b->count; i++)
+		callout_schedule(callouts[i],
+		    (10 + (i * 7 + 1) % 2000) * GFARM_SECOND_BY_MICROSEC);
+	gfarm_gettimerval(&t2);
+	for (i = 0; i < b->count; i++)
+		callout_stop(callouts[i]);
+	gfarm_gettimerval(&t3);
+
+	b->schedule_sec = gfarm_timerval_sub(&t1, &t0);
+	b->reschedule_sec = gfarm_timerval_sub(&t2, &t1);
+	b->stop_sec = gfarm_timerval_sub(&t3, &t2);
+
+	for (i = 0; i < b->count; i++)
+		callout_free(callouts[i]);
+	free(callouts);
+	return (NULL);
+}
+
+static double
+ops_per_sec(long long count, double sec)
+{
+	return (sec <= 0 ? 0.0 : count / sec);
+}
+
+int
+main(int argc, char **argv)
+{
+	gfarm_error_t e;
+	struct bench *b;
+	double sched = 0, resched = 0, stop = 0;
+	int c, i, rv, count = 1000000, nthreads = 4, nshards = 4;
+
+	/* XXX: settings in gfmd.conf doesn't work in this case */
+	char *config  = getenv("GFARM_CONFIG_FILE");
+
+	debug_mode = 1;
+	e = gfarm_server_initialize_for_gfmd(config, &argc, &argv);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: gfarm_server_initialize: %s\n",
+		    program_name, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+
+	while ((c = getopt(argc, argv, GETOPT_ARG)) != -1) {
+		switch (c) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'p':
+			nthreads = atoi(optarg);
+			break;
+		case 's':
+			nshards = atoi(optarg);
+			break;
+		case '?':
+		default:
+			usage();
+		}
+	}
+	if (nthreads <= 0 || nshards <= 0 || count < nthreads)
+		usage();
+
+	callout_module_init(1, nshards);
+
+	GFARM_MALLOC_ARRAY(b, nthreads);
+	if (b == NULL)
+		no_memory();
+	for (i = 0; i < nthreads; i++) {
+		b[i].count = count / nthreads;
+		rv = pthread_create(&b[i].thread, NULL, bench_thread, &b[i]);
+		if (rv != 0) {
+			fprintf(stderr, "%s: pthread_create: %s\n",
+			    program_name, strerror(rv));
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(b[i].thread, NULL);
+		/* threads run concurrently, the slowest one decides */
+		if (sched < b[i].schedule_sec)
+			sched = b[i].schedule_sec;
+		if (resched < b[i].reschedule_sec)
+			resched = b[i].reschedule_sec;
+		if (stop < b[i].stop_sec)
+			stop = b[i].stop_sec;
+	}
+	count = count / nthreads * nthreads;
+	printf("%d callouts by %d threads on %d shards:"
+	    " schedule %.0f/s, reschedule %.0f/s, stop %.0f/s\n",
+	    count, nthreads, nshards, ops_per_sec(count, sched),
+	    ops_per_sec(count, resched), ops_per_sec(count, stop));
+	free(b);
+	return (EXIT_SUCCESS);
+}
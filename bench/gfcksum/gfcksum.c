@@ -0,0 +1,247 @@
+/*
+ * $Id$
+ */
+
+/*
+ * throughput benchmark of the message digest calculation of local files,
+ * which is used by gfsd and gfspoolmd5.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <libgen.h>
+
+#include <openssl/evp.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#define GFARM_USE_OPENSSL
+#include "msgdigest.h"
+#include "msgdigest_engine.h"
+
+char *program_name = "gfcksum";
+
+static const char *md_type_name = "md5";
+static int nthreads = 4;
+static size_t chunksize = 65536;
+static int open_flags = O_RDONLY;
+static int drop_cache;
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [options] file ...\n", program_name);
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "\t-b size\tread size (default %ld)\n",
+	    (long)chunksize);
+	fprintf(stderr, "\t-c\tdrop page cache of the files before each run\n");
+#ifdef O_DIRECT
+	fprintf(stderr, "\t-d\tuse O_DIRECT\n");
+#endif
+	fprintf(stderr, "\t-j num\tnumber of threads for parallel "
+	    "(default %d)\n", nthreads);
+	fprintf(stderr, "\t-t type\tdigest type (default %s)\n",
+	    md_type_name);
+	exit(2);
+}
+
+static double
+timeval_sub(struct timeval *t1, struct timeval *t0)
+{
+	return ((t1->tv_sec - t0->tv_sec) +
+	    (t1->tv_usec - t0->tv_usec) * .000001);
+}
+
+static EVP_MD_CTX *
+md_alloc(void)
+{
+	EVP_MD_CTX *md_ctx;
+	int cause;
+
+	md_ctx = gfarm_msgdigest_alloc_by_name(md_type_name, &cause);
+	if (md_ctx == NULL) {
+		fprintf(stderr, "%s: digest type <%s>: %s\n", program_name,
+		    md_type_name, cause != 0 ? strerror(cause) :
+		    "not specified");
+		exit(1);
+	}
+	return (md_ctx);
+}
+
+static int
+open_file(const char *file)
+{
+	int fd;
+
+	if ((fd = open(file, open_flags)) == -1) {
+		perror(file);
+		exit(1);
+	}
+#ifdef POSIX_FADV_DONTNEED
+	if (drop_cache)
+		(void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+	return (fd);
+}
+
+static void
+report(const char *name, int nfiles, long long size,
+	struct timeval *t1, struct timeval *t0)
+{
+	double t = timeval_sub(t1, t0);
+
+	printf("%10s: %d files %lld bytes %.3f sec %.2f MB/s\n",
+	    name, nfiles, size, t, t > 0 ? size / t / 1e6 : 0.0);
+}
+
+/* the traditional way: read and hash in turn */
+static void
+bench_serial(int nfiles, char **files, char *buffer)
+{
+	EVP_MD_CTX *md_ctx;
+	char md_string[GFARM_MSGDIGEST_STRSIZE];
+	struct timeval t0, t1;
+	long long size = 0;
+	ssize_t sz;
+	int i, fd;
+
+	gettimeofday(&t0, NULL);
+	for (i = 0; i < nfiles; i++) {
+		fd = open_file(files[i]);
+		md_ctx = md_alloc();
+		while ((sz = read(fd, buffer, chunksize)) > 0) {
+			EVP_DigestUpdate(md_ctx, buffer, sz);
+			size += sz;
+		}
+		if (sz == -1)
+			perror(files[i]);
+		gfarm_msgdigest_to_string_and_free(md_ctx, md_string);
+		close(fd);
+	}
+	gettimeofday(&t1, NULL);
+	report("serial", nfiles, size, &t1, &t0);
+}
+
+/* read-ahead by a reader thread */
+static void
+bench_readahead(int nfiles, char **files, char *buffer)
+{
+	EVP_MD_CTX *md_ctx;
+	char md_string[GFARM_MSGDIGEST_STRSIZE];
+	struct timeval t0, t1;
+	long long size = 0;
+	gfarm_off_t len;
+	int i, fd, err;
+
+	gettimeofday(&t0, NULL);
+	for (i = 0; i < nfiles; i++) {
+		fd = open_file(files[i]);
+		md_ctx = md_alloc();
+		err = gfarm_msgdigest_fd(md_ctx, fd, buffer,
+		    GFARM_MSGDIGEST_ENGINE_NBUF * chunksize, &len, NULL, NULL);
+		if (err != 0)
+			fprintf(stderr, "%s: %s\n", files[i], strerror(err));
+		size += len;
+		gfarm_msgdigest_to_string_and_free(md_ctx, md_string);
+		close(fd);
+	}
+	gettimeofday(&t1, NULL);
+	report("readahead", nfiles, size, &t1, &t0);
+}
+
+/* read-ahead, and several files concurrently */
+static void
+bench_parallel(int nfiles, char **files)
+{
+	struct gfarm_msgdigest_job *jobs;
+	char md_string[GFARM_MSGDIGEST_STRSIZE];
+	struct timeval t0, t1;
+	long long size = 0;
+	int i, err;
+
+	GFARM_MALLOC_ARRAY(jobs, nfiles);
+	if (jobs == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(1);
+	}
+	gettimeofday(&t0, NULL);
+	for (i = 0; i < nfiles; i++) {
+		jobs[i].fd = open_file(files[i]);
+		jobs[i].md_ctx = md_alloc();
+	}
+	err = gfarm_msgdigest_fd_multi(nfiles, jobs, nthreads,
+	    GFARM_MSGDIGEST_ENGINE_NBUF * chunksize);
+	if (err != 0) {
+		fprintf(stderr, "%s: %s\n", program_name, strerror(err));
+		exit(1);
+	}
+	for (i = 0; i < nfiles; i++) {
+		if (jobs[i].error != 0)
+			fprintf(stderr, "%s: %s\n", files[i],
+			    strerror(jobs[i].error));
+		size += jobs[i].len;
+		gfarm_msgdigest_to_string_and_free(jobs[i].md_ctx, md_string);
+		close(jobs[i].fd);
+	}
+	gettimeofday(&t1, NULL);
+	free(jobs);
+	report("parallel", nfiles, size, &t1, &t0);
+}
+
+int
+main(int argc, char **argv)
+{
+	void *buffer;
+	int c;
+
+	if (argc > 0)
+		program_name = basename(argv[0]);
+	while ((c = getopt(argc, argv, "b:cdj:t:h?")) != -1) {
+		switch (c) {
+		case 'b':
+			chunksize = strtol(optarg, NULL, 0);
+			break;
+		case 'c':
+			drop_cache = 1;
+			break;
+#ifdef O_DIRECT
+		case 'd':
+			open_flags |= O_DIRECT;
+			break;
+#endif
+		case 'j':
+			nthreads = atoi(optarg);
+			break;
+		case 't':
+			md_type_name = optarg;
+			break;
+		case 'h':
+		case '?':
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc == 0 || chunksize == 0 || nthreads < 1)
+		usage();
+
+	/* 4096: O_DIRECT alignment */
+	if (posix_memalign(&buffer, 4096,
+	    GFARM_MSGDIGEST_ENGINE_NBUF * chunksize) != 0) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(1);
+	}
+	bench_serial(argc, argv, buffer);
+	bench_readahead(argc, argv, buffer);
+	bench_parallel(argc, argv);
+	free(buffer);
+	return (0);
+}
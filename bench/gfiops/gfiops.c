@@ -27,6 +27,8 @@ char *program_name = "gfiops";
 #define TYPE_FILE1M 5
 #define TYPE_STAT   6
 #define TYPE_UTIME  7
+#define TYPE_DIRPLUS 8
+#define TYPE_LSTATMULTI 9
 
 #define BYTE_1 1
 #define KILO_1 1024
@@ -34,6 +36,8 @@ char *program_name = "gfiops";
 
 #define MAX_LINE 1024
 
+#define LSTATMULTI_BATCH 64
+
 static void
 usage(void)
 {
@@ -51,6 +55,9 @@ usage(void)
 "        gfs_pio_open + gfs_pio_read(1MB) + gfs_pio_close\n"
 "type=6: gfs_lstat(existing entry), gfs_lstat(no entry)\n"
 "type=7: gfs_utimes(), gfs_utimes(same time [not update])\n"
+"type=8: gfs_mkdir, gfs_opendirplus + gfs_readdirplus + gfs_closedirplus,\n"
+"        gfs_rmdir\n"
+"type=9: gfs_mkdir, gfs_lstat, gfs_lstat_multi(64 entries), gfs_rmdir\n"
 );
 }
 
@@ -73,6 +80,8 @@ static struct function FUNC_UNLINK   = { .id = 9, .name = "unlink" };
 
 static struct function FUNC_LSTAT    = { .id = 10, .name = "lstat" };
 static struct function FUNC_UTIMES   = { .id = 11, .name = "utimes" };
+static struct function FUNC_OPENDIRPLUS = { .id = 12, .name = "dirplus" };
+static struct function FUNC_LSTATMULTI = { .id = 13, .name = "lstatmulti" };
 
 const static int ID_ERROR = -1;
 const static int ID_SKIP = -2;
@@ -243,6 +252,31 @@ do_opendir(char **names, int nnames)
 	send_id(&FUNC_OPENDIR);
 }
 
+static void
+do_opendirplus(char **names, int nnames)
+{
+	gfarm_error_t e;
+	int i;
+
+	/* opendirplus, readdirplus, closedirplus */
+	for (i = 0; i < nnames; i++) {
+		GFS_DirPlus dp;
+		struct gfs_dirent *de;
+		struct gfs_stat *st;
+		e = gfs_opendirplus(names[i], &dp);
+		if (e != GFARM_ERR_NO_ERROR) {
+			send_error("gfs_opendirplus(): %s: %s",
+				   names[i], gfarm_error_string(e));
+			return;
+		}
+		while ((e = gfs_readdirplus(dp, &de, &st)) ==
+		       GFARM_ERR_NO_ERROR && de != NULL)
+			;
+		gfs_closedirplus(dp);
+	}
+	send_id(&FUNC_OPENDIRPLUS);
+}
+
 static void
 do_rmdir(char **names, int nnames)
 {
@@ -396,6 +430,49 @@ do_lstat(char *dname, int ntimes, int exist)
 	send_id(&FUNC_LSTAT);
 }
 
+static void
+do_lstat_multi(char **names, int nnames, int batch)
+{
+	int i, j, n;
+	struct gfs_stat sts[LSTATMULTI_BATCH];
+	gfarm_error_t e, errs[LSTATMULTI_BATCH];
+
+	if (batch <= 1) {
+		for (i = 0; i < nnames; i++) {
+			e = gfs_lstat(names[i], &sts[0]);
+			if (e != GFARM_ERR_NO_ERROR) {
+				send_error("gfs_lstat(): %s: %s",
+					   names[i], gfarm_error_string(e));
+				return;
+			}
+			gfs_stat_free(&sts[0]);
+		}
+		send_id(&FUNC_LSTATMULTI);
+		return;
+	}
+	for (i = 0; i < nnames; i += n) {
+		n = nnames - i < batch ? nnames - i : batch;
+		e = gfs_lstat_multi(n, (const char **)&names[i], sts, errs);
+		if (e != GFARM_ERR_NO_ERROR) {
+			send_error("gfs_lstat_multi(): %s",
+				   gfarm_error_string(e));
+			return;
+		}
+		for (j = 0; j < n; j++) {
+			if (errs[j] == GFARM_ERR_NO_ERROR)
+				gfs_stat_free(&sts[j]);
+			else
+				e = errs[j];
+		}
+		if (e != GFARM_ERR_NO_ERROR) {
+			send_error("gfs_lstat_multi(): %s",
+				   gfarm_error_string(e));
+			return;
+		}
+	}
+	send_id(&FUNC_LSTATMULTI);
+}
+
 static void
 do_utimes(char *dname, int ntimes, int update)
 {
@@ -464,6 +541,8 @@ child_main(char *dname, int ntimes)
 			do_mkdir(names, ntimes);
 		else if (id == FUNC_OPENDIR.id)
 			do_opendir(names, ntimes);
+		else if (id == FUNC_OPENDIRPLUS.id)
+			do_opendirplus(names, ntimes);
 		else if (id == FUNC_RMDIR.id)
 			do_rmdir(names, ntimes);
 		else if (id == FUNC_SETINT64.id) {
@@ -490,6 +569,8 @@ child_main(char *dname, int ntimes)
 			do_lstat(dname, ntimes, (int)int64);
 		else if (id == FUNC_UTIMES.id)
 			do_utimes(dname, ntimes, (int)int64);
+		else if (id == FUNC_LSTATMULTI.id)
+			do_lstat_multi(names, ntimes, (int)int64);
 		else if (id == FUNC_TERM.id) {
 			do_terminate(dname, names, ntimes);
 			return; /* end */
@@ -836,6 +917,20 @@ main(int argc, char **argv)
 	if (!ok)
 		goto term;
 
+	if (type == TYPE_DIRPLUS || type == TYPE_ALL) {
+		start(&FUNC_MKDIR, procs, nprocs, &t);
+		ok = end(&FUNC_MKDIR, procs, nprocs, ntimes, &t);
+		if (ok) {
+			start(&FUNC_OPENDIRPLUS, procs, nprocs, &t);
+			ok = end(&FUNC_OPENDIRPLUS, procs, nprocs, ntimes,
+				 &t);
+		}
+		start(&FUNC_RMDIR, procs, nprocs, &t);
+		ok = end(&FUNC_RMDIR, procs, nprocs, ntimes, &t);
+	}
+	if (!ok)
+		goto term;
+
 	if (type == TYPE_FILE0 || type == TYPE_FILE1B || type == TYPE_FILE1K
 	    || type == TYPE_FILE1M || type == TYPE_ALL) {
 		int64_t sizes[4] = {-1, -1, -1, -1};
@@ -892,6 +987,26 @@ main(int argc, char **argv)
 		start(&FUNC_LSTAT, procs, nprocs, &t);
 		end_with_suffix(&FUNC_LSTAT, procs, nprocs, ntimes, &t, "NE");
 	}
+	if (type == TYPE_LSTATMULTI || type == TYPE_ALL) {
+		start(&FUNC_MKDIR, procs, nprocs, &t);
+		ok = end(&FUNC_MKDIR, procs, nprocs, ntimes, &t);
+		if (ok) {
+			send_setint64(procs, nprocs, 1); /* gfs_lstat */
+			start(&FUNC_LSTATMULTI, procs, nprocs, &t);
+			end_with_suffix(&FUNC_LSTATMULTI, procs, nprocs,
+					ntimes, &t, "1");
+
+			send_setint64(procs, nprocs, LSTATMULTI_BATCH);
+			start(&FUNC_LSTATMULTI, procs, nprocs, &t);
+			end_with_suffix(&FUNC_LSTATMULTI, procs, nprocs,
+					ntimes, &t, "64");
+		}
+		start(&FUNC_RMDIR, procs, nprocs, &t);
+		ok = end(&FUNC_RMDIR, procs, nprocs, ntimes, &t);
+	}
+	if (!ok)
+		goto term;
+
 	if (type == TYPE_UTIME || type == TYPE_ALL) {
 		send_setint64(procs, nprocs, 1); /* utimes with update */
 		start(&FUNC_UTIMES, procs, nprocs, &t);
@@ -0,0 +1,322 @@
+/*
+ * $Id$
+ */
+
+/*
+ * benchmark of TLS connections of gfsd:
+ * the handshake rate with and without session resumption, and
+ * the throughput of GFS_PROTO_BULKREAD-style transfers over a plain TCP
+ * connection, TLS, and TLS with kTLS sendfile.
+ * both ends run in this process over the loopback interface.
+ *
+ * the certificate and the private key of gfsd are used, thus this has
+ * to be run by the user who can read them.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <libgen.h>
+
+#include <openssl/evp.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+
+#include "context.h"
+#include "config.h"
+#include "gfp_xdr.h"
+#include "io_fd.h"
+#include "io_tls.h"
+#include "sockopt.h"
+#define GFARM_USE_OPENSSL
+#include "gfs_client.h"
+
+char *program_name = "gftlsbench";
+
+static int nconnections = 1000;
+static gfarm_off_t transfer_size = 1024 * 1024 * 1024;
+
+static int listen_sock;
+static struct sockaddr_in listen_addr;
+
+#define MODE_TLS	1
+#define MODE_KTLS	2	/* kTLS and sendfile */
+#define MODE_ZEROCOPY	4	/* sendfile(2) to a plain socket */
+
+static const struct {
+	const char *name;
+	int mode;
+} transfer_modes[] = {
+	{ "plain", 0 },
+	{ "plain+sendfile", MODE_ZEROCOPY },
+	{ "tls", MODE_TLS },
+	{ "tls+ktls", MODE_TLS | MODE_KTLS },
+};
+
+struct server_arg {
+	int count, mode, file_fd;
+	int ktls_used; /* result */
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [options]\n", program_name);
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "\t-n num\tnumber of connections for handshake "
+	    "(default %d)\n", nconnections);
+	fprintf(stderr, "\t-s size\tbytes to transfer (default %lld)\n",
+	    (long long)transfer_size);
+	exit(2);
+}
+
+static void
+check(const char *msg, gfarm_error_t e)
+{
+	if (e == GFARM_ERR_NO_ERROR)
+		return;
+	fprintf(stderr, "%s: %s: %s\n", program_name, msg,
+	    gfarm_error_string(e));
+	exit(1);
+}
+
+static double
+timeval_sub(struct timeval *t1, struct timeval *t0)
+{
+	return ((t1->tv_sec - t0->tv_sec) +
+	    (t1->tv_usec - t0->tv_usec) * .000001);
+}
+
+/* kTLS doesn't work with KeyUpdate, see "tls_ktls" in gfarm2.conf(5) */
+static void
+set_ktls(int enable)
+{
+	static int saved_key_update = -1;
+
+	if (saved_key_update == -1)
+		saved_key_update = gfarm_ctxp->tls_key_update;
+	gfarm_ctxp->tls_ktls = enable;
+	gfarm_ctxp->tls_key_update = enable ? 0 : saved_key_update;
+}
+
+static struct gfp_xdr *
+conn_open(int fd, int mode, int tls_flags)
+{
+	struct gfp_xdr *conn;
+
+	/* not to measure the delayed ACK of a NewSessionTicket message */
+	check("tcp_nodelay", gfarm_sockopt_set_option(fd, "tcp_nodelay"));
+	check("gfp_xdr_new_socket", gfp_xdr_new_socket(fd, &conn));
+	if ((mode & MODE_TLS) != 0)
+		check("gfp_xdr_tls_alloc",
+		    gfp_xdr_tls_alloc(conn, fd, tls_flags));
+	return (conn);
+}
+
+static void *
+server(void *arg)
+{
+	struct server_arg *a = arg;
+	struct gfp_xdr *conn;
+	gfarm_int32_t src_err, ack;
+	gfarm_off_t sent;
+	int i, fd, eof;
+
+	for (i = 0; i < a->count; i++) {
+		if ((fd = accept(listen_sock, NULL, NULL)) == -1) {
+			perror("accept");
+			exit(1);
+		}
+		conn = conn_open(fd, a->mode, GFP_XDR_TLS_ACCEPT);
+		if ((a->mode & MODE_KTLS) != 0)
+			a->ktls_used = gfp_xdr_tls_is_ktls_send(conn);
+		if (a->file_fd == -1) {
+			check("send", gfp_xdr_send(conn, "i", 0));
+		} else if ((a->mode & MODE_ZEROCOPY) != 0 || a->ktls_used) {
+			/* as sendfile_is_available() in gfsd */
+			check("gfs_sendfile_zerocopy", gfs_sendfile_zerocopy(
+			    conn, &src_err, a->file_fd, 0, -1, &sent));
+		} else {
+			check("gfs_sendfile_common", gfs_sendfile_common(
+			    conn, &src_err, a->file_fd, 0, -1, NULL, &sent));
+		}
+		check("flush", gfp_xdr_flush(conn));
+		check("recv", gfp_xdr_recv(conn, 0, &eof, "i", &ack));
+		gfp_xdr_free(conn);
+	}
+	return (NULL);
+}
+
+static void
+server_start(pthread_t *thread, struct server_arg *a)
+{
+	int rv = pthread_create(thread, NULL, server, a);
+
+	if (rv != 0) {
+		fprintf(stderr, "%s: pthread_create: %s\n", program_name,
+		    strerror(rv));
+		exit(1);
+	}
+}
+
+static struct gfp_xdr *
+client_connect(int mode)
+{
+	int fd = socket(PF_INET, SOCK_STREAM, 0);
+
+	if (fd == -1 || connect(fd, (struct sockaddr *)&listen_addr,
+	    sizeof(listen_addr)) == -1) {
+		perror("connect");
+		exit(1);
+	}
+	return (conn_open(fd, mode, GFP_XDR_TLS_INITIATE));
+}
+
+static void
+client_ack(struct gfp_xdr *conn)
+{
+	check("send", gfp_xdr_send(conn, "i", 0));
+	check("flush", gfp_xdr_flush(conn));
+	gfp_xdr_free(conn);
+}
+
+static void
+bench_handshake(const char *name, int resumption)
+{
+	struct server_arg a = { nconnections, MODE_TLS, -1 };
+	struct gfp_xdr *conn;
+	struct timeval t0, t1;
+	pthread_t thread;
+	gfarm_int32_t dummy;
+	int i, eof, nreused = 0;
+	double t;
+
+	gfarm_ctxp->tls_session_resumption = resumption;
+	server_start(&thread, &a);
+	gettimeofday(&t0, NULL);
+	for (i = 0; i < nconnections; i++) {
+		conn = client_connect(MODE_TLS);
+		if (gfp_xdr_tls_session_reused(conn))
+			nreused++;
+		/* a session ticket is received here */
+		check("recv", gfp_xdr_recv(conn, 0, &eof, "i", &dummy));
+		client_ack(conn);
+	}
+	gettimeofday(&t1, NULL);
+	pthread_join(thread, NULL);
+	t = timeval_sub(&t1, &t0);
+	printf("handshake %-14s %8.1f connections/s (%d/%d resumed)\n",
+	    name, nconnections / t, nreused, nconnections);
+}
+
+static void
+bench_transfer(const char *name, int mode, int file_fd, int null_fd)
+{
+	struct server_arg a = { 1, mode, file_fd };
+	struct gfp_xdr *conn;
+	struct timeval t0, t1;
+	pthread_t thread;
+	gfarm_int32_t dst_err;
+	gfarm_off_t received;
+	double t;
+
+	set_ktls((mode & MODE_KTLS) != 0);
+	server_start(&thread, &a);
+	conn = client_connect(mode);
+	gettimeofday(&t0, NULL);
+	check("gfs_recvfile_common", gfs_recvfile_common(conn, &dst_err,
+	    null_fd, 0, 0, NULL, NULL, &received));
+	gettimeofday(&t1, NULL);
+	client_ack(conn);
+	pthread_join(thread, NULL);
+	set_ktls(0);
+	t = timeval_sub(&t1, &t0);
+	printf("transfer  %-14s %8.1f MiB/s%s\n", name,
+	    received / t / 1024 / 1024,
+	    (mode & MODE_KTLS) == 0 ? "" :
+	    a.ktls_used ? " (kTLS)" : " (kTLS unavailable)");
+}
+
+int
+main(int argc, char **argv)
+{
+	gfarm_error_t e;
+	socklen_t addrlen = sizeof(listen_addr);
+	char tmpfile[] = "/tmp/gftlsbench.XXXXXX";
+	int c, i, file_fd, null_fd;
+
+	if (argc > 0)
+		program_name = basename(argv[0]);
+	/* the configuration of gfsd is used, unless $GFARM_CONFIG_FILE */
+	e = gfarm_server_initialize_for_gfsd(getenv("GFARM_CONFIG_FILE"),
+	    &argc, &argv);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: gfarm_server_initialize: %s\n",
+		    program_name, gfarm_error_string(e));
+		exit(1);
+	}
+	while ((c = getopt(argc, argv, "n:s:")) != -1) {
+		switch (c) {
+		case 'n':
+			nconnections = atoi(optarg);
+			break;
+		case 's':
+			transfer_size = strtoll(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (nconnections <= 0 || transfer_size <= 0)
+		usage();
+	signal(SIGPIPE, SIG_IGN);
+
+	listen_sock = socket(PF_INET, SOCK_STREAM, 0);
+	memset(&listen_addr, 0, sizeof(listen_addr));
+	listen_addr.sin_family = AF_INET;
+	listen_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	listen_addr.sin_port = 0;
+	if (listen_sock == -1 ||
+	    bind(listen_sock, (struct sockaddr *)&listen_addr,
+	    sizeof(listen_addr)) == -1 ||
+	    listen(listen_sock, 128) == -1 ||
+	    getsockname(listen_sock, (struct sockaddr *)&listen_addr,
+	    &addrlen) == -1) {
+		perror("listen");
+		exit(1);
+	}
+
+	/* a sparse file, to measure the network side only */
+	if ((file_fd = mkstemp(tmpfile)) == -1 ||
+	    ftruncate(file_fd, transfer_size) == -1) {
+		perror(tmpfile);
+		exit(1);
+	}
+	unlink(tmpfile);
+	if ((null_fd = open("/dev/null", O_WRONLY)) == -1) {
+		perror("/dev/null");
+		exit(1);
+	}
+
+	bench_handshake("full", 0);
+	bench_handshake("resumed", 1);
+	for (i = 0; i < GFARM_ARRAY_LENGTH(transfer_modes); i++)
+		bench_transfer(transfer_modes[i].name, transfer_modes[i].mode,
+		    file_fd, null_fd);
+
+	close(file_fd);
+	close(null_fd);
+	return (0);
+}
@@ -0,0 +1,134 @@
+/*
+ * $Id$
+ */
+
+/*
+ * compares the chained gfarm_hash table with the resizable
+ * open addressing one.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "hash.h"
+#include "timer.h"
+
+static const char *program_name = "hash-bench";
+
+/* typical size of chained tables in gfarm */
+#define CHAINED_SIZE	1009
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-n <nentries>]\n", program_name);
+	exit(2);
+}
+
+static void
+no_memory(void)
+{
+	fprintf(stderr, "%s: no memory\n", program_name);
+	exit(1);
+}
+
+static void
+bench(const char *name, struct gfarm_hash_table *tab, int n, char **keys)
+{
+	gfarm_timerval_t t0, t1, t2, t3, t4;
+	int i, created, len, nerrors = 0;
+	char buf[64];
+
+	if (tab == NULL)
+		no_memory();
+	gfarm_gettimerval(&t0);
+	for (i = 0; i < n; i++) {
+		if (gfarm_hash_enter(tab, keys[i], strlen(keys[i]),
+		    sizeof(int), &created) == NULL)
+			no_memory();
+		if (!created)
+			nerrors++;
+	}
+	gfarm_gettimerval(&t1);
+	for (i = 0; i < n; i++) {
+		if (gfarm_hash_lookup(tab, keys[i], strlen(keys[i])) == NULL)
+			nerrors++;
+	}
+	gfarm_gettimerval(&t2);
+	for (i = 0; i < n; i++) {
+		len = snprintf(buf, sizeof(buf), "%s.miss", keys[i]);
+		if (gfarm_hash_lookup(tab, buf, len) != NULL)
+			nerrors++;
+	}
+	gfarm_gettimerval(&t3);
+	for (i = 0; i < n; i++) {
+		if (!gfarm_hash_purge(tab, keys[i], strlen(keys[i])))
+			nerrors++;
+	}
+	gfarm_gettimerval(&t4);
+	gfarm_hash_table_free(tab);
+
+	if (nerrors > 0) {
+		/* see regress/lib/libgfarm/gfutil/hash for the details */
+		fprintf(stderr, "%s: %s: %d unexpected results\n",
+		    program_name, name, nerrors);
+		exit(1);
+	}
+	printf("%-28s enter %7.1f  lookup %7.1f  miss %7.1f  purge %7.1f"
+	    " ns/op\n", name,
+	    gfarm_timerval_sub(&t1, &t0) * 1e9 / n,
+	    gfarm_timerval_sub(&t2, &t1) * 1e9 / n,
+	    gfarm_timerval_sub(&t3, &t2) * 1e9 / n,
+	    gfarm_timerval_sub(&t4, &t3) * 1e9 / n);
+}
+
+int
+main(int argc, char **argv)
+{
+	char **keys, buf[64];
+	int c, i, n = 100000;
+
+	if (argc > 0)
+		program_name = argv[0];
+	while ((c = getopt(argc, argv, "n:")) != -1) {
+		switch (c) {
+		case 'n':
+			n = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (n <= 0)
+		usage();
+
+	if ((keys = malloc(sizeof(*keys) * n)) == NULL)
+		no_memory();
+	for (i = 0; i < n; i++) {
+		snprintf(buf, sizeof(buf), "/home/user%d/dir%d/file%d",
+		    i % 97, i % 1013, i);
+		if ((keys[i] = strdup(buf)) == NULL)
+			no_memory();
+	}
+
+	printf("%d entries\n", n);
+	bench("chained, default hash", gfarm_hash_table_alloc(
+	    CHAINED_SIZE, gfarm_hash_default, gfarm_hash_key_equal_default),
+	    n, keys);
+	bench("resizable, default hash", gfarm_hash_table_alloc_resizable(
+	    0, gfarm_hash_default, gfarm_hash_key_equal_default), n, keys);
+	bench("chained, fast hash", gfarm_hash_table_alloc(
+	    CHAINED_SIZE, gfarm_hash_fast, gfarm_hash_key_equal_default),
+	    n, keys);
+	bench("resizable, fast hash", gfarm_hash_table_alloc_resizable(
+	    0, gfarm_hash_fast, gfarm_hash_key_equal_default), n, keys);
+
+	for (i = 0; i < n; i++)
+		free(keys[i]);
+	free(keys);
+	return (0);
+}
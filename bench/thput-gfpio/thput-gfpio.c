@@ -9,6 +9,7 @@
 #include <gfarm/gfarm.h>
 
 int node_index = -1;
+int read_window = 0; /* report client_file_read_window, if non-zero */
 
 #ifdef i386
 
@@ -395,10 +396,18 @@ test(enum testmode test_mode, char *file1, char *file2,
 	}
 	gettimeofday(&t2, NULL);
 
-	printf("[%03d] %" GFARM_PRId64 " %7d %-5s %10.0f %s\n",
-	       node_index, (gfarm_off_t)file_size,
-	       buffer_size, label,
-	       file_size / timeval_sub(&t2, &t1), gfarm_host_get_self_name());
+	if (read_window > 0)
+		printf("[%03d] %" GFARM_PRId64 " %7d %-5s %10.0f %s window %d\n",
+		       node_index, (gfarm_off_t)file_size,
+		       buffer_size, label,
+		       file_size / timeval_sub(&t2, &t1),
+		       gfarm_host_get_self_name(), read_window);
+	else
+		printf("[%03d] %" GFARM_PRId64 " %7d %-5s %10.0f %s\n",
+		       node_index, (gfarm_off_t)file_size,
+		       buffer_size, label,
+		       file_size / timeval_sub(&t2, &t1),
+		       gfarm_host_get_self_name());
 	fflush(stdout);
 
 	if ((flags & FLAG_MEASURE_PRIMITIVES) != 0) {
@@ -436,7 +445,7 @@ main(int argc, char **argv)
 	int c, buffer_size = 1024 * 1024;
 	off_t file_size = -1;
 	enum testmode test_mode = TESTMODE_WRITE;
-	int flags = 0;
+	int flags = 0, max_window = 0;
 	gfarm_error_t e;
 
 	if (argc > 0)
@@ -449,7 +458,7 @@ main(int argc, char **argv)
 		exit(1);
 	}
 
-	while ((c = getopt(argc, argv, "b:s:wrcm")) != -1) {
+	while ((c = getopt(argc, argv, "b:s:wrcmW:")) != -1) {
 		switch (c) {
 		case 'b':
 			buffer_size = strtol(optarg, NULL, 0);
@@ -474,6 +483,15 @@ main(int argc, char **argv)
 		case 'm':
 			flags |= FLAG_MEASURE_PRIMITIVES;
 			break;
+		case 'W':
+			max_window = strtol(optarg, NULL, 0);
+			if (max_window <= 0) {
+				fprintf(stderr, "%s: \"-W %d\" is invalid\n",
+					program_name, max_window);
+				exit(1);
+			}
+			test_mode = TESTMODE_READ;
+			break;
 		case '?':
 		default:
 			fprintf(stderr,
@@ -484,7 +502,10 @@ main(int argc, char **argv)
 				"\t-s file-size\n"
 				"\t-w			: write test\n"
 				"\t-r			: read test\n"
-				"\t-c			: copy test\n",
+				"\t-c			: copy test\n"
+				"\t-W max-window	: read test with "
+				"client_file_read_window 1, 2, 4, ..., "
+				"max-window\n",
 				program_name);
 			exit(1);
 		}
@@ -516,7 +537,15 @@ main(int argc, char **argv)
 	file_size *= 1024 * 1024;
 	initbuffer();
 
-	test(test_mode, file1, file2, buffer_size, file_size, flags);
+	if (max_window > 0) {
+		for (read_window = 1; read_window <= max_window;
+		    read_window *= 2) {
+			gfarm_set_client_file_read_window(read_window);
+			test(test_mode, file1, file2, buffer_size, file_size,
+			    flags);
+		}
+	} else
+		test(test_mode, file1, file2, buffer_size, file_size, flags);
 
 	e = gfarm_terminate();
 	if (e != GFARM_ERR_NO_ERROR) {
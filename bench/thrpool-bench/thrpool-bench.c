@@ -0,0 +1,167 @@
+/*
+ * $Id$
+ */
+
+/*
+ * throughput of the thread pools of gfmd,
+ * producers add empty jobs as fast as possible.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+#include "timer.h"
+
+#include "config.h"
+
+#include "subr.h"
+#include "thrpool.h"
+
+static char *program_name = "thrpool-bench";
+
+#define GETOPT_ARG	"n:p:q:?"
+#define HELPOPT		"[-n <count>] [-p <nthreads>] [-q <nproducers>]"
+
+/* the default of metadb_server_job_queue_length */
+#define BENCH_QUEUE_LENGTH	16000
+
+static const struct {
+	const char *name;
+	int type;
+} types[] = {
+	{ "mutex", GFARM_THREAD_POOL_TYPE_MUTEX },
+	{ "work_stealing", GFARM_THREAD_POOL_TYPE_WORK_STEALING },
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s " HELPOPT "\n", program_name);
+	exit(EXIT_FAILURE);
+}
+
+static void
+no_memory(void)
+{
+	fprintf(stderr, "%s: no memory\n", program_name);
+	exit(EXIT_FAILURE);
+}
+
+static int done;
+
+static void *
+count_job(void *arg)
+{
+	__atomic_add_fetch(&done, 1, __ATOMIC_SEQ_CST);
+	return (NULL);
+}
+
+struct bench {
+	pthread_t thread;
+	struct thread_pool *pool;
+	int count;
+};
+
+static void *
+bench_thread(void *arg)
+{
+	struct bench *b = arg;
+	int i;
+
+	for (i = 0; i < b->count; i++)
+		thrpool_add_job(b->pool, count_job, NULL);
+	return (NULL);
+}
+
+static void
+bench_type(const char *name, int type, int count, int nthreads,
+	int nproducers)
+{
+	struct thread_pool *pool;
+	struct bench *b;
+	gfarm_timerval_t t0, t1;
+	double sec;
+	int i, rv;
+
+	pool = thrpool_new_by_type(type, nthreads, BENCH_QUEUE_LENGTH, name);
+	if (pool == NULL)
+		no_memory();
+	GFARM_MALLOC_ARRAY(b, nproducers);
+	if (b == NULL)
+		no_memory();
+
+	done = 0;
+	count = count / nproducers * nproducers;
+	gfarm_gettimerval(&t0);
+	for (i = 0; i < nproducers; i++) {
+		b[i].pool = pool;
+		b[i].count = count / nproducers;
+		rv = pthread_create(&b[i].thread, NULL, bench_thread, &b[i]);
+		if (rv != 0) {
+			fprintf(stderr, "%s: pthread_create: %s\n",
+			    program_name, strerror(rv));
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < nproducers; i++)
+		pthread_join(b[i].thread, NULL);
+	while (__atomic_load_n(&done, __ATOMIC_SEQ_CST) < count)
+		gfarm_nanosleep(GFARM_MILLISEC_BY_NANOSEC);
+	gfarm_gettimerval(&t1);
+	sec = gfarm_timerval_sub(&t1, &t0);
+
+	printf("%s: %d jobs by %d producers and %d workers: %.0f jobs/s\n",
+	    name, count, nproducers, nthreads, sec <= 0 ? 0.0 : count / sec);
+	free(b);
+	/* the pool cannot be freed, its workers are left idle */
+}
+
+int
+main(int argc, char **argv)
+{
+	gfarm_error_t e;
+	int c, i, count = 1000000, nthreads = 1, nproducers = 1;
+
+	/* XXX: settings in gfmd.conf doesn't work in this case */
+	char *config  = getenv("GFARM_CONFIG_FILE");
+
+	debug_mode = 1;
+	e = gfarm_server_initialize_for_gfmd(config, &argc, &argv);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: gfarm_server_initialize: %s\n",
+		    program_name, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+
+	while ((c = getopt(argc, argv, GETOPT_ARG)) != -1) {
+		switch (c) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'p':
+			nthreads = atoi(optarg);
+			break;
+		case 'q':
+			nproducers = atoi(optarg);
+			break;
+		case '?':
+		default:
+			usage();
+		}
+	}
+	if (nthreads <= 0 || nproducers <= 0 || count < nproducers)
+		usage();
+
+	for (i = 0; i < GFARM_ARRAY_LENGTH(types); i++)
+		bench_type(types[i].name, types[i].type,
+		    count, nthreads, nproducers);
+	return (EXIT_SUCCESS);
+}
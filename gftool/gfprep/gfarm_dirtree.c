@@ -155,6 +155,17 @@ dirtree_is_excluded(int n_excluded_regexs, regex_t *excluded_regexs,
 	return (0);
 }
 
+/*
+ * number of entries of a DIRTREE_CMD_GET_FINFO request,
+ * to reduce round trips between the parent and children.
+ */
+#define DIRTREE_FINFO_BATCH	64
+
+struct dirtree_finfo_batch {
+	int n_ents;
+	gfarm_dirtree_entry_t *ents[DIRTREE_FINFO_BATCH];
+};
+
 enum dirtree_cmd {
 	DIRTREE_CMD_GET_DENTS,
 	DIRTREE_CMD_GET_FINFO,
@@ -382,18 +393,312 @@ dirtree_gfarm_lstat(const char *path, struct my_stat *stp)
 	return (GFARM_ERR_NO_ERROR);
 }
 
+/* information of an entry, prefetched for a DIRTREE_CMD_GET_FINFO request */
+struct dirtree_replicas {
+	const char *path; /* NULL if not required */
+	gfarm_error_t e;
+	int ncopy;
+	char **copy;
+};
+
+struct dirtree_finfo {
+	char *src_path, *dst_path;
+	struct dirtree_replicas src, dst;
+	gfarm_error_t dst_e;
+	struct my_stat dst_st;
+};
+
+/*
+ * gfs_replica_list_by_name() per parent directory instead of per entry,
+ * since entries of a same directory are consecutive in a batch.
+ */
+static void
+dirtree_replica_list_multi(int n, struct dirtree_replicas **reps)
+{
+	const char *names[DIRTREE_FINFO_BATCH];
+	int idx[DIRTREE_FINFO_BATCH], ns[DIRTREE_FINFO_BATCH];
+	char **copies[DIRTREE_FINFO_BATCH];
+	gfarm_error_t errs[DIRTREE_FINFO_BATCH];
+	const char *path, *base;
+	char *dir;
+	size_t dirlen;
+	int i, j, k;
+
+	for (i = 0; i < n; i = j) {
+		j = i + 1;
+		if ((path = reps[i]->path) == NULL)
+			continue;
+		dir = NULL;
+		if ((base = strrchr(path, '/')) != NULL) {
+			dirlen = base - path;
+			GFARM_MALLOC_ARRAY(dir, dirlen + 1);
+		}
+		if (dir == NULL) {
+			reps[i]->e = gfs_replica_list_by_name(path,
+			    &reps[i]->ncopy, &reps[i]->copy);
+			continue;
+		}
+		memcpy(dir, path, dirlen);
+		dir[dirlen] = '\0';
+		idx[0] = i;
+		names[0] = base + 1;
+		k = 1;
+		for (; j < n; j++) {
+			if ((path = reps[j]->path) == NULL)
+				continue;
+			if (strncmp(path, dir, dirlen) != 0 ||
+			    path[dirlen] != '/' ||
+			    strchr(path + dirlen + 1, '/') != NULL)
+				break;
+			idx[k] = j;
+			names[k++] = path + dirlen + 1;
+		}
+		(void)gfs_replica_list_by_name_multi(dir, k, names,
+		    ns, copies, errs);
+		while (--k >= 0) {
+			reps[idx[k]]->e = errs[k];
+			reps[idx[k]]->ncopy = ns[k];
+			reps[idx[k]]->copy = copies[k];
+		}
+		free(dir);
+	}
+}
+
+/* lstat of the destination entries, by a request for gfarm */
+static void
+dirtree_dst_lstat_multi(gfarm_dirtree_t *handle, int n,
+	struct dirtree_finfo *fi,
+	gfarm_error_t (*func_lstat)(const char *, struct my_stat *))
+{
+	const char *paths[DIRTREE_FINFO_BATCH];
+	int idx[DIRTREE_FINFO_BATCH];
+	struct gfs_stat sts[DIRTREE_FINFO_BATCH];
+	gfarm_error_t errs[DIRTREE_FINFO_BATCH];
+	int i, k = 0;
+
+	for (i = 0; i < n; i++) {
+		if (fi[i].dst_path == NULL)
+			continue;
+		if (handle->dst_type != URL_TYPE_GFARM) {
+			fi[i].dst_e = func_lstat(fi[i].dst_path,
+			    &fi[i].dst_st);
+			continue;
+		}
+		idx[k] = i;
+		paths[k++] = fi[i].dst_path;
+	}
+	if (k == 0)
+		return;
+	(void)gfs_lstat_multi(k, paths, sts, errs);
+	for (i = 0; i < k; i++) {
+		fi[idx[i]].dst_e = errs[i];
+		if (errs[i] != GFARM_ERR_NO_ERROR) {
+			/* see dirtree_gfarm_lstat() */
+			if (errs[i] != GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY)
+				fprintf(stderr, "ERROR: gfs_lstat(%s): %s\n",
+				    paths[i], gfarm_error_string(errs[i]));
+			continue;
+		}
+		dirtree_convert_gfs_stat(&sts[i], &fi[idx[i]].dst_st);
+		gfs_stat_free(&sts[i]);
+	}
+}
+
+/* send information of a source entry and the destination to the parent */
+static void
+dirtree_child_finfo(gfarm_dirtree_t *handle, int is_file,
+	struct dirtree_finfo *fi,
+	gfarm_error_t (*func_lstat)(const char *, struct my_stat *),
+	FILE *to_parent)
+{
+	gfarm_error_t e;
+	char *src_path = fi->src_path, *dst_path = fi->dst_path;
+	int ncopy, i;
+	char **copy;
+
+	if (src_path == NULL ||
+	    (handle->dst_type != URL_TYPE_UNUSED && dst_path == NULL)) {
+		gfpara_send_int(to_parent, 0); /* 1: src_ncopy */
+		gfpara_send_int(to_parent, 0); /* 3: dst_exist */
+		return;
+	}
+
+	/* ----- src ----- */
+	if (handle->src_type == URL_TYPE_LOCAL || is_file == 0) {
+		/* 1: src_ncopy */
+		gfpara_send_int(to_parent, 0);
+		goto finfo_dst;
+	}
+	assert(handle->src_type == URL_TYPE_GFARM);
+	e = fi->src.e;
+	ncopy = fi->src.ncopy;
+	copy = fi->src.copy;
+	if (e != GFARM_ERR_NO_ERROR && gfm_client_is_connection_error(e)) {
+		e = gfs_replica_list_by_name(src_path, &ncopy, &copy);
+		if (e == GFARM_ERR_NO_ERROR)
+			fprintf(stderr,
+			    "INFO: retry gfs_replica_list_by_name(%s) OK\n",
+			    src_path);
+	}
+	if (e != GFARM_ERR_NO_ERROR) {
+		/* 1: src_ncopy */
+		gfpara_send_int(to_parent, 0);
+		fprintf(stderr,
+			"ERROR: gfs_replica_list_by_name(%s): %s\n",
+			src_path, gfarm_error_string(e));
+		goto finfo_dst;
+	}
+	/* 1: src_ncopy */
+	gfpara_send_int(to_parent, ncopy);
+	for (i = 0; i < ncopy; i++) /* 2: src_copy */
+		gfpara_send_string(to_parent, "%s", copy[i]);
+	gfarm_strings_free_deeply(ncopy, copy);
+finfo_dst:	/* ----- dst ----- */
+	if (handle->dst_type == URL_TYPE_UNUSED) {
+		/* dst is unused */
+		gfpara_send_int(to_parent, 0); /* 3: dst_exist */
+		return;
+	}
+	assert(dst_path);
+	e = fi->dst_e;
+	if (e != GFARM_ERR_NO_ERROR && gfm_client_is_connection_error(e)) {
+		e = func_lstat(dst_path, &fi->dst_st);
+		if (e == GFARM_ERR_NO_ERROR)
+			fprintf(stderr, "INFO: retry lstat(%s) OK\n",
+			    dst_path);
+	}
+	if (e != GFARM_ERR_NO_ERROR) {
+		/* dst does not exist */
+		gfpara_send_int(to_parent, 0); /* 3: dst_exist */
+		return;
+	}
+
+	/* 3: dst_exist */
+	gfpara_send_int(to_parent, 1);
+	/* 4: dst_m_sec */
+	gfpara_send_int64(to_parent, fi->dst_st.mtime_sec);
+	/* 5: dst_m_nsec */
+	gfpara_send_int(to_parent, fi->dst_st.mtime_nsec);
+	if (S_ISREG(fi->dst_st.mode)) {
+		/* 6: dst_d_type */
+		gfpara_send_int(to_parent, GFS_DT_REG);
+		/* 7: dst_size */
+		gfpara_send_int64(to_parent, fi->dst_st.size);
+		if (handle->dst_type == URL_TYPE_GFARM) {
+			if (fi->dst.path == NULL) /* not prefetched */
+				fi->dst.e = gfs_replica_list_by_name(dst_path,
+				    &fi->dst.ncopy, &fi->dst.copy);
+			e = fi->dst.e;
+			ncopy = fi->dst.ncopy;
+			copy = fi->dst.copy;
+			if (e != GFARM_ERR_NO_ERROR &&
+			    gfm_client_is_connection_error(e)) {
+				e = gfs_replica_list_by_name(dst_path,
+				    &ncopy, &copy);
+				if (e == GFARM_ERR_NO_ERROR)
+					fprintf(stderr, "INFO: retry "
+					    "gfs_replica_list_by_name(%s) "
+					    "OK\n", dst_path);
+			}
+			if (e == GFARM_ERR_NO_ERROR) {
+				/* 8: dst_ncopy */
+				gfpara_send_int(to_parent, ncopy);
+				for (i = 0; i < ncopy; i++)
+					/* 9: dst_copy */
+					gfpara_send_string(
+					    to_parent, "%s", copy[i]);
+				gfarm_strings_free_deeply(ncopy, copy);
+			} else { /* no replica: ncopy == 0 */
+				fprintf(stderr,
+				    "INFO: gfs_replica_list_by_name(%s):"
+				    " %s\n", dst_path,
+				    gfarm_error_string(e));
+				/* 8: dst_ncopy */
+				gfpara_send_int(to_parent, 0);
+			}
+		} else /* URL_TYPE_LOCAL: ncopy == 0 */
+			/* 8: dst_ncopy */
+			gfpara_send_int(to_parent, 0);
+	} else if (S_ISDIR(fi->dst_st.mode)) /* 6: dst_d_type */
+		gfpara_send_int(to_parent, GFS_DT_DIR);
+	else if (S_ISLNK(fi->dst_st.mode)) /* 6: dst_d_type */
+		gfpara_send_int(to_parent, GFS_DT_LNK);
+	else /* 6: dst_d_type */
+		gfpara_send_int(to_parent, GFS_DT_UNKNOWN);
+}
+
+/*
+ * send information of entries of a DIRTREE_CMD_GET_FINFO request.
+ * replicas and the destination are looked up for all entries at first,
+ * to make gfmd process them by fewer round trips.
+ */
+static void
+dirtree_child_finfo_batch(gfarm_dirtree_t *handle, int n_ents,
+	char **subpaths, int *is_files,
+	gfarm_error_t (*func_lstat)(const char *, struct my_stat *),
+	FILE *to_parent)
+{
+	struct dirtree_finfo fi[DIRTREE_FINFO_BATCH];
+	struct dirtree_replicas *reps[DIRTREE_FINFO_BATCH];
+	int i;
+
+	for (i = 0; i < n_ents; i++) {
+		fi[i].src_path = gfurl_path_combine(
+		    gfurl_epath(handle->src_dir), subpaths[i]);
+		fi[i].dst_path = NULL;
+		if (handle->dst_type != URL_TYPE_UNUSED) {
+			assert(handle->dst_dir);
+			fi[i].dst_path = gfurl_path_combine(
+			    gfurl_epath(handle->dst_dir), subpaths[i]);
+		}
+		if (fi[i].src_path == NULL ||
+		    (handle->dst_type != URL_TYPE_UNUSED &&
+		     fi[i].dst_path == NULL)) {
+			fprintf(stderr, "ERROR: no memory: %s\n",
+			    subpaths[i]);
+			free(fi[i].src_path);
+			free(fi[i].dst_path);
+			fi[i].src_path = fi[i].dst_path = NULL;
+		}
+		fi[i].src.path = handle->src_type == URL_TYPE_GFARM &&
+		    is_files[i] ? fi[i].src_path : NULL;
+		fi[i].dst.path = NULL;
+		reps[i] = &fi[i].src;
+	}
+	if (handle->src_type == URL_TYPE_GFARM)
+		dirtree_replica_list_multi(n_ents, reps);
+	if (handle->dst_type != URL_TYPE_UNUSED) {
+		dirtree_dst_lstat_multi(handle, n_ents, fi, func_lstat);
+		for (i = 0; i < n_ents; i++) {
+			if (handle->dst_type == URL_TYPE_GFARM &&
+			    fi[i].dst_path != NULL &&
+			    fi[i].dst_e == GFARM_ERR_NO_ERROR &&
+			    S_ISREG(fi[i].dst_st.mode))
+				fi[i].dst.path = fi[i].dst_path;
+			reps[i] = &fi[i].dst;
+		}
+		if (handle->dst_type == URL_TYPE_GFARM)
+			dirtree_replica_list_multi(n_ents, reps);
+	}
+	for (i = 0; i < n_ents; i++) {
+		dirtree_child_finfo(handle, is_files[i], &fi[i], func_lstat,
+		    to_parent);
+		free(fi[i].src_path);
+		free(fi[i].dst_path);
+	}
+}
+
 static int
 dirtree_child(void *param, FILE *from_parent, FILE *to_parent)
 {
-	int command, is_file;
+	int command, n_ents, *is_files;
 	gfarm_error_t e;
-	char *subpath, *src_dir, *src_path, *dst_path;
+	char *subpath, *src_dir, **subpaths;
 	char *name;
 	struct dirtree_dir_handle dh;
 	struct gfs_dirent dent;
-	struct my_stat src_st, dst_st;
-	int ncopy, i, retv, is_retry;
-	char **copy;
+	struct my_stat src_st;
+	int i, retv, is_retry;
 	FILE *tmpfp;
 	char buf[64];
 	gfarm_dirtree_t *handle = param;
@@ -560,151 +865,44 @@ dents_error:
 		goto dents_loop; /* loop */
 	/* ------------------------------------------------------------ */
 	case DIRTREE_CMD_GET_FINFO:
-		dst_path = NULL;
-		subpath = NULL;
-		gfpara_recv_string(from_parent, &subpath);
-		gfpara_recv_int(from_parent, &is_file);
-		if (subpath[0] == '\0') {
+		gfpara_recv_int(from_parent, &n_ents);
+		if (n_ents <= 0 || n_ents > DIRTREE_FINFO_BATCH) {
 			fprintf(stderr, "FATAL: unexpected message\n");
 			gfpara_send_int(to_parent, DIRTREE_STAT_NG);
 			goto term;
 		}
-		src_path = gfurl_path_combine(gfurl_epath(handle->src_dir),
-		    subpath);
-		if (src_path == NULL) {
+		GFARM_MALLOC_ARRAY(subpaths, n_ents);
+		GFARM_MALLOC_ARRAY(is_files, n_ents);
+		if (subpaths == NULL || is_files == NULL) {
 			fprintf(stderr, "FATAL: no memory\n");
 			gfpara_send_int(to_parent, DIRTREE_STAT_NG);
-			free(subpath);
+			free(subpaths);
+			free(is_files);
 			goto term;
 		}
-		if (handle->dst_type != URL_TYPE_UNUSED) {
-			assert(handle->dst_dir);
-			dst_path = gfurl_path_combine(
-			    gfurl_epath(handle->dst_dir), subpath);
-			if (dst_path == NULL) {
-				fprintf(stderr, "FATAL: no memory\n");
+		for (i = 0; i < n_ents; i++) {
+			subpaths[i] = NULL;
+			gfpara_recv_string(from_parent, &subpaths[i]);
+			gfpara_recv_int(from_parent, &is_files[i]);
+		}
+		for (i = 0; i < n_ents; i++) {
+			if (subpaths[i] == NULL || subpaths[i][0] == '\0') {
+				fprintf(stderr, "FATAL: unexpected message\n");
 				gfpara_send_int(to_parent, DIRTREE_STAT_NG);
-				free(subpath);
-				free(src_path);
+				for (i = 0; i < n_ents; i++)
+					free(subpaths[i]);
+				free(subpaths);
+				free(is_files);
 				goto term;
 			}
 		}
-
 		gfpara_send_int(to_parent, DIRTREE_STAT_GET_FINFO_OK);
-		/* ----- src ----- */
-		if (handle->src_type == URL_TYPE_LOCAL || is_file == 0) {
-			/* 1: src_ncopy */
-			gfpara_send_int(to_parent, 0);
-			goto finfo_dst;
-		}
-		assert(handle->src_type == URL_TYPE_GFARM);
-		is_retry = 0;
-finfo_retry1:
-		e = gfs_replica_list_by_name(src_path, &ncopy, &copy);
-		if (e != GFARM_ERR_NO_ERROR) {
-			if (!is_retry && gfm_client_is_connection_error(e)) {
-				is_retry = 1;
-				goto finfo_retry1;
-			}
-			/* 1: src_ncopy */
-			gfpara_send_int(to_parent, 0);
-			fprintf(stderr,
-				"ERROR: gfs_replica_list_by_name(%s): %s\n",
-				src_path, gfarm_error_string(e));
-			goto finfo_dst;
-		}
-		if (is_retry)
-			fprintf(stderr,
-			    "INFO: retry gfs_replica_list_by_name(%s) OK\n",
-			    src_path);
-		/* 1: src_ncopy */
-		gfpara_send_int(to_parent, ncopy);
-		for (i = 0; i < ncopy; i++) /* 2: src_copy */
-			gfpara_send_string(to_parent, "%s", copy[i]);
-		gfarm_strings_free_deeply(ncopy, copy);
-finfo_dst:	/* ----- dst ----- */
-		if (handle->dst_type == URL_TYPE_UNUSED) {
-			/* dst is unused */
-			gfpara_send_int(to_parent, 0); /* 3: dst_exist */
-			free(subpath);
-			free(src_path);
-			goto next_command;
-		}
-		assert(dst_path);
-		is_retry = 0;
-finfo_retry2:
-		e = func_lstat(dst_path, &dst_st);
-		if (e != GFARM_ERR_NO_ERROR) {
-			if (!is_retry && gfm_client_is_connection_error(e)) {
-				is_retry = 1;
-				goto finfo_retry2;
-			}
-			/* dst does not exist */
-			gfpara_send_int(to_parent, 0); /* 3: dst_exist */
-			free(subpath);
-			free(src_path);
-			free(dst_path);
-			goto next_command;
-		}
-		if (is_retry)
-			fprintf(stderr, "INFO: retry lstat(%s) OK\n", dst_path);
-
-		/* 3: dst_exist */
-		gfpara_send_int(to_parent, 1);
-		/* 4: dst_m_sec */
-		gfpara_send_int64(to_parent, dst_st.mtime_sec);
-		/* 5: dst_m_nsec */
-		gfpara_send_int(to_parent, dst_st.mtime_nsec);
-		if (S_ISREG(dst_st.mode)) {
-			/* 6: dst_d_type */
-			gfpara_send_int(to_parent, GFS_DT_REG);
-			/* 7: dst_size */
-			gfpara_send_int64(to_parent, dst_st.size);
-			if (handle->dst_type == URL_TYPE_GFARM) {
-				is_retry = 0;
-finfo_retry3:
-				e = gfs_replica_list_by_name(
-					dst_path, &ncopy, &copy);
-				if (e == GFARM_ERR_NO_ERROR) {
-					if (is_retry)
-						fprintf(stderr,
-						"INFO: retry "
-						"gfs_replica_list_by_name(%s) "
-						"OK\n", dst_path);
-					/* 8: dst_ncopy */
-					gfpara_send_int(to_parent, ncopy);
-					for (i = 0; i < ncopy; i++)
-						/* 9: dst_copy */
-						gfpara_send_string(
-							to_parent,
-							"%s", copy[i]);
-					gfarm_strings_free_deeply(ncopy, copy);
-				} else { /* no replica: ncopy == 0 */
-					if (!is_retry &&
-					    gfm_client_is_connection_error(e)
-						) {
-						is_retry = 1;
-						goto finfo_retry3;
-					}
-					fprintf(stderr,
-					"INFO: gfs_replica_list_by_name(%s):"
-					" %s\n", dst_path,
-					gfarm_error_string(e));
-					/* 8: dst_ncopy */
-					gfpara_send_int(to_parent, 0);
-				}
-			} else /* URL_TYPE_LOCAL: ncopy == 0 */
-				/* 8: dst_ncopy */
-				gfpara_send_int(to_parent, 0);
-		} else if (S_ISDIR(dst_st.mode)) /* 6: dst_d_type */
-			gfpara_send_int(to_parent, GFS_DT_DIR);
-		else if (S_ISLNK(dst_st.mode)) /* 6: dst_d_type */
-			gfpara_send_int(to_parent, GFS_DT_LNK);
-		else /* 6: dst_d_type */
-			gfpara_send_int(to_parent, GFS_DT_UNKNOWN);
-		free(subpath);
-		free(src_path);
-		free(dst_path);
+		dirtree_child_finfo_batch(handle, n_ents, subpaths, is_files,
+		    func_lstat, to_parent);
+		for (i = 0; i < n_ents; i++)
+			free(subpaths[i]);
+		free(subpaths);
+		free(is_files);
 		goto next_command;
 	/* ------------------------------------------------------------ */
 	case DIRTREE_CMD_TERMINATE:
@@ -735,8 +933,9 @@ dirtree_send(FILE *child_in, gfpara_proc_t *proc, void *param, int stop)
 	gfarm_dirtree_t *handle = param;
 	char *subdir;
 	gfarm_error_t e;
-	gfarm_dirtree_entry_t *ent;
+	struct dirtree_finfo_batch *batch;
 	void *p;
+	int i;
 
 	if (stop) {
 		gfpara_send_int(child_in, DIRTREE_CMD_TERMINATE);
@@ -751,14 +950,31 @@ retry:
 	/* Don't read fifo_dirs before fifo_ents */
 	e = gfarm_fifo_simple_next(handle->fifo_ents, &p); /* nonblock */
 	if (e == GFARM_ERR_NO_ERROR) {
+		GFARM_MALLOC(batch);
+		if (batch == NULL) {
+			gfarm_mutex_unlock(&handle->mutex, diag, "mutex");
+			fprintf(stderr, "FATAL: no memory\n");
+			return (GFPARA_FATAL);
+		}
+		batch->ents[0] = p;
+		for (i = 1; i < DIRTREE_FINFO_BATCH; i++) {
+			if (gfarm_fifo_simple_next(handle->fifo_ents, &p)
+			    != GFARM_ERR_NO_ERROR)
+				break;
+			batch->ents[i] = p;
+		}
+		batch->n_ents = i;
 		handle->n_get_ents++;
 		gfarm_mutex_unlock(&handle->mutex, diag, "mutex");
-		ent = p;
 		gfpara_send_int(child_in, DIRTREE_CMD_GET_FINFO);
-		gfpara_send_string(child_in, "%s", ent->subpath);
-		gfpara_send_int(child_in,
-				ent->src_d_type == GFS_DT_REG ? 1 : 0);
-		gfpara_data_set(proc, ent);
+		gfpara_send_int(child_in, batch->n_ents);
+		for (i = 0; i < batch->n_ents; i++) {
+			gfpara_send_string(child_in, "%s",
+			    batch->ents[i]->subpath);
+			gfpara_send_int(child_in,
+			    batch->ents[i]->src_d_type == GFS_DT_REG ? 1 : 0);
+		}
+		gfpara_data_set(proc, batch);
 		return (GFPARA_NEXT);
 	}
 	if (handle->n_get_ents > 0) { /* wait all dirtree_recv_finfo() */
@@ -905,13 +1121,11 @@ dirtree_recv_dents(FILE *child_out, gfpara_proc_t *proc, void *param)
 }
 
 static int
-dirtree_recv_finfo(FILE *child_out, gfpara_proc_t *proc, void *param)
+dirtree_recv_finfo_one(FILE *child_out, gfarm_dirtree_entry_t *ent,
+	gfarm_dirtree_t *handle)
 {
-	gfarm_dirtree_t *handle = param;
 	int d_type_int, i;
-	gfarm_dirtree_entry_t *ent;
 
-	ent = gfpara_data_get(proc);
 	gfpara_recv_int(child_out, &ent->src_ncopy); /* 1 */
 	if (ent->src_ncopy > 0) {
 		GFARM_MALLOC_ARRAY(ent->src_copy, ent->src_ncopy);
@@ -977,6 +1191,24 @@ dirtree_recv_finfo(FILE *child_out, gfpara_proc_t *proc, void *param)
 	return (GFPARA_NEXT);
 }
 
+static int
+dirtree_recv_finfo(FILE *child_out, gfpara_proc_t *proc, void *param)
+{
+	gfarm_dirtree_t *handle = param;
+	struct dirtree_finfo_batch *batch = gfpara_data_get(proc);
+	int i, retv = GFPARA_NEXT;
+
+	for (i = 0; i < batch->n_ents; i++) {
+		retv = dirtree_recv_finfo_one(child_out, batch->ents[i],
+		    handle);
+		if (retv != GFPARA_NEXT)
+			break;
+	}
+	gfpara_data_set(proc, NULL);
+	free(batch);
+	return (retv);
+}
+
 static int
 dirtree_recv(FILE *child_out, gfpara_proc_t *proc, void *param)
 {
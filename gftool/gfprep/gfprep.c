@@ -272,7 +272,7 @@ gfprep_create_hostinfohash_all(const char *path, int *nhost_infos_p,
 	struct gfarm_hash_entry *he;
 	struct gfarm_hash_iterator iter;
 
-	*hash_all_p = gfarm_hash_table_alloc(
+	*hash_all_p = gfarm_hash_table_alloc_resizable(
 		HOSTHASH_SIZE, gfarm_hash_casefold_strptr,
 		gfarm_hash_key_equal_casefold_strptr);
 	if (*hash_all_p == NULL)
@@ -417,7 +417,7 @@ gfprep_filter_hostinfohash(const char *path,
 	struct gfarm_hash_iterator iter;
 	gfarm_error_t e;
 
-	*hash_info_p = gfarm_hash_table_alloc(
+	*hash_info_p = gfarm_hash_table_alloc_resizable(
 		HOSTHASH_SIZE, gfarm_hash_strptr, gfarm_hash_key_equal_strptr);
 	if (*hash_info_p == NULL)
 		return (GFARM_ERR_NO_MEMORY);
@@ -2772,7 +2772,8 @@ main(int argc, char *argv[])
 	enum way { WAY_NOPLAN, WAY_GREEDY, WAY_BAD };
 	enum way way = WAY_NOPLAN;
 	gfarm_list list_to_schedule;
-	struct timeval time_start, time_end;
+	struct timeval time_start, time_end, time_dirtree;
+	double dirtree_sec;
 	static gfarm_uint64_t total_requested_filesize = 0;
 	enum gfmsg_level msglevel;
 	/* options */
@@ -3999,6 +4000,10 @@ next_entry:
 		gfarm_pfunc_terminate(pfunc_handle);
 		gfmsg_fatal_e(e, "gfarm_dirtree_checknext");
 	}
+	if (opt.performance) {
+		gettimeofday(&time_dirtree, NULL);
+		gfarm_timeval_sub(&time_dirtree, &time_start);
+	}
 
 	e = gfarm_dirtree_close(dirtree_handle);
 	gfmsg_warn_e(e, "gfarm_dirtree_close");
@@ -4101,6 +4106,14 @@ next_entry:
 		gfarm_timeval_sub(&time_end, &time_start);
 		printf("all_entries_num: %"GFARM_PRId64"\n", n_entry);
 		printf("all_files_num: %"GFARM_PRId64"\n", n_file);
+		dirtree_sec = (double)time_dirtree.tv_sec +
+		    (double)time_dirtree.tv_usec / GFARM_SECOND_BY_MICROSEC;
+		printf("dirtree_time: %lld.%06d sec.\n",
+		       (long long)time_dirtree.tv_sec,
+		       (int)time_dirtree.tv_usec);
+		if (dirtree_sec > 0)
+			printf("dirtree_entries_per_sec: %.1f\n",
+			       (double)n_entry / dirtree_sec);
 		printf("%s_file_num: %"GFARM_PRId64"\n",
 		       prefix, total_ok_filenum);
 		printf("%s_file_size: %"GFARM_PRId64"\n",
@@ -24,6 +24,7 @@
 #include "gfutil.h"
 #define GFARM_USE_OPENSSL
 #include "msgdigest.h"
+#include "msgdigest_engine.h"
 
 #include "config.h"
 #include "lookup.h"
@@ -139,42 +140,92 @@ dir_foreach(
 	return (GFARM_ERR_NO_ERROR);
 }
 
+/*
+ * files are hashed concurrently by up to `nthreads' threads.
+ * each checksum is compared after all files in the batch are hashed.
+ */
+struct check_job {
+	char *file;
+	GFS_File gf;
+	struct gfs_stat_cksum c;
+	struct gfarm_msgdigest_job digest;
+};
+
+#define DIGEST_BUFSIZE	(GFARM_MSGDIGEST_ENGINE_NBUF * 65536)
+#define JOBS_PER_THREAD	4
+
+static int nthreads = 1;
+static struct check_job *jobs;
+static int njobs, max_jobs;
+
 static gfarm_error_t
-calc_digest(const char *file,
-	const char *md_type_name, char *md_string, size_t *md_strlenp)
+calc_digest_enqueue(char *file, GFS_File gf, struct gfs_stat_cksum *cp)
 {
-#define BUFSIZE	65536
-	char buf[BUFSIZE];
-	ssize_t sz;
-	int fd;
-	gfarm_error_t e = GFARM_ERR_NO_ERROR;
-
-	EVP_MD_CTX *md_ctx;
-	size_t md_len;
-	unsigned char md_value[EVP_MAX_MD_SIZE];
+	struct check_job *job;
 	int cause;
 
-	md_ctx = gfarm_msgdigest_alloc_by_name(md_type_name, &cause);
-	if (md_ctx == NULL)
+	if (jobs == NULL) {
+		max_jobs = nthreads > 1 ? nthreads * JOBS_PER_THREAD : 1;
+		GFARM_MALLOC_ARRAY(jobs, max_jobs);
+		if (jobs == NULL)
+			return (GFARM_ERR_NO_MEMORY);
+	}
+	job = &jobs[njobs];
+	if ((job->file = strdup(file)) == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+
+	job->digest.md_ctx = gfarm_msgdigest_alloc_by_name(cp->type, &cause);
+	if (job->digest.md_ctx == NULL)
 		gflog_fatal(GFARM_MSG_1004521, "%s: fatal error. "
 		    "digest type <%s> - %s",
-		    file, md_type_name, cause != 0 ? strerror(cause) :
+		    file, cp->type, cause != 0 ? strerror(cause) :
 		    "digest calculation disabled");
 
-	if ((fd = open(file, O_RDONLY)) == -1)
-		return (gfarm_errno_to_error(errno));
+	/* the result is set by calc_digest_flush() */
+	job->digest.error = 0;
+	if ((job->digest.fd = open(file, O_RDONLY)) == -1)
+		job->digest.error = errno;
+	job->gf = gf;
+	job->c = *cp;
+	njobs++;
+	return (GFARM_ERR_NO_ERROR);
+}
 
-	while ((sz = read(fd, buf, sizeof buf)) > 0)
-		EVP_DigestUpdate(md_ctx, buf, sz);
-	if (sz == -1)
-		e = gfarm_errno_to_error(errno);
+static void check_file_digest(struct check_job *);
 
-	md_len = gfarm_msgdigest_free(md_ctx, md_value);
-	if (e == GFARM_ERR_NO_ERROR)
-		*md_strlenp = gfarm_msgdigest_to_string(
-		    md_string, md_value, md_len);
-	close(fd);
-	return (e);
+static void
+calc_digest_flush(void)
+{
+	struct gfarm_msgdigest_job *digests;
+	int i, n, save_errno;
+
+	if (njobs == 0)
+		return;
+
+	/* jobs which failed to open are not hashed */
+	GFARM_MALLOC_ARRAY(digests, njobs);
+	if (digests == NULL)
+		save_errno = ENOMEM;
+	else {
+		for (i = n = 0; i < njobs; i++) {
+			if (jobs[i].digest.fd != -1)
+				digests[n++] = jobs[i].digest;
+		}
+		save_errno = gfarm_msgdigest_fd_multi(n, digests, nthreads,
+		    DIGEST_BUFSIZE);
+		for (i = n = 0; i < njobs; i++) {
+			if (jobs[i].digest.fd != -1)
+				jobs[i].digest = digests[n++];
+		}
+		free(digests);
+	}
+	for (i = 0; i < njobs; i++) {
+		if (save_errno != 0 && jobs[i].digest.fd != -1)
+			jobs[i].digest.error = save_errno;
+		check_file_digest(&jobs[i]);
+	}
+	njobs = 0;
+	*progress_addr = count;
 }
 
 static void
@@ -290,8 +341,6 @@ check_file(char *file, struct stat *stp, void *arg)
 	gfarm_uint64_t gen;
 	GFS_File gf;
 	gfarm_error_t e;
-	size_t md_strlen = 0;
-	char md_string[GFARM_MSGDIGEST_STRSIZE];
 
 	if (!mtime_filter(stp))
 		return (GFARM_ERR_NO_ERROR);
@@ -324,13 +373,48 @@ check_file(char *file, struct stat *stp, void *arg)
 		e = GFARM_ERR_NO_ERROR;
 	} else if (c.len > 0 && !cksum_check) {
 		e = GFARM_ERR_NO_ERROR;
-	} else if ((e = calc_digest(file, c.type, md_string, &md_strlen))
-	    != GFARM_ERR_NO_ERROR) {
-		if (e == GFARM_ERR_OPERATION_NOT_SUPPORTED) {
-			gflog_warning(GFARM_MSG_1004196,
-			    "%s: cksum type <%s> isn't supported on this host",
-			    file, c.type);
-		} else if (e == GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY) {
+	} else if ((e = calc_digest_enqueue(file, gf, &c))
+	    == GFARM_ERR_NO_ERROR) {
+		/* check_file_digest() does the rest */
+		count += 1;
+		size += stp->st_size;
+		if (njobs == max_jobs)
+			calc_digest_flush();
+		if (foreground)
+			show_progress();
+		return (GFARM_ERR_NO_ERROR);
+	}
+	gfs_stat_cksum_free(&c);
+close_progress:
+	gfs_pio_close(gf);
+progress:
+	count += 1;
+	size += stp->st_size;
+	if (foreground)
+		show_progress();
+	/* do not skip the pending files, if restarted */
+	if (njobs == 0)
+		*progress_addr = count;
+	return (e);
+}
+
+static void
+check_file_digest(struct check_job *job)
+{
+	char *file = job->file;
+	struct gfs_stat_cksum c = job->c;
+	GFS_File gf = job->gf;
+	gfarm_error_t e;
+	size_t md_strlen = 0;
+	char md_string[GFARM_MSGDIGEST_STRSIZE];
+
+	if (job->digest.fd != -1)
+		close(job->digest.fd);
+	md_strlen = gfarm_msgdigest_to_string_and_free(
+	    job->digest.md_ctx, md_string);
+	if (job->digest.error != 0) {
+		e = gfarm_errno_to_error(job->digest.error);
+		if (e == GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY) {
 			/*
 			 * GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY means
 			 * this file is updated simultaneously
@@ -343,7 +427,7 @@ check_file(char *file, struct stat *stp, void *arg)
 	    (md_strlen != c.len || memcmp(md_string, c.cksum, c.len) != 0)) {
 		gfs_stat_cksum_free(&c);
 		if ((e = gfs_fstat_cksum(gf, &c)) != GFARM_ERR_NO_ERROR)
-			goto close_progress;
+			goto close;
 		if (c.len > 0 && (c.flags & (GFM_PROTO_CKSUM_GET_MAYBE_EXPIRED|
 		    GFM_PROTO_CKSUM_GET_EXPIRED)) == 0) {
 			e = GFARM_ERR_CHECKSUM_MISMATCH;
@@ -360,15 +444,12 @@ check_file(char *file, struct stat *stp, void *arg)
 		e = gfs_fstat_cksum_set(gf, &ck);
 	}
 	gfs_stat_cksum_free(&c);
-close_progress:
+close:
 	gfs_pio_close(gf);
-progress:
-	count += 1;
-	size += stp->st_size;
-	if (foreground)
-		show_progress();
-	*progress_addr = count;
-	return (e);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_error(GFARM_MSG_1005783, "%s: %s", file,
+		    gfarm_error_string(e));
+	free(file);
 }
 
 static void
@@ -377,6 +458,7 @@ check_spool(char *dir, gfarm_error_t (*op)(char *, struct stat *, void *))
 	gfarm_error_t e;
 
 	e = dir_foreach(op, NULL, NULL, dir, NULL);
+	calc_digest_flush();
 	if (e != GFARM_ERR_NO_ERROR)
 		gflog_error(GFARM_MSG_1003790, "%s: %s", dir,
 		    gfarm_error_string(e));
@@ -464,6 +546,8 @@ usage(void)
 	    progname);
 	fprintf(stderr, "2> log\n");
 	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "\t-j num\tcalculate checksums of num files "
+	    "in parallel\n");
 	fprintf(stderr, "\t-n\tdo not calculate checksum\n");
 	fprintf(stderr, "\t-m day\tselect files modified within day days\n");
 	fprintf(stderr, "\t-M day\tselect files modified older than day ");
@@ -487,7 +571,7 @@ main(int argc, char *argv[])
 	if (argc > 0)
 		progname = basename(argv[0]);
 
-	while ((c = getopt(argc, argv, "fh:m:nr:GM:?")) != -1) {
+	while ((c = getopt(argc, argv, "fh:j:m:nr:GM:?")) != -1) {
 		switch (c) {
 		case 'f':
 			foreground = 1;
@@ -495,6 +579,11 @@ main(int argc, char *argv[])
 		case 'h':
 			op_host = optarg;
 			break;
+		case 'j':
+			nthreads = atoi(optarg);
+			if (nthreads < 1)
+				usage();
+			break;
 		case 'm':
 			mtime_max_day = atoi(optarg) * 3600 * 24;
 			break;
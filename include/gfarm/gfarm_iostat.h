@@ -20,7 +20,7 @@ struct gfarm_iostat_head {
 	unsigned int	s_rowmax;	/* maximum # row */
 	unsigned int	s_item_size;
 	unsigned int	s_ncolumn;
-	unsigned int	s_dummy;
+	unsigned int	s_nhist;	/* # histogram row */
 	gfarm_uint64_t	s_start_sec;
 	gfarm_uint64_t	s_update_sec;
 	gfarm_uint64_t	s_item_off;
@@ -34,3 +34,23 @@ struct gfarm_iostat_items {
 	gfarm_uint64_t	s_valid;
 	gfarm_int64_t	s_vals[1];	/* [s_nitem] */
 };
+
+/*
+ * log-linear latency histogram, placed after the s_row items.
+ * values less than 2^GFARM_IOSTAT_HIST_SUB_BITS have their own bucket,
+ * and each power of two above is divided into 2^GFARM_IOSTAT_HIST_SUB_BITS
+ * buckets, thus the relative error is less than 12.5%.
+ * the lower bound of the bucket i (i >= 8) is
+ *	(8 + i % 8) << (i / 8 - 1)
+ */
+#define GFARM_IOSTAT_HIST_SUB_BITS	3
+#define GFARM_IOSTAT_HIST_NBUCKET	248
+struct gfarm_iostat_hist {
+	char h_name[GFARM_IOSTAT_NAME_MAX + 2];
+	gfarm_uint64_t	h_count;
+	gfarm_uint64_t	h_sum;		/* microseconds */
+	gfarm_uint64_t	h_max;		/* microseconds */
+	gfarm_uint64_t	h_reserved;
+	gfarm_uint64_t	h_buckets[GFARM_IOSTAT_HIST_NBUCKET];
+};
+
@@ -71,6 +71,8 @@ int gfarm_version_minor(void);
 int gfarm_version_teeny(void);
 
 int gfarm_get_client_file_bufsize(void);
+int gfarm_get_client_file_read_window(void);
+void gfarm_set_client_file_read_window(int);
 void gfarm_set_client_digest_check(int);
 
 /*
@@ -5663,3 +5663,171 @@
 #define GFARM_MSG_1005661	1005661
 #define GFARM_MSG_1005662	1005662
 #define GFARM_MSG_1005663	1005663
+#define GFARM_MSG_1005664	1005664
+#define GFARM_MSG_1005665	1005665
+#define GFARM_MSG_1005666	1005666
+#define GFARM_MSG_1005667	1005667
+#define GFARM_MSG_1005668	1005668
+#define GFARM_MSG_1005669	1005669
+#define GFARM_MSG_1005670	1005670
+#define GFARM_MSG_1005671	1005671
+#define GFARM_MSG_1005672	1005672
+#define GFARM_MSG_1005673	1005673
+#define GFARM_MSG_1005674	1005674
+#define GFARM_MSG_1005675	1005675
+#define GFARM_MSG_1005676	1005676
+#define GFARM_MSG_1005677	1005677
+#define GFARM_MSG_1005678	1005678
+#define GFARM_MSG_1005679	1005679
+#define GFARM_MSG_1005680	1005680
+#define GFARM_MSG_1005681	1005681
+#define GFARM_MSG_1005682	1005682
+#define GFARM_MSG_1005683	1005683
+#define GFARM_MSG_1005684	1005684
+#define GFARM_MSG_1005685	1005685
+#define GFARM_MSG_1005686	1005686
+#define GFARM_MSG_1005687	1005687
+#define GFARM_MSG_1005688	1005688
+#define GFARM_MSG_1005689	1005689
+#define GFARM_MSG_1005690	1005690
+#define GFARM_MSG_1005691	1005691
+#define GFARM_MSG_1005692	1005692
+#define GFARM_MSG_1005693	1005693
+#define GFARM_MSG_1005694	1005694
+#define GFARM_MSG_1005695	1005695
+#define GFARM_MSG_1005696	1005696
+#define GFARM_MSG_1005697	1005697
+#define GFARM_MSG_1005698	1005698
+#define GFARM_MSG_1005699	1005699
+#define GFARM_MSG_1005700	1005700
+#define GFARM_MSG_1005701	1005701
+#define GFARM_MSG_1005702	1005702
+#define GFARM_MSG_1005703	1005703
+#define GFARM_MSG_1005704	1005704
+#define GFARM_MSG_1005705	1005705
+#define GFARM_MSG_1005706	1005706
+#define GFARM_MSG_1005707	1005707
+#define GFARM_MSG_1005708	1005708
+#define GFARM_MSG_1005709	1005709
+#define GFARM_MSG_1005710	1005710
+#define GFARM_MSG_1005711	1005711
+#define GFARM_MSG_1005712	1005712
+#define GFARM_MSG_1005713	1005713
+#define GFARM_MSG_1005714	1005714
+#define GFARM_MSG_1005715	1005715
+#define GFARM_MSG_1005716	1005716
+#define GFARM_MSG_1005717	1005717
+#define GFARM_MSG_1005718	1005718
+#define GFARM_MSG_1005719	1005719
+#define GFARM_MSG_1005720	1005720
+#define GFARM_MSG_1005721	1005721
+#define GFARM_MSG_1005722	1005722
+#define GFARM_MSG_1005723	1005723
+#define GFARM_MSG_1005724	1005724
+#define GFARM_MSG_1005725	1005725
+#define GFARM_MSG_1005726	1005726
+#define GFARM_MSG_1005727	1005727
+#define GFARM_MSG_1005728	1005728
+#define GFARM_MSG_1005729	1005729
+#define GFARM_MSG_1005730	1005730
+#define GFARM_MSG_1005731	1005731
+#define GFARM_MSG_1005732	1005732
+#define GFARM_MSG_1005733	1005733
+#define GFARM_MSG_1005734	1005734
+#define GFARM_MSG_1005735	1005735
+#define GFARM_MSG_1005736	1005736
+#define GFARM_MSG_1005737	1005737
+#define GFARM_MSG_1005738	1005738
+#define GFARM_MSG_1005739	1005739
+#define GFARM_MSG_1005740	1005740
+#define GFARM_MSG_1005741	1005741
+#define GFARM_MSG_1005742	1005742
+#define GFARM_MSG_1005743	1005743
+#define GFARM_MSG_1005744	1005744
+#define GFARM_MSG_1005745	1005745
+#define GFARM_MSG_1005746	1005746
+#define GFARM_MSG_1005747	1005747
+#define GFARM_MSG_1005748	1005748
+#define GFARM_MSG_1005749	1005749
+#define GFARM_MSG_1005750	1005750
+#define GFARM_MSG_1005751	1005751
+#define GFARM_MSG_1005752	1005752
+#define GFARM_MSG_1005753	1005753
+#define GFARM_MSG_1005754	1005754
+#define GFARM_MSG_1005755	1005755
+#define GFARM_MSG_1005756	1005756
+#define GFARM_MSG_1005757	1005757
+#define GFARM_MSG_1005758	1005758
+#define GFARM_MSG_1005759	1005759
+#define GFARM_MSG_1005760	1005760
+#define GFARM_MSG_1005761	1005761
+#define GFARM_MSG_1005762	1005762
+#define GFARM_MSG_1005763	1005763
+#define GFARM_MSG_1005764	1005764
+#define GFARM_MSG_1005765	1005765
+#define GFARM_MSG_1005766	1005766
+#define GFARM_MSG_1005767	1005767
+#define GFARM_MSG_1005768	1005768
+#define GFARM_MSG_1005769	1005769
+#define GFARM_MSG_1005770	1005770
+#define GFARM_MSG_1005771	1005771
+#define GFARM_MSG_1005772	1005772
+#define GFARM_MSG_1005773	1005773
+#define GFARM_MSG_1005774	1005774
+#define GFARM_MSG_1005775	1005775
+#define GFARM_MSG_1005776	1005776
+#define GFARM_MSG_1005777	1005777
+#define GFARM_MSG_1005778	1005778
+#define GFARM_MSG_1005779	1005779
+#define GFARM_MSG_1005780	1005780
+#define GFARM_MSG_1005781	1005781
+#define GFARM_MSG_1005782	1005782
+#define GFARM_MSG_1005783	1005783
+#define GFARM_MSG_1005784	1005784
+#define GFARM_MSG_1005785	1005785
+#define GFARM_MSG_1005786	1005786
+#define GFARM_MSG_1005787	1005787
+#define GFARM_MSG_1005788	1005788
+#define GFARM_MSG_1005789	1005789
+#define GFARM_MSG_1005790	1005790
+#define GFARM_MSG_1005791	1005791
+#define GFARM_MSG_1005792	1005792
+#define GFARM_MSG_1005793	1005793
+#define GFARM_MSG_1005794	1005794
+#define GFARM_MSG_1005795	1005795
+#define GFARM_MSG_1005796	1005796
+#define GFARM_MSG_1005797	1005797
+#define GFARM_MSG_1005798	1005798
+#define GFARM_MSG_1005799	1005799
+#define GFARM_MSG_1005800	1005800
+#define GFARM_MSG_1005801	1005801
+#define GFARM_MSG_1005802	1005802
+#define GFARM_MSG_1005803	1005803
+#define GFARM_MSG_1005804	1005804
+#define GFARM_MSG_1005805	1005805
+#define GFARM_MSG_1005806	1005806
+#define GFARM_MSG_1005807	1005807
+#define GFARM_MSG_1005808	1005808
+#define GFARM_MSG_1005809	1005809
+#define GFARM_MSG_1005810	1005810
+#define GFARM_MSG_1005811	1005811
+#define GFARM_MSG_1005812	1005812
+#define GFARM_MSG_1005813	1005813
+#define GFARM_MSG_1005814	1005814
+#define GFARM_MSG_1005815	1005815
+#define GFARM_MSG_1005816	1005816
+#define GFARM_MSG_1005817	1005817
+#define GFARM_MSG_1005818	1005818
+#define GFARM_MSG_1005819	1005819
+#define GFARM_MSG_1005820	1005820
+#define GFARM_MSG_1005821	1005821
+#define GFARM_MSG_1005822	1005822
+#define GFARM_MSG_1005823	1005823
+#define GFARM_MSG_1005824	1005824
+#define GFARM_MSG_1005825	1005825
+#define GFARM_MSG_1005826	1005826
+#define GFARM_MSG_1005827	1005827
+#define GFARM_MSG_1005828	1005828
+#define GFARM_MSG_1005829	1005829
+#define GFARM_MSG_1005830	1005830
+#define GFARM_MSG_1005831	1005831
@@ -239,6 +239,8 @@ gfarm_error_t gfs_rename(const char *, const char *);
 
 gfarm_error_t gfs_stat(const char *, struct gfs_stat *);
 gfarm_error_t gfs_lstat(const char *, struct gfs_stat *);
+gfarm_error_t gfs_lstat_multi(int, const char **, struct gfs_stat *,
+	gfarm_error_t *);
 gfarm_error_t gfs_fstat(GFS_File, struct gfs_stat *);
 gfarm_error_t gfs_stat_cksum(const char *, struct gfs_stat_cksum *);
 gfarm_error_t gfs_fstat_cksum(GFS_File, struct gfs_stat_cksum *);
@@ -345,6 +347,8 @@ int gfs_replica_info_nth_is_dead_copy(struct gfs_replica_info *, int);
 void gfs_replica_info_free(struct gfs_replica_info *);
 
 gfarm_error_t gfs_replica_list_by_name(const char *, int *, char ***);
+gfarm_error_t gfs_replica_list_by_name_multi(const char *, int,
+	const char **, int *, char ***, gfarm_error_t *);
 gfarm_error_t gfs_replica_remove_by_file(const char *, const char *);
 gfarm_error_t gfs_replicate_to_local(GFS_File, char *, int);
 
@@ -478,6 +482,7 @@ gfarm_error_t gfs_stat_cached(const char *, struct gfs_stat *);
 gfarm_error_t gfs_stat_caching(const char *, struct gfs_stat *);
 gfarm_error_t gfs_lstat_cached(const char *, struct gfs_stat *);
 gfarm_error_t gfs_lstat_caching(const char *, struct gfs_stat *);
+gfarm_error_t gfs_lstat_prefetch(int, const char **);
 gfarm_error_t gfs_getxattr_cached(const char *path, const char *name,
 	void *value, size_t *size);
 gfarm_error_t gfs_getxattr_caching(const char *path, const char *name,
@@ -943,6 +943,8 @@ gfarm_set_local_user_for_this_uid(uid_t uid)
 	(64LL*1024*1024*1024*1024) /* one process per 64TB */
 #define GFARM_SPOOL_BASE_LOAD_DEFAULT	0.0F
 #define GFARM_SPOOL_DIGEST_ERROR_CHECK_DEFAULT	1 /* enable */
+#define GFARM_SPOOL_SERVER_ZEROCOPY_DEFAULT	1 /* enable */
+#define GFARM_SPOOL_SERVER_WORKER_POOL_SIZE_DEFAULT	0 /* fork per client */
 #define GFARM_SPOOL_SERVER_READ_ONLY_RETRY_INTERVAL_DEFAULT 60 /* second */
 #define GFARM_WRITE_VERIFY_DEFAULT 0 /* disable */
 #define GFARM_WRITE_VERIFY_INTERVAL_DEFAULT 21600 /* seconds (6 hours) */
@@ -973,6 +975,8 @@ gfarm_off_t gfarm_spool_check_parallel_per_capacity =
     GFARM_CONFIG_MISC_DEFAULT;
 float gfarm_spool_base_load = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_spool_digest_error_check = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_spool_server_zerocopy = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_spool_server_worker_pool_size = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_write_verify = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_write_verify_interval = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_write_verify_retry_interval = GFARM_CONFIG_MISC_DEFAULT;
@@ -1040,6 +1044,12 @@ int gfarm_iostat_max_client = GFARM_CONFIG_MISC_DEFAULT;
 #define GFARM_GFSD_CONNECTION_TIMEOUT_DEFAULT 30 /* 30 seconds */
 #define GFARM_ATTR_CACHE_LIMIT_DEFAULT		40000 /* 40,000 entries */
 #define GFARM_ATTR_CACHE_TIMEOUT_DEFAULT	1000 /* 1,000 milli second */
+#define GFARM_NEGATIVE_CACHE_TIMEOUT_DEFAULT	0 /* disabled */
+#define GFARM_DIR_CACHE_TIMEOUT_DEFAULT		0 /* disabled */
+#define GFARM_DIR_CACHE_SIZE_DEFAULT		(8 * 1024 * 1024) /* 8MB */
+#define GFARM_PATH_CACHE_TIMEOUT_DEFAULT	0 /* disabled */
+#define GFARM_LOOKUP_PATH_RPC_DEFAULT		0 /* disabled */
+#define GFARM_LSTAT_MULTI_RPC_DEFAULT		0 /* disabled */
 #define GFARM_PAGE_CACHE_TIMEOUT_DEFAULT	1000 /* 1,000 milli second */
 
 /* same with GFARM_GFMD_AUTHENTICATION_TIMEOUT_DEFAULT */
@@ -1078,20 +1088,35 @@ int gfarm_iostat_max_client = GFARM_CONFIG_MISC_DEFAULT;
 #define GFARM_METADB_REPLICA_REMOVER_BY_HOST_INODE_STEP_DEFAULT	1024
 #define GFARM_CLIENT_DIGEST_CHECK_DEFAULT	0
 #define GFARM_CLIENT_FILE_BUFSIZE_DEFAULT	(1024 * 1024)
+#define GFARM_CLIENT_FILE_READ_WINDOW_DEFAULT	4
+#define GFARM_CLIENT_FILE_READ_AHEAD_LIMIT_DEFAULT	(64 * 1024 * 1024)
 #define GFARM_CLIENT_PARALLEL_COPY_DEFAULT	4
 #define GFARM_CLIENT_PARALLEL_MAX_DEFAULT	16
 #define GFARM_PROFILE_DEFAULT 0 /* disable */
 #define GFARM_METADB_REPLICATION_ENABLED_DEFAULT	0
 #define GFARM_JOURNAL_MAX_SIZE_DEFAULT		(32 * 1024 * 1024) /* 32MB */
 #define GFARM_JOURNAL_RECVQ_SIZE_DEFAULT	100000
+#define GFARM_JOURNAL_SEND_FRAME_SIZE_DEFAULT	(256 * 1024) /* 256KB */
+#define GFARM_JOURNAL_SEND_WINDOW_DEFAULT	8 /* frames */
+#define GFARM_JOURNAL_SEND_COMPRESSION_DEFAULT	0 /* disable */
 #define GFARM_JOURNAL_SYNC_FILE_DEFAULT		1
+#define GFARM_JOURNAL_SYNC_GROUP_COMMIT_DEFAULT	0 /* disable */
+#define GFARM_JOURNAL_SYNC_MAX_DELAY_DEFAULT	0 /* microseconds */
+#define GFARM_JOURNAL_SYNC_MAX_BATCH_SIZE_DEFAULT	(1024 * 1024) /* 1MB */
 #define GFARM_JOURNAL_SYNC_SLAVE_TIMEOUT_DEFAULT 10 /* 10 second */
+#define GFARM_METADB_SNAPSHOT_INTERVAL_DEFAULT	3600 /* 1 hour */
 #define GFARM_METADB_SERVER_SLAVE_REPLICATION_TIMEOUT_DEFAULT 120 /* 120 sec */
 #define GFARM_METADB_SERVER_SLAVE_MAX_SIZE_DEFAULT	16
 #define GFARM_METADB_SERVER_FORCE_SLAVE_DEFAULT		0
 #define GFARM_METADB_SERVER_NFS_ROOT_SQUASH_SUPPORT_DEFAULT	1 /* enable */
 #define GFARM_METADB_SERVER_LONG_TERM_LOCK_TYPE_DEFAULT	\
 	GFARM_LOCK_TYPE_TICKETLOCK
+#define GFARM_METADB_SERVER_THREAD_POOL_TYPE_DEFAULT	\
+	GFARM_THREAD_POOL_TYPE_MUTEX
+#define GFARM_METADB_SERVER_FAIR_SHARE_KEY_DEFAULT	\
+	GFARM_FAIR_SHARE_KEY_NONE
+#define GFARM_METADB_SERVER_FAIR_SHARE_WEIGHT_DEFAULT	1
+#define GFARM_METADB_SERVER_FAIR_SHARE_RATE_DEFAULT	0 /* unlimited */
 #define GFARM_NETWORK_RECEIVE_TIMEOUT_DEFAULT	60 /* 60 seconds */
 #define GFARM_NETWORK_SEND_TIMEOUT_DEFAULT	0 /* seconds (disabled) */
 #define GFARM_FILE_TRACE_DEFAULT 0 /* disable */
@@ -1111,7 +1136,10 @@ int gfarm_iostat_max_client = GFARM_CONFIG_MISC_DEFAULT;
 #define GFARM_REPLICA_CHECK_SLEEP_TIME_DEFAULT 100000 /* nanosec. */
 #define GFARM_REPLICA_CHECK_YIELD_TIME_DEFAULT 0 /* nanosec. (disabled) */
 #define GFARM_REPLICA_CHECK_MINIMUM_INTERVAL_DEFAULT 10 /* 10 sec. */
+#define GFARM_REPLICA_CHECK_SCAN_BUDGET_DEFAULT 1000000 /* files per cycle */
 #define GFARM_REPLICAINFO_ENABLED_DEFAULT	1 /* enable */
+#define GFARM_XATTR_INDEX_DEFAULT	0 /* disable */
+#define GFARM_REPLICA_PLACEMENT_DEFAULT	GFARM_REPLICA_PLACEMENT_RANDOM
 
 char *gfarm_digest = NULL;
 int gfarm_read_only = GFARM_CONFIG_MISC_DEFAULT;
@@ -1119,6 +1147,8 @@ int gfarm_simultaneous_replication_receivers = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replication_busy_host = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_xattr_size_limit = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_xmlattr_size_limit = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_xattr_index = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_replica_placement = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_directory_quota_count_per_user_limit = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_directory_quota_check_start_delay = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_directory_quota_check_retry_interval = GFARM_CONFIG_MISC_DEFAULT;
@@ -1137,9 +1167,12 @@ int gfarm_metadb_remove_scan_interval_factor = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_heartbeat_interval = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_failover_notify_delay = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_dbq_size = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_metadb_dbq_batch_size = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_server_back_channel_sndbuf_limit = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_server_nfs_root_squash_support = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_server_long_term_lock_type = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_metadb_server_thread_pool_type = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_metadb_server_fair_share_key = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_replica_remover_by_host_sleep_time =
 	GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_replica_remover_by_host_inode_step =
@@ -1148,8 +1181,16 @@ static int metadb_replication_enabled = GFARM_CONFIG_MISC_DEFAULT;
 static char *journal_dir = NULL;
 static int journal_max_size = GFARM_CONFIG_MISC_DEFAULT;
 static int journal_recvq_size = GFARM_CONFIG_MISC_DEFAULT;
+static int journal_send_frame_size = GFARM_CONFIG_MISC_DEFAULT;
+static int journal_send_window = GFARM_CONFIG_MISC_DEFAULT;
+static int journal_send_compression = GFARM_CONFIG_MISC_DEFAULT;
 static int journal_sync_file = GFARM_CONFIG_MISC_DEFAULT;
+static int journal_sync_group_commit = GFARM_CONFIG_MISC_DEFAULT;
+static int journal_sync_max_delay = GFARM_CONFIG_MISC_DEFAULT;
+static int journal_sync_max_batch_size = GFARM_CONFIG_MISC_DEFAULT;
 static int journal_sync_slave_timeout = GFARM_CONFIG_MISC_DEFAULT;
+static char *metadb_snapshot_file = NULL;
+static int metadb_snapshot_interval = GFARM_CONFIG_MISC_DEFAULT;
 static int metadb_server_slave_replication_timeout = GFARM_CONFIG_MISC_DEFAULT;
 static int metadb_server_slave_max_size = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replica_check = GFARM_CONFIG_MISC_DEFAULT;
@@ -1162,12 +1203,16 @@ int gfarm_replica_check_host_down_thresh = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replica_check_sleep_time = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replica_check_yield_time = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replica_check_minimum_interval = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_replica_check_scan_budget = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replicainfo_enabled = GFARM_CONFIG_MISC_DEFAULT;
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 static const char mutex_label[] = "config";
 static int metadb_server_force_slave = GFARM_CONFIG_MISC_DEFAULT;
 
+static void replica_placement_by_fsngroup_free(void);
+static void fair_share_weight_free(void);
+
 void
 gfarm_config_clear(void)
 {
@@ -1190,6 +1235,7 @@ gfarm_config_clear(void)
 		&gfarm_postgresql_conninfo,
 		&gfarm_localfs_datadir,
 		&journal_dir,
+		&metadb_snapshot_file,
 	};
 	int i;
 
@@ -1203,6 +1249,8 @@ gfarm_config_clear(void)
 		free(gfarm_spool_root[i]);
 		gfarm_spool_root[i] = NULL;
 	}
+	replica_placement_by_fsngroup_free();
+	fair_share_weight_free();
 #if 0 /* XXX */
 	config_read = gfarm_config_not_read;
 #endif
@@ -1443,18 +1491,66 @@ gfarm_get_journal_max_size(void)
 	return (journal_max_size);
 }
 
+const char *
+gfarm_get_metadb_snapshot_file(void)
+{
+	return (metadb_snapshot_file);
+}
+
+int
+gfarm_get_metadb_snapshot_interval(void)
+{
+	return (metadb_snapshot_interval);
+}
+
 int
 gfarm_get_journal_recvq_size(void)
 {
 	return (journal_recvq_size);
 }
 
+int
+gfarm_get_journal_send_frame_size(void)
+{
+	return (journal_send_frame_size);
+}
+
+int
+gfarm_get_journal_send_window(void)
+{
+	return (journal_send_window);
+}
+
+int
+gfarm_get_journal_send_compression(void)
+{
+	return (journal_send_compression);
+}
+
 int
 gfarm_get_journal_sync_file(void)
 {
 	return (journal_sync_file);
 }
 
+int
+gfarm_get_journal_sync_group_commit(void)
+{
+	return (journal_sync_group_commit);
+}
+
+int
+gfarm_get_journal_sync_max_delay(void)
+{
+	return (journal_sync_max_delay);
+}
+
+int
+gfarm_get_journal_sync_max_batch_size(void)
+{
+	return (journal_sync_max_batch_size);
+}
+
 int
 gfarm_get_journal_sync_slave_timeout(void)
 {
@@ -1507,6 +1603,18 @@ gfarm_get_client_file_bufsize(void)
 	return (gfarm_ctxp->client_file_bufsize);
 }
 
+int
+gfarm_get_client_file_read_window(void)
+{
+	return (gfarm_ctxp->client_file_read_window);
+}
+
+void
+gfarm_set_client_file_read_window(int window)
+{
+	gfarm_ctxp->client_file_read_window = window;
+}
+
 void
 gfarm_set_client_digest_check(int enable)
 {
@@ -2698,6 +2806,7 @@ static struct gfarm_name_value_tuple lock_type_name_table[] = {
 	{ "mutex", GFARM_LOCK_TYPE_MUTEX },
 	{ "ticketlock", GFARM_LOCK_TYPE_TICKETLOCK },
 	{ "queuelock", GFARM_LOCK_TYPE_QUEUELOCK },
+	{ "rwqueuelock", GFARM_LOCK_TYPE_RWQUEUELOCK },
 };
 
 static gfarm_error_t
@@ -2708,6 +2817,248 @@ parse_set_misc_lock_type(char *p, int *vp)
 	    "lock_type"));
 }
 
+static struct gfarm_name_value_tuple thread_pool_type_name_table[] = {
+	{ "mutex", GFARM_THREAD_POOL_TYPE_MUTEX },
+	{ "work_stealing", GFARM_THREAD_POOL_TYPE_WORK_STEALING },
+};
+
+static gfarm_error_t
+parse_set_misc_thread_pool_type(char *p, int *vp)
+{
+	return (parse_set_misc_name_value_table(p, vp,
+	    thread_pool_type_name_table,
+	    GFARM_ARRAY_LENGTH(thread_pool_type_name_table),
+	    "thread_pool_type"));
+}
+
+static struct gfarm_name_value_tuple fair_share_key_name_table[] = {
+	{ "none", GFARM_FAIR_SHARE_KEY_NONE },
+	{ "user", GFARM_FAIR_SHARE_KEY_USER },
+	{ "tenant", GFARM_FAIR_SHARE_KEY_TENANT },
+};
+
+static gfarm_error_t
+parse_set_misc_fair_share_key(char *p, int *vp)
+{
+	return (parse_set_misc_name_value_table(p, vp,
+	    fair_share_key_name_table,
+	    GFARM_ARRAY_LENGTH(fair_share_key_name_table),
+	    "fair_share_key"));
+}
+
+/* "metadb_server_fair_share_weight <name> <weight> [<rate>]" */
+struct fair_share_weight {
+	char *name;
+	int weight, rate;
+};
+static struct fair_share_weight *fair_share_weights;
+static int fair_share_weights_num;
+
+static void
+fair_share_weight_free(void)
+{
+	int i;
+
+	for (i = 0; i < fair_share_weights_num; i++)
+		free(fair_share_weights[i].name);
+	free(fair_share_weights);
+	fair_share_weights = NULL;
+	fair_share_weights_num = 0;
+}
+
+static struct fair_share_weight *
+fair_share_weight_lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i < fair_share_weights_num; i++) {
+		if (strcmp(fair_share_weights[i].name, name) == 0)
+			return (&fair_share_weights[i]);
+	}
+	return (NULL);
+}
+
+/*
+ * `name' is a user name or a tenant name,
+ * depending on metadb_server_fair_share_key.
+ * `*ratep' is the maximum number of jobs per second, 0 means unlimited.
+ */
+void
+gfarm_metadb_server_fair_share_weight_of(const char *name,
+	int *weightp, int *ratep)
+{
+	struct fair_share_weight *w = fair_share_weight_lookup(name);
+
+	*weightp = w != NULL ? w->weight :
+	    GFARM_METADB_SERVER_FAIR_SHARE_WEIGHT_DEFAULT;
+	*ratep = w != NULL ? w->rate :
+	    GFARM_METADB_SERVER_FAIR_SHARE_RATE_DEFAULT;
+}
+
+static gfarm_error_t
+parse_fair_share_weight(char *p, const char **op)
+{
+	gfarm_error_t e;
+	char *name, *s_weight, *s_rate, *tmp;
+	struct fair_share_weight *w;
+	int weight, rate = GFARM_METADB_SERVER_FAIR_SHARE_RATE_DEFAULT;
+	const char *listname = *op;
+
+	if ((e = gfarm_strtoken(&p, &name)) != GFARM_ERR_NO_ERROR ||
+	    (e = gfarm_strtoken(&p, &s_weight)) != GFARM_ERR_NO_ERROR ||
+	    (e = gfarm_strtoken(&p, &s_rate)) != GFARM_ERR_NO_ERROR ||
+	    (e = gfarm_strtoken(&p, &tmp)) != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_1005805,
+		    "parsing of %s arguments (%s) failed: %s",
+		    listname, p, gfarm_error_string(e));
+		return (e);
+	}
+	if (name == NULL || s_weight == NULL)
+		return (GFARM_ERRMSG_MISSING_ARGUMENT);
+	if (tmp != NULL)
+		return (GFARM_ERRMSG_TOO_MANY_ARGUMENTS);
+	if ((e = parse_set_int(s_weight, &weight)) != GFARM_ERR_NO_ERROR) {
+		*op = "2nd (weight) argument";
+		return (e);
+	}
+	if (weight <= 0) {
+		*op = "2nd (weight) argument";
+		return (GFARM_ERR_INVALID_ARGUMENT);
+	}
+	if (s_rate != NULL &&
+	    (e = parse_set_int(s_rate, &rate)) != GFARM_ERR_NO_ERROR) {
+		*op = "3rd (rate) argument";
+		return (e);
+	}
+	if (rate < 0) {
+		*op = "3rd (rate) argument";
+		return (GFARM_ERR_INVALID_ARGUMENT);
+	}
+
+	if (fair_share_weight_lookup(name) != NULL)
+		return (GFARM_ERR_NO_ERROR); /* first line has precedence */
+	GFARM_REALLOC_ARRAY(w, fair_share_weights, fair_share_weights_num + 1);
+	if (w == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	fair_share_weights = w;
+	w = &fair_share_weights[fair_share_weights_num];
+	if ((w->name = strdup(name)) == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	w->weight = weight;
+	w->rate = rate;
+	fair_share_weights_num++;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static struct gfarm_name_value_tuple replica_placement_name_table[] = {
+	{ "random", GFARM_REPLICA_PLACEMENT_RANDOM },
+	{ "weighted", GFARM_REPLICA_PLACEMENT_WEIGHTED },
+	{ "two_choices", GFARM_REPLICA_PLACEMENT_TWO_CHOICES },
+};
+
+/* "replica_placement <policy> <fsngroup>" */
+struct replica_placement_by_fsngroup {
+	char *fsngroup;
+	int policy;
+};
+static struct replica_placement_by_fsngroup *replica_placement_by_fsngroup;
+static int replica_placement_by_fsngroup_num;
+
+static void
+replica_placement_by_fsngroup_free(void)
+{
+	int i;
+
+	for (i = 0; i < replica_placement_by_fsngroup_num; i++)
+		free(replica_placement_by_fsngroup[i].fsngroup);
+	free(replica_placement_by_fsngroup);
+	replica_placement_by_fsngroup = NULL;
+	replica_placement_by_fsngroup_num = 0;
+}
+
+/* returns GFARM_CONFIG_MISC_DEFAULT, if not specified for the fsngroup */
+static int
+replica_placement_by_fsngroup_lookup(const char *fsngroup)
+{
+	int i;
+
+	for (i = 0; i < replica_placement_by_fsngroup_num; i++) {
+		if (strcmp(replica_placement_by_fsngroup[i].fsngroup,
+		    fsngroup) == 0)
+			return (replica_placement_by_fsngroup[i].policy);
+	}
+	return (GFARM_CONFIG_MISC_DEFAULT);
+}
+
+/* `fsngroup' may be NULL */
+int
+gfarm_replica_placement_of_fsngroup(const char *fsngroup)
+{
+	int policy;
+
+	if (fsngroup != NULL &&
+	    (policy = replica_placement_by_fsngroup_lookup(fsngroup)) !=
+	    GFARM_CONFIG_MISC_DEFAULT)
+		return (policy);
+	return (gfarm_replica_placement);
+}
+
+static gfarm_error_t
+parse_replica_placement(char *p, const char **op)
+{
+	gfarm_error_t e;
+	char *s, *fsngroup, *tmp;
+	struct replica_placement_by_fsngroup *r;
+	int i, policy;
+	const char *listname = *op;
+
+	if ((e = gfarm_strtoken(&p, &s)) != GFARM_ERR_NO_ERROR ||
+	    (e = gfarm_strtoken(&p, &fsngroup)) != GFARM_ERR_NO_ERROR ||
+	    (e = gfarm_strtoken(&p, &tmp)) != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_1005800,
+		    "parsing of %s arguments (%s) failed: %s",
+		    listname, p, gfarm_error_string(e));
+		return (e);
+	}
+	if (s == NULL)
+		return (GFARM_ERRMSG_MISSING_ARGUMENT);
+	if (tmp != NULL)
+		return (GFARM_ERRMSG_TOO_MANY_ARGUMENTS);
+	for (i = 0; i < GFARM_ARRAY_LENGTH(replica_placement_name_table);
+	    i++) {
+		if (strcmp(s, replica_placement_name_table[i].name) == 0)
+			break;
+	}
+	if (i >= GFARM_ARRAY_LENGTH(replica_placement_name_table)) {
+		*op = "1st (policy) argument";
+		gflog_debug(GFARM_MSG_1005801,
+		    "%s(%s): unknown policy", listname, s);
+		return (GFARM_ERR_INVALID_ARGUMENT);
+	}
+	policy = replica_placement_name_table[i].value;
+
+	if (fsngroup == NULL) {
+		/* first line has precedence */
+		if (gfarm_replica_placement == GFARM_CONFIG_MISC_DEFAULT)
+			gfarm_replica_placement = policy;
+		return (GFARM_ERR_NO_ERROR);
+	}
+	if (replica_placement_by_fsngroup_lookup(fsngroup) !=
+	    GFARM_CONFIG_MISC_DEFAULT)
+		return (GFARM_ERR_NO_ERROR); /* first line has precedence */
+	GFARM_REALLOC_ARRAY(r, replica_placement_by_fsngroup,
+	    replica_placement_by_fsngroup_num + 1);
+	if (r == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	replica_placement_by_fsngroup = r;
+	r = &replica_placement_by_fsngroup[replica_placement_by_fsngroup_num];
+	if ((r->fsngroup = strdup(fsngroup)) == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	r->policy = policy;
+	replica_placement_by_fsngroup_num++;
+	return (GFARM_ERR_NO_ERROR);
+}
+
 static gfarm_error_t
 parse_log_level(char *p, int *vp)
 {
@@ -3436,6 +3787,10 @@ parse_one_line(const char *s, char *p,
 		e = parse_set_misc_float(p, &gfarm_spool_base_load);
 	} else if (strcmp(s, o = "spool_digest_error_check") == 0) {
 		e = parse_set_misc_enabled(p, &gfarm_spool_digest_error_check);
+	} else if (strcmp(s, o = "spool_server_zerocopy") == 0) {
+		e = parse_set_misc_enabled(p, &gfarm_spool_server_zerocopy);
+	} else if (strcmp(s, o = "spool_server_worker_pool_size") == 0) {
+		e = parse_set_misc_int(p, &gfarm_spool_server_worker_pool_size);
 
 	} else if (strcmp(s, o = "write_verify") == 0) {
 		e = parse_set_misc_enabled(p, &gfarm_write_verify);
@@ -3568,6 +3923,11 @@ parse_one_line(const char *s, char *p,
 		    &gfarm_ctxp->tls_proxy_certificate);
 	} else if (strcmp(s, o = "tls_security_level") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->tls_security_level);
+	} else if (strcmp(s, o = "tls_session_resumption") == 0) {
+		e = parse_set_misc_enabled(p,
+		    &gfarm_ctxp->tls_session_resumption);
+	} else if (strcmp(s, o = "tls_ktls") == 0) {
+		e = parse_set_misc_enabled(p, &gfarm_ctxp->tls_ktls);
 
 	} else if (strcmp(s, o = "sasl_mechanisms") == 0) {
 		e = parse_set_var(p, &gfarm_ctxp->sasl_mechanisms);
@@ -3636,6 +3996,18 @@ parse_one_line(const char *s, char *p,
 		e = parse_set_misc_int(p, &gfarm_ctxp->attr_cache_limit);
 	} else if (strcmp(s, o = "attr_cache_timeout") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->attr_cache_timeout);
+	} else if (strcmp(s, o = "negative_cache_timeout") == 0) {
+		e = parse_set_misc_int(p, &gfarm_ctxp->negative_cache_timeout);
+	} else if (strcmp(s, o = "dir_cache_timeout") == 0) {
+		e = parse_set_misc_int(p, &gfarm_ctxp->dir_cache_timeout);
+	} else if (strcmp(s, o = "dir_cache_size") == 0) {
+		e = parse_set_misc_int(p, &gfarm_ctxp->dir_cache_size);
+	} else if (strcmp(s, o = "path_cache_timeout") == 0) {
+		e = parse_set_misc_int(p, &gfarm_ctxp->path_cache_timeout);
+	} else if (strcmp(s, o = "lookup_path_rpc") == 0) {
+		e = parse_set_misc_enabled(p, &gfarm_ctxp->lookup_path_rpc);
+	} else if (strcmp(s, o = "lstat_multi_rpc") == 0) {
+		e = parse_set_misc_enabled(p, &gfarm_ctxp->lstat_multi_rpc);
 	} else if (strcmp(s, o = "page_cache_timeout") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->page_cache_timeout);
 	} else if (strcmp(s, o = "schedule_rpc_timeout") == 0) {
@@ -3690,6 +4062,8 @@ parse_one_line(const char *s, char *p,
 		    &gfarm_simultaneous_replication_receivers);
 	} else if (strcmp(s, o = "replication_busy_host") == 0) {
 		e = parse_set_misc_enabled(p, &gfarm_replication_busy_host);
+	} else if (strcmp(s, o = "replica_placement") == 0) {
+		e = parse_replica_placement(p, &o);
 	} else if (strcmp(s, o = "gfsd_connection_cache") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->gfsd_connection_cache);
 	} else if (strcmp(s, o = "gfmd_connection_cache") == 0) {
@@ -3701,6 +4075,8 @@ parse_one_line(const char *s, char *p,
 			e = GFARM_ERR_VALUE_TOO_LARGE_TO_BE_STORED_IN_DATA_TYPE;
 			gfarm_xattr_size_limit = GFARM_CONFIG_MISC_DEFAULT;
 		}
+	} else if (strcmp(s, o = "xattr_index") == 0) {
+		e = parse_set_misc_enabled(p, &gfarm_xattr_index);
 	} else if (strcmp(s, o = "xmlattr_size_limit") == 0) {
 		e = parse_set_misc_int(p, &gfarm_xmlattr_size_limit);
 		if (e == GFARM_ERR_NO_ERROR &&
@@ -3757,6 +4133,8 @@ parse_one_line(const char *s, char *p,
 		e = parse_set_misc_int(p, &gfarm_metadb_failover_notify_delay);
 	} else if (strcmp(s, o = "metadb_server_dbq_size") == 0) {
 		e = parse_set_misc_int(p, &gfarm_metadb_dbq_size);
+	} else if (strcmp(s, o = "metadb_server_dbq_batch_size") == 0) {
+		e = parse_set_misc_int(p, &gfarm_metadb_dbq_batch_size);
 	} else if (strcmp(s, o = "metadb_server_back_channel_sndbuf_limit")
 	    == 0) {
 		e = parse_set_sockbuf_limit_int(p,
@@ -3768,6 +4146,14 @@ parse_one_line(const char *s, char *p,
 	} else if (strcmp(s, o = "metadb_server_long_term_lock_type") == 0) {
 		e = parse_set_misc_lock_type(p,
 		    &gfarm_metadb_server_long_term_lock_type);
+	} else if (strcmp(s, o = "metadb_server_thread_pool_type") == 0) {
+		e = parse_set_misc_thread_pool_type(p,
+		    &gfarm_metadb_server_thread_pool_type);
+	} else if (strcmp(s, o = "metadb_server_fair_share_key") == 0) {
+		e = parse_set_misc_fair_share_key(p,
+		    &gfarm_metadb_server_fair_share_key);
+	} else if (strcmp(s, o = "metadb_server_fair_share_weight") == 0) {
+		e = parse_fair_share_weight(p, &o);
 	} else if (strcmp(s, o = "metadb_replica_remover_by_host_sleep_time")
 	     == 0) {
 		e = parse_set_misc_int(p,
@@ -3791,6 +4177,12 @@ parse_one_line(const char *s, char *p,
 		    &gfarm_ctxp->client_digest_check);
 	} else if (strcmp(s, o = "client_file_bufsize") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->client_file_bufsize);
+	} else if (strcmp(s, o = "client_file_read_window") == 0) {
+		e = parse_set_misc_int(p,
+		    &gfarm_ctxp->client_file_read_window);
+	} else if (strcmp(s, o = "client_file_read_ahead_limit") == 0) {
+		e = parse_set_misc_int(p,
+		    &gfarm_ctxp->client_file_read_ahead_limit);
 	} else if (strcmp(s, o = "client_parallel_copy") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->client_parallel_copy);
 	} else if (strcmp(s, o = "client_parallel_max") == 0) {
@@ -3811,8 +4203,25 @@ parse_one_line(const char *s, char *p,
 		e = parse_set_misc_int(p, &journal_max_size);
 	} else if (strcmp(s, o = "metadb_journal_recvq_size") == 0) {
 		e = parse_set_misc_int(p, &journal_recvq_size);
+	} else if (strcmp(s, o = "metadb_journal_send_frame_size") == 0) {
+		e = parse_set_misc_int(p, &journal_send_frame_size);
+	} else if (strcmp(s, o = "metadb_journal_send_window") == 0) {
+		e = parse_set_misc_int(p, &journal_send_window);
+	} else if (strcmp(s, o = "metadb_journal_send_compression") == 0) {
+		e = parse_set_misc_enabled(p, &journal_send_compression);
+	} else if (strcmp(s, o = "metadb_snapshot_file") == 0) {
+		e = parse_set_var(p, &metadb_snapshot_file);
+	} else if (strcmp(s, o = "metadb_snapshot_interval") == 0) {
+		e = parse_set_misc_int(p, &metadb_snapshot_interval);
 	} else if (strcmp(s, o = "synchronous_journaling") == 0) {
 		e = parse_set_misc_enabled(p, &journal_sync_file);
+	} else if (strcmp(s, o = "synchronous_journaling_group_commit") == 0) {
+		e = parse_set_misc_enabled(p, &journal_sync_group_commit);
+	} else if (strcmp(s, o = "synchronous_journaling_max_delay") == 0) {
+		e = parse_set_misc_int(p, &journal_sync_max_delay);
+	} else if (strcmp(s, o = "synchronous_journaling_max_batch_size")
+	    == 0) {
+		e = parse_set_misc_int(p, &journal_sync_max_batch_size);
 	} else if (strcmp(s, o = "synchronous_replication_timeout") == 0) {
 		e = parse_set_misc_int(p, &journal_sync_slave_timeout);
 	} else if (strcmp(s, o = "metadb_server_slave_replication_timeout")
@@ -3877,6 +4286,8 @@ parse_one_line(const char *s, char *p,
 	} else if (strcmp(s, o = "replica_check_minimum_interval") == 0) {
 		e = parse_set_misc_int(
 		    p, &gfarm_replica_check_minimum_interval);
+	} else if (strcmp(s, o = "replica_check_scan_budget") == 0) {
+		e = parse_set_misc_int(p, &gfarm_replica_check_scan_budget);
 	} else if (strcmp(s, o = "replicainfo") == 0) {
 		e = parse_set_misc_enabled(p, &gfarm_replicainfo_enabled);
 	} else {
@@ -4013,6 +4424,12 @@ gfarm_config_set_default_misc(void)
 	if (gfarm_spool_digest_error_check == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_spool_digest_error_check =
 		    GFARM_SPOOL_DIGEST_ERROR_CHECK_DEFAULT;
+	if (gfarm_spool_server_zerocopy == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_spool_server_zerocopy =
+		    GFARM_SPOOL_SERVER_ZEROCOPY_DEFAULT;
+	if (gfarm_spool_server_worker_pool_size == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_spool_server_worker_pool_size =
+		    GFARM_SPOOL_SERVER_WORKER_POOL_SIZE_DEFAULT;
 	if (gfarm_write_verify == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_write_verify = GFARM_WRITE_VERIFY_DEFAULT;
 	if (gfarm_write_verify_interval == GFARM_CONFIG_MISC_DEFAULT)
@@ -4066,6 +4483,11 @@ gfarm_config_set_default_misc(void)
 		gfarm_ctxp->tls_proxy_certificate =
 		    GFARM_TLS_PROXY_CERTIFICATE_DEFAULT;
 	/* default value of gfarm_ctxp->tls_security_level is "NOT SET" */
+	if (gfarm_ctxp->tls_session_resumption == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->tls_session_resumption =
+		    GFARM_TLS_SESSION_RESUMPTION_DEFAULT;
+	if (gfarm_ctxp->tls_ktls == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->tls_ktls = GFARM_TLS_KTLS_DEFAULT;
 
 	if (gfarm_ctxp->log_level == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->log_level = GFARM_DEFAULT_PRIORITY_LEVEL_TO_LOG;
@@ -4094,6 +4516,21 @@ gfarm_config_set_default_misc(void)
 	if (gfarm_ctxp->attr_cache_timeout == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->attr_cache_timeout =
 		    GFARM_ATTR_CACHE_TIMEOUT_DEFAULT;
+	if (gfarm_ctxp->negative_cache_timeout == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->negative_cache_timeout =
+		    GFARM_NEGATIVE_CACHE_TIMEOUT_DEFAULT;
+	if (gfarm_ctxp->dir_cache_timeout == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->dir_cache_timeout =
+		    GFARM_DIR_CACHE_TIMEOUT_DEFAULT;
+	if (gfarm_ctxp->dir_cache_size == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->dir_cache_size = GFARM_DIR_CACHE_SIZE_DEFAULT;
+	if (gfarm_ctxp->path_cache_timeout == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->path_cache_timeout =
+		    GFARM_PATH_CACHE_TIMEOUT_DEFAULT;
+	if (gfarm_ctxp->lookup_path_rpc == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->lookup_path_rpc = GFARM_LOOKUP_PATH_RPC_DEFAULT;
+	if (gfarm_ctxp->lstat_multi_rpc == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->lstat_multi_rpc = GFARM_LSTAT_MULTI_RPC_DEFAULT;
 	if (gfarm_ctxp->page_cache_timeout == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->page_cache_timeout =
 		    GFARM_PAGE_CACHE_TIMEOUT_DEFAULT;
@@ -4160,6 +4597,10 @@ gfarm_config_set_default_misc(void)
 		gfarm_xattr_size_limit = GFARM_XATTR_SIZE_MAX_DEFAULT;
 	if (gfarm_xmlattr_size_limit == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_xmlattr_size_limit = GFARM_XMLATTR_SIZE_MAX_DEFAULT;
+	if (gfarm_xattr_index == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_xattr_index = GFARM_XATTR_INDEX_DEFAULT;
+	if (gfarm_replica_placement == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_replica_placement = GFARM_REPLICA_PLACEMENT_DEFAULT;
 	if (gfarm_directory_quota_count_per_user_limit
 	    == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_directory_quota_count_per_user_limit =
@@ -4206,6 +4647,9 @@ gfarm_config_set_default_misc(void)
 		    GFARM_METADB_REMOVE_SCAN_INTERVAL_FACTOR_DEFAULT;
 	if (gfarm_metadb_dbq_size == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_metadb_dbq_size = GFARM_METADB_DBQ_SIZE_DEFAULT;
+	if (gfarm_metadb_dbq_batch_size == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_metadb_dbq_batch_size =
+		    GFARM_METADB_DBQ_BATCH_SIZE_DEFAULT;
 	if (gfarm_metadb_replica_remover_by_host_sleep_time
 	    == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_metadb_replica_remover_by_host_sleep_time =
@@ -4224,6 +4668,13 @@ gfarm_config_set_default_misc(void)
 	if (gfarm_ctxp->client_file_bufsize == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->client_file_bufsize =
 		    GFARM_CLIENT_FILE_BUFSIZE_DEFAULT;
+	if (gfarm_ctxp->client_file_read_window == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->client_file_read_window =
+		    GFARM_CLIENT_FILE_READ_WINDOW_DEFAULT;
+	if (gfarm_ctxp->client_file_read_ahead_limit ==
+	    GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->client_file_read_ahead_limit =
+		    GFARM_CLIENT_FILE_READ_AHEAD_LIMIT_DEFAULT;
 	if (gfarm_ctxp->client_parallel_copy == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->client_parallel_copy =
 		    GFARM_CLIENT_PARALLEL_COPY_DEFAULT;
@@ -4239,8 +4690,27 @@ gfarm_config_set_default_misc(void)
 		journal_max_size = GFARM_JOURNAL_MAX_SIZE_DEFAULT;
 	if (journal_recvq_size == GFARM_CONFIG_MISC_DEFAULT)
 		journal_recvq_size = GFARM_JOURNAL_RECVQ_SIZE_DEFAULT;
+	if (metadb_snapshot_interval == GFARM_CONFIG_MISC_DEFAULT)
+		metadb_snapshot_interval =
+		    GFARM_METADB_SNAPSHOT_INTERVAL_DEFAULT;
+	if (journal_send_frame_size == GFARM_CONFIG_MISC_DEFAULT)
+		journal_send_frame_size =
+		    GFARM_JOURNAL_SEND_FRAME_SIZE_DEFAULT;
+	if (journal_send_window == GFARM_CONFIG_MISC_DEFAULT)
+		journal_send_window = GFARM_JOURNAL_SEND_WINDOW_DEFAULT;
+	if (journal_send_compression == GFARM_CONFIG_MISC_DEFAULT)
+		journal_send_compression =
+		    GFARM_JOURNAL_SEND_COMPRESSION_DEFAULT;
 	if (journal_sync_file == GFARM_CONFIG_MISC_DEFAULT)
 		journal_sync_file = GFARM_JOURNAL_SYNC_FILE_DEFAULT;
+	if (journal_sync_group_commit == GFARM_CONFIG_MISC_DEFAULT)
+		journal_sync_group_commit =
+		    GFARM_JOURNAL_SYNC_GROUP_COMMIT_DEFAULT;
+	if (journal_sync_max_delay == GFARM_CONFIG_MISC_DEFAULT)
+		journal_sync_max_delay = GFARM_JOURNAL_SYNC_MAX_DELAY_DEFAULT;
+	if (journal_sync_max_batch_size == GFARM_CONFIG_MISC_DEFAULT)
+		journal_sync_max_batch_size =
+		    GFARM_JOURNAL_SYNC_MAX_BATCH_SIZE_DEFAULT;
 	if (journal_sync_slave_timeout == GFARM_CONFIG_MISC_DEFAULT)
 		journal_sync_slave_timeout =
 		    GFARM_JOURNAL_SYNC_SLAVE_TIMEOUT_DEFAULT;
@@ -4265,6 +4735,13 @@ gfarm_config_set_default_misc(void)
 	    == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_metadb_server_long_term_lock_type =
 		    GFARM_METADB_SERVER_LONG_TERM_LOCK_TYPE_DEFAULT;
+	if (gfarm_metadb_server_thread_pool_type
+	    == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_metadb_server_thread_pool_type =
+		    GFARM_METADB_SERVER_THREAD_POOL_TYPE_DEFAULT;
+	if (gfarm_metadb_server_fair_share_key == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_metadb_server_fair_share_key =
+		    GFARM_METADB_SERVER_FAIR_SHARE_KEY_DEFAULT;
 	if (gfarm_ctxp->network_receive_timeout == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->network_receive_timeout =
 		    GFARM_NETWORK_RECEIVE_TIMEOUT_DEFAULT;
@@ -4316,6 +4793,9 @@ gfarm_config_set_default_misc(void)
 	if (gfarm_replica_check_minimum_interval == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_replica_check_minimum_interval =
 		    GFARM_REPLICA_CHECK_MINIMUM_INTERVAL_DEFAULT;
+	if (gfarm_replica_check_scan_budget == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_replica_check_scan_budget =
+		    GFARM_REPLICA_CHECK_SCAN_BUDGET_DEFAULT;
 
 	if (gfarm_iostat_max_client == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_iostat_max_client = GFARM_IOSTAT_MAX_CLIENT;
@@ -4840,6 +5320,13 @@ static const struct gfarm_config_type config_types[] = {
 	{ "client_file_bufsize",
 	  FOR_CLIENT, CLIENT_PARSE, INT_POSITIVE,
 	  NULL, offsetof(struct gfarm_context, client_file_bufsize) },
+	{ "client_file_read_window",
+	  FOR_CLIENT, CLIENT_PARSE, INT_POSITIVE,
+	  NULL, offsetof(struct gfarm_context, client_file_read_window) },
+	{ "client_file_read_ahead_limit",
+	  FOR_CLIENT, CLIENT_PARSE, INT_NON_NEGATIVE,
+	  NULL, offsetof(struct gfarm_context,
+	  client_file_read_ahead_limit) },
 	{ "max_open_files",
 	  FOR_METADB, CLIENT_PARSE, INT_POSITIVE,
 	  &gfarm_max_open_files, 0 },
@@ -4896,6 +5383,9 @@ static const struct gfarm_config_type config_types[] = {
 	{ "replica_check_minimum_interval",
 	  FOR_METADB, CLIENT_PARSE, INT_NON_NEGATIVE,
 	  &gfarm_replica_check_minimum_interval, 0 },
+	{ "replica_check_scan_budget",
+	  FOR_METADB, CLIENT_PARSE, INT_NON_NEGATIVE,
+	  &gfarm_replica_check_scan_budget, 0 },
 	{ "replication_busy_host",
 	  FOR_METADB, CLIENT_PARSE, TYPE_ENABLED,
 	  &gfarm_replication_busy_host, 0 },
@@ -5351,6 +5841,7 @@ gfs_display_timers(void)
 	gfs_pio_local_display_timers();
 	gfs_pio_remote_display_timers();
 	gfs_stat_display_timers();
+	gfs_dircache_display_timers();
 	gfs_unlink_display_timers();
 	gfs_xattr_display_timers();
 #endif /* __KERNEL__ */
@@ -5377,6 +5868,9 @@ gfarm_config_profile_value(const char *name, char *value, size_t *sizep)
 	else if ((err = gfs_stat_profile_value(name, value, sizep)) ==
 	    GFARM_ERR_NO_ERROR)
 		;
+	else if ((err = gfs_dircache_profile_value(name, value, sizep)) ==
+	    GFARM_ERR_NO_ERROR)
+		;
 	else if ((err = gfs_unlink_profile_value(name, value, sizep)) ==
 	    GFARM_ERR_NO_ERROR)
 		;
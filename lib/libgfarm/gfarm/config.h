@@ -35,6 +35,8 @@ extern int gfarm_spool_check_parallel_step;
 extern gfarm_off_t gfarm_spool_check_parallel_per_capacity;
 extern float gfarm_spool_base_load;
 extern int gfarm_spool_digest_error_check;
+extern int gfarm_spool_server_zerocopy;
+extern int gfarm_spool_server_worker_pool_size;
 extern int gfarm_write_verify;
 extern int gfarm_write_verify_interval;
 extern int gfarm_write_verify_retry_interval;
@@ -93,9 +95,12 @@ extern enum gfarm_db_access_type gfarm_db_access_type;
 #define GFARM_TLS_KEY_UPDATE_DEFAULT		1	/* enable */
 #define GFARM_TLS_BUILD_CHAIN_LOCAL_DEFAULT	0	/* disable */
 #define GFARM_TLS_ALLOW_NO_CRL_DEFAULT		1	/* enable */
+#define GFARM_TLS_SESSION_RESUMPTION_DEFAULT	1	/* enable */
+#define GFARM_TLS_KTLS_DEFAULT			0	/* disable */
 
 extern int gfarm_xattr_size_limit;
 extern int gfarm_xmlattr_size_limit;
+extern int gfarm_xattr_index;
 extern int gfarm_directory_quota_count_per_user_limit;
 extern int gfarm_directory_quota_check_start_delay;
 extern int gfarm_directory_quota_check_retry_interval;
@@ -115,6 +120,7 @@ extern int gfarm_metadb_remove_scan_interval_factor;
 extern int gfarm_metadb_heartbeat_interval;
 extern int gfarm_metadb_failover_notify_delay;
 extern int gfarm_metadb_dbq_size;
+extern int gfarm_metadb_dbq_batch_size;
 extern int gfarm_metadb_server_back_channel_sndbuf_limit;
 extern int gfarm_metadb_server_nfs_root_squash_support;
 
@@ -122,10 +128,27 @@ enum gfarm_lock_type {
 	GFARM_LOCK_TYPE_MUTEX,
 	GFARM_LOCK_TYPE_TICKETLOCK,
 	GFARM_LOCK_TYPE_QUEUELOCK,
+	GFARM_LOCK_TYPE_RWQUEUELOCK,
 	GFARM_LOCK_TYPE_LIMIT
 };
 extern int gfarm_metadb_server_long_term_lock_type;
 
+enum gfarm_thread_pool_type {
+	GFARM_THREAD_POOL_TYPE_MUTEX,
+	GFARM_THREAD_POOL_TYPE_WORK_STEALING,
+	GFARM_THREAD_POOL_TYPE_LIMIT
+};
+extern int gfarm_metadb_server_thread_pool_type;
+
+enum gfarm_fair_share_key {
+	GFARM_FAIR_SHARE_KEY_NONE,
+	GFARM_FAIR_SHARE_KEY_USER,
+	GFARM_FAIR_SHARE_KEY_TENANT,
+	GFARM_FAIR_SHARE_KEY_LIMIT
+};
+extern int gfarm_metadb_server_fair_share_key;
+void gfarm_metadb_server_fair_share_weight_of(const char *, int *, int *);
+
 extern int gfarm_metadb_replica_remover_by_host_sleep_time;
 extern int gfarm_metadb_replica_remover_by_host_inode_step;
 extern int gfarm_replica_check;
@@ -137,6 +160,7 @@ extern int gfarm_replica_check_host_down_thresh;
 extern int gfarm_replica_check_sleep_time;
 extern int gfarm_replica_check_yield_time;
 extern int gfarm_replica_check_minimum_interval;
+extern int gfarm_replica_check_scan_budget;
 extern int gfarm_replicainfo_enabled;
 #define GFARM_METADB_STACK_SIZE_DEFAULT 0 /* use OS default */
 #define GFARM_METADB_THREAD_POOL_SIZE_DEFAULT	16  /* quadcore, quadsocket */
@@ -152,6 +176,7 @@ extern int gfarm_replicainfo_enabled;
 #define GFARM_METADB_HEARTBEAT_INTERVAL_DEFAULT 180 /* 3 min */
 #define GFARM_METADB_FAILOVER_NOTIFY_DELAY_DEFAULT 0 /* 0 second (no delay) */
 #define GFARM_METADB_DBQ_SIZE_DEFAULT	65536
+#define GFARM_METADB_DBQ_BATCH_SIZE_DEFAULT	64
 #define GFARM_SYMLINK_LEVEL_MAX			20
 
 /* LDAP dependent */
@@ -190,6 +215,13 @@ extern int gfarm_read_only;
 extern int gfarm_simultaneous_replication_receivers;
 extern int gfarm_replication_busy_host;
 
+/* replica placement policies, see the "replica_placement" directive */
+#define GFARM_REPLICA_PLACEMENT_RANDOM		0
+#define GFARM_REPLICA_PLACEMENT_WEIGHTED	1
+#define GFARM_REPLICA_PLACEMENT_TWO_CHOICES	2
+extern int gfarm_replica_placement;
+int gfarm_replica_placement_of_fsngroup(const char *);
+
 char *gfarm_alloc_name_in_tenant(const char *);
 
 gfarm_error_t gfarm_get_global_username_by_host_for_connection_cache(
@@ -207,8 +239,16 @@ int gfarm_get_metadb_replication_enabled(void);
 void gfarm_set_metadb_replication_enabled(int);
 const char *gfarm_get_journal_dir(void);
 int gfarm_get_journal_max_size(void);
+const char *gfarm_get_metadb_snapshot_file(void);
+int gfarm_get_metadb_snapshot_interval(void);
 int gfarm_get_journal_recvq_size(void);
+int gfarm_get_journal_send_frame_size(void);
+int gfarm_get_journal_send_window(void);
+int gfarm_get_journal_send_compression(void);
 int gfarm_get_journal_sync_file(void);
+int gfarm_get_journal_sync_group_commit(void);
+int gfarm_get_journal_sync_max_delay(void);
+int gfarm_get_journal_sync_max_batch_size(void);
 int gfarm_get_journal_sync_slave_timeout(void);
 int gfarm_get_metadb_server_slave_replication_timeout(void);
 int gfarm_get_metadb_server_slave_max_size(void);
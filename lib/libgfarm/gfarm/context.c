@@ -157,6 +157,12 @@ gfarm_context_init(void)
 	ctxp->gfsd_connection_timeout = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->attr_cache_limit = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->attr_cache_timeout = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->negative_cache_timeout = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->dir_cache_timeout = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->dir_cache_size = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->path_cache_timeout = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->lookup_path_rpc = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->lstat_multi_rpc = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->page_cache_timeout = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->schedule_rpc_timeout = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->schedule_cache_timeout = GFARM_CONFIG_MISC_DEFAULT;
@@ -176,6 +182,8 @@ gfarm_context_init(void)
 	ctxp->gfmd_connection_cache = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->client_digest_check = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->client_file_bufsize = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->client_file_read_window = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->client_file_read_ahead_limit = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->client_parallel_copy = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->client_parallel_max = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->network_receive_timeout = GFARM_CONFIG_MISC_DEFAULT;
@@ -203,6 +211,8 @@ gfarm_context_init(void)
 	ctxp->tls_allow_no_crl = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->tls_proxy_certificate = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->tls_security_level = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->tls_session_resumption = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->tls_ktls = GFARM_CONFIG_MISC_DEFAULT;
 
 	ctxp->sasl_mechanisms = NULL;
 	ctxp->sasl_realm = NULL;
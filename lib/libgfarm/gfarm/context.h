@@ -15,6 +15,12 @@ struct gfarm_context {
 	int gfsd_connection_timeout;
 	int attr_cache_limit;
 	int attr_cache_timeout;
+	int negative_cache_timeout;
+	int dir_cache_timeout;
+	int dir_cache_size;
+	int path_cache_timeout;
+	int lookup_path_rpc; /* boolean */
+	int lstat_multi_rpc; /* boolean */
 	int page_cache_timeout;
 	int schedule_rpc_timeout;
 	int schedule_cache_timeout;
@@ -34,6 +40,8 @@ struct gfarm_context {
 	int gfsd_connection_cache;
 	int client_digest_check;
 	int client_file_bufsize;
+	int client_file_read_window;
+	int client_file_read_ahead_limit;
 	int client_parallel_copy;
 	int client_parallel_max;
 	int on_demand_replication;
@@ -103,6 +111,8 @@ struct gfarm_context {
 	int tls_allow_no_crl; /* boolean */
 	int tls_proxy_certificate; /* boolean */
 	int tls_security_level;
+	int tls_session_resumption; /* boolean */
+	int tls_ktls; /* boolean */
 
 	/* auth sasl* */
 	char *sasl_mechanisms;
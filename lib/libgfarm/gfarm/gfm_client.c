@@ -2401,6 +2401,64 @@ gfm_client_fhopen_result(struct gfm_connection *gfm_server,
 	return (gfm_client_rpc_result(gfm_server, 0, "i", modep));
 }
 
+/* the first `ncached' components of `path' are the directory inum:gen */
+gfarm_error_t
+gfm_client_lookup_path_request(struct gfm_connection *gfm_server,
+	const char *path, size_t len, int ncached,
+	gfarm_ino_t inum, gfarm_uint64_t gen)
+{
+	return (gfm_client_rpc_request(gfm_server, GFM_PROTO_LOOKUP_PATH,
+	    "Sill", path, len, ncached, inum, gen));
+}
+
+/*
+ * `ncomponents' is the number of the components sent.
+ * *firstp is the index of the component which inums[0] corresponds to.
+ */
+gfarm_error_t
+gfm_client_lookup_path_result(struct gfm_connection *gfm_server,
+	int ncomponents, int *firstp, int *np,
+	gfarm_ino_t *inums, gfarm_uint64_t *gens, gfarm_mode_t *modes)
+{
+	gfarm_error_t e;
+	int eof, i;
+	gfarm_int32_t first, n;
+	gfarm_ino_t inum;
+	gfarm_uint64_t gen;
+	gfarm_mode_t mode;
+
+	e = gfm_client_rpc_result(gfm_server, 0, "ii", &first, &n);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (first < 0 || n < 0 || first + n > ncomponents) {
+		gflog_debug(GFARM_MSG_1005795,
+		    "lookup_path: %d+%d components are returned for %d",
+		    (int)first, (int)n, ncomponents);
+		return (GFARM_ERR_PROTOCOL);
+	}
+	for (i = 0; i < n; i++) {
+		e = gfm_client_xdr_recv(gfm_server, 0, &eof, "lli",
+		    &inum, &gen, &mode);
+		if (e != GFARM_ERR_NO_ERROR || eof) {
+			if (e == GFARM_ERR_NO_ERROR)
+				e = GFARM_ERR_PROTOCOL;
+			gflog_debug(GFARM_MSG_1005796,
+			    "receiving lookup_path response failed: %s",
+			    gfarm_error_string(e));
+			return (e);
+		}
+		/* the components are discarded, if the arrays are NULL */
+		if (inums != NULL) {
+			inums[i] = inum;
+			gens[i] = gen;
+			modes[i] = mode;
+		}
+	}
+	*firstp = first;
+	*np = n;
+	return (GFARM_ERR_NO_ERROR);
+}
+
 gfarm_error_t
 gfm_client_close_request(struct gfm_connection *gfm_server)
 {
@@ -3009,6 +3067,80 @@ gfm_client_getdirentsplus_result(struct gfm_connection *gfm_server,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+gfarm_error_t
+gfm_client_lstat_multi_request(struct gfm_connection *gfm_server,
+	int npaths, const char **paths)
+{
+	gfarm_error_t e;
+	int i;
+
+	if ((e = gfm_client_rpc_request(gfm_server,
+	    GFM_PROTO_LSTAT_MULTI, "i", npaths)) != GFARM_ERR_NO_ERROR)
+		return (e);
+	for (i = 0; i < npaths; i++) {
+		e = gfm_client_xdr_send(gfm_server, "s", paths[i]);
+		if (e != GFARM_ERR_NO_ERROR)
+			return (e);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* errs[i] is set for each path, and stv[i] is valid only if it's no error */
+gfarm_error_t
+gfm_client_lstat_multi_result(struct gfm_connection *gfm_server,
+	int npaths, struct gfs_stat *stv, gfarm_error_t *errs)
+{
+	gfarm_error_t e;
+	int eof, i;
+	gfarm_int32_t n, err;
+
+	e = gfm_client_rpc_result(gfm_server, 0, "i", &n);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_1005766,
+		    "gfm_client_rpc_result() failed: %s",
+		    gfarm_error_string(e));
+		return (e);
+	}
+	if (n != npaths) {
+		gflog_debug(GFARM_MSG_1005767,
+		    "lstat_multi: %d entries are returned for %d",
+		    (int)n, npaths);
+		return (GFARM_ERR_PROTOCOL);
+	}
+	for (i = 0; i < n; i++) {
+		struct gfs_stat *st = &stv[i];
+
+		e = gfm_client_xdr_recv(gfm_server, 0, &eof, "i", &err);
+		if (e == GFARM_ERR_NO_ERROR && !eof &&
+		    err == GFARM_ERR_NO_ERROR)
+			e = gfm_client_xdr_recv(gfm_server, 0, &eof,
+			    "llilsslllilili",
+			    &st->st_ino, &st->st_gen, &st->st_mode,
+			    &st->st_nlink, &st->st_user, &st->st_group,
+			    &st->st_size, &st->st_ncopy,
+			    &st->st_atimespec.tv_sec,
+			    &st->st_atimespec.tv_nsec,
+			    &st->st_mtimespec.tv_sec,
+			    &st->st_mtimespec.tv_nsec,
+			    &st->st_ctimespec.tv_sec,
+			    &st->st_ctimespec.tv_nsec);
+		if (e != GFARM_ERR_NO_ERROR || eof) {
+			if (e == GFARM_ERR_NO_ERROR)
+				e = GFARM_ERR_PROTOCOL;
+			gflog_debug(GFARM_MSG_1005768,
+			    "receiving lstat_multi response failed: %s",
+			    gfarm_error_string(e));
+			for (--i; i >= 0; --i) {
+				if (errs[i] == GFARM_ERR_NO_ERROR)
+					gfs_stat_free(&stv[i]);
+			}
+			return (e);
+		}
+		errs[i] = err;
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
 gfarm_error_t
 gfm_client_getdirentsplusxattr_request(struct gfm_connection *gfm_server,
 	gfarm_int32_t n_entries, char **patterns, int npatterns)
@@ -3717,6 +3849,58 @@ gfm_client_findxmlattr_result(struct gfm_connection *gfm_server,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+/* if value is NULL, inodes which have the attribute with any value match */
+gfarm_error_t
+gfm_client_findxattr_request(struct gfm_connection *gfm_server,
+		int xmlMode, const char *name, const void *value, size_t size,
+		gfarm_ino_t cookie, int nalloc)
+{
+	return (gfm_client_rpc_request(gfm_server, GFM_PROTO_XATTR_FIND,
+			"isibli", xmlMode, name, value != NULL,
+			value != NULL ? size : 0, value, cookie, nalloc));
+}
+
+/*
+ * inums and gens must have the room for nalloc entries.
+ * pass *next_cookiep as the cookie of the next request, unless *eofp.
+ */
+gfarm_error_t
+gfm_client_findxattr_result(struct gfm_connection *gfm_server, int nalloc,
+		int *eofp, int *np, gfarm_ino_t *next_cookiep,
+		gfarm_ino_t *inums, gfarm_uint64_t *gens)
+{
+	gfarm_error_t e;
+	int i, eof;
+
+	e = gfm_client_rpc_result(gfm_server, 0, "iil",
+			eofp, np, next_cookiep);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_1005756,
+			"gfm_client_rpc_result() failed: %s",
+			gfarm_error_string(e));
+		return (e);
+	}
+	if (*np < 0 || *np > nalloc) {
+		gflog_debug(GFARM_MSG_1005757,
+			"findxattr: %d entries are returned for %d",
+			*np, nalloc);
+		return (GFARM_ERR_PROTOCOL);
+	}
+	for (i = 0; i < *np; i++) {
+		e = gfm_client_xdr_recv(gfm_server, 0, &eof, "ll",
+			&inums[i], &gens[i]);
+		if (e != GFARM_ERR_NO_ERROR || eof) {
+			if (e == GFARM_ERR_NO_ERROR)
+				e = GFARM_ERR_PROTOCOL;
+			gflog_debug(GFARM_MSG_1005758,
+				"receiving findxattr entries failed: %s",
+				gfarm_error_string(e));
+			return (e);
+		}
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
 /*
  * gfs from gfsd
  */
@@ -4811,7 +4995,12 @@ gfm_client_process_alloc_child(struct gfm_connection *gfm_server,
 gfarm_error_t
 gfm_client_process_free(struct gfm_connection *gfm_server)
 {
-	return (gfm_client_rpc(gfm_server, 0, GFM_PROTO_PROCESS_FREE, "/"));
+	gfarm_error_t e;
+
+	e = gfm_client_rpc(gfm_server, 0, GFM_PROTO_PROCESS_FREE, "/");
+	if (e == GFARM_ERR_NO_ERROR)
+		gfm_server->pid = 0;
+	return (e);
 }
 
 #ifndef __KERNEL__	/* gfsd only */
@@ -192,6 +192,10 @@ gfarm_error_t gfm_client_open_parent_result(struct gfm_connection *);
 gfarm_error_t gfm_client_fhopen_request(struct gfm_connection *,
 	gfarm_ino_t, gfarm_uint64_t, gfarm_uint32_t);
 gfarm_error_t gfm_client_fhopen_result(struct gfm_connection *, gfarm_mode_t *);
+gfarm_error_t gfm_client_lookup_path_request(struct gfm_connection *,
+	const char *, size_t, int, gfarm_ino_t, gfarm_uint64_t);
+gfarm_error_t gfm_client_lookup_path_result(struct gfm_connection *,
+	int, int *, int *, gfarm_ino_t *, gfarm_uint64_t *, gfarm_mode_t *);
 gfarm_error_t gfm_client_close_request(struct gfm_connection *);
 gfarm_error_t gfm_client_close_result(struct gfm_connection *);
 gfarm_error_t gfm_client_close_getgen_request(struct gfm_connection *);
@@ -318,6 +322,10 @@ gfarm_error_t gfm_client_getdirentsplus_request(struct gfm_connection *,
 	gfarm_int32_t);
 gfarm_error_t gfm_client_getdirentsplus_result(struct gfm_connection *,
 	int *, struct gfs_dirent *, struct gfs_stat *);
+gfarm_error_t gfm_client_lstat_multi_request(struct gfm_connection *,
+	int, const char **);
+gfarm_error_t gfm_client_lstat_multi_result(struct gfm_connection *,
+	int, struct gfs_stat *, gfarm_error_t *);
 gfarm_error_t gfm_client_getdirentsplusxattr_request(struct gfm_connection *,
 	gfarm_int32_t, char **, int);
 gfarm_error_t gfm_client_getdirentsplusxattr_result(struct gfm_connection *,
@@ -359,6 +367,10 @@ gfarm_error_t gfm_client_findxmlattr_request(struct gfm_connection *,
 		struct gfs_xmlattr_ctx *ctxp);
 gfarm_error_t gfm_client_findxmlattr_result(struct gfm_connection *,
 		struct gfs_xmlattr_ctx *ctxp);
+gfarm_error_t gfm_client_findxattr_request(struct gfm_connection *,
+		int, const char *, const void *, size_t, gfarm_ino_t, int);
+gfarm_error_t gfm_client_findxattr_result(struct gfm_connection *, int,
+		int *, int *, gfarm_ino_t *, gfarm_ino_t *, gfarm_uint64_t *);
 
 gfarm_error_t gfm_client_quota_user_get(struct gfm_connection *, const char *,
 					struct gfarm_quota_get_info *);
@@ -28,6 +28,18 @@
 
 #define GFM_INTER_GFMD_PROTOCOL_VERSION	GFM_PROTOCOL_VERSION_V2_5_0
 
+/*
+ * features which a slave gfmd accepts.
+ * these are ORed to the version of GFM_PROTO_SWITCH_GFMD_CHANNEL.
+ */
+#define GFM_INTER_GFMD_PROTOCOL_VERSION_MASK	0x0000ffff
+#define GFM_INTER_GFMD_FEATURE_JOURNAL_PACKED	0x00010000
+#define GFM_INTER_GFMD_FEATURE_JOURNAL_ZLIB	0x00020000
+
+/* GFM_PROTO_JOURNAL_SEND_PACKED: codec */
+#define GFM_PROTO_JOURNAL_CODEC_NONE		0
+#define GFM_PROTO_JOURNAL_CODEC_ZLIB		1
+
 enum gfm_proto_command {
 	/* host/user/group metadata */
 
@@ -163,8 +175,8 @@ enum gfm_proto_command {
 	GFM_PROTO_SEEK,
 	GFM_PROTO_GETDIRENTSPLUS,
 	GFM_PROTO_GETDIRENTSPLUSXATTR,		/* since gfarm-2.4.1 */
-	GFM_PROTO_DIR_OP_RESERVE11,
-	GFM_PROTO_DIR_OP_RESERVE12,
+	GFM_PROTO_LSTAT_MULTI,			/* since gfarm-2.8.4 */
+	GFM_PROTO_LOOKUP_PATH,			/* since gfarm-2.8.4 */
 	GFM_PROTO_DIR_OP_RESERVE13,
 	GFM_PROTO_DIR_OP_RESERVE14,
 	GFM_PROTO_DIR_OP_RESERVE15,
@@ -330,7 +342,7 @@ enum gfm_proto_command {
 	GFM_PROTO_XATTR_LIST,
 	GFM_PROTO_XMLATTR_LIST,
 	GFM_PROTO_XMLATTR_FIND,
-	GFM_PROTO_XATTR_OP_RESERVE9,
+	GFM_PROTO_XATTR_FIND,			/* since gfarm-2.8.4 */
 	GFM_PROTO_XATTR_OP_RESERVE10,
 	GFM_PROTO_XATTR_OP_RESERVE11,
 	GFM_PROTO_XATTR_OP_RESERVE12,
@@ -343,7 +355,7 @@ enum gfm_proto_command {
 	GFM_PROTO_SWITCH_GFMD_CHANNEL,		/* since gfarm-2.5.0 */
 	GFM_PROTO_JOURNAL_READY_TO_RECV,	/* since gfarm-2.5.0 */
 	GFM_PROTO_JOURNAL_SEND,			/* since gfarm-2.5.0 */
-	GFM_PROTO_REDUNDANCY_RESERVE3,
+	GFM_PROTO_JOURNAL_SEND_PACKED,		/* since gfarm-2.8.4 */
 	GFM_PROTO_REDUNDANCY_RESERVE4,
 	GFM_PROTO_REDUNDANCY_RESERVE5,
 	GFM_PROTO_REDUNDANCY_RESERVE6,
@@ -458,6 +470,7 @@ enum gfm_proto_command {
 #define GFM_PROTO_CKSUM_MAXLEN			256
 
 #define GFM_PROTO_MAX_DIRENT	10240
+#define GFM_PROTO_MAX_LSTAT_MULTI	1024
 
 #define GFARM_HOST_NAME_MAX			256
 #define GFARM_HOST_ARCHITECTURE_NAME_MAX	128
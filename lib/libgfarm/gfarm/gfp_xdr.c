@@ -149,6 +149,19 @@ gfp_xdr_fd(struct gfp_xdr *conn)
 	return (conn->fd);
 }
 
+struct gfp_iobuffer_ops *
+gfp_xdr_iobuffer_ops(struct gfp_xdr *conn)
+{
+	return (conn->iob_ops);
+}
+
+/* number of bytes which are already received, but not consumed yet */
+int
+gfp_xdr_recv_buffered_length(struct gfp_xdr *conn)
+{
+	return (gfarm_iobuffer_avail_length(conn->recvbuffer));
+}
+
 gfarm_error_t
 gfp_xdr_sendbuffer_check_size(struct gfp_xdr *conn, int size)
 {
@@ -40,6 +40,8 @@ gfarm_error_t gfp_xdr_free(struct gfp_xdr *);
 
 void *gfp_xdr_cookie(struct gfp_xdr *);
 int gfp_xdr_fd(struct gfp_xdr *);
+struct gfp_iobuffer_ops *gfp_xdr_iobuffer_ops(struct gfp_xdr *);
+int gfp_xdr_recv_buffered_length(struct gfp_xdr *);
 int gfp_xdr_read_fd(struct gfp_xdr *);
 gfarm_error_t gfp_xdr_sendbuffer_check_size(struct gfp_xdr *, int);
 void gfp_xdr_recvbuffer_clear_read_eof(struct gfp_xdr *);
@@ -120,6 +122,23 @@ gfarm_error_t gfp_xdr_vsend_async_request_notimeout(struct gfp_xdr *,
 gfarm_error_t gfp_xdr_recv_async_header(struct gfp_xdr *, int,
 	enum gfp_xdr_msg_type *, gfp_xdr_xid_t *, size_t *);
 
+/*
+ * a list of items is sent as "i" (the number of items),
+ * followed by each item.
+ * the callback sends or receives the i-th item,
+ * or if the gfp_xdr is NULL, adds the size of the i-th item to send.
+ */
+typedef gfarm_error_t (*gfp_xdr_item_callback_t)(struct gfp_xdr *, size_t *,
+	int, void *);
+gfarm_error_t gfp_xdr_send_async_request_items_notimeout(struct gfp_xdr *,
+	gfp_xdr_async_peer_t,
+	result_callback_t, disconnect_callback_t, void *,
+	gfarm_int32_t, int, gfp_xdr_item_callback_t, void *);
+gfarm_error_t gfp_xdr_send_async_result_items_notimeout(struct gfp_xdr *,
+	gfp_xdr_xid_t, gfarm_int32_t, int, gfp_xdr_item_callback_t, void *);
+gfarm_error_t gfp_xdr_recv_items_sized(struct gfp_xdr *, int, int, size_t *,
+	int, int *, gfp_xdr_item_callback_t, void *);
+
 gfarm_error_t gfp_xdr_recv_request_command(struct gfp_xdr *, int, size_t *,
 	gfarm_int32_t *);
 gfarm_error_t gfp_xdr_vrecv_request_parameters(struct gfp_xdr *, int, size_t *,
@@ -233,6 +233,81 @@ gfp_xdr_vsend_async_request_notimeout(struct gfp_xdr *server,
 	    command, format, app));
 }
 
+static gfarm_error_t
+gfp_xdr_items_size_add(size_t *sizep, int nitems,
+	gfp_xdr_item_callback_t send_item, void *closure)
+{
+	gfarm_error_t e;
+	int i;
+
+	e = gfp_xdr_send_size_add(sizep, "i", (gfarm_int32_t)nitems);
+	for (i = 0; e == GFARM_ERR_NO_ERROR && i < nitems; i++)
+		e = (*send_item)(NULL, sizep, i, closure);
+	return (e);
+}
+
+static gfarm_error_t
+gfp_xdr_send_items_notimeout(struct gfp_xdr *conn, int nitems,
+	gfp_xdr_item_callback_t send_item, void *closure)
+{
+	gfarm_error_t e;
+	int i;
+
+	e = gfp_xdr_send_notimeout(conn, "i", (gfarm_int32_t)nitems);
+	for (i = 0; e == GFARM_ERR_NO_ERROR && i < nitems; i++)
+		e = (*send_item)(conn, NULL, i, closure);
+	return (e);
+}
+
+/*
+ * same as gfp_xdr_vsend_async_request_notimeout(),
+ * but the parameters of the request are a list of `nitems' items.
+ * this does gfp_xdr_flush_notimeout() too.
+ */
+gfarm_error_t
+gfp_xdr_send_async_request_items_notimeout(struct gfp_xdr *server,
+	gfp_xdr_async_peer_t async_server,
+	result_callback_t result_callback,
+	disconnect_callback_t disconnect_callback,
+	void *closure,
+	gfarm_int32_t command, int nitems,
+	gfp_xdr_item_callback_t send_item, void *item_closure)
+{
+	gfarm_error_t e;
+	size_t size = 0;
+	gfarm_int32_t xid;
+
+	e = gfp_xdr_send_size_add(&size, "i", command);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_items_size_add(&size, nitems,
+		    send_item, item_closure);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+
+	e = gfp_xdr_send_async_request_header(server, async_server, size,
+	    result_callback, disconnect_callback, closure, &xid);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	e = gfp_xdr_send_notimeout(server, "i", command);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_send_items_notimeout(server, nitems,
+		    send_item, item_closure);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gfp_xdr_send_async_request_error(async_server, xid,
+		    "gfp_xdr_send_items");
+		return (e);
+	}
+
+	e = gfp_xdr_flush_notimeout(server);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gfp_xdr_send_async_request_error(async_server, xid,
+		    "gfp_xdr_flush");
+		return (e);
+	}
+
+	return (GFARM_ERR_NO_ERROR);
+}
+
 /*
  * used by both client and server side
  */
@@ -258,6 +333,35 @@ gfp_xdr_recv_async_header(struct gfp_xdr *conn, int just,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+/*
+ * receives a list which is sent by gfp_xdr_send_*_items_notimeout().
+ * it's an error if the list has more than `maxitems' items.
+ */
+gfarm_error_t
+gfp_xdr_recv_items_sized(struct gfp_xdr *conn, int just, int do_timeout,
+	size_t *sizep, int maxitems, int *nitemsp,
+	gfp_xdr_item_callback_t recv_item, void *closure)
+{
+	gfarm_error_t e;
+	gfarm_int32_t i, n;
+	int eof;
+
+	e = gfp_xdr_recv_sized(conn, just, do_timeout, sizep, &eof, "i", &n);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (eof)
+		return (GFARM_ERR_UNEXPECTED_EOF);
+	if (n < 0 || n > maxitems)
+		return (GFARM_ERR_PROTOCOL);
+	for (i = 0; i < n; i++) {
+		e = (*recv_item)(conn, sizep, i, closure);
+		if (e != GFARM_ERR_NO_ERROR)
+			return (e);
+	}
+	*nitemsp = n;
+	return (GFARM_ERR_NO_ERROR);
+}
+
 /*
  * server side functions
  */
@@ -381,3 +485,29 @@ gfp_xdr_vsend_async_result_notimeout(struct gfp_xdr *client, gfp_xdr_xid_t xid,
 	return (gfp_xdr_vsend_result(client, 0, ecode, format, app));
 		/* notimeout */
 }
+
+/*
+ * same as gfp_xdr_vsend_async_result_notimeout(),
+ * but the result is a list of `nitems' items.
+ */
+gfarm_error_t
+gfp_xdr_send_async_result_items_notimeout(struct gfp_xdr *client,
+	gfp_xdr_xid_t xid, gfarm_int32_t ecode, int nitems,
+	gfp_xdr_item_callback_t send_item, void *closure)
+{
+	gfarm_error_t e;
+	size_t size = 0;
+
+	e = gfp_xdr_send_size_add(&size, "i", ecode);
+	if (e == GFARM_ERR_NO_ERROR && ecode == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_items_size_add(&size, nitems, send_item, closure);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	e = gfp_xdr_send_async_result_header_notimeout(client, xid, size);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_send_notimeout(client, "i", ecode);
+	if (e == GFARM_ERR_NO_ERROR && ecode == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_send_items_notimeout(client, nitems,
+		    send_item, closure);
+	return (e);
+}
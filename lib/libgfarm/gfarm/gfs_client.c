@@ -47,6 +47,7 @@
 #include "iobuffer.h"
 #include "gfp_xdr.h"
 #include "io_fd.h"
+#include "io_tls.h"
 #include "host.h"
 #include "sockopt.h"
 #include "auth.h"
@@ -1785,6 +1786,88 @@ gfs_client_pread(struct gfs_connection *gfs_server,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+/*
+ * same as gfs_client_pread(), but `size' may be larger than
+ * GFS_PROTO_MAX_IOSIZE.
+ * the request is split into GFS_PROTO_MAX_IOSIZE chunks, and at most
+ * `window' GFS_PROTO_PREAD requests are kept in flight to hide the
+ * network latency.  since gfsd replies in order, each reply is stored
+ * at the offset of the corresponding request.
+ *
+ * if a chunk is short (EOF) or fails, no more requests are sent,
+ * and the replies of outstanding requests are read and discarded.
+ * an error is returned only if no data is read at all.
+ */
+gfarm_error_t
+gfs_client_pread_pipelined(struct gfs_connection *gfs_server,
+	gfarm_int32_t fd, void *buffer, size_t size,
+	gfarm_off_t off, int window, size_t *np)
+{
+	gfarm_error_t e, e_save = GFARM_ERR_NO_ERROR;
+	char *p = buffer;
+	size_t requested = 0, replied = 0, total = 0, len, n;
+	int in_flight = 0, done = 0;
+
+	gfs_client_connection_lock(gfs_server);
+	for (;;) {
+		while (!done && in_flight < window && requested < size) {
+			len = size - requested < GFS_PROTO_MAX_IOSIZE ?
+			    size - requested : GFS_PROTO_MAX_IOSIZE;
+			e = gfs_client_rpc_request(gfs_server,
+			    GFS_PROTO_PREAD, "iil",
+			    fd, (int)len, off + requested);
+			if (e != GFARM_ERR_NO_ERROR) {
+				/* connection is broken, replies are lost */
+				gfs_client_connection_unlock(gfs_server);
+				return (e);
+			}
+			requested += len;
+			in_flight++;
+		}
+		if (in_flight == 0)
+			break;
+
+		len = size - replied < GFS_PROTO_MAX_IOSIZE ?
+		    size - replied : GFS_PROTO_MAX_IOSIZE;
+		e = gfs_client_rpc_result(gfs_server, 0, "b",
+		    len, &n, p + replied);
+		in_flight--;
+		replied += len;
+		if (IS_CONNECTION_ERROR(e)) {
+			gflog_debug(GFARM_MSG_1005674,
+			    "gfs_client_pread_pipelined: %s",
+			    gfarm_error_string(e));
+			gfs_client_connection_unlock(gfs_server);
+			return (e);
+		}
+		if (done)
+			continue;
+		if (e != GFARM_ERR_NO_ERROR) {
+			gflog_debug(GFARM_MSG_1005675,
+			    "gfs_client_rpc_result() failed: %s",
+			    gfarm_error_string(e));
+			e_save = e;
+			done = 1;
+		} else if (n > len) {
+			gflog_debug(GFARM_MSG_1005676,
+			    "Protocol error in client pread (%llu)>(%llu)",
+			    (unsigned long long)n, (unsigned long long)len);
+			e_save = GFARM_ERRMSG_GFS_PROTO_PREAD_PROTOCOL;
+			done = 1;
+		} else {
+			total += n;
+			if (n < len) /* EOF, or truncated by gfsd */
+				done = 1;
+		}
+	}
+	gfs_client_connection_unlock(gfs_server);
+
+	if (total == 0 && e_save != GFARM_ERR_NO_ERROR)
+		return (e_save);
+	*np = total;
+	return (GFARM_ERR_NO_ERROR);
+}
+
 gfarm_error_t
 gfs_client_pwrite(struct gfs_connection *gfs_server,
 	gfarm_int32_t fd, const void *buffer, size_t size,
@@ -2667,6 +2750,289 @@ gfs_recvfile_common(struct gfp_xdr *conn, gfarm_int32_t *dst_errp,
 	return (e);
 }
 
+#ifdef HAVE_LINUX_SENDFILE
+/*
+ * used by gfsd
+ *
+ * same as gfs_sendfile_common(), but the contents of `r_fd' are
+ * transferred to the socket by sendfile(2) without copying them to
+ * the userland.  the protocol on the wire is not changed.
+ * `conn' must be a plain socket (see gfp_xdr_is_socket()) or
+ * a TLS connection offloaded to the kernel (see gfp_xdr_tls_is_ktls_send()),
+ * `r_fd' must be a regular file, and digest calculation isn't supported.
+ *
+ * because the record length has to be sent before the record, an error
+ * at the middle of a record cannot be reported by *src_errp.
+ * the connection is abandoned in that case.
+ */
+gfarm_error_t
+gfs_sendfile_zerocopy(struct gfp_xdr *conn, gfarm_int32_t *src_errp,
+	int r_fd, gfarm_off_t r_off, gfarm_off_t len, gfarm_off_t *sentp)
+{
+	gfarm_error_t e;
+	gfarm_error_t e_conn = GFARM_ERR_NO_ERROR;
+	gfarm_error_t e_read = GFARM_ERR_NO_ERROR;
+	struct stat st;
+	size_t to_send, done;
+	ssize_t rv;
+	off_t sent = 0;
+	int zerocopy = 1, until_eof = len < 0;
+	char buffer[GFS_STACK_BUFSIZE];
+
+	while (until_eof || len > 0) {
+		if (fstat(r_fd, &st) == -1) {
+			e_read = gfarm_errno_to_error(errno);
+			break;
+		}
+		if (st.st_size <= r_off)
+			break;
+		to_send = st.st_size - r_off < GFS_STACK_BUFSIZE ?
+		    st.st_size - r_off : GFS_STACK_BUFSIZE;
+		if (!until_eof && to_send > len)
+			to_send = len;
+
+		if ((e = gfp_xdr_send(conn, "i", (gfarm_int32_t)to_send))
+		    != GFARM_ERR_NO_ERROR ||
+		    (e = gfp_xdr_flush(conn)) != GFARM_ERR_NO_ERROR) {
+			e_conn = e;
+			gflog_debug(GFARM_MSG_1005668,
+			    "gfp_xdr_send() failed: %s",
+			    gfarm_error_string(e));
+			break;
+		}
+		done = 0;
+		if (zerocopy) {
+#ifdef HAVE_TLS_1_3
+			if (!gfp_xdr_is_socket(conn))
+				e = gfp_xdr_tls_sendfile(conn, r_fd, r_off,
+				    to_send, &done);
+			else
+#endif
+			e = gfp_xdr_socket_sendfile(conn, r_fd, r_off, to_send,
+			    &done);
+			if (e != GFARM_ERR_NO_ERROR) {
+				/* try the rest of this record by pread(2) */
+				gflog_debug(GFARM_MSG_1005669,
+				    "sendfile(2) at offset %lld: %s",
+				    (long long)(r_off + done),
+				    gfarm_error_string(e));
+				zerocopy = 0;
+			}
+		}
+		while (done < to_send) {
+			rv = pread(r_fd, buffer, to_send - done,
+			    r_off + done);
+			if (rv == 0) {
+				e_read = GFARM_ERR_UNEXPECTED_EOF;
+				break;
+			}
+			if (rv == -1) {
+				e_read = gfarm_errno_to_error(errno);
+				break;
+			}
+			e = gfp_xdr_send(conn, "r", (int)rv, buffer);
+			if (e != GFARM_ERR_NO_ERROR) {
+				e_conn = e;
+				break;
+			}
+			done += rv;
+		}
+		r_off += done;
+		if (!until_eof)
+			len -= done;
+		sent += done;
+		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RCOUNT, 1);
+		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RBYTES, done);
+		if (done < to_send) {
+			if (e_conn == GFARM_ERR_NO_ERROR) {
+				gflog_error(GFARM_MSG_1005670,
+				    "sendfile: cannot read %lld bytes "
+				    "at offset %lld: %s, disconnecting",
+				    (long long)(to_send - done),
+				    (long long)r_off,
+				    gfarm_error_string(e_read));
+				/* make sure no one will use this connection */
+				(void)gfp_xdr_shutdown(conn);
+				e_conn = GFARM_ERR_PROTOCOL;
+			}
+			break;
+		}
+	}
+
+	/* send EOF mark */
+	if (e_conn == GFARM_ERR_NO_ERROR)
+		e_conn = gfp_xdr_send(conn, "i", (gfarm_int32_t)0);
+	if (src_errp != NULL)
+		*src_errp = e_read;
+	if (sentp != NULL)
+		*sentp = sent;
+	return (e_conn);
+}
+#endif /* HAVE_LINUX_SENDFILE */
+
+#ifdef HAVE_LINUX_SPLICE
+/*
+ * used by gfsd
+ *
+ * same as gfs_recvfile_common(), but received data are moved to `w_fd'
+ * by splice(2) without copying them to the userland, except the part
+ * which is already read into the recvbuffer of `conn'.
+ * `conn' must be a plain socket (see gfp_xdr_is_socket()),
+ * `w_fd' must be a regular file, and append mode and digest calculation
+ * aren't supported.
+ */
+gfarm_error_t
+gfs_recvfile_zerocopy(struct gfp_xdr *conn, gfarm_int32_t *dst_errp,
+	int w_fd, gfarm_off_t w_off, gfarm_off_t *recvp)
+{
+	gfarm_error_t e; /* connection related error */
+	gfarm_error_t e_write = GFARM_ERR_NO_ERROR, e_splice;
+	gfarm_off_t written = 0;
+	int pipefd[2], zerocopy;
+	size_t pipe_capacity, received, spliced;
+	struct gfs_client_static *s = gfarm_ctxp->gfs_client_static;
+	static const char diag[] = "gfs_recvfile_zerocopy()";
+
+	e = gfp_xdr_splice_pipe_open(pipefd, &pipe_capacity);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_1005671, "%s: pipe: %s",
+		    diag, gfarm_error_string(e));
+		return (gfs_recvfile_common(conn, dst_errp, w_fd, w_off,
+		    0, NULL, NULL, recvp));
+	}
+	zerocopy = 1;
+	for (;;) {
+		gfarm_int32_t size;
+		int eof;
+
+		/* XXX - FIXME layering violation */
+		e = gfp_xdr_recv(conn, 0, &eof, "i", &size);
+		if (e != GFARM_ERR_NO_ERROR)
+			break;
+		if (eof) {
+			e = GFARM_ERR_PROTOCOL;
+			break;
+		}
+		if (size <= 0) {
+			if (size < 0) {
+				gflog_error(GFARM_MSG_1005672,
+				    "%s: invalid record size %d byte "
+				    "at offset %lld, "
+				    "possible data corruption on the network, "
+				    "disconnecting",
+				    diag, (int)size, (long long)w_off);
+				/* make sure no one will use this connection */
+				(void)gfp_xdr_shutdown(conn);
+				/* abandon this network connection */
+				e = GFARM_ERR_PROTOCOL;
+			}
+			break;
+		}
+		while (size > 0) {
+			int i, partial;
+			ssize_t rv;
+			char buffer[GFS_STACK_BUFSIZE];
+
+			if (zerocopy && e_write == GFARM_ERR_NO_ERROR &&
+			    gfp_xdr_recv_buffered_length(conn) == 0) {
+				e = gfp_xdr_socket_splice_to_file(conn,
+				    pipefd, pipe_capacity, w_fd, w_off, size,
+				    &received, &spliced, &e_splice);
+				size -= received;
+				w_off += spliced;
+				written += spliced;
+				gfarm_iostat_local_add(
+				    GFARM_IOSTAT_IO_WCOUNT, 1);
+				gfarm_iostat_local_add(
+				    GFARM_IOSTAT_IO_WBYTES, spliced);
+				if (e != GFARM_ERR_NO_ERROR)
+					break;
+				if (e_splice ==
+				    GFARM_ERR_OPERATION_NOT_SUPPORTED) {
+					/* receive the rest by the iobuffer */
+					zerocopy = 0;
+				} else if (e_splice != GFARM_ERR_NO_ERROR) {
+					e_write = e_splice;
+					if (s->return_on_write_error) {
+						(void)gfp_xdr_shutdown(conn);
+						break;
+					}
+				}
+				continue;
+			}
+
+			/* XXX - FIXME layering violation */
+			e = gfp_xdr_recv_partial(conn, 0,
+			    buffer, size, &partial);
+			if (e != GFARM_ERR_NO_ERROR)
+				break;
+			if (partial <= 0) {
+				gflog_error(GFARM_MSG_1005673,
+				    "%s: invalid read size %d byte "
+				    "at offset %lld, "
+				    "possible data corruption on the network, "
+				    "disconnecting",
+				    diag, (int)partial, (long long)w_off);
+				/* make sure no one will use this connection */
+				(void)gfp_xdr_shutdown(conn);
+				/* abandon this network connection */
+				e = GFARM_ERR_PROTOCOL;
+				break;
+			}
+			size -= partial;
+			if (e_write != GFARM_ERR_NO_ERROR) {
+				/*
+				 * write(2) returned an error.
+				 * We should receive rest of data
+				 * even in that case.
+				 */
+				continue;
+			}
+			for (i = 0; i < partial; i += rv) {
+				rv = pwrite(w_fd,
+				    buffer + i, partial - i, w_off);
+				if (rv == 0) {
+					e_write = GFARM_ERR_NO_SPACE;
+					break;
+				}
+				if (rv == -1) {
+					e_write = gfarm_errno_to_error(errno);
+					break;
+				}
+				w_off += rv;
+				written += rv;
+				gfarm_iostat_local_add(
+				    GFARM_IOSTAT_IO_WCOUNT, 1);
+				gfarm_iostat_local_add(
+				    GFARM_IOSTAT_IO_WBYTES, rv);
+			}
+			if (s->return_on_write_error &&
+			    e_write != GFARM_ERR_NO_ERROR) {
+				/*
+				 * protocol interaction was aborted,
+				 * make sure no one will use this connection
+				 */
+				(void)gfp_xdr_shutdown(conn);
+				break;
+			}
+		}
+		if (e != GFARM_ERR_NO_ERROR)
+			break;
+		if (s->return_on_write_error &&
+		    e_write != GFARM_ERR_NO_ERROR) {
+			/* protocol interaction was aborted */
+			break;
+		}
+	}
+	gfp_xdr_splice_pipe_close(pipefd);
+	if (dst_errp != NULL)
+		*dst_errp = e_write;
+	if (recvp != NULL)
+		*recvp = written;
+	return (e);
+}
+#endif /* HAVE_LINUX_SPLICE */
+
 /*
  * *md_ctx: if an error happens in gfsd side, *md_ctx may not reflect
  *	the content which is actually written by the gfsd.
@@ -2812,6 +3178,13 @@ gfs_client_replica_recv_common(struct gfs_connection *gfs_server,
 		return (e);
 	}
 
+#if defined(HAVE_LINUX_SPLICE) && !defined(__KERNEL__)
+	if (gfarm_spool_server_zerocopy && md_ctx == NULL &&
+	    gfp_xdr_is_socket(gfs_server->conn))
+		e = gfs_recvfile_zerocopy(gfs_server->conn, &dst_err,
+		    local_fd, 0, NULL);
+	else
+#endif
 	e = gfs_recvfile_common(gfs_server->conn, &dst_err,
 	    local_fd, 0, 0, md_ctx, NULL, NULL);
 	/*
@@ -71,6 +71,9 @@ gfarm_error_t gfs_client_close_write(struct gfs_connection *,
 	gfarm_int32_t, gfarm_int32_t);
 gfarm_error_t gfs_client_pread(struct gfs_connection *,
 			gfarm_int32_t, void *, size_t, gfarm_off_t, size_t *);
+gfarm_error_t gfs_client_pread_pipelined(struct gfs_connection *,
+			gfarm_int32_t, void *, size_t, gfarm_off_t, int,
+			size_t *);
 gfarm_error_t gfs_client_pwrite(struct gfs_connection *,
 			gfarm_int32_t, const void *, size_t, gfarm_off_t,
 			size_t *);
@@ -140,8 +143,19 @@ gfarm_error_t gfs_sendfile_common(struct gfp_xdr *, gfarm_int32_t *,
 	int, gfarm_off_t, gfarm_off_t, EVP_MD_CTX *, gfarm_off_t *);
 gfarm_error_t gfs_recvfile_common(struct gfp_xdr *, gfarm_int32_t *,
 	int, gfarm_off_t, int, EVP_MD_CTX *, int *, gfarm_off_t *);
+#ifdef HAVE_LINUX_SENDFILE
+gfarm_error_t gfs_sendfile_zerocopy(struct gfp_xdr *, gfarm_int32_t *,
+	int, gfarm_off_t, gfarm_off_t, gfarm_off_t *);
+#endif
+#ifdef HAVE_LINUX_SPLICE
+gfarm_error_t gfs_recvfile_zerocopy(struct gfp_xdr *, gfarm_int32_t *,
+	int, gfarm_off_t, gfarm_off_t *);
+#endif
 #endif
 
+/* commonly used by both clients and gfsd */
+int gfarm_fd_receive_message(int, void *, size_t, int, int *);
+
 #define GFS_CLIENT_COMMAND_FLAG_STDIN_EOF	0x01
 #define GFS_CLIENT_COMMAND_FLAG_SHELL_COMMAND	0x02
 #define GFS_CLIENT_COMMAND_FLAG_XENVCOPY	0x10
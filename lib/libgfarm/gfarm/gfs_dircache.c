@@ -10,6 +10,7 @@
 
 #include "gfutil.h"
 #include "hash.h"
+#include "lru_cache.h"
 #include "thrsubr.h"
 
 #include "context.h"
@@ -18,6 +19,7 @@
 #include "gfs_dirplusxattr.h"
 #include "gfs_dircache.h"
 #include "gfs_attrplus.h"
+#include "gfs_profile.h"
 
 /* #define DIRCACHE_DEBUG */
 
@@ -86,6 +88,389 @@ stat_cache_unlock(const char *where)
 	gfarm_mutex_unlock(&stat_cache_mutex, where, "stat_cache");
 }
 
+/*
+ * gfs_dir_cache
+ *
+ * This caches negative lookup results, complete directory listings,
+ * and inode numbers of directories looked up by GFM_PROTO_LOOKUP_PATH.
+ * All are protected by stat_cache_mutex, and share one byte budget
+ * (dir_cache_size) which is managed in LRU order.
+ */
+
+#define DIR_CACHE_HASH_SIZE	1021	/* prime number */
+
+#define DIR_CACHE_NEGATIVE_NOFOLLOW	1 /* gfs_lstat() also failed */
+
+struct dir_cache_data {
+	struct gfarm_lru_entry lru_entry; /* must be the first member */
+
+	struct gfarm_hash_table *table;
+	struct gfarm_hash_entry *entry;
+	struct timeval expiration;
+	size_t size;
+	int flags;
+
+	/* only used for directory listings.  sorted by d_name */
+	int nentries;
+	struct gfs_dirent *entries;
+
+	/* only used for the path cache */
+	gfarm_ino_t ino;
+	gfarm_uint64_t gen;
+};
+
+static struct gfarm_lru_cache dir_cache_lru =
+	GFARM_LRU_CACHE_INITIALIZER(dir_cache_lru);
+static struct gfarm_hash_table *negative_table, *dirlist_table, *path_table;
+static size_t dir_cache_used;
+
+/* incremented whenever any entry may be stale */
+static unsigned long dir_cache_generation;
+
+static struct gfs_dircache_profile {
+	unsigned long long attr_cache_hit;
+	unsigned long long attr_cache_miss;
+	unsigned long long negative_cache_hit;
+	unsigned long long dir_cache_hit;
+	unsigned long long dir_cache_miss;
+	unsigned long long path_cache_hit;
+	unsigned long long path_cache_miss;
+} dircache_profile;
+
+static void
+dir_cache_data_free(struct dir_cache_data *data)
+{
+	struct gfarm_hash_entry *entry = data->entry;
+
+	gfarm_lru_cache_purge_entry(&data->lru_entry);
+	dir_cache_used -= data->size;
+	free(data->entries);
+	/* this frees `data' itself, thus this must be the last */
+	gfarm_hash_purge(data->table, gfarm_hash_entry_key(entry),
+	    gfarm_hash_entry_key_length(entry));
+}
+
+static void
+dir_cache_clear(void)
+{
+	struct gfarm_lru_entry *head = &dir_cache_lru.list_head;
+
+	while (head->next != head)
+		dir_cache_data_free((struct dir_cache_data *)head->next);
+	++dir_cache_generation;
+}
+
+/* remove least recently used entries to make room for `size' bytes */
+static void
+dir_cache_reserve(size_t size)
+{
+	struct gfarm_lru_entry *head = &dir_cache_lru.list_head;
+
+	while (head->prev != head &&
+	    dir_cache_used + size > gfarm_ctxp->dir_cache_size)
+		dir_cache_data_free((struct dir_cache_data *)head->prev);
+}
+
+static void
+dir_cache_purge(struct gfarm_hash_table *table, const char *key)
+{
+	struct gfarm_hash_entry *entry;
+
+	if (table == NULL)
+		return;
+	entry = gfarm_hash_lookup(table, key, strlen(key) + 1);
+	if (entry != NULL)
+		dir_cache_data_free(gfarm_hash_entry_data(entry));
+}
+
+static gfarm_error_t
+dir_cache_enter(struct gfarm_hash_table **tablep, const char *key,
+	int lifespan_millisec, size_t size, int flags,
+	int nentries, struct gfs_dirent *entries, struct dir_cache_data **datap)
+{
+	struct gfarm_hash_entry *entry;
+	struct dir_cache_data *data;
+	struct timeval now;
+	int created;
+
+	if (*tablep == NULL) {
+		*tablep = gfarm_hash_table_alloc(DIR_CACHE_HASH_SIZE,
+		    gfarm_hash_default, gfarm_hash_key_equal_default);
+		if (*tablep == NULL)
+			return (GFARM_ERR_NO_MEMORY);
+	}
+	dir_cache_purge(*tablep, key);
+
+	size += sizeof(*data) + strlen(key) + 1;
+	if (size > gfarm_ctxp->dir_cache_size)
+		return (GFARM_ERR_NO_SPACE);
+	dir_cache_reserve(size);
+
+	entry = gfarm_hash_enter(*tablep, key, strlen(key) + 1,
+	    sizeof(*data), &created);
+	if (entry == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	data = gfarm_hash_entry_data(entry);
+	data->table = *tablep;
+	data->entry = entry;
+	gettimeofday(&now, NULL);
+	data->expiration.tv_sec = lifespan_millisec / 1000;
+	data->expiration.tv_usec = (lifespan_millisec % 1000) * 1000;
+	gfarm_timeval_add(&data->expiration, &now);
+	data->size = size;
+	data->flags = flags;
+	data->nentries = nentries;
+	data->entries = entries;
+	gfarm_lru_cache_link_entry(&dir_cache_lru, &data->lru_entry);
+	dir_cache_used += size;
+	if (datap != NULL)
+		*datap = data;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static struct dir_cache_data *
+dir_cache_lookup(struct gfarm_hash_table *table, const char *key)
+{
+	struct gfarm_hash_entry *entry;
+	struct dir_cache_data *data;
+	struct timeval now;
+
+	if (table == NULL)
+		return (NULL);
+	entry = gfarm_hash_lookup(table, key, strlen(key) + 1);
+	if (entry == NULL)
+		return (NULL);
+	data = gfarm_hash_entry_data(entry);
+	gettimeofday(&now, NULL);
+	if (gfarm_timeval_cmp(&data->expiration, &now) <= 0) {
+		dir_cache_data_free(data);
+		return (NULL);
+	}
+	gfarm_lru_cache_access_entry(&dir_cache_lru, &data->lru_entry);
+	return (data);
+}
+
+/* returns the length of the parent directory part including the last '/' */
+static size_t
+dir_cache_parent_length(const char *path)
+{
+	const char *base = strrchr(path, '/');
+
+	if (base == NULL || base < gfarm_url_prefix_hostname_port_skip(path))
+		return (0);
+	return (base - path + 1);
+}
+
+static int
+dirent_name_compare(const void *a, const void *b)
+{
+	const struct gfs_dirent *da = a, *db = b;
+
+	return (strcmp(da->d_name, db->d_name));
+}
+
+static void
+gfs_negative_cache_enter(const char *path, int no_follow)
+{
+	gfarm_error_t e;
+
+	if (gfarm_ctxp->negative_cache_timeout <= 0)
+		return;
+	e = dir_cache_enter(&negative_table, path,
+	    gfarm_ctxp->negative_cache_timeout, 0,
+	    no_follow ? DIR_CACHE_NEGATIVE_NOFOLLOW : 0, 0, NULL, NULL);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005693,
+		    "negative cache: failed to cache %s: %s",
+		    path, gfarm_error_string(e));
+}
+
+/* returns true, if `path' is known not to exist */
+static int
+gfs_negative_cache_lookup(const char *path, int no_follow)
+{
+	struct dir_cache_data *data;
+	struct gfs_dirent key;
+	size_t len;
+	char *parent;
+
+	if (gfarm_ctxp->negative_cache_timeout > 0 &&
+	    (data = dir_cache_lookup(negative_table, path)) != NULL &&
+	    (!no_follow || (data->flags & DIR_CACHE_NEGATIVE_NOFOLLOW))) {
+		gfs_profile(dircache_profile.negative_cache_hit++);
+		return (1);
+	}
+
+	/* a complete listing of the parent directory is also usable */
+	if (gfarm_ctxp->dir_cache_timeout <= 0 || dirlist_table == NULL ||
+	    (len = dir_cache_parent_length(path)) == 0 ||
+	    strlen(path + len) > GFS_MAXNAMLEN || path[len] == '\0')
+		return (0);
+	GFARM_MALLOC_ARRAY(parent, len + 1);
+	if (parent == NULL)
+		return (0);
+	memcpy(parent, path, len);
+	parent[len] = '\0';
+	data = dir_cache_lookup(dirlist_table, parent);
+	free(parent);
+	if (data == NULL)
+		return (0);
+	strcpy(key.d_name, path + len);
+	if (bsearch(&key, data->entries, data->nentries,
+	    sizeof(data->entries[0]), dirent_name_compare) != NULL)
+		return (0);
+	gfs_profile(dircache_profile.negative_cache_hit++);
+	return (1);
+}
+
+/* this must be called with stat_cache_mutex locked */
+static void
+gfs_dircache_invalidate0(const char *path)
+{
+	size_t len = strlen(path), plen = dir_cache_parent_length(path);
+	char *p;
+
+	++dir_cache_generation;
+	if (dir_cache_used == 0)
+		return;
+	dir_cache_purge(negative_table, path);
+
+	GFARM_MALLOC_ARRAY(p, len + 1 + 1);
+	if (p == NULL) {
+		dir_cache_clear();
+		return;
+	}
+	sprintf(p, "%s/", path);
+	dir_cache_purge(dirlist_table, p); /* in case `path' is a directory */
+	if (plen > 0) {
+		p[plen] = '\0';
+		dir_cache_purge(dirlist_table, p);
+	}
+	free(p);
+}
+
+/* `path' is created, removed or renamed */
+void
+gfs_dircache_invalidate(const char *path)
+{
+	stat_cache_lock(__func__);
+	gfs_dircache_invalidate0(path);
+	stat_cache_unlock(__func__);
+}
+
+/*
+ * the directory `path' is removed or renamed, or another directory is
+ * renamed to `path'.  listings and negative entries of its descendants
+ * are purged as well.  the path cache is cleared by gfs_path_cache_clear().
+ */
+void
+gfs_dircache_invalidate_tree(const char *path)
+{
+	struct gfarm_lru_entry *head = &dir_cache_lru.list_head, *p, *next;
+	struct dir_cache_data *data;
+	size_t len = strlen(path);
+	const char *key;
+
+	stat_cache_lock(__func__);
+	gfs_dircache_invalidate0(path);
+	for (p = head->next; p != head; p = next) {
+		next = p->next;
+		data = (struct dir_cache_data *)p;
+		if (data->table == path_table)
+			continue;
+		key = gfarm_hash_entry_key(data->entry);
+		if (strncmp(key, path, len) == 0 && key[len] == '/')
+			dir_cache_data_free(data);
+	}
+	stat_cache_unlock(__func__);
+}
+
+/*
+ * the path cache
+ *
+ * `key' identifies the metadata server and the user as well as the path,
+ * see gfm_path_cache_key() in lookup.c.
+ */
+
+/* returns true, if `key' is cached */
+int
+gfs_path_cache_lookup(const char *key, gfarm_ino_t *inop,
+	gfarm_uint64_t *genp)
+{
+	struct dir_cache_data *data;
+	int found = 0;
+
+	if (gfarm_ctxp->path_cache_timeout <= 0)
+		return (0);
+	stat_cache_lock(__func__);
+	if ((data = dir_cache_lookup(path_table, key)) != NULL) {
+		*inop = data->ino;
+		*genp = data->gen;
+		found = 1;
+	}
+	stat_cache_unlock(__func__);
+	return (found);
+}
+
+void
+gfs_path_cache_enter(const char *key, gfarm_ino_t ino, gfarm_uint64_t gen)
+{
+	gfarm_error_t e;
+	struct dir_cache_data *data;
+
+	if (gfarm_ctxp->path_cache_timeout <= 0)
+		return;
+	stat_cache_lock(__func__);
+	e = dir_cache_enter(&path_table, key, gfarm_ctxp->path_cache_timeout,
+	    0, 0, 0, NULL, &data);
+	if (e == GFARM_ERR_NO_ERROR) {
+		data->ino = ino;
+		data->gen = gen;
+	}
+	stat_cache_unlock(__func__);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005797,
+		    "path cache: failed to cache %s: %s",
+		    key, gfarm_error_string(e));
+}
+
+/* `hit' is true, if any ancestor of a path was found in the cache */
+void
+gfs_path_cache_profile(int hit)
+{
+	if (hit) {
+		gfs_profile(dircache_profile.path_cache_hit++);
+	} else {
+		gfs_profile(dircache_profile.path_cache_miss++);
+	}
+}
+
+/*
+ * a directory may be renamed, and every path under it may be stale.
+ * a directory which is removed is detected by gfmd.
+ */
+void
+gfs_path_cache_clear(void)
+{
+	struct gfarm_hash_iterator it;
+	struct dir_cache_data *data;
+
+	stat_cache_lock(__func__);
+	if (path_table != NULL) {
+		for (gfarm_hash_iterator_begin(path_table, &it);
+		    !gfarm_hash_iterator_is_end(&it);
+		    gfarm_hash_iterator_next(&it)) {
+			data = gfarm_hash_entry_data(
+			    gfarm_hash_iterator_access(&it));
+			gfarm_lru_cache_purge_entry(&data->lru_entry);
+			dir_cache_used -= data->size;
+		}
+		gfarm_hash_table_free(path_table);
+		path_table = NULL;
+	}
+	stat_cache_unlock(__func__);
+}
+
 static gfarm_error_t
 gfs_stat_cache_init0(struct stat_cache *cache)
 {
@@ -170,6 +555,7 @@ gfs_stat_cache_clear(void)
 	stat_cache_lock(__func__);
 	gfs_stat_cache_clear0(&stat_cache);
 	gfs_stat_cache_clear0(&lstat_cache);
+	dir_cache_clear();
 	stat_cache_unlock(__func__);
 }
 
@@ -432,6 +818,7 @@ gfs_stat_cache_purge(const char *path)
 	stat_cache_lock(__func__);
 	e1 = gfs_stat_cache_purge0(&lstat_cache, path);
 	e2 = gfs_stat_cache_purge0(&stat_cache, path);
+	gfs_dircache_invalidate0(path);
 	stat_cache_unlock(__func__);
 	/* only if not found in both lstat cache and stat cache */
 	if (e1 == GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY &&
@@ -465,6 +852,8 @@ gfs_getattrplus_caching0(struct stat_cache *cache,
 	if (e != GFARM_ERR_NO_ERROR) {
 		gflog_debug(GFARM_MSG_1002465, "gfs_getattrplusstat(%s): %s",
 		    path, gfarm_error_string(e));
+		if (e == GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY)
+			gfs_negative_cache_enter(path, no_follow);
 		return (e);
 	}
 
@@ -649,6 +1038,7 @@ gfs_stat_cache_data_get0(struct stat_cache *cache, const char *path,
 		    "%ld.%06ld: gfs_stat_cached(%s): hit (%d)",
 		    (long)now.tv_sec, (long)now.tv_usec, path, cache->count);
 #endif
+		gfs_profile(dircache_profile.attr_cache_hit++);
 		*datap = gfarm_hash_entry_data(entry);
 		return (GFARM_ERR_NO_ERROR);
 	}
@@ -657,6 +1047,7 @@ gfs_stat_cache_data_get0(struct stat_cache *cache, const char *path,
 	    "%ld.%06ld: gfs_stat_cached(%s): miss (%d)",
 	    (long)now.tv_sec, (long)now.tv_usec, path, cache->count);
 #endif
+	gfs_profile(dircache_profile.attr_cache_miss++);
 	*datap = NULL;
 	return (GFARM_ERR_NO_ERROR);
 }
@@ -670,8 +1061,11 @@ gfs_stat_cached_internal0(struct stat_cache *cache, const char *path,
 
 	if (e != GFARM_ERR_NO_ERROR)
 		return (e);
-	if (data == NULL) /* not hit */
+	if (data == NULL) { /* not hit */
+		if (gfs_negative_cache_lookup(path, cache == &lstat_cache))
+			return (GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY);
 		return (gfs_stat_caching0(cache, path, st));
+	}
 
 	return (gfs_stat_copy(st, &data->st)); /* hit */
 }
@@ -698,6 +1092,73 @@ gfs_lstat_cached_internal(const char *path, struct gfs_stat *st)
 	return (rv);
 }
 
+/*
+ * gfs_lstat_prefetch() does nothing if any xattr is cached, because
+ * gfs_lstat_multi() doesn't return xattrs, and the cache entries would be
+ * incomplete.  it does nothing if lstat_multi_rpc is disabled either,
+ * because looking up each path in advance wouldn't save any round trip.
+ */
+static int
+gfs_lstat_prefetch_is_available(void)
+{
+	return (gfarm_ctxp->lstat_multi_rpc &&
+	    gfarm_xattr_caching_patterns_number() == 0);
+}
+
+/*
+ * enter lstat results of the paths to the cache, by one round trip
+ * for each metadata server.
+ */
+gfarm_error_t
+gfs_lstat_prefetch_internal(int npaths, const char **paths)
+{
+	gfarm_error_t e, *errs;
+	struct gfs_stat *sts;
+	struct timeval now;
+	int i;
+
+	if (npaths <= 0 || !gfs_lstat_prefetch_is_available())
+		return (GFARM_ERR_NO_ERROR);
+
+	GFARM_MALLOC_ARRAY(sts, npaths);
+	GFARM_MALLOC_ARRAY(errs, npaths);
+	if (sts == NULL || errs == NULL) {
+		free(sts);
+		free(errs);
+		gflog_debug(GFARM_MSG_1005780,
+		    "gfs_lstat_prefetch(%d): no memory", npaths);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	if ((e = gfs_lstat_multi(npaths, paths, sts, errs))
+	    != GFARM_ERR_NO_ERROR) {
+		free(sts);
+		free(errs);
+		return (e);
+	}
+
+	gettimeofday(&now, NULL);
+	stat_cache_lock(__func__);
+	for (i = 0; i < npaths; i++) {
+		if (errs[i] == GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY) {
+			gfs_negative_cache_enter(paths[i], 1);
+			continue;
+		} else if (errs[i] != GFARM_ERR_NO_ERROR)
+			continue;
+		/* it's ok to fail in entering the cache */
+		(void)gfs_stat_cache_enter_internal0(&lstat_cache, paths[i],
+		    &sts[i], 0, NULL, NULL, NULL, &now);
+		if (!GFARM_S_ISLNK(sts[i].st_mode))
+			(void)gfs_stat_cache_enter_internal0(&stat_cache,
+			    paths[i], &sts[i], 0, NULL, NULL, NULL, &now);
+		gfs_stat_free(&sts[i]);
+	}
+	stat_cache_unlock(__func__);
+
+	free(sts);
+	free(errs);
+	return (GFARM_ERR_NO_ERROR);
+}
+
 /* this returns cached result */
 static gfarm_error_t
 gfs_getxattr_cached_internal0(struct stat_cache *cache,
@@ -709,9 +1170,12 @@ gfs_getxattr_cached_internal0(struct stat_cache *cache,
 
 	if (e != GFARM_ERR_NO_ERROR)
 		return (e);
-	if (data == NULL) /* not hit */
+	if (data == NULL) { /* not hit */
+		if (gfs_negative_cache_lookup(path, cache == &lstat_cache))
+			return (GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY);
 		return (gfs_getxattr_caching0(cache, path, name, value,
 			sizep));
+	}
 
 	/* hit */
 	for (i = 0; i < data->nattrs; i++) {
@@ -782,8 +1246,70 @@ struct gfs_dir_caching {
 
 	GFS_DirPlusXAttr dp;
 	char *path;
+
+	/* for dir_cache. collected while the directory is read sequentially */
+	int collecting, nentries, entries_size;
+	struct gfs_dirent *entries;
+	unsigned long generation;
 };
 
+static void
+gfs_dir_caching_collect_stop(struct gfs_dir_caching *dir)
+{
+	dir->collecting = 0;
+	free(dir->entries);
+	dir->entries = NULL;
+	dir->nentries = dir->entries_size = 0;
+}
+
+/* this must be called with stat_cache_mutex locked */
+static void
+gfs_dir_caching_collect(struct gfs_dir_caching *dir, struct gfs_dirent *ep)
+{
+	gfarm_error_t e;
+	struct gfs_dirent *entries;
+	int n;
+
+	if (ep != NULL) { /* i.e. not EOF */
+		if (dir->nentries >= dir->entries_size) {
+			n = dir->entries_size == 0 ?
+			    DIRENTSPLUS_BUFCOUNT : dir->entries_size * 2;
+			if ((size_t)n * sizeof(*entries) >
+			    gfarm_ctxp->dir_cache_size) {
+				/* too large directory to cache */
+				gfs_dir_caching_collect_stop(dir);
+				return;
+			}
+			GFARM_REALLOC_ARRAY(entries, dir->entries, n);
+			if (entries == NULL) {
+				gfs_dir_caching_collect_stop(dir);
+				return;
+			}
+			dir->entries = entries;
+			dir->entries_size = n;
+		}
+		dir->entries[dir->nentries++] = *ep;
+		return;
+	}
+
+	/* EOF: the listing is complete, unless something has been changed */
+	if (dir->generation == dir_cache_generation) {
+		qsort(dir->entries, dir->nentries, sizeof(*dir->entries),
+		    dirent_name_compare);
+		e = dir_cache_enter(&dirlist_table, dir->path,
+		    gfarm_ctxp->dir_cache_timeout,
+		    dir->nentries * sizeof(*dir->entries), 0,
+		    dir->nentries, dir->entries, NULL);
+		if (e == GFARM_ERR_NO_ERROR)
+			dir->entries = NULL; /* now owned by dir_cache */
+		else
+			gflog_debug(GFARM_MSG_1005694,
+			    "dir cache: failed to cache %s: %s",
+			    dir->path, gfarm_error_string(e));
+	}
+	gfs_dir_caching_collect_stop(dir);
+}
+
 static gfarm_error_t
 gfs_readdir_caching_internal(GFS_Dir super, struct gfs_dirent **entryp)
 {
@@ -855,9 +1381,12 @@ gfs_readdir_caching_internal(GFS_Dir super, struct gfs_dirent **entryp)
 				    "dircache: failed to cache %s: %s",
 				    path, gfarm_error_string(e));
 			}
+			dir_cache_purge(negative_table, path);
 			free(path);
 		}
 	}
+	if (dir->collecting)
+		gfs_dir_caching_collect(dir, ep);
 
 	stat_cache_unlock(__func__);
 	*entryp = ep;
@@ -872,6 +1401,9 @@ gfs_seekdir_caching_internal(GFS_Dir super, gfarm_off_t off)
 
 	stat_cache_lock(__func__);
 	e = gfs_seekdirplusxattr(dir->dp, off);
+	/* the listing may not be complete any more */
+	if (dir->collecting)
+		gfs_dir_caching_collect_stop(dir);
 	stat_cache_unlock(__func__);
 	return (e);
 }
@@ -898,18 +1430,174 @@ gfs_closedir_caching_internal(GFS_Dir super)
 	e = gfs_closedirplusxattr(dir->dp);
 	stat_cache_unlock(__func__);
 
+	free(dir->entries);
 	free(dir->path);
 	free(dir);
 	return (e);
 }
 
+/*
+ * a directory which is read from dir_cache without any RPC
+ */
+
+struct gfs_dir_cached {
+	struct gfs_dir super;
+
+	int nentries, index;
+	struct gfs_dirent *entries;
+};
+
+static gfarm_error_t
+gfs_readdir_cached_internal(GFS_Dir super, struct gfs_dirent **entryp)
+{
+	struct gfs_dir_cached *dir = (struct gfs_dir_cached *)super;
+
+	if (dir->index >= dir->nentries)
+		*entryp = NULL;
+	else
+		*entryp = &dir->entries[dir->index++];
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+gfs_seekdir_cached_internal(GFS_Dir super, gfarm_off_t off)
+{
+	struct gfs_dir_cached *dir = (struct gfs_dir_cached *)super;
+
+	if (off < 0 || off > dir->nentries)
+		return (GFARM_ERR_INVALID_ARGUMENT);
+	dir->index = off;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+gfs_telldir_cached_internal(GFS_Dir super, gfarm_off_t *offp)
+{
+	struct gfs_dir_cached *dir = (struct gfs_dir_cached *)super;
+
+	*offp = dir->index;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+gfs_closedir_cached_internal(GFS_Dir super)
+{
+	struct gfs_dir_cached *dir = (struct gfs_dir_cached *)super;
+
+	free(dir->entries);
+	free(dir);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * returns the number of the entries in the listing, whose lstat results
+ * aren't in the cache.  if `pathsp' isn't NULL, their paths are returned,
+ * unless memory is exhausted.
+ * this must be called with stat_cache_mutex locked.
+ */
+static int
+gfs_dir_cached_uncached_entries(const char *path,
+	struct dir_cache_data *data, char ***pathsp)
+{
+	struct timeval now;
+	char *epath, **paths = NULL;
+	int i, n = 0;
+
+	if (gfs_stat_cache_init0(&lstat_cache) != GFARM_ERR_NO_ERROR)
+		return (0);
+	/* nothing to be refilled, if the attr cache is disabled */
+	if (lstat_cache.lifespan.tv_sec == 0 &&
+	    lstat_cache.lifespan.tv_usec == 0)
+		return (0);
+	GFARM_MALLOC_ARRAY(epath, strlen(path) + GFS_MAXNAMLEN + 1);
+	if (epath == NULL)
+		return (0);
+	if (pathsp != NULL && data->nentries > 0)
+		GFARM_MALLOC_ARRAY(paths, data->nentries);
+
+	gettimeofday(&now, NULL);
+	gfs_stat_cache_expire_internal0(&lstat_cache, &now);
+	for (i = 0; i < data->nentries; i++) {
+		sprintf(epath, "%s%s", path, data->entries[i].d_name);
+		if (gfarm_hash_lookup(lstat_cache.table, epath,
+		    strlen(epath) + 1) != NULL)
+			continue;
+		if (paths != NULL && (paths[n] = strdup(epath)) == NULL) {
+			gfarm_strings_free_deeply(n, paths);
+			paths = NULL;
+		}
+		n++;
+	}
+	free(epath);
+	if (pathsp != NULL)
+		*pathsp = paths;
+	else if (paths != NULL)
+		gfarm_strings_free_deeply(n, paths);
+	return (n);
+}
+
+/*
+ * the cached listing is only used if the lstat results of all entries
+ * are in the cache as well, because gfs_readdir_caching() enters them,
+ * and lstat calls which follow readdir (e.g. ls -l) expect them.
+ * otherwise, the paths of the uncached entries are returned by
+ * `*pathsp' and `*npathsp' to be refilled, if they can be prefetched.
+ * this must be called with stat_cache_mutex locked.
+ */
+static struct gfs_dir *
+gfs_opendir_cached_internal(const char *path, char ***pathsp, int *npathsp)
+{
+	struct dir_cache_data *data;
+	struct gfs_dir_cached *dir;
+	int n;
+	static struct gfs_dir_ops ops = {
+		gfs_closedir_cached_internal,
+		gfs_readdir_cached_internal,
+		gfs_seekdir_cached_internal,
+		gfs_telldir_cached_internal
+	};
+
+	*pathsp = NULL;
+	*npathsp = 0;
+	if ((data = dir_cache_lookup(dirlist_table, path)) == NULL) {
+		gfs_profile(dircache_profile.dir_cache_miss++);
+		return (NULL);
+	}
+	if ((n = gfs_dir_cached_uncached_entries(path, data,
+	    gfs_lstat_prefetch_is_available() ? pathsp : NULL)) > 0) {
+		if (*pathsp != NULL)
+			*npathsp = n;
+		gfs_profile(dircache_profile.dir_cache_miss++);
+		return (NULL);
+	}
+
+	/* copy, since the cache entry may be evicted while this is open */
+	GFARM_MALLOC(dir);
+	if (dir == NULL)
+		return (NULL);
+	GFARM_MALLOC_ARRAY(dir->entries, data->nentries);
+	if (dir->entries == NULL && data->nentries > 0) {
+		free(dir);
+		return (NULL);
+	}
+	memcpy(dir->entries, data->entries,
+	    data->nentries * sizeof(*dir->entries));
+	dir->super.ops = &ops;
+	dir->nentries = data->nentries;
+	dir->index = 0;
+	gfs_profile(dircache_profile.dir_cache_hit++);
+	return (&dir->super);
+}
+
 gfarm_error_t
 gfs_opendir_caching_internal(const char *path, GFS_Dir *dirp)
 {
 	gfarm_error_t e;
 	GFS_DirPlusXAttr dp;
 	struct gfs_dir_caching *dir;
-	char *p;
+	struct gfs_dir *cached;
+	char *p, **paths;
+	int npaths;
 	static struct gfs_dir_ops ops = {
 		gfs_closedir_caching_internal,
 		gfs_readdir_caching_internal,
@@ -917,36 +1605,61 @@ gfs_opendir_caching_internal(const char *path, GFS_Dir *dirp)
 		gfs_telldir_caching_internal
 	};
 
+	if (*gfarm_url_dir_skip(path) != '\0') {
+		GFARM_MALLOC_ARRAY(p, strlen(path) + 1 + 1);
+		if (p != NULL)
+			sprintf(p, "%s/", path);
+	} else {
+		GFARM_MALLOC_ARRAY(p, strlen(path) + 1);
+		if (p != NULL)
+			strcpy(p, path);
+	}
+	if (p == NULL) {
+		gflog_debug(GFARM_MSG_1005695,
+			"allocation of path failed: %s",
+			gfarm_error_string(GFARM_ERR_NO_MEMORY));
+		return (GFARM_ERR_NO_MEMORY);
+	}
+
 	stat_cache_lock(__func__);
 
+	if (gfarm_ctxp->dir_cache_timeout > 0) {
+		cached = gfs_opendir_cached_internal(p, &paths, &npaths);
+		if (cached == NULL && npaths > 0) {
+			/* refill the lstat results by one round trip */
+			stat_cache_unlock(__func__);
+			(void)gfs_lstat_prefetch_internal(npaths,
+			    (const char **)paths);
+			gfarm_strings_free_deeply(npaths, paths);
+			stat_cache_lock(__func__);
+			cached = gfs_opendir_cached_internal(p,
+			    &paths, &npaths);
+			gfarm_strings_free_deeply(npaths, paths);
+		}
+		if (cached != NULL) {
+			stat_cache_unlock(__func__);
+			free(p);
+			*dirp = cached;
+			return (GFARM_ERR_NO_ERROR);
+		}
+	}
+
 	if ((e = gfs_opendirplusxattr(path, &dp)) != GFARM_ERR_NO_ERROR) {
 		gflog_debug(GFARM_MSG_1001290,
 			"gfs_opendirplusxattr(%s) failed: %s",
 			path,
 			gfarm_error_string(e));
 		stat_cache_unlock(__func__);
+		free(p);
 		return (e);
 	}
 
 	GFARM_MALLOC(dir);
-	if (*gfarm_url_dir_skip(path) != '\0') {
-		GFARM_MALLOC_ARRAY(p, strlen(path) + 1 + 1);
-		if (p != NULL)
-			sprintf(p, "%s/", path);
-	} else {
-		GFARM_MALLOC_ARRAY(p, strlen(path) + 1);
-		if (p != NULL)
-			strcpy(p, path);
-	}
-
-	if (dir == NULL || p == NULL) {
+	if (dir == NULL) {
 		gfs_closedirplusxattr(dp);
-		if (dir != NULL)
-			free(dir);
-		if (p != NULL)
-			free(p);
+		free(p);
 		gflog_debug(GFARM_MSG_1001291,
-			"allocation of dir or path failed: %s",
+			"allocation of dir failed: %s",
 			gfarm_error_string(GFARM_ERR_NO_MEMORY));
 		stat_cache_unlock(__func__);
 		return (GFARM_ERR_NO_MEMORY);
@@ -955,8 +1668,47 @@ gfs_opendir_caching_internal(const char *path, GFS_Dir *dirp)
 	dir->super.ops = &ops;
 	dir->dp = dp;
 	dir->path = p;
+	dir->collecting = gfarm_ctxp->dir_cache_timeout > 0;
+	dir->nentries = dir->entries_size = 0;
+	dir->entries = NULL;
+	dir->generation = dir_cache_generation;
 
 	stat_cache_unlock(__func__);
 	*dirp = &dir->super;
 	return (GFARM_ERR_NO_ERROR);
 }
+
+struct gfs_profile_list dircache_profile_items[] = {
+	{ "attr_cache_hit", "attr cache hit     : %llu", "%llu", 'l',
+	  offsetof(struct gfs_dircache_profile, attr_cache_hit) },
+	{ "attr_cache_miss", "attr cache miss    : %llu", "%llu", 'l',
+	  offsetof(struct gfs_dircache_profile, attr_cache_miss) },
+	{ "negative_cache_hit", "negative cache hit : %llu", "%llu", 'l',
+	  offsetof(struct gfs_dircache_profile, negative_cache_hit) },
+	{ "dir_cache_hit", "dir cache hit      : %llu", "%llu", 'l',
+	  offsetof(struct gfs_dircache_profile, dir_cache_hit) },
+	{ "dir_cache_miss", "dir cache miss     : %llu", "%llu", 'l',
+	  offsetof(struct gfs_dircache_profile, dir_cache_miss) },
+	{ "path_cache_hit", "path cache hit     : %llu", "%llu", 'l',
+	  offsetof(struct gfs_dircache_profile, path_cache_hit) },
+	{ "path_cache_miss", "path cache miss    : %llu", "%llu", 'l',
+	  offsetof(struct gfs_dircache_profile, path_cache_miss) },
+};
+
+void
+gfs_dircache_display_timers(void)
+{
+	int n = GFARM_ARRAY_LENGTH(dircache_profile_items);
+
+	gfs_profile_display_timers(n, dircache_profile_items,
+	    &dircache_profile);
+}
+
+gfarm_error_t
+gfs_dircache_profile_value(const char *name, char *value, size_t *sizep)
+{
+	int n = GFARM_ARRAY_LENGTH(dircache_profile_items);
+
+	return (gfs_profile_value(name, n, dircache_profile_items,
+		    &dircache_profile, value, sizep));
+}
@@ -1,7 +1,14 @@
 gfarm_error_t gfs_stat_cached_internal(const char *, struct gfs_stat *);
 gfarm_error_t gfs_lstat_cached_internal(const char *, struct gfs_stat *);
+gfarm_error_t gfs_lstat_prefetch_internal(int, const char **);
 gfarm_error_t gfs_opendir_caching_internal(const char *, GFS_Dir *);
 gfarm_error_t gfs_getxattr_cached_internal(const char *, const char *,
 	void *, size_t *);
 gfarm_error_t gfs_lgetxattr_cached_internal(const char *, const char *,
 	void *, size_t *);
+void gfs_dircache_invalidate(const char *);
+void gfs_dircache_invalidate_tree(const char *);
+int gfs_path_cache_lookup(const char *, gfarm_ino_t *, gfarm_uint64_t *);
+void gfs_path_cache_enter(const char *, gfarm_ino_t, gfarm_uint64_t);
+void gfs_path_cache_profile(int);
+void gfs_path_cache_clear(void);
@@ -7,6 +7,7 @@
 #include "context.h"
 #include "gfm_client.h"
 #include "lookup.h"
+#include "gfs_dircache.h"
 
 struct gfm_link_closure {
 	/* input, for gfarm_file_trace */
@@ -81,7 +82,8 @@ gfs_link(const char *src, const char *dst)
 			"Creation of link (%s)(%s) failed: %s",
 			src, dst,
 			gfarm_error_string(e));
-	}
+	} else
+		gfs_dircache_invalidate(dst);
 	return (e);
 }
 
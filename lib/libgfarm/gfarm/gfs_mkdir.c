@@ -10,6 +10,7 @@
 #include "gfm_client.h"
 #include "config.h"
 #include "lookup.h"
+#include "gfs_dircache.h"
 
 struct gfm_mkdir_closure {
 	/* input */
@@ -56,11 +57,15 @@ gfarm_error_t
 gfs_mkdir(const char *path, gfarm_mode_t mode)
 {
 	struct gfm_mkdir_closure closure;
+	gfarm_error_t e;
 
 	closure.mode = mode;
-	return (gfm_name_op_modifiable(path, GFARM_ERR_ALREADY_EXISTS,
+	e = gfm_name_op_modifiable(path, GFARM_ERR_ALREADY_EXISTS,
 	    gfm_mkdir_request,
 	    gfm_mkdir_result,
 	    gfm_name_success_op_connection_free,
-	    gfm_mkdir_must_be_warned, &closure));
+	    gfm_mkdir_must_be_warned, &closure);
+	if (e == GFARM_ERR_NO_ERROR)
+		gfs_dircache_invalidate(path);
+	return (e);
 }
@@ -11,6 +11,7 @@
 #include <string.h>
 #include <unistd.h>	/* [FRWX]_OK */
 #include <errno.h>
+#include <limits.h> /* INT_MAX */
 #include <pthread.h>
 
 #include <openssl/evp.h>
@@ -40,6 +41,7 @@
 #include "gfp_xdr.h"
 #include "gfs_failover.h"
 #include "gfs_file_list.h"
+#include "gfs_dircache.h"
 
 #define staticp	(gfarm_ctxp->gfs_pio_static)
 
@@ -56,6 +58,10 @@ struct gfarm_gfs_pio_static {
 	unsigned long long read_count, write_count;
 	unsigned long long sync_count, datasync_count;
 	unsigned long long getline_count, getc_count, putc_count;
+
+	/* total of the buffers enlarged by gfs_pio_enlarge_read_buffer() */
+	pthread_mutex_t read_ahead_mutex;
+	long long read_ahead_size;
 };
 
 static gfarm_error_t flush_internal(GFS_File gf);
@@ -96,6 +102,10 @@ gfarm_gfs_pio_static_init(struct gfarm_context *ctxp)
 	s->getc_count =
 	s->putc_count = 0;
 
+	gfarm_mutex_init(&s->read_ahead_mutex, "gfs_pio_static_init",
+	    "read_ahead");
+	s->read_ahead_size = 0;
+
 	ctxp->gfs_pio_static = s;
 	return (GFARM_ERR_NO_ERROR);
 }
@@ -103,7 +113,13 @@ gfarm_gfs_pio_static_init(struct gfarm_context *ctxp)
 void
 gfarm_gfs_pio_static_term(struct gfarm_context *ctxp)
 {
-	free(ctxp->gfs_pio_static);
+	struct gfarm_gfs_pio_static *s = ctxp->gfs_pio_static;
+
+	if (s == NULL)
+		return;
+	gfarm_mutex_destroy(&s->read_ahead_mutex, "gfs_pio_static_term",
+	    "read_ahead");
+	free(s);
 }
 
 struct gfs_file_list {
@@ -473,9 +489,12 @@ gfs_file_alloc(struct gfm_connection *gfm_server, gfarm_int32_t fd, int flags,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+static void gfs_pio_release_read_buffer(GFS_File);
+
 static void
 gfs_file_free(GFS_File gf)
 {
+	gfs_pio_release_read_buffer(gf);
 	free(gf->buffer);
 	free(gf->url);
 	free(gf->md.cksum_type);
@@ -654,6 +673,7 @@ gfs_pio_create_igen(const char *url, int flags, gfarm_mode_t mode,
 			*inop = inum;
 		if (genp)
 			*genp = gen;
+		gfs_dircache_invalidate(url);
 	} else {
 		gflog_debug(GFARM_MSG_1001296,
 			"creation of file descriptor for URL (%s): %s",
@@ -1006,6 +1026,66 @@ gfs_pio_purge(GFS_File gf)
 	} \
 }
 
+/*
+ * when a read-only file is read sequentially, enlarge the buffer,
+ * so that the storage layer can keep client_file_read_window
+ * requests in flight.  the buffer is never shrunk.
+ *
+ * the enlarged part of the buffers of all files in this process is
+ * limited by client_file_read_ahead_limit, so that a process which
+ * reads many files at once doesn't consume window * 1MiB for each.
+ */
+static void
+gfs_pio_enlarge_read_buffer(GFS_File gf)
+{
+	int window = gfarm_ctxp->client_file_read_window, newsize, ok;
+	char *buffer;
+	static const char diag[] = "gfs_pio_enlarge_read_buffer";
+
+	if ((gf->mode & GFS_FILE_MODE_WRITE) != 0 || window <= 1)
+		return;
+	if (window > INT_MAX / GFS_PROTO_MAX_IOSIZE)
+		window = INT_MAX / GFS_PROTO_MAX_IOSIZE;
+	newsize = window * GFS_PROTO_MAX_IOSIZE;
+	if (gf->bufsize < GFS_PROTO_MAX_IOSIZE || gf->bufsize >= newsize)
+		return;
+
+	gfarm_mutex_lock(&staticp->read_ahead_mutex, diag, "read_ahead");
+	ok = staticp->read_ahead_size + newsize - gf->bufsize <=
+	    gfarm_ctxp->client_file_read_ahead_limit;
+	if (ok)
+		staticp->read_ahead_size += newsize - gf->bufsize;
+	gfarm_mutex_unlock(&staticp->read_ahead_mutex, diag, "read_ahead");
+	if (!ok) /* keep using the current buffer */
+		return;
+
+	GFARM_REALLOC_ARRAY(buffer, gf->buffer, newsize);
+	if (buffer == NULL) { /* keep using the current buffer */
+		gfarm_mutex_lock(&staticp->read_ahead_mutex, diag,
+		    "read_ahead");
+		staticp->read_ahead_size -= newsize - gf->bufsize;
+		gfarm_mutex_unlock(&staticp->read_ahead_mutex, diag,
+		    "read_ahead");
+		return;
+	}
+	gf->buffer = buffer;
+	gf->read_ahead_size += newsize - gf->bufsize;
+	gf->bufsize = newsize;
+}
+
+static void
+gfs_pio_release_read_buffer(GFS_File gf)
+{
+	static const char diag[] = "gfs_pio_release_read_buffer";
+
+	if (gf->read_ahead_size == 0)
+		return;
+	gfarm_mutex_lock(&staticp->read_ahead_mutex, diag, "read_ahead");
+	staticp->read_ahead_size -= gf->read_ahead_size;
+	gfarm_mutex_unlock(&staticp->read_ahead_mutex, diag, "read_ahead");
+	gf->read_ahead_size = 0;
+}
+
 static gfarm_error_t
 gfs_pio_fillbuf(GFS_File gf, size_t size)
 {
@@ -1044,6 +1124,10 @@ gfs_pio_fillbuf(GFS_File gf, size_t size)
 
 	if (gf->io_offset != gf->offset) {
 		gf->io_offset = gf->offset;
+	} else if (gf->io_offset > 0 && size == gf->bufsize) {
+		/* sequential access */
+		gfs_pio_enlarge_read_buffer(gf);
+		size = gf->bufsize;
 	}
 
 	do {
@@ -74,11 +74,14 @@ struct gfs_file {
 
 /*
  * bufsize should be equal to or less than
- * GFS_PROTO_MAX_IOSIZE defined in gfs_proto.h.
+ * GFS_PROTO_MAX_IOSIZE defined in gfs_proto.h,
+ * except the read-ahead buffer of a read-only file
+ * (see gfs_pio_enlarge_read_buffer()).
  */
 	char *buffer;
 
 	int bufsize;
+	int read_ahead_size; /* the enlarged part of bufsize */
 	int p;
 	int length;
 
@@ -345,7 +345,17 @@ notrdma:
 		gfs_client_connection_unlock(gfs_server);
 	}
 #endif
-	e = gfs_client_pread(gfs_server, gf->fd, buffer, size, offset,
+	/*
+	 * a large read is split into multiple GFS_PROTO_PREAD requests
+	 * which are pipelined, to hide the network latency.
+	 */
+	if (size > GFS_PROTO_MAX_IOSIZE &&
+	    gfarm_ctxp->client_file_read_window > 1)
+		e = gfs_client_pread_pipelined(gfs_server, gf->fd,
+		    buffer, size, offset, gfarm_ctxp->client_file_read_window,
+		    lengthp);
+	else
+		e = gfs_client_pread(gfs_server, gf->fd, buffer, size, offset,
 					lengthp);
 
 	if (e != GFARM_ERR_NO_ERROR)
@@ -34,6 +34,7 @@ void gfs_pio_section_display_timers(void);
 void gfs_pio_local_display_timers(void);
 void gfs_pio_remote_display_timers(void);
 void gfs_stat_display_timers(void);
+void gfs_dircache_display_timers(void);
 void gfs_unlink_display_timers(void);
 void gfs_xattr_display_timers(void);
 
@@ -42,5 +43,6 @@ gfarm_error_t gfs_pio_section_profile_value(const char *, char *, size_t *);
 gfarm_error_t gfs_pio_local_profile_value(const char *, char *, size_t *);
 gfarm_error_t gfs_pio_remote_profile_value(const char *, char *, size_t *);
 gfarm_error_t gfs_stat_profile_value(const char *, char *, size_t *);
+gfarm_error_t gfs_dircache_profile_value(const char *, char *, size_t *);
 gfarm_error_t gfs_unlink_profile_value(const char *, char *, size_t *);
 gfarm_error_t gfs_xattr_profile_value(const char *, char *, size_t *);
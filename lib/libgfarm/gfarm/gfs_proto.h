@@ -14,12 +14,14 @@
  * 2: protocol since gfarm 2.4
  * 3: protocol since gfarm 2.6
  * 4: protocol since gfarm 2.7.13
+ * 5: protocol since gfarm 2.8.4
  */
 #define GFS_PROTOCOL_VERSION_V2_3	1
 #define GFS_PROTOCOL_VERSION_V2_4	2
 #define GFS_PROTOCOL_VERSION_V2_6	3
 #define GFS_PROTOCOL_VERSION_V2_7_13	4
-#define GFS_PROTOCOL_VERSION		GFS_PROTOCOL_VERSION_V2_7_13
+#define GFS_PROTOCOL_VERSION_V2_8_4	5
+#define GFS_PROTOCOL_VERSION		GFS_PROTOCOL_VERSION_V2_8_4
 
 enum gfs_proto_command {
 	/* from client */
@@ -82,11 +84,15 @@ enum gfs_proto_command {
 
 	/* from gfmd (i.e. back channel) */
 	GFS_PROTO_STATUS2,			/* since gfarm-2.7.13 */
+	GFS_PROTO_FHREMOVE_MULTI,		/* since gfarm-2.8.4 */
 
 };
 
 #define GFS_PROTO_MAX_IOSIZE	(1024 * 1024)
 
+/* max number of files removed by a GFS_PROTO_FHREMOVE_MULTI request */
+#define GFS_PROTO_MAX_FHREMOVE_MULTI	256
+
 /*
  * sub protocols of GFS_PROTO_COMMAND
  */
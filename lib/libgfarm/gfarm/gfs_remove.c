@@ -10,6 +10,7 @@
 #include "context.h"
 #include "gfm_client.h"
 #include "lookup.h"
+#include "gfs_dircache.h"
 
 struct gfm_remove_closure {
 	/* input */
@@ -70,13 +71,17 @@ gfarm_error_t
 gfs_remove(const char *path)
 {
 	struct gfm_remove_closure closure;
+	gfarm_error_t e;
 
 	closure.path = path;
-	return (gfm_name_op_modifiable(path,
+	e = gfm_name_op_modifiable(path,
 	    GFARM_ERR_DEVICE_BUSY,
 	    gfm_remove_request,
 	    gfm_remove_result,
 	    gfm_name_success_op_connection_free,
 	    gfm_remove_must_be_warned,
-	    &closure));
+	    &closure);
+	if (e == GFARM_ERR_NO_ERROR)
+		gfs_dircache_invalidate(path);
+	return (e);
 }
@@ -7,6 +7,7 @@
 #include "context.h"
 #include "gfm_client.h"
 #include "lookup.h"
+#include "gfs_dircache.h"
 
 struct gfm_rename_closure {
 	/* input, for gfarm_file_trace */
@@ -80,6 +81,11 @@ gfs_rename(const char *src, const char *dst)
 			"error occurred during gfs_rename(%s)(%s): %s",
 			src, dst,
 			gfarm_error_string(e));
+	} else {
+		/* either may be a directory */
+		gfs_dircache_invalidate_tree(src);
+		gfs_dircache_invalidate_tree(dst);
+		gfs_path_cache_clear();
 	}
 	return (e);
 }
@@ -4,6 +4,7 @@
 
 #include <stdio.h>	/* config.h needs FILE */
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
 
@@ -87,6 +88,187 @@ gfs_replica_list_by_name(const char *path, int *np, char ***hostsp)
 	return (e);
 }
 
+/*
+ * number of entries looked up by a COMPOUND request of
+ * gfs_replica_list_by_name_multi().
+ * this has to be small enough for the requests to fit in a socket buffer,
+ * since replies are not read until all requests are sent.
+ */
+#define GFS_REPLICA_LIST_MULTI_MAX	64
+
+struct gfm_replica_list_by_name_multi_closure {
+	int n;
+	const char **names;
+	int *ns;
+	char ***hostss;
+	gfarm_error_t *errs;
+	int ndone; /* number of entries whose result has been received */
+};
+
+static void
+gfm_replica_list_by_name_multi_cleanup(struct gfm_connection *gfm_server,
+	void *closure)
+{
+	struct gfm_replica_list_by_name_multi_closure *c = closure;
+	int i;
+
+	for (i = 0; i < c->ndone; i++) {
+		if (c->errs[i] == GFARM_ERR_NO_ERROR)
+			gfarm_strings_free_deeply(c->ns[i], c->hostss[i]);
+	}
+	c->ndone = 0;
+}
+
+/*
+ * SAVE_FD remembers the parent directory, and each RESTORE_FD makes it
+ * current again.  the entry opened by the previous OPEN is closed by
+ * RESTORE_FD, and the last one is closed by COMPOUND_END.
+ */
+static gfarm_error_t
+gfm_replica_list_by_name_multi_request(struct gfm_connection *gfm_server,
+	void *closure)
+{
+	struct gfm_replica_list_by_name_multi_closure *c = closure;
+	gfarm_error_t e;
+	int i;
+
+	/* in case of a retry after failover */
+	gfm_replica_list_by_name_multi_cleanup(gfm_server, closure);
+
+	if ((e = gfm_client_save_fd_request(gfm_server))
+	    != GFARM_ERR_NO_ERROR) {
+		gflog_warning(GFARM_MSG_1005816, "save_fd request: %s",
+		    gfarm_error_string(e));
+		return (e);
+	}
+	for (i = 0; i < c->n; i++) {
+		if ((e = gfm_client_restore_fd_request(gfm_server))
+		    != GFARM_ERR_NO_ERROR)
+			gflog_warning(GFARM_MSG_1005817,
+			    "restore_fd request: %s", gfarm_error_string(e));
+		else if ((e = gfm_client_open_request(gfm_server,
+		    c->names[i], strlen(c->names[i]), GFARM_FILE_LOOKUP))
+		    != GFARM_ERR_NO_ERROR)
+			gflog_warning(GFARM_MSG_1005818,
+			    "open(%s) request: %s", c->names[i],
+			    gfarm_error_string(e));
+		else if ((e = gfm_client_replica_list_by_name_request(
+		    gfm_server)) != GFARM_ERR_NO_ERROR)
+			gflog_warning(GFARM_MSG_1005819,
+			    "replica_list_by_name request: %s",
+			    gfarm_error_string(e));
+		if (e != GFARM_ERR_NO_ERROR)
+			return (e);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * gfmd skips the rest of the COMPOUND block after the first error,
+ * thus this stops at the first entry which failed.
+ */
+static gfarm_error_t
+gfm_replica_list_by_name_multi_result(struct gfm_connection *gfm_server,
+	void *closure)
+{
+	struct gfm_replica_list_by_name_multi_closure *c = closure;
+	gfarm_error_t e;
+	gfarm_ino_t ino;
+	gfarm_uint64_t gen;
+	gfarm_mode_t mode;
+	char *link;
+	int i;
+
+	if ((e = gfm_client_save_fd_result(gfm_server))
+	    != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_1005820, "save_fd result: %s",
+		    gfarm_error_string(e));
+		return (e);
+	}
+	for (i = 0; i < c->n; i++) {
+		if ((e = gfm_client_restore_fd_result(gfm_server))
+		    == GFARM_ERR_NO_ERROR &&
+		    (e = gfm_client_open_result(gfm_server,
+		    &ino, &gen, &mode)) == GFARM_ERR_NO_ERROR)
+			e = gfm_client_replica_list_by_name_result(
+			    gfm_server, &c->ns[i], &c->hostss[i]);
+		c->errs[i] = e;
+		c->ndone = i + 1;
+		if (e == GFARM_ERR_NO_ERROR)
+			continue;
+		gflog_debug(GFARM_MSG_1005821,
+		    "replica_list_by_name_multi(%s) result: %s",
+		    c->names[i], gfarm_error_string(e));
+		/* the READLINK of gfm_inode_op() is processed in this case */
+		if (e == GFARM_ERR_IS_A_SYMBOLIC_LINK &&
+		    gfm_client_readlink_result(gfm_server, &link)
+		    == GFARM_ERR_NO_ERROR)
+			free(link);
+		return (e);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+gfs_replica_list_by_name_in_dir(const char *dir, const char *name,
+	int *np, char ***hostsp)
+{
+	gfarm_error_t e;
+	size_t len = strlen(dir);
+	char *path;
+
+	GFARM_MALLOC_ARRAY(path, len + 1 + strlen(name) + 1);
+	if (path == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	sprintf(path, "%s%s%s",
+	    dir, len > 0 && dir[len - 1] == '/' ? "" : "/", name);
+	e = gfs_replica_list_by_name(path, np, hostsp);
+	free(path);
+	return (e);
+}
+
+/*
+ * gfs_replica_list_by_name() for entries in a same directory,
+ * by a COMPOUND request per GFS_REPLICA_LIST_MULTI_MAX entries.
+ * the result of each entry is returned in errs[], and hostss[] has to be
+ * freed by gfarm_strings_free_deeply() if the entry succeeded.
+ */
+gfarm_error_t
+gfs_replica_list_by_name_multi(const char *dir, int n, const char **names,
+	int *ns, char ***hostss, gfarm_error_t *errs)
+{
+	struct gfm_replica_list_by_name_multi_closure closure;
+	int i, j, nresult;
+
+	for (i = 0; i < n; i += nresult) {
+		closure.n = n - i < GFS_REPLICA_LIST_MULTI_MAX ?
+		    n - i : GFS_REPLICA_LIST_MULTI_MAX;
+		closure.names = &names[i];
+		closure.ns = &ns[i];
+		closure.hostss = &hostss[i];
+		closure.errs = &errs[i];
+		closure.ndone = 0;
+		(void)gfm_inode_op_readonly(dir, GFARM_FILE_LOOKUP,
+		    gfm_replica_list_by_name_multi_request,
+		    gfm_replica_list_by_name_multi_result,
+		    gfm_inode_success_op_connection_free,
+		    gfm_replica_list_by_name_multi_cleanup,
+		    &closure);
+		/*
+		 * fall back to gfs_replica_list_by_name(), if an entry failed,
+		 * e.g. due to a symbolic link to be followed,
+		 * or if the COMPOUND request failed as a whole.
+		 */
+		nresult = closure.ndone > 0 ? closure.ndone : closure.n;
+		for (j = i; j < i + nresult; j++) {
+			if (closure.ndone == 0 || errs[j] != GFARM_ERR_NO_ERROR)
+				errs[j] = gfs_replica_list_by_name_in_dir(
+				    dir, names[j], &ns[j], &hostss[j]);
+		}
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
 
 
 struct gfm_replica_remove_by_file_closure {
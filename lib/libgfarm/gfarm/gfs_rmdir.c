@@ -2,6 +2,8 @@
 
 #include <gfarm/gfarm.h>
 
+#include "gfs_dircache.h"
+
 gfarm_error_t
 gfs_rmdir(const char *path)
 {
@@ -29,5 +31,8 @@ gfs_rmdir(const char *path)
 
 	/* XXX FIXME there is race condition here */
 
-	return (gfs_remove(path));
+	e = gfs_remove(path);
+	if (e == GFARM_ERR_NO_ERROR)
+		gfs_dircache_invalidate_tree(path);
+	return (e);
 }
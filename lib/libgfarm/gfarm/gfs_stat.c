@@ -153,6 +153,196 @@ gfs_lstat(const char *path, struct gfs_stat *s)
 	return (e);
 }
 
+static gfarm_error_t
+gfm_lstat_multi_rpc(struct gfm_connection *gfm_server,
+	int npaths, const char **paths, struct gfs_stat *sts,
+	gfarm_error_t *errs)
+{
+	gfarm_error_t e;
+	int i;
+
+	if ((e = gfm_client_compound_begin_request(gfm_server))
+	    != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005769,
+		    "compound_begin request: %s", gfarm_error_string(e));
+	else if ((e = gfm_client_open_root_request(gfm_server,
+	    GFARM_FILE_LOOKUP)) != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005770,
+		    "open_root request: %s", gfarm_error_string(e));
+	else if ((e = gfm_client_lstat_multi_request(gfm_server,
+	    npaths, paths)) != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005771,
+		    "lstat_multi request: %s", gfarm_error_string(e));
+	else if ((e = gfm_client_close_request(gfm_server))
+	    != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005772,
+		    "close request: %s", gfarm_error_string(e));
+	else if ((e = gfm_client_compound_end_request(gfm_server))
+	    != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005773,
+		    "compound_end request: %s", gfarm_error_string(e));
+
+	else if ((e = gfm_client_compound_begin_result(gfm_server))
+	    != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005774,
+		    "compound_begin result: %s", gfarm_error_string(e));
+	else if ((e = gfm_client_open_root_result(gfm_server))
+	    != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005775,
+		    "open_root result: %s", gfarm_error_string(e));
+	else if ((e = gfm_client_lstat_multi_result(gfm_server,
+	    npaths, sts, errs)) != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005776,
+		    "lstat_multi result: %s", gfarm_error_string(e));
+	else {
+		if ((e = gfm_client_close_result(gfm_server))
+		    != GFARM_ERR_NO_ERROR)
+			gflog_debug(GFARM_MSG_1005777,
+			    "close result: %s", gfarm_error_string(e));
+		else if ((e = gfm_client_compound_end_result(gfm_server))
+		    != GFARM_ERR_NO_ERROR)
+			gflog_debug(GFARM_MSG_1005778,
+			    "compound_end result: %s", gfarm_error_string(e));
+
+		/* the caller falls back to gfs_lstat(), overwriting sts[] */
+		if (e != GFARM_ERR_NO_ERROR) {
+			for (i = 0; i < npaths; i++) {
+				if (errs[i] == GFARM_ERR_NO_ERROR)
+					gfs_stat_free(&sts[i]);
+			}
+		}
+	}
+	return (e);
+}
+
+/* paths which are served by same metadata server are sent at once */
+static void
+gfs_lstat_multi_batch(struct gfm_connection *gfm_server,
+	int npaths, const char **paths, const char **rpaths,
+	struct gfs_stat *sts, gfarm_error_t *errs)
+{
+	gfarm_error_t e;
+	int i;
+
+	gfm_client_connection_lock(gfm_server);
+	e = gfm_lstat_multi_rpc(gfm_server, npaths, rpaths, sts, errs);
+	gfm_client_connection_unlock(gfm_server);
+
+	for (i = 0; i < npaths; i++) {
+		/*
+		 * fall back to gfs_lstat() if the RPC failed,
+		 * e.g. due to failover, or if a symbolic link has to be
+		 * resolved on the client side.
+		 */
+		if (e != GFARM_ERR_NO_ERROR ||
+		    errs[i] == GFARM_ERR_IS_A_SYMBOLIC_LINK) {
+			errs[i] = gfs_lstat(paths[i], &sts[i]);
+			continue;
+		}
+		if (errs[i] == GFARM_ERR_NO_ERROR &&
+		    GFARM_S_IS_SUGID_PROGRAM(sts[i].st_mode) &&
+		    !gfm_is_mounted(gfm_server)) {
+			/* see gfm_stat_result() */
+			sts[i].st_mode &= ~(GFARM_S_ISUID|GFARM_S_ISGID);
+		}
+	}
+}
+
+/*
+ * lstat of multiple paths, with one round trip for each metadata server.
+ * errs[i] is set for each path, and sts[i] is only valid if errs[i] is
+ * GFARM_ERR_NO_ERROR.
+ * GFM_PROTO_LSTAT_MULTI is only used if lstat_multi_rpc is enabled,
+ * because a gfmd which doesn't support it closes the connection.
+ */
+gfarm_error_t
+gfs_lstat_multi(int npaths, const char **paths, struct gfs_stat *sts,
+	gfarm_error_t *errs)
+{
+	gfarm_timerval_t t1, t2;
+	struct gfm_connection **servers;
+	const char **rpaths, **bpaths, **brpaths;
+	struct gfs_stat *bsts;
+	gfarm_error_t *berrs;
+	int i, j, n, *bindex;
+
+	GFARM_KERNEL_UNUSE2(t1, t2);
+	GFARM_TIMEVAL_FIX_INITIALIZE_WARNING(t1);
+	gfs_profile(gfarm_gettimerval(&t1));
+
+	if (npaths <= 0)
+		return (GFARM_ERR_NO_ERROR);
+	if (!gfarm_ctxp->lstat_multi_rpc) {
+		for (i = 0; i < npaths; i++)
+			errs[i] = gfs_lstat(paths[i], &sts[i]);
+		return (GFARM_ERR_NO_ERROR);
+	}
+	n = npaths < GFM_PROTO_MAX_LSTAT_MULTI ?
+	    npaths : GFM_PROTO_MAX_LSTAT_MULTI;
+	GFARM_CALLOC_ARRAY(servers, npaths);
+	GFARM_MALLOC_ARRAY(rpaths, npaths);
+	GFARM_MALLOC_ARRAY(bpaths, n);
+	GFARM_MALLOC_ARRAY(brpaths, n);
+	GFARM_MALLOC_ARRAY(bsts, n);
+	GFARM_MALLOC_ARRAY(berrs, n);
+	GFARM_MALLOC_ARRAY(bindex, n);
+	if (servers == NULL || rpaths == NULL || bpaths == NULL ||
+	    brpaths == NULL || bsts == NULL || berrs == NULL ||
+	    bindex == NULL) {
+		free(servers);
+		free(rpaths);
+		free(bpaths);
+		free(brpaths);
+		free(bsts);
+		free(berrs);
+		free(bindex);
+		gflog_debug(GFARM_MSG_1005779,
+		    "gfs_lstat_multi(%d): no memory", npaths);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+
+	for (i = 0; i < npaths; i++) {
+		rpaths[i] = paths[i];
+		if ((errs[i] = gfarm_url_parse_metadb(&rpaths[i], &servers[i]))
+		    != GFARM_ERR_NO_ERROR)
+			servers[i] = NULL;
+	}
+	for (i = 0; i < npaths; i++) {
+		if (servers[i] == NULL)
+			continue;
+		n = 0;
+		for (j = i; j < npaths && n < GFM_PROTO_MAX_LSTAT_MULTI; j++) {
+			if (servers[j] != servers[i])
+				continue;
+			bindex[n] = j;
+			bpaths[n] = paths[j];
+			brpaths[n] = rpaths[j];
+			n++;
+		}
+		gfs_lstat_multi_batch(servers[i], n, bpaths, brpaths,
+		    bsts, berrs);
+		for (j = 0; j < n; j++) {
+			sts[bindex[j]] = bsts[j];
+			errs[bindex[j]] = berrs[j];
+			gfm_client_connection_free(servers[bindex[j]]);
+			servers[bindex[j]] = NULL;
+		}
+	}
+	free(servers);
+	free(rpaths);
+	free(bpaths);
+	free(brpaths);
+	free(bsts);
+	free(berrs);
+	free(bindex);
+
+	gfs_profile(gfarm_gettimerval(&t2));
+	gfs_profile(staticp->stat_time += gfarm_timerval_sub(&t2, &t1));
+	gfs_profile(staticp->stat_count += npaths);
+
+	return (GFARM_ERR_NO_ERROR);
+}
+
 gfarm_error_t
 gfs_fstat(GFS_File gf, struct gfs_stat *s)
 {
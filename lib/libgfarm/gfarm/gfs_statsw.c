@@ -11,18 +11,26 @@ struct gfs_statsw {
 		void *value, size_t *size);
 	gfarm_error_t (*lgetxattr)(const char *path, const char *name,
 		void *value, size_t *size);
+	gfarm_error_t (*lstat_prefetch)(int, const char **);
 };
 
 /*
  * for gfs_statsw_uncached
  */
 
+static gfarm_error_t
+gfs_lstat_prefetch_uncached(int npaths, const char **paths)
+{
+	return (GFARM_ERR_NO_ERROR);
+}
+
 static struct gfs_statsw gfs_statsw_uncached = {
 	gfs_opendir,
 	gfs_stat,
 	gfs_lstat,
 	gfs_getxattr,
 	gfs_lgetxattr,
+	gfs_lstat_prefetch_uncached,
 };
 
 /*
@@ -35,6 +43,7 @@ static struct gfs_statsw gfs_statsw_cached = {
 	gfs_lstat_cached_internal,
 	gfs_getxattr_cached_internal,
 	gfs_lgetxattr_cached_internal,
+	gfs_lstat_prefetch_internal,
 };
 
 /*
@@ -74,6 +83,13 @@ gfs_lgetxattr_cached(const char *path, const char *name,
 	return ((*gfs_statsw->lgetxattr)(path, name, value, sizep));
 }
 
+/* make following gfs_lstat_cached() and gfs_stat_cached() hit */
+gfarm_error_t
+gfs_lstat_prefetch(int npaths, const char **paths)
+{
+	return ((*gfs_statsw->lstat_prefetch)(npaths, paths));
+}
+
 void
 gfs_stat_cache_enable(int enable)
 {
@@ -10,6 +10,7 @@
 #include "context.h"
 #include "gfm_client.h"
 #include "lookup.h"
+#include "gfs_dircache.h"
 
 struct gfm_symlink_closure {
 	/* input */
@@ -72,13 +73,17 @@ gfarm_error_t
 gfs_symlink(const char *src, const char *path)
 {
 	struct gfm_symlink_closure closure;
+	gfarm_error_t e;
 
 	closure.src = src;
 	closure.path = path;
-	return (gfm_name_op_modifiable(path, GFARM_ERR_OPERATION_NOT_PERMITTED,
+	e = gfm_name_op_modifiable(path, GFARM_ERR_OPERATION_NOT_PERMITTED,
 	    gfm_symlink_request,
 	    gfm_symlink_result,
 	    gfm_name_success_op_connection_free,
 	    gfm_symlink_must_be_warned,
-	    &closure));
+	    &closure);
+	if (e == GFARM_ERR_NO_ERROR)
+		gfs_dircache_invalidate(path);
+	return (e);
 }
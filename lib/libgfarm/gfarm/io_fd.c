@@ -13,11 +13,16 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <unistd.h>
+#include <limits.h> /* PIPE_BUF */
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <netdb.h> /* for NI_MAXHOST, NI_NUMERICHOST, etc */
+#include <fcntl.h>
+#ifdef HAVE_LINUX_SENDFILE
+#include <sys/sendfile.h>
+#endif
 
 #include <gfarm/error.h>
 #include <gfarm/gfarm_misc.h>
@@ -298,3 +303,266 @@ gfp_xdr_set_socket(struct gfp_xdr *conn, int fd)
 	gfp_xdr_set(conn, &gfp_xdr_socket_iobuffer_ops, NULL, fd);
 	return (GFARM_ERR_NO_ERROR);
 }
+
+int
+gfp_xdr_is_socket(struct gfp_xdr *conn)
+{
+	return (gfp_xdr_iobuffer_ops(conn) == &gfp_xdr_socket_iobuffer_ops);
+}
+
+#if defined(HAVE_LINUX_SENDFILE) || defined(HAVE_LINUX_SPLICE)
+
+/*
+ * zero-copy transfer between a socket and a file.
+ * these bypass the iobuffers of the gfp_xdr, thus the caller has to
+ * flush the sendbuffer or to consume the recvbuffer beforehand.
+ */
+
+/* wait until `fd' becomes ready for `events', with network_*_timeout */
+gfarm_error_t
+gfp_xdr_socket_wait(int fd, int events)
+{
+	int avail, timeout = (events & POLLIN) != 0 ?
+	    gfarm_ctxp->network_receive_timeout :
+	    gfarm_ctxp->network_send_timeout;
+	struct pollfd fds[1];
+	const char *hostaddr_prefix, *hostaddr;
+	char hostbuf[NI_MAXHOST];
+
+	for (;;) {
+		fds[0].fd = fd;
+		fds[0].events = events;
+		fds[0].revents = 0;
+		avail = poll(fds, 1, timeout == 0 ? -1 : timeout * 1000);
+		if (avail == -1) {
+			if (errno == EINTR)
+				continue;
+			return (gfarm_errno_to_error(errno));
+		}
+		if (avail > 0)
+			return (GFARM_ERR_NO_ERROR);
+
+		gfarm_peer_name_string(fd, hostbuf, sizeof(hostbuf),
+		    NI_NUMERICHOST | NI_NUMERICSERV,
+		    &hostaddr_prefix, &hostaddr);
+		if ((events & POLLIN) != 0)
+			gflog_error(GFARM_MSG_1005665,
+			    "closing network connection due to "
+			    "no response within %d seconds "
+			    "(network_receive_timeout) from %s%s",
+			    timeout, hostaddr_prefix, hostaddr);
+		else
+			gflog_error(GFARM_MSG_1005666,
+			    "closing network connection due to "
+			    "send blocking more than %d seconds "
+			    "(network_send_timeout) to %s%s",
+			    timeout, hostaddr_prefix, hostaddr);
+		return (GFARM_ERR_OPERATION_TIMED_OUT);
+	}
+}
+
+#endif /* defined(HAVE_LINUX_SENDFILE) || defined(HAVE_LINUX_SPLICE) */
+
+#ifdef HAVE_LINUX_SENDFILE
+
+/*
+ * send `len' bytes of `r_fd' from `r_off' to the socket by sendfile(2).
+ * *sentp is set, even if an error happens.
+ * SIGPIPE has to be ignored by the caller.
+ */
+gfarm_error_t
+gfp_xdr_socket_sendfile(struct gfp_xdr *conn, int r_fd, off_t r_off,
+	size_t len, size_t *sentp)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	int fd = gfp_xdr_fd(conn);
+	off_t off = r_off;
+	size_t sent = 0;
+	ssize_t rv;
+
+	while (sent < len) {
+		if ((e = gfp_xdr_socket_wait(fd, POLLOUT))
+		    != GFARM_ERR_NO_ERROR)
+			break;
+		rv = sendfile(fd, r_fd, &off, len - sent);
+		if (rv == -1) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			e = gfarm_errno_to_error(errno);
+			break;
+		}
+		if (rv == 0) { /* the file is truncated */
+			e = GFARM_ERR_UNEXPECTED_EOF;
+			break;
+		}
+		sent += rv;
+	}
+	*sentp = sent;
+	return (e);
+}
+
+#endif /* HAVE_LINUX_SENDFILE */
+
+#ifdef HAVE_LINUX_SPLICE
+
+gfarm_error_t
+gfp_xdr_splice_pipe_open(int pipefd[2], size_t *capacityp)
+{
+	int rv;
+
+	if (pipe2(pipefd, O_CLOEXEC) == -1)
+		return (gfarm_errno_to_error(errno));
+#ifdef F_SETPIPE_SZ
+	/* a bigger pipe reduces the number of splice(2) calls */
+	(void)fcntl(pipefd[1], F_SETPIPE_SZ, GFP_XDR_SPLICE_PIPE_SIZE);
+#endif
+#ifdef F_GETPIPE_SZ
+	rv = fcntl(pipefd[1], F_GETPIPE_SZ);
+#else
+	rv = -1;
+#endif
+	/* at least PIPE_BUF bytes are guaranteed by POSIX */
+	*capacityp = rv > 0 ? rv : PIPE_BUF;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+void
+gfp_xdr_splice_pipe_close(int pipefd[2])
+{
+	close(pipefd[0]);
+	close(pipefd[1]);
+}
+
+/* read and discard `len' bytes which remain in the pipe */
+static void
+gfp_xdr_splice_pipe_drain(int pipe_rfd, size_t len)
+{
+	char buffer[PIPE_BUF];
+	ssize_t rv;
+
+	while (len > 0) {
+		rv = read(pipe_rfd, buffer,
+		    len < sizeof(buffer) ? len : sizeof(buffer));
+		if (rv == -1) {
+			if (errno == EINTR)
+				continue;
+			gflog_error_errno(GFARM_MSG_1005667,
+			    "draining pipe for splice(2)");
+			return;
+		}
+		if (rv == 0)
+			return;
+		len -= rv;
+	}
+}
+
+/*
+ * receive `len' bytes from the socket and write them to `w_fd' at `w_off'
+ * by splice(2) via the pipe `pipefd', which capacity is `pipe_capacity'.
+ *
+ * *receivedp is the number of bytes received from the socket,
+ * and *writtenp is the number of bytes written to `w_fd'.
+ * these are set, even if an error happens.
+ *
+ * if writing to `w_fd' fails, the error is stored to *w_errp,
+ * the data in the pipe is discarded, and this function returns
+ * without receiving the rest.  GFARM_ERR_OPERATION_NOT_SUPPORTED in *w_errp
+ * means that `w_fd' does not support splice(2), and the data in the pipe
+ * is written by write(2) in that case.
+ *
+ * return value: an error of the connection
+ */
+gfarm_error_t
+gfp_xdr_socket_splice_to_file(struct gfp_xdr *conn,
+	int pipefd[2], size_t pipe_capacity,
+	int w_fd, off_t w_off, size_t len,
+	size_t *receivedp, size_t *writtenp, gfarm_error_t *w_errp)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR, e_write = GFARM_ERR_NO_ERROR;
+	int fd = gfp_xdr_fd(conn);
+	loff_t off = w_off;
+	size_t received = 0, written = 0, in_pipe;
+	ssize_t rv;
+
+	while (received < len) {
+		if ((e = gfp_xdr_socket_wait(fd, POLLIN))
+		    != GFARM_ERR_NO_ERROR)
+			break;
+		rv = splice(fd, NULL, pipefd[1], NULL,
+		    len - received < pipe_capacity ?
+		    len - received : pipe_capacity,
+		    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (rv == -1) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			e = gfarm_errno_to_error(errno);
+			break;
+		}
+		if (rv == 0) {
+			e = GFARM_ERR_UNEXPECTED_EOF;
+			break;
+		}
+		received += rv;
+
+		/* the pipe is always emptied here to avoid deadlock */
+		for (in_pipe = rv; in_pipe > 0; ) {
+			rv = splice(pipefd[0], NULL, w_fd, &off, in_pipe,
+			    SPLICE_F_MOVE);
+			if (rv == -1) {
+				if (errno == EINTR)
+					continue;
+				e_write = errno == EINVAL ?
+				    GFARM_ERR_OPERATION_NOT_SUPPORTED :
+				    gfarm_errno_to_error(errno);
+				break;
+			}
+			if (rv == 0) { /* shouldn't happen */
+				e_write = GFARM_ERR_NO_SPACE;
+				break;
+			}
+			in_pipe -= rv;
+			written += rv;
+		}
+		if (e_write == GFARM_ERR_OPERATION_NOT_SUPPORTED) {
+			/* fall back to read(2) and write(2) */
+			char buffer[PIPE_BUF];
+			ssize_t sz, done;
+
+			while (in_pipe > 0) {
+				sz = read(pipefd[0], buffer,
+				    in_pipe < sizeof(buffer) ?
+				    in_pipe : sizeof(buffer));
+				if (sz <= 0) {
+					if (sz == -1 && errno == EINTR)
+						continue;
+					break;
+				}
+				in_pipe -= sz;
+				for (done = 0; done < sz; done += rv) {
+					rv = pwrite(w_fd, buffer + done,
+					    sz - done, off);
+					if (rv <= 0) {
+						e_write = rv == 0 ?
+						    GFARM_ERR_NO_SPACE :
+						    gfarm_errno_to_error(errno);
+						break;
+					}
+					off += rv;
+					written += rv;
+				}
+				if (done < sz)
+					break;
+			}
+		}
+		if (e_write != GFARM_ERR_NO_ERROR) {
+			gfp_xdr_splice_pipe_drain(pipefd[0], in_pipe);
+			break;
+		}
+	}
+	*receivedp = received;
+	*writtenp = written;
+	*w_errp = e_write;
+	return (e);
+}
+
+#endif /* HAVE_LINUX_SPLICE */
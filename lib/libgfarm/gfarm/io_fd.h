@@ -13,6 +13,24 @@ struct gfp_xdr;
 
 gfarm_error_t gfp_xdr_new_socket(int, struct gfp_xdr **);
 gfarm_error_t gfp_xdr_set_socket(struct gfp_xdr *, int);
+int gfp_xdr_is_socket(struct gfp_xdr *);
+
+/* zero-copy transfer between a plain socket and a file */
+#if defined(HAVE_LINUX_SENDFILE) || defined(HAVE_LINUX_SPLICE)
+gfarm_error_t gfp_xdr_socket_wait(int, int);
+#endif
+#ifdef HAVE_LINUX_SENDFILE
+gfarm_error_t gfp_xdr_socket_sendfile(struct gfp_xdr *, int, off_t,
+	size_t, size_t *);
+#endif
+#ifdef HAVE_LINUX_SPLICE
+#define GFP_XDR_SPLICE_PIPE_SIZE	(1024 * 1024)
+
+gfarm_error_t gfp_xdr_splice_pipe_open(int [2], size_t *);
+void gfp_xdr_splice_pipe_close(int [2]);
+gfarm_error_t gfp_xdr_socket_splice_to_file(struct gfp_xdr *, int [2], size_t,
+	int, off_t, size_t, size_t *, size_t *, gfarm_error_t *);
+#endif
 
 /* the followings are refered from "gsi_auth" method implementation */
 int gfarm_iobuffer_blocking_read_timeout_fd_op(struct gfarm_iobuffer *,
@@ -1,6 +1,7 @@
 #include <gfarm/gfarm_config.h>
 
 #include <pthread.h>
+#include <netdb.h>
 
 #ifdef HAVE_TLS_1_3
 
@@ -14,7 +15,11 @@
 #include "thrsubr.h"
 
 #include "config_openssl.h"
-#include "io_fd.h" /* for gfp_xdr_set_socket() */
+#include "io_fd.h" /* for gfp_xdr_set_socket() and gfp_xdr_socket_wait() */
+
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#define TLS_KTLS_AVAILABLE
+#endif
 
 /*
  * Gfarm iobuffer iops
@@ -45,6 +50,14 @@ gfp_io_tls_free(struct gfp_io_tls *io, const char *diag)
 	gfarm_mutex_lock(&io->mutex, diag, mutex_what);
 
 	e = tls_session_shutdown(ctx);
+	/*
+	 * OpenSSL invalidates the session of an SSL which isn't shut down,
+	 * but tls_session_shutdown() doesn't call SSL_shutdown().
+	 * keep the session resumable, unless an error happened.
+	 */
+	if (ctx != NULL && ctx->ssl_ != NULL && !ctx->is_got_fatal_ssl_error_)
+		SSL_set_shutdown(ctx->ssl_,
+		    SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
 	tls_session_destroy_ctx(ctx);
 
 	gfarm_mutex_unlock(&io->mutex, diag, mutex_what);
@@ -273,6 +286,205 @@ static struct gfp_iobuffer_ops gfp_xdr_tls_iobuf_ops = {
 	tls_iobufop_full_blocking_write,
 };
 
+/*
+ * TLS session resumption
+ *
+ * an SSL_CTX is created for each connection by tls_session_create_ctx(),
+ * thus neither the session cache nor the session ticket keys of OpenSSL
+ * survive the connection.  the followings are shared by the process:
+ * - servers: the keys to encrypt session tickets.
+ *   gfp_xdr_tls_initialize() has to be called before fork(2),
+ *   if the children should accept the tickets issued by each other.
+ * - clients: the received tickets, keyed by the address of the server.
+ *   a ticket is used only once, as RFC 8446 Appendix C.4 recommends.
+ *
+ * resumption is disabled with client certificates, because
+ * tls_verify_callback() isn't called for a resumed session, and the
+ * information about a proxy certificate would be lost.
+ */
+
+/* name (16 bytes), HMAC secret (32 bytes) and AES key (32 bytes) */
+static unsigned char tls_ticket_keys[80];
+static int tls_ticket_keys_available;
+static pthread_once_t tls_ticket_keys_once = PTHREAD_ONCE_INIT;
+
+#define TLS_SESSION_CACHE_SIZE	64
+#define TLS_SESSION_KEY_SIZE	80 /* "<numeric address>:<port>" */
+
+struct tls_session_cache_entry {
+	char key[TLS_SESSION_KEY_SIZE];
+	SSL_SESSION *session;
+};
+
+/* the most recently used one is at index 0 */
+static struct tls_session_cache_entry
+	tls_session_cache[TLS_SESSION_CACHE_SIZE];
+static int tls_session_cache_n;
+static pthread_mutex_t tls_session_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char tls_session_cache_diag[] = "tls_session_cache";
+static const char tls_session_cache_mutex_what[] = "tls_session_cache::mutex";
+
+static void
+tls_ticket_keys_init(void)
+{
+	tls_runtime_flush_error();
+	if (RAND_bytes(tls_ticket_keys, sizeof(tls_ticket_keys)) == 1)
+		tls_ticket_keys_available = 1;
+	else
+		gflog_tls_warning(GFARM_MSG_1005811,
+		    "cannot generate TLS session ticket keys, "
+		    "TLS session resumption is disabled");
+}
+
+/* returns 0, if the address of the peer is unknown */
+static int
+tls_session_cache_key(int fd, char *key, size_t size)
+{
+	struct sockaddr_storage sa;
+	socklen_t salen = sizeof(sa);
+	char host[NI_MAXHOST], serv[NI_MAXSERV];
+
+	if (getpeername(fd, (struct sockaddr *)&sa, &salen) == -1 ||
+	    getnameinfo((struct sockaddr *)&sa, salen, host, sizeof(host),
+	    serv, sizeof(serv), NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+		return (0);
+	return (snprintf(key, size, "%s:%s", host, serv) < size);
+}
+
+static void
+tls_session_cache_remove(int i)
+{
+	memmove(&tls_session_cache[i], &tls_session_cache[i + 1],
+	    sizeof(tls_session_cache[0]) * (tls_session_cache_n - i - 1));
+	tls_session_cache_n--;
+}
+
+static int
+tls_session_cache_lookup(const char *key)
+{
+	int i;
+
+	for (i = 0; i < tls_session_cache_n; i++) {
+		if (strcmp(tls_session_cache[i].key, key) == 0)
+			return (i);
+	}
+	return (-1);
+}
+
+static void
+tls_session_cache_put(const char *key, SSL_SESSION *session)
+{
+	int i;
+
+	gfarm_mutex_lock(&tls_session_cache_mutex,
+	    tls_session_cache_diag, tls_session_cache_mutex_what);
+	if ((i = tls_session_cache_lookup(key)) != -1) {
+		SSL_SESSION_free(tls_session_cache[i].session);
+		tls_session_cache_remove(i);
+	} else if (tls_session_cache_n >= TLS_SESSION_CACHE_SIZE) {
+		SSL_SESSION_free(
+		    tls_session_cache[tls_session_cache_n - 1].session);
+		tls_session_cache_n--;
+	}
+	memmove(&tls_session_cache[1], &tls_session_cache[0],
+	    sizeof(tls_session_cache[0]) * tls_session_cache_n);
+	tls_session_cache_n++;
+	snprintf(tls_session_cache[0].key, sizeof(tls_session_cache[0].key),
+	    "%s", key);
+	tls_session_cache[0].session = session;
+	gfarm_mutex_unlock(&tls_session_cache_mutex,
+	    tls_session_cache_diag, tls_session_cache_mutex_what);
+}
+
+/* the caller has to SSL_SESSION_free() the result */
+static SSL_SESSION *
+tls_session_cache_take(const char *key)
+{
+	SSL_SESSION *session = NULL;
+	int i;
+
+	gfarm_mutex_lock(&tls_session_cache_mutex,
+	    tls_session_cache_diag, tls_session_cache_mutex_what);
+	if ((i = tls_session_cache_lookup(key)) != -1) {
+		session = tls_session_cache[i].session;
+		tls_session_cache_remove(i);
+	}
+	gfarm_mutex_unlock(&tls_session_cache_mutex,
+	    tls_session_cache_diag, tls_session_cache_mutex_what);
+	return (session);
+}
+
+/* called by OpenSSL, when a client receives a session ticket */
+static int
+tls_session_new_cb(SSL *ssl, SSL_SESSION *session)
+{
+	char key[TLS_SESSION_KEY_SIZE];
+
+	if (!SSL_SESSION_is_resumable(session) ||
+	    !tls_session_cache_key(SSL_get_fd(ssl), key, sizeof(key)))
+		return (0);
+	tls_session_cache_put(key, session);
+	return (1); /* the reference is taken */
+}
+
+/*
+ * setup an SSL_CTX for session resumption and kTLS,
+ * and prepare an SSL to resume a cached session, if any.
+ */
+static gfarm_error_t
+gfp_xdr_tls_session_setup(struct tls_session_ctx_struct *ctx, int fd)
+{
+	SSL_CTX *ssl_ctx = ctx->ssl_ctx_;
+	SSL_SESSION *session;
+	char key[TLS_SESSION_KEY_SIZE];
+
+#ifdef TLS_KTLS_AVAILABLE
+	/*
+	 * a KeyUpdate doesn't work once the keys are passed to the kernel,
+	 * thus kTLS is used only if tls_key_update is disabled.
+	 * a server cannot refuse a KeyUpdate requested by a client, though.
+	 */
+	if (gfarm_ctxp->tls_ktls && ctx->io_key_update_thresh_ == 0)
+		SSL_CTX_set_options(ssl_ctx, SSL_OP_ENABLE_KTLS);
+#endif
+	if (!gfarm_ctxp->tls_session_resumption || ctx->do_mutual_auth_) {
+		if (ctx->role_ == TLS_ROLE_SERVER)
+			SSL_CTX_set_num_tickets(ssl_ctx, 0);
+		return (GFARM_ERR_NO_ERROR);
+	}
+
+	if (ctx->role_ == TLS_ROLE_SERVER) {
+		pthread_once(&tls_ticket_keys_once, tls_ticket_keys_init);
+		if (!tls_ticket_keys_available ||
+		    SSL_CTX_set_tlsext_ticket_keys(ssl_ctx,
+		    tls_ticket_keys, sizeof(tls_ticket_keys)) != 1) {
+			SSL_CTX_set_num_tickets(ssl_ctx, 0);
+			return (GFARM_ERR_NO_ERROR);
+		}
+		/* a client uses only one ticket at a time */
+		SSL_CTX_set_num_tickets(ssl_ctx, 1);
+		return (GFARM_ERR_NO_ERROR);
+	}
+
+	SSL_CTX_set_session_cache_mode(ssl_ctx,
+	    SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(ssl_ctx, tls_session_new_cb);
+	if (!tls_session_cache_key(fd, key, sizeof(key)) ||
+	    (session = tls_session_cache_take(key)) == NULL)
+		return (GFARM_ERR_NO_ERROR);
+
+	/* tls_session_setup_ssl() uses this SSL */
+	tls_runtime_flush_error();
+	if ((ctx->ssl_ = SSL_new(ssl_ctx)) == NULL) {
+		SSL_SESSION_free(session);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	/* if this fails, a full handshake is done */
+	(void)SSL_set_session(ctx->ssl_, session);
+	SSL_SESSION_free(session);
+	return (GFARM_ERR_NO_ERROR);
+}
+
 /*
  * Gfarm internal APIs
  */
@@ -337,6 +549,8 @@ gfp_xdr_tls_alloc(struct gfp_xdr *conn,	int fd, int flags)
 #if 0
 	gfarm_openssl_global_unlock(diag);
 #endif
+	if (ret == GFARM_ERR_NO_ERROR)
+		ret = gfp_xdr_tls_session_setup(ctx, fd);
 
 	/*
 	 * to make TLS authentication graceful,
@@ -360,6 +574,105 @@ gfp_xdr_tls_alloc(struct gfp_xdr *conn,	int fd, int flags)
 	return (ret);
 }
 
+/*
+ * generate the session ticket keys before fork(2), see above.
+ */
+void
+gfp_xdr_tls_initialize(void)
+{
+	pthread_once(&tls_ticket_keys_once, tls_ticket_keys_init);
+}
+
+int
+gfp_xdr_tls_session_reused(struct gfp_xdr *conn)
+{
+	struct gfp_io_tls *io = gfp_xdr_cookie(conn);
+	int reused;
+	static const char diag[] = "gfp_xdr_tls_session_reused";
+
+	gfarm_mutex_lock(&io->mutex, diag, mutex_what);
+	reused = SSL_session_reused(io->ctx->ssl_);
+	gfarm_mutex_unlock(&io->mutex, diag, mutex_what);
+
+	return (reused);
+}
+
+/*
+ * returns true, if the sending side of a TLS connection is offloaded
+ * to the kernel.  see "tls_ktls" in gfarm2.conf(5).
+ */
+int
+gfp_xdr_tls_is_ktls_send(struct gfp_xdr *conn)
+{
+#ifdef TLS_KTLS_AVAILABLE
+	struct gfp_io_tls *io;
+	int ktls;
+	static const char diag[] = "gfp_xdr_tls_is_ktls_send";
+
+	if (gfp_xdr_iobuffer_ops(conn) != &gfp_xdr_tls_iobuf_ops)
+		return (0);
+	io = gfp_xdr_cookie(conn);
+	gfarm_mutex_lock(&io->mutex, diag, mutex_what);
+	ktls = BIO_get_ktls_send(SSL_get_wbio(io->ctx->ssl_));
+	gfarm_mutex_unlock(&io->mutex, diag, mutex_what);
+	return (ktls);
+#else
+	return (0);
+#endif
+}
+
+#ifdef HAVE_LINUX_SENDFILE
+/*
+ * same as gfp_xdr_socket_sendfile(), but for a TLS connection.
+ * this requires gfp_xdr_tls_is_ktls_send(conn).
+ */
+gfarm_error_t
+gfp_xdr_tls_sendfile(struct gfp_xdr *conn, int r_fd, off_t r_off,
+	size_t len, size_t *sentp)
+{
+#ifdef TLS_KTLS_AVAILABLE
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	struct gfp_io_tls *io = gfp_xdr_cookie(conn);
+	struct tls_session_ctx_struct *ctx = io->ctx;
+	int fd = gfp_xdr_fd(conn);
+	size_t sent = 0;
+	ossl_ssize_t rv;
+	static const char diag[] = "gfp_xdr_tls_sendfile";
+
+	gfarm_mutex_lock(&io->mutex, diag, mutex_what);
+	while (sent < len) {
+		if ((e = gfp_xdr_socket_wait(fd, POLLOUT))
+		    != GFARM_ERR_NO_ERROR)
+			break;
+		errno = 0;
+		tls_runtime_flush_error();
+		rv = SSL_sendfile(ctx->ssl_, r_fd, r_off + sent, len - sent,
+		    0);
+		if (rv > 0) {
+			sent += rv;
+			continue;
+		}
+		if (rv == 0) { /* the file is truncated */
+			e = GFARM_ERR_UNEXPECTED_EOF;
+			break;
+		}
+		if (SSL_get_error(ctx->ssl_, rv) == SSL_ERROR_WANT_WRITE)
+			continue;
+		e = errno != 0 ?
+		    gfarm_errno_to_error(errno) : GFARM_ERR_TLS_RUNTIME_ERROR;
+		break;
+	}
+	ctx->io_total_ += sent;
+	gfarm_mutex_unlock(&io->mutex, diag, mutex_what);
+	*sentp = sent;
+	return (e);
+#else
+	*sentp = 0;
+	return (GFARM_ERR_OPERATION_NOT_SUPPORTED);
+#endif
+}
+#endif /* HAVE_LINUX_SENDFILE */
+
 /*
  * An SSL destructor
  */
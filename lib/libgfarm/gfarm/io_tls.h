@@ -18,6 +18,14 @@ gfarm_error_t gfp_xdr_tls_alloc(struct gfp_xdr *, int, int);
 
 void gfp_xdr_tls_reset(struct gfp_xdr *);
 
+void gfp_xdr_tls_initialize(void);
+int gfp_xdr_tls_session_reused(struct gfp_xdr *);
+int gfp_xdr_tls_is_ktls_send(struct gfp_xdr *);
+#ifdef HAVE_LINUX_SENDFILE
+gfarm_error_t gfp_xdr_tls_sendfile(struct gfp_xdr *, int, off_t,
+	size_t, size_t *);
+#endif
+
 char *gfp_xdr_tls_peer_dn_rfc2253(struct gfp_xdr *);
 char *gfp_xdr_tls_peer_dn_gsi(struct gfp_xdr *);
 char *gfp_xdr_tls_peer_dn_common_name(struct gfp_xdr *);
@@ -21,6 +21,7 @@ struct gfarm_iostat_static {
 	struct gfarm_iostat_head	*stat_hp;
 	struct gfarm_iostat_items	*stat_sip;
 	struct gfarm_iostat_items	*stat_local_ip;
+	struct gfarm_iostat_hist	*stat_hist;
 	gfarm_off_t		stat_size;
 };
 
@@ -72,10 +73,17 @@ gfarm_iostat_static_term(struct gfarm_context *ctxp)
 gfarm_error_t
 gfarm_iostat_mmap(char *path, struct gfarm_iostat_spec *specp,
 		unsigned int nitem, unsigned int row)
+{
+	return (gfarm_iostat_mmap_hist(path, specp, nitem, row, 0));
+}
+
+gfarm_error_t
+gfarm_iostat_mmap_hist(char *path, struct gfarm_iostat_spec *specp,
+		unsigned int nitem, unsigned int row, unsigned int nhist)
 {
 	int fd;
 	gfarm_error_t e;
-	size_t	size, off;
+	size_t	size, off, hist_off;
 	void	*addr;
 	struct gfarm_iostat_head head, *hp = &head;
 	int	ncol;
@@ -99,8 +107,10 @@ gfarm_iostat_mmap(char *path, struct gfarm_iostat_spec *specp,
 	hp->s_item_off = off;
 	hp->s_ncolumn = ncol;
 	hp->s_item_size = scol * ncol;
+	hp->s_nhist = nhist;
 
-	size = off + hp->s_item_size * row;
+	hist_off = off + hp->s_item_size * row;
+	size = hist_off + sizeof(struct gfarm_iostat_hist) * nhist;
 	strncpy(hp->s_name, basename(path), GFARM_IOSTAT_NAME_MAX);
 
 	if ((fd = open(path, O_CREAT|O_TRUNC|O_RDWR, 0644)) < 0) {
@@ -151,6 +161,8 @@ gfarm_iostat_mmap(char *path, struct gfarm_iostat_spec *specp,
 #endif
 	staticp->stat_hp = (struct gfarm_iostat_head *)addr;
 	staticp->stat_sip = (struct gfarm_iostat_items *)((char*)addr + off);
+	staticp->stat_hist = nhist == 0 ? NULL :
+		(struct gfarm_iostat_hist *)((char *)addr + hist_off);
 	staticp->stat_size = size;
 
 	return (GFARM_ERR_NO_ERROR);
@@ -365,3 +377,76 @@ gfarm_iostat_local_add(unsigned int cat, int val)
 	}
 	gfarm_iostat_stat_add(ip, cat, val);
 }
+
+/*
+ * histograms are shared by forked processes via MAP_SHARED,
+ * thus they are updated by atomic operations without any lock,
+ * where the compiler provides them.
+ */
+struct gfarm_iostat_hist *
+gfarm_iostat_get_hist(unsigned int i, const char *name)
+{
+	struct gfarm_iostat_hist *hist;
+	struct gfarm_iostat_head *hp; struct gfarm_iostat_items *sip;
+
+	if (!is_statfile_valid(hp, sip) || staticp->stat_hist == NULL)
+		return (NULL);
+
+	if (i >= hp->s_nhist) {
+		gflog_error(GFARM_MSG_1005759,
+			"gfarm_iostat_get_hist(%s) too big id %d",
+			hp->s_name, i);
+		return (NULL);
+	}
+	hist = &staticp->stat_hist[i];
+	strncpy(hist->h_name, name, GFARM_IOSTAT_NAME_MAX);
+	return (hist);
+}
+
+unsigned int
+gfarm_iostat_hist_index(gfarm_uint64_t usec)
+{
+	unsigned int e, i;
+	const unsigned int nsub = 1 << GFARM_IOSTAT_HIST_SUB_BITS;
+
+	if (usec < nsub)
+		return (usec);
+#ifdef __GNUC__
+	e = 63 - __builtin_clzll(usec);
+#else
+	for (e = GFARM_IOSTAT_HIST_SUB_BITS; (usec >> e) > 1; e++)
+		;
+#endif
+	i = (e - GFARM_IOSTAT_HIST_SUB_BITS + 1) * nsub +
+		((usec >> (e - GFARM_IOSTAT_HIST_SUB_BITS)) & (nsub - 1));
+	return (i < GFARM_IOSTAT_HIST_NBUCKET ?
+		i : GFARM_IOSTAT_HIST_NBUCKET - 1);
+}
+
+void
+gfarm_iostat_hist_add(struct gfarm_iostat_hist *hist, gfarm_uint64_t usec)
+{
+	gfarm_uint64_t max;
+
+	if (hist == NULL)
+		return;
+#ifdef __GNUC__
+	__atomic_fetch_add(&hist->h_buckets[gfarm_iostat_hist_index(usec)], 1,
+		__ATOMIC_RELAXED);
+	__atomic_fetch_add(&hist->h_sum, usec, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&hist->h_max, __ATOMIC_RELAXED);
+	while (usec > max && !__atomic_compare_exchange_n(&hist->h_max,
+		&max, usec, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+	/* readers may use h_count as a generation of the buckets */
+	__atomic_fetch_add(&hist->h_count, 1, __ATOMIC_RELEASE);
+#else
+	/* as gfarm_iostat_stat_add(), concurrent updates may be lost */
+	hist->h_buckets[gfarm_iostat_hist_index(usec)]++;
+	hist->h_sum += usec;
+	max = hist->h_max;
+	if (usec > max)
+		hist->h_max = usec;
+	hist->h_count++;
+#endif
+}
@@ -1,5 +1,8 @@
 gfarm_error_t gfarm_iostat_mmap(char *path,  struct gfarm_iostat_spec *specp,
 		unsigned int nitem, unsigned int row);
+gfarm_error_t gfarm_iostat_mmap_hist(char *path,
+		struct gfarm_iostat_spec *specp,
+		unsigned int nitem, unsigned int row, unsigned int nhist);
 void gfarm_iostat_clear_id(gfarm_uint64_t id, unsigned int hint);
 void gfarm_iostat_clear_ip(struct gfarm_iostat_items *ip);
 struct gfarm_iostat_items *gfarm_iostat_find_space(unsigned int hint);
@@ -9,3 +12,8 @@ void gfarm_iostat_set_local_ip(struct gfarm_iostat_items *ip);
 void gfarm_iostat_stat_add(struct gfarm_iostat_items *ip,
 			unsigned int cat, int val);
 void gfarm_iostat_local_add(unsigned int cat, int val);
+struct gfarm_iostat_hist *gfarm_iostat_get_hist(unsigned int i,
+			const char *name);
+unsigned int gfarm_iostat_hist_index(gfarm_uint64_t usec);
+void gfarm_iostat_hist_add(struct gfarm_iostat_hist *hist,
+			gfarm_uint64_t usec);
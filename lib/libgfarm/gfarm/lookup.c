@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -21,6 +22,7 @@
 #include "lookup.h"
 #include "filesystem.h"
 #include "gfs_failover.h"
+#include "gfs_dircache.h"
 
 static gfarm_error_t
 gfarm_get_hostname_by_url0(const char **pathp,
@@ -217,19 +219,213 @@ gfm_is_mounted(struct gfm_connection *gfm_server)
 
 #define SKIP_SLASH(p) { while (*(p) == '/') (p)++; }
 
+/*
+ * if lookup_path_rpc is enabled, the directories in a pathname are
+ * looked up by one GFM_PROTO_LOOKUP_PATH request, instead of
+ * GFM_PROTO_OPEN and GFM_PROTO_VERIFY_TYPE for each of them.
+ * the directories looked up are remembered in the path cache,
+ * so that the lookup can start at the deepest cached ancestor.
+ */
+struct gfm_lookup_dir_state {
+	const char *dirpath;	/* NULL, if GFM_PROTO_LOOKUP_PATH isn't used */
+	size_t dirlen;
+	int ncomponents;
+};
+
+static int
+path_count_components(const char *path, size_t len)
+{
+	const char *end = path + len;
+	int n = 0;
+
+	for (;;) {
+		while (path < end && *path == '/')
+			path++;
+		if (path >= end)
+			return (n);
+		n++;
+		while (path < end && *path != '/')
+			path++;
+	}
+}
+
+/* returns the end of the `n'th component, or `path' if n == 0 */
+static const char *
+path_component_end(const char *path, int n)
+{
+	for (; n > 0; n--) {
+		SKIP_SLASH(path);
+		path += strcspn(path, "/");
+	}
+	return (path);
+}
+
+/* the first `len' bytes of `path' are appended */
+static char *
+gfm_path_cache_key(struct gfm_connection *gfm_server,
+	const char *path, size_t len, size_t *prefix_lenp)
+{
+	const char *user = gfm_client_username(gfm_server);
+	const char *host = gfm_client_hostname(gfm_server);
+	size_t sz = strlen(user) + 1 + strlen(host) + 1 + GFARM_INT32STRLEN +
+	    1 + len + 1;
+	char *key;
+	int n;
+
+	GFARM_MALLOC_ARRAY(key, sz);
+	if (key == NULL)
+		return (NULL);
+	n = snprintf(key, sz, "%s@%s:%d/", user, host,
+	    gfm_client_port(gfm_server));
+	memcpy(key + n, path, len);
+	key[n + len] = '\0';
+	*prefix_lenp = n;
+	return (key);
+}
+
+/* `dirlen' is the length of the directory part of `path' */
+static gfarm_error_t
+gfm_lookup_path_request(struct gfm_connection *gfm_server, const char *path,
+	size_t dirlen, struct gfm_lookup_dir_state *state)
+{
+	gfarm_error_t e;
+	gfarm_ino_t inum = 0;
+	gfarm_uint64_t gen = 0;
+	int n, ncached = 0;
+	size_t len, prefix_len;
+	char *key;
+
+	while (dirlen > 0 && path[dirlen - 1] == '/')
+		--dirlen;
+	state->dirpath = path;
+	state->dirlen = dirlen;
+	state->ncomponents = path_count_components(path, dirlen);
+
+	/* find the deepest cached ancestor */
+	if (gfarm_ctxp->path_cache_timeout > 0 && (key = gfm_path_cache_key(
+	    gfm_server, path, dirlen, &prefix_len)) != NULL) {
+		for (len = dirlen, n = state->ncomponents; len > 0; --n) {
+			key[prefix_len + len] = '\0';
+			if (gfs_path_cache_lookup(key, &inum, &gen)) {
+				ncached = n;
+				break;
+			}
+			while (len > 0 && path[len - 1] != '/')
+				--len;
+			while (len > 0 && path[len - 1] == '/')
+				--len;
+		}
+		free(key);
+		gfs_path_cache_profile(ncached > 0);
+	}
+
+	/* the root is the base, if the cached directory is not valid */
+	if ((e = gfm_client_open_root_request(gfm_server, GFARM_FILE_LOOKUP))
+	    != GFARM_ERR_NO_ERROR)
+		return (e);
+	if ((e = gfm_client_lookup_path_request(gfm_server, path, dirlen,
+	    ncached, inum, gen)) != GFARM_ERR_NO_ERROR)
+		return (e);
+	return (gfm_client_verify_type_request(gfm_server, GFS_DT_DIR));
+}
+
+static gfarm_error_t
+gfm_lookup_path_result(struct gfm_connection *gfm_server,
+	struct gfm_lookup_dir_state *state, const char **restp, int *is_lastp)
+{
+	gfarm_error_t e;
+	gfarm_ino_t *inums;
+	gfarm_uint64_t *gens;
+	gfarm_mode_t *modes;
+	int i, first, n;
+	size_t len, prefix_len;
+	char *key, c;
+	const char *path = state->dirpath;
+
+	if ((e = gfm_client_open_root_result(gfm_server))
+	    != GFARM_ERR_NO_ERROR)
+		return (e);
+	inums = NULL;
+	gens = NULL;
+	modes = NULL;
+	if (gfarm_ctxp->path_cache_timeout > 0) {
+		GFARM_MALLOC_ARRAY(inums, state->ncomponents);
+		GFARM_MALLOC_ARRAY(gens, state->ncomponents);
+		GFARM_MALLOC_ARRAY(modes, state->ncomponents);
+		if (inums == NULL || gens == NULL || modes == NULL) {
+			/* not cached, but the results have to be received */
+			free(inums);
+			free(gens);
+			free(modes);
+			inums = NULL;
+			gens = NULL;
+			modes = NULL;
+		}
+	}
+	e = gfm_client_lookup_path_result(gfm_server, state->ncomponents,
+	    &first, &n, inums, gens, modes);
+	if (e == GFARM_ERR_NO_ERROR && inums != NULL &&
+	    (key = gfm_path_cache_key(gfm_server, path, state->dirlen,
+	    &prefix_len)) != NULL) {
+		/* remember the directories newly looked up */
+		for (i = 0; i < n && GFARM_S_ISDIR(modes[i]); i++) {
+			len = path_component_end(path, first + i + 1) - path;
+			c = key[prefix_len + len];
+			key[prefix_len + len] = '\0';
+			gfs_path_cache_enter(key, inums[i], gens[i]);
+			key[prefix_len + len] = c;
+		}
+		free(key);
+	}
+	free(inums);
+	free(gens);
+	free(modes);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+
+	/* the component which is not a directory is the current fd */
+	*restp = path_component_end(path, first + n);
+	SKIP_SLASH(*restp);
+	if ((e = gfm_client_verify_type_result(gfm_server))
+	    != GFARM_ERR_NO_ERROR)
+		return (e);
+	*restp = path + state->dirlen;
+	SKIP_SLASH(*restp);
+	if (is_lastp != NULL)
+		*is_lastp = 1;
+	return (GFARM_ERR_NO_ERROR);
+}
+
 static gfarm_error_t
 gfm_lookup_dir_request(struct gfm_connection *gfm_server, const char *path,
-	const char **basep, int *is_lastp)
+	const char **basep, int *is_lastp, struct gfm_lookup_dir_state *state)
 {
 	gfarm_error_t e;
 	int beginning = 1;
 	int len;
+	const char *last;
 
 	/* XXX FIX ME: current directory is always "/" on v2 for now */
 	if (is_lastp != NULL)
 		*is_lastp = 0;
 	SKIP_SLASH(path);
 
+	state->dirpath = NULL;
+	if (gfarm_ctxp->lookup_path_rpc &&
+	    (last = strrchr(path, '/')) != NULL) {
+		e = gfm_lookup_path_request(gfm_server, path, last - path,
+		    state);
+		if (e == GFARM_ERR_NO_ERROR) {
+			*basep = last + 1;
+			if (is_lastp != NULL)
+				*is_lastp = 1;
+		} else
+			gflog_debug(GFARM_MSG_1005798,
+			    "lookup_path(%s) request: %s", path,
+			    gfarm_error_string(e));
+		return (e);
+	}
+
 	for (;;) {
 		len = strcspn(path, "/");
 		if (path[len] != '/') {
@@ -289,9 +485,9 @@ gfm_lookup_dir_request(struct gfm_connection *gfm_server, const char *path,
 	return (e);
 }
 
-gfarm_error_t
+static gfarm_error_t
 gfm_lookup_dir_result(struct gfm_connection *gfm_server, const char *path,
-	const char **restp, int *is_lastp)
+	const char **restp, int *is_lastp, struct gfm_lookup_dir_state *state)
 {
 	gfarm_error_t e;
 	int beginning = 1;
@@ -305,6 +501,15 @@ gfm_lookup_dir_result(struct gfm_connection *gfm_server, const char *path,
 		*is_lastp = 0;
 	SKIP_SLASH(path);
 
+	if (state->dirpath != NULL) {
+		e = gfm_lookup_path_result(gfm_server, state, restp, is_lastp);
+		if (e != GFARM_ERR_NO_ERROR)
+			gflog_debug(GFARM_MSG_1005799,
+			    "lookup_path(%s) result: %s", path,
+			    gfarm_error_string(e));
+		return (e);
+	}
+
 	for (;;) {
 		len = strcspn(path, "/");
 		if (path[len] != '/') {
@@ -487,7 +692,8 @@ trim_trailing_file_separator(const char *path)
 
 static gfarm_error_t
 gfm_inode_or_name_op_lookup_request(struct gfm_connection *gfm_server,
-	const char *path, int flags, char **restp, int *do_verifyp)
+	const char *path, int flags, char **restp, int *do_verifyp,
+	struct gfm_lookup_dir_state *state)
 {
 	gfarm_error_t e;
 	int is_last;
@@ -495,7 +701,7 @@ gfm_inode_or_name_op_lookup_request(struct gfm_connection *gfm_server,
 	int is_open_last = (flags & GFARM_FILE_OPEN_LAST_COMPONENT) != 0;
 
 	if ((e = gfm_lookup_dir_request(gfm_server, path,
-		(const char **)restp, &is_last)) != GFARM_ERR_NO_ERROR) {
+		(const char **)restp, &is_last, state)) != GFARM_ERR_NO_ERROR) {
 		gflog_warning(GFARM_MSG_1002589,
 		    "lookup_dir(%s) request: %s", path,
 		    gfarm_error_string(e));
@@ -542,13 +748,14 @@ static gfarm_error_t
 gfm_inode_or_name_op_lookup_result(struct gfm_connection *gfm_server,
 	const char *path, int flags, int do_verify, char **restp,
 	int *typep, int *retry_countp, int *is_lastp, int *is_retryp,
-	gfarm_ino_t *inop, gfarm_uint64_t *igenp)
+	gfarm_ino_t *inop, gfarm_uint64_t *igenp,
+	struct gfm_lookup_dir_state *state)
 {
 	gfarm_error_t e;
 	int is_open_last = (flags & GFARM_FILE_OPEN_LAST_COMPONENT) != 0;
 
 	if ((e = gfm_lookup_dir_result(gfm_server, path, (const char **)restp,
-	    is_lastp)) != GFARM_ERR_NO_ERROR) {
+	    is_lastp, state)) != GFARM_ERR_NO_ERROR) {
 		gflog_debug(GFARM_MSG_1002593,
 		    "lookup_dir(path=%s) result failed: %s",
 		    path, gfarm_error_string(e));
@@ -668,6 +875,7 @@ gfm_inode_or_name_op0(const char *url, int flags,
 	int is_open_last = (flags & GFARM_FILE_OPEN_LAST_COMPONENT) != 0;
 	gfarm_ino_t ino;
 	gfarm_uint64_t igen;
+	struct gfm_lookup_dir_state lookup_state;
 
 	nextpath = trim_trailing_file_separator(url);
 	if (nextpath == NULL) {
@@ -717,7 +925,7 @@ gfm_inode_or_name_op0(const char *url, int flags,
 			    gfarm_error_string(e));
 			break;
 		} else if ((e = gfm_inode_or_name_op_lookup_request(
-		    gfm_server, path, flags, &rest, &do_verify))
+		    gfm_server, path, flags, &rest, &do_verify, &lookup_state))
 		    != GFARM_ERR_NO_ERROR)
 			break;
 
@@ -751,7 +959,8 @@ gfm_inode_or_name_op0(const char *url, int flags,
 			break;
 		} else if ((e = gfm_inode_or_name_op_lookup_result(gfm_server,
 		    path, flags, do_verify, &rest, &type, &retry_count,
-		    &is_last, &is_retry, &ino, &igen)) != GFARM_ERR_NO_ERROR) {
+		    &is_last, &is_retry, &ino, &igen, &lookup_state))
+		    != GFARM_ERR_NO_ERROR) {
 			if (is_retry)
 				continue;
 			if (e != GFARM_ERR_IS_A_SYMBOLIC_LINK)
@@ -1104,6 +1313,7 @@ gfm_name2_op0(const char *src, const char *dst, int flags,
 	gfarm_ino_t ino;
 	gfarm_uint64_t igen;
 	int sconn_locked = 0, dconn_locked = 0;
+	struct gfm_lookup_dir_state slookup_state, dlookup_state;
 
 	snextpath = trim_trailing_file_separator(src);
 	dnextpath = trim_trailing_file_separator(dst);
@@ -1320,7 +1530,8 @@ gfm_name2_op0(const char *src, const char *dst, int flags,
 		}
 		if (slookup) {
 			if ((e = gfm_inode_or_name_op_lookup_request(sconn,
-			    spath, flags, &srest, &s_do_verify))
+			    spath, flags, &srest, &s_do_verify,
+			    &slookup_state))
 			    != GFARM_ERR_NO_ERROR)
 				break;
 			if ((e = gfm_client_get_fd_request(
@@ -1350,7 +1561,8 @@ gfm_name2_op0(const char *src, const char *dst, int flags,
 		}
 		if (dlookup) {
 			if ((e = gfm_inode_or_name_op_lookup_request(dconn,
-				dpath, 0, &drest, &d_do_verify))
+				dpath, 0, &drest, &d_do_verify,
+				&dlookup_state))
 			    != GFARM_ERR_NO_ERROR) {
 				*is_dst_errp = !same_mds;
 				break;
@@ -1457,7 +1669,8 @@ gfm_name2_op0(const char *src, const char *dst, int flags,
 		if (slookup) {
 			if ((se = gfm_inode_or_name_op_lookup_result(sconn,
 			    spath, flags, s_do_verify, &srest, &type,
-			    &retry_count, &s_is_last, &sretry, &ino, &igen))
+			    &retry_count, &s_is_last, &sretry, &ino, &igen,
+			    &slookup_state))
 			    != GFARM_ERR_NO_ERROR) {
 				if (sretry)
 					continue;
@@ -1499,7 +1712,8 @@ dst_lookup_result:
 		if (dlookup) {
 			if ((de = gfm_inode_or_name_op_lookup_result(dconn,
 			    dpath, 0, d_do_verify, &drest, &type,
-			    &retry_count, &d_is_last, &dretry, &ino, &igen))
+			    &retry_count, &d_is_last, &dretry, &ino, &igen,
+			    &dlookup_state))
 			    != GFARM_ERR_NO_ERROR) {
 				if (dretry)
 					continue;
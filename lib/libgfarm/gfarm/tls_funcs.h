@@ -2082,7 +2082,12 @@ tls_session_setup_ssl(struct tls_session_ctx_struct *ctx)
 #endif
 
 		if (ret == GFARM_ERR_NO_ERROR) {
-			tls_session_clear_ctx(ctx,
+			/*
+			 * Don't free the SSL if it's given by the caller,
+			 * e.g. to resume a session.
+			 */
+			tls_session_clear_ctx(ctx, (ssl == ctx->ssl_) ?
+				CTX_CLEAR_VAR :
 				CTX_CLEAR_READY_FOR_ESTABLISH);
 			ctx->ssl_ = ssl;
 		}
@@ -3,10 +3,16 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 #include <sys/types.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
+#include <gfarm/error.h>
 #include <gfarm/gflog.h>
+#include <gfarm/gfarm_misc.h>
 
 #include "gfutil.h"
 #include "hash.h"
@@ -55,6 +61,95 @@ gfarm_hash_casefold(const void *key, int keylen)
 	return (hash);
 }
 
+/*
+ * a wyhash style hash function, which processes 16 bytes per iteration.
+ * the value depends on the byte order, thus it must not be stored.
+ */
+
+#define HASH_FAST_P0	0xa0761d6478bd642fULL
+#define HASH_FAST_P1	0xe7037ed1a0b428dbULL
+#define HASH_FAST_P2	0x8ebc6af09c88c6e3ULL
+
+/* returns the xor of upper and lower halves of 128 bit product */
+static unsigned long long
+hash_fast_mum(unsigned long long a, unsigned long long b)
+{
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 r = (unsigned __int128)a * b;
+
+	return ((unsigned long long)r ^ (unsigned long long)(r >> 64));
+#else
+	unsigned long long ha = a >> 32, la = (unsigned int)a;
+	unsigned long long hb = b >> 32, lb = (unsigned int)b;
+	unsigned long long rh = ha * hb, rm0 = ha * lb, rm1 = hb * la;
+	unsigned long long rl = la * lb, t, lo, hi;
+	int carry;
+
+	t = rl + (rm0 << 32);
+	carry = t < rl;
+	lo = t + (rm1 << 32);
+	carry += lo < t;
+	hi = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+	return (lo ^ hi);
+#endif
+}
+
+static unsigned long long
+hash_fast_read64(const unsigned char *p)
+{
+	unsigned long long v;
+
+	memcpy(&v, p, sizeof(v));
+	return (v);
+}
+
+static unsigned long long
+hash_fast_read32(const unsigned char *p)
+{
+	unsigned int v;
+
+	memcpy(&v, p, sizeof(v));
+	return (v);
+}
+
+int
+gfarm_hash_fast(const void *key, int keylen)
+{
+	const unsigned char *p = key;
+	size_t len = keylen, rest = len;
+	unsigned long long seed = HASH_FAST_P0, a, b, h;
+
+	if (len <= 16) {
+		if (len >= 4) {
+			a = (hash_fast_read32(p) << 32) |
+			    hash_fast_read32(p + ((len >> 3) << 2));
+			b = (hash_fast_read32(p + len - 4) << 32) |
+			    hash_fast_read32(p + len - 4 - ((len >> 3) << 2));
+		} else if (len > 0) {
+			a = ((unsigned long long)p[0] << 16) |
+			    ((unsigned long long)p[len >> 1] << 8) |
+			    p[len - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		do {
+			seed = hash_fast_mum(hash_fast_read64(p) ^ HASH_FAST_P1,
+			    hash_fast_read64(p + 8) ^ seed);
+			p += 16;
+			rest -= 16;
+		} while (rest > 16);
+		/* the last 16 bytes, may overlap with the bytes above */
+		a = hash_fast_read64(p + rest - 16);
+		b = hash_fast_read64(p + rest - 8);
+	}
+	h = hash_fast_mum(HASH_FAST_P1 ^ len,
+	    hash_fast_mum(a ^ HASH_FAST_P1, b ^ seed ^ HASH_FAST_P2));
+	/* the chained table requires non-negative value */
+	return ((int)((h ^ (h >> 32)) & INT_MAX));
+}
+
 int
 gfarm_hash_key_equal_default(const void *key1, int key1len,
 			     const void *key2, int key2len)
@@ -79,7 +174,10 @@ gfarm_hash_key_equal_casefold(const void *key1, int key1len,
 }
 
 struct gfarm_hash_entry {
-	struct gfarm_hash_entry *next;
+	union {
+		struct gfarm_hash_entry *next;	/* chained table */
+		unsigned int hash;		/* open addressing table */
+	} u;
 	int key_length;
 	int data_length;
 	double key_stub;
@@ -91,17 +189,22 @@ struct gfarm_hash_entry {
 #define HASH_DATA(entry) \
 	(HASH_KEY(entry) + HASH_ALIGN((entry)->key_length))
 
+struct gfarm_hash_open;
+
 struct gfarm_hash_table {
 	int table_size;
 
 	int (*hash)(const void *, int);
 	int (*equal)(const void *, int, const void *, int);
 
+	/* NULL, if this is a chained table */
+	struct gfarm_hash_open *open;
+
 	struct gfarm_hash_entry *buckets[1];
 };
 
-struct gfarm_hash_table *
-gfarm_hash_table_alloc(int size,
+static struct gfarm_hash_table *
+gfarm_hash_table_alloc_common(int size,
 		       int (*hash)(const void *, int),
 		       int (*equal)(const void *, int, const void *, int))
 {
@@ -129,19 +232,487 @@ gfarm_hash_table_alloc(int size,
 	hashtab->table_size = size;
 	hashtab->hash = hash;
 	hashtab->equal = equal;
+	hashtab->open = NULL;
 	memset(hashtab->buckets, 0, sizeof(struct gfarm_hash_entry *) * size);
 	return (hashtab);
 }
 
+struct gfarm_hash_table *
+gfarm_hash_table_alloc(int size,
+		       int (*hash)(const void *, int),
+		       int (*equal)(const void *, int, const void *, int))
+{
+	return (gfarm_hash_table_alloc_common(size, hash, equal));
+}
+
+static struct gfarm_hash_entry *
+gfarm_hash_entry_alloc(const void *key, int keylen, int datalen)
+{
+	struct gfarm_hash_entry *p;
+	size_t hash_entry_size;
+	int overflow = 0;
+
+	hash_entry_size =
+		gfarm_size_add(&overflow,
+		    gfarm_size_add(&overflow,
+			HASH_ALIGN(offsetof(struct gfarm_hash_entry, key_stub)),
+			HASH_ALIGN(keylen)),
+		    datalen);
+	if (overflow) {
+		gflog_debug(GFARM_MSG_1000785,
+			"Overflow when entering hash entry");
+		return (NULL);
+	}
+	p = malloc(hash_entry_size); /* size is already checked */
+	if (p == NULL) {
+		gflog_debug(GFARM_MSG_1000786,
+			"allocation of 'gfarm_hash_entry' failed (%zd)",
+			hash_entry_size);
+		return (NULL);
+	}
+	p->key_length = keylen;
+	p->data_length = datalen;
+	memcpy(HASH_KEY(p), key, keylen);
+	return (p);
+}
+
+/*
+ * open addressing table
+ *
+ * this is a variant of the Swiss table.  the table consists of
+ * an array of control bytes and an array of pointers to entries,
+ * and it's divided into groups of HASH_GROUP_WIDTH slots.
+ * the control byte of a used slot holds 7 bits of the hash value,
+ * so that a lookup can compare the whole group at once (by SSE2 if
+ * available) without touching the entries.
+ * the entries themselves are allocated separately, thus a pointer to
+ * an entry is never changed by growing the table, as a chained table.
+ *
+ * when the table is grown, the old slots are migrated to the new table
+ * incrementally, a few groups at each gfarm_hash_enter(), to avoid
+ * a long pause.  until that finishes, a lookup probes both tables.
+ * gfarm_hash_lookup() and iterators never modify the table, but
+ * unlike a chained table, gfarm_hash_enter() must not be called
+ * while iterating the table.
+ */
+
+#define HASH_CTRL_EMPTY		((signed char)-128)	/* 0b10000000 */
+#define HASH_CTRL_DELETED	((signed char)-2)	/* 0b11111110 */
+/* a used slot has 0b0xxxxxxx */
+
+#ifdef __SSE2__
+
+#define HASH_GROUP_WIDTH	16
+typedef unsigned int hash_group_mask_t;
+#define HASH_GROUP_MASK_SHIFT	0
+
+static hash_group_mask_t
+hash_group_match(const signed char *group, signed char h2)
+{
+	__m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+
+	return (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+}
+
+static hash_group_mask_t
+hash_group_match_empty(const signed char *group)
+{
+	return (hash_group_match(group, HASH_CTRL_EMPTY));
+}
+
+static hash_group_mask_t
+hash_group_match_empty_or_deleted(const signed char *group)
+{
+	return (_mm_movemask_epi8(
+	    _mm_loadu_si128((const __m128i *)group)));
+}
+
+#else /* ! __SSE2__ */
+
+/* process 8 control bytes by 64bit integer operations */
+
+#define HASH_GROUP_WIDTH	8
+typedef unsigned long long hash_group_mask_t;
+#define HASH_GROUP_MASK_SHIFT	3	/* the MSB of each byte is used */
+
+#define HASH_GROUP_LSBS		0x0101010101010101ULL
+#define HASH_GROUP_MSBS		0x8080808080808080ULL
+
+static unsigned long long
+hash_group_load(const signed char *group)
+{
+	unsigned long long v = 0;
+	int i;
+
+	/* byte i goes to bits 8i..8i+7 regardless of the byte order */
+	for (i = 0; i < HASH_GROUP_WIDTH; i++)
+		v |= (unsigned long long)(unsigned char)group[i] << (i * 8);
+	return (v);
+}
+
+/* may have false positives, but they are rejected by the caller */
+static hash_group_mask_t
+hash_group_match(const signed char *group, signed char h2)
+{
+	unsigned long long x = hash_group_load(group) ^
+	    (HASH_GROUP_LSBS * (unsigned char)h2);
+
+	return ((x - HASH_GROUP_LSBS) & ~x & HASH_GROUP_MSBS);
+}
+
+static hash_group_mask_t
+hash_group_match_empty(const signed char *group)
+{
+	unsigned long long v = hash_group_load(group);
+
+	/* the MSB is set, and bit 1 isn't set */
+	return (v & ~(v << 6) & HASH_GROUP_MSBS);
+}
+
+static hash_group_mask_t
+hash_group_match_empty_or_deleted(const signed char *group)
+{
+	return (hash_group_load(group) & HASH_GROUP_MSBS);
+}
+
+#endif /* ! __SSE2__ */
+
+/* index of the lowest slot in the mask */
+static int
+hash_group_mask_index(hash_group_mask_t mask)
+{
+#ifdef __GNUC__
+	return (__builtin_ctzll(mask) >> HASH_GROUP_MASK_SHIFT);
+#else
+	int i = 0;
+
+	while ((mask & 1) == 0) {
+		mask >>= 1;
+		i++;
+	}
+	return (i >> HASH_GROUP_MASK_SHIFT);
+#endif
+}
+
+/* MurmurHash3 finalizer, since the hash functions above are not uniform */
+static unsigned long long
+hash_open_mix(unsigned int hash)
+{
+	unsigned long long x = hash;
+
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return (x);
+}
+
+#define HASH_OPEN_H1(x)		((size_t)((x) >> 7))
+#define HASH_OPEN_H2(x)		((signed char)((x) & 0x7f))
+
+/* max load factor is 7/8 */
+#define HASH_OPEN_GROWTH(capacity)	((capacity) - (capacity) / 8)
+
+/* # of groups migrated at each gfarm_hash_enter() */
+#define HASH_OPEN_MIGRATE_GROUPS	4
+
+/* bucket_index of iterators is int */
+#define HASH_OPEN_CAPACITY_MAX	((size_t)INT_MAX / 4 + 1)
+
+struct gfarm_hash_slots {
+	size_t capacity;	/* power of 2, and >= HASH_GROUP_WIDTH */
+	size_t nentries;
+	size_t growth_left;	/* # of empty slots which can be used */
+	signed char *ctrl;	/* NULL, if not allocated */
+	struct gfarm_hash_entry **slots;
+};
+
+struct gfarm_hash_open {
+	struct gfarm_hash_slots cur;
+
+	/* being migrated to `cur', if old.ctrl != NULL */
+	struct gfarm_hash_slots old;
+	size_t migrate_group;
+};
+
+static int
+hash_slots_alloc(struct gfarm_hash_slots *s, size_t capacity)
+{
+	GFARM_MALLOC_ARRAY(s->ctrl, capacity);
+	GFARM_MALLOC_ARRAY(s->slots, capacity);
+	if (s->ctrl == NULL || s->slots == NULL) {
+		free(s->ctrl);
+		free(s->slots);
+		s->ctrl = NULL;
+		s->slots = NULL;
+		return (0);
+	}
+	memset(s->ctrl, HASH_CTRL_EMPTY, capacity);
+	s->capacity = capacity;
+	s->nentries = 0;
+	s->growth_left = HASH_OPEN_GROWTH(capacity);
+	return (1);
+}
+
+static void
+hash_slots_free(struct gfarm_hash_slots *s, int free_entries)
+{
+	size_t i;
+
+	if (s->ctrl == NULL)
+		return;
+	if (free_entries) {
+		for (i = 0; i < s->capacity; i++) {
+			if (s->ctrl[i] >= 0)
+				free(s->slots[i]);
+		}
+	}
+	free(s->ctrl);
+	free(s->slots);
+	memset(s, 0, sizeof(*s));
+}
+
+/* returns the pointer to the slot, or NULL if not found */
+static struct gfarm_hash_entry **
+hash_slots_lookup(struct gfarm_hash_slots *s,
+	int (*equal)(const void *, int, const void *, int),
+	unsigned int hash, unsigned long long x, const void *key, int keylen)
+{
+	size_t ngroups_mask, group, stride, i;
+	hash_group_mask_t mask;
+	const signed char *ctrl;
+	struct gfarm_hash_entry *p;
+
+	if (s->ctrl == NULL)
+		return (NULL);
+	ngroups_mask = s->capacity / HASH_GROUP_WIDTH - 1;
+	group = HASH_OPEN_H1(x) & ngroups_mask;
+	for (stride = 0; stride <= ngroups_mask; ) {
+		ctrl = &s->ctrl[group * HASH_GROUP_WIDTH];
+		for (mask = hash_group_match(ctrl, HASH_OPEN_H2(x));
+		    mask != 0; mask &= mask - 1) {
+			i = group * HASH_GROUP_WIDTH +
+			    hash_group_mask_index(mask);
+			p = s->slots[i];
+			if (p->u.hash == hash &&
+			    (*equal)(HASH_KEY(p), p->key_length, key, keylen))
+				return (&s->slots[i]);
+		}
+		if (hash_group_match_empty(ctrl) != 0)
+			return (NULL);
+		/* triangular probing visits all groups */
+		group = (group + ++stride) & ngroups_mask;
+	}
+	return (NULL);
+}
+
+/* the caller should guarantee that the entry doesn't exist in the table */
+static void
+hash_slots_insert(struct gfarm_hash_slots *s, unsigned long long x,
+	struct gfarm_hash_entry *p)
+{
+	size_t ngroups_mask = s->capacity / HASH_GROUP_WIDTH - 1;
+	size_t group = HASH_OPEN_H1(x) & ngroups_mask, stride = 0, i;
+	hash_group_mask_t mask;
+
+	while ((mask = hash_group_match_empty_or_deleted(
+	    &s->ctrl[group * HASH_GROUP_WIDTH])) == 0)
+		group = (group + ++stride) & ngroups_mask;
+	i = group * HASH_GROUP_WIDTH + hash_group_mask_index(mask);
+	if (s->ctrl[i] == HASH_CTRL_EMPTY)
+		s->growth_left--;
+	s->ctrl[i] = HASH_OPEN_H2(x);
+	s->slots[i] = p;
+	s->nentries++;
+}
+
+static void
+hash_slots_erase(struct gfarm_hash_slots *s, size_t i)
+{
+	size_t group = i / HASH_GROUP_WIDTH;
+
+	/*
+	 * if the group still has an empty slot, no probe sequence has
+	 * ever passed this group, so this slot can be empty again.
+	 */
+	if (hash_group_match_empty(&s->ctrl[group * HASH_GROUP_WIDTH])
+	    != 0) {
+		s->ctrl[i] = HASH_CTRL_EMPTY;
+		s->growth_left++;
+	} else {
+		s->ctrl[i] = HASH_CTRL_DELETED;
+	}
+	s->slots[i] = NULL;
+	s->nentries--;
+}
+
+static void
+hash_open_migrate(struct gfarm_hash_open *o, size_t ngroups)
+{
+	struct gfarm_hash_slots *old = &o->old;
+	size_t end = old->capacity / HASH_GROUP_WIDTH, i, last;
+	struct gfarm_hash_entry *p;
+
+	for (; ngroups > 0 && o->migrate_group < end && old->nentries > 0;
+	    ngroups--, o->migrate_group++) {
+		i = o->migrate_group * HASH_GROUP_WIDTH;
+		for (last = i + HASH_GROUP_WIDTH; i < last; i++) {
+			if (old->ctrl[i] < 0) /* empty or deleted */
+				continue;
+			p = old->slots[i];
+			hash_slots_insert(&o->cur, hash_open_mix(p->u.hash), p);
+			/* keep the probe sequences in the old table valid */
+			old->ctrl[i] = HASH_CTRL_DELETED;
+			old->slots[i] = NULL;
+			old->nentries--;
+		}
+	}
+	if (old->nentries == 0)
+		hash_slots_free(old, 0);
+}
+
+static int
+hash_open_grow(struct gfarm_hash_open *o)
+{
+	struct gfarm_hash_slots new;
+	size_t capacity = o->cur.capacity;
+
+	if (o->old.ctrl != NULL)
+		hash_open_migrate(o, o->old.capacity);
+
+	/* if many slots are just deleted, rehash to the same size */
+	if (o->cur.nentries >= HASH_OPEN_GROWTH(capacity) / 2) {
+		if (capacity >= HASH_OPEN_CAPACITY_MAX)
+			return (0);
+		capacity *= 2;
+	}
+	if (!hash_slots_alloc(&new, capacity))
+		return (0);
+	o->old = o->cur;
+	o->cur = new;
+	o->migrate_group = 0;
+	return (1);
+}
+
+struct gfarm_hash_table *
+gfarm_hash_table_alloc_resizable(int size,
+		       int (*hash)(const void *, int),
+		       int (*equal)(const void *, int, const void *, int))
+{
+	struct gfarm_hash_table *hashtab;
+	struct gfarm_hash_open *o;
+	size_t capacity = HASH_GROUP_WIDTH;
+
+	hashtab = gfarm_hash_table_alloc_common(1, hash, equal);
+	if (hashtab == NULL)
+		return (NULL);
+	GFARM_MALLOC(o);
+	if (o == NULL) {
+		gflog_debug(GFARM_MSG_1005745,
+		    "allocation of 'gfarm_hash_open' failed");
+		free(hashtab);
+		return (NULL);
+	}
+	/* `size' is the expected number of entries */
+	while (HASH_OPEN_GROWTH(capacity) < size &&
+	    capacity < HASH_OPEN_CAPACITY_MAX)
+		capacity *= 2;
+	memset(o, 0, sizeof(*o));
+	if (!hash_slots_alloc(&o->cur, capacity)) {
+		gflog_debug(GFARM_MSG_1005746,
+		    "allocation of hash slots (%zd) failed", capacity);
+		free(o);
+		free(hashtab);
+		return (NULL);
+	}
+	hashtab->open = o;
+	return (hashtab);
+}
+
+/* returns the slot, and sets *sp to the slots which has the entry */
+static struct gfarm_hash_entry **
+gfarm_hash_open_lookup(struct gfarm_hash_table *hashtab,
+	const void *key, int keylen, struct gfarm_hash_slots **sp)
+{
+	struct gfarm_hash_open *o = hashtab->open;
+	unsigned int hash = (*hashtab->hash)(key, keylen);
+	unsigned long long x = hash_open_mix(hash);
+	struct gfarm_hash_entry **pp;
+
+	pp = hash_slots_lookup(&o->cur, hashtab->equal, hash, x, key, keylen);
+	if (pp != NULL) {
+		*sp = &o->cur;
+		return (pp);
+	}
+	pp = hash_slots_lookup(&o->old, hashtab->equal, hash, x, key, keylen);
+	if (pp != NULL) {
+		*sp = &o->old;
+		return (pp);
+	}
+	return (NULL);
+}
+
+static struct gfarm_hash_entry *
+gfarm_hash_open_enter(struct gfarm_hash_table *hashtab,
+	const void *key, int keylen, int datalen, int *createdp)
+{
+	struct gfarm_hash_open *o = hashtab->open;
+	struct gfarm_hash_slots *s;
+	struct gfarm_hash_entry *p, **pp;
+
+	pp = gfarm_hash_open_lookup(hashtab, key, keylen, &s);
+	if (pp != NULL)
+		return (*pp);
+
+	if (o->cur.growth_left == 0 && !hash_open_grow(o)) {
+		gflog_debug(GFARM_MSG_1005747,
+		    "growing hash table (%zd) failed", o->cur.capacity);
+		return (NULL);
+	}
+	p = gfarm_hash_entry_alloc(key, keylen, datalen);
+	if (p == NULL)
+		return (NULL);
+	p->u.hash = (*hashtab->hash)(key, keylen);
+	hash_slots_insert(&o->cur, hash_open_mix(p->u.hash), p);
+	if (o->old.ctrl != NULL)
+		hash_open_migrate(o, HASH_OPEN_MIGRATE_GROUPS);
+
+	if (createdp != NULL)
+		*createdp = 1;
+	return (p);
+}
+
+static int
+gfarm_hash_open_purge(struct gfarm_hash_table *hashtab,
+	const void *key, int keylen)
+{
+	struct gfarm_hash_slots *s;
+	struct gfarm_hash_entry *p, **pp;
+
+	pp = gfarm_hash_open_lookup(hashtab, key, keylen, &s);
+	if (pp == NULL)
+		return (0); /* key is not found */
+	p = *pp;
+	hash_slots_erase(s, pp - s->slots);
+	free(p);
+	return (1); /* purged */
+}
+
 void
 gfarm_hash_table_free(struct gfarm_hash_table *hashtab)
 {
 	int i;
 	struct gfarm_hash_entry *p, *np;
 
+	if (hashtab->open != NULL) {
+		hash_slots_free(&hashtab->open->cur, 1);
+		hash_slots_free(&hashtab->open->old, 1);
+		free(hashtab->open);
+	}
 	for (i = 0; i < hashtab->table_size; i++) {
 		for (p = hashtab->buckets[i]; p != NULL; p = np) {
-			np = p->next;
+			np = p->u.next;
 			free(p);
 		}
 	}
@@ -156,7 +727,7 @@ gfarm_hash_lookup_internal_search(struct gfarm_hash_table *hashtab,
 	struct gfarm_hash_entry *p;
 	int (*equal)(const void *, int, const void *, int) = hashtab->equal;
 
-	for (p = *pp; p != NULL; pp = &p->next, p = *pp) {
+	for (p = *pp; p != NULL; pp = &p->u.next, p = *pp) {
 		if ((*equal)(HASH_KEY(p), p->key_length, key, keylen))
 			break;
 	}
@@ -175,9 +746,14 @@ struct gfarm_hash_entry *
 gfarm_hash_lookup(struct gfarm_hash_table *hashtab,
 		  const void *key, int keylen)
 {
-	struct gfarm_hash_entry **pp =
-		GFARM_HASH_LOOKUP_INTERNAL(hashtab, key, keylen);
+	struct gfarm_hash_entry **pp;
+	struct gfarm_hash_slots *s;
 
+	if (hashtab->open != NULL) {
+		pp = gfarm_hash_open_lookup(hashtab, key, keylen, &s);
+		return (pp == NULL ? NULL : *pp);
+	}
+	pp = GFARM_HASH_LOOKUP_INTERNAL(hashtab, key, keylen);
 	return (*pp);
 }
 
@@ -185,44 +761,27 @@ struct gfarm_hash_entry *
 gfarm_hash_enter(struct gfarm_hash_table *hashtab, const void *key, int keylen,
 		  int datalen, int *createdp)
 {
-	struct gfarm_hash_entry *p, **pp =
-		GFARM_HASH_LOOKUP_INTERNAL(hashtab, key, keylen);
-	size_t hash_entry_size;
-	int overflow = 0;
+	struct gfarm_hash_entry *p, **pp;
 
 	if (createdp != NULL)
 		*createdp = 0;
 
+	if (hashtab->open != NULL)
+		return (gfarm_hash_open_enter(hashtab, key, keylen, datalen,
+		    createdp));
+
+	pp = GFARM_HASH_LOOKUP_INTERNAL(hashtab, key, keylen);
 	if (*pp != NULL)
 		return (*pp);
 
 	/*
 	 * create if not found
 	 */
-	hash_entry_size =
-		gfarm_size_add(&overflow,
-		    gfarm_size_add(&overflow,
-			HASH_ALIGN(offsetof(struct gfarm_hash_entry, key_stub)),
-			HASH_ALIGN(keylen)),
-		    datalen);
-	if (overflow) {
-		gflog_debug(GFARM_MSG_1000785,
-			"Overflow when entering hash entry");
-		return (NULL);
-	}
-	p = malloc(hash_entry_size); /* size is already checked */
-	if (p == NULL) {
-		gflog_debug(GFARM_MSG_1000786,
-			"allocation of 'gfarm_hash_entry' failed (%zd)",
-			hash_entry_size);
+	p = gfarm_hash_entry_alloc(key, keylen, datalen);
+	if (p == NULL)
 		return (NULL);
-	}
 	*pp = p;
-
-	p->next = NULL;
-	p->key_length = keylen;
-	p->data_length = datalen;
-	memcpy(HASH_KEY(p), key, keylen);
+	p->u.next = NULL;
 
 	if (createdp != NULL)
 		*createdp = 1;
@@ -232,13 +791,16 @@ gfarm_hash_enter(struct gfarm_hash_table *hashtab, const void *key, int keylen,
 int
 gfarm_hash_purge(struct gfarm_hash_table *hashtab, const void *key, int keylen)
 {
-	struct gfarm_hash_entry *p, **pp =
-		GFARM_HASH_LOOKUP_INTERNAL(hashtab, key, keylen);
+	struct gfarm_hash_entry *p, **pp;
 
+	if (hashtab->open != NULL)
+		return (gfarm_hash_open_purge(hashtab, key, keylen));
+
+	pp = GFARM_HASH_LOOKUP_INTERNAL(hashtab, key, keylen);
 	p = *pp;
 	if (p == NULL)
 		return (0); /* key is not found */
-	*pp = p->next;
+	*pp = p->u.next;
 	free(p);
 	return (1); /* purged */
 }
@@ -269,12 +831,49 @@ gfarm_hash_entry_data_length(struct gfarm_hash_entry *entry)
 
 /*
  * hash iterator
+ *
+ * for an open addressing table, bucket_index is the slot index of
+ * the current table followed by the old table, and pp points the slot.
  */
+
+/* returns the slots which has the index, and converts the index */
+static struct gfarm_hash_slots *
+gfarm_hash_open_iterator_slots(struct gfarm_hash_open *o, size_t *ip)
+{
+	if (*ip < o->cur.capacity)
+		return (&o->cur);
+	*ip -= o->cur.capacity;
+	if (*ip < o->old.capacity)
+		return (&o->old);
+	return (NULL);
+}
+
+static int
+gfarm_hash_open_iterator_valid_entry(struct gfarm_hash_iterator *iterator)
+{
+	struct gfarm_hash_slots *s;
+	size_t i;
+
+	for (;; iterator->bucket_index++) {
+		i = iterator->bucket_index;
+		s = gfarm_hash_open_iterator_slots(iterator->table->open, &i);
+		if (s == NULL)
+			return (0);
+		if (s->ctrl[i] >= 0) {
+			iterator->pp = &s->slots[i];
+			return (1);
+		}
+	}
+}
+
 int
 gfarm_hash_iterator_valid_entry(struct gfarm_hash_iterator *iterator)
 {
 	struct gfarm_hash_table *hashtab = iterator->table;
 
+	if (hashtab->open != NULL)
+		return (gfarm_hash_open_iterator_valid_entry(iterator));
+
 	if (iterator->bucket_index >= hashtab->table_size)
 		return (0);
 	while (*iterator->pp == NULL) {
@@ -297,10 +896,12 @@ gfarm_hash_iterator_begin(struct gfarm_hash_table *hashtab,
 void
 gfarm_hash_iterator_next(struct gfarm_hash_iterator *iterator)
 {
-	if (*iterator->pp == NULL)
+	if (iterator->table->open != NULL)
+		iterator->bucket_index++;
+	else if (*iterator->pp == NULL)
 		iterator->bucket_index++;
 	else
-		iterator->pp = &(*iterator->pp)->next;
+		iterator->pp = &(*iterator->pp)->u.next;
 }
 
 int
@@ -323,7 +924,25 @@ gfarm_hash_iterator_lookup(struct gfarm_hash_table *hashtab,
 	const void *key, int keylen,
 	struct gfarm_hash_iterator *iterator)
 {
+	struct gfarm_hash_slots *s;
+	struct gfarm_hash_entry **pp;
+
 	iterator->table = hashtab;
+	if (hashtab->open != NULL) {
+		pp = gfarm_hash_open_lookup(hashtab, key, keylen, &s);
+		if (pp == NULL) {
+			/* points the end */
+			iterator->bucket_index = hashtab->open->cur.capacity +
+			    hashtab->open->old.capacity;
+			iterator->pp = NULL;
+			return (0);
+		}
+		iterator->bucket_index = pp - s->slots;
+		if (s == &hashtab->open->old)
+			iterator->bucket_index += hashtab->open->cur.capacity;
+		iterator->pp = pp;
+		return (1);
+	}
 	iterator->bucket_index = HASH_BUCKET(hashtab, key, keylen);
 	iterator->pp = gfarm_hash_lookup_internal_search(hashtab,
 	    &hashtab->buckets[HASH_BUCKET(hashtab, key, keylen)],
@@ -335,11 +954,20 @@ int
 gfarm_hash_iterator_purge(struct gfarm_hash_iterator *iterator)
 {
 	struct gfarm_hash_entry *p;
+	struct gfarm_hash_slots *s;
+	size_t i;
 
 	if (!gfarm_hash_iterator_valid_entry(iterator))
 		return (0); /* not purged */
 	p = *iterator->pp;
-	*iterator->pp = p->next;
+	if (iterator->table->open != NULL) {
+		/* the iterator will move to the next entry by valid_entry */
+		i = iterator->bucket_index;
+		s = gfarm_hash_open_iterator_slots(iterator->table->open, &i);
+		hash_slots_erase(s, i);
+	} else {
+		*iterator->pp = p->u.next;
+	}
 	free(p);
 	return (1); /* purged */
 }
@@ -2,6 +2,8 @@
 int gfarm_hash_default(const void *, int);
 int gfarm_hash_add(int, const void *, size_t);
 int gfarm_hash_key_equal_default(const void *, int, const void *, int);
+/* faster than gfarm_hash_default(), but the value depends on the byte order */
+int gfarm_hash_fast(const void *, int);
 /* for string key (casefold) */
 int gfarm_hash_casefold(const void *, int);
 int gfarm_hash_key_equal_casefold(const void *, int, const void *, int);
@@ -20,6 +22,14 @@ struct gfarm_hash_entry;
 struct gfarm_hash_table *gfarm_hash_table_alloc(int,
 	int (*)(const void *, int),
 	int (*)(const void *, int, const void *, int));
+/*
+ * open addressing table which grows as entries are added.
+ * the size is the expected number of entries.
+ * NOTE: gfarm_hash_enter() must not be called while iterating this table.
+ */
+struct gfarm_hash_table *gfarm_hash_table_alloc_resizable(int,
+	int (*)(const void *, int),
+	int (*)(const void *, int, const void *, int));
 void gfarm_hash_table_free(struct gfarm_hash_table *);
 
 struct gfarm_hash_entry *gfarm_hash_lookup(struct gfarm_hash_table *,
@@ -0,0 +1,301 @@
+#include <sys/types.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <openssl/evp.h>
+
+#include <gfarm/gfarm.h>
+
+#include "thrsubr.h"
+
+#include "msgdigest_engine.h"
+
+/*
+ * the file is read by a reader thread into one of the chunks,
+ * while the caller thread is hashing another chunk,
+ * so that I/O and hashing are overlapped.
+ * this is especially effective with O_DIRECT, because the kernel
+ * doesn't do read-ahead in that case.
+ */
+
+#define MSGDIGEST_ENGINE_ALIGNMENT	4096 /* enough for O_DIRECT */
+
+struct msgdigest_reader {
+	pthread_mutex_t mutex;
+	pthread_cond_t filled, emptied;
+
+	int fd;
+	size_t chunksize;
+	char *chunk[GFARM_MSGDIGEST_ENGINE_NBUF];
+	ssize_t len[GFARM_MSGDIGEST_ENGINE_NBUF]; /* -1: error */
+	int error[GFARM_MSGDIGEST_ENGINE_NBUF];
+	int full[GFARM_MSGDIGEST_ENGINE_NBUF];
+
+	int stop; /* the caller doesn't need more data */
+};
+
+static const char READER_DIAG[] = "msgdigest_reader";
+
+/*
+ * all signals are blocked in the helper threads,
+ * so that a signal is delivered to the caller thread, e.g. SIGINT or SIGPIPE.
+ */
+static int
+msgdigest_thread_create(pthread_t *thread, void *(*func)(void *), void *arg)
+{
+	sigset_t all, old;
+	int err;
+
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	err = pthread_create(thread, NULL, func, arg);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	return (err);
+}
+
+static void *
+msgdigest_reader_thread(void *arg)
+{
+	struct msgdigest_reader *r = arg;
+	int i = 1; /* chunk[0] is filled by the caller */
+	ssize_t sz;
+	int save_errno;
+
+	for (;;) {
+		gfarm_mutex_lock(&r->mutex, READER_DIAG, "mutex");
+		while (r->full[i] && !r->stop)
+			gfarm_cond_wait(&r->emptied, &r->mutex,
+			    READER_DIAG, "emptied");
+		if (r->stop) {
+			gfarm_mutex_unlock(&r->mutex, READER_DIAG, "mutex");
+			break;
+		}
+		gfarm_mutex_unlock(&r->mutex, READER_DIAG, "mutex");
+
+		sz = read(r->fd, r->chunk[i], r->chunksize);
+		save_errno = errno;
+
+		gfarm_mutex_lock(&r->mutex, READER_DIAG, "mutex");
+		r->len[i] = sz;
+		r->error[i] = sz == -1 ? save_errno : 0;
+		r->full[i] = 1;
+		gfarm_cond_signal(&r->filled, READER_DIAG, "filled");
+		gfarm_mutex_unlock(&r->mutex, READER_DIAG, "mutex");
+		if (sz <= 0)
+			break;
+		i = (i + 1) % GFARM_MSGDIGEST_ENGINE_NBUF;
+	}
+	return (NULL);
+}
+
+static int
+msgdigest_fd_serial(EVP_MD_CTX *md_ctx, int fd, char *buffer, size_t bufsize,
+	gfarm_off_t *lenp, void (*callback)(void *, ssize_t), void *closure)
+{
+	ssize_t sz;
+
+	while ((sz = read(fd, buffer, bufsize)) > 0) {
+		EVP_DigestUpdate(md_ctx, buffer, sz);
+		*lenp += sz;
+		if (callback != NULL)
+			callback(closure, sz);
+	}
+	return (sz == -1 ? errno : 0);
+}
+
+int
+gfarm_msgdigest_fd(EVP_MD_CTX *md_ctx, int fd, char *buffer, size_t bufsize,
+	gfarm_off_t *lenp, void (*callback)(void *, ssize_t), void *closure)
+{
+	struct msgdigest_reader r;
+	pthread_t reader;
+	gfarm_off_t len = 0;
+	ssize_t sz;
+	int i, err, save_errno = 0;
+	size_t chunksize = bufsize / GFARM_MSGDIGEST_ENGINE_NBUF;
+
+	/* a small file doesn't need the reader thread */
+	sz = read(fd, buffer, chunksize);
+	if (sz <= 0 || (size_t)sz < chunksize) {
+		if (sz == -1)
+			return (errno);
+		if (sz > 0) {
+			EVP_DigestUpdate(md_ctx, buffer, sz);
+			len = sz;
+			if (callback != NULL)
+				callback(closure, sz);
+			/* not always EOF, e.g. a pipe, or a signal */
+			save_errno = msgdigest_fd_serial(md_ctx, fd, buffer,
+			    chunksize, &len, callback, closure);
+		}
+		if (lenp != NULL)
+			*lenp = len;
+		return (save_errno);
+	}
+
+	gfarm_mutex_init(&r.mutex, READER_DIAG, "mutex");
+	gfarm_cond_init(&r.filled, READER_DIAG, "filled");
+	gfarm_cond_init(&r.emptied, READER_DIAG, "emptied");
+	r.fd = fd;
+	r.chunksize = chunksize;
+	for (i = 0; i < GFARM_MSGDIGEST_ENGINE_NBUF; i++) {
+		r.chunk[i] = buffer + i * chunksize;
+		r.len[i] = 0;
+		r.error[i] = 0;
+		r.full[i] = 0;
+	}
+	r.len[0] = sz;
+	r.full[0] = 1;
+	r.stop = 0;
+
+	if ((err = msgdigest_thread_create(&reader,
+	    msgdigest_reader_thread, &r)) != 0) {
+		gflog_debug(GFARM_MSG_1005781,
+		    "msgdigest: pthread_create: %s, no read-ahead",
+		    strerror(err));
+		EVP_DigestUpdate(md_ctx, buffer, sz);
+		len = sz;
+		if (callback != NULL)
+			callback(closure, sz);
+		save_errno = msgdigest_fd_serial(md_ctx, fd, buffer, chunksize,
+		    &len, callback, closure);
+	} else {
+		for (i = 0;; i = (i + 1) % GFARM_MSGDIGEST_ENGINE_NBUF) {
+			gfarm_mutex_lock(&r.mutex, READER_DIAG, "mutex");
+			while (!r.full[i])
+				gfarm_cond_wait(&r.filled, &r.mutex,
+				    READER_DIAG, "filled");
+			sz = r.len[i];
+			save_errno = r.error[i];
+			gfarm_mutex_unlock(&r.mutex, READER_DIAG, "mutex");
+			if (sz <= 0)
+				break;
+
+			EVP_DigestUpdate(md_ctx, r.chunk[i], sz);
+			len += sz;
+			if (callback != NULL)
+				callback(closure, sz);
+
+			gfarm_mutex_lock(&r.mutex, READER_DIAG, "mutex");
+			r.full[i] = 0;
+			gfarm_cond_signal(&r.emptied, READER_DIAG, "emptied");
+			gfarm_mutex_unlock(&r.mutex, READER_DIAG, "mutex");
+		}
+		gfarm_mutex_lock(&r.mutex, READER_DIAG, "mutex");
+		r.stop = 1;
+		gfarm_cond_signal(&r.emptied, READER_DIAG, "emptied");
+		gfarm_mutex_unlock(&r.mutex, READER_DIAG, "mutex");
+		pthread_join(reader, NULL);
+	}
+
+	gfarm_cond_destroy(&r.emptied, READER_DIAG, "emptied");
+	gfarm_cond_destroy(&r.filled, READER_DIAG, "filled");
+	gfarm_mutex_destroy(&r.mutex, READER_DIAG, "mutex");
+	if (lenp != NULL)
+		*lenp = len;
+	return (save_errno);
+}
+
+/*
+ * OpenSSL doesn't provide multi-buffer hashing for EVP_MD,
+ * thus several files are hashed in parallel by worker threads instead.
+ */
+
+struct msgdigest_workers {
+	pthread_mutex_t mutex;
+	int next, njobs;
+	struct gfarm_msgdigest_job *jobs;
+	size_t bufsize;
+};
+
+static const char WORKERS_DIAG[] = "msgdigest_workers";
+
+static void
+msgdigest_worker_run(struct msgdigest_workers *w, char *buffer)
+{
+	struct gfarm_msgdigest_job *job;
+	int i;
+
+	for (;;) {
+		gfarm_mutex_lock(&w->mutex, WORKERS_DIAG, "mutex");
+		i = w->next < w->njobs ? w->next++ : -1;
+		gfarm_mutex_unlock(&w->mutex, WORKERS_DIAG, "mutex");
+		if (i == -1)
+			break;
+
+		job = &w->jobs[i];
+		job->len = 0;
+		job->error = gfarm_msgdigest_fd(job->md_ctx, job->fd,
+		    buffer, w->bufsize, &job->len, NULL, NULL);
+	}
+}
+
+static void *
+msgdigest_worker_thread(void *arg)
+{
+	struct msgdigest_workers *w = arg;
+	void *buffer;
+
+	if (posix_memalign(&buffer, MSGDIGEST_ENGINE_ALIGNMENT, w->bufsize)
+	    != 0)
+		return (NULL); /* the remaining jobs are done by others */
+	msgdigest_worker_run(w, buffer);
+	free(buffer);
+	return (NULL);
+}
+
+/*
+ * `bufsize' is for each file, see gfarm_msgdigest_fd().
+ * returns 0 or errno.  the result for each file is in jobs[i].error.
+ */
+int
+gfarm_msgdigest_fd_multi(int njobs, struct gfarm_msgdigest_job *jobs,
+	int nthreads, size_t bufsize)
+{
+	struct msgdigest_workers w;
+	pthread_t *threads;
+	void *buffer;
+	int i, n, err;
+
+	if (posix_memalign(&buffer, MSGDIGEST_ENGINE_ALIGNMENT, bufsize) != 0)
+		return (ENOMEM);
+	if (nthreads > njobs)
+		nthreads = njobs;
+	if (nthreads < 1)
+		nthreads = 1;
+	GFARM_MALLOC_ARRAY(threads, nthreads - 1 > 0 ? nthreads - 1 : 1);
+	if (threads == NULL) {
+		free(buffer);
+		return (ENOMEM);
+	}
+
+	gfarm_mutex_init(&w.mutex, WORKERS_DIAG, "mutex");
+	w.next = 0;
+	w.njobs = njobs;
+	w.jobs = jobs;
+	w.bufsize = bufsize;
+
+	/* the caller thread is one of the workers */
+	for (n = 0; n < nthreads - 1; n++) {
+		err = msgdigest_thread_create(&threads[n],
+		    msgdigest_worker_thread, &w);
+		if (err != 0) {
+			gflog_debug(GFARM_MSG_1005782,
+			    "msgdigest: pthread_create: %s, %d workers",
+			    strerror(err), n + 1);
+			break;
+		}
+	}
+	msgdigest_worker_run(&w, buffer);
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	gfarm_mutex_destroy(&w.mutex, WORKERS_DIAG, "mutex");
+	free(threads);
+	free(buffer);
+	return (0);
+}
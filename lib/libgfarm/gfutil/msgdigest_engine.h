@@ -0,0 +1,32 @@
+/*
+ * streaming message digest calculation of local files
+ *
+ * this requires <openssl/evp.h> and <gfarm/gfarm.h>
+ */
+
+/* number of buffers used for the read-ahead */
+#define GFARM_MSGDIGEST_ENGINE_NBUF	2
+
+/*
+ * `buffer' is split into GFARM_MSGDIGEST_ENGINE_NBUF chunks,
+ * thus `bufsize' should be a multiple of
+ * GFARM_MSGDIGEST_ENGINE_NBUF * (alignment required by O_DIRECT),
+ * if `fd' is opened with O_DIRECT.
+ * `callback' is called in the caller thread for each chunk read.
+ * returns 0 or errno.
+ */
+int gfarm_msgdigest_fd(EVP_MD_CTX *, int, char *, size_t, gfarm_off_t *,
+	void (*)(void *, ssize_t), void *);
+
+struct gfarm_msgdigest_job {
+	/* input */
+	int fd;
+	EVP_MD_CTX *md_ctx;
+
+	/* output */
+	gfarm_off_t len;
+	int error; /* 0 or errno */
+};
+
+/* calculate message digests of several files concurrently */
+int gfarm_msgdigest_fd_multi(int, struct gfarm_msgdigest_job *, int, size_t);
@@ -491,4 +491,141 @@ gfarm_queuelock_destroy(struct gfarm_queuelock *ql,
 	gfarm_mutex_destroy(&ql->mutex, where, what);
 }
 
+
+/*
+ * reader/writer lock which grants the lock in FIFO order.
+ *
+ * consecutive readers at the head of the queue are granted together,
+ * but a reader which arrives after a waiting writer has to wait for
+ * the writer, thus neither readers nor writers starve.
+ * the lock is handed over by the unlocker, like gfarm_queuelock.
+ */
+
+struct gfarm_rwqueuelock_waiter {
+	struct gfarm_rwqueuelock_waiter *next;
+	pthread_cond_t granted_cond;
+	int shared, granted;
+};
+
+void
+gfarm_rwqueuelock_init(struct gfarm_rwqueuelock *rl,
+	const char *where, const char *what)
+{
+	gfarm_mutex_init(&rl->mutex, where, what);
+	rl->head = NULL;
+	rl->tail = &rl->head;
+	rl->readers = 0;
+	rl->writer = 0;
+}
+
+/* rl->mutex should be held */
+static void
+gfarm_rwqueuelock_grant(struct gfarm_rwqueuelock *rl,
+	const char *where, const char *what)
+{
+	struct gfarm_rwqueuelock_waiter *w;
+
+	while ((w = rl->head) != NULL && !rl->writer) {
+		if (w->shared)
+			rl->readers++;
+		else if (rl->readers == 0)
+			rl->writer = 1;
+		else
+			break;
+		rl->head = w->next;
+		if (rl->head == NULL)
+			rl->tail = &rl->head;
+		w->granted = 1;
+		gfarm_cond_signal(&w->granted_cond, where, what);
+	}
+}
+
+static void
+gfarm_rwqueuelock_wait(struct gfarm_rwqueuelock *rl, int shared,
+	const char *where, const char *what)
+{
+	struct gfarm_rwqueuelock_waiter me;
+
+	gfarm_cond_init(&me.granted_cond, where, what);
+	me.next = NULL;
+	me.shared = shared;
+	me.granted = 0;
+	*rl->tail = &me;
+	rl->tail = &me.next;
+	do {
+		gfarm_cond_wait(&me.granted_cond, &rl->mutex, where, what);
+	} while (!me.granted); /* for spurious wakeup */
+	gfarm_cond_destroy(&me.granted_cond, where, what);
+}
+
+void
+gfarm_rwqueuelock_rdlock(struct gfarm_rwqueuelock *rl,
+	const char *where, const char *what)
+{
+	gfarm_mutex_lock(&rl->mutex, where, what);
+	if (rl->writer || rl->head != NULL)
+		gfarm_rwqueuelock_wait(rl, 1, where, what);
+	else
+		rl->readers++;
+	gfarm_mutex_unlock(&rl->mutex, where, what);
+}
+
+void
+gfarm_rwqueuelock_wrlock(struct gfarm_rwqueuelock *rl,
+	const char *where, const char *what)
+{
+	gfarm_mutex_lock(&rl->mutex, where, what);
+	if (rl->writer || rl->readers > 0 || rl->head != NULL)
+		gfarm_rwqueuelock_wait(rl, 0, where, what);
+	else
+		rl->writer = 1;
+	gfarm_mutex_unlock(&rl->mutex, where, what);
+}
+
+/* false: busy */
+int
+gfarm_rwqueuelock_trywrlock(struct gfarm_rwqueuelock *rl,
+	const char *where, const char *what)
+{
+	int locked;
+
+	gfarm_mutex_lock(&rl->mutex, where, what);
+	/* unlocked AND there is no waiter */
+	locked = !rl->writer && rl->readers == 0 && rl->head == NULL;
+	if (locked)
+		rl->writer = 1;
+	gfarm_mutex_unlock(&rl->mutex, where, what);
+	return (locked);
+}
+
+/* this can be used for both shared and exclusive lock */
+void
+gfarm_rwqueuelock_unlock(struct gfarm_rwqueuelock *rl,
+	const char *where, const char *what)
+{
+	gfarm_mutex_lock(&rl->mutex, where, what);
+	if (rl->writer) {
+		rl->writer = 0;
+	} else {
+		assert(rl->readers > 0);
+		rl->readers--;
+	}
+	gfarm_rwqueuelock_grant(rl, where, what);
+	gfarm_mutex_unlock(&rl->mutex, where, what);
+}
+
+void
+gfarm_rwqueuelock_destroy(struct gfarm_rwqueuelock *rl,
+	const char *where, const char *what)
+{
+	/* assertion */
+	if (rl->writer || rl->readers > 0 || rl->head != NULL)
+		gflog_fatal(GFARM_MSG_1005664,
+		    "destroying rwqueuelock while using: "
+		    "writer:%d readers:%d head:%p",
+		     rl->writer, rl->readers, rl->head);
+
+	gfarm_mutex_destroy(&rl->mutex, where, what);
+}
+
 #endif /* __KERNEL__ */
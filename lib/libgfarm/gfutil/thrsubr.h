@@ -59,6 +59,25 @@ void gfarm_queuelock_unlock(struct gfarm_queuelock *,
 void gfarm_queuelock_destroy(struct gfarm_queuelock *,
 	const char *, const char *);
 
+struct gfarm_rwqueuelock_waiter;
+struct gfarm_rwqueuelock {
+	pthread_mutex_t mutex;
+	struct gfarm_rwqueuelock_waiter *head, **tail;
+	int readers, writer;
+};
+void gfarm_rwqueuelock_init(struct gfarm_rwqueuelock *,
+	const char *, const char *);
+void gfarm_rwqueuelock_rdlock(struct gfarm_rwqueuelock *,
+	const char *, const char *);
+void gfarm_rwqueuelock_wrlock(struct gfarm_rwqueuelock *,
+	const char *, const char *);
+int gfarm_rwqueuelock_trywrlock(struct gfarm_rwqueuelock *,
+	const char *, const char *);
+void gfarm_rwqueuelock_unlock(struct gfarm_rwqueuelock *,
+	const char *, const char *);
+void gfarm_rwqueuelock_destroy(struct gfarm_rwqueuelock *,
+	const char *, const char *);
+
 #ifdef __KERNEL__	/* PTHREAD_MUTEX_INITIALIZER */
 #define GFARM_MUTEX_INITIALIZER(name)   __MUTEX_INITIALIZER(name)
 #else /* __KERNEL__ */
@@ -0,0 +1,21 @@
+/*
+ * $Id$
+ */
+
+/*
+ * assertion for the regression test programs.
+ * a program exits with EXIT_FAILURE when an assertion fails,
+ * and the test script which invoked it returns $exit_fail.
+ */
+
+#define TEST_ASSERT(msg, x) \
+	test_assert((msg), (x), __FILE__, __LINE__)
+
+static void
+test_assert(const char *msg, int ok, const char *file, int line)
+{
+	if (ok)
+		return;
+	fprintf(stderr, "error: %s at %s:%d\n", msg, file, line);
+	exit(EXIT_FAILURE);
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libgen.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfm_client.h"
+#include "lookup.h"
+
+/*
+ * print inode numbers which have the extended attribute, found by
+ * GFM_PROTO_XATTR_FIND.  a small -n exercises the paging by the cookie.
+ * if the request fails, the error string is printed instead.
+ */
+
+char *program_name = "findxattr";
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "Usage: %s [-n <nentries>] [-v <value>] <gfarm_url> <xattr>\n",
+	    program_name);
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	int c, i, n, eof = 0, nalloc = 1;
+	char *value = NULL;
+	gfarm_ino_t cookie = 0, *inums;
+	gfarm_uint64_t *gens;
+	struct gfm_connection *gfm_server;
+	gfarm_error_t e;
+
+	if (argc > 0)
+		program_name = basename(argv[0]);
+
+	e = gfarm_initialize(&argc, &argv);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "gfarm_initialize: %s\n",
+		    gfarm_error_string(e));
+		return (1);
+	}
+
+	while ((c = getopt(argc, argv, "n:v:")) != -1) {
+		switch (c) {
+		case 'n':
+			nalloc = atoi(optarg);
+			break;
+		case 'v':
+			value = optarg;
+			break;
+		default:
+			fprintf(stderr, "%s: unknown option -%c\n",
+				program_name, c);
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 2 || nalloc <= 0)
+		usage();
+
+	GFARM_MALLOC_ARRAY(inums, nalloc);
+	GFARM_MALLOC_ARRAY(gens, nalloc);
+	if (inums == NULL || gens == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		return (1);
+	}
+	e = gfm_client_connection_and_process_acquire_by_path(argv[0],
+	    &gfm_server);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: %s\n", argv[0], gfarm_error_string(e));
+		return (1);
+	}
+	while (!eof) {
+		if ((e = gfm_client_findxattr_request(gfm_server, 0, argv[1],
+		    value, value != NULL ? strlen(value) : 0,
+		    cookie, nalloc)) != GFARM_ERR_NO_ERROR ||
+		    (e = gfm_client_findxattr_result(gfm_server, nalloc,
+		    &eof, &n, &cookie, inums, gens)) != GFARM_ERR_NO_ERROR) {
+			printf("%s\n", gfarm_error_string(e));
+			break;
+		}
+		for (i = 0; i < n; i++)
+			printf("%lld\n", (long long)inums[i]);
+	}
+	gfm_client_connection_free(gfm_server);
+	free(inums);
+	free(gens);
+
+	e = gfarm_terminate();
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "gfarm_terminate: %s\n",
+		    gfarm_error_string(e));
+		return (1);
+	}
+	return (0);
+}
@@ -0,0 +1,56 @@
+#!/bin/sh
+
+. ./regress.conf
+
+if $regress/bin/am_I_gfarm_super_root; then :; else
+	exit $exit_unsupported
+fi
+
+name=user.regress.findxattr.$$
+not_supported="operation not supported"
+
+trap 'gfrm -rf $gftmp; rm -f $localtmp; exit $exit_trap' $trap_sigs
+
+inum()
+{
+	gfls -id "$1" | awk '{ print $1 }'
+}
+
+if gfmkdir $gftmp &&
+   gfreg $data/1byte $gftmp/a &&
+   gfreg $data/1byte $gftmp/b &&
+   gfreg $data/1byte $gftmp/c &&
+   printf x | gfxattr -s $gftmp/a $name &&
+   printf y | gfxattr -s $gftmp/c $name &&
+   gfncopy -s 3 $gftmp/b &&
+   a=`inum $gftmp/a` && b=`inum $gftmp/b` && c=`inum $gftmp/c` &&
+   $testbin/findxattr $gftmp $name >$localtmp
+then
+   if [ "`cat $localtmp`" = "$not_supported" ]; then
+	# xattr_index is disabled
+	exit_code=$exit_unsupported
+   elif
+	# the result is paged one by one, and is sorted by the inode number
+	[ "`cat $localtmp`" = "`printf '%s\n' $a $c | sort -n`" ] &&
+
+	# gfarm.ncopy is always cached, and can be searched by the value
+	$testbin/findxattr -n 10 -v 3 $gftmp gfarm.ncopy | grep "^$b\$" \
+		>/dev/null &&
+	result=`$testbin/findxattr -n 10 -v 2 $gftmp gfarm.ncopy` &&
+	[ "$result" != "$not_supported" ] &&
+	! echo "$result" | grep "^$b\$" >/dev/null &&
+
+	# an uncached value has to be reported as not supported
+	result=`$testbin/findxattr -v x $gftmp $name` &&
+	{ [ "$result" = "$not_supported" ] || [ "$result" = "$a" ]; } &&
+
+	gfxattr -r $gftmp/a $name &&
+	[ "`$testbin/findxattr $gftmp $name`" = "$c" ]
+   then
+	exit_code=$exit_pass
+   fi
+fi
+
+gfrm -rf $gftmp
+rm -f $localtmp
+exit $exit_code
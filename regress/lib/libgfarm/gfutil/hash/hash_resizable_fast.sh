@@ -0,0 +1,11 @@
+#!/bin/sh
+
+. ./regress.conf
+
+trap 'exit $exit_trap' $trap_sigs
+
+if $testbin/hash_test -f; then
+	exit_code=$exit_pass
+fi
+
+exit $exit_code
@@ -0,0 +1,186 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hash.h"
+
+#include "test_assert.h"
+
+static const char *program_name = "hash_test";
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s -c|-r|-f\n", program_name);
+	fprintf(stderr, "\t-c: chained table\n");
+	fprintf(stderr, "\t-r: resizable table\n");
+	fprintf(stderr, "\t-f: resizable table with gfarm_hash_fast()\n");
+	exit(2);
+}
+
+/*
+ * functional test, compares a table with a simple array
+ */
+
+#define T_NKEYS		50000
+#define T_NOPS		1000000
+
+/* typical size of chained tables in gfarm */
+#define T_CHAINED_SIZE	1009
+
+struct t_model {
+	struct gfarm_hash_entry *entry;	/* NULL if not entered */
+	int data;
+};
+
+static struct t_model model[T_NKEYS];
+
+static void
+t_check_all(struct gfarm_hash_table *tab)
+{
+	struct gfarm_hash_iterator it;
+	struct gfarm_hash_entry *e;
+	int i, key, n = 0, nmodel = 0;
+	static unsigned char seen[T_NKEYS];
+
+	memset(seen, 0, sizeof(seen));
+	for (gfarm_hash_iterator_begin(tab, &it);
+	    !gfarm_hash_iterator_is_end(&it);
+	    gfarm_hash_iterator_next(&it)) {
+		e = gfarm_hash_iterator_access(&it);
+		key = *(int *)gfarm_hash_entry_key(e);
+		TEST_ASSERT("iterated key is valid", key >= 0 && key < T_NKEYS);
+		TEST_ASSERT("iterated once", !seen[key]);
+		seen[key] = 1;
+		TEST_ASSERT("iterated entry", model[key].entry == e);
+		n++;
+	}
+	for (i = 0; i < T_NKEYS; i++) {
+		if (model[i].entry != NULL)
+			nmodel++;
+	}
+	TEST_ASSERT("number of iterated entries", n == nmodel);
+}
+
+static void
+t_functional(struct gfarm_hash_table *tab)
+{
+	struct gfarm_hash_iterator it;
+	struct gfarm_hash_entry *e;
+	int i, key, created, op;
+
+	memset(model, 0, sizeof(model));
+	srandom(1);
+	for (i = 0; i < T_NOPS; i++) {
+		key = random() % T_NKEYS;
+		/* enter more than purge, to grow the table */
+		op = random() % (i < T_NOPS / 2 ? 8 : 5);
+		switch (op) {
+		case 0:
+		case 1:
+			e = gfarm_hash_lookup(tab, &key, sizeof(key));
+			TEST_ASSERT("lookup", e == model[key].entry);
+			if (e != NULL)
+				TEST_ASSERT("data", *(int *)gfarm_hash_entry_data(e)
+				    == model[key].data);
+			break;
+		case 2:
+			TEST_ASSERT("purge", gfarm_hash_purge(tab, &key, sizeof(key))
+			    == (model[key].entry != NULL));
+			model[key].entry = NULL;
+			break;
+		case 3:
+			TEST_ASSERT("iterator lookup", gfarm_hash_iterator_lookup(
+			    tab, &key, sizeof(key), &it) ==
+			    (model[key].entry != NULL));
+			if (model[key].entry == NULL)
+				break;
+			TEST_ASSERT("iterator access",
+			    gfarm_hash_iterator_access(&it) ==
+			    model[key].entry);
+			TEST_ASSERT("iterator purge", gfarm_hash_iterator_purge(&it));
+			model[key].entry = NULL;
+			break;
+		default:
+			e = gfarm_hash_enter(tab, &key, sizeof(key),
+			    sizeof(int), &created);
+			TEST_ASSERT("enter", e != NULL);
+			TEST_ASSERT("created", created == (model[key].entry == NULL));
+			/* an entry never moves */
+			TEST_ASSERT("entry", created || e == model[key].entry);
+			model[key].entry = e;
+			model[key].data = i;
+			*(int *)gfarm_hash_entry_data(e) = i;
+			break;
+		}
+		if (i % (T_NOPS / 10) == 0)
+			t_check_all(tab);
+	}
+	t_check_all(tab);
+
+	/* purge every other entry while iterating */
+	for (gfarm_hash_iterator_begin(tab, &it), i = 0;
+	    !gfarm_hash_iterator_is_end(&it); i++) {
+		e = gfarm_hash_iterator_access(&it);
+		key = *(int *)gfarm_hash_entry_key(e);
+		if (i % 2 == 0) {
+			TEST_ASSERT("purge while iterating",
+			    gfarm_hash_iterator_purge(&it));
+			model[key].entry = NULL;
+		} else {
+			gfarm_hash_iterator_next(&it);
+		}
+	}
+	t_check_all(tab);
+
+	/* purge all while iterating */
+	for (gfarm_hash_iterator_begin(tab, &it);
+	    !gfarm_hash_iterator_is_end(&it);) {
+		e = gfarm_hash_iterator_access(&it);
+		model[*(int *)gfarm_hash_entry_key(e)].entry = NULL;
+		TEST_ASSERT("purge all", gfarm_hash_iterator_purge(&it));
+	}
+	t_check_all(tab);
+	gfarm_hash_table_free(tab);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct gfarm_hash_table *tab = NULL;
+	int c, op = 0;
+
+	while ((c = getopt(argc, argv, "crf")) != -1) {
+		switch (c) {
+		case 'c':
+		case 'r':
+		case 'f':
+			op = c;
+			break;
+		default:
+			usage();
+		}
+	}
+	switch (op) {
+	case 'c':
+		tab = gfarm_hash_table_alloc(T_CHAINED_SIZE,
+		    gfarm_hash_default, gfarm_hash_key_equal_default);
+		break;
+	case 'r':
+		/* start small to grow many times */
+		tab = gfarm_hash_table_alloc_resizable(0,
+		    gfarm_hash_default, gfarm_hash_key_equal_default);
+		break;
+	case 'f':
+		tab = gfarm_hash_table_alloc_resizable(0,
+		    gfarm_hash_fast, gfarm_hash_key_equal_default);
+		break;
+	default:
+		usage();
+	}
+	TEST_ASSERT("gfarm_hash_table_alloc", tab != NULL);
+	t_functional(tab);
+	return (0);
+}
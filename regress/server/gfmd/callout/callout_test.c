@@ -0,0 +1,312 @@
+/*
+ * $Id$
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+#include "thrsubr.h"
+#include "timer.h"
+
+#include "config.h"
+
+#include "subr.h"
+#include "thrpool.h"
+#include "callout.h"
+
+#include "test_assert.h"
+
+static char *program_name = "callout_test";
+
+#define GETOPT_ARG	"fg:is:?"
+#define HELPOPT		"[-g <ngroups>] [-s <nshards_per_group>] -f|-i"
+
+/* the callout tick, a callout may fire up to this earlier */
+#define TICK_MICROSEC		10000
+/* a callout is considered lost if it's later than this */
+#define LATE_LIMIT_MICROSEC	1000000
+
+static void
+usage(void)
+{
+	fprintf(stderr, "%s " HELPOPT "\n", program_name);
+	fprintf(stderr, "\t-f: callouts fire in time, and only once\n");
+	fprintf(stderr, "\t-i: a blocked thread pool doesn't delay others, "
+	    "needs 2 groups at least\n");
+	exit(EXIT_FAILURE);
+}
+
+struct t_callout {
+	struct callout *callout;
+	int delay;	/* microseconds */
+	int expect_fire;
+	gfarm_timerval_t scheduled, fired;
+	int nfired;
+};
+
+static long long
+t_delay(struct t_callout *t)
+{
+	return (gfarm_timerval_sub(&t->fired, &t->scheduled) *
+	    GFARM_SECOND_BY_MICROSEC);
+}
+
+static pthread_mutex_t t_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t t_cond = PTHREAD_COND_INITIALIZER;
+static int t_nfired;
+
+static void *
+t_fired(void *arg)
+{
+	struct t_callout *t = arg;
+
+	pthread_mutex_lock(&t_mutex);
+	gfarm_gettimerval(&t->fired);
+	t->nfired++;
+	t_nfired++;
+	/* t_blocker() may be waiting on t_cond as well */
+	pthread_cond_broadcast(&t_cond);
+	pthread_mutex_unlock(&t_mutex);
+	return (NULL);
+}
+
+/* callouts fire in time, and only once, unless they are stopped */
+static void
+t_fire(void)
+{
+	/*
+	 * 2.56 seconds is the span of the level 0 of the wheel,
+	 * so the later ones are cascaded from the upper level.
+	 */
+	static struct t_callout t[] = {
+		{ NULL,       0, 1 },
+		{ NULL,    5000, 1 },
+		{ NULL,   20000, 1 },
+		{ NULL,  100000, 1 },
+		{ NULL,  300000, 0 },	/* stopped */
+		{ NULL, 1000000, 1 },
+		{ NULL, 2600000, 1 },
+		{ NULL, 3000000, 0 },	/* rescheduled to `resched' */
+		{ NULL, 3500000, 1 },
+		{ NULL, 5000000, 0 },	/* stopped */
+	};
+	const int n = sizeof(t) / sizeof(t[0]), stopped0 = 4, stopped1 = 9;
+	const int resched = 7, resched_delay = 50000;
+	struct thread_pool *thrpool;
+	struct timespec deadline;
+	int i, nexpected = 0, rv;
+	long long d;
+
+	thrpool = thrpool_new(2, 16, "callout test");
+	TEST_ASSERT("thrpool_new", thrpool != NULL);
+
+	for (i = 0; i < n; i++) {
+		t[i].callout = callout_new();
+		TEST_ASSERT("callout_new", t[i].callout != NULL);
+		if (t[i].expect_fire)
+			nexpected++;
+	}
+	for (i = 0; i < n; i++) {
+		gfarm_gettimerval(&t[i].scheduled);
+		callout_reset(t[i].callout, t[i].delay,
+		    thrpool, t_fired, &t[i]);
+	}
+
+	TEST_ASSERT("stop before firing", !callout_stop(t[stopped0].callout));
+	gfarm_gettimerval(&t[resched].scheduled);
+	t[resched].delay = resched_delay;
+	t[resched].expect_fire = 1;
+	nexpected++;
+	callout_schedule(t[resched].callout, t[resched].delay);
+
+	gfarm_gettime(&deadline);
+	deadline.tv_sec += 10;
+	pthread_mutex_lock(&t_mutex);
+	while (t_nfired < nexpected) {
+		rv = pthread_cond_timedwait(&t_cond, &t_mutex, &deadline);
+		TEST_ASSERT("all callouts fired in time", rv == 0);
+	}
+	pthread_mutex_unlock(&t_mutex);
+
+	TEST_ASSERT("stop after firing", !callout_stop(t[stopped1].callout));
+
+	/* wait a bit more to catch spurious firings */
+	gfarm_nanosleep(200 * GFARM_MILLISEC_BY_NANOSEC);
+
+	pthread_mutex_lock(&t_mutex);
+	for (i = 0; i < n; i++) {
+		if (!t[i].expect_fire) {
+			TEST_ASSERT("stopped callout didn't fire",
+			    t[i].nfired == 0);
+			continue;
+		}
+		TEST_ASSERT("fired exactly once", t[i].nfired == 1);
+		d = t_delay(&t[i]);
+		if (d < t[i].delay - TICK_MICROSEC ||
+		    d > t[i].delay + LATE_LIMIT_MICROSEC) {
+			fprintf(stderr, "%s: callout delay %d fired at %lld\n",
+			    program_name, t[i].delay, d);
+			TEST_ASSERT("fire time", 0);
+		}
+	}
+	pthread_mutex_unlock(&t_mutex);
+
+	for (i = 0; i < n; i++) {
+		callout_stop(t[i].callout);
+		callout_free(t[i].callout);
+	}
+}
+
+static int t_released;
+
+static void *
+t_blocker(void *arg)
+{
+	pthread_mutex_lock(&t_mutex);
+	t_released = -1; /* started */
+	pthread_cond_broadcast(&t_cond);
+	while (t_released <= 0)
+		pthread_cond_wait(&t_cond, &t_mutex);
+	pthread_mutex_unlock(&t_mutex);
+	return (NULL);
+}
+
+static void *
+t_nop(void *arg)
+{
+	return (NULL);
+}
+
+/*
+ * a shard thread blocked in thrpool_add_job() doesn't delay
+ * the callouts of other thread pools.
+ * this needs 2 groups at least.
+ */
+static void
+t_isolation(void)
+{
+	static struct t_callout t[4];
+	const int n = sizeof(t) / sizeof(t[0]), delay = 100000;
+	struct thread_pool *blocked, *other;
+	struct callout *bc;
+	struct timespec deadline;
+	int i, rv;
+	long long d;
+
+	blocked = thrpool_new(1, 1, "callout test blocked");
+	other = thrpool_new(1, 16, "callout test other");
+	TEST_ASSERT("thrpool_new", blocked != NULL && other != NULL);
+
+	/* occupy the worker and the queue of `blocked' */
+	t_released = 0;
+	thrpool_add_job(blocked, t_blocker, NULL);
+	pthread_mutex_lock(&t_mutex);
+	while (t_released == 0)
+		pthread_cond_wait(&t_cond, &t_mutex);
+	pthread_mutex_unlock(&t_mutex);
+	thrpool_add_job(blocked, t_nop, NULL);
+
+	/* callouts are spread by their address over the shards of a group */
+	bc = callout_new();
+	TEST_ASSERT("callout_new", bc != NULL);
+	for (i = 0; i < n; i++) {
+		t[i].callout = callout_new();
+		TEST_ASSERT("callout_new", t[i].callout != NULL);
+	}
+	callout_reset(bc, 0, blocked, t_nop, NULL);
+
+	t_nfired = 0;
+	for (i = 0; i < n; i++) {
+		t[i].delay = delay;
+		gfarm_gettimerval(&t[i].scheduled);
+		callout_reset(t[i].callout, delay, other, t_fired, &t[i]);
+	}
+
+	gfarm_gettime(&deadline);
+	deadline.tv_sec += 10;
+	pthread_mutex_lock(&t_mutex);
+	while (t_nfired < n) {
+		rv = pthread_cond_timedwait(&t_cond, &t_mutex, &deadline);
+		TEST_ASSERT("isolation: callouts fired", rv == 0);
+	}
+	for (i = 0; i < n; i++) {
+		d = t_delay(&t[i]);
+		TEST_ASSERT("isolation: fire time",
+		    d <= delay + LATE_LIMIT_MICROSEC);
+	}
+	t_released = 1;
+	pthread_cond_broadcast(&t_cond);
+	pthread_mutex_unlock(&t_mutex);
+
+	callout_stop(bc);
+	callout_free(bc);
+	for (i = 0; i < n; i++) {
+		callout_stop(t[i].callout);
+		callout_free(t[i].callout);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	gfarm_error_t e;
+	int c, op = 0, ngroups = 1, nshards = 1;
+
+	/* XXX: settings in gfmd.conf doesn't work in this case */
+	char *config  = getenv("GFARM_CONFIG_FILE");
+
+	debug_mode = 1;
+	e = gfarm_server_initialize_for_gfmd(config, &argc, &argv);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: gfarm_server_initialize: %s\n",
+		    argv[0], gfarm_error_string(e));
+		fprintf(stderr, "%s: aborting\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	while ((c = getopt(argc, argv, GETOPT_ARG)) != -1) {
+		switch (c) {
+		default:
+			fprintf(stderr, "%s: unknown option -%c\n",
+			    program_name, c);
+			/* no break */
+		case '?':
+			usage();
+			break;
+		case 'g':
+			ngroups = atoi(optarg);
+			break;
+		case 's':
+			nshards = atoi(optarg);
+			break;
+		case 'f':
+		case 'i':
+			op = c;
+			break;
+		}
+	}
+	if (op == 0 || ngroups <= 0 || nshards <= 0)
+		usage();
+	if (op == 'i' && ngroups < 2)
+		usage();
+
+	callout_module_init(ngroups, nshards);
+
+	switch (op) {
+	case 'f':
+		t_fire();
+		break;
+	case 'i':
+		t_isolation();
+		break;
+	}
+	return (EXIT_SUCCESS);
+}
@@ -9,7 +9,10 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <pthread.h>
 
 #include "db_journal.c"
@@ -46,8 +49,8 @@ struct t_username {
 	const char *username, *realname;
 };
 
-#define GETOPT_ARG	"apow?"
-#define HELPOPT		"apow?"
+#define GETOPT_ARG	"agpow?"
+#define HELPOPT		"agpow?"
 
 static void
 usage(void)
@@ -3611,6 +3614,135 @@ t_apply(void)
 	journal_file_close(self_jf);
 }
 
+/***********************************************/
+/* t_group_commit */
+
+/*
+ * a gfmd process is forked for each case, and reports its replies
+ * through a pipe.  it's killed between the commit and the sync,
+ * and no reply must be seen before that.
+ */
+
+static int t_group_commit_fd; /* the pipe to the parent */
+
+static void
+t_group_commit_report(char c)
+{
+	TEST_ASSERT0(write(t_group_commit_fd, &c, 1) == 1);
+}
+
+static gfarm_error_t
+t_group_commit_request(gfarm_uint64_t seqnum)
+{
+	db_journal_group_commit_request(seqnum);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* the sync never finishes, until the process is killed */
+static gfarm_error_t
+t_group_commit_crash(void)
+{
+	for (;;)
+		pause();
+	/*NOTREACHED*/
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+t_group_commit_sync(void)
+{
+	gfarm_error_t e = db_journal_file_writer_sync();
+
+	t_group_commit_report('s');
+	return (e);
+}
+
+/* a reply to a client, or a request to gfsd */
+static void *
+t_group_commit_reply(void *arg)
+{
+	db_journal_group_commit_wait(db_journal_group_commit_seqnum());
+	t_group_commit_report(*(char *)arg);
+	return (NULL);
+}
+
+static void
+t_group_commit_child(gfarm_error_t (*sync_op)(void))
+{
+	struct gfarm_user_info *ui;
+	pthread_t reader;
+	char before = 'b', after = 'a';
+
+	TEST_ASSERT_NOERR("journal_file_open",
+	    journal_file_open(filepath, TEST_FILE_MAX_SIZE, 0,
+		&self_jf, GFARM_JOURNAL_RDWR));
+	setup_write();
+	db_journal_set_sync_op(t_group_commit_request);
+	db_journal_group_commit_sync_op = sync_op;
+	db_journal_group_commit_init();
+
+	/* nothing to wait for */
+	t_group_commit_reply(&before);
+
+	ui = t_new_user_info("user1", "USER1");
+	TEST_ASSERT_NOERR("begin", db_journal_ops.begin(1, NULL));
+	TEST_ASSERT_NOERR("user_add", db_journal_ops.user_add(2, ui));
+	TEST_ASSERT_NOERR("end", db_journal_ops.end(3, NULL));
+
+	/* the reply of another client, which may see `user1' */
+	TEST_ASSERT0(pthread_create(&reader, NULL,
+	    t_group_commit_reply, &after) == 0);
+	pthread_join(reader, NULL);
+	_exit(EXIT_SUCCESS);
+}
+
+/* read the reports of the child, until EOF or no report in `timeout' msec */
+static void
+t_group_commit_case(const char *name, gfarm_error_t (*sync_op)(void),
+	const char *expected)
+{
+	int fds[2], n = 0, status;
+	struct pollfd pfd;
+	char buf[8];
+	pid_t pid;
+	const int timeout = 500;
+
+	unlink_test_file(filepath);
+	TEST_ASSERT0(pipe(fds) == 0);
+	pid = fork();
+	TEST_ASSERT0(pid != -1);
+	if (pid == 0) {
+		close(fds[0]);
+		t_group_commit_fd = fds[1];
+		t_group_commit_child(sync_op);
+	}
+	close(fds[1]);
+
+	pfd.fd = fds[0];
+	pfd.events = POLLIN;
+	while (n < sizeof(buf) - 1 && poll(&pfd, 1, timeout) > 0) {
+		if (read(fds[0], &buf[n], 1) != 1)
+			break;
+		n++;
+	}
+	buf[n] = '\0';
+	kill(pid, SIGKILL);
+	waitpid(pid, &status, 0);
+	close(fds[0]);
+	TEST_ASSERT_S(name, expected, buf);
+}
+
+void
+t_group_commit(void)
+{
+	/* b: reply before the commit, s: sync, a: reply after the commit */
+	t_group_commit_case("crash between commit and sync",
+	    t_group_commit_crash, "b");
+	t_group_commit_case("commit and sync",
+	    t_group_commit_sync, "bsa");
+	unlink_test_file(filepath);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -3641,6 +3773,7 @@ main(int argc, char **argv)
 			usage();
 			break;
 		case 'a':
+		case 'g':
 		case 'p':
 		case 'o':
 		case 'w':
@@ -3660,6 +3793,9 @@ main(int argc, char **argv)
 	case 'a':
 		t_apply();
 		break;
+	case 'g':
+		t_group_commit();
+		break;
 	case 'o':
 		t_open();
 		break;
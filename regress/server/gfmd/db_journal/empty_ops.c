@@ -454,6 +454,8 @@ const struct db_ops empty_ops = {
 
 	empty_nop,
 	empty_nop,
+	NULL,
+	NULL,
 
 	empty_host_add,
 	empty_host_modify,
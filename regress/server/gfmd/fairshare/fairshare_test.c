@@ -0,0 +1,319 @@
+/*
+ * $Id$
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+#include "thrsubr.h"
+#include "timer.h"
+
+#include "config.h"
+
+#include "subr.h"
+#include "thrpool.h"
+#include "fairshare.h"
+
+#include "test_assert.h"
+
+static char *program_name = "fairshare_test";
+
+#define GETOPT_ARG	"lruw?"
+#define HELPOPT		"-l|-w|-u|-r"
+
+/* a job is considered lost if it doesn't run within this */
+#define TIMEOUT_MICROSEC	30000000
+/* the running time of a bulk job */
+#define JOB_MICROSEC		1000
+
+#define RATE_LIMIT		20	/* jobs per second of "limited" */
+
+static void
+usage(void)
+{
+	fprintf(stderr, "%s " HELPOPT "\n", program_name);
+	fprintf(stderr, "\t-l: a light user isn't blocked by a heavy user\n");
+	fprintf(stderr, "\t-w: jobs run in proportion to their weights\n");
+	fprintf(stderr, "\t-u: a reused key doesn't inherit the weight\n");
+	fprintf(stderr, "\t-r: a rate-limited user doesn't exceed the rate\n");
+	exit(EXIT_FAILURE);
+}
+
+static void
+t_weight_of(const char *name, int *weightp, int *ratep)
+{
+	*weightp = strcmp(name, "heavy3") == 0 ? 3 : 1;
+	*ratep = strcmp(name, "limited") == 0 ? RATE_LIMIT : 0;
+}
+
+/*
+ * jobs, only one thread runs them
+ */
+
+struct t_key {
+	const char *name;
+	int done;
+	int done_at_first; /* `total' when the first job of this key ran */
+	int done_at_last; /* `total' when the last job of this key ran */
+};
+
+static int total;
+
+static pthread_mutex_t t_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t t_cond = PTHREAD_COND_INITIALIZER;
+static int t_released;
+
+static const char T_DIAG[] = "fairshare_test";
+
+static void
+t_done(struct t_key *k)
+{
+	gfarm_mutex_lock(&t_mutex, T_DIAG, "mutex");
+	if (k->done++ == 0)
+		k->done_at_first = total;
+	k->done_at_last = total++;
+	gfarm_cond_broadcast(&t_cond, T_DIAG, "cond");
+	gfarm_mutex_unlock(&t_mutex, T_DIAG, "mutex");
+}
+
+static void *
+t_bulk(void *arg)
+{
+	gfarm_nanosleep((unsigned long long)JOB_MICROSEC *
+	    GFARM_MICROSEC_BY_NANOSEC);
+	t_done(arg);
+	return (NULL);
+}
+
+static void *
+t_quick(void *arg)
+{
+	t_done(arg);
+	return (NULL);
+}
+
+/* occupies the only worker, until all jobs are queued */
+static void *
+t_blocker(void *arg)
+{
+	gfarm_mutex_lock(&t_mutex, T_DIAG, "mutex");
+	while (!t_released)
+		gfarm_cond_wait(&t_cond, &t_mutex, T_DIAG, "cond");
+	gfarm_mutex_unlock(&t_mutex, T_DIAG, "mutex");
+	return (NULL);
+}
+
+static void
+t_release(void)
+{
+	gfarm_mutex_lock(&t_mutex, T_DIAG, "mutex");
+	t_released = 1;
+	gfarm_cond_broadcast(&t_cond, T_DIAG, "cond");
+	gfarm_mutex_unlock(&t_mutex, T_DIAG, "mutex");
+}
+
+/* returns 1, if `total' reaches `n' within TIMEOUT_MICROSEC */
+static int
+t_wait_total(int n)
+{
+	struct timespec deadline;
+	int ok = 1;
+
+	gfarm_gettime(&deadline);
+	deadline.tv_sec += TIMEOUT_MICROSEC / GFARM_SECOND_BY_MICROSEC;
+	gfarm_mutex_lock(&t_mutex, T_DIAG, "mutex");
+	while (total < n) {
+		if (!gfarm_cond_timedwait(&t_cond, &t_mutex, &deadline,
+		    T_DIAG, "cond")) {
+			ok = total >= n;
+			break;
+		}
+	}
+	gfarm_mutex_unlock(&t_mutex, T_DIAG, "mutex");
+	return (ok);
+}
+
+static struct fairshare *
+t_setup(void)
+{
+	struct thread_pool *pool;
+	struct fairshare *fs;
+
+	total = 0;
+	t_released = 0;
+	pool = thrpool_new_by_type(GFARM_THREAD_POOL_TYPE_MUTEX,
+	    1, 10000, "fairshare test");
+	TEST_ASSERT("thrpool_new", pool != NULL);
+	fs = fairshare_new(pool, t_weight_of, "fairshare test");
+	TEST_ASSERT("fairshare_new", fs != NULL);
+	return (fs);
+}
+
+/* a light user isn't blocked by a heavy user */
+static void
+t_latency(void)
+{
+	struct fairshare *fs = t_setup();
+	struct t_key heavy = { "heavy" }, light = { "light" };
+	const int nheavy = 1000, nlight = 5;
+	int i;
+
+	fairshare_add_job(fs, &t_released, "blocker", t_blocker, NULL);
+	for (i = 0; i < nheavy; i++)
+		fairshare_add_job(fs, &heavy, heavy.name, t_bulk, &heavy);
+	for (i = 0; i < nlight; i++)
+		fairshare_add_job(fs, &light, light.name, t_quick, &light);
+	t_release();
+	TEST_ASSERT("latency: all jobs", t_wait_total(nheavy + nlight));
+	/* in FIFO, the light jobs would run after all the heavy jobs */
+	TEST_ASSERT("latency: light jobs run early",
+	    light.done_at_last < nlight * 4);
+}
+
+/* jobs run in proportion to their weights */
+static void
+t_weight(void)
+{
+	struct fairshare *fs = t_setup();
+	struct t_key heavy1 = { "heavy1" }, heavy3 = { "heavy3" };
+	const int njobs = 400;
+	int i, done1, done3;
+
+	fairshare_add_job(fs, &t_released, "blocker", t_blocker, NULL);
+	for (i = 0; i < njobs; i++) {
+		fairshare_add_job(fs, &heavy1, heavy1.name, t_bulk, &heavy1);
+		fairshare_add_job(fs, &heavy3, heavy3.name, t_bulk, &heavy3);
+	}
+	t_release();
+	TEST_ASSERT("weight: half of jobs", t_wait_total(njobs));
+	gfarm_mutex_lock(&t_mutex, T_DIAG, "mutex");
+	done1 = heavy1.done;
+	done3 = heavy3.done;
+	gfarm_mutex_unlock(&t_mutex, T_DIAG, "mutex");
+	/* 3:1 is expected, allow some error of the running time */
+	TEST_ASSERT("weight: 3:1", done3 > done1 * 2 && done3 < done1 * 4 + 10);
+	TEST_ASSERT("weight: all jobs", t_wait_total(njobs * 2));
+}
+
+/* a key freed and reused by another user doesn't inherit its weight */
+static void
+t_reuse(void)
+{
+	struct fairshare *fs = t_setup();
+	struct t_key key = { "heavy1" }, heavy1 = { "heavy1" };
+	const int njobs = 400;
+	int i, done1, done3;
+
+	t_released = 1;
+	fairshare_add_job(fs, &key, key.name, t_quick, &key);
+	TEST_ASSERT("reuse: first job", t_wait_total(1));
+
+	/* `key' is reused by "heavy3", whose weight is 3 */
+	key.name = "heavy3";
+	key.done = 0;
+	gfarm_mutex_lock(&t_mutex, T_DIAG, "mutex");
+	total = 0;
+	t_released = 0;
+	gfarm_mutex_unlock(&t_mutex, T_DIAG, "mutex");
+	fairshare_add_job(fs, &t_released, "blocker", t_blocker, NULL);
+	for (i = 0; i < njobs; i++) {
+		fairshare_add_job(fs, &heavy1, heavy1.name, t_bulk, &heavy1);
+		fairshare_add_job(fs, &key, key.name, t_bulk, &key);
+	}
+	t_release();
+	TEST_ASSERT("reuse: half of jobs", t_wait_total(njobs));
+	gfarm_mutex_lock(&t_mutex, T_DIAG, "mutex");
+	done1 = heavy1.done;
+	done3 = key.done;
+	gfarm_mutex_unlock(&t_mutex, T_DIAG, "mutex");
+	TEST_ASSERT("reuse: 3:1", done3 > done1 * 2 && done3 < done1 * 4 + 10);
+	TEST_ASSERT("reuse: all jobs", t_wait_total(njobs * 2));
+}
+
+/* a rate-limited user doesn't exceed the rate, but others do */
+static void
+t_rate(void)
+{
+	struct fairshare *fs = t_setup();
+	struct t_key limited = { "limited" }, other = { "other" };
+	const int nlimited = RATE_LIMIT * 2, nother = 100;
+	gfarm_timerval_t t0, t1;
+	int i;
+
+	t_released = 1;
+	gfarm_gettimerval(&t0);
+	for (i = 0; i < nlimited; i++)
+		fairshare_add_job(fs, &limited, limited.name,
+		    t_quick, &limited);
+	for (i = 0; i < nother; i++)
+		fairshare_add_job(fs, &other, other.name, t_quick, &other);
+	TEST_ASSERT("rate: all jobs", t_wait_total(nlimited + nother));
+	gfarm_gettimerval(&t1);
+	/* a burst of RATE_LIMIT, and RATE_LIMIT more in a second */
+	TEST_ASSERT("rate: limited", gfarm_timerval_sub(&t1, &t0) >= 0.8);
+	TEST_ASSERT("rate: others are not limited", other.done_at_last < nother +
+	    RATE_LIMIT * 2);
+}
+
+int
+main(int argc, char **argv)
+{
+	gfarm_error_t e;
+	int c, op = 0;
+
+	/* XXX: settings in gfmd.conf doesn't work in this case */
+	char *config  = getenv("GFARM_CONFIG_FILE");
+
+	debug_mode = 1;
+	e = gfarm_server_initialize_for_gfmd(config, &argc, &argv);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: gfarm_server_initialize: %s\n",
+		    argv[0], gfarm_error_string(e));
+		fprintf(stderr, "%s: aborting\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	while ((c = getopt(argc, argv, GETOPT_ARG)) != -1) {
+		switch (c) {
+		default:
+			fprintf(stderr, "%s: unknown option -%c\n",
+			    program_name, c);
+			/* no break */
+		case '?':
+			usage();
+			break;
+		case 'l':
+		case 'w':
+		case 'u':
+		case 'r':
+			op = c;
+			break;
+		}
+	}
+
+	switch (op) {
+	case 'l':
+		t_latency();
+		break;
+	case 'w':
+		t_weight();
+		break;
+	case 'u':
+		t_reuse();
+		break;
+	case 'r':
+		t_rate();
+		break;
+	default:
+		usage();
+	}
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,360 @@
+/*
+ * $Id$
+ */
+
+/*
+ * replica placement simulator.
+ * replays a file size distribution against a set of hosts, and reports
+ * how full each host becomes with the "replica_placement" policy.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+
+#include "config.h"
+
+#include "placement.h"
+
+#include "test_assert.h"
+
+static char *program_name = "placement_sim";
+
+#define GETOPT_ARG	"eH:lm:n:p:?"
+#define HELPOPT		"[-H <hostfile>] [-m <minfree>] [-n <ncopy>] " \
+			"[-p <policy>] [<sizefile>]"
+
+#define MAX_HOSTS	4096
+
+struct sim_host {
+	gfarm_uint64_t capacity, used;
+	int ncpu;
+	double loadavg;
+	long nfiles;
+};
+
+struct sim_result {
+	long nfiles, nshortage;
+	double min_usage, max_usage; /* 0 - 1 */
+};
+
+static const struct {
+	const char *name;
+	int policy;
+} policies[] = {
+	{ "random", GFARM_REPLICA_PLACEMENT_RANDOM },
+	{ "weighted", GFARM_REPLICA_PLACEMENT_WEIGHTED },
+	{ "two_choices", GFARM_REPLICA_PLACEMENT_TWO_CHOICES },
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "%s " HELPOPT "\n", program_name);
+	fprintf(stderr, "\t<hostfile>: \"capacity [ncpu [loadavg]]\" "
+	    "in bytes per line\n");
+	fprintf(stderr, "\t<sizefile>: a file size in bytes per line "
+	    "(default: stdin)\n");
+	fprintf(stderr, "%s -e|-l\n", program_name);
+	fprintf(stderr, "\t-e: weighted policies fill hosts more evenly\n");
+	fprintf(stderr, "\t-l: a loaded host gets fewer replicas\n");
+	exit(EXIT_FAILURE);
+}
+
+static int
+policy_by_name(const char *name)
+{
+	int i;
+
+	for (i = 0; i < GFARM_ARRAY_LENGTH(policies); i++) {
+		if (strcmp(name, policies[i].name) == 0)
+			return (policies[i].policy);
+	}
+	fprintf(stderr, "%s: unknown policy <%s>\n", program_name, name);
+	exit(EXIT_FAILURE);
+}
+
+static int
+hosts_read(const char *file, struct sim_host *hosts)
+{
+	FILE *fp;
+	char line[256];
+	unsigned long long capacity;
+	int n = 0, ncpu;
+	double loadavg;
+
+	if ((fp = fopen(file, "r")) == NULL) {
+		perror(file);
+		exit(EXIT_FAILURE);
+	}
+	while (fgets(line, sizeof line, fp) != NULL && n < MAX_HOSTS) {
+		ncpu = 1;
+		loadavg = 0;
+		if (sscanf(line, "%llu %d %lf", &capacity, &ncpu, &loadavg) < 1)
+			continue;
+		hosts[n].capacity = capacity;
+		hosts[n].ncpu = ncpu;
+		hosts[n].loadavg = loadavg;
+		n++;
+	}
+	fclose(fp);
+	return (n);
+}
+
+static void
+hosts_reset(int nhosts, struct sim_host *hosts)
+{
+	int i;
+
+	for (i = 0; i < nhosts; i++) {
+		hosts[i].used = 0;
+		hosts[i].nfiles = 0;
+	}
+}
+
+/* place `ncopy' replicas of a file, as hostset_schedule_n_except() does */
+static int
+place(int policy, int nhosts, struct sim_host *hosts, gfarm_uint64_t minfree,
+	int ncopy, gfarm_uint64_t size)
+{
+	static int candidates[MAX_HOSTS], index[MAX_HOSTS], results[MAX_HOSTS];
+	static double weights[MAX_HOSTS];
+	gfarm_uint64_t avail;
+	int i, n = 0;
+
+	for (i = 0; i < nhosts; i++) {
+		avail = hosts[i].capacity - hosts[i].used;
+		/* host_is_disk_available() */
+		if (avail < minfree + size)
+			continue;
+		/* host_placement_weight() */
+		weights[n] = placement_weight(avail - minfree,
+		    hosts[i].loadavg, hosts[i].ncpu, 0);
+		candidates[n++] = i;
+	}
+	if (n > ncopy)
+		placement_select(policy, n, weights, index, ncopy, results);
+	else
+		for (i = 0; i < n; i++)
+			results[i] = i;
+	if (n > ncopy)
+		n = ncopy;
+	for (i = 0; i < n; i++) {
+		hosts[candidates[results[i]]].used += size;
+		hosts[candidates[results[i]]].nfiles++;
+	}
+	return (n);
+}
+
+static void
+result_summarize(int nhosts, struct sim_host *hosts, struct sim_result *r)
+{
+	double usage;
+	int i;
+
+	r->min_usage = 1;
+	r->max_usage = 0;
+	for (i = 0; i < nhosts; i++) {
+		usage = (double)hosts[i].used / hosts[i].capacity;
+		if (usage < r->min_usage)
+			r->min_usage = usage;
+		if (usage > r->max_usage)
+			r->max_usage = usage;
+	}
+}
+
+static void
+simulate(int policy, int nhosts, struct sim_host *hosts,
+	gfarm_uint64_t minfree, int ncopy, long nsizes, gfarm_uint64_t *sizes,
+	struct sim_result *r)
+{
+	long i;
+
+	hosts_reset(nhosts, hosts);
+	r->nfiles = nsizes;
+	r->nshortage = 0;
+	for (i = 0; i < nsizes; i++) {
+		if (place(policy, nhosts, hosts, minfree, ncopy, sizes[i])
+		    < ncopy)
+			r->nshortage++;
+	}
+	result_summarize(nhosts, hosts, r);
+}
+
+static void
+report(int nhosts, struct sim_host *hosts, struct sim_result *r)
+{
+	int i;
+
+	for (i = 0; i < nhosts; i++)
+		printf("host %d: capacity %llu used %llu (%.1f%%) files %ld\n",
+		    i, (unsigned long long)hosts[i].capacity,
+		    (unsigned long long)hosts[i].used,
+		    100.0 * hosts[i].used / hosts[i].capacity,
+		    hosts[i].nfiles);
+	printf("files %ld shortage %ld usage %.1f%% - %.1f%%\n",
+	    r->nfiles, r->nshortage, 100 * r->min_usage, 100 * r->max_usage);
+}
+
+static long
+sizes_read(FILE *fp, gfarm_uint64_t **sizesp)
+{
+	gfarm_uint64_t *sizes = NULL, *s;
+	unsigned long long size;
+	long n = 0, nalloc = 0;
+
+	while (fscanf(fp, "%llu", &size) == 1) {
+		if (n >= nalloc) {
+			nalloc = nalloc == 0 ? 1024 : nalloc * 2;
+			GFARM_REALLOC_ARRAY(s, sizes, nalloc);
+			if (s == NULL) {
+				fprintf(stderr, "%s: no memory\n",
+				    program_name);
+				exit(EXIT_FAILURE);
+			}
+			sizes = s;
+		}
+		sizes[n++] = size;
+	}
+	*sizesp = sizes;
+	return (n);
+}
+
+/*
+ * old small hosts and new large hosts, as the motivating case.
+ */
+
+#define TB	(1000ULL * 1000 * 1000 * 1000)
+
+static struct sim_host t_hosts[] = {
+	{ 40 * TB, 0, 8, 0.0 },
+	{ 40 * TB, 0, 8, 0.0 },
+	{ 40 * TB, 0, 8, 0.0 },
+	{ 40 * TB, 0, 8, 0.0 },
+	{ 200 * TB, 0, 8, 0.0 },
+	{ 200 * TB, 0, 8, 0.0 },
+};
+#define T_NHOSTS	GFARM_ARRAY_LENGTH(t_hosts)
+#define T_NCOPY		2
+#define T_MINFREE	(512 * 1024 * 1024)
+
+/* 1MB - 1GB, so that random placement fills the small hosts */
+static gfarm_uint64_t *
+t_sizes(long nsizes)
+{
+	gfarm_uint64_t *sizes;
+	long i;
+
+	GFARM_MALLOC_ARRAY(sizes, nsizes);
+	TEST_ASSERT("no memory", sizes != NULL);
+	for (i = 0; i < nsizes; i++)
+		sizes[i] = (gfarm_uint64_t)(1 + gfarm_random() % 1000) *
+		    1000 * 1000;
+	return (sizes);
+}
+
+/* weighted policies fill small and large hosts more evenly than random */
+static void
+t_even(void)
+{
+	const long nsizes = 200000;
+	gfarm_uint64_t *sizes = t_sizes(nsizes);
+	struct sim_result rnd, wtd, two;
+
+	simulate(GFARM_REPLICA_PLACEMENT_RANDOM, T_NHOSTS, t_hosts,
+	    T_MINFREE, T_NCOPY, nsizes, sizes, &rnd);
+	simulate(GFARM_REPLICA_PLACEMENT_WEIGHTED, T_NHOSTS, t_hosts,
+	    T_MINFREE, T_NCOPY, nsizes, sizes, &wtd);
+	simulate(GFARM_REPLICA_PLACEMENT_TWO_CHOICES, T_NHOSTS, t_hosts,
+	    T_MINFREE, T_NCOPY, nsizes, sizes, &two);
+
+	TEST_ASSERT("no shortage",
+	    rnd.nshortage == 0 && wtd.nshortage == 0 && two.nshortage == 0);
+	TEST_ASSERT("weighted is more even than random",
+	    wtd.max_usage - wtd.min_usage <
+	    (rnd.max_usage - rnd.min_usage) / 2);
+	TEST_ASSERT("two_choices is more even than random",
+	    two.max_usage - two.min_usage < rnd.max_usage - rnd.min_usage);
+	free(sizes);
+}
+
+/* a loaded host gets fewer replicas than an idle one of the same size */
+static void
+t_loaded(void)
+{
+	const long nsizes = 20000;
+	gfarm_uint64_t *sizes = t_sizes(nsizes);
+	struct sim_result wtd;
+
+	t_hosts[4].loadavg = 32.0;
+	simulate(GFARM_REPLICA_PLACEMENT_WEIGHTED, T_NHOSTS, t_hosts,
+	    T_MINFREE, T_NCOPY, nsizes, sizes, &wtd);
+	TEST_ASSERT("loaded host", t_hosts[4].nfiles < t_hosts[5].nfiles);
+	free(sizes);
+}
+
+int
+main(int argc, char **argv)
+{
+	static struct sim_host hosts[MAX_HOSTS];
+	int c, nhosts = 0, ncopy = 1, op = 0;
+	int policy = GFARM_REPLICA_PLACEMENT_WEIGHTED;
+	gfarm_uint64_t minfree = 512 * 1024 * 1024, *sizes;
+	struct sim_result r;
+	long nsizes;
+	FILE *fp = stdin;
+
+	while ((c = getopt(argc, argv, GETOPT_ARG)) != -1) {
+		switch (c) {
+		case 'H':
+			nhosts = hosts_read(optarg, hosts);
+			break;
+		case 'm':
+			minfree = strtoull(optarg, NULL, 0);
+			break;
+		case 'n':
+			ncopy = atoi(optarg);
+			break;
+		case 'p':
+			policy = policy_by_name(optarg);
+			break;
+		case 'e':
+		case 'l':
+			op = c;
+			break;
+		case '?':
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	switch (op) {
+	case 'e':
+		t_even();
+		return (EXIT_SUCCESS);
+	case 'l':
+		t_loaded();
+		return (EXIT_SUCCESS);
+	}
+	if (nhosts == 0 || ncopy < 1 || argc > 1)
+		usage();
+	if (argc == 1 && (fp = fopen(argv[0], "r")) == NULL) {
+		perror(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	nsizes = sizes_read(fp, &sizes);
+	if (fp != stdin)
+		fclose(fp);
+
+	simulate(policy, nhosts, hosts, minfree, ncopy, nsizes, sizes, &r);
+	report(nhosts, hosts, &r);
+	free(sizes);
+	return (EXIT_SUCCESS);
+}
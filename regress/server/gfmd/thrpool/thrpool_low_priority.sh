@@ -0,0 +1,14 @@
+#!/bin/sh
+
+. ./regress.conf
+
+trap 'exit $exit_trap' $trap_sigs
+
+for type in mutex work_stealing; do
+	if $testbin/thrpool_test -T $type -l; then :
+	else
+		exit $exit_fail
+	fi
+done
+
+exit $exit_pass
@@ -0,0 +1,223 @@
+/*
+ * $Id$
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+#include "thrsubr.h"
+#include "timer.h"
+
+#include "config.h"
+
+#include "subr.h"
+#include "thrpool.h"
+
+#include "test_assert.h"
+
+static char *program_name = "thrpool_test";
+
+#define GETOPT_ARG	"alT:?"
+#define HELPOPT		"[-T mutex|work_stealing] -a|-l"
+
+/* a job is considered lost if it doesn't run within this */
+#define TIMEOUT_MICROSEC	10000000
+/* an add is considered blocked if it doesn't return within this */
+#define BLOCK_MICROSEC		200000
+
+static const struct {
+	const char *name;
+	int type;
+} types[] = {
+	{ "mutex", GFARM_THREAD_POOL_TYPE_MUTEX },
+	{ "work_stealing", GFARM_THREAD_POOL_TYPE_WORK_STEALING },
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr, "%s " HELPOPT "\n", program_name);
+	fprintf(stderr, "\t-a: all jobs run\n");
+	fprintf(stderr, "\t-l: low priority jobs are limited\n");
+	exit(EXIT_FAILURE);
+}
+
+static int
+type_by_name(const char *name)
+{
+	int i;
+
+	for (i = 0; i < GFARM_ARRAY_LENGTH(types); i++) {
+		if (strcmp(name, types[i].name) == 0)
+			return (types[i].type);
+	}
+	fprintf(stderr, "%s: unknown thread pool type <%s>\n",
+	    program_name, name);
+	exit(EXIT_FAILURE);
+}
+
+static int done;
+
+static void *
+t_count(void *arg)
+{
+	__atomic_add_fetch(&done, 1, __ATOMIC_SEQ_CST);
+	return (NULL);
+}
+
+/* returns 1, if `done' reaches `n' within TIMEOUT_MICROSEC */
+static int
+t_wait_done(int n)
+{
+	gfarm_timerval_t t0, t1;
+
+	gfarm_gettimerval(&t0);
+	while (__atomic_load_n(&done, __ATOMIC_SEQ_CST) < n) {
+		gfarm_gettimerval(&t1);
+		if (gfarm_timerval_sub(&t1, &t0) * GFARM_SECOND_BY_MICROSEC >
+		    TIMEOUT_MICROSEC)
+			return (0);
+		usleep(1000);
+	}
+	return (1);
+}
+
+/* all jobs run */
+static void
+t_all_jobs(int type)
+{
+	struct thread_pool *pool;
+	const int njobs = 100000;
+	int i;
+
+	done = 0;
+	pool = thrpool_new_by_type(type, 8, 1000, "thrpool test");
+	TEST_ASSERT("thrpool_new", pool != NULL);
+	for (i = 0; i < njobs; i++)
+		thrpool_add_job(pool, t_count, NULL);
+	TEST_ASSERT("all jobs", t_wait_done(njobs));
+}
+
+static pthread_mutex_t t_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t t_cond = PTHREAD_COND_INITIALIZER;
+static int t_started, t_released, t_added;
+static struct thread_pool *t_pool;
+
+static const char T_DIAG[] = "thrpool_test";
+
+/* occupies the only worker until it's released */
+static void *
+t_blocker(void *arg)
+{
+	gfarm_mutex_lock(&t_mutex, T_DIAG, "mutex");
+	t_started = 1;
+	gfarm_cond_broadcast(&t_cond, T_DIAG, "cond");
+	while (!t_released)
+		gfarm_cond_wait(&t_cond, &t_mutex, T_DIAG, "cond");
+	gfarm_mutex_unlock(&t_mutex, T_DIAG, "mutex");
+	return (NULL);
+}
+
+static void *
+t_add_low_priority(void *arg)
+{
+	thrpool_add_job_low_priority(t_pool, t_count, NULL);
+	__atomic_store_n(&t_added, 1, __ATOMIC_SEQ_CST);
+	return (NULL);
+}
+
+/* low priority jobs are limited, normal jobs aren't */
+static void
+t_low_priority(int type)
+{
+	pthread_t adder;
+	const int limit = 4;
+	int i, rv;
+
+	done = 0;
+	t_started = t_released = t_added = 0;
+	t_pool = thrpool_new_by_type(type, 1, 16, "thrpool test low");
+	TEST_ASSERT("thrpool_new", t_pool != NULL);
+	thrpool_set_jobq_low_priority_limit(t_pool, limit);
+	thrpool_add_job(t_pool, t_blocker, NULL);
+	gfarm_mutex_lock(&t_mutex, T_DIAG, "mutex");
+	while (!t_started)
+		gfarm_cond_wait(&t_cond, &t_mutex, T_DIAG, "cond");
+	gfarm_mutex_unlock(&t_mutex, T_DIAG, "mutex");
+
+	for (i = 0; i < limit; i++)
+		thrpool_add_job_low_priority(t_pool, t_count, NULL);
+	rv = pthread_create(&adder, NULL, t_add_low_priority, NULL);
+	TEST_ASSERT("pthread_create", rv == 0);
+	usleep(BLOCK_MICROSEC);
+	TEST_ASSERT("low priority job blocks",
+	    !__atomic_load_n(&t_added, __ATOMIC_SEQ_CST));
+	/* a normal job can be added beyond the limit */
+	thrpool_add_job(t_pool, t_count, NULL);
+
+	gfarm_mutex_lock(&t_mutex, T_DIAG, "mutex");
+	t_released = 1;
+	gfarm_cond_broadcast(&t_cond, T_DIAG, "cond");
+	gfarm_mutex_unlock(&t_mutex, T_DIAG, "mutex");
+	rv = pthread_join(adder, NULL);
+	TEST_ASSERT("pthread_join", rv == 0);
+	TEST_ASSERT("low priority jobs", t_wait_done(limit + 2));
+}
+
+int
+main(int argc, char **argv)
+{
+	gfarm_error_t e;
+	int c, op = 0, type = GFARM_THREAD_POOL_TYPE_MUTEX;
+
+	/* XXX: settings in gfmd.conf doesn't work in this case */
+	char *config  = getenv("GFARM_CONFIG_FILE");
+
+	debug_mode = 1;
+	e = gfarm_server_initialize_for_gfmd(config, &argc, &argv);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: gfarm_server_initialize: %s\n",
+		    argv[0], gfarm_error_string(e));
+		fprintf(stderr, "%s: aborting\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	while ((c = getopt(argc, argv, GETOPT_ARG)) != -1) {
+		switch (c) {
+		default:
+			fprintf(stderr, "%s: unknown option -%c\n",
+			    program_name, c);
+			/* no break */
+		case '?':
+			usage();
+			break;
+		case 'a':
+		case 'l':
+			op = c;
+			break;
+		case 'T':
+			type = type_by_name(optarg);
+			break;
+		}
+	}
+
+	switch (op) {
+	case 'a':
+		t_all_jobs(type);
+		break;
+	case 'l':
+		t_low_priority(type);
+		break;
+	default:
+		usage();
+	}
+	return (EXIT_SUCCESS);
+}
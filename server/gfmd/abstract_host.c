@@ -35,6 +35,7 @@
 #include "peer.h"
 #include "abstract_host.h"
 #include "protocol_state.h"
+#include "db_journal.h"
 
 
 static const char ABSTRACT_HOST_MUTEX_DIAG[]	= "abstract_host_mutex";
@@ -834,24 +835,13 @@ gfm_server_channel_disconnect_request(struct abstract_host *host,
 	abstract_host_disconnect_request(host, peer, diag);
 }
 
-/*
- * synchronous mode of back_channel is only used before gfarm-2.4.0
- */
-gfarm_error_t
-gfm_client_channel_vsend_request_notimeout(struct abstract_host *host,
+static gfarm_error_t
+gfm_client_channel_sender_lock(struct abstract_host *host,
 	struct peer *peer0, const char *diag,
-	result_callback_t result_callback,
-	disconnect_callback_t disconnect_callback, void *closure,
-#ifdef COMPAT_GFARM_2_3
-	host_set_callback_t host_set_callback,
-#endif
-	long timeout_microsec, gfarm_int32_t command,
-	const char *format, va_list * app)
+	long timeout_microsec, gfarm_int32_t command, struct peer **peerp)
 {
 	gfarm_error_t e;
 	struct peer *peer;
-	gfp_xdr_async_peer_t async;
-	struct gfp_xdr *server;
 
 	if (debug_mode)
 		gflog_info(GFARM_MSG_1002788,
@@ -883,6 +873,46 @@ gfm_client_channel_vsend_request_notimeout(struct abstract_host *host,
 		return (GFARM_ERR_CONNECTION_ABORTED);
 	}
 	abstract_host_peer_unbusy(host, diag);
+	*peerp = peer;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * requests and replies through the channels are seen outside of gfmd,
+ * thus they must not be sent before the transactions which they may
+ * depend on become durable.
+ * PREREQUISITE: nothing (giant_lock shouldn't be held)
+ */
+static void
+channel_journal_wait(void)
+{
+	db_journal_group_commit_wait(db_journal_group_commit_seqnum());
+}
+
+/*
+ * synchronous mode of back_channel is only used before gfarm-2.4.0
+ */
+gfarm_error_t
+gfm_client_channel_vsend_request_notimeout(struct abstract_host *host,
+	struct peer *peer0, const char *diag,
+	result_callback_t result_callback,
+	disconnect_callback_t disconnect_callback, void *closure,
+#ifdef COMPAT_GFARM_2_3
+	host_set_callback_t host_set_callback,
+#endif
+	long timeout_microsec, gfarm_int32_t command,
+	const char *format, va_list * app)
+{
+	gfarm_error_t e;
+	struct peer *peer;
+	gfp_xdr_async_peer_t async;
+	struct gfp_xdr *server;
+
+	channel_journal_wait();
+	e = gfm_client_channel_sender_lock(host, peer0, diag,
+	    timeout_microsec, command, &peer);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
 	async = peer_get_async(peer);
 	server = peer_get_conn(peer);
 
@@ -920,6 +950,48 @@ gfm_client_channel_vsend_request_notimeout(struct abstract_host *host,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+/*
+ * same as gfm_client_channel_vsend_request_notimeout(),
+ * but the parameters of the request are a list of `nitems' items.
+ * this is only available in asynchronous mode.
+ */
+gfarm_error_t
+gfm_client_channel_send_request_items_notimeout(struct abstract_host *host,
+	struct peer *peer0, const char *diag,
+	result_callback_t result_callback,
+	disconnect_callback_t disconnect_callback, void *closure,
+	long timeout_microsec, gfarm_int32_t command, int nitems,
+	gfp_xdr_item_callback_t send_item, void *item_closure)
+{
+	gfarm_error_t e;
+	struct peer *peer;
+	gfp_xdr_async_peer_t async;
+
+	channel_journal_wait();
+	e = gfm_client_channel_sender_lock(host, peer0, diag,
+	    timeout_microsec, command, &peer);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	async = peer_get_async(peer);
+	if (async == NULL) { /* synchronous mode */
+		abstract_host_sender_unlock(host, peer, diag);
+		gflog_error(GFARM_MSG_1005829,
+		    "%s(%s) channel (command %d) request: "
+		    "not supported by synchronous protocol",
+		    abstract_host_get_name(host), diag, command);
+		return (GFARM_ERR_OPERATION_NOT_SUPPORTED);
+	}
+
+	e = gfp_xdr_send_async_request_items_notimeout(peer_get_conn(peer),
+	    async, result_callback, disconnect_callback, closure,
+	    command, nitems, send_item, item_closure);
+	if (e != GFARM_ERR_NO_ERROR) /* must be IS_CONNECTION_ERROR(e) */
+		gfm_server_channel_disconnect_request(host, peer,
+		    diag, "request", gfarm_error_string(e));
+	abstract_host_sender_unlock(host, peer, diag);
+	return (e);
+}
+
 /* abstract_host_receiver_lock() must be already called here by
  * channel_main() */
 gfarm_error_t
@@ -958,6 +1030,7 @@ gfm_server_channel_vput_reply_notimeout(struct abstract_host *host,
 		    "%s: <%s> sending reply: %d",
 		    abstract_host_get_name(host), diag, (int)errcode);
 
+	channel_journal_wait();
 	/*
 	 * Since this is a reply, the peer is probably living,
 	 * thus, not using peer_sender_trylock() is mostly ok.
@@ -984,6 +1057,32 @@ gfm_server_channel_vput_reply_notimeout(struct abstract_host *host,
 	return (e);
 }
 
+static gfarm_error_t
+gfm_client_channel_result_check(struct peer *peer,
+	struct abstract_host *host, gfarm_error_t e, int is_async, size_t size)
+{
+	struct gfp_xdr *conn = peer_get_conn(peer);
+
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_error(GFARM_MSG_1002797,
+		    "%s(%s) RPC result: %s", back_channel_type_name(peer),
+		    abstract_host_get_name(host), gfarm_error_string(e));
+	} else if (is_async && size != 0) {
+		gflog_error(GFARM_MSG_1002798,
+		    "%s(%s) RPC result: protocol residual %d",
+		    back_channel_type_name(peer), abstract_host_get_name(host),
+		    (int)size);
+		if ((e = gfp_xdr_purge(conn, 0, size)) != GFARM_ERR_NO_ERROR)
+			gflog_warning(GFARM_MSG_1002799,
+			    "%s(%s) RPC result: skipping: %s",
+			    back_channel_type_name(peer),
+			    abstract_host_get_name(host),
+			    gfarm_error_string(e));
+		e = GFARM_ERR_PROTOCOL;
+	}
+	return (e);
+}
+
 /* abstract_host_receiver_lock() must be already called here by
  * channel_main() */
 gfarm_error_t
@@ -1009,24 +1108,43 @@ gfm_client_channel_vrecv_result(struct peer *peer,
 		abstract_host_sender_unlock(host, peer,
 		    back_channel_type_name(peer));
 	}
-	if (e != GFARM_ERR_NO_ERROR) {
-		gflog_error(GFARM_MSG_1002797,
-		    "%s(%s) RPC result: %s", back_channel_type_name(peer),
-		    abstract_host_get_name(host), gfarm_error_string(e));
-	} else if (async != NULL && size != 0) {
-		gflog_error(GFARM_MSG_1002798,
-		    "%s(%s) RPC result: protocol residual %d",
-		    back_channel_type_name(peer), abstract_host_get_name(host),
-		    (int)size);
-		if ((e = gfp_xdr_purge(conn, 0, size)) != GFARM_ERR_NO_ERROR)
-			gflog_warning(GFARM_MSG_1002799,
-			    "%s(%s) RPC result: skipping: %s",
-			    back_channel_type_name(peer),
-			    abstract_host_get_name(host),
-			    gfarm_error_string(e));
-		e = GFARM_ERR_PROTOCOL;
-	} else { /* e == GFARM_ERR_NO_ERROR */
+	e = gfm_client_channel_result_check(peer, host, e, async != NULL,
+	    size);
+	if (e == GFARM_ERR_NO_ERROR)
+		*errcodep = errcode;
+	return (e);
+}
+
+/*
+ * same as gfm_client_channel_vrecv_result(),
+ * but the result is a list of `maxitems' items at most.
+ * this is only available in asynchronous mode,
+ * as gfm_client_channel_send_request_items_notimeout() is.
+ */
+gfarm_error_t
+gfm_client_channel_recv_result_items(struct peer *peer,
+	struct abstract_host *host, size_t size, const char *diag,
+	gfarm_error_t *errcodep, int maxitems, int *nitemsp,
+	gfp_xdr_item_callback_t recv_item, void *closure)
+{
+	gfarm_error_t e;
+	gfarm_int32_t errcode;
+	struct gfp_xdr *conn = peer_get_conn(peer);
+	int eof;
+
+	if (debug_mode)
+		gflog_info(GFARM_MSG_1005830,
+		    "%s: <%s> %s receiving reply", abstract_host_get_name(host),
+		    diag, back_channel_type_name(peer));
+
+	e = gfp_xdr_recv_sized(conn, 0, 1, &size, &eof, "i", &errcode);
+	if (e == GFARM_ERR_NO_ERROR && eof)
+		e = GFARM_ERR_UNEXPECTED_EOF;
+	if (e == GFARM_ERR_NO_ERROR && errcode == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_recv_items_sized(conn, 0, 1, &size,
+		    maxitems, nitemsp, recv_item, closure);
+	e = gfm_client_channel_result_check(peer, host, e, 1, size);
+	if (e == GFARM_ERR_NO_ERROR)
 		*errcodep = errcode;
-	}
 	return (e);
 }
@@ -97,6 +97,13 @@ gfarm_error_t gfm_client_channel_vsend_request_notimeout(
 	host_set_callback_t,
 #endif
 	long, gfarm_int32_t, const char *, va_list *);
+gfarm_error_t gfm_client_channel_send_request_items_notimeout(
+	struct abstract_host *,
+	struct peer *, const char *, result_callback_t, disconnect_callback_t,
+	void *, long, gfarm_int32_t, int, gfp_xdr_item_callback_t, void *);
 gfarm_error_t gfm_client_channel_vrecv_result(struct peer *,
 	struct abstract_host *, size_t, const char *, const char **,
 	gfarm_error_t *, va_list *);
+gfarm_error_t gfm_client_channel_recv_result_items(struct peer *,
+	struct abstract_host *, size_t, const char *, gfarm_error_t *,
+	int, int *, gfp_xdr_item_callback_t, void *);
@@ -19,6 +19,7 @@
 
 #include "gfutil.h"
 #include "gflog_reduced.h"
+#include "hash.h"
 #include "thrsubr.h"
 
 #include "context.h"
@@ -357,22 +358,397 @@ gfs_client_fhremove_request(void *closure)
 	return (NULL);
 }
 
+/*
+ * GFS_PROTO_FHREMOVE_MULTI didn't exist before gfarm-2.8.4
+ *
+ * removal requests are grouped by host into batches,
+ * and the number of outstanding batches for each host is limited by
+ * a window, which is adjusted by the response time of the gfsd:
+ * the window is increased by one when a whole window of batches
+ * completes without the response time growing, and it's halved
+ * when the response time grows, or the host becomes busy.
+ * the response time is divided by the number of files in the batch,
+ * since a batch may be partially filled.
+ */
+
+#define FHREMOVE_COLLECT_MAX		(GFS_PROTO_MAX_FHREMOVE_MULTI * 4)
+#define FHREMOVE_WINDOW_INITIAL		2
+#define FHREMOVE_WINDOW_MAX		32
+#define FHREMOVE_RTT_GROWTH_LIMIT	2	/* rtt_avg / rtt_min */
+#define FHREMOVE_WINDOWS_HASH_SIZE	256
+
+struct fhremove_batch {
+	struct fhremove_batch *next;
+	struct host *host;
+	struct timeval sent;
+	int n;
+	struct dead_file_copy *dfcs[GFS_PROTO_MAX_FHREMOVE_MULTI];
+};
+
+struct fhremove_window {
+	int inflight, window, completed;
+	/* microseconds per file, 0: not measured */
+	gfarm_uint64_t rtt_min, rtt_avg;
+
+	/* batches waiting for the window to be opened */
+	struct fhremove_batch *waiting, **waiting_tail;
+	int nwaiting; /* number of dead file copies in `waiting' */
+
+	gfarm_uint64_t removed, failed, deferred; /* deferred: host is busy */
+};
+
+enum fhremove_batch_status {
+	FHREMOVE_BATCH_REPLIED,	/* each file may still fail */
+	FHREMOVE_BATCH_BUSY,	/* the host is overloaded */
+	FHREMOVE_BATCH_FAILED	/* sending or receiving failed */
+};
+
+/*
+ * IMPORTANT NOTE:
+ * functions should not sleep while holding fhremove_mutex
+ */
+static pthread_mutex_t fhremove_mutex = GFARM_MUTEX_INITIALIZER(fhremove_mutex);
+static pthread_cond_t fhremove_ready_cond = PTHREAD_COND_INITIALIZER;
+static struct gfarm_hash_table *fhremove_windows; /* key: struct host * */
+
+/* batches which are allowed to be sent */
+static struct fhremove_batch *fhremove_ready, **fhremove_ready_tail =
+	&fhremove_ready;
+
+static const char FHREMOVE_MUTEX_DIAG[] = "fhremove_mutex";
+
+/* PREREQUISITE: fhremove_mutex */
+static struct fhremove_window *
+fhremove_window_lookup(struct host *host)
+{
+	struct gfarm_hash_entry *entry;
+	struct fhremove_window *w;
+	int created;
+
+	entry = gfarm_hash_enter(fhremove_windows, &host, sizeof(host),
+	    sizeof(*w), &created);
+	if (entry == NULL)
+		return (NULL);
+	w = gfarm_hash_entry_data(entry);
+	if (created) {
+		w->inflight = 0;
+		w->window = FHREMOVE_WINDOW_INITIAL;
+		w->completed = 0;
+		w->rtt_min = w->rtt_avg = 0;
+		w->waiting = NULL;
+		w->waiting_tail = &w->waiting;
+		w->nwaiting = 0;
+		w->removed = w->failed = w->deferred = 0;
+	}
+	return (w);
+}
+
+/* PREREQUISITE: fhremove_mutex */
+static void
+fhremove_ready_enqueue(struct fhremove_batch *b)
+{
+	b->next = NULL;
+	*fhremove_ready_tail = b;
+	fhremove_ready_tail = &b->next;
+	gfarm_cond_signal(&fhremove_ready_cond, FHREMOVE_MUTEX_DIAG, "ready");
+}
+
+static void
+fhremove_batch_submit(struct fhremove_batch *b)
+{
+	struct fhremove_window *w;
+	static const char diag[] = "fhremove_batch_submit";
+
+	gfarm_mutex_lock(&fhremove_mutex, diag, FHREMOVE_MUTEX_DIAG);
+	w = fhremove_window_lookup(b->host);
+	if (w == NULL || w->inflight < w->window) {
+		if (w != NULL)
+			w->inflight++;
+		/* if no memory, send it anyway */
+		fhremove_ready_enqueue(b);
+	} else {
+		b->next = NULL;
+		*w->waiting_tail = b;
+		w->waiting_tail = &b->next;
+		w->nwaiting += b->n;
+	}
+	gfarm_mutex_unlock(&fhremove_mutex, diag, FHREMOVE_MUTEX_DIAG);
+}
+
+/* this is called when a batch is finished */
+static void
+fhremove_batch_done(struct fhremove_batch *b,
+	enum fhremove_batch_status status, int nremoved)
+{
+	struct fhremove_window *w;
+	struct fhremove_batch *next;
+	struct timeval now;
+	gfarm_uint64_t rtt;
+	static const char diag[] = "fhremove_batch_done";
+
+	gettimeofday(&now, NULL);
+	gfarm_timeval_sub(&now, &b->sent);
+	rtt = ((gfarm_uint64_t)now.tv_sec * GFARM_SECOND_BY_MICROSEC +
+	    now.tv_usec) / (b->n > 0 ? b->n : 1);
+	if (rtt == 0) /* 0 means not measured */
+		rtt = 1;
+
+	gfarm_mutex_lock(&fhremove_mutex, diag, FHREMOVE_MUTEX_DIAG);
+	w = fhremove_window_lookup(b->host);
+	if (w != NULL) {
+		w->inflight--;
+		w->removed += nremoved;
+		if (status == FHREMOVE_BATCH_BUSY)
+			w->deferred += b->n;
+		else
+			w->failed += b->n - nremoved;
+		/* a failure may be immediate, which isn't a response time */
+		if (status == FHREMOVE_BATCH_REPLIED) {
+			w->rtt_avg = w->rtt_avg == 0 ? rtt :
+			    (w->rtt_avg * 7 + rtt) / 8;
+			if (w->rtt_min == 0 || rtt < w->rtt_min)
+				w->rtt_min = rtt;
+		}
+		if (status == FHREMOVE_BATCH_BUSY || w->rtt_avg >
+		    w->rtt_min * FHREMOVE_RTT_GROWTH_LIMIT) {
+			if (w->window > 1)
+				w->window /= 2;
+			else /* learn the response time again */
+				w->rtt_min = w->rtt_avg;
+			w->completed = 0;
+		} else if (++w->completed >= w->window) {
+			if (w->window < FHREMOVE_WINDOW_MAX)
+				w->window++;
+			w->completed = 0;
+		}
+		while (w->waiting != NULL && w->inflight < w->window) {
+			next = w->waiting;
+			if ((w->waiting = next->next) == NULL)
+				w->waiting_tail = &w->waiting;
+			w->nwaiting -= next->n;
+			w->inflight++;
+			fhremove_ready_enqueue(next);
+		}
+	}
+	gfarm_mutex_unlock(&fhremove_mutex, diag, FHREMOVE_MUTEX_DIAG);
+	free(b);
+}
+
+static gfarm_error_t
+gfs_client_fhremove_multi_recv_item(struct gfp_xdr *conn, size_t *sizep,
+	int i, void *closure)
+{
+	gfarm_int32_t *errs = closure;
+	gfarm_error_t e;
+	int eof;
+
+	e = gfp_xdr_recv_sized(conn, 0, 1, sizep, &eof, "i", &errs[i]);
+	if (e == GFARM_ERR_NO_ERROR && eof)
+		e = GFARM_ERR_UNEXPECTED_EOF;
+	return (e);
+}
+
+static gfarm_int32_t
+gfs_client_fhremove_multi_result(void *p, void *arg, size_t size)
+{
+	struct peer *peer = p;
+	struct fhremove_batch *b = arg;
+	gfarm_error_t e, e2;
+	gfarm_int32_t errs[GFS_PROTO_MAX_FHREMOVE_MULTI];
+	int i, n = 0, nremoved = 0;
+	static const char diag[] = "GFS_PROTO_FHREMOVE_MULTI";
+
+	e = gfm_client_channel_recv_result_items(peer,
+	    host_to_abstract_host(b->host), size, diag, &e2,
+	    GFS_PROTO_MAX_FHREMOVE_MULTI, &n,
+	    gfs_client_fhremove_multi_recv_item, errs);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = e2;
+	if (e == GFARM_ERR_NO_ERROR && n != b->n) {
+		gflog_error(GFARM_MSG_1005787, "%s(%s): %d results for "
+		    "%d requests", diag, host_name(b->host), n, b->n);
+		e = GFARM_ERR_PROTOCOL;
+	}
+	for (i = 0; i < b->n; i++) {
+		e2 = e != GFARM_ERR_NO_ERROR ? e : errs[i];
+		if (e2 == GFARM_ERR_NO_ERROR)
+			nremoved++;
+		removal_finishedq_enqueue(b->dfcs[i], e2);
+	}
+	fhremove_batch_done(b, e == GFARM_ERR_NO_ERROR ?
+	    FHREMOVE_BATCH_REPLIED : FHREMOVE_BATCH_FAILED, nremoved);
+	return (e);
+}
+
+/* both giant_lock and peer_table_lock are held before calling this function */
+static void
+gfs_client_fhremove_multi_free(void *p, void *arg)
+{
+	struct fhremove_batch *b = arg;
+	int i;
+
+	for (i = 0; i < b->n; i++)
+		removal_finishedq_enqueue(b->dfcs[i],
+		    GFARM_ERR_CONNECTION_ABORTED);
+	fhremove_batch_done(b, FHREMOVE_BATCH_FAILED, 0);
+}
+
+static gfarm_error_t
+gfs_client_fhremove_multi_send_item(struct gfp_xdr *conn, size_t *sizep,
+	int i, void *closure)
+{
+	struct fhremove_batch *b = closure;
+	gfarm_ino_t ino = dead_file_copy_get_ino(b->dfcs[i]);
+	gfarm_uint64_t gen = dead_file_copy_get_gen(b->dfcs[i]);
+
+	if (conn == NULL)
+		return (gfp_xdr_send_size_add(sizep, "ll", ino, gen));
+	return (gfp_xdr_send_notimeout(conn, "ll", ino, gen));
+}
+
+static void *
+gfs_client_fhremove_multi_request(void *closure)
+{
+	struct fhremove_batch *b = closure;
+	gfarm_error_t e;
+	int i;
+	static const char diag[] = "GFS_PROTO_FHREMOVE_MULTI";
+
+	gettimeofday(&b->sent, NULL);
+	e = gfm_client_channel_send_request_items_notimeout(
+	    host_to_abstract_host(b->host), NULL, diag,
+	    gfs_client_fhremove_multi_result, gfs_client_fhremove_multi_free,
+	    b, GFS_PROTO_FHREMOVE_TIMEOUT, GFS_PROTO_FHREMOVE_MULTI,
+	    b->n, gfs_client_fhremove_multi_send_item, b);
+	if (e == GFARM_ERR_NO_ERROR) {
+		return (NULL);
+	} else if (e == GFARM_ERR_DEVICE_BUSY) {
+		gflog_reduced_info(GFARM_MSG_1005788, &busy_state,
+		    "%s(%d files, %s): busy, waiting for some time", diag,
+		    b->n, host_name(b->host));
+		for (i = 0; i < b->n; i++)
+			host_busyq_enqueue(b->dfcs[i]);
+		fhremove_batch_done(b, FHREMOVE_BATCH_BUSY, 0);
+	} else {
+		for (i = 0; i < b->n; i++)
+			removal_finishedq_enqueue(b->dfcs[i], e);
+		fhremove_batch_done(b, FHREMOVE_BATCH_FAILED, 0);
+	}
+
+	/* this return value won't be used, because this thread is detached */
+	return (NULL);
+}
+
+/* the thread which passes the batches to back_channel_send_thread_pool */
+static void *
+fhremove_dispatcher(void *closure)
+{
+	struct fhremove_batch *b;
+	static const char diag[] = "fhremove_dispatcher";
+
+	for (;;) {
+		gfarm_mutex_lock(&fhremove_mutex, diag, FHREMOVE_MUTEX_DIAG);
+		while (fhremove_ready == NULL)
+			gfarm_cond_wait(&fhremove_ready_cond, &fhremove_mutex,
+			    diag, "ready");
+		b = fhremove_ready;
+		if ((fhremove_ready = b->next) == NULL)
+			fhremove_ready_tail = &fhremove_ready;
+		gfarm_mutex_unlock(&fhremove_mutex, diag,
+		    FHREMOVE_MUTEX_DIAG);
+
+		/* this may sleep, if the job queue is full */
+		thrpool_add_job_low_priority(back_channel_send_thread_pool,
+		    gfs_client_fhremove_multi_request, b);
+	}
+
+	/*NOTREACHED*/
+	return (NULL);
+}
+
+void
+back_channel_fhremove_info(void)
+{
+	struct gfarm_hash_iterator it;
+	struct host *host;
+	struct fhremove_window *w;
+	static const char diag[] = "back_channel_fhremove_info";
+
+	gfarm_mutex_lock(&fhremove_mutex, diag, FHREMOVE_MUTEX_DIAG);
+	for (gfarm_hash_iterator_begin(fhremove_windows, &it);
+	    !gfarm_hash_iterator_is_end(&it);
+	    gfarm_hash_iterator_next(&it)) {
+		host = *(struct host **)gfarm_hash_entry_key(
+		    gfarm_hash_iterator_access(&it));
+		w = gfarm_hash_entry_data(gfarm_hash_iterator_access(&it));
+		gflog_info(GFARM_MSG_1005789,
+		    "file removal on %s: window %d, in flight %d, "
+		    "waiting %d, response %llu/%llu usec per file (avg/min), "
+		    "%llu removed, %llu failed, %llu deferred by busy host",
+		    host_name(host), w->window, w->inflight,
+		    w->nwaiting,
+		    (unsigned long long)w->rtt_avg,
+		    (unsigned long long)w->rtt_min,
+		    (unsigned long long)w->removed,
+		    (unsigned long long)w->failed,
+		    (unsigned long long)w->deferred);
+	}
+	gfarm_mutex_unlock(&fhremove_mutex, diag, FHREMOVE_MUTEX_DIAG);
+}
+
 static void *
 remover(void *closure)
 {
-	struct dead_file_copy *dfc;
+	struct dead_file_copy *dfcs[FHREMOVE_COLLECT_MAX], *dfc;
+	struct fhremove_batch *batches[FHREMOVE_COLLECT_MAX], *b;
+	struct host *host;
+	int i, j, n, nbatches;
 
 	for (;;) {
-		dfc = removal_pendingq_dequeue();
-		if (host_is_file_removable(dead_file_copy_get_host(dfc)))
-			thrpool_add_job_low_priority(
-			    back_channel_send_thread_pool,
-			    gfs_client_fhremove_request, dfc);
-		else /* make this dfcstate_deferred */
-			removal_finishedq_enqueue(dfc,
-			    host_is_up(dead_file_copy_get_host(dfc)) ?
-			    GFARM_ERR_READ_ONLY_FILE_SYSTEM :
-			    GFARM_ERR_NO_ROUTE_TO_HOST);
+		n = removal_pendingq_dequeue_multi(dfcs, FHREMOVE_COLLECT_MAX);
+		nbatches = 0;
+		for (i = 0; i < n; i++) {
+			dfc = dfcs[i];
+			host = dead_file_copy_get_host(dfc);
+			if (!host_is_file_removable(host)) {
+				/* make this dfcstate_deferred */
+				removal_finishedq_enqueue(dfc,
+				    host_is_up(host) ?
+				    GFARM_ERR_READ_ONLY_FILE_SYSTEM :
+				    GFARM_ERR_NO_ROUTE_TO_HOST);
+				continue;
+			}
+			if (!host_supports_fhremove_multi_protocols(host)) {
+				thrpool_add_job_low_priority(
+				    back_channel_send_thread_pool,
+				    gfs_client_fhremove_request, dfc);
+				continue;
+			}
+			for (j = 0; j < nbatches; j++) {
+				if (batches[j]->host == host)
+					break;
+			}
+			if (j == nbatches) {
+				GFARM_MALLOC(b);
+				if (b == NULL) {
+					thrpool_add_job_low_priority(
+					    back_channel_send_thread_pool,
+					    gfs_client_fhremove_request, dfc);
+					continue;
+				}
+				b->host = host;
+				b->n = 0;
+				batches[nbatches++] = b;
+			}
+			b = batches[j];
+			b->dfcs[b->n++] = dfc;
+			if (b->n == GFS_PROTO_MAX_FHREMOVE_MULTI) {
+				fhremove_batch_submit(b);
+				batches[j] = batches[--nbatches];
+			}
+		}
+		for (j = 0; j < nbatches; j++)
+			fhremove_batch_submit(batches[j]);
 	}
 
 	/*NOTREACHED*/
@@ -799,7 +1175,7 @@ gfm_server_switch_back_channel_common(struct peer *peer, int from_client,
 		e = GFARM_ERR_OPERATION_NOT_PERMITTED;
 	} else if (is_async ? (
 	    version <  GFS_PROTOCOL_VERSION_V2_4 ||
-	    version >  GFS_PROTOCOL_VERSION_V2_7_13) :
+	    version >  GFS_PROTOCOL_VERSION_V2_8_4) :
 	    version != GFS_PROTOCOL_VERSION_V2_3) {
 		e = GFARM_ERR_PROTOCOL_NOT_SUPPORTED;
 		gflog_info(GFARM_MSG_1004037,
@@ -951,6 +1327,17 @@ back_channel_init(void)
 		    gfarm_metadb_thread_pool_size,
 		    gfarm_metadb_job_queue_length);
 
+	fhremove_windows = gfarm_hash_table_alloc(FHREMOVE_WINDOWS_HASH_SIZE,
+	    gfarm_hash_default, gfarm_hash_key_equal_default);
+	if (fhremove_windows == NULL)
+		gflog_fatal(GFARM_MSG_1005790,
+		    "fhremove windows: no memory");
+	e = create_detached_thread(fhremove_dispatcher, NULL);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_fatal(GFARM_MSG_1005791,
+		    "create_detached_thread(fhremove_dispatcher): %s",
+		    gfarm_error_string(e));
+
 	e = create_detached_thread(remover, NULL);
 	if (e != GFARM_ERR_NO_ERROR)
 		gflog_fatal(GFARM_MSG_1002289,
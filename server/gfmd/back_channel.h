@@ -20,4 +20,6 @@ gfarm_error_t gfm_server_switch_async_back_channel(struct peer *, int, int);
 struct watcher *back_channel_watcher(void);
 struct thread_pool *back_channel_recv_thrpool(void);
 
+void back_channel_fhremove_info(void);
+
 void back_channel_init(void);
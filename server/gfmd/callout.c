@@ -1,6 +1,6 @@
 #include <pthread.h>
-#include <sys/time.h>
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
@@ -14,6 +14,45 @@
 #include "subr.h"
 #include "thrpool.h"
 
+/*
+ * callouts are kept in a hierarchical timing wheel (Varghese and Lauck),
+ * so that both scheduling and cancellation are O(1) regardless of
+ * how many callouts are pending and how their intervals are distributed.
+ *
+ * each callout thread owns a shard which consists of its own mutex,
+ * condition variable and wheel, thus callout threads never contend with
+ * each other.
+ * shards are divided into groups, and callouts which run on the same
+ * thread pool are bound to the same group by callout_reset() and
+ * callout_setfunc(), so that a shard thread which is blocked in
+ * thrpool_add_job() only delays the callouts of that pool.
+ * within a group, a callout is placed in a shard by the hash of its
+ * address, so the callouts of a busy pool are spread over the shards.
+ * a callout which isn't bound yet is placed in a shard of any group
+ * by the hash as well.
+ *
+ * level 0 of the wheel has CALLOUT_WHEEL_SIZE slots of
+ * CALLOUT_TICK_MICROSEC each, and level N has slots which are
+ * CALLOUT_WHEEL_SIZE times coarser than level N-1.
+ * whenever a level wraps around, the next slot of the upper level
+ * is cascaded down into the lower levels.
+ * a callout which is farther than the whole wheel is parked in the
+ * farthest slot, and it will be re-inserted when the slot is cascaded.
+ */
+#define CALLOUT_TICK_MICROSEC	10000	/* 10ms */
+#define CALLOUT_TICKS_PER_SECOND \
+	(GFARM_SECOND_BY_MICROSEC / CALLOUT_TICK_MICROSEC)
+#define CALLOUT_WHEEL_BITS	8
+#define CALLOUT_WHEEL_SIZE	(1 << CALLOUT_WHEEL_BITS)
+#define CALLOUT_WHEEL_MASK	(CALLOUT_WHEEL_SIZE - 1)
+#define CALLOUT_WHEEL_LEVELS	4
+#define CALLOUT_WHEEL_SPAN \
+	((gfarm_uint64_t)1 << (CALLOUT_WHEEL_BITS * CALLOUT_WHEEL_LEVELS))
+
+#define CALLOUT_TICK_INFINITY	(~(gfarm_uint64_t)0)
+
+struct callout_shard;
+
 struct callout {
 	struct callout *prev, *next;
 
@@ -22,108 +61,284 @@ struct callout {
 #define CALLOUT_INVOKING	4
 	int state;
 
-	struct timespec target_time;
+	gfarm_uint64_t target_tick;
+	struct callout_shard *shard;
 
 	struct thread_pool *thrpool;
 	void *(*func)(void *);
 	void *closure;
 };
 
-struct callout_module {
+struct callout_shard {
 	pthread_mutex_t mutex;
 	pthread_cond_t have_things_to_run;
 
-	/* dummy head of doubly linked circular list */
-	struct callout pendings;
+	/* the next tick which is not processed yet */
+	gfarm_uint64_t current_tick;
+
+	/* the tick callout_main() is sleeping until */
+	gfarm_uint64_t wakeup_tick;
+
+	/* number of callouts in the wheel and in the expired list */
+	long npendings;
+
+	/* dummy heads of doubly linked circular lists */
+	struct callout expired;
+	struct callout wheel[CALLOUT_WHEEL_LEVELS][CALLOUT_WHEEL_SIZE];
+};
+
+struct callout_module {
+	pthread_mutex_t mutex; /* protects thrpools */
+	int ngroups, nshards_per_group, nshards;
+	struct callout_shard *shards; /* nshards_per_group * ngroups */
+
+	/* thrpools[i] is bound to the group (i % ngroups) */
+	int nthrpools;
+	struct thread_pool **thrpools;
 } callout_module;
 
 static const char module_name[] = "callout_module";
 
-int
-timespec_cmp(const struct timespec *t1, const struct timespec *t2)
+static void
+callout_list_init(struct callout *head)
+{
+	head->prev = head;
+	head->next = head;
+}
+
+static int
+callout_list_is_empty(struct callout *head)
+{
+	return (head->next == head);
+}
+
+static void
+callout_list_add_tail(struct callout *head, struct callout *c)
+{
+	c->prev = head->prev;
+	c->next = head;
+	head->prev->next = c;
+	head->prev = c;
+}
+
+static void
+callout_list_remove(struct callout *c)
+{
+	c->prev->next = c->next;
+	c->next->prev = c->prev;
+	/* clear the pointers to be sure */
+	c->next = c;
+	c->prev = c;
+}
+
+static gfarm_uint64_t
+callout_current_tick(void)
+{
+	struct timespec now;
+
+	gfarm_gettime(&now);
+	return ((gfarm_uint64_t)now.tv_sec * CALLOUT_TICKS_PER_SECOND +
+	    now.tv_nsec /
+	    (CALLOUT_TICK_MICROSEC * GFARM_MICROSEC_BY_NANOSEC));
+}
+
+static void
+callout_tick_to_timespec(gfarm_uint64_t tick, struct timespec *ts)
+{
+	ts->tv_sec = tick / CALLOUT_TICKS_PER_SECOND;
+	ts->tv_nsec = (tick % CALLOUT_TICKS_PER_SECOND) *
+	    CALLOUT_TICK_MICROSEC * GFARM_MICROSEC_BY_NANOSEC;
+}
+
+/* PREREQUISITE: shard->mutex */
+static void
+callout_wheel_insert(struct callout_shard *shard, struct callout *c)
+{
+	gfarm_uint64_t tick = c->target_tick, delta;
+	int level;
+
+	if (tick < shard->current_tick) /* already expired */
+		tick = shard->current_tick;
+	delta = tick - shard->current_tick;
+	if (delta >= CALLOUT_WHEEL_SPAN) {
+		/* park in the farthest slot, re-inserted at the cascade */
+		delta = CALLOUT_WHEEL_SPAN - 1;
+		tick = shard->current_tick + delta;
+	}
+	for (level = 0; level < CALLOUT_WHEEL_LEVELS - 1; level++) {
+		if (delta < ((gfarm_uint64_t)1 <<
+		    (CALLOUT_WHEEL_BITS * (level + 1))))
+			break;
+	}
+	callout_list_add_tail(&shard->wheel[level][
+	    (tick >> (CALLOUT_WHEEL_BITS * level)) & CALLOUT_WHEEL_MASK], c);
+}
+
+/* PREREQUISITE: shard->mutex */
+static void
+callout_wheel_cascade(struct callout_shard *shard, int level, int slot)
+{
+	struct callout *head = &shard->wheel[level][slot], *c;
+
+	while (!callout_list_is_empty(head)) {
+		c = head->next;
+		callout_list_remove(c);
+		callout_wheel_insert(shard, c);
+	}
+}
+
+/*
+ * move all callouts which expire at or before `now' to the expired list
+ *
+ * PREREQUISITE: shard->mutex
+ */
+static void
+callout_wheel_advance(struct callout_shard *shard, gfarm_uint64_t now)
 {
-	if (t1->tv_sec > t2->tv_sec)
-		return (1);
-	if (t1->tv_sec < t2->tv_sec)
-		return (-1);
-	if (t1->tv_nsec > t2->tv_nsec)
-		return (1);
-	if (t1->tv_nsec < t2->tv_nsec)
-		return (-1);
-	return (0);
+	struct callout *head, *c;
+	int level, slot;
+
+	if (shard->npendings == 0) {
+		/* nothing to do, and no need to cascade */
+		if (shard->current_tick < now)
+			shard->current_tick = now;
+		return;
+	}
+	for (; shard->current_tick <= now; shard->current_tick++) {
+		slot = shard->current_tick & CALLOUT_WHEEL_MASK;
+		for (level = 1; slot == 0 && level < CALLOUT_WHEEL_LEVELS;
+		    level++) {
+			slot = (shard->current_tick >>
+			    (CALLOUT_WHEEL_BITS * level)) & CALLOUT_WHEEL_MASK;
+			callout_wheel_cascade(shard, level, slot);
+		}
+		head = &shard->wheel[0][
+		    shard->current_tick & CALLOUT_WHEEL_MASK];
+		while (!callout_list_is_empty(head)) {
+			c = head->next;
+			callout_list_remove(c);
+			callout_list_add_tail(&shard->expired, c);
+		}
+	}
+}
+
+/*
+ * returns the tick when callout_main() has to wake up next,
+ * i.e. either the nearest non-empty slot of level 0 or the next cascade.
+ *
+ * PREREQUISITE: shard->mutex
+ */
+static gfarm_uint64_t
+callout_wheel_next_tick(struct callout_shard *shard)
+{
+	gfarm_uint64_t tick;
+
+	for (tick = shard->current_tick;; tick++) {
+		if (!callout_list_is_empty(
+		    &shard->wheel[0][tick & CALLOUT_WHEEL_MASK]))
+			return (tick);
+		if (((tick + 1) & CALLOUT_WHEEL_MASK) == 0)
+			return (tick + 1);
+	}
 }
 
 void *
 callout_main(void *arg)
 {
-	struct callout_module *cm = arg;
+	struct callout_shard *shard = arg;
 	struct callout *c;
 	struct thread_pool *thrpool;
 	void *(*func)(void *);
 	void *closure;
 	int rv;
-	struct timespec now;
+	struct timespec timeout;
 
-#ifdef __GNUC__ /* shut up stupid warning by gcc */
-	thrpool = NULL;
-	closure = NULL;
-#endif
 	for (;;) {
-		gfarm_mutex_lock(&cm->mutex, module_name, "main lock");
-		c = cm->pendings.next;
-		if (c == &cm->pendings)
-			rv = pthread_cond_wait(&cm->have_things_to_run,
-			    &cm->mutex);
-		else
-			rv = pthread_cond_timedwait(&cm->have_things_to_run,
-			    &cm->mutex, &c->target_time);
-		if (rv != 0 && rv != ETIMEDOUT) {
-			gflog_fatal(GFARM_MSG_1001490, "s: %s cond wait: %s",
-			    module_name, strerror(rv));
-		}
-
-		func = NULL;
-
-		/* cm->pendings may be changed while cond_wait */
-		c = cm->pendings.next;
-		if (c != &cm->pendings) {
-			gfarm_gettime(&now);
-			if (timespec_cmp(&c->target_time, &now) <= 0) {
-				/* remove the head of the list */
-				c->prev->next = c->next;
-				c->next->prev = c->prev;
-				/* clear the pointers to be sure */
-				c->next = c;
-				c->prev = c;
-				c->state &= ~CALLOUT_PENDING;
-				c->state |= (CALLOUT_FIRED | CALLOUT_INVOKING);
-				thrpool = c->thrpool;
-				func = c->func;
-				closure = c->closure;
+		gfarm_mutex_lock(&shard->mutex, module_name, "main lock");
+		for (;;) {
+			callout_wheel_advance(shard, callout_current_tick());
+			if (!callout_list_is_empty(&shard->expired))
+				break;
+			if (shard->npendings == 0) {
+				shard->wakeup_tick = CALLOUT_TICK_INFINITY;
+				rv = pthread_cond_wait(
+				    &shard->have_things_to_run,
+				    &shard->mutex);
+			} else {
+				shard->wakeup_tick =
+				    callout_wheel_next_tick(shard);
+				callout_tick_to_timespec(shard->wakeup_tick,
+				    &timeout);
+				rv = pthread_cond_timedwait(
+				    &shard->have_things_to_run,
+				    &shard->mutex, &timeout);
+			}
+			if (rv != 0 && rv != ETIMEDOUT) {
+				gflog_fatal(GFARM_MSG_1001490,
+				    "s: %s cond wait: %s",
+				    module_name, strerror(rv));
 			}
 		}
-		gfarm_mutex_unlock(&cm->mutex, module_name, "main lock");
+		shard->wakeup_tick = CALLOUT_TICK_INFINITY;
+
+		/* remove the head of the expired list */
+		c = shard->expired.next;
+		callout_list_remove(c);
+		shard->npendings--;
+		c->state &= ~CALLOUT_PENDING;
+		c->state |= (CALLOUT_FIRED | CALLOUT_INVOKING);
+		thrpool = c->thrpool;
+		func = c->func;
+		closure = c->closure;
+		gfarm_mutex_unlock(&shard->mutex, module_name, "main lock");
 
 		if (func != NULL)
 			thrpool_add_job(thrpool, func, closure);
 	}
 }
 
-/* This function is equivalent to callout_startup(9) */
+/*
+ * This function is equivalent to callout_startup(9)
+ *
+ * ngroups * nshards_per_group callout threads are created.
+ */
 void
-callout_module_init(int nthreads)
+callout_module_init(int ngroups, int nshards_per_group)
 {
 	gfarm_error_t e;
 	struct callout_module *cm = &callout_module;
-	int i;
+	struct callout_shard *shard;
+	int i, level, slot, nshards;
 
+	assert(ngroups > 0 && nshards_per_group > 0);
+	nshards = ngroups * nshards_per_group;
 	gfarm_mutex_init(&cm->mutex, module_name, "init");
-	gfarm_cond_init(&cm->have_things_to_run, module_name, "init");
-	cm->pendings.prev = &cm->pendings;
-	cm->pendings.next = &cm->pendings;
-
-	for (i = 0; i < nthreads; i++) {
-		e = create_detached_thread(callout_main, &callout_module);
+	GFARM_MALLOC_ARRAY(cm->shards, nshards);
+	if (cm->shards == NULL)
+		gflog_fatal(GFARM_MSG_1005744,
+		    "callout_module_init: %d shards: no memory", nshards);
+	cm->ngroups = ngroups;
+	cm->nshards_per_group = nshards_per_group;
+	cm->nshards = nshards;
+	cm->nthrpools = 0;
+	cm->thrpools = NULL;
+
+	for (i = 0; i < nshards; i++) {
+		shard = &cm->shards[i];
+		gfarm_mutex_init(&shard->mutex, module_name, "init");
+		gfarm_cond_init(&shard->have_things_to_run, module_name,
+		    "init");
+		shard->current_tick = callout_current_tick();
+		shard->wakeup_tick = CALLOUT_TICK_INFINITY;
+		shard->npendings = 0;
+		callout_list_init(&shard->expired);
+		for (level = 0; level < CALLOUT_WHEEL_LEVELS; level++) {
+			for (slot = 0; slot < CALLOUT_WHEEL_SIZE; slot++)
+				callout_list_init(&shard->wheel[level][slot]);
+		}
+	}
+	for (i = 0; i < nshards; i++) {
+		e = create_detached_thread(callout_main, &cm->shards[i]);
 		if (e != GFARM_ERR_NO_ERROR)
 			gflog_fatal(GFARM_MSG_1001491,
 			    "callout_module_init: create_detached_thread: %s",
@@ -131,10 +346,22 @@ callout_module_init(int nthreads)
 	}
 }
 
+/* returns a number in [0, n) which is derived from the address of `c' */
+static int
+callout_hash(struct callout *c, int n)
+{
+	/* Fibonacci hashing, the low bits of the address are aligned */
+	gfarm_uint64_t h = (gfarm_uint64_t)(uintptr_t)c *
+	    0x9e3779b97f4a7c15ULL;
+
+	return ((int)((h >> 32) % n));
+}
+
 /* This function is nearly equivalent to callout_init(9) */
 struct callout *
 callout_new(void)
 {
+	struct callout_module *cm = &callout_module;
 	struct callout *c;
 
 	GFARM_MALLOC(c);
@@ -143,11 +370,112 @@ callout_new(void)
 	c->prev = c;
 	c->next = c;
 	c->state = 0;
+	c->target_tick = 0;
+	c->thrpool = NULL;
 	c->func = NULL;
 	c->closure = NULL;
+
+	/*
+	 * any shard, until it's bound to a thread pool.
+	 * no shard, if callout_module_init() isn't called, e.g. in
+	 * a regression test which uses gfmd modules, such callout can be
+	 * stopped and freed, but cannot be scheduled.
+	 */
+	c->shard = cm->nshards == 0 ? NULL :
+	    &cm->shards[callout_hash(c, cm->nshards)];
 	return (c);
 }
 
+/*
+ * returns the shard in the group which callouts running on `thrpool'
+ * are bound to, or NULL if `c' doesn't have to move,
+ * i.e. it's already in the group, or there is no memory to remember
+ * `thrpool'.
+ *
+ * c->thrpool is only changed with the shard lock held, but reading it
+ * without the lock is fine, because a stale value only makes
+ * the lookup below happen.
+ */
+static struct callout_shard *
+callout_shard_of(struct callout *c, struct thread_pool *thrpool)
+{
+	struct callout_module *cm = &callout_module;
+	struct callout_shard *shard = NULL;
+	struct thread_pool **thrpools;
+	int i;
+
+	/* the callout is already bound to the group of `thrpool' */
+	if (c->thrpool == thrpool)
+		return (NULL);
+
+	gfarm_mutex_lock(&cm->mutex, module_name, "shard_of lock");
+	for (i = 0; i < cm->nthrpools; i++) {
+		if (cm->thrpools[i] == thrpool)
+			break;
+	}
+	if (i == cm->nthrpools) {
+		GFARM_REALLOC_ARRAY(thrpools, cm->thrpools, i + 1);
+		if (thrpools != NULL) {
+			cm->thrpools = thrpools;
+			cm->thrpools[cm->nthrpools++] = thrpool;
+		}
+	}
+	if (i < cm->nthrpools)
+		shard = &cm->shards[(i % cm->ngroups) * cm->nshards_per_group +
+		    callout_hash(c, cm->nshards_per_group)];
+	gfarm_mutex_unlock(&cm->mutex, module_name, "shard_of unlock");
+	return (shard);
+}
+
+/*
+ * locks the shard of `c', after moving `c' to `to' if `to' isn't NULL.
+ *
+ * c->shard may be changed by another thread until the shard is locked,
+ * thus it's checked again after locking, as callout_lock() of FreeBSD does.
+ */
+static struct callout_shard *
+callout_lock(struct callout *c, struct callout_shard *to, const char *diag)
+{
+	struct callout_shard *shard;
+
+	assert(c->shard != NULL);
+	for (;;) {
+		shard = c->shard;
+		if (to == NULL || to == shard) {
+			gfarm_mutex_lock(&shard->mutex, module_name, diag);
+			if (shard == c->shard)
+				return (shard);
+			gfarm_mutex_unlock(&shard->mutex, module_name, diag);
+			continue;
+		}
+		/* lock both in the order of the address to avoid deadlock */
+		gfarm_mutex_lock(shard < to ? &shard->mutex : &to->mutex,
+		    module_name, diag);
+		gfarm_mutex_lock(shard < to ? &to->mutex : &shard->mutex,
+		    module_name, diag);
+		if (shard == c->shard)
+			break;
+		gfarm_mutex_unlock(&to->mutex, module_name, diag);
+		gfarm_mutex_unlock(&shard->mutex, module_name, diag);
+	}
+	if ((c->state & CALLOUT_PENDING) != 0) {
+		/* from the wheel or from the expired list */
+		callout_list_remove(c);
+		shard->npendings--;
+		if (to->npendings == 0 &&
+		    to->current_tick < shard->current_tick)
+			to->current_tick = shard->current_tick;
+		callout_wheel_insert(to, c);
+		to->npendings++;
+		if (c->target_tick < to->wakeup_tick)
+			gfarm_cond_signal(&to->have_things_to_run,
+			    module_name, diag);
+	}
+	c->shard = to;
+	gfarm_mutex_unlock(&shard->mutex, module_name, diag);
+	return (to);
+}
+
 /*
  * This function is equivalent to callout_destroy(9)
  *
@@ -160,105 +488,94 @@ callout_free(struct callout *c)
 	free(c);
 }
 
+/*
+ * the expiration is rounded up to CALLOUT_TICK_MICROSEC,
+ * and the cost of this function doesn't depend on the number of
+ * pending callouts nor on the intervals they are scheduled with.
+ */
 static void
-callout_schedule_common(struct callout *n, int microseconds)
+callout_schedule_common(struct callout *c, int microseconds)
 {
-	struct callout_module *cm = &callout_module;
-	struct callout *c;
-	struct timeval now;
-
-	/* callout_module.mutex must be already locked here */
-
-	gettimeofday(&now, NULL);
-	gfarm_timeval_add_microsec(&now, microseconds);
-	n->target_time.tv_sec = now.tv_sec;
-	n->target_time.tv_nsec = now.tv_usec * GFARM_MICROSEC_BY_NANOSEC;
-	n->state &= ~(CALLOUT_FIRED | CALLOUT_INVOKING);
+	struct callout_shard *shard = c->shard;
+	gfarm_uint64_t now = callout_current_tick();
 
-	if ((n->state & CALLOUT_PENDING) != 0) {
-		/* remove from the pending list */
-		n->prev->next = n->next;
-		n->next->prev = n->prev;
-	}
+	/* c->shard->mutex must be already locked here */
 
-	/*
-	 * Since currently all callouts are scheduled with same interval
-	 * (i.e. gfarm_metadb_heartbeat_interval), searching from the tail
-	 * is most efficient.
-	 * XXX If we use another interval for something, this implementation
-	 * should be changed to use buckets for efficiency.
-	 */
-	for (c = cm->pendings.prev; c != &cm->pendings;
-	     c = c->prev) {
-		if (timespec_cmp(&n->target_time, &c->target_time) >= 0)
-			break;
+	c->state &= ~(CALLOUT_FIRED | CALLOUT_INVOKING);
+	if ((c->state & CALLOUT_PENDING) != 0) {
+		callout_list_remove(c);
+		shard->npendings--;
 	}
-	/* insert n as the successor of c */
-	n->prev = c;
-	n->next = c->next;
-	c->next->prev = n;
-	c->next = n;
-	n->state |= CALLOUT_PENDING;
-	if (n->prev == &cm->pendings)
-		gfarm_cond_signal(&cm->have_things_to_run, module_name,
+	/* the wheel is empty, so skip the idle period at once */
+	if (shard->npendings == 0 && shard->current_tick < now)
+		shard->current_tick = now;
+
+	if (microseconds < 0)
+		microseconds = 0;
+	c->target_tick = now +
+	    (microseconds + CALLOUT_TICK_MICROSEC - 1) / CALLOUT_TICK_MICROSEC;
+	callout_wheel_insert(shard, c);
+	shard->npendings++;
+	c->state |= CALLOUT_PENDING;
+	if (c->target_tick < shard->wakeup_tick)
+		gfarm_cond_signal(&shard->have_things_to_run, module_name,
 		    "scheduling singal");
 }
 
 void
 callout_schedule(struct callout *c, int microseconds)
 {
-	struct callout_module *cm = &callout_module;
+	struct callout_shard *shard = callout_lock(c, NULL, "schedule lock");
 
-	gfarm_mutex_lock(&cm->mutex, module_name, "schedule lock");
 	callout_schedule_common(c, microseconds);
-	gfarm_mutex_unlock(&cm->mutex, module_name, "schedule unlock");
+	gfarm_mutex_unlock(&shard->mutex, module_name, "schedule unlock");
 }
 
 void
 callout_reset(struct callout *c, int microseconds,
 	struct thread_pool *thrpool, void *(*func)(void *), void *closure)
 {
-	struct callout_module *cm = &callout_module;
+	struct callout_shard *shard =
+	    callout_lock(c, callout_shard_of(c, thrpool), "reset lock");
 
-	gfarm_mutex_lock(&cm->mutex, module_name, "reset lock");
 	c->thrpool = thrpool;
 	c->func = func;
 	c->closure = closure;
 	callout_schedule_common(c, microseconds);
-	gfarm_mutex_unlock(&cm->mutex, module_name, "reset unlock");
+	gfarm_mutex_unlock(&shard->mutex, module_name, "reset unlock");
 }
 
 void
 callout_setfunc(struct callout *c,
 	struct thread_pool *thrpool, void *(*func)(void *), void *closure)
 {
-	struct callout_module *cm = &callout_module;
+	struct callout_shard *shard =
+	    callout_lock(c, callout_shard_of(c, thrpool), "setfunc lock");
 
-	gfarm_mutex_lock(&cm->mutex, module_name, "reset lock");
 	c->thrpool = thrpool;
 	c->func = func;
 	c->closure = closure;
-	gfarm_mutex_unlock(&cm->mutex, module_name, "reset unlock");
+	gfarm_mutex_unlock(&shard->mutex, module_name, "setfunc unlock");
 }
 
 int
 callout_stop(struct callout *c)
 {
-	struct callout_module *cm = &callout_module;
+	struct callout_shard *shard;
 	int expired;
 
-	gfarm_mutex_lock(&cm->mutex, module_name, "stop lock");
+	if (c->shard == NULL) /* the module isn't initialized */
+		return (0);
+	shard = callout_lock(c, NULL, "stop lock");
+
 	if ((c->state & CALLOUT_PENDING) != 0) {
-		/* remove the head of the list */
-		c->prev->next = c->next;
-		c->next->prev = c->prev;
-		/* clear the pointers to be sure */
-		c->next = c;
-		c->prev = c;
+		/* remove from the wheel or from the expired list */
+		callout_list_remove(c);
+		shard->npendings--;
 	}
 	expired = (c->state & CALLOUT_FIRED) != 0;
 	c->state &= ~(CALLOUT_PENDING | CALLOUT_FIRED);
-	gfarm_mutex_unlock(&cm->mutex, module_name, "stop unlock");
+	gfarm_mutex_unlock(&shard->mutex, module_name, "stop unlock");
 	return (expired);
 }
 
@@ -266,22 +583,20 @@ callout_stop(struct callout *c)
 int
 callout_invoking(struct callout *c)
 {
-	struct callout_module *cm = &callout_module;
+	struct callout_shard *shard = callout_lock(c, NULL, "invoking lock");
 	int invoking;
 
-	gfarm_mutex_lock(&cm->mutex, module_name, "invoking lock");
 	invoking = (c->state & CALLOUT_INVOKING) != 0;
-	gfarm_mutex_unlock(&cm->mutex, module_name, "invoking unlock");
+	gfarm_mutex_unlock(&shard->mutex, module_name, "invoking unlock");
 	return (invoking);
 }
 
 void
 callout_ack(struct callout *c)
 {
-	struct callout_module *cm = &callout_module;
+	struct callout_shard *shard = callout_lock(c, NULL, "ack lock");
 
-	gfarm_mutex_lock(&cm->mutex, module_name, "ack lock");
 	c->state &= ~CALLOUT_INVOKING;
-	gfarm_mutex_unlock(&cm->mutex, module_name, "ack unlock");
+	gfarm_mutex_unlock(&shard->mutex, module_name, "ack unlock");
 }
 #endif /* NOT_USED */
@@ -12,7 +12,7 @@
 struct callout;
 struct thread_pool;
 
-void callout_module_init(int);
+void callout_module_init(int, int);
 struct callout *callout_new(void);
 void callout_free(struct callout *);
 void callout_schedule(struct callout *, int);
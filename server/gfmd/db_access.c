@@ -65,6 +65,9 @@ static const struct db_ops *ops;
 const struct db_ops *store_ops;
 static db_enter_func_t db_enter_op = dbq_enter1;
 
+/* filesystem tables may be loaded from other than `ops', see db_snapshot.c */
+static const struct db_ops *load_ops;
+
 static int transaction_nesting = 0;
 
 gfarm_error_t
@@ -321,10 +324,12 @@ gfarm_dbq_enter_for_waitret(
 	return (dbq_enter_for_waitret(func, data, ctx));
 }
 
+/* take at most `max' entries from the queue */
 static gfarm_error_t
-dbq_delete(struct dbq *q, struct dbq_entry *entp)
+dbq_delete(struct dbq *q, struct dbq_entry *ents, int max, int *np)
 {
 	gfarm_error_t e;
+	int i, n;
 	static const char diag[] = "dbq_delete";
 
 	gfarm_mutex_lock(&q->mutex, diag, "mutex");
@@ -338,12 +343,22 @@ dbq_delete(struct dbq *q, struct dbq_entry *entp)
 		e = GFARM_ERR_NO_SUCH_OBJECT;
 	} else { /* (q->n > 0) */
 		e = GFARM_ERR_NO_ERROR;
-		*entp = q->entries[q->out++];
-		if (q->out >= gfarm_metadb_dbq_size)
-			q->out = 0;
-		if (q->n-- >= gfarm_metadb_dbq_size) {
-			gfarm_cond_signal(&q->nonfull, diag, "nonfull");
+		n = q->n < max ? q->n : max;
+		for (i = 0; i < n; i++) {
+			ents[i] = q->entries[q->out++];
+			if (q->out >= gfarm_metadb_dbq_size)
+				q->out = 0;
+		}
+		if (q->n >= gfarm_metadb_dbq_size) {
+			if (n == 1)
+				gfarm_cond_signal(&q->nonfull, diag,
+				    "nonfull");
+			else
+				gfarm_cond_broadcast(&q->nonfull, diag,
+				    "nonfull");
 		}
+		q->n -= n;
+		*np = n;
 	}
 	gfarm_mutex_unlock(&q->mutex, diag, "mutex");
 	return (e);
@@ -402,6 +417,18 @@ db_use(const struct db_ops *o)
 	return (GFARM_ERR_NO_ERROR);
 }
 
+void
+db_use_for_load(const struct db_ops *o)
+{
+	load_ops = o;
+}
+
+static const struct db_ops *
+db_load_ops(void)
+{
+	return (load_ops != NULL ? load_ops : ops);
+}
+
 gfarm_error_t
 db_initialize(void)
 {
@@ -439,36 +466,313 @@ get_db_access_mutex(void)
 	return (&db_access_mutex);
 }
 
+/*
+ * statistics of db_thread(), reported by db_thread_info().
+ * "entries" doesn't include begin/end marks of transactions.
+ */
+static pthread_mutex_t db_thread_stat_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char DB_THREAD_STAT_MUTEX_DIAG[] = "db_thread_stat_mutex";
+static struct db_thread_stat {
+	gfarm_uint64_t entries, statements, collapsed;
+	gfarm_uint64_t batches, batch_entries, batch_failures;
+} db_thread_stat;
+
+static void
+db_thread_stat_add(int entries, int statements, int collapsed,
+	int batches, int batch_entries, int batch_failures)
+{
+	static const char diag[] = "db_thread_stat_add";
+
+	gfarm_mutex_lock(&db_thread_stat_mutex, diag,
+	    DB_THREAD_STAT_MUTEX_DIAG);
+	db_thread_stat.entries += entries;
+	db_thread_stat.statements += statements;
+	db_thread_stat.collapsed += collapsed;
+	db_thread_stat.batches += batches;
+	db_thread_stat.batch_entries += batch_entries;
+	db_thread_stat.batch_failures += batch_failures;
+	gfarm_mutex_unlock(&db_thread_stat_mutex, diag,
+	    DB_THREAD_STAT_MUTEX_DIAG);
+}
+
+void
+db_thread_info(void)
+{
+	struct db_thread_stat st;
+	struct timeval now;
+	double elapsed;
+	static struct timeval last;
+	static gfarm_uint64_t last_statements;
+	static const char diag[] = "db_thread_info";
+
+	if (gfarm_is_db_access_type_none())
+		return;
+
+	gfarm_mutex_lock(&db_thread_stat_mutex, diag,
+	    DB_THREAD_STAT_MUTEX_DIAG);
+	st = db_thread_stat;
+	gettimeofday(&now, NULL);
+	elapsed = last.tv_sec == 0 ? 0.0 :
+	    (now.tv_sec - last.tv_sec) +
+	    (now.tv_usec - last.tv_usec) / 1000000.0;
+	gflog_info(GFARM_MSG_1005711,
+	    "dbq: entries=%llu, statements=%llu (%.1f/sec), "
+	    "%.2f entries/statement, collapsed=%llu, free slots=%d",
+	    (unsigned long long)st.entries,
+	    (unsigned long long)st.statements,
+	    elapsed > 0.0 ? (st.statements - last_statements) / elapsed : 0.0,
+	    st.statements == 0 ? 0.0 :
+	    (double)st.entries / st.statements,
+	    (unsigned long long)st.collapsed, db_getfreenum());
+	gflog_info(GFARM_MSG_1005712,
+	    "dbq: batches=%llu, %.1f entries/batch, batch failures=%llu",
+	    (unsigned long long)st.batches,
+	    st.batches == 0 ? 0.0 : (double)st.batch_entries / st.batches,
+	    (unsigned long long)st.batch_failures);
+	last = now;
+	last_statements = st.statements;
+	gfarm_mutex_unlock(&db_thread_stat_mutex, diag,
+	    DB_THREAD_STAT_MUTEX_DIAG);
+}
+
+/* returns the change of the transaction nesting level by the entry */
+static int
+db_entry_nesting(struct dbq_entry *ent)
+{
+	if (ent->func == (dbq_entry_func_t)ops->begin)
+		return (1);
+	if (ent->func == (dbq_entry_func_t)ops->end)
+		return (-1);
+	return (0);
+}
+
+/*
+ * set *inump and return 1, if the entry is an update of the INode table.
+ * a later entry with the same func (or ops->inode_modify which updates
+ * all columns) for the same inode makes this entry redundant.
+ */
+static int
+db_entry_inode_modify(struct dbq_entry *ent, gfarm_ino_t *inump)
+{
+	dbq_entry_func_t f = ent->func;
+
+	if (f == (dbq_entry_func_t)ops->inode_modify)
+		*inump = ((struct gfs_stat *)ent->data)->st_ino;
+	else if (f == (dbq_entry_func_t)ops->inode_gen_modify ||
+	    f == (dbq_entry_func_t)ops->inode_nlink_modify ||
+	    f == (dbq_entry_func_t)ops->inode_size_modify)
+		*inump = ((struct db_inode_uint64_modify_arg *)ent->data)->inum;
+	else if (f == (dbq_entry_func_t)ops->inode_mode_modify)
+		*inump = ((struct db_inode_uint32_modify_arg *)ent->data)->inum;
+	else if (f == (dbq_entry_func_t)ops->inode_user_modify ||
+	    f == (dbq_entry_func_t)ops->inode_group_modify)
+		*inump = ((struct db_inode_string_modify_arg *)ent->data)->inum;
+	else if (f == (dbq_entry_func_t)ops->inode_atime_modify ||
+	    f == (dbq_entry_func_t)ops->inode_mtime_modify ||
+	    f == (dbq_entry_func_t)ops->inode_ctime_modify)
+		*inump =
+		    ((struct db_inode_timespec_modify_arg *)ent->data)->inum;
+	else
+		return (0);
+	return (1);
+}
+
+/*
+ * only entries which just update the database and free their argument
+ * can be batched.  e.g. dbq_call_callback() cannot.
+ */
+static int
+db_entry_is_batchable(struct dbq_entry *ent)
+{
+	dbq_entry_func_t f = ent->func;
+	gfarm_ino_t inum;
+
+	return (db_entry_nesting(ent) != 0 ||
+	    db_entry_inode_modify(ent, &inum) ||
+	    f == (dbq_entry_func_t)ops->inode_add ||
+	    f == (dbq_entry_func_t)ops->filecopy_add ||
+	    f == (dbq_entry_func_t)ops->filecopy_remove ||
+	    f == (dbq_entry_func_t)ops->deadfilecopy_add ||
+	    f == (dbq_entry_func_t)ops->deadfilecopy_remove ||
+	    f == (dbq_entry_func_t)ops->direntry_add ||
+	    f == (dbq_entry_func_t)ops->direntry_remove ||
+	    f == (dbq_entry_func_t)ops->symlink_add ||
+	    f == (dbq_entry_func_t)ops->symlink_remove);
+}
+
+/* the longest prefix of batchable entries which closes all transactions */
+static int
+db_batch_length(struct dbq_entry *ents, int n)
+{
+	int i, nesting = 0, len = 0;
+
+	for (i = 0; i < n && db_entry_is_batchable(&ents[i]); i++) {
+		nesting += db_entry_nesting(&ents[i]);
+		if (nesting < 0)
+			break;
+		if (nesting == 0)
+			len = i + 1;
+	}
+	return (len);
+}
+
+/* drop updates of the INode table overwritten later in the same batch */
+static int
+db_batch_collapse(struct dbq_entry *ents, int n)
+{
+	int i, j, collapsed = 0;
+	gfarm_ino_t inum, inum2;
+
+	for (i = 0; i < n; i++) {
+		if (!db_entry_inode_modify(&ents[i], &inum))
+			continue;
+		for (j = i + 1; j < n; j++) {
+			if ((ents[j].func == ents[i].func ||
+			    ents[j].func == (dbq_entry_func_t)ops->inode_modify)
+			    && db_entry_inode_modify(&ents[j], &inum2) &&
+			    inum2 == inum) {
+				free(ents[i].data);
+				ents[i].func = NULL;
+				ents[i].data = NULL;
+				collapsed++;
+				break;
+			}
+		}
+	}
+	return (collapsed);
+}
+
+static void
+db_entry_call(struct dbq_entry *ent)
+{
+	gfarm_error_t e;
+
+	/* Do not execute a function that writes to database
+	 * when metadata-replication enabled.
+	 * Because we pass seqnum as zero. */
+	do {
+		e = (*ent->func)(0, ent->data);
+	} while (e == GFARM_ERR_DB_ACCESS_SHOULD_BE_RETRIED);
+}
+
+static void
+db_batch_call(struct dbq_entry *ents, int n)
+{
+	gfarm_error_t e;
+	int i, entries = 0, statements = 0, collapsed;
+
+	for (i = 0; i < n; i++) {
+		if (db_entry_nesting(&ents[i]) == 0)
+			entries++;
+	}
+	collapsed = db_batch_collapse(ents, n);
+
+	if ((e = (*ops->batch_begin)(n)) == GFARM_ERR_NO_ERROR) {
+		for (i = 0; i < n; i++) {
+			if (ents[i].func == NULL)
+				continue;
+			if (db_entry_nesting(&ents[i]) == 0)
+				statements++;
+			if ((e = (*ents[i].func)(0, ents[i].data))
+			    != GFARM_ERR_NO_ERROR)
+				break;
+		}
+		e = (*ops->batch_end)(i == n);
+		if (e == GFARM_ERR_NO_ERROR) {
+			db_thread_stat_add(entries, statements, collapsed,
+			    1, entries, 0);
+			return;
+		}
+		if (e == GFARM_ERR_NO_MEMORY) {
+			gflog_error(GFARM_MSG_1005713,
+			    "db_thread: %d of %d entries are lost due to "
+			    "no memory", i + 1, n);
+			i++;
+		} else {
+			gflog_notice(GFARM_MSG_1005714,
+			    "db_thread: batch of %d entries failed (%s), "
+			    "retrying one by one", n, gfarm_error_string(e));
+			i = 0;
+		}
+	} else {
+		gflog_debug(GFARM_MSG_1005715,
+		    "db_thread: cannot start batch: %s",
+		    gfarm_error_string(e));
+		i = 0;
+	}
+
+	statements = 0;
+	for (; i < n; i++) {
+		if (ents[i].func == NULL)
+			continue;
+		if (db_entry_nesting(&ents[i]) == 0)
+			statements++;
+		db_entry_call(&ents[i]);
+	}
+	db_thread_stat_add(entries, statements, collapsed, 0, 0, 1);
+}
+
 void *
 db_thread(void *arg)
 {
 	gfarm_error_t e;
-	struct dbq_entry ent;
+	struct dbq_entry ent, *ents;
+	int i, n, nsingle, batch_size, nbatch, nesting = 0;
 	static const char diag[] = "db_thread";
 
 	if (gfarm_is_db_access_type_none())
 		return (NULL);
 
+	batch_size = gfarm_metadb_dbq_batch_size;
+	if (batch_size < 1 || ops->batch_begin == NULL)
+		batch_size = 1;
+	if (batch_size == 1)
+		ents = &ent;
+	else {
+		GFARM_MALLOC_ARRAY(ents, batch_size);
+		if (ents == NULL) {
+			gflog_warning(GFARM_MSG_1005716,
+			    "db_thread: no memory for %d entries, "
+			    "batch is disabled", batch_size);
+			batch_size = 1;
+			ents = &ent;
+		}
+	}
+
 	for (;;) {
-		e = dbq_delete(&dbq, &ent);
+		e = dbq_delete(&dbq, ents, batch_size, &n);
 		if (e == GFARM_ERR_NO_ERROR) {
 			/* lock to avoid race condition between
 			 * db_journal_store_thread. */
 			gfarm_mutex_lock(&db_access_mutex, diag,
 			    DB_ACCESS_MUTEX_DIAG);
 
-			/* Do not execute a function that writes to database
-			 * when metadata-replication enabled.
-			 * Because we pass seqnum as zero. */
-			do {
-				e = (*ent.func)(0, ent.data);
-			} while (e == GFARM_ERR_DB_ACCESS_SHOULD_BE_RETRIED);
+			i = 0;
+			if (nesting == 0 && n > 1) {
+				nbatch = db_batch_length(ents, n);
+				if (nbatch > 1) {
+					db_batch_call(ents, nbatch);
+					i = nbatch;
+				}
+			}
+			for (nsingle = 0; i < n; i++) {
+				if (db_entry_nesting(&ents[i]) == 0)
+					nsingle++;
+				else
+					nesting += db_entry_nesting(&ents[i]);
+				db_entry_call(&ents[i]);
+			}
+			if (nsingle > 0)
+				db_thread_stat_add(nsingle, nsingle,
+				    0, 0, 0, 0);
 
 			gfarm_mutex_unlock(&db_access_mutex, diag,
 			    DB_ACCESS_MUTEX_DIAG);
 		} else if (e == GFARM_ERR_NO_SUCH_OBJECT)
 			break;
 	}
+	if (ents != &ent)
+		free(ents);
 	return (NULL);
 }
 
@@ -1285,7 +1589,7 @@ db_inode_load(void *closure, void (*callback)(void *, struct gfs_stat *))
 	static const char diag[] = "db_inode_load";
 
 	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
-	e = ((*ops->inode_load)(closure, callback));
+	e = ((*db_load_ops()->inode_load)(closure, callback));
 	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
 	return (e);
 }
@@ -1384,7 +1688,7 @@ db_inode_cksum_load(void *closure,
 	static const char diag[] = "db_inode_cksum_load";
 
 	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
-	e = ((*ops->inode_cksum_load)(closure, callback));
+	e = ((*db_load_ops()->inode_cksum_load)(closure, callback));
 	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
 	return (e);
 }
@@ -1471,7 +1775,7 @@ db_filecopy_load(void *closure,
 	static const char diag[] = "db_filecopy_load";
 
 	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
-	e = ((*ops->filecopy_load)(closure, callback));
+	e = ((*db_load_ops()->filecopy_load)(closure, callback));
 	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
 	return (e);
 }
@@ -1643,7 +1947,7 @@ db_direntry_load(void *closure,
 	static const char diag[] = "db_direntry_load";
 
 	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
-	e = ((*ops->direntry_load)(closure, callback));
+	e = ((*db_load_ops()->direntry_load)(closure, callback));
 	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
 	return (e);
 }
@@ -1709,7 +2013,7 @@ db_symlink_load(void *closure, void (*callback)(void *, gfarm_ino_t, char *))
 	static const char diag[] = "db_symlink_load";
 
 	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
-	e = ((*ops->symlink_load)(closure, callback));
+	e = ((*db_load_ops()->symlink_load)(closure, callback));
 	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
 	return (e);
 }
@@ -1876,7 +2180,7 @@ db_xattr_load(void *closure,
 	static const char diag[] = "db_xattr_load";
 
 	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
-	e = ((*ops->xattr_load)(closure, callback));
+	e = ((*db_load_ops()->xattr_load)(closure, callback));
 	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
 	return (e);
 }
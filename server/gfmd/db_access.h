@@ -7,6 +7,7 @@
 gfarm_error_t db_initialize(void);
 gfarm_error_t db_terminate(void);
 void *db_thread(void *);
+void db_thread_info(void);
 int db_getfreenum(void);
 
 gfarm_error_t db_begin(const char *);
@@ -210,6 +211,7 @@ struct db_quota_remove_arg *db_quota_remove_arg_alloc(const char *, int);
 
 struct db_ops;
 gfarm_error_t db_use(const struct db_ops *);
+void db_use_for_load(const struct db_ops *);
 
 extern const struct db_ops db_none_ops, db_ldap_ops, db_pgsql_ops;
 extern const struct db_ops *store_ops;
@@ -23,6 +23,7 @@
 #include "queue.h"
 #include "gfutil.h"
 #include "thrsubr.h"
+#include "nanosec.h"
 #ifdef DEBUG_JOURNAL
 #include "timer.h"
 #endif
@@ -263,6 +264,15 @@ db_journal_set_sync_op(gfarm_error_t (*func)(gfarm_uint64_t))
 gfarm_error_t
 db_journal_terminate(void)
 {
+	gfarm_uint64_t nsyncs, nrecords;
+
+	db_journal_group_commit_stats(&nsyncs, &nrecords);
+	if (nsyncs > 0)
+		gflog_info(GFARM_MSG_1005681,
+		    "journal group commit: %llu transactions "
+		    "by %llu syncs (%.2f transactions per sync)",
+		    (unsigned long long)nrecords, (unsigned long long)nsyncs,
+		    (double)nrecords / nsyncs);
 	store_ops->terminate();
 	journal_file_close(self_jf);
 	return (GFARM_ERR_NO_ERROR);
@@ -622,6 +632,234 @@ db_journal_file_writer_sync(void)
 	return (journal_file_writer_sync(journal_file_writer(self_jf)));
 }
 
+/*
+ * group commit of the journal file.
+ *
+ * instead of calling fdatasync(2) for each transaction under giant_lock,
+ * db_journal_group_commit_request() only records the seqnum of the
+ * transaction, and a dedicated thread calls fdatasync(2) once for all
+ * transactions which have been written since the previous call.
+ *
+ * the giant_lock is released before the sync, thus other threads may
+ * see the result of a transaction which isn't durable yet.
+ * so, not only the reply of the RPC which has written the transaction,
+ * but every reply and every request which gfmd sends to others must
+ * wait in db_journal_group_commit_wait() until all transactions
+ * committed before, i.e. up to db_journal_group_commit_seqnum(),
+ * become durable.  a crash before the sync never loses a transaction
+ * whose effect has been seen outside of gfmd.
+ * nothing is waited for, if all transactions are already synced.
+ */
+static struct db_journal_group_commit {
+	int enabled; /* set only at initialization */
+	pthread_mutex_t mutex;
+	pthread_cond_t request_cond, synced_cond;
+
+	gfarm_uint64_t requested_seqnum, synced_seqnum;
+	gfarm_uint64_t requested_bytes, synced_bytes;
+	int pending_records;
+
+	/* statistics */
+	gfarm_uint64_t nsyncs, nrecords;
+} journal_group_commit;
+
+static const char GROUP_COMMIT_MUTEX_DIAG[] = "journal_group_commit_mutex";
+static const char GROUP_COMMIT_REQUEST_COND_DIAG[] =
+	"journal_group_commit_request_cond";
+static const char GROUP_COMMIT_SYNCED_COND_DIAG[] =
+	"journal_group_commit_synced_cond";
+
+static int
+db_journal_group_commit_batch_is_full(struct db_journal_group_commit *gc)
+{
+	return (gc->requested_bytes - gc->synced_bytes >=
+	    gfarm_get_journal_sync_max_batch_size());
+}
+
+/* this is a variable, so that a regression test can stop the sync */
+static gfarm_error_t (*db_journal_group_commit_sync_op)(void) =
+	db_journal_file_writer_sync;
+
+static void *
+db_journal_group_commit_thread(void *arg)
+{
+	struct db_journal_group_commit *gc = &journal_group_commit;
+	gfarm_error_t e;
+	gfarm_uint64_t seqnum, bytes;
+	int nrecords, delay = gfarm_get_journal_sync_max_delay();
+	struct timespec deadline;
+	static const char diag[] = "db_journal_group_commit_thread";
+
+	gfarm_mutex_lock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	for (;;) {
+		while (gc->requested_seqnum == gc->synced_seqnum)
+			gfarm_cond_wait(&gc->request_cond, &gc->mutex,
+			    diag, GROUP_COMMIT_REQUEST_COND_DIAG);
+		if (delay > 0) {
+			/* wait for more transactions to join this batch */
+			gfarm_gettime(&deadline);
+			deadline.tv_sec += delay / 1000000;
+			deadline.tv_nsec +=
+			    (delay % 1000000) * GFARM_MICROSEC_BY_NANOSEC;
+			if (deadline.tv_nsec >= GFARM_SECOND_BY_NANOSEC) {
+				deadline.tv_sec++;
+				deadline.tv_nsec -= GFARM_SECOND_BY_NANOSEC;
+			}
+			while (!db_journal_group_commit_batch_is_full(gc) &&
+			    gfarm_cond_timedwait(&gc->request_cond, &gc->mutex,
+			    &deadline, diag, GROUP_COMMIT_REQUEST_COND_DIAG))
+				;
+		}
+		seqnum = gc->requested_seqnum;
+		bytes = gc->requested_bytes;
+		nrecords = gc->pending_records;
+		gc->pending_records = 0;
+		gfarm_mutex_unlock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+
+		e = db_journal_group_commit_sync_op();
+		if (e != GFARM_ERR_NO_ERROR)
+			gflog_fatal(GFARM_MSG_1005678,
+			    "failed to sync the journal file: %s",
+			    gfarm_error_string(e));
+		if (nrecords > 1)
+			gflog_debug(GFARM_MSG_1005679,
+			    "journal group commit: %d transactions "
+			    "up to seqnum %llu by one sync",
+			    nrecords, (unsigned long long)seqnum);
+
+		gfarm_mutex_lock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+		gc->synced_seqnum = seqnum;
+		gc->synced_bytes = bytes;
+		gc->nsyncs++;
+		gc->nrecords += nrecords;
+		gfarm_cond_broadcast(&gc->synced_cond, diag,
+		    GROUP_COMMIT_SYNCED_COND_DIAG);
+	}
+	/*NOTREACHED*/
+	return (NULL);
+}
+
+void
+db_journal_group_commit_init(void)
+{
+	struct db_journal_group_commit *gc = &journal_group_commit;
+	gfarm_error_t e;
+	static const char diag[] = "db_journal_group_commit_init";
+
+	gfarm_mutex_init(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	gfarm_cond_init(&gc->request_cond, diag,
+	    GROUP_COMMIT_REQUEST_COND_DIAG);
+	gfarm_cond_init(&gc->synced_cond, diag,
+	    GROUP_COMMIT_SYNCED_COND_DIAG);
+	gc->requested_seqnum = gc->synced_seqnum = 0;
+	gc->requested_bytes = gc->synced_bytes =
+	    journal_file_writer_written(journal_file_writer(self_jf));
+	gc->pending_records = 0;
+	gc->nsyncs = gc->nrecords = 0;
+	gc->enabled = 1;
+
+	e = create_detached_thread(db_journal_group_commit_thread, NULL);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_fatal(GFARM_MSG_1005680,
+		    "create_detached_thread(%s): %s",
+		    diag, gfarm_error_string(e));
+}
+
+/*
+ * PREREQUISITE: giant_lock
+ * the transaction `seqnum' has been written to the journal file,
+ * and will be synced by db_journal_group_commit_thread().
+ */
+void
+db_journal_group_commit_request(gfarm_uint64_t seqnum)
+{
+	struct db_journal_group_commit *gc = &journal_group_commit;
+	static const char diag[] = "db_journal_group_commit_request";
+
+	gfarm_mutex_lock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	gc->requested_seqnum = seqnum;
+	gc->requested_bytes =
+	    journal_file_writer_written(journal_file_writer(self_jf));
+	gc->pending_records++;
+	gfarm_cond_signal(&gc->request_cond, diag,
+	    GROUP_COMMIT_REQUEST_COND_DIAG);
+	gfarm_mutex_unlock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+}
+
+/*
+ * returns the seqnum of the last committed transaction,
+ * whose result may be already seen by any thread,
+ * or 0 if all transactions are already synced.
+ */
+gfarm_uint64_t
+db_journal_group_commit_seqnum(void)
+{
+	struct db_journal_group_commit *gc = &journal_group_commit;
+	gfarm_uint64_t seqnum;
+	static const char diag[] = "db_journal_group_commit_seqnum";
+
+	if (!gc->enabled)
+		return (0);
+	gfarm_mutex_lock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	seqnum = gc->requested_seqnum == gc->synced_seqnum ?
+	    0 : gc->requested_seqnum;
+	gfarm_mutex_unlock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	return (seqnum);
+}
+
+/*
+ * PREREQUISITE: nothing (giant_lock shouldn't be held)
+ * wait until the transaction `seqnum' becomes durable.
+ * 0 means that there is nothing to wait for.
+ */
+void
+db_journal_group_commit_wait(gfarm_uint64_t seqnum)
+{
+	struct db_journal_group_commit *gc = &journal_group_commit;
+	static const char diag[] = "db_journal_group_commit_wait";
+
+	if (!gc->enabled || seqnum == 0)
+		return;
+	gfarm_mutex_lock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	while (gc->synced_seqnum < seqnum)
+		gfarm_cond_wait(&gc->synced_cond, &gc->mutex,
+		    diag, GROUP_COMMIT_SYNCED_COND_DIAG);
+	gfarm_mutex_unlock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+}
+
+/* number of syncs, and number of transactions made durable by them */
+void
+db_journal_group_commit_stats(gfarm_uint64_t *nsyncsp,
+	gfarm_uint64_t *nrecordsp)
+{
+	struct db_journal_group_commit *gc = &journal_group_commit;
+	static const char diag[] = "db_journal_group_commit_stats";
+
+	if (!gc->enabled) {
+		*nsyncsp = *nrecordsp = 0;
+		return;
+	}
+	gfarm_mutex_lock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+	*nsyncsp = gc->nsyncs;
+	*nrecordsp = gc->nrecords;
+	gfarm_mutex_unlock(&gc->mutex, diag, GROUP_COMMIT_MUTEX_DIAG);
+}
+
+void
+db_journal_group_commit_info(void)
+{
+	gfarm_uint64_t nsyncs, nrecords;
+
+	if (!journal_group_commit.enabled)
+		return;
+	db_journal_group_commit_stats(&nsyncs, &nrecords);
+	gflog_info(GFARM_MSG_1005815,
+	    "journal group commit: %llu transactions by %llu syncs "
+	    "(%.2f transactions per sync)",
+	    (unsigned long long)nrecords, (unsigned long long)nsyncs,
+	    nsyncs == 0 ? 0.0 : (double)nrecords / nsyncs);
+}
+
 static gfarm_error_t
 db_journal_write_string_size_add(enum journal_operation ope,
 	size_t *sizep, void *arg)
@@ -4403,6 +4641,62 @@ db_journal_reader_reopen_if_needed(const char *label,
 		last_fetch_seqnum, initedp));
 }
 
+struct db_journal_replay_closure {
+	gfarm_uint64_t from_seqnum, last_seqnum, napplied;
+	int (*filter)(enum journal_operation);
+};
+
+static gfarm_error_t
+db_journal_replay_op(void *op_arg, gfarm_uint64_t seqnum,
+	enum journal_operation ope, void *obj, void *closure, size_t length,
+	int *needs_freep)
+{
+	struct db_journal_replay_closure *c = closure;
+
+	*needs_freep = 1;
+	c->last_seqnum = seqnum;
+	if (seqnum <= c->from_seqnum || !(*c->filter)(ope))
+		return (GFARM_ERR_NO_ERROR);
+	c->napplied++;
+	return (db_journal_ops_call(journal_apply_ops, seqnum, ope, obj,
+	    "db_journal_replay"));
+}
+
+/*
+ * apply journal records in (from_seqnum, to_seqnum] to the in-memory
+ * metadata.  records which are rejected by `filter' are skipped.
+ *
+ * PREREQUISITE: giant_lock
+ */
+gfarm_error_t
+db_journal_replay(struct journal_file_reader *reader,
+	gfarm_uint64_t from_seqnum, gfarm_uint64_t to_seqnum,
+	int (*filter)(enum journal_operation), gfarm_uint64_t *nappliedp)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	int eof = 0;
+	struct db_journal_replay_closure c;
+
+	c.from_seqnum = c.last_seqnum = from_seqnum;
+	c.napplied = 0;
+	c.filter = filter;
+	while (c.last_seqnum < to_seqnum && !eof) {
+		if ((e = db_journal_read(reader, NULL, db_journal_replay_op,
+		    &c, &eof)) != GFARM_ERR_NO_ERROR)
+			break;
+	}
+	if (e == GFARM_ERR_NO_ERROR && c.last_seqnum < to_seqnum) {
+		e = GFARM_ERR_EXPIRED;
+		gflog_error(GFARM_MSG_1005717,
+		    "db_journal_replay: journal ends at seqnum %llu, "
+		    "expected %llu",
+		    (unsigned long long)c.last_seqnum,
+		    (unsigned long long)to_seqnum);
+	}
+	*nappliedp = c.napplied;
+	return (e);
+}
+
 struct db_journal_fetch_info {
 	struct db_journal_fetch_info *next;
 	char *rec;
@@ -4426,11 +4720,11 @@ db_journal_fetch_info_list_free(struct db_journal_fetch_info *fi_list)
 
 gfarm_error_t
 db_journal_fetch(struct journal_file_reader *reader,
-	gfarm_uint64_t min_seqnum, char **datap, int *lenp,
+	gfarm_uint64_t min_seqnum, size_t size_threshold,
+	char **datap, int *lenp,
 	gfarm_uint64_t *from_seqnump, gfarm_uint64_t *to_seqnump,
 	int *no_recp, const char *diag)
 {
-#define FETCH_SIZE_THRESHOLD 8000
 	gfarm_error_t e;
 	gfarm_uint64_t cur_seqnum, seqnum;
 	char *rec, *recs, *p;
@@ -4507,7 +4801,7 @@ db_journal_fetch(struct journal_file_reader *reader,
 			fi0 = fi;
 			all_len += rec_len;
 			++num_fi;
-			if (all_len >= FETCH_SIZE_THRESHOLD)
+			if (all_len >= size_threshold)
 				break;
 		}
 	}
@@ -4863,6 +5157,8 @@ struct db_ops db_journal_ops = {
 
 	db_journal_write_begin,
 	db_journal_write_end,
+	NULL,
+	NULL,
 
 	db_journal_write_host_add,
 	db_journal_write_host_modify,
@@ -19,14 +19,23 @@ gfarm_error_t db_journal_read(struct journal_file_reader *, void *,
 void db_journal_wait_for_apply_thread(void);
 gfarm_error_t db_journal_reader_reopen_if_needed(const char *,
 	struct journal_file_reader **, gfarm_uint64_t, int *);
+gfarm_error_t db_journal_replay(struct journal_file_reader *,
+	gfarm_uint64_t, gfarm_uint64_t, int (*)(enum journal_operation),
+	gfarm_uint64_t *);
 gfarm_error_t db_journal_fetch(struct journal_file_reader *, gfarm_uint64_t,
-	char **, int *, gfarm_uint64_t *, gfarm_uint64_t *, int *,
+	size_t, char **, int *, gfarm_uint64_t *, gfarm_uint64_t *, int *,
 	const char *);
 gfarm_error_t db_journal_recvq_enter(gfarm_uint64_t, gfarm_uint64_t, int,
 	unsigned char *);
 void db_journal_cancel_recvq();
 void db_journal_set_sync_op(gfarm_error_t (*func)(gfarm_uint64_t));
 gfarm_error_t db_journal_file_writer_sync(void);
+void db_journal_group_commit_init(void);
+void db_journal_group_commit_request(gfarm_uint64_t);
+gfarm_uint64_t db_journal_group_commit_seqnum(void);
+void db_journal_group_commit_wait(gfarm_uint64_t);
+void db_journal_group_commit_stats(gfarm_uint64_t *, gfarm_uint64_t *);
+void db_journal_group_commit_info(void);
 void db_journal_wait_until_readable(void);
 
 void *db_journal_store_thread(void *);
@@ -988,6 +988,8 @@ const struct db_ops db_journal_apply_ops = {
 
 	db_journal_apply_begin,
 	db_journal_apply_end,
+	NULL,
+	NULL,
 
 	db_journal_apply_host_add,
 	db_journal_apply_host_modify,
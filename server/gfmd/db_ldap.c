@@ -3429,6 +3429,8 @@ const struct db_ops db_ldap_ops = {
 
 	gfarm_ldap_nop,
 	gfarm_ldap_nop,
+	NULL,
+	NULL,
 
 	gfarm_ldap_host_add,
 	gfarm_ldap_host_modify,
@@ -612,6 +612,8 @@ const struct db_ops db_none_ops = {
 
 	gfarm_none_nop,
 	gfarm_none_nop,
+	NULL,
+	NULL,
 
 	gfarm_none_host_add,
 	gfarm_none_host_modify,
@@ -172,6 +172,9 @@ struct db_ops {
 
 	gfarm_error_t (*begin)(gfarm_uint64_t, void *);
 	gfarm_error_t (*end)(gfarm_uint64_t, void *);
+	/* optional: run several dbq entries in one backend transaction */
+	gfarm_error_t (*batch_begin)(int);
+	gfarm_error_t (*batch_end)(int);
 
 	gfarm_error_t (*host_add)(gfarm_uint64_t, struct gfarm_host_info *);
 	gfarm_error_t (*host_modify)(gfarm_uint64_t,
@@ -102,6 +102,7 @@ typedef gfarm_error_t (*gfarm_pgsql_dml_t)(
 	const int *, const int *, int, const char *);
 
 static gfarm_error_t gfarm_pgsql_seqnum_modify(struct db_seqnum_arg *);
+static int pgsql_batch_defer_free(void *);
 
 /**********************************************************************/
 
@@ -127,8 +128,12 @@ free_arg(void *arg)
 	 *   of db_pgsql_ops and freed in db_journal_ops_free() called from
 	 *   db_journal_free_rec_list().
 	 *
+	 * - While db_thread() runs a batch of dbq entries, 'arg' is kept
+	 *   until gfarm_pgsql_batch_end(), so that the entries can be
+	 *   executed again one by one, if the batch transaction fails.
 	 */
-	if (!gfarm_get_metadb_replication_enabled())
+	if (!gfarm_get_metadb_replication_enabled() &&
+	    !pgsql_batch_defer_free(arg))
 		free(arg);
 }
 
@@ -138,6 +143,12 @@ static int transaction_postponed = 0;
 static int transaction_ok;
 static int connection_recovered = 0;
 
+/* for gfarm_pgsql_batch_begin() and gfarm_pgsql_batch_end() */
+static int batch_active = 0;
+static int batch_args_lost = 0;
+static int batch_nargs = 0, batch_args_size = 0;
+static void **batch_args = NULL;
+
 /* XXX FIXME - workaround for SourceForge #549 */
 static int invalid_XML_value = 0;
 
@@ -1348,6 +1359,11 @@ gfarm_pgsql_generic_load(
 static gfarm_error_t
 gfarm_pgsql_begin(gfarm_uint64_t seqnum, void *arg)
 {
+	if (batch_active) {
+		/* already in the transaction of gfarm_pgsql_batch_begin() */
+		transaction_nesting++;
+		return (GFARM_ERR_NO_ERROR);
+	}
 	assert(transaction_nesting == 0);
 	transaction_nesting++;
 	/*
@@ -1366,7 +1382,86 @@ gfarm_pgsql_end(gfarm_uint64_t seqnum, void *arg)
 	gfarm_error_t e = gfarm_pgsql_commit_sn(seqnum,
 	    transaction_ok ? "gfarm_pgsql_end(OK)" : "gfarm_pgsql_end(NG)");
 
-	assert(transaction_nesting == 0);
+	assert(transaction_nesting == (batch_active ? 1 : 0));
+	return (e);
+}
+
+static int
+pgsql_batch_defer_free(void *arg)
+{
+	if (!batch_active)
+		return (0);
+	if (batch_nargs >= batch_args_size) {
+		/* shouldn't happen, see gfarm_pgsql_batch_begin() */
+		batch_args_lost = 1;
+		return (0);
+	}
+	batch_args[batch_nargs++] = arg;
+	return (1);
+}
+
+/*
+ * run the following dbq entries in one transaction.
+ * each of `nentries' entries must call free_arg() at most once.
+ */
+static gfarm_error_t
+gfarm_pgsql_batch_begin(int nentries)
+{
+	gfarm_error_t e;
+	void **args;
+
+	assert(transaction_nesting == 0 && !batch_active);
+	if (nentries > batch_args_size) {
+		GFARM_REALLOC_ARRAY(args, batch_args, nentries);
+		if (args == NULL)
+			return (GFARM_ERR_NO_MEMORY);
+		batch_args = args;
+		batch_args_size = nentries;
+	}
+	if ((e = gfarm_pgsql_start("gfarm_pgsql_batch_begin"))
+	    != GFARM_ERR_NO_ERROR) {
+		transaction_nesting = 0;
+		return (e);
+	}
+	batch_active = 1;
+	batch_args_lost = 0;
+	batch_nargs = 0;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * if this returns an error other than GFARM_ERR_NO_MEMORY,
+ * nothing in the batch is stored, and the arguments of the entries are
+ * still available to execute the entries again.
+ * GFARM_ERR_NO_MEMORY means that some of the arguments have been lost.
+ */
+static gfarm_error_t
+gfarm_pgsql_batch_end(int commit)
+{
+	gfarm_error_t e;
+	int i;
+	static const char diag[] = "gfarm_pgsql_batch_end";
+
+	assert(batch_active);
+	if (commit && transaction_ok && !connection_recovered &&
+	    PQtransactionStatus(conn) == PQTRANS_INTRANS)
+		e = gfarm_pgsql_exec_and_log("COMMIT", diag);
+	else {
+		(void)gfarm_pgsql_exec_and_log("ROLLBACK", diag);
+		e = GFARM_ERR_DB_ACCESS_SHOULD_BE_RETRIED;
+	}
+	transaction_nesting = 0;
+	transaction_postponed = 0;
+	connection_recovered = 0;
+	batch_active = 0;
+
+	if (e == GFARM_ERR_NO_ERROR || batch_args_lost) {
+		for (i = 0; i < batch_nargs; i++)
+			free(batch_args[i]);
+		if (e != GFARM_ERR_NO_ERROR)
+			e = GFARM_ERR_NO_MEMORY;
+	}
+	batch_nargs = 0;
 	return (e);
 }
 
@@ -4407,6 +4502,8 @@ const struct db_ops db_pgsql_ops = {
 
 	gfarm_pgsql_begin,
 	gfarm_pgsql_end,
+	gfarm_pgsql_batch_begin,
+	gfarm_pgsql_batch_end,
 
 	gfarm_pgsql_host_add,
 	gfarm_pgsql_host_modify,
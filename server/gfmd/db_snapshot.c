@@ -0,0 +1,1238 @@
+/*
+ * $Id$
+ */
+
+/*
+ * binary snapshot image of the filesystem metadata.
+ *
+ * Loading millions of inodes, directory entries, replicas and xattrs
+ * from the backend DB row by row dominates the startup time of gfmd.
+ * The master gfmd periodically dumps these tables from memory into
+ * a flat file, and the next startup loads them from that file,
+ * then replays the journal records which are newer than the snapshot.
+ *
+ * The image consists of a fixed-size header followed by segments.
+ * Each segment holds records of one table and has its own CRC,
+ * so that the segments can be verified in parallel.
+ * All integers are stored in big endian.
+ *
+ *	header:
+ *		magic "GfMs", version, seqnum, number of segments,
+ *		file size, CRC of the header
+ *	segment:
+ *		section, number of records, payload length,
+ *		CRC of the payload, payload
+ *	the last segment is DB_SNAPSHOT_SECTION_END without payload.
+ *
+ * The header is written at last, thus a partially written image
+ * is never accepted.
+ */
+
+#include <pthread.h>
+#include <stdio.h> /* rename */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "thrsubr.h"
+
+#include "config.h"
+#include "crc32.h"
+#include "xattr_info.h"
+#include "quota_info.h"
+#include "metadb_server.h"
+
+#include "subr.h"
+#include "quota.h"
+#include "db_access.h"
+#include "db_ops.h"
+#include "journal_file.h"
+#include "db_journal.h"
+#include "db_snapshot.h"
+#include "inode.h"
+#include "mdhost.h"
+
+#define DB_SNAPSHOT_MAGIC		"GfMs"
+#define DB_SNAPSHOT_VERSION		1
+#define DB_SNAPSHOT_HEADER_SIZE		64
+#define DB_SNAPSHOT_SEGMENT_HEADER_SIZE	16
+#define DB_SNAPSHOT_SEGMENT_SIZE	(1024 * 1024)	/* 1MB */
+/*
+ * a segment is flushed when it reaches DB_SNAPSHOT_SEGMENT_SIZE,
+ * and a record is smaller than DB_SNAPSHOT_SEGMENT_SIZE,
+ * since an xattr value is limited by GFARM_XATTR_SIZE_MAX_LIMIT.
+ */
+#define DB_SNAPSHOT_WRITER_BUFSIZE	(2 * DB_SNAPSHOT_SEGMENT_SIZE)
+#define DB_SNAPSHOT_VERIFY_THREADS_MAX	8
+
+enum db_snapshot_section {
+	DB_SNAPSHOT_SECTION_END,
+	DB_SNAPSHOT_SECTION_INODE,
+	DB_SNAPSHOT_SECTION_INODE_CKSUM,
+	DB_SNAPSHOT_SECTION_FILECOPY,
+	DB_SNAPSHOT_SECTION_DIRENTRY,
+	DB_SNAPSHOT_SECTION_SYMLINK,
+	DB_SNAPSHOT_SECTION_XATTR,
+	DB_SNAPSHOT_SECTION_XMLATTR,
+	DB_SNAPSHOT_SECTION_MAX
+};
+
+static const char *db_snapshot_section_names[] = {
+	"end",
+	"inode",
+	"inode_cksum",
+	"filecopy",
+	"direntry",
+	"symlink",
+	"xattr",
+	"xmlattr",
+};
+
+static int
+db_snapshot_is_enabled(void)
+{
+	return (gfarm_get_metadb_snapshot_file() != NULL &&
+	    gfarm_get_metadb_replication_enabled() &&
+	    gfarm_backend_db_type != GFARM_BACKEND_DB_TYPE_NONE);
+}
+
+static void
+db_snapshot_encode_uint32(unsigned char *p, gfarm_uint32_t n)
+{
+	p[0] = n >> 24;
+	p[1] = n >> 16;
+	p[2] = n >> 8;
+	p[3] = n;
+}
+
+static void
+db_snapshot_encode_uint64(unsigned char *p, gfarm_uint64_t n)
+{
+	db_snapshot_encode_uint32(p, n >> 32);
+	db_snapshot_encode_uint32(p + 4, n);
+}
+
+static gfarm_uint32_t
+db_snapshot_decode_uint32(const unsigned char *p)
+{
+	return (((gfarm_uint32_t)p[0] << 24) | ((gfarm_uint32_t)p[1] << 16) |
+	    ((gfarm_uint32_t)p[2] << 8) | (gfarm_uint32_t)p[3]);
+}
+
+static gfarm_uint64_t
+db_snapshot_decode_uint64(const unsigned char *p)
+{
+	return (((gfarm_uint64_t)db_snapshot_decode_uint32(p) << 32) |
+	    db_snapshot_decode_uint32(p + 4));
+}
+
+/**********************************************************************/
+/* writer */
+
+/*
+ * the writer may run in a forked child of gfmd,
+ * so it must not call gflog, take any mutex, or allocate memory.
+ * the buffer is allocated by the parent, and never grows.
+ */
+struct db_snapshot_writer {
+	int fd;
+	gfarm_error_t error;
+
+	enum db_snapshot_section section;
+	gfarm_uint32_t nrecords;
+	unsigned char *buf; /* segment header + payload */
+	size_t len, size;
+
+	gfarm_uint64_t nsegments, offset;
+};
+
+static gfarm_error_t
+db_snapshot_write_all(int fd, const void *buf, size_t len, off_t offset)
+{
+	const char *p = buf;
+	ssize_t rv;
+
+	while (len > 0) {
+		if ((rv = pwrite(fd, p, len, offset)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return (gfarm_errno_to_error(errno));
+		}
+		p += rv;
+		len -= rv;
+		offset += rv;
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+db_snapshot_writer_flush(struct db_snapshot_writer *w)
+{
+	size_t payload = w->len - DB_SNAPSHOT_SEGMENT_HEADER_SIZE;
+
+	db_snapshot_encode_uint32(w->buf, w->section);
+	db_snapshot_encode_uint32(w->buf + 4, w->nrecords);
+	db_snapshot_encode_uint32(w->buf + 8, payload);
+	db_snapshot_encode_uint32(w->buf + 12, gfarm_crc32(0,
+	    w->buf + DB_SNAPSHOT_SEGMENT_HEADER_SIZE, payload));
+	if ((w->error = db_snapshot_write_all(w->fd, w->buf, w->len,
+	    w->offset)) != GFARM_ERR_NO_ERROR)
+		return (w->error);
+	w->offset += w->len;
+	w->nsegments++;
+	w->nrecords = 0;
+	w->len = DB_SNAPSHOT_SEGMENT_HEADER_SIZE;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static unsigned char *
+db_snapshot_writer_reserve(struct db_snapshot_writer *w, size_t len)
+{
+	unsigned char *buf;
+
+	if (w->error != GFARM_ERR_NO_ERROR)
+		return (NULL);
+	if (len > w->size - w->len) {
+		w->error = GFARM_ERR_RESULT_OUT_OF_RANGE;
+		return (NULL);
+	}
+	buf = w->buf + w->len;
+	w->len += len;
+	return (buf);
+}
+
+static void
+db_snapshot_put_uint32(struct db_snapshot_writer *w, gfarm_uint32_t n)
+{
+	unsigned char *p = db_snapshot_writer_reserve(w, sizeof(n));
+
+	if (p != NULL)
+		db_snapshot_encode_uint32(p, n);
+}
+
+static void
+db_snapshot_put_uint64(struct db_snapshot_writer *w, gfarm_uint64_t n)
+{
+	unsigned char *p = db_snapshot_writer_reserve(w, sizeof(n));
+
+	if (p != NULL)
+		db_snapshot_encode_uint64(p, n);
+}
+
+static void
+db_snapshot_put_bytes(struct db_snapshot_writer *w, const void *s, size_t len)
+{
+	unsigned char *p;
+
+	db_snapshot_put_uint32(w, len);
+	if ((p = db_snapshot_writer_reserve(w, len)) != NULL)
+		memcpy(p, s, len);
+}
+
+static void
+db_snapshot_put_string(struct db_snapshot_writer *w, const char *s)
+{
+	db_snapshot_put_bytes(w, s, strlen(s));
+}
+
+static void
+db_snapshot_put_timespec(struct db_snapshot_writer *w,
+	const struct gfarm_timespec *ts)
+{
+	db_snapshot_put_uint64(w, ts->tv_sec);
+	db_snapshot_put_uint32(w, ts->tv_nsec);
+}
+
+static void
+db_snapshot_record_begin(struct db_snapshot_writer *w,
+	enum db_snapshot_section section)
+{
+	if (w->section != section && w->nrecords > 0)
+		(void)db_snapshot_writer_flush(w);
+	w->section = section;
+}
+
+static gfarm_error_t
+db_snapshot_record_end(struct db_snapshot_writer *w)
+{
+	if (w->error != GFARM_ERR_NO_ERROR)
+		return (w->error);
+	w->nrecords++;
+	if (w->len >= DB_SNAPSHOT_SEGMENT_SIZE)
+		return (db_snapshot_writer_flush(w));
+	return (GFARM_ERR_NO_ERROR);
+}
+
+gfarm_error_t
+db_snapshot_put_inode(struct db_snapshot_writer *w, struct gfs_stat *st)
+{
+	db_snapshot_record_begin(w, DB_SNAPSHOT_SECTION_INODE);
+	db_snapshot_put_uint64(w, st->st_ino);
+	db_snapshot_put_uint64(w, st->st_gen);
+	db_snapshot_put_uint32(w, st->st_mode);
+	db_snapshot_put_uint64(w, st->st_nlink);
+	db_snapshot_put_string(w, st->st_user);
+	db_snapshot_put_string(w, st->st_group);
+	db_snapshot_put_uint64(w, st->st_size);
+	db_snapshot_put_timespec(w, &st->st_atimespec);
+	db_snapshot_put_timespec(w, &st->st_mtimespec);
+	db_snapshot_put_timespec(w, &st->st_ctimespec);
+	return (db_snapshot_record_end(w));
+}
+
+gfarm_error_t
+db_snapshot_put_inode_cksum(struct db_snapshot_writer *w,
+	gfarm_ino_t inum, const char *type, size_t len, const char *sum)
+{
+	db_snapshot_record_begin(w, DB_SNAPSHOT_SECTION_INODE_CKSUM);
+	db_snapshot_put_uint64(w, inum);
+	db_snapshot_put_string(w, type);
+	db_snapshot_put_bytes(w, sum, len);
+	return (db_snapshot_record_end(w));
+}
+
+gfarm_error_t
+db_snapshot_put_filecopy(struct db_snapshot_writer *w,
+	gfarm_ino_t inum, const char *hostname)
+{
+	db_snapshot_record_begin(w, DB_SNAPSHOT_SECTION_FILECOPY);
+	db_snapshot_put_uint64(w, inum);
+	db_snapshot_put_string(w, hostname);
+	return (db_snapshot_record_end(w));
+}
+
+gfarm_error_t
+db_snapshot_put_direntry(struct db_snapshot_writer *w,
+	gfarm_ino_t dir_inum, const char *name, int namelen,
+	gfarm_ino_t entry_inum)
+{
+	db_snapshot_record_begin(w, DB_SNAPSHOT_SECTION_DIRENTRY);
+	db_snapshot_put_uint64(w, dir_inum);
+	db_snapshot_put_bytes(w, name, namelen);
+	db_snapshot_put_uint64(w, entry_inum);
+	return (db_snapshot_record_end(w));
+}
+
+gfarm_error_t
+db_snapshot_put_symlink(struct db_snapshot_writer *w,
+	gfarm_ino_t inum, const char *source_path)
+{
+	db_snapshot_record_begin(w, DB_SNAPSHOT_SECTION_SYMLINK);
+	db_snapshot_put_uint64(w, inum);
+	db_snapshot_put_string(w, source_path);
+	return (db_snapshot_record_end(w));
+}
+
+/* `value' is NULL, if the value is not cached in memory */
+gfarm_error_t
+db_snapshot_put_xattr(struct db_snapshot_writer *w, int xmlMode,
+	gfarm_ino_t inum, const char *attrname, const void *value, int size)
+{
+	db_snapshot_record_begin(w, xmlMode ?
+	    DB_SNAPSHOT_SECTION_XMLATTR : DB_SNAPSHOT_SECTION_XATTR);
+	db_snapshot_put_uint64(w, inum);
+	db_snapshot_put_string(w, attrname);
+	if (!xmlMode) {
+		db_snapshot_put_uint32(w, value != NULL);
+		db_snapshot_put_bytes(w, value != NULL ? value : "",
+		    value != NULL ? size : 0);
+	}
+	return (db_snapshot_record_end(w));
+}
+
+/*
+ * `buf' has to be DB_SNAPSHOT_WRITER_BUFSIZE bytes.
+ *
+ * PREREQUISITE: giant_lock, or running in a forked child.
+ * this function must not call gflog, take any mutex, or allocate memory.
+ */
+static gfarm_error_t
+db_snapshot_write_image(int fd, gfarm_uint64_t seqnum, unsigned char *buf)
+{
+	gfarm_error_t e;
+	struct db_snapshot_writer w;
+	unsigned char header[DB_SNAPSHOT_HEADER_SIZE];
+
+	w.fd = fd;
+	w.error = GFARM_ERR_NO_ERROR;
+	w.section = DB_SNAPSHOT_SECTION_END;
+	w.nrecords = 0;
+	w.buf = buf;
+	w.size = DB_SNAPSHOT_WRITER_BUFSIZE;
+	w.len = DB_SNAPSHOT_SEGMENT_HEADER_SIZE;
+	w.nsegments = 0;
+	w.offset = DB_SNAPSHOT_HEADER_SIZE;
+
+	if ((e = inode_snapshot_write(&w)) == GFARM_ERR_NO_ERROR &&
+	    (w.nrecords == 0 ||
+	     (e = db_snapshot_writer_flush(&w)) == GFARM_ERR_NO_ERROR)) {
+		/* terminator */
+		w.section = DB_SNAPSHOT_SECTION_END;
+		e = db_snapshot_writer_flush(&w);
+	}
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, DB_SNAPSHOT_MAGIC, 4);
+	db_snapshot_encode_uint32(header + 4, DB_SNAPSHOT_VERSION);
+	db_snapshot_encode_uint64(header + 8, seqnum);
+	db_snapshot_encode_uint64(header + 16, w.nsegments);
+	db_snapshot_encode_uint64(header + 24, w.offset);
+	db_snapshot_encode_uint32(header + DB_SNAPSHOT_HEADER_SIZE - 4,
+	    gfarm_crc32(0, header, DB_SNAPSHOT_HEADER_SIZE - 4));
+	if ((e = db_snapshot_write_all(fd, header, sizeof(header), 0))
+	    != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (fsync(fd) == -1)
+		return (gfarm_errno_to_error(errno));
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+db_snapshot_tmp_open(const char *path, char **tmpp, int *fdp)
+{
+	gfarm_error_t e;
+	char *tmp;
+	int fd, save_errno;
+	static const char diag[] = "db_snapshot_tmp_open";
+
+	GFARM_MALLOC_ARRAY(tmp, strlen(path) + sizeof(".tmp"));
+	if (tmp == NULL) {
+		gflog_error(GFARM_MSG_1005718, "%s: %s: no memory",
+		    diag, path);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	strcpy(tmp, path);
+	strcat(tmp, ".tmp");
+	gfarm_privilege_lock(diag);
+	fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+	save_errno = errno;
+	gfarm_privilege_unlock(diag);
+	if (fd == -1) {
+		e = gfarm_errno_to_error(save_errno);
+		gflog_error(GFARM_MSG_1005719, "%s: %s: %s",
+		    diag, tmp, gfarm_error_string(e));
+		free(tmp);
+		return (e);
+	}
+	*tmpp = tmp;
+	*fdp = fd;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+db_snapshot_tmp_close(char *tmp, const char *path, gfarm_error_t e,
+	gfarm_uint64_t seqnum, time_t t)
+{
+	int rv, save_errno;
+	static const char diag[] = "db_snapshot_tmp_close";
+
+	gfarm_privilege_lock(diag);
+	if (e == GFARM_ERR_NO_ERROR) {
+		rv = rename(tmp, path);
+		save_errno = errno;
+		if (rv == -1)
+			e = gfarm_errno_to_error(save_errno);
+	}
+	if (e != GFARM_ERR_NO_ERROR)
+		(void)unlink(tmp);
+	gfarm_privilege_unlock(diag);
+
+	if (e == GFARM_ERR_NO_ERROR)
+		gflog_info(GFARM_MSG_1005720,
+		    "metadata snapshot %s: seqnum=%llu, %lld seconds",
+		    path, (unsigned long long)seqnum,
+		    (long long)(time(NULL) - t));
+	else
+		gflog_error(GFARM_MSG_1005721,
+		    "writing metadata snapshot %s: %s",
+		    path, gfarm_error_string(e));
+	free(tmp);
+	return (e);
+}
+
+/*
+ * write the snapshot in this process.
+ * this blocks every other operation until the image is written,
+ * thus it is only used at shutdown.
+ *
+ * PREREQUISITE: giant_lock
+ */
+gfarm_error_t
+db_snapshot_write(void)
+{
+	gfarm_error_t e;
+	const char *path = gfarm_get_metadb_snapshot_file();
+	char *tmp;
+	unsigned char *buf;
+	int fd;
+	gfarm_uint64_t seqnum;
+	time_t t = time(NULL);
+
+	if (!db_snapshot_is_enabled())
+		return (GFARM_ERR_NO_ERROR);
+	GFARM_MALLOC_ARRAY(buf, DB_SNAPSHOT_WRITER_BUFSIZE);
+	if (buf == NULL) {
+		gflog_error(GFARM_MSG_1005826,
+		    "metadata snapshot: no memory");
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	if ((e = db_snapshot_tmp_open(path, &tmp, &fd))
+	    != GFARM_ERR_NO_ERROR) {
+		free(buf);
+		return (e);
+	}
+	seqnum = db_journal_get_current_seqnum();
+	e = db_snapshot_write_image(fd, seqnum, buf);
+	close(fd);
+	free(buf);
+	return (db_snapshot_tmp_close(tmp, path, e, seqnum, t));
+}
+
+/*
+ * the metadata is copied into a child process by fork(2),
+ * so that the giant lock is only held while forking.
+ * since gfmd is multithreaded, the child may only use async-signal-safe
+ * functions, thus the buffer is allocated before fork(2).
+ */
+static gfarm_error_t
+db_snapshot_write_by_child(void)
+{
+	gfarm_error_t e;
+	const char *path = gfarm_get_metadb_snapshot_file();
+	char *tmp;
+	unsigned char *buf;
+	int fd, status;
+	pid_t pid, rv;
+	gfarm_uint64_t seqnum;
+	time_t t = time(NULL);
+
+	GFARM_MALLOC_ARRAY(buf, DB_SNAPSHOT_WRITER_BUFSIZE);
+	if (buf == NULL) {
+		gflog_error(GFARM_MSG_1005827,
+		    "metadata snapshot: no memory");
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	if ((e = db_snapshot_tmp_open(path, &tmp, &fd))
+	    != GFARM_ERR_NO_ERROR) {
+		free(buf);
+		return (e);
+	}
+
+	giant_lock();
+	seqnum = db_journal_get_current_seqnum();
+	pid = fork();
+	if (pid == 0) { /* child */
+		e = db_snapshot_write_image(fd, seqnum, buf);
+		_exit(e == GFARM_ERR_NO_ERROR ? 0 : 1);
+	}
+	status = errno;
+	giant_unlock();
+	close(fd);
+	free(buf);
+
+	if (pid == -1) {
+		e = gfarm_errno_to_error(status);
+		gflog_error(GFARM_MSG_1005722, "metadata snapshot: fork: %s",
+		    gfarm_error_string(e));
+	} else {
+		while ((rv = waitpid(pid, &status, 0)) == -1 && errno == EINTR)
+			;
+		if (rv == -1) {
+			e = gfarm_errno_to_error(errno);
+			gflog_error(GFARM_MSG_1005723,
+			    "metadata snapshot: waitpid: %s",
+			    gfarm_error_string(e));
+		} else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			e = GFARM_ERR_INPUT_OUTPUT;
+			gflog_error(GFARM_MSG_1005724,
+			    "metadata snapshot: writer process failed, "
+			    "status=0x%x", status);
+		}
+	}
+	return (db_snapshot_tmp_close(tmp, path, e, seqnum, t));
+}
+
+void *
+db_snapshot_thread(void *arg)
+{
+	int interval;
+
+	if (!db_snapshot_is_enabled())
+		return (NULL);
+	for (;;) {
+		config_var_lock();
+		interval = gfarm_get_metadb_snapshot_interval();
+		config_var_unlock();
+		if (interval <= 0) {
+			gflog_info(GFARM_MSG_1005725,
+			    "metadata snapshot: periodic writing is disabled");
+			return (NULL);
+		}
+		gfarm_sleep(interval);
+
+		if (mdhost_self_is_master())
+			(void)db_snapshot_write_by_child();
+	}
+
+	/*NOTREACHED*/
+	return (NULL);
+}
+
+/**********************************************************************/
+/* loader */
+
+struct db_snapshot_segment {
+	enum db_snapshot_section section;
+	gfarm_uint32_t nrecords, crc;
+	const unsigned char *data;
+	size_t len;
+};
+
+static struct db_snapshot {
+	void *map;
+	size_t size;
+	gfarm_uint64_t seqnum, db_seqnum;
+	gfarm_uint64_t nsegments;
+	struct db_snapshot_segment *segments;
+	struct journal_file_reader *reader;
+	time_t load_start;
+} snapshot;
+
+static struct db_ops db_snapshot_load_ops;
+
+struct db_snapshot_decoder {
+	const unsigned char *p, *end;
+	int error;
+};
+
+static const unsigned char *
+db_snapshot_get(struct db_snapshot_decoder *d, size_t len)
+{
+	const unsigned char *p = d->p;
+
+	if (d->error || d->end - d->p < len) {
+		d->error = 1;
+		return (NULL);
+	}
+	d->p += len;
+	return (p);
+}
+
+static gfarm_uint32_t
+db_snapshot_get_uint32(struct db_snapshot_decoder *d)
+{
+	const unsigned char *p = db_snapshot_get(d, sizeof(gfarm_uint32_t));
+
+	return (p == NULL ? 0 : db_snapshot_decode_uint32(p));
+}
+
+static gfarm_uint64_t
+db_snapshot_get_uint64(struct db_snapshot_decoder *d)
+{
+	const unsigned char *p = db_snapshot_get(d, sizeof(gfarm_uint64_t));
+
+	return (p == NULL ? 0 : db_snapshot_decode_uint64(p));
+}
+
+static const unsigned char *
+db_snapshot_get_bytes(struct db_snapshot_decoder *d, size_t *lenp)
+{
+	*lenp = db_snapshot_get_uint32(d);
+	return (db_snapshot_get(d, *lenp));
+}
+
+/* returns a malloc'ed, NUL terminated copy */
+static char *
+db_snapshot_get_string(struct db_snapshot_decoder *d, size_t *lenp)
+{
+	const unsigned char *p;
+	char *s;
+	size_t len;
+
+	if ((p = db_snapshot_get_bytes(d, &len)) == NULL)
+		return (NULL);
+	GFARM_MALLOC_ARRAY(s, len + 1);
+	if (s == NULL)
+		gflog_fatal(GFARM_MSG_1005726,
+		    "loading metadata snapshot: no memory");
+	memcpy(s, p, len);
+	s[len] = '\0';
+	if (lenp != NULL)
+		*lenp = len;
+	return (s);
+}
+
+static void
+db_snapshot_get_timespec(struct db_snapshot_decoder *d,
+	struct gfarm_timespec *ts)
+{
+	ts->tv_sec = db_snapshot_get_uint64(d);
+	ts->tv_nsec = db_snapshot_get_uint32(d);
+}
+
+struct db_snapshot_iterator {
+	enum db_snapshot_section section;
+	gfarm_uint64_t segment;
+	gfarm_uint32_t record;
+	struct db_snapshot_decoder d;
+};
+
+static void
+db_snapshot_iterator_init(struct db_snapshot_iterator *it,
+	enum db_snapshot_section section)
+{
+	it->section = section;
+	it->segment = 0;
+	it->record = 0;
+	it->d.p = it->d.end = NULL;
+	it->d.error = 0;
+}
+
+static void
+db_snapshot_corrupted(struct db_snapshot_iterator *it)
+{
+	gflog_fatal(GFARM_MSG_1005727,
+	    "metadata snapshot %s: %s section, segment %llu is corrupted. "
+	    "remove the file and restart gfmd",
+	    gfarm_get_metadb_snapshot_file(),
+	    db_snapshot_section_names[it->section],
+	    (unsigned long long)it->segment);
+}
+
+/* returns 0 at the end of the section */
+static int
+db_snapshot_iterator_next(struct db_snapshot_iterator *it)
+{
+	struct db_snapshot_segment *seg;
+
+	for (; it->segment < snapshot.nsegments; it->segment++) {
+		seg = &snapshot.segments[it->segment];
+		if (seg->section != it->section)
+			continue;
+		if (it->d.p == NULL) {
+			it->d.p = seg->data;
+			it->d.end = seg->data + seg->len;
+			it->record = 0;
+		} else if (it->d.error)
+			db_snapshot_corrupted(it);
+		if (it->record < seg->nrecords) {
+			it->record++;
+			return (1);
+		}
+		if (it->d.p != it->d.end)
+			db_snapshot_corrupted(it);
+		it->d.p = it->d.end = NULL;
+	}
+	return (0);
+}
+
+static gfarm_error_t
+db_snapshot_inode_load(void *closure,
+	void (*callback)(void *, struct gfs_stat *))
+{
+	struct db_snapshot_iterator it;
+	struct db_snapshot_decoder *d = &it.d;
+	struct gfs_stat st;
+
+	db_snapshot_iterator_init(&it, DB_SNAPSHOT_SECTION_INODE);
+	while (db_snapshot_iterator_next(&it)) {
+		st.st_ino = db_snapshot_get_uint64(d);
+		st.st_gen = db_snapshot_get_uint64(d);
+		st.st_mode = db_snapshot_get_uint32(d);
+		st.st_nlink = db_snapshot_get_uint64(d);
+		st.st_user = db_snapshot_get_string(d, NULL);
+		st.st_group = db_snapshot_get_string(d, NULL);
+		st.st_size = db_snapshot_get_uint64(d);
+		st.st_ncopy = 0;
+		db_snapshot_get_timespec(d, &st.st_atimespec);
+		db_snapshot_get_timespec(d, &st.st_mtimespec);
+		db_snapshot_get_timespec(d, &st.st_ctimespec);
+		if (d->error)
+			db_snapshot_corrupted(&it);
+		(*callback)(closure, &st);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+db_snapshot_inode_cksum_load(void *closure,
+	void (*callback)(void *, gfarm_ino_t, char *, size_t, char *))
+{
+	struct db_snapshot_iterator it;
+	struct db_snapshot_decoder *d = &it.d;
+	gfarm_ino_t inum;
+	char *type, *sum;
+	size_t len;
+
+	db_snapshot_iterator_init(&it, DB_SNAPSHOT_SECTION_INODE_CKSUM);
+	while (db_snapshot_iterator_next(&it)) {
+		inum = db_snapshot_get_uint64(d);
+		type = db_snapshot_get_string(d, NULL);
+		sum = db_snapshot_get_string(d, &len);
+		if (d->error)
+			db_snapshot_corrupted(&it);
+		(*callback)(closure, inum, type, len, sum);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+db_snapshot_filecopy_load(void *closure,
+	void (*callback)(void *, gfarm_ino_t, char *))
+{
+	struct db_snapshot_iterator it;
+	struct db_snapshot_decoder *d = &it.d;
+	gfarm_ino_t inum;
+	char *hostname;
+
+	db_snapshot_iterator_init(&it, DB_SNAPSHOT_SECTION_FILECOPY);
+	while (db_snapshot_iterator_next(&it)) {
+		inum = db_snapshot_get_uint64(d);
+		hostname = db_snapshot_get_string(d, NULL);
+		if (d->error)
+			db_snapshot_corrupted(&it);
+		(*callback)(closure, inum, hostname);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+db_snapshot_direntry_load(void *closure,
+	void (*callback)(void *, gfarm_ino_t, char *, int, gfarm_ino_t))
+{
+	struct db_snapshot_iterator it;
+	struct db_snapshot_decoder *d = &it.d;
+	gfarm_ino_t dir_inum, entry_inum;
+	char *name;
+	size_t len;
+
+	db_snapshot_iterator_init(&it, DB_SNAPSHOT_SECTION_DIRENTRY);
+	while (db_snapshot_iterator_next(&it)) {
+		dir_inum = db_snapshot_get_uint64(d);
+		name = db_snapshot_get_string(d, &len);
+		entry_inum = db_snapshot_get_uint64(d);
+		if (d->error)
+			db_snapshot_corrupted(&it);
+		(*callback)(closure, dir_inum, name, len, entry_inum);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+db_snapshot_symlink_load(void *closure,
+	void (*callback)(void *, gfarm_ino_t, char *))
+{
+	struct db_snapshot_iterator it;
+	struct db_snapshot_decoder *d = &it.d;
+	gfarm_ino_t inum;
+	char *source_path;
+
+	db_snapshot_iterator_init(&it, DB_SNAPSHOT_SECTION_SYMLINK);
+	while (db_snapshot_iterator_next(&it)) {
+		inum = db_snapshot_get_uint64(d);
+		source_path = db_snapshot_get_string(d, NULL);
+		if (d->error)
+			db_snapshot_corrupted(&it);
+		(*callback)(closure, inum, source_path);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * the value of an xattr which has become cacheable after the snapshot
+ * was written is not in the image.  read it from the backend DB.
+ * the DB may be newer than the snapshot, but the journal replay
+ * in db_snapshot_load_end() makes the value consistent.
+ *
+ * PREREQUISITE: db_access_mutex
+ */
+static void
+db_snapshot_xattr_get(struct xattr_info *info)
+{
+	gfarm_error_t e;
+	struct db_xattr_arg *arg;
+	void *value = NULL;
+	size_t size = 0;
+
+	GFARM_MALLOC(arg);
+	if (arg == NULL)
+		gflog_fatal(GFARM_MSG_1005728,
+		    "loading metadata snapshot: no memory");
+	arg->xmlMode = 0;
+	arg->inum = info->inum;
+	arg->attrname = info->attrname;
+	arg->value = NULL;
+	arg->size = 0;
+	arg->valuep = &value;
+	arg->sizep = &size;
+	/* `arg' is freed by xattr_get() */
+	if ((e = (*store_ops->xattr_get)(0, arg)) == GFARM_ERR_NO_ERROR) {
+		info->attrvalue = value;
+		info->attrsize = size;
+	} else if (e != GFARM_ERR_NO_SUCH_OBJECT)
+		gflog_warning(GFARM_MSG_1005729,
+		    "loading xattr %s of inode %llu: %s", info->attrname,
+		    (unsigned long long)info->inum, gfarm_error_string(e));
+}
+
+static gfarm_error_t
+db_snapshot_xattr_load(void *closure,
+	void (*callback)(void *, struct xattr_info *))
+{
+	struct db_snapshot_iterator it;
+	struct db_snapshot_decoder *d = &it.d;
+	int xmlMode = (closure != NULL) ? *(int *)closure : 0;
+	struct xattr_info info;
+	const unsigned char *value;
+	size_t size;
+	int cached;
+
+	db_snapshot_iterator_init(&it, xmlMode ?
+	    DB_SNAPSHOT_SECTION_XMLATTR : DB_SNAPSHOT_SECTION_XATTR);
+	while (db_snapshot_iterator_next(&it)) {
+		info.inum = db_snapshot_get_uint64(d);
+		info.attrname = db_snapshot_get_string(d, &size);
+		info.namelen = size + 1; /* include '\0' */
+		info.attrvalue = NULL;
+		info.attrsize = 0;
+		cached = 0;
+		if (!xmlMode) {
+			cached = db_snapshot_get_uint32(d);
+			value = db_snapshot_get_bytes(d, &size);
+			if (cached && value != NULL) {
+				/* the owner is not changed by the callback */
+				info.attrvalue = (void *)value; /* UNCONST */
+				info.attrsize = size;
+			}
+		}
+		if (d->error)
+			db_snapshot_corrupted(&it);
+		if (!xmlMode && !cached && gfarm_xattr_caching(info.attrname))
+			db_snapshot_xattr_get(&info);
+		(*callback)(closure, &info);
+		if (!xmlMode && !cached)
+			free(info.attrvalue);
+		free(info.attrname);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+struct db_snapshot_verifier {
+	pthread_t thread;
+	int id, nthreads;
+	gfarm_uint64_t nbad, first_bad;
+};
+
+static void *
+db_snapshot_verify_thread(void *arg)
+{
+	struct db_snapshot_verifier *v = arg;
+	struct db_snapshot_segment *seg;
+	gfarm_uint64_t i;
+
+	for (i = v->id; i < snapshot.nsegments; i += v->nthreads) {
+		seg = &snapshot.segments[i];
+		if (gfarm_crc32(0, seg->data, seg->len) != seg->crc) {
+			if (v->nbad++ == 0)
+				v->first_bad = i;
+		}
+	}
+	return (NULL);
+}
+
+/* verify CRC of the segments in parallel */
+static int
+db_snapshot_verify(void)
+{
+	struct db_snapshot_verifier v[DB_SNAPSHOT_VERIFY_THREADS_MAX];
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	int i, nthreads, ok = 1;
+
+	nthreads = ncpu < 1 ? 1 : ncpu > DB_SNAPSHOT_VERIFY_THREADS_MAX ?
+	    DB_SNAPSHOT_VERIFY_THREADS_MAX : ncpu;
+	if (nthreads > snapshot.nsegments)
+		nthreads = snapshot.nsegments > 0 ? snapshot.nsegments : 1;
+	for (i = 0; i < nthreads; i++) {
+		v[i].id = i;
+		v[i].nthreads = nthreads;
+		v[i].nbad = 0;
+	}
+	/* v[0] is verified by this thread */
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&v[i].thread, NULL,
+		    db_snapshot_verify_thread, &v[i]) != 0) {
+			/* verify all segments by this thread */
+			while (--i >= 1)
+				pthread_join(v[i].thread, NULL);
+			nthreads = v[0].nthreads = 1;
+			break;
+		}
+	}
+	db_snapshot_verify_thread(&v[0]);
+	for (i = 1; i < nthreads; i++)
+		pthread_join(v[i].thread, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		if (v[i].nbad > 0) {
+			gflog_error(GFARM_MSG_1005730,
+			    "metadata snapshot %s: CRC error at segment %llu",
+			    gfarm_get_metadb_snapshot_file(),
+			    (unsigned long long)v[i].first_bad);
+			ok = 0;
+		}
+	}
+	return (ok);
+}
+
+/* build the segment index, returns 0 if the image is broken */
+static int
+db_snapshot_index(void)
+{
+	const unsigned char *p = snapshot.map, *end = p + snapshot.size;
+	struct db_snapshot_segment *seg;
+	gfarm_uint64_t i;
+
+	if (snapshot.nsegments > snapshot.size / DB_SNAPSHOT_SEGMENT_HEADER_SIZE)
+		return (0);
+	GFARM_MALLOC_ARRAY(snapshot.segments, snapshot.nsegments + 1);
+	if (snapshot.segments == NULL)
+		return (0);
+	p += DB_SNAPSHOT_HEADER_SIZE;
+	for (i = 0; i <= snapshot.nsegments; i++) {
+		if (end - p < DB_SNAPSHOT_SEGMENT_HEADER_SIZE)
+			return (0);
+		seg = &snapshot.segments[i];
+		seg->section = db_snapshot_decode_uint32(p);
+		seg->nrecords = db_snapshot_decode_uint32(p + 4);
+		seg->len = db_snapshot_decode_uint32(p + 8);
+		seg->crc = db_snapshot_decode_uint32(p + 12);
+		seg->data = p + DB_SNAPSHOT_SEGMENT_HEADER_SIZE;
+		if (seg->section >= DB_SNAPSHOT_SECTION_MAX ||
+		    end - seg->data < seg->len)
+			return (0);
+		p = seg->data + seg->len;
+		if (seg->section == DB_SNAPSHOT_SECTION_END)
+			break;
+	}
+	/* the END segment is not counted */
+	return (i == snapshot.nsegments && p == end);
+}
+
+static void
+db_snapshot_unmap(void)
+{
+	if (snapshot.map != NULL)
+		munmap(snapshot.map, snapshot.size);
+	free(snapshot.segments);
+	snapshot.map = NULL;
+	snapshot.segments = NULL;
+}
+
+/* returns 0, if the image cannot be used */
+static int
+db_snapshot_open(const char *path)
+{
+	gfarm_error_t e;
+	int fd, save_errno, inited = 0;
+	struct stat sb;
+	const unsigned char *h;
+	static const char diag[] = "db_snapshot_open";
+
+	gfarm_privilege_lock(diag);
+	fd = open(path, O_RDONLY);
+	save_errno = errno;
+	gfarm_privilege_unlock(diag);
+	if (fd == -1) {
+		if (save_errno == ENOENT)
+			gflog_info(GFARM_MSG_1005731,
+			    "metadata snapshot %s: not found", path);
+		else
+			gflog_warning(GFARM_MSG_1005732,
+			    "metadata snapshot %s: %s", path,
+			    strerror(save_errno));
+		return (0);
+	}
+	if (fstat(fd, &sb) == -1 || sb.st_size < DB_SNAPSHOT_HEADER_SIZE ||
+	    (snapshot.map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE,
+	    fd, 0)) == MAP_FAILED) {
+		snapshot.map = NULL;
+		gflog_warning(GFARM_MSG_1005733,
+		    "metadata snapshot %s: cannot map", path);
+		close(fd);
+		return (0);
+	}
+	close(fd);
+	snapshot.size = sb.st_size;
+
+	h = snapshot.map;
+	if (memcmp(h, DB_SNAPSHOT_MAGIC, 4) != 0 ||
+	    db_snapshot_decode_uint32(h + 4) != DB_SNAPSHOT_VERSION ||
+	    db_snapshot_decode_uint32(h + DB_SNAPSHOT_HEADER_SIZE - 4) !=
+	    gfarm_crc32(0, h, DB_SNAPSHOT_HEADER_SIZE - 4) ||
+	    db_snapshot_decode_uint64(h + 24) != snapshot.size) {
+		gflog_warning(GFARM_MSG_1005734,
+		    "metadata snapshot %s: invalid header", path);
+		return (0);
+	}
+	snapshot.seqnum = db_snapshot_decode_uint64(h + 8);
+	snapshot.nsegments = db_snapshot_decode_uint64(h + 16);
+	if (!db_snapshot_index()) {
+		gflog_warning(GFARM_MSG_1005735,
+		    "metadata snapshot %s: broken segment", path);
+		return (0);
+	}
+	if (!db_snapshot_verify())
+		return (0);
+
+	/* the backend DB has been updated by boot_apply_db_journal() */
+	snapshot.db_seqnum = db_journal_get_current_seqnum();
+	if (snapshot.seqnum > snapshot.db_seqnum) {
+		gflog_warning(GFARM_MSG_1005736,
+		    "metadata snapshot %s: seqnum %llu is newer than "
+		    "the database %llu", path,
+		    (unsigned long long)snapshot.seqnum,
+		    (unsigned long long)snapshot.db_seqnum);
+		return (0);
+	}
+	if (snapshot.seqnum < snapshot.db_seqnum &&
+	    (e = db_journal_reader_reopen_if_needed("snapshot",
+	    &snapshot.reader, snapshot.seqnum, &inited))
+	    != GFARM_ERR_NO_ERROR) {
+		gflog_warning(GFARM_MSG_1005737,
+		    "metadata snapshot %s: seqnum %llu: journal records "
+		    "after the snapshot are not available: %s",
+		    path, (unsigned long long)snapshot.seqnum,
+		    gfarm_error_string(e));
+		if (snapshot.reader != NULL) {
+			journal_file_reader_close(snapshot.reader);
+			snapshot.reader = NULL;
+		}
+		return (0);
+	}
+	return (1);
+}
+
+/*
+ * switch the filesystem tables to be loaded from the snapshot image.
+ * must be called after boot_apply_db_journal() and before inode_init().
+ */
+void
+db_snapshot_load_begin(void)
+{
+	const char *path = gfarm_get_metadb_snapshot_file();
+
+	if (path == NULL)
+		return;
+	if (!db_snapshot_is_enabled()) {
+		gflog_warning(GFARM_MSG_1005738,
+		    "metadb_snapshot_file requires metadb_replication "
+		    "and a backend database, ignored");
+		return;
+	}
+	snapshot.load_start = time(NULL);
+	if (!db_snapshot_open(path)) {
+		gflog_info(GFARM_MSG_1005739,
+		    "loading metadata from the database");
+		db_snapshot_unmap();
+		return;
+	}
+
+	db_snapshot_load_ops = *store_ops;
+	db_snapshot_load_ops.inode_load = db_snapshot_inode_load;
+	db_snapshot_load_ops.inode_cksum_load = db_snapshot_inode_cksum_load;
+	db_snapshot_load_ops.filecopy_load = db_snapshot_filecopy_load;
+	db_snapshot_load_ops.direntry_load = db_snapshot_direntry_load;
+	db_snapshot_load_ops.symlink_load = db_snapshot_symlink_load;
+	db_snapshot_load_ops.xattr_load = db_snapshot_xattr_load;
+	db_use_for_load(&db_snapshot_load_ops);
+
+	gflog_info(GFARM_MSG_1005740,
+	    "loading metadata from snapshot %s: seqnum=%llu, "
+	    "%llu segments, journal seqnum=%llu", path,
+	    (unsigned long long)snapshot.seqnum,
+	    (unsigned long long)snapshot.nsegments,
+	    (unsigned long long)snapshot.db_seqnum);
+}
+
+/* journal operations against the tables stored in the snapshot */
+static int
+db_snapshot_journal_filter(enum journal_operation ope)
+{
+	switch (ope) {
+	case GFM_JOURNAL_INODE_ADD:
+	case GFM_JOURNAL_INODE_MODIFY:
+	case GFM_JOURNAL_INODE_GEN_MODIFY:
+	case GFM_JOURNAL_INODE_NLINK_MODIFY:
+	case GFM_JOURNAL_INODE_SIZE_MODIFY:
+	case GFM_JOURNAL_INODE_MODE_MODIFY:
+	case GFM_JOURNAL_INODE_USER_MODIFY:
+	case GFM_JOURNAL_INODE_GROUP_MODIFY:
+	case GFM_JOURNAL_INODE_ATIME_MODIFY:
+	case GFM_JOURNAL_INODE_MTIME_MODIFY:
+	case GFM_JOURNAL_INODE_CTIME_MODIFY:
+	case GFM_JOURNAL_INODE_CKSUM_ADD:
+	case GFM_JOURNAL_INODE_CKSUM_MODIFY:
+	case GFM_JOURNAL_INODE_CKSUM_REMOVE:
+	case GFM_JOURNAL_FILECOPY_ADD:
+	case GFM_JOURNAL_FILECOPY_REMOVE:
+	case GFM_JOURNAL_DIRENTRY_ADD:
+	case GFM_JOURNAL_DIRENTRY_REMOVE:
+	case GFM_JOURNAL_SYMLINK_ADD:
+	case GFM_JOURNAL_SYMLINK_REMOVE:
+	case GFM_JOURNAL_XATTR_ADD:
+	case GFM_JOURNAL_XATTR_MODIFY:
+	case GFM_JOURNAL_XATTR_REMOVE:
+	case GFM_JOURNAL_XATTR_REMOVEALL:
+		return (1);
+	default:
+		return (0);
+	}
+}
+
+/*
+ * bring the tables loaded from the snapshot up to date with the
+ * backend DB by replaying the journal.
+ * must be called after xattr_init() and before dirset_init(),
+ * because the latter tables refer to inodes.
+ */
+void
+db_snapshot_load_end(void)
+{
+	gfarm_error_t e;
+	gfarm_uint64_t napplied = 0;
+
+	if (snapshot.map == NULL)
+		return;
+	db_use_for_load(NULL);
+	if (snapshot.reader != NULL) {
+		giant_lock();
+		e = db_journal_replay(snapshot.reader, snapshot.seqnum,
+		    snapshot.db_seqnum, db_snapshot_journal_filter, &napplied);
+		giant_unlock();
+		journal_file_reader_close(snapshot.reader);
+		snapshot.reader = NULL;
+		if (e != GFARM_ERR_NO_ERROR)
+			gflog_fatal(GFARM_MSG_1005741,
+			    "metadata snapshot %s: replaying journal: %s. "
+			    "remove the file and restart gfmd",
+			    gfarm_get_metadb_snapshot_file(),
+			    gfarm_error_string(e));
+	}
+	db_snapshot_unmap();
+	gflog_info(GFARM_MSG_1005742,
+	    "metadata snapshot loaded: %llu journal records replayed, "
+	    "%lld seconds", (unsigned long long)napplied,
+	    (long long)(time(NULL) - snapshot.load_start));
+}
@@ -0,0 +1,24 @@
+/*
+ * $Id$
+ */
+
+struct db_snapshot_writer;
+struct gfs_stat;
+
+gfarm_error_t db_snapshot_put_inode(struct db_snapshot_writer *,
+	struct gfs_stat *);
+gfarm_error_t db_snapshot_put_inode_cksum(struct db_snapshot_writer *,
+	gfarm_ino_t, const char *, size_t, const char *);
+gfarm_error_t db_snapshot_put_filecopy(struct db_snapshot_writer *,
+	gfarm_ino_t, const char *);
+gfarm_error_t db_snapshot_put_direntry(struct db_snapshot_writer *,
+	gfarm_ino_t, const char *, int, gfarm_ino_t);
+gfarm_error_t db_snapshot_put_symlink(struct db_snapshot_writer *,
+	gfarm_ino_t, const char *);
+gfarm_error_t db_snapshot_put_xattr(struct db_snapshot_writer *,
+	int, gfarm_ino_t, const char *, const void *, int);
+
+void db_snapshot_load_begin(void);
+void db_snapshot_load_end(void);
+gfarm_error_t db_snapshot_write(void);
+void *db_snapshot_thread(void *);
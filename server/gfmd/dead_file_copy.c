@@ -92,12 +92,14 @@ struct dfc_allq {
 	pthread_mutex_t mutex;
 
 	struct dead_file_copy q; /* dummy head of doubly linked circular list */
+	long count;
 };
 
 /* IMPORTANT NOTE: functions should not sleep while holding dfc_allq.mutex */
 static struct dfc_allq dfc_allq = {
 	PTHREAD_MUTEX_INITIALIZER,
-	{ &dfc_allq.q, &dfc_allq.q, NULL, NULL }
+	{ &dfc_allq.q, &dfc_allq.q, NULL, NULL },
+	0
 };
 
 struct dfc_workq {
@@ -105,6 +107,7 @@ struct dfc_workq {
 	pthread_cond_t not_empty;
 
 	struct dead_file_copy q; /* dummy head of doubly linked circular list */
+	long count;
 };
 
 /*
@@ -114,7 +117,8 @@ struct dfc_workq {
 static struct dfc_workq removal_pendingq = {
 	PTHREAD_MUTEX_INITIALIZER,
 	PTHREAD_COND_INITIALIZER,
-	{ NULL, NULL, &removal_pendingq.q, &removal_pendingq.q }
+	{ NULL, NULL, &removal_pendingq.q, &removal_pendingq.q },
+	0
 };
 
 /*
@@ -124,7 +128,8 @@ static struct dfc_workq removal_pendingq = {
 static struct dfc_workq removal_finishedq = {
 	PTHREAD_MUTEX_INITIALIZER,
 	PTHREAD_COND_INITIALIZER,
-	{ NULL, NULL, &removal_finishedq.q, &removal_finishedq.q }
+	{ NULL, NULL, &removal_finishedq.q, &removal_finishedq.q },
+	0
 };
 
 /*
@@ -134,7 +139,8 @@ static struct dfc_workq removal_finishedq = {
 static struct dfc_workq host_busyq = {
 	PTHREAD_MUTEX_INITIALIZER,
 	PTHREAD_COND_INITIALIZER,
-	{ NULL, NULL, &host_busyq.q, &host_busyq.q }
+	{ NULL, NULL, &host_busyq.q, &host_busyq.q },
+	0
 };
 
 static void
@@ -147,6 +153,7 @@ dfc_workq_enqueue(struct dfc_workq *q, struct dead_file_copy *dfc,
 	dfc->workq_prev = q->q.workq_prev;
 	q->q.workq_prev->workq_next = dfc;
 	q->q.workq_prev = dfc;
+	q->count++;
 
 	gfarm_mutex_lock(&dfc->mutex, diag, "dfc state");
 	dfc->state = new_state;
@@ -170,9 +177,10 @@ dfc_workq_dequeue(struct dfc_workq *q, enum dead_file_copy_state new_state,
 
 	dfc = q->q.workq_next;
 
-	/* i.e. dfc_workq_remove(q->q.workq_next) */
+	/* i.e. dfc_workq_remove(q, q->q.workq_next) */
 	q->q.workq_next = dfc->workq_next;
 	dfc->workq_next->workq_prev = &q->q;
+	q->count--;
 
 	dfc->workq_next = dfc->workq_prev = NULL; /* to be sure */
 
@@ -184,11 +192,62 @@ dfc_workq_dequeue(struct dfc_workq *q, enum dead_file_copy_state new_state,
 	return (dfc);
 }
 
+/*
+ * wait for an entry, and dequeue up to `max' entries at once.
+ * returns the number of entries dequeued.
+ */
+static int
+dfc_workq_dequeue_multi(struct dfc_workq *q,
+	enum dead_file_copy_state new_state,
+	struct dead_file_copy **dfcs, int max, const char *diag)
+{
+	struct dead_file_copy *dfc;
+	int n = 0;
+
+	gfarm_mutex_lock(&q->mutex, diag, "lock");
+
+	while (q->q.workq_next == &q->q) {
+		gfarm_cond_wait(&q->not_empty, &q->mutex, diag, "not empty");
+	}
+
+	while (n < max && q->q.workq_next != &q->q) {
+		dfc = q->q.workq_next;
+
+		q->q.workq_next = dfc->workq_next;
+		dfc->workq_next->workq_prev = &q->q;
+		q->count--;
+
+		dfc->workq_next = dfc->workq_prev = NULL; /* to be sure */
+
+		gfarm_mutex_lock(&dfc->mutex, diag, "dfc state");
+		dfc->state = new_state;
+		gfarm_mutex_unlock(&dfc->mutex, diag, "dfc state");
+
+		dfcs[n++] = dfc;
+	}
+
+	gfarm_mutex_unlock(&q->mutex, diag, "unlock");
+	return (n);
+}
+
+/* PREREQUISITE: dfc_workq::mutex */
 static void
-dfc_workq_remove(struct dead_file_copy *dfc)
+dfc_workq_remove(struct dfc_workq *q, struct dead_file_copy *dfc)
 {
 	dfc->workq_next->workq_prev = dfc->workq_prev;
 	dfc->workq_prev->workq_next = dfc->workq_next;
+	q->count--;
+}
+
+static long
+dfc_workq_count(struct dfc_workq *q, const char *diag)
+{
+	long count;
+
+	gfarm_mutex_lock(&q->mutex, diag, "lock");
+	count = q->count;
+	gfarm_mutex_unlock(&q->mutex, diag, "unlock");
+	return (count);
 }
 
 /*
@@ -210,7 +269,7 @@ dfc_workq_host_remove(struct dfc_workq *q, struct host *host, const char *diag)
 		if (dfc->host != host)
 			continue;
 
-		dfc_workq_remove(dfc);
+		dfc_workq_remove(q, dfc);
 
 		gfarm_mutex_lock(&dfc->mutex, diag, "dfc state");
 		dfc->state = dfcstate_deferred;
@@ -255,6 +314,15 @@ removal_pendingq_dequeue(void)
 	    diag));
 }
 
+int
+removal_pendingq_dequeue_multi(struct dead_file_copy **dfcs, int max)
+{
+	static const char diag[] = "removal_pendingq_dequeue_multi";
+
+	return (dfc_workq_dequeue_multi(&removal_pendingq, dfcstate_in_flight,
+	    dfcs, max, diag));
+}
+
 void
 removal_finishedq_enqueue(struct dead_file_copy *dfc, gfarm_int32_t result)
 {
@@ -279,23 +347,30 @@ removal_finishedq_enqueue(struct dead_file_copy *dfc, gfarm_int32_t result)
 	dfc_workq_enqueue(&removal_finishedq, dfc, dfcstate_finished, diag);
 }
 
-static struct dead_file_copy *
-removal_finishedq_dequeue(void)
+static int
+removal_finishedq_dequeue_multi(struct dead_file_copy **dfcs, int max)
 {
-	static const char diag[] = "removal_finishedq_dequeue";
+	static const char diag[] = "removal_finishedq_dequeue_multi";
 
-	return (dfc_workq_dequeue(&removal_finishedq, dfcstate_finalizing,
-	    diag));
+	return (dfc_workq_dequeue_multi(&removal_finishedq,
+	    dfcstate_finalizing, dfcs, max, diag));
 }
 
 static void dead_file_copy_free(struct dead_file_copy *);
 void host_busyq_enqueue(struct dead_file_copy *);
 
+/* max number of results handled by one giant_lock() */
+#define REMOVAL_FINALIZE_BATCH	256
+
+/* cumulative statistics, protected by giant_lock */
+static unsigned long long removal_total_removed = 0;
+static unsigned long long removal_total_retried = 0;
+
 /*
- * PREREQUISITE: nothing
- * LOCKS: giant_lock
- *  -> (dbq.mutex, dfc_allq.mutex, host_busyq.mutex, host::back_channel_mutex)
- * SLEEPS: yes (giant_lock, dbq.mutex)
+ * PREREQUISITE: giant_lock
+ * LOCKS: dbq.mutex, dfc_allq.mutex, host_busyq.mutex,
+ *	host::back_channel_mutex
+ * SLEEPS: yes (dbq.mutex)
  *	but dfc_allq.mutex, host_busyq.mutex and host::back_channel_mutex
  *	won't be blocked while sleeping.
  */
@@ -304,9 +379,6 @@ handle_removal_result(struct dead_file_copy *dfc)
 {
 	static const char diag[] = "handle_removal_result";
 
-	/* giant_lock is necessary before calling dead_file_copy_free() */
-	giant_lock();
-
 	/*
 	 * because there is race condition between
 	 * the gfarm_read_only check in removal_finalizer() and here,
@@ -317,6 +389,7 @@ handle_removal_result(struct dead_file_copy *dfc)
 	} else if (dfc->result == GFARM_ERR_NO_ERROR ||
 	    dfc->result == GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY) {
 		dead_file_copy_free(dfc); /* sleeps to wait for dbq.mutex */
+		removal_total_removed++;
 	} else if (host_is_file_removable(dfc->host)) {
 		/* unexpected error, try again later to avoid busy loop */
 		gflog_notice(GFARM_MSG_1002223,
@@ -324,6 +397,7 @@ handle_removal_result(struct dead_file_copy *dfc)
 		    (long long)dfc->inum, (long long)dfc->igen,
 		    host_name(dfc->host), gfarm_error_string(dfc->result));
 		host_busyq_enqueue(dfc);
+		removal_total_retried++;
 	} else if (!host_is_valid(dfc->host)) {
 		dead_file_copy_free(dfc); /* sleeps to wait for dbq.mutex */
 	} else {
@@ -331,7 +405,22 @@ handle_removal_result(struct dead_file_copy *dfc)
 		dfc->state = dfcstate_deferred;
 		gfarm_mutex_unlock(&dfc->mutex, diag, "dfc state");
 	}
+}
 
+/*
+ * PREREQUISITE: nothing
+ * LOCKS: giant_lock -> see handle_removal_result()
+ * SLEEPS: yes (giant_lock, dbq.mutex)
+ */
+static void
+handle_removal_results(struct dead_file_copy **dfcs, int n)
+{
+	int i;
+
+	/* giant_lock is necessary before calling dead_file_copy_free() */
+	giant_lock();
+	for (i = 0; i < n; i++)
+		handle_removal_result(dfcs[i]);
 	giant_unlock();
 }
 
@@ -339,6 +428,8 @@ static void *
 removal_finalizer(void *arg)
 {
 	gfarm_error_t e;
+	struct dead_file_copy *dfcs[REMOVAL_FINALIZE_BATCH];
+	int n;
 	static const char diag[] = "removal_finalizer";
 
 	e = gfarm_pthread_set_priority_minimum(diag);
@@ -350,7 +441,9 @@ removal_finalizer(void *arg)
 	for (;;) {
 		gfarm_read_only_disabled_wait(diag);
 
-		handle_removal_result(removal_finishedq_dequeue());
+		n = removal_finishedq_dequeue_multi(dfcs,
+		    REMOVAL_FINALIZE_BATCH);
+		handle_removal_results(dfcs, n);
 	}
 
 	/*NOTREACHED*/
@@ -457,7 +550,7 @@ dead_file_copy_host_busyq_scan(void)
 		up = host_is_up(dfc->host);
 
 		if (!up) {
-			dfc_workq_remove(dfc);
+			dfc_workq_remove(&host_busyq, dfc);
 			gfarm_mutex_lock(&dfc->mutex, diag, "dfc state");
 			dfc->state = dfcstate_deferred;
 			gfarm_mutex_unlock(&dfc->mutex, diag, "dfc state");
@@ -466,7 +559,7 @@ dead_file_copy_host_busyq_scan(void)
 			dfc->workq_next = dfc->workq_prev = NULL;
 
 		} else if (!busy) {
-			dfc_workq_remove(dfc);
+			dfc_workq_remove(&host_busyq, dfc);
 
 			if (dead_file_copy_is_removable(dfc) &&
 			    host_is_file_removable(dfc->host)) {
@@ -514,7 +607,8 @@ host_busyq_scanner_schedule(void)
 {
 	/*
 	 * Q: why we use gfarm_metadb_heartbeat_interval here?
-	 * A: see the comment in callout_schedule_common().
+	 * A: to share the wakeup of the callout thread with the heartbeats,
+	 *    though any interval costs the same in callout_schedule().
 	 *
 	 * Q: why we use sync_protocol_get_thrpool() here?
 	 * A: because this thread needs giant_lock, and
@@ -1359,6 +1453,7 @@ dead_file_copy_alloc(gfarm_ino_t inum, gfarm_uint64_t igen, struct host *host)
 	dfc->allq_prev = dfc_allq.q.allq_prev;
 	dfc_allq.q.allq_prev->allq_next = dfc;
 	dfc_allq.q.allq_prev = dfc;
+	dfc_allq.count++;
 	gfarm_mutex_unlock(&dfc_allq.mutex, diag, "unlock");
 
 	return (dfc);
@@ -1432,6 +1527,7 @@ dead_file_copy_free(struct dead_file_copy *dfc)
 
 	dfc->allq_next->allq_prev = dfc->allq_prev;
 	dfc->allq_prev->allq_next = dfc->allq_next;
+	dfc_allq.count--;
 	gfarm_mutex_unlock(&dfc_allq.mutex, diag, "allq unlock");
 
 	e = db_deadfilecopy_remove(dfc->inum, dfc->igen, host_name(dfc->host));
@@ -1458,6 +1554,34 @@ dead_file_copy_free(struct dead_file_copy *dfc)
 	free(dfc);
 }
 
+/* report the backlog and the progress of removal, by SIGUSR2 */
+void
+dead_file_copy_info(void)
+{
+	long all, pending, finished, busy;
+	unsigned long long removed, retried;
+	static const char diag[] = "dead_file_copy_info";
+
+	gfarm_mutex_lock(&dfc_allq.mutex, diag, "allq lock");
+	all = dfc_allq.count;
+	gfarm_mutex_unlock(&dfc_allq.mutex, diag, "allq unlock");
+	pending = dfc_workq_count(&removal_pendingq, diag);
+	finished = dfc_workq_count(&removal_finishedq, diag);
+	busy = dfc_workq_count(&host_busyq, diag);
+
+	giant_lock();
+	removed = removal_total_removed;
+	retried = removal_total_retried;
+	giant_unlock();
+
+	gflog_info(GFARM_MSG_1005785, "dead file copies: %ld, "
+	    "pending removal: %ld, waiting for finalization: %ld, "
+	    "waiting for busy hosts: %ld",
+	    all, pending, finished, busy);
+	gflog_info(GFARM_MSG_1005786, "cumulative dead file copy removal: "
+	    "%llu removed, %llu retried", removed, retried);
+}
+
 /* The memory owner of `hostname' is changed to dead_file_copy.c */
 void
 dead_file_copy_add_one(void *closure,
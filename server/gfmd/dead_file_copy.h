@@ -12,6 +12,7 @@ extern int (*dead_file_copy_is_removable)(struct dead_file_copy *);
 
 void removal_pendingq_enqueue(struct dead_file_copy *);
 struct dead_file_copy *removal_pendingq_dequeue(void);
+int removal_pendingq_dequeue_multi(struct dead_file_copy **, int);
 void removal_finishedq_enqueue(struct dead_file_copy *, gfarm_int32_t);
 void host_busyq_enqueue(struct dead_file_copy *);
 
@@ -32,5 +33,7 @@ gfarm_error_t dead_file_copy_info_by_inode(gfarm_ino_t, gfarm_uint64_t, int,
 	int *, char **, gfarm_int64_t *, gfarm_int32_t *);
 int dead_file_copy_existing(gfarm_ino_t, gfarm_uint64_t, struct host *);
 
+void dead_file_copy_info(void);
+
 void dead_file_copy_init_load(void);
 void dead_file_copy_init(int);
@@ -0,0 +1,473 @@
+/*
+ * $Id$
+ */
+
+#include <pthread.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "hash.h"
+#include "nanosec.h"
+#include "thrsubr.h"
+
+#include "subr.h"
+#include "thrpool.h"
+#include "fairshare.h"
+
+/*
+ * fair share scheduling of jobs in front of a thread pool.
+ *
+ * jobs are queued by their key (e.g. a user or a tenant), and a job of
+ * the key which has consumed the least time divided by its weight runs
+ * first, i.e. start-time fair queuing, where the cost of a job is its
+ * running time.
+ * for each queued job, fairshare_run() is added to the thread pool,
+ * and which job to run is decided when a thread takes it.
+ *
+ * a key may also have a rate limit by a token bucket.
+ * if only jobs of rate-limited keys are queued, fairshare_run() is
+ * deferred, and the timer thread adds it to the thread pool again later,
+ * so that no thread in the pool waits for the rate limit.
+ *
+ * a key is a pointer (e.g. struct user) which may be freed and reused,
+ * thus a key which is idle for FAIRSHARE_KEY_IDLE_TIMEOUT is dropped,
+ * and the weight is looked up again whenever a key becomes active.
+ */
+
+#define FAIRSHARE_HASH_SIZE		256
+#define FAIRSHARE_COST_INITIAL		100.0	/* microseconds */
+#define FAIRSHARE_COST_SMOOTHING	8	/* exponential moving average */
+#define FAIRSHARE_KEY_IDLE_TIMEOUT	600	/* seconds */
+
+struct fairshare_job {
+	struct fairshare_job *next;
+	void *(*func)(void *);
+	void *arg;
+	struct timespec queued;
+};
+
+struct fairshare_key {
+	struct fairshare_key *active_next; /* in fairshare::active */
+	char *name;
+	int weight, rate; /* rate: jobs per second, 0 means unlimited */
+
+	struct fairshare_job *head, **tail;
+	int depth;
+	int nrunning;	/* jobs being run by fairshare_run() */
+	struct timespec idle_since; /* valid if depth == 0 && nrunning == 0 */
+
+	double vtime;	/* consumed time in microseconds / weight */
+	double cost;	/* average running time of a job in microseconds */
+	double tokens;	/* only used if rate > 0 */
+	struct timespec refilled;
+
+	/* statistics */
+	int depth_max;
+	unsigned long long njobs, ndeferred;
+	unsigned long long wait_total, wait_max; /* microseconds */
+};
+
+struct fairshare {
+	pthread_mutex_t mutex;
+	pthread_cond_t deferred_cond;
+
+	struct thread_pool *thrpool;
+	void (*weight_of)(const char *, int *, int *);
+
+	struct gfarm_hash_table *keys; /* key: const void * */
+	struct fairshare_key *active; /* keys which have queued jobs */
+	double vtime; /* vtime of the key which ran last */
+	int ndeferred; /* fairshare_run() to be added by the timer thread */
+	struct timespec swept; /* when idle keys were dropped last */
+
+	const char *name;
+	struct fairshare *next;
+};
+
+static const char FAIRSHARE_MUTEX_DIAG[] = "fairshare_mutex";
+static const char FAIRSHARE_DEFERRED_DIAG[] = "fairshare_deferred";
+
+static pthread_mutex_t fairshare_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct fairshare *fairshare_list = NULL;
+
+static long long
+fairshare_elapsed_microsec(const struct timespec *t0,
+	const struct timespec *t1)
+{
+	return ((long long)(t1->tv_sec - t0->tv_sec) *
+	    GFARM_SECOND_BY_MICROSEC +
+	    (t1->tv_nsec - t0->tv_nsec) / GFARM_MICROSEC_BY_NANOSEC);
+}
+
+static int
+fairshare_key_is_idle(struct fairshare_key *k)
+{
+	return (k->depth == 0 && k->nrunning == 0);
+}
+
+static void
+fairshare_key_reset(struct fairshare *fs, struct fairshare_key *k)
+{
+	k->vtime = fs->vtime;
+	k->cost = FAIRSHARE_COST_INITIAL;
+	k->tokens = k->rate; /* allow a burst of one second */
+	gfarm_gettime(&k->refilled);
+	k->idle_since = k->refilled;
+	k->depth_max = 0;
+	k->njobs = k->ndeferred = 0;
+	k->wait_total = k->wait_max = 0;
+}
+
+static struct fairshare_key *
+fairshare_key_lookup_or_enter(struct fairshare *fs,
+	const void *key, const char *name)
+{
+	struct gfarm_hash_entry *entry;
+	struct fairshare_key *k;
+	char *s;
+	int created;
+
+	entry = gfarm_hash_enter(fs->keys, &key, sizeof(key),
+	    sizeof(struct fairshare_key), &created);
+	if (entry == NULL)
+		return (NULL);
+	k = gfarm_hash_entry_data(entry);
+	if (!created) {
+		if (strcmp(k->name, name) == 0)
+			return (k);
+		/* the key is renamed, or freed and reused by another one */
+		if ((s = strdup(name)) == NULL)
+			return (NULL);
+		free(k->name);
+		k->name = s;
+		if (fairshare_key_is_idle(k)) /* will be activated soon */
+			fairshare_key_reset(fs, k);
+		return (k);
+	}
+
+	if ((k->name = strdup(name)) == NULL) {
+		gfarm_hash_purge(fs->keys, &key, sizeof(key));
+		return (NULL);
+	}
+	(*fs->weight_of)(name, &k->weight, &k->rate);
+	k->active_next = NULL;
+	k->head = NULL;
+	k->tail = &k->head;
+	k->depth = 0;
+	k->nrunning = 0;
+	fairshare_key_reset(fs, k);
+	return (k);
+}
+
+/* drops the keys which are idle for FAIRSHARE_KEY_IDLE_TIMEOUT */
+static void
+fairshare_key_sweep(struct fairshare *fs, const struct timespec *now)
+{
+	struct gfarm_hash_iterator it;
+	struct fairshare_key *k;
+
+	if (now->tv_sec - fs->swept.tv_sec < FAIRSHARE_KEY_IDLE_TIMEOUT)
+		return;
+	fs->swept = *now;
+	for (gfarm_hash_iterator_begin(fs->keys, &it);
+	    !gfarm_hash_iterator_is_end(&it);) {
+		k = gfarm_hash_entry_data(gfarm_hash_iterator_access(&it));
+		if (fairshare_key_is_idle(k) && now->tv_sec -
+		    k->idle_since.tv_sec >= FAIRSHARE_KEY_IDLE_TIMEOUT) {
+			free(k->name);
+			gfarm_hash_iterator_purge(&it);
+		} else {
+			gfarm_hash_iterator_next(&it);
+		}
+	}
+}
+
+static void
+fairshare_key_refill(struct fairshare_key *k, const struct timespec *now)
+{
+	if (k->rate <= 0)
+		return;
+	k->tokens += (double)fairshare_elapsed_microsec(&k->refilled, now) *
+	    k->rate / GFARM_SECOND_BY_MICROSEC;
+	if (k->tokens > k->rate)
+		k->tokens = k->rate;
+	k->refilled = *now;
+}
+
+/*
+ * returns the active key to run next, or NULL if all of them reach
+ * their rate limits.  in the latter case, `*waitp' is set to the
+ * microseconds until one of them becomes runnable.
+ */
+static struct fairshare_key **
+fairshare_select(struct fairshare *fs, const struct timespec *now,
+	long long *waitp)
+{
+	struct fairshare_key *k, **kp, **best = NULL;
+	long long wait, min_wait = LLONG_MAX;
+
+	for (kp = &fs->active; (k = *kp) != NULL; kp = &k->active_next) {
+		fairshare_key_refill(k, now);
+		if (k->rate > 0 && k->tokens < 1) {
+			wait = (1 - k->tokens) * GFARM_SECOND_BY_MICROSEC /
+			    k->rate + 1;
+			if (wait < min_wait)
+				min_wait = wait;
+			continue;
+		}
+		if (best == NULL || k->vtime < (*best)->vtime)
+			best = kp;
+	}
+	*waitp = min_wait;
+	return (best);
+}
+
+static void *
+fairshare_run(void *arg)
+{
+	struct fairshare *fs = arg;
+	struct fairshare_key *k, **kp;
+	struct fairshare_job *job;
+	struct timespec now, done;
+	long long wait, cost;
+	static const char diag[] = "fairshare_run";
+
+	gfarm_mutex_lock(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+	gfarm_gettime(&now);
+	kp = fairshare_select(fs, &now, &wait);
+	if (kp == NULL) {
+		for (k = fs->active; k != NULL; k = k->active_next)
+			k->ndeferred++;
+		fs->ndeferred++;
+		gfarm_cond_signal(&fs->deferred_cond,
+		    diag, FAIRSHARE_DEFERRED_DIAG);
+		gfarm_mutex_unlock(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+		return (NULL);
+	}
+	k = *kp;
+	job = k->head;
+	if ((k->head = job->next) == NULL)
+		k->tail = &k->head;
+	if (--k->depth == 0) {
+		*kp = k->active_next;
+		k->active_next = NULL;
+	}
+	k->nrunning++; /* `k' must not be dropped until the cost is charged */
+	if (k->rate > 0)
+		k->tokens -= 1;
+
+	/* charge the expected cost now, so that other threads see it */
+	fs->vtime = k->vtime;
+	k->vtime += k->cost / k->weight;
+
+	wait = fairshare_elapsed_microsec(&job->queued, &now);
+	k->njobs++;
+	k->wait_total += wait;
+	if (k->wait_max < wait)
+		k->wait_max = wait;
+	gfarm_mutex_unlock(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+
+	(*job->func)(job->arg);
+	free(job);
+
+	gfarm_gettime(&done);
+	cost = fairshare_elapsed_microsec(&now, &done);
+	gfarm_mutex_lock(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+	k->vtime += (cost - k->cost) / k->weight;
+	k->cost += (cost - k->cost) / FAIRSHARE_COST_SMOOTHING;
+	if (--k->nrunning == 0 && k->depth == 0)
+		k->idle_since = done;
+	gfarm_mutex_unlock(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+
+	/* this return value won't be used, because this thread is detached */
+	return (NULL);
+}
+
+/* adds the deferred fairshare_run() again, when the rate limit allows */
+static void *
+fairshare_timer(void *arg)
+{
+	struct fairshare *fs = arg;
+	struct timespec now, deadline;
+	long long wait;
+	int i, n;
+	static const char diag[] = "fairshare_timer";
+
+	gfarm_mutex_lock(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+	for (;;) {
+		if (fs->ndeferred == 0) {
+			gfarm_cond_wait(&fs->deferred_cond, &fs->mutex,
+			    diag, FAIRSHARE_DEFERRED_DIAG);
+			continue;
+		}
+		gfarm_gettime(&now);
+		if (fairshare_select(fs, &now, &wait) != NULL) {
+			n = fs->ndeferred;
+			fs->ndeferred = 0;
+			gfarm_mutex_unlock(&fs->mutex,
+			    diag, FAIRSHARE_MUTEX_DIAG);
+			/* this is not a thread in the pool, thus can add */
+			for (i = 0; i < n; i++)
+				thrpool_add_job(fs->thrpool, fairshare_run, fs);
+			gfarm_mutex_lock(&fs->mutex,
+			    diag, FAIRSHARE_MUTEX_DIAG);
+			continue;
+		}
+		if (wait == LLONG_MAX) { /* shouldn't happen */
+			gfarm_cond_wait(&fs->deferred_cond, &fs->mutex,
+			    diag, FAIRSHARE_DEFERRED_DIAG);
+			continue;
+		}
+		deadline = now;
+		deadline.tv_sec += wait / GFARM_SECOND_BY_MICROSEC;
+		deadline.tv_nsec += (wait % GFARM_SECOND_BY_MICROSEC) *
+		    GFARM_MICROSEC_BY_NANOSEC;
+		if (deadline.tv_nsec >= GFARM_SECOND_BY_NANOSEC) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= GFARM_SECOND_BY_NANOSEC;
+		}
+		gfarm_cond_timedwait(&fs->deferred_cond, &fs->mutex,
+		    &deadline, diag, FAIRSHARE_DEFERRED_DIAG);
+	}
+	/*NOTREACHED*/
+
+	/* this return value won't be used, because this thread is detached */
+	return (NULL);
+}
+
+/*
+ * `weight_of(name, &weight, &rate)' returns the weight and the rate limit
+ * of a key.  it's called whenever the key becomes active, so that
+ * a change of the configuration is applied.
+ */
+struct fairshare *
+fairshare_new(struct thread_pool *thrpool,
+	void (*weight_of)(const char *, int *, int *), const char *name)
+{
+	gfarm_error_t e;
+	struct fairshare *fs;
+	static const char diag[] = "fairshare_new";
+
+	GFARM_MALLOC(fs);
+	if (fs == NULL)
+		return (NULL);
+	fs->keys = gfarm_hash_table_alloc(FAIRSHARE_HASH_SIZE,
+	    gfarm_hash_default, gfarm_hash_key_equal_default);
+	if (fs->keys == NULL) {
+		free(fs);
+		return (NULL);
+	}
+	gfarm_mutex_init(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+	gfarm_cond_init(&fs->deferred_cond, diag, FAIRSHARE_DEFERRED_DIAG);
+	fs->thrpool = thrpool;
+	fs->weight_of = weight_of;
+	fs->active = NULL;
+	fs->vtime = 0;
+	fs->ndeferred = 0;
+	gfarm_gettime(&fs->swept);
+	fs->name = name;
+
+	e = create_detached_thread(fairshare_timer, fs);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_fatal(GFARM_MSG_1005806,
+		    "create_detached_thread(fairshare_timer): %s",
+		    gfarm_error_string(e));
+
+	gfarm_mutex_lock(&fairshare_list_mutex, diag, "fairshare_list");
+	fs->next = fairshare_list;
+	fairshare_list = fs;
+	gfarm_mutex_unlock(&fairshare_list_mutex, diag, "fairshare_list");
+	return (fs);
+}
+
+/*
+ * `key' identifies the owner of the job, and `name' is used to lookup
+ * its weight, and for fairshare_info().
+ * if memory is exhausted, the job is added to the thread pool directly.
+ */
+void
+fairshare_add_job(struct fairshare *fs, const void *key, const char *name,
+	void *(*func)(void *), void *arg)
+{
+	struct fairshare_key *k;
+	struct fairshare_job *job;
+	static const char diag[] = "fairshare_add_job";
+
+	GFARM_MALLOC(job);
+	if (job == NULL) {
+		gflog_warning(GFARM_MSG_1005807,
+		    "%s: %s: no memory, scheduled without fair share",
+		    fs->name, name);
+		thrpool_add_job(fs->thrpool, func, arg);
+		return;
+	}
+	job->next = NULL;
+	job->func = func;
+	job->arg = arg;
+	gfarm_gettime(&job->queued);
+
+	gfarm_mutex_lock(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+	fairshare_key_sweep(fs, &job->queued);
+	k = fairshare_key_lookup_or_enter(fs, key, name);
+	if (k == NULL) {
+		gfarm_mutex_unlock(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+		gflog_warning(GFARM_MSG_1005808,
+		    "%s: %s: no memory, scheduled without fair share",
+		    fs->name, name);
+		free(job);
+		thrpool_add_job(fs->thrpool, func, arg);
+		return;
+	}
+	if (k->depth++ == 0) {
+		(*fs->weight_of)(k->name, &k->weight, &k->rate);
+		if (k->rate > 0 && k->tokens > k->rate)
+			k->tokens = k->rate;
+		/* an idle key doesn't save its share for later */
+		if (k->vtime < fs->vtime)
+			k->vtime = fs->vtime;
+		k->active_next = fs->active;
+		fs->active = k;
+	}
+	if (k->depth_max < k->depth)
+		k->depth_max = k->depth;
+	*k->tail = job;
+	k->tail = &job->next;
+	gfarm_mutex_unlock(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+
+	thrpool_add_job(fs->thrpool, fairshare_run, fs);
+}
+
+void
+fairshare_info(void)
+{
+	struct fairshare *fs;
+	struct fairshare_key *k;
+	struct gfarm_hash_iterator it;
+	static const char diag[] = "fairshare_info";
+
+	gfarm_mutex_lock(&fairshare_list_mutex, diag, "fairshare_list");
+	for (fs = fairshare_list; fs != NULL; fs = fs->next) {
+		gfarm_mutex_lock(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+		for (gfarm_hash_iterator_begin(fs->keys, &it);
+		    !gfarm_hash_iterator_is_end(&it);
+		    gfarm_hash_iterator_next(&it)) {
+			k = gfarm_hash_entry_data(
+			    gfarm_hash_iterator_access(&it));
+			gflog_info(GFARM_MSG_1005809,
+			    "%s: fair share of <%s>: weight %d, rate %d/s, "
+			    "queued %d (max %d), %llu jobs, "
+			    "wait %llu/%llu usec (avg/max), %llu deferred",
+			    fs->name, k->name, k->weight, k->rate,
+			    k->depth, k->depth_max, k->njobs,
+			    k->njobs == 0 ? 0ULL : k->wait_total / k->njobs,
+			    k->wait_max, k->ndeferred);
+		}
+		gfarm_mutex_unlock(&fs->mutex, diag, FAIRSHARE_MUTEX_DIAG);
+	}
+	gfarm_mutex_unlock(&fairshare_list_mutex, diag, "fairshare_list");
+}
@@ -0,0 +1,9 @@
+struct fairshare;
+struct thread_pool;
+
+struct fairshare *fairshare_new(struct thread_pool *,
+	void (*)(const char *, int *, int *), const char *);
+void fairshare_add_job(struct fairshare *, const void *, const char *,
+	void *(*)(void *), void *);
+
+void fairshare_info(void);
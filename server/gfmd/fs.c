@@ -776,6 +776,117 @@ gfm_server_fhopen(struct peer *peer, int from_client, int skip)
 	return (gfm_server_put_reply(peer, diag, e, "i", mode));
 }
 
+/* returns the rest of `path' after `n' components, or NULL */
+static const char *
+path_skip_components(const char *path, int n)
+{
+	for (; n > 0; n--) {
+		while (*path == '/')
+			path++;
+		if (*path == '\0')
+			return (NULL);
+		path += strcspn(path, "/");
+	}
+	return (path);
+}
+
+/*
+ * lookup the directories in a pathname with one request,
+ * instead of GFM_PROTO_OPEN and GFM_PROTO_VERIFY_TYPE for each component.
+ * only the last component is opened.
+ */
+gfarm_error_t
+gfm_server_lookup_path(struct peer *peer, int from_client, int skip)
+{
+	struct gfp_xdr *client = peer_get_conn(peer);
+	gfarm_error_t e, e2;
+	char *path;
+	const char *rest;
+	gfarm_int32_t ncached, first = 0, n = 0, cfd, fd, i;
+	gfarm_ino_t inum;
+	gfarm_uint64_t gen;
+	struct process *process;
+	struct inode *base, **inodes = NULL;
+	struct dirset *tdirset = TDIRSET_IS_UNKNOWN;
+	struct lookup_path_rec {
+		gfarm_ino_t inum;
+		gfarm_uint64_t gen;
+		gfarm_int32_t mode;
+	} *p = NULL;
+	static const char diag[] = "GFM_PROTO_LOOKUP_PATH";
+
+	e = gfm_server_get_request(peer, diag, "sill",
+	    &path, &ncached, &inum, &gen);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (skip) {
+		free(path);
+		return (GFARM_ERR_NO_ERROR);
+	}
+	/* each component takes at least 2 bytes, except the last one */
+	GFARM_MALLOC_ARRAY(inodes, strlen(path) / 2 + 1);
+	GFARM_MALLOC_ARRAY(p, strlen(path) / 2 + 1);
+	if (inodes == NULL || p == NULL) {
+		gflog_debug(GFARM_MSG_1005792, "%s: no memory", diag);
+		free(inodes);
+		free(p);
+		free(path);
+		return (gfm_server_put_reply(peer, diag,
+		    GFARM_ERR_NO_MEMORY, ""));
+	}
+
+	giant_lock();
+
+	rest = path;
+	if (!from_client || (process = peer_get_process(peer)) == NULL) {
+		gflog_debug(GFARM_MSG_1005793,
+		    "%s: operation is not permitted", diag);
+		e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+	} else if (ncached > 0 &&
+	    (rest = path_skip_components(path, ncached)) != NULL &&
+	    inode_lookup_cached_dir(inum, gen, process, &base) ==
+	    GFARM_ERR_NO_ERROR) {
+		first = ncached;
+	} else {
+		/* the cached directory isn't valid, start from the beginning */
+		rest = path;
+		if ((e = peer_fdpair_get_current(peer, &cfd)) ==
+		    GFARM_ERR_NO_ERROR &&
+		    (e = process_get_file_inode(process, peer, cfd, &base,
+		    diag)) == GFARM_ERR_NO_ERROR)
+			tdirset = inode_get_tdirset(base);
+	}
+	if (e == GFARM_ERR_NO_ERROR)
+		e = inode_lookup_dir_path(base, rest, process, &tdirset,
+		    inodes, &n);
+	if (e == GFARM_ERR_NO_ERROR &&
+	    (e = process_open_file(process, n > 0 ? inodes[n - 1] : base,
+	    GFARM_FILE_LOOKUP, 0, peer, NULL, tdirset, &fd)) ==
+	    GFARM_ERR_NO_ERROR) {
+		peer_fdpair_set_current(peer, fd, diag);
+		for (i = 0; i < n; i++) {
+			p[i].inum = inode_get_number(inodes[i]);
+			p[i].gen = inode_get_gen(inodes[i]);
+			p[i].mode = inode_get_mode(inodes[i]);
+		}
+	}
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005794, "%s: %s: %s", diag,
+		    path, gfarm_error_string(e));
+
+	giant_unlock();
+
+	e2 = gfm_server_put_reply(peer, diag, e, "ii", first, n);
+	/* if network error doesn't happen, e2 == e here */
+	for (i = 0; e2 == GFARM_ERR_NO_ERROR && i < n; i++)
+		e2 = gfp_xdr_send(client, "lli",
+		    p[i].inum, p[i].gen, p[i].mode);
+	free(inodes);
+	free(p);
+	free(path);
+	return (e2);
+}
+
 /* FUSE client does not report close error */
 static gfarm_error_t
 save_inum_for_close_check(struct process *process, struct peer *peer,
@@ -1107,7 +1218,8 @@ gfm_server_fstat(struct peer *peer, int from_client, int skip)
 #endif
 	if (skip)
 		return (GFARM_ERR_NO_ERROR);
-	giant_lock();
+	/* this doesn't modify any metadata */
+	giant_lock_shared();
 
 	if (!from_client && (spool_host = peer_get_host(peer)) == NULL) {
 		gflog_debug(GFARM_MSG_1001817,
@@ -1129,7 +1241,7 @@ gfm_server_fstat(struct peer *peer, int from_client, int skip)
 		e = inode_get_stat(inode,
 		    user_is_super_admin(peer_get_user(peer)), process, &st);
 
-	giant_unlock();
+	giant_unlock_shared();
 	e2 = gfm_server_put_reply(peer, diag, e, "llilsslllilili",
 	    st.st_ino, st.st_gen, st.st_mode, st.st_nlink,
 	    st.st_user, st.st_group, st.st_size,
@@ -2542,26 +2654,95 @@ fs_dir_cursor_get_name_and_inode(Dir dir,
 	return (GFARM_ERR_NO_ERROR);
 }
 
-/* remember current position */
+/* the directory position to be remembered in the descriptor */
+struct fs_dir_position {
+	char *key;	/* NULL at the end of the directory */
+	gfarm_off_t offset;
+};
+
 static void
-fs_dir_remember_cursor(struct peer *peer, struct process *process,
-	gfarm_int32_t fd, Dir dir, DirCursor *cursor, int eof,
-	const char *diag)
+fs_dir_position_get(Dir dir, DirCursor *cursor, int eof,
+	struct fs_dir_position *pos)
 {
 	DirEntry entry;
-	gfarm_off_t dir_offset;
+	int namelen;
+	char *name;
 
 	if (eof || (entry = dir_cursor_get_entry(dir, cursor)) == NULL) {
+		pos->key = NULL;
+		pos->offset = dir_get_entry_count(dir);
+		return;
+	}
+	name = dir_entry_get_name(entry, &namelen);
+	/* if this fails, only the offset is remembered */
+	if ((pos->key = malloc(namelen + 1)) != NULL) {
+		memcpy(pos->key, name, namelen);
+		pos->key[namelen] = '\0';
+	}
+	pos->offset = dir_cursor_get_pos(dir, cursor);
+}
+
+/* PREREQUISITE: giant_lock */
+static void
+fs_dir_position_remember(struct peer *peer, struct process *process,
+	gfarm_int32_t fd, struct fs_dir_position *pos, const char *diag)
+{
+	if (pos->key == NULL)
 		process_clear_dir_key(process, peer, fd, diag);
-		dir_offset = dir_get_entry_count(dir);
-	} else {
-		int namelen;
-		char *name = dir_entry_get_name(entry, &namelen);
+	else
+		process_set_dir_key(process, peer, fd,
+		    pos->key, strlen(pos->key), diag);
+	process_set_dir_offset(process, peer, fd, pos->offset, diag);
+	free(pos->key);
+	pos->key = NULL;
+}
+
+/*
+ * remember current position
+ *
+ * PREREQUISITE: giant_lock
+ */
+static void
+fs_dir_remember_cursor(struct peer *peer, struct process *process,
+	gfarm_int32_t fd, Dir dir, DirCursor *cursor, int eof,
+	const char *diag)
+{
+	struct fs_dir_position pos;
 
-		process_set_dir_key(process, peer, fd, name, namelen, diag);
-		dir_offset = dir_cursor_get_pos(dir, cursor);
+	fs_dir_position_get(dir, cursor, eof, &pos);
+	fs_dir_position_remember(peer, process, fd, &pos, diag);
+}
+
+/*
+ * neither the position of the descriptor nor the atime can be updated
+ * under giant_lock_shared(), thus this is called after giant_unlock_shared().
+ * `inum' and `igen' are of the directory which `fd' was opened for.
+ * while unlocked, another connection of the same process may close `fd'
+ * and open another directory as `fd', so the position is only remembered
+ * if `fd' still refers to the same directory.
+ */
+static void
+fs_dir_update(struct peer *peer, gfarm_int32_t fd,
+	struct fs_dir_position *pos,
+	int accessed, gfarm_ino_t inum, gfarm_uint64_t igen, const char *diag)
+{
+	struct process *process;
+	struct inode *inode;
+
+	giant_lock();
+	if ((process = peer_get_process(peer)) != NULL &&
+	    process_get_file_inode(process, peer, fd, &inode, diag) ==
+	    GFARM_ERR_NO_ERROR &&
+	    inode_get_number(inode) == inum && inode_get_gen(inode) == igen)
+		fs_dir_position_remember(peer, process, fd, pos, diag);
+	if (accessed) {
+		inode = inode_lookup(inum);
+		/* the directory may be removed and reused while unlocked */
+		if (inode != NULL && inode_get_gen(inode) == igen)
+			inode_accessed(inode);
 	}
-	process_set_dir_offset(process, peer, fd, dir_offset, diag);
+	giant_unlock();
+	free(pos->key);
 }
 
 gfarm_error_t
@@ -2572,9 +2753,12 @@ gfm_server_getdirents(struct peer *peer, int from_client, int skip)
 	gfarm_int32_t fd, n, i;
 	struct process *process;
 	struct inode *inode, *entry_inode;
-	int dir_is_root, name_with_tenant;
+	int dir_is_root, name_with_tenant, remember = 0, accessed = 0;
+	gfarm_ino_t inum = 0;
+	gfarm_uint64_t igen = 0;
 	Dir dir;
 	DirCursor cursor;
+	struct fs_dir_position pos;
 	struct dir_result_rec {
 		char *name;
 		gfarm_ino_t inum;
@@ -2587,7 +2771,12 @@ gfm_server_getdirents(struct peer *peer, int from_client, int skip)
 		return (e_ret);
 	if (skip)
 		return (GFARM_ERR_NO_ERROR);
-	giant_lock();
+	/*
+	 * this doesn't modify any metadata.
+	 * the directory position of the descriptor is updated by
+	 * fs_dir_update() later.
+	 */
+	giant_lock_shared();
 
 	if ((e_rpc = fs_dir_get(peer, from_client, &n, &process, &fd, &inode,
 	    &dir_is_root, &dir, &cursor, &name_with_tenant, diag))
@@ -2613,15 +2802,20 @@ gfm_server_getdirents(struct peer *peer, int from_client, int skip)
 				break;
 		}
 		if (e_rpc == GFARM_ERR_NO_ERROR) {
-			fs_dir_remember_cursor(peer, process, fd, dir,
-			    &cursor, n == 0, diag);
-			if (i > 0) /* XXX is this check necessary? */
-				inode_accessed(inode);
+			fs_dir_position_get(dir, &cursor, n == 0, &pos);
+			remember = 1;
+			inum = inode_get_number(inode);
+			igen = inode_get_gen(inode);
+			if (i > 0 && /* XXX is this check necessary? */
+			    inode_accessed_needs_update(inode))
+				accessed = 1;
 		}
 		n = i;
 	}
 
-	giant_unlock();
+	giant_unlock_shared();
+	if (remember)
+		fs_dir_update(peer, fd, &pos, accessed, inum, igen, diag);
 
 	e_ret = gfm_server_put_reply(peer, diag, e_rpc, "i", n);
 	/* if network error doesn't happen, e_ret == e_rpc here */
@@ -2655,9 +2849,12 @@ gfm_server_getdirentsplus(struct peer *peer, int from_client, int skip)
 	gfarm_int32_t fd, n, i;
 	struct process *process;
 	struct inode *inode, *entry_inode;
-	int dir_is_root, name_with_tenant;
+	int dir_is_root, name_with_tenant, remember = 0, accessed = 0;
+	gfarm_ino_t inum = 0;
+	gfarm_uint64_t igen = 0;
 	Dir dir;
 	DirCursor cursor;
+	struct fs_dir_position pos;
 	struct dir_result_rec {
 		char *name;
 		struct gfs_stat st;
@@ -2669,7 +2866,12 @@ gfm_server_getdirentsplus(struct peer *peer, int from_client, int skip)
 		return (e_ret);
 	if (skip)
 		return (GFARM_ERR_NO_ERROR);
-	giant_lock();
+	/*
+	 * this doesn't modify any metadata.
+	 * the directory position of the descriptor is updated by
+	 * fs_dir_update() later.
+	 */
+	giant_lock_shared();
 
 	if ((e_rpc = fs_dir_get(peer, from_client, &n, &process, &fd,
 	    &inode, &dir_is_root, &dir, &cursor, &name_with_tenant, diag))
@@ -2706,15 +2908,20 @@ gfm_server_getdirentsplus(struct peer *peer, int from_client, int skip)
 				break;
 		}
 		if (e_rpc == GFARM_ERR_NO_ERROR) {
-			fs_dir_remember_cursor(peer, process, fd, dir,
-			    &cursor, n == 0, diag);
-			if (i > 0) /* XXX is this check necessary? */
-				inode_accessed(inode);
+			fs_dir_position_get(dir, &cursor, n == 0, &pos);
+			remember = 1;
+			inum = inode_get_number(inode);
+			igen = inode_get_gen(inode);
+			if (i > 0 && /* XXX is this check necessary? */
+			    inode_accessed_needs_update(inode))
+				accessed = 1;
 		}
 		n = i;
 	}
 
-	giant_unlock();
+	giant_unlock_shared();
+	if (remember)
+		fs_dir_update(peer, fd, &pos, accessed, inum, igen, diag);
 	e_ret = gfm_server_put_reply(peer, diag, e_rpc, "i", n);
 	/* if network error doesn't happen, e_ret == e_rpc here */
 	if (e_ret == GFARM_ERR_NO_ERROR) {
@@ -2749,6 +2956,129 @@ gfm_server_getdirentsplus(struct peer *peer, int from_client, int skip)
 	return (e_ret);
 }
 
+/*
+ * lstat(2) of multiple pathnames relative to the current descriptor,
+ * under a single giant lock acquisition.
+ */
+gfarm_error_t
+gfm_server_lstat_multi(struct peer *peer, int from_client, int skip)
+{
+	struct gfp_xdr *client = peer_get_conn(peer);
+	gfarm_error_t e_ret, e_rpc = GFARM_ERR_NO_ERROR;
+	gfarm_int32_t fd, n, i;
+	char **paths = NULL;
+	struct process *process;
+	struct inode *base, *inode;
+	int name_with_tenant;
+	struct lstat_result_rec {
+		gfarm_error_t e;
+		struct gfs_stat st;
+	} *p = NULL;
+	static const char diag[] = "GFM_PROTO_LSTAT_MULTI";
+
+	e_ret = gfm_server_get_request(peer, diag, "i", &n);
+	if (e_ret != GFARM_ERR_NO_ERROR)
+		return (e_ret);
+	if (n < 0 || n > GFM_PROTO_MAX_LSTAT_MULTI) {
+		gflog_debug(GFARM_MSG_1005760, "%s: too many paths: %d",
+		    diag, (int)n);
+		e_rpc = GFARM_ERR_INVALID_ARGUMENT;
+	}
+	/* receive the paths anyway, to keep the protocol stream */
+	e_ret = gfm_server_recv_attrpatterns(peer,
+	    skip || e_rpc != GFARM_ERR_NO_ERROR, n < 0 ? 0 : n, &paths, diag);
+	if (e_ret != GFARM_ERR_NO_ERROR)
+		return (e_ret);
+	if (skip)
+		return (GFARM_ERR_NO_ERROR);
+
+	if (e_rpc != GFARM_ERR_NO_ERROR)
+		;
+	else if (n > 0 && (paths == NULL || GFARM_MALLOC_ARRAY(p, n) == NULL)) {
+		gflog_debug(GFARM_MSG_1005761, "%s: no memory for %d paths",
+		    diag, (int)n);
+		e_rpc = GFARM_ERR_NO_MEMORY;
+	} else {
+		/* this doesn't modify any metadata */
+		giant_lock_shared();
+
+		if (!from_client) {
+			gflog_debug(GFARM_MSG_1005762,
+			    "%s: operation is not permitted", diag);
+			e_rpc = GFARM_ERR_OPERATION_NOT_PERMITTED;
+		} else if ((process = peer_get_process(peer)) == NULL) {
+			gflog_debug(GFARM_MSG_1005763,
+			    "%s: peer_get_process() failed", diag);
+			e_rpc = GFARM_ERR_OPERATION_NOT_PERMITTED;
+		} else if ((e_rpc = peer_fdpair_get_current(peer, &fd)) !=
+		    GFARM_ERR_NO_ERROR) {
+			gflog_debug(GFARM_MSG_1005764,
+			    "%s: peer_fdpair_get_current() failed: %s",
+			    diag, gfarm_error_string(e_rpc));
+		} else if ((e_rpc = process_get_file_inode(process, peer, fd,
+		    &base, diag)) == GFARM_ERR_NO_ERROR) {
+			/* peer_get_user(peer) is not NULL if from_client */
+			name_with_tenant =
+			    user_is_super_admin(peer_get_user(peer));
+			for (i = 0; i < n; i++) {
+				p[i].e = inode_lookup_path_no_follow(base,
+				    paths[i], process, &inode);
+				if (p[i].e == GFARM_ERR_NO_ERROR)
+					p[i].e = inode_get_stat(inode,
+					    name_with_tenant, process,
+					    &p[i].st);
+			}
+		}
+
+		giant_unlock_shared();
+	}
+
+	e_ret = gfm_server_put_reply(peer, diag, e_rpc, "i", n);
+	/* if network error doesn't happen, e_ret == e_rpc here */
+	if (e_ret == GFARM_ERR_NO_ERROR) {
+		for (i = 0; i < n; i++) {
+			struct gfs_stat *st = &p[i].st;
+
+			if (p[i].e != GFARM_ERR_NO_ERROR) {
+				e_ret = gfp_xdr_send(client, "i", p[i].e);
+			} else {
+				e_ret = gfp_xdr_send(client,
+				    "illilsslllilili", p[i].e,
+				    st->st_ino, st->st_gen, st->st_mode,
+				    st->st_nlink, st->st_user, st->st_group,
+				    st->st_size, st->st_ncopy,
+				    st->st_atimespec.tv_sec,
+				    st->st_atimespec.tv_nsec,
+				    st->st_mtimespec.tv_sec,
+				    st->st_mtimespec.tv_nsec,
+				    st->st_ctimespec.tv_sec,
+				    st->st_ctimespec.tv_nsec);
+			}
+			if (e_ret != GFARM_ERR_NO_ERROR) {
+				gflog_warning(GFARM_MSG_1005765,
+				    "%s@%s: lstat_multi: %s",
+				    peer_get_username(peer),
+				    peer_get_hostname(peer),
+				    gfarm_error_string(e_ret));
+				break;
+			}
+		}
+	}
+	if (p != NULL) {
+		for (i = 0; e_rpc == GFARM_ERR_NO_ERROR && i < n; i++) {
+			if (p[i].e == GFARM_ERR_NO_ERROR)
+				gfs_stat_free(&p[i].st);
+		}
+		free(p);
+	}
+	if (paths != NULL) {
+		for (i = 0; i < n; i++)
+			free(paths[i]);
+		free(paths);
+	}
+	return (e_ret);
+}
+
 gfarm_error_t
 gfm_server_getdirentsplusxattr(struct peer *peer, int from_client, int skip)
 {
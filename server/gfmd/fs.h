@@ -15,6 +15,7 @@ gfarm_error_t gfm_server_create(struct peer *, int, int);
 gfarm_error_t gfm_server_open(struct peer *, int, int);
 gfarm_error_t gfm_server_open_root(struct peer *, int, int);
 gfarm_error_t gfm_server_open_parent(struct peer *, int, int);
+gfarm_error_t gfm_server_lookup_path(struct peer *, int, int);
 gfarm_error_t gfm_server_fhopen(struct peer *, int, int);
 gfarm_error_t gfm_server_close(struct peer *, int, int);
 gfarm_error_t gfm_server_close_getgen(struct peer *, int, int);
@@ -54,6 +55,7 @@ gfarm_error_t gfm_server_getdirpath(struct peer *, int, int);
 gfarm_error_t gfm_server_getdirents(struct peer *, int, int);
 gfarm_error_t gfm_server_seek(struct peer *, int, int);
 gfarm_error_t gfm_server_getdirentsplus(struct peer *, int, int);
+gfarm_error_t gfm_server_lstat_multi(struct peer *, int, int);
 gfarm_error_t gfm_server_getdirentsplusxattr(struct peer *, int, int);
 
 /* gfs from gfsd */
@@ -194,7 +194,8 @@ fsngroup_schedule_replication(
 				break;
 			}
 			e = inode_schedule_replication_within_scope(
-			    inode, tdirset, num, n_srcs, srcs, &next_src_index,
+			    inode, tdirset, num, group,
+			    n_srcs, srcs, &next_src_index,
 			    &n_scope, scope, n_existingp, existing, grace,
 			    n_being_removedp, being_removed, diag,
 			    req_ok_nump);
@@ -45,11 +45,13 @@
 
 #include "subr.h"
 #include "thrpool.h"
+#include "fairshare.h"
 #include "callout.h"
 #include "journal_file.h"	/* for enum journal_operation */
 #include "db_access.h"
 #include "db_journal.h"
 #include "db_journal_apply.h"
+#include "db_snapshot.h"
 #include "host.h"
 #include "fsngroup.h"
 #include "mdhost.h"
@@ -81,14 +83,26 @@
 
 #define GFMD_FAILOVER_CONFIG_BASENAME	"gfmd.failover.conf"
 
-#ifndef CALLOUT_NTHREADS
+#ifndef CALLOUT_NGROUPS
 /*
- * this is number of thread pools which are used by callouts,
- * so thrpool_add_job() in callout_main() won't be blocked for long time.
+ * this is number of groups of callout threads.  callouts are bound to
+ * a group by their thread pool, so thrpool_add_job() blocked in one group
+ * won't delay callouts of other thread pools.
+ * this should be at least the number of thread pools used by callouts.
  *
- * currently, only back_channel_send_thread_pool is called from callouts.
+ * currently, proto_status_send_thread_pool and sync_protocol_get_thrpool()
+ * are called from callouts.
  */
-#define CALLOUT_NTHREADS	1
+#define CALLOUT_NGROUPS		2
+#endif
+
+#ifndef CALLOUT_NTHREADS_PER_GROUP
+/*
+ * this is number of callout threads in a group, each of which owns
+ * its own shard of the timing wheel.  callouts of a group are spread
+ * over these shards.
+ */
+#define CALLOUT_NTHREADS_PER_GROUP	4
 #endif
 
 char *program_name = "gfmd";
@@ -128,6 +142,31 @@ gfarm_error_t (*gfm_server_protocol_extension)(struct peer *,
 	gfarm_int32_t *, gfarm_error_t *) =
 		gfm_server_protocol_extension_default;
 
+/*
+ * remember the journal seqnum which the reply to `peer' depends on.
+ * that's not only the transactions written for `peer', but all the
+ * transactions committed so far, because `peer' may have seen them.
+ */
+static void
+protocol_journal_seqnum_update(struct peer *peer)
+{
+	struct protocol_state *ps = peer_get_protocol_state(peer);
+	gfarm_uint64_t seqnum = db_journal_group_commit_seqnum();
+
+	if (seqnum > ps->journal_seqnum)
+		ps->journal_seqnum = seqnum;
+}
+
+/* the reply must not be sent before the journal is synced */
+static void
+protocol_journal_wait(struct peer *peer)
+{
+	struct protocol_state *ps = peer_get_protocol_state(peer);
+
+	db_journal_group_commit_wait(ps->journal_seqnum);
+	ps->journal_seqnum = 0;
+}
+
 gfarm_error_t
 protocol_switch(struct peer *peer, int from_client, int skip, int level,
 	gfarm_int32_t last_sync_request,
@@ -367,6 +406,12 @@ protocol_switch(struct peer *peer, int from_client, int skip, int level,
 	case GFM_PROTO_GETDIRENTSPLUSXATTR:
 		e = gfm_server_getdirentsplusxattr(peer, from_client, skip);
 		break;
+	case GFM_PROTO_LSTAT_MULTI:
+		e = gfm_server_lstat_multi(peer, from_client, skip);
+		break;
+	case GFM_PROTO_LOOKUP_PATH:
+		e = gfm_server_lookup_path(peer, from_client, skip);
+		break;
 	case GFM_PROTO_REOPEN:
 		e = gfm_server_reopen(peer, from_client, skip,
 		    suspendedp);
@@ -616,6 +661,9 @@ protocol_switch(struct peer *peer, int from_client, int skip, int level,
 	case GFM_PROTO_XMLATTR_FIND:
 		e = gfm_server_findxmlattr(peer, from_client, skip);
 		break;
+	case GFM_PROTO_XATTR_FIND:
+		e = gfm_server_findxattr(peer, from_client, skip);
+		break;
 	case GFM_PROTO_QUOTA_USER_GET:
 		e = gfm_server_quota_user_get(peer, from_client, skip);
 		break;
@@ -677,10 +725,13 @@ protocol_switch(struct peer *peer, int from_client, int skip, int level,
 		break;
 	}
 
+	protocol_journal_seqnum_update(peer);
 	if (!*suspendedp &&
 	    ((level == 0 && request != GFM_PROTO_COMPOUND_BEGIN)
 	    || request == GFM_PROTO_COMPOUND_END)) {
 		/* flush only when a COMPOUND loop is done */
+
+		protocol_journal_wait(peer);
 		if (debug_mode)
 			gflog_debug(GFARM_MSG_1000182, "gfp_xdr_flush");
 		e2 = gfp_xdr_flush(peer_get_conn(peer));
@@ -711,8 +762,10 @@ protocol_state_init(struct protocol_state *ps)
 	ps->nesting_level = 0;
 	ps->last_sync_request = -1;
 	ps->last_async_request = -1;
+	ps->journal_seqnum = 0;
 }
 
+
 /*
  * finish foreground protocol handling.
  *
@@ -921,6 +974,7 @@ resuming_thread(void *arg)
 
 	e = (*entry->action)(peer, entry->arg, &suspended);
 	free(entry);
+	protocol_journal_seqnum_update(peer);
 	if (suspended)
 		return (NULL);
 
@@ -940,6 +994,7 @@ resuming_thread(void *arg)
 	if (gfp_xdr_recv_is_ready(peer_get_conn(peer))) { /* inside COMPOUND */
 		protocol_main(peer);
 	} else { /* maybe inside COMPOUND, maybe not */
+		protocol_journal_wait(peer);
 		e = gfp_xdr_flush(peer_get_conn(peer));
 		if (e != GFARM_ERR_NO_ERROR) {
 			gflog_warning(GFARM_MSG_1004004, "protocol flush: %s",
@@ -1583,8 +1638,13 @@ sigs_handler(void *p)
 #endif
 		case SIGUSR2:
 			thrpool_info();
+			fairshare_info();
 			replica_check_info();
 			replication_info();
+			dead_file_copy_info();
+			back_channel_fhremove_info();
+			db_thread_info();
+			db_journal_group_commit_info();
 			continue;
 
 		/* some of these will be never delivered due to `*sigs' */
@@ -1658,6 +1718,9 @@ gfmd_terminate(const char *diag)
 	/* db_terminate() needs giant_lock(), see comment in dbq_enter() */
 	db_terminate();
 
+	if (gfmd_startup_state_is_ready() && mdhost_self_is_master())
+		(void)db_snapshot_write();
+
 	if (iostat_dirbuf) {
 		/*
 		 * We don't have to call gfarm_privilege_lock() here,
@@ -1733,11 +1796,21 @@ void
 gfmd_modules_init_default(int table_size)
 {
 	gfarm_error_t e;
+	struct fairshare *fs;
 
 	peer_watcher_set_default_nfd(table_size);
 	sync_protocol_watcher = peer_watcher_alloc(
 	    gfarm_metadb_thread_pool_size, gfarm_metadb_job_queue_length,
 	    protocol_main, "synchronous protocol handler");
+	if (gfarm_metadb_server_fair_share_key != GFARM_FAIR_SHARE_KEY_NONE) {
+		fs = fairshare_new(sync_protocol_get_thrpool(),
+		    gfarm_metadb_server_fair_share_weight_of,
+		    "synchronous protocol handler");
+		if (fs == NULL)
+			gflog_fatal(GFARM_MSG_1005810,
+			    "fair share scheduler: no memory");
+		peer_watcher_set_fairshare(sync_protocol_watcher, fs);
+	}
 
 	authentication_thread_pool = thrpool_new(gfarm_metadb_thread_pool_size,
 	    gfarm_metadb_job_queue_length, "authentication threads");
@@ -1747,7 +1820,7 @@ gfmd_modules_init_default(int table_size)
 		    gfarm_metadb_thread_pool_size,
 		    gfarm_metadb_job_queue_length);
 
-	callout_module_init(CALLOUT_NTHREADS);
+	callout_module_init(CALLOUT_NGROUPS, CALLOUT_NTHREADS_PER_GROUP);
 
 	if (gfarm_get_metadb_replication_enabled()) {
 		char *diag = "db_journal_init";
@@ -1781,6 +1854,7 @@ gfmd_modules_init_default(int table_size)
 	quota_init();
 
 	/* filesystem */
+	db_snapshot_load_begin();
 	inode_init();
 	dir_entry_init();
 	file_copy_init();
@@ -1788,6 +1862,7 @@ gfmd_modules_init_default(int table_size)
 	if (gfarm_backend_db_type == GFARM_BACKEND_DB_TYPE_NONE)
 		xattr_init_cache_all();
 	xattr_init();
+	db_snapshot_load_end();
 	dirset_init();
 	quota_dir_init();
 
@@ -2107,6 +2182,11 @@ main(int argc, char **argv)
 
 	quota_check_init();
 	replica_check_init();
+	if ((e = create_detached_thread(db_snapshot_thread, NULL))
+	    != GFARM_ERR_NO_ERROR)
+		gflog_fatal(GFARM_MSG_1005743,
+		    "create_detached_thread(db_snapshot_thread): %s",
+		    gfarm_error_string(e));
 	failover_notify();
 	accepting_loop(sock);
 
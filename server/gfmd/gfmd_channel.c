@@ -19,6 +19,10 @@
 #include <gfarm/gfarm_misc.h>
 #include <gfarm/gfs.h>
 
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
 #include "nanosec.h"
 #include "thrsubr.h"
 #include "gfutil.h"
@@ -72,10 +76,25 @@ static const char JOURNAL_READY_TO_RECV_MUTEX_DIAG[] =
 static const char JOURNAL_READY_TO_RECV_WAIT_COND_DIAG[] =
 					"journal_ready_to_recv_info.wait_cond";
 static const char PEER_RECORD_MUTEX_DIAG[] = "gfmdc_peer_record.mutex";
+static const char SEND_WINDOW_COND_DIAG[] =
+					"gfmdc_peer_record.send_window_cond";
 
 #define GFMDC_CONNECT_INTERVAL	30
 #define GFMDC_SEND_DEFAULT_TIMEOUT	1000000 /* 1 sec. */
 
+/* size of GFM_PROTO_JOURNAL_SEND, for slaves which don't accept packed one */
+#define GFMDC_JOURNAL_SEND_SIZE_LEGACY		8000
+#define GFMDC_JOURNAL_SEND_WINDOW_WAIT		1 /* 1 sec. */
+#define GFMDC_JOURNAL_LAG_REPORT_INTERVAL	60 /* 1 min. */
+
+#ifdef HAVE_LIBZ
+#define GFMDC_INTER_GFMD_FEATURES \
+	(GFM_INTER_GFMD_FEATURE_JOURNAL_PACKED | \
+	 GFM_INTER_GFMD_FEATURE_JOURNAL_ZLIB)
+#else
+#define GFMDC_INTER_GFMD_FEATURES	GFM_INTER_GFMD_FEATURE_JOURNAL_PACKED
+#endif
+
 /*
  * gmfdc_journal_send_closure
  */
@@ -85,6 +104,11 @@ struct gfmdc_journal_send_closure {
 	void *data;
 	gfarm_uint64_t to_sn;
 
+	/* for accounting of replication lag and the send window */
+	struct gfmdc_peer_record *gfmdc_peer;
+	size_t data_len; /* uncompressed */
+	int windowed, acked;
+
 	/* for synchrnous slave only */
 	int end;
 	pthread_mutex_t send_mutex;
@@ -122,6 +146,9 @@ static gfarm_error_t
 	c->host = NULL;
 	c->data = NULL;
 	c->to_sn = 0;
+	c->gfmdc_peer = NULL;
+	c->data_len = 0;
+	c->windowed = c->acked = 0;
 	c->end = 0;
 
 	*cp = c;
@@ -140,6 +167,7 @@ gfmdc_journal_syncsend_free(struct gfmdc_journal_send_closure *c)
 }
 
 static void gfmdc_journal_transfer_event(void);
+static void gfmdc_journal_send_done(struct gfmdc_journal_send_closure *);
 
 static void
 gfmdc_journal_send_closure_reset(struct gfmdc_journal_send_closure *c,
@@ -148,6 +176,9 @@ gfmdc_journal_send_closure_reset(struct gfmdc_journal_send_closure *c,
 	c->host = mh;
 	c->data = NULL;
 	c->to_sn = 0;
+	c->gfmdc_peer = NULL;
+	c->data_len = 0;
+	c->windowed = c->acked = 0;
 }
 
 static void
@@ -155,6 +186,7 @@ gfmdc_journal_syncsend_completed(struct gfmdc_journal_send_closure *c)
 {
 	static const char diag[] = "gfmdc_journal_syncsend_completed";
 
+	gfmdc_journal_send_done(c);
 	free(c->data);
 	c->data = NULL;
 	gfarm_mutex_lock(&c->send_mutex, diag, SEND_MUTEX_DIAG);
@@ -179,6 +211,7 @@ gfmdc_journal_asyncsend_alloc(struct mdhost *mh)
 static void
 gfmdc_journal_asyncsend_free(struct gfmdc_journal_send_closure *c)
 {
+	gfmdc_journal_send_done(c);
 	free(c->data);
 	free(c);
 
@@ -198,6 +231,15 @@ struct gfmdc_peer_record {
 
 	/* only used by synchronous slave */
 	struct gfmdc_journal_send_closure *journal_send_closure;
+
+	/* journal records which are sent, but not acknowledged yet */
+	pthread_cond_t send_window_cond;
+	int nsending_frames;
+	gfarm_uint64_t sending_bytes;
+
+	gfarm_uint64_t acked_seqnum;
+	time_t lag_reported;
+	int lag_is_reported;
 };
 
 static gfarm_error_t
@@ -221,6 +263,16 @@ gfmdc_peer_record_alloc(const char *diag,
 		free(gfmdc_peer);
 		return (gfarm_errno_to_error(err));
 	}
+	if ((err = pthread_cond_init(&gfmdc_peer->send_window_cond, NULL))
+	    != 0) {
+		gflog_error(GFARM_MSG_1005696,
+		    "%s: pthread_cond_init(%s): %s",
+		    diag, SEND_WINDOW_COND_DIAG, strerror(err));
+		gfarm_mutex_destroy(&gfmdc_peer->mutex,
+		    diag, PEER_RECORD_MUTEX_DIAG);
+		free(gfmdc_peer);
+		return (gfarm_errno_to_error(err));
+	}
 
 	/*
 	 * although gfmdc_peer->journal_send_closure is only used
@@ -229,6 +281,8 @@ gfmdc_peer_record_alloc(const char *diag,
 	 */
 	if ((e = gfmdc_journal_syncsend_alloc(diag,
 	    &gfmdc_peer->journal_send_closure)) != GFARM_ERR_NO_ERROR) {
+		gfarm_cond_destroy(&gfmdc_peer->send_window_cond,
+		    diag, SEND_WINDOW_COND_DIAG);
 		gfarm_mutex_destroy(&gfmdc_peer->mutex,
 		    diag, PEER_RECORD_MUTEX_DIAG);
 		free(gfmdc_peer);
@@ -239,6 +293,11 @@ gfmdc_peer_record_alloc(const char *diag,
 	gfmdc_peer->last_fetch_seqnum = 0;
 	gfmdc_peer->is_received_seqnum = 0;
 	gfmdc_peer->first_sync_completed = 0;
+	gfmdc_peer->nsending_frames = 0;
+	gfmdc_peer->sending_bytes = 0;
+	gfmdc_peer->acked_seqnum = 0;
+	gfmdc_peer->lag_reported = 0;
+	gfmdc_peer->lag_is_reported = 0;
 
 	*gfmdc_peerp = gfmdc_peer;
 	return (GFARM_ERR_NO_ERROR);
@@ -251,6 +310,8 @@ gfmdc_peer_record_free(struct gfmdc_peer_record *gfmdc_peer, const char *diag)
 	if (gfmdc_peer->jreader != NULL)
 		journal_file_reader_close(gfmdc_peer->jreader);
 	gfmdc_journal_syncsend_free(gfmdc_peer->journal_send_closure);
+	gfarm_cond_destroy(&gfmdc_peer->send_window_cond,
+	    diag, SEND_WINDOW_COND_DIAG);
 	gfarm_mutex_destroy(&gfmdc_peer->mutex, diag, PEER_RECORD_MUTEX_DIAG);
 	free(gfmdc_peer);
 }
@@ -373,6 +434,153 @@ gfmdc_peer_get_journal_send_closure(struct gfmdc_peer_record *gfmdc_peer)
 	return (gfmdc_peer->journal_send_closure);
 }
 
+/*
+ * flow control of journal records which are sent asynchronously.
+ * returns 0, if the window is full and (!wait || the slave is down)
+ */
+static int
+gfmdc_peer_send_window_acquire(struct gfmdc_peer_record *gfmdc_peer,
+	struct mdhost *mh, int wait)
+{
+	int window = gfarm_get_journal_send_window(), acquired = 1;
+	struct timespec ts;
+	static const char diag[] = "gfmdc_peer_send_window_acquire";
+
+	gfmdc_peer_mutex_lock(gfmdc_peer, diag);
+	while (window > 0 && gfmdc_peer->nsending_frames >= window) {
+		if (!wait || !mdhost_is_up(mh)) {
+			acquired = 0;
+			break;
+		}
+		gfarm_gettime(&ts);
+		ts.tv_sec += GFMDC_JOURNAL_SEND_WINDOW_WAIT;
+		gfarm_cond_timedwait(&gfmdc_peer->send_window_cond,
+		    &gfmdc_peer->mutex, &ts, diag, SEND_WINDOW_COND_DIAG);
+	}
+	if (acquired)
+		++gfmdc_peer->nsending_frames;
+	gfmdc_peer_mutex_unlock(gfmdc_peer, diag);
+	return (acquired);
+}
+
+static void
+gfmdc_peer_send_window_release(struct gfmdc_peer_record *gfmdc_peer)
+{
+	static const char diag[] = "gfmdc_peer_send_window_release";
+
+	gfmdc_peer_mutex_lock(gfmdc_peer, diag);
+	--gfmdc_peer->nsending_frames;
+	gfarm_cond_signal(&gfmdc_peer->send_window_cond,
+	    diag, SEND_WINDOW_COND_DIAG);
+	gfmdc_peer_mutex_unlock(gfmdc_peer, diag);
+}
+
+static void
+gfmdc_peer_add_sending_bytes(struct gfmdc_peer_record *gfmdc_peer,
+	gfarm_int64_t len)
+{
+	static const char diag[] = "gfmdc_peer_add_sending_bytes";
+
+	gfmdc_peer_mutex_lock(gfmdc_peer, diag);
+	gfmdc_peer->sending_bytes += len;
+	gfmdc_peer_mutex_unlock(gfmdc_peer, diag);
+}
+
+static void
+gfmdc_peer_set_acked_seqnum(struct gfmdc_peer_record *gfmdc_peer,
+	gfarm_uint64_t seqnum)
+{
+	static const char diag[] = "gfmdc_peer_set_acked_seqnum";
+
+	gfmdc_peer_mutex_lock(gfmdc_peer, diag);
+	if (gfmdc_peer->acked_seqnum < seqnum)
+		gfmdc_peer->acked_seqnum = seqnum;
+	gfmdc_peer_mutex_unlock(gfmdc_peer, diag);
+}
+
+/*
+ * replication lag is the number of journal records which are not
+ * acknowledged by the slave yet, and the size of them.
+ */
+static void
+gfmdc_peer_get_journal_lag(struct gfmdc_peer_record *gfmdc_peer,
+	gfarm_uint64_t *lag_seqnump, gfarm_uint64_t *lag_bytesp)
+{
+	gfarm_uint64_t cur_seqnum = db_journal_get_current_seqnum();
+	gfarm_uint64_t acked_seqnum, lag_bytes;
+	struct journal_file_reader *reader;
+	static const char diag[] = "gfmdc_peer_get_journal_lag";
+
+	gfmdc_peer_mutex_lock(gfmdc_peer, diag);
+	acked_seqnum = gfmdc_peer->acked_seqnum;
+	if (acked_seqnum == 0) /* nothing is acknowledged in this session */
+		acked_seqnum = gfmdc_peer->last_fetch_seqnum;
+	lag_bytes = gfmdc_peer->sending_bytes;
+	reader = gfmdc_peer->jreader;
+	gfmdc_peer_mutex_unlock(gfmdc_peer, diag);
+
+	if (reader != NULL)
+		lag_bytes += journal_file_reader_lag_bytes(reader);
+	*lag_seqnump = cur_seqnum > acked_seqnum ? cur_seqnum - acked_seqnum :
+	    0;
+	*lag_bytesp = lag_bytes;
+}
+
+static void
+gfmdc_peer_journal_lag_report(struct gfmdc_peer_record *gfmdc_peer,
+	struct mdhost *mh)
+{
+	gfarm_uint64_t lag_seqnum, lag_bytes;
+	time_t now = time(NULL);
+	int report = 0, caught_up = 0;
+	static const char diag[] = "gfmdc_peer_journal_lag_report";
+
+	gfmdc_peer_get_journal_lag(gfmdc_peer, &lag_seqnum, &lag_bytes);
+
+	gfmdc_peer_mutex_lock(gfmdc_peer, diag);
+	if (lag_seqnum > 0) {
+		if (now >= gfmdc_peer->lag_reported +
+		    GFMDC_JOURNAL_LAG_REPORT_INTERVAL) {
+			gfmdc_peer->lag_reported = now;
+			gfmdc_peer->lag_is_reported = 1;
+			report = 1;
+		}
+	} else if (gfmdc_peer->lag_is_reported) {
+		gfmdc_peer->lag_is_reported = 0;
+		caught_up = 1;
+	}
+	gfmdc_peer_mutex_unlock(gfmdc_peer, diag);
+
+	if (report)
+		gflog_info(GFARM_MSG_1005697,
+		    "%s: journal replication lag: %llu records, %llu bytes",
+		    mdhost_get_name(mh), (unsigned long long)lag_seqnum,
+		    (unsigned long long)lag_bytes);
+	else if (caught_up)
+		gflog_info(GFARM_MSG_1005698,
+		    "%s: journal replication caught up",
+		    mdhost_get_name(mh));
+}
+
+/* called when journal records are acknowledged, or the slave is gone */
+static void
+gfmdc_journal_send_done(struct gfmdc_journal_send_closure *c)
+{
+	struct gfmdc_peer_record *gfmdc_peer = c->gfmdc_peer;
+
+	if (gfmdc_peer == NULL) /* nothing has been sent */
+		return;
+	if (c->data != NULL)
+		gfmdc_peer_add_sending_bytes(gfmdc_peer,
+		    -(gfarm_int64_t)c->data_len);
+	if (c->windowed)
+		gfmdc_peer_send_window_release(gfmdc_peer);
+	if (c->acked)
+		gfmdc_peer_journal_lag_report(gfmdc_peer, c->host);
+	c->gfmdc_peer = NULL;
+	c->windowed = c->acked = 0;
+}
+
 /*
  * gfmd channel
  */
@@ -487,11 +695,17 @@ gfmdc_client_journal_send_result_common(void *p, void *arg, size_t size)
 	static const char *diag = "GFM_PROTO_JOURNAL_SEND";
 
 	if ((e = gfmdc_client_recv_result(peer, c->host, size, diag, ""))
-	    != GFARM_ERR_NO_ERROR)
+	    != GFARM_ERR_NO_ERROR) {
 		gflog_error(GFARM_MSG_1002976,
 		    "%s : %s", mdhost_get_name(c->host),
 		    gfarm_error_string(e));
-	else if (c->to_sn >= db_journal_get_current_seqnum())
+		return (e);
+	}
+	if (c->gfmdc_peer != NULL) {
+		gfmdc_peer_set_acked_seqnum(c->gfmdc_peer, c->to_sn);
+		c->acked = 1;
+	}
+	if (c->to_sn >= db_journal_get_current_seqnum())
 		mdhost_set_seqnum_ok(peer_get_mdhost(peer));
 	return (e);
 }
@@ -542,6 +756,33 @@ gfmdc_wait_journal_syncsend(struct gfmdc_journal_send_closure *c)
 	return (r);
 }
 
+#ifdef HAVE_LIBZ
+/* returns 0, if it's not worth compressing */
+static int
+gfmdc_journal_compress(const char *data, int data_len,
+	char **cdatap, int *cdata_lenp, const char *diag)
+{
+	char *cdata;
+	uLongf clen = compressBound(data_len);
+	int rv;
+
+	GFARM_MALLOC_ARRAY(cdata, clen);
+	if (cdata == NULL)
+		return (0);
+	if ((rv = compress2((Bytef *)cdata, &clen, (const Bytef *)data,
+	    data_len, Z_BEST_SPEED)) != Z_OK || clen >= data_len) {
+		if (rv != Z_OK)
+			gflog_notice(GFARM_MSG_1005699,
+			    "%s: compress2(): %d", diag, rv);
+		free(cdata);
+		return (0);
+	}
+	*cdatap = cdata;
+	*cdata_lenp = clen;
+	return (1);
+}
+#endif
+
 static gfarm_error_t
 gfmdc_client_journal_send(struct peer *peer,
 	gfarm_error_t (*result_op)(void *, void *, size_t),
@@ -550,20 +791,28 @@ gfmdc_client_journal_send(struct peer *peer,
 	gfarm_uint64_t *to_snp)
 {
 	gfarm_error_t e;
-	int data_len, no_rec;
-	char *data;
+	int data_len, no_rec, features, packed;
+	int codec = GFM_PROTO_JOURNAL_CODEC_NONE, send_len;
+	char *data, *send_data;
 	gfarm_uint64_t min_seqnum, from_sn, to_sn, lf_sn;
 	struct journal_file_reader *reader;
 	struct mdhost *mh = c->host;
 	struct gfmdc_peer_record *gfmdc_peer = peer_get_gfmdc_record(peer);
 	static const char diag[] = "GFM_PROTO_JOURNAL_SEND";
 
+	features = abstract_host_get_protocol_version(
+	    mdhost_to_abstract_host(mh)) &
+	    ~GFM_INTER_GFMD_PROTOCOL_VERSION_MASK;
+	packed = (features & GFM_INTER_GFMD_FEATURE_JOURNAL_PACKED) != 0;
+
 	lf_sn = gfmdc_peer_get_last_fetch_seqnum(gfmdc_peer);
 	min_seqnum = lf_sn == 0 ? 0 : lf_sn + 1;
 	reader = gfmdc_peer_get_journal_file_reader(gfmdc_peer);
 	assert(reader);
-	e = db_journal_fetch(reader, min_seqnum, &data, &data_len, &from_sn,
-	    &to_sn, &no_rec, mdhost_get_name(mh));
+	e = db_journal_fetch(reader, min_seqnum,
+	    packed ? gfarm_get_journal_send_frame_size() :
+	    GFMDC_JOURNAL_SEND_SIZE_LEGACY,
+	    &data, &data_len, &from_sn, &to_sn, &no_rec, mdhost_get_name(mh));
 	if (e != GFARM_ERR_NO_ERROR) {
 		mdhost_set_seqnum_state_by_error(mh, e);
 		gflog_notice(GFARM_MSG_1002977,
@@ -577,16 +826,40 @@ gfmdc_client_journal_send(struct peer *peer,
 	}
 	mdhost_set_seqnum_behind(mh);
 	gfmdc_peer_set_last_fetch_seqnum(gfmdc_peer, to_sn);
-	c->data = data;
-	c->to_sn = to_sn;
 
-	if ((e = gfmdc_client_send_request(mh, peer, diag,
-	    result_op, disconnect_op, c, GFMDC_SEND_DEFAULT_TIMEOUT,
-	    GFM_PROTO_JOURNAL_SEND, "llb", from_sn, to_sn,
-	    (size_t)data_len, data)) != GFARM_ERR_NO_ERROR) {
+	send_data = data;
+	send_len = data_len;
+#ifdef HAVE_LIBZ
+	if (packed && gfarm_get_journal_send_compression() &&
+	    (features & GFM_INTER_GFMD_FEATURE_JOURNAL_ZLIB) != 0 &&
+	    gfmdc_journal_compress(data, data_len, &send_data, &send_len,
+	    mdhost_get_name(mh))) {
+		free(data);
+		codec = GFM_PROTO_JOURNAL_CODEC_ZLIB;
+	}
+#endif
+	c->data = send_data;
+	c->data_len = data_len;
+	c->to_sn = to_sn;
+	c->gfmdc_peer = gfmdc_peer;
+	/* account before sending, the reply may arrive before we return */
+	gfmdc_peer_add_sending_bytes(gfmdc_peer, data_len);
+
+	if (packed)
+		e = gfmdc_client_send_request(mh, peer, diag,
+		    result_op, disconnect_op, c, GFMDC_SEND_DEFAULT_TIMEOUT,
+		    GFM_PROTO_JOURNAL_SEND_PACKED, "lliib", from_sn, to_sn,
+		    codec, data_len, (size_t)send_len, send_data);
+	else
+		e = gfmdc_client_send_request(mh, peer, diag,
+		    result_op, disconnect_op, c, GFMDC_SEND_DEFAULT_TIMEOUT,
+		    GFM_PROTO_JOURNAL_SEND, "llb", from_sn, to_sn,
+		    (size_t)send_len, send_data);
+	if (e != GFARM_ERR_NO_ERROR) {
 		gflog_error(GFARM_MSG_1002978,
 		    "%s: %s", mdhost_get_name(mh), gfarm_error_string(e));
-		free(data);
+		gfmdc_peer_add_sending_bytes(gfmdc_peer, -(gfarm_int64_t)data_len);
+		free(send_data);
 		c->data = NULL;
 		return (e);
 	}
@@ -657,6 +930,81 @@ gfmdc_server_journal_send(struct mdhost *mh, struct peer *peer,
 	return (e);
 }
 
+static gfarm_error_t
+gfmdc_server_journal_send_packed(struct mdhost *mh, struct peer *peer,
+	gfp_xdr_xid_t xid, size_t size)
+{
+	gfarm_error_t e, er = GFARM_ERR_NO_ERROR;
+	gfarm_uint64_t from_sn, to_sn;
+	gfarm_int32_t codec, raw_len;
+	unsigned char *data = NULL, *recs = NULL;
+	size_t data_len, recs_len = 0;
+	static const char diag[] = "GFM_PROTO_JOURNAL_SEND_PACKED";
+
+	e = gfmdc_server_get_request(peer, size, diag, "lliiB",
+	    &from_sn, &to_sn, &codec, &raw_len, &data_len, &data);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_error(GFARM_MSG_1005700, "from %s : %s: %s",
+		    mdhost_get_name(mh), diag, gfarm_error_string(e));
+		return (e);
+	}
+
+	switch (codec) {
+	case GFM_PROTO_JOURNAL_CODEC_NONE:
+		recs = data;
+		recs_len = data_len;
+		data = NULL;
+		break;
+#ifdef HAVE_LIBZ
+	case GFM_PROTO_JOURNAL_CODEC_ZLIB: {
+		uLongf len = raw_len;
+		int rv;
+
+		if (raw_len <= 0) {
+			er = GFARM_ERR_PROTOCOL;
+			break;
+		}
+		GFARM_MALLOC_ARRAY(recs, raw_len);
+		if (recs == NULL) {
+			er = GFARM_ERR_NO_MEMORY;
+			break;
+		}
+		if ((rv = uncompress(recs, &len, data, data_len)) != Z_OK ||
+		    len != raw_len) {
+			gflog_error(GFARM_MSG_1005701,
+			    "from %s : %s: uncompress(): %d, %lu/%d bytes",
+			    mdhost_get_name(mh), diag, rv,
+			    (unsigned long)len, (int)raw_len);
+			free(recs);
+			recs = NULL;
+			er = GFARM_ERR_PROTOCOL;
+			break;
+		}
+		recs_len = len;
+		break;
+	}
+#endif
+	default:
+		gflog_error(GFARM_MSG_1005702,
+		    "from %s : %s: unknown codec %d",
+		    mdhost_get_name(mh), diag, (int)codec);
+		er = GFARM_ERR_OPERATION_NOT_SUPPORTED;
+		break;
+	}
+	free(data);
+
+	if (er == GFARM_ERR_NO_ERROR) {
+		er = db_journal_recvq_enter(from_sn, to_sn, recs_len, recs);
+		if (er != GFARM_ERR_NO_ERROR) /* probably GFARM_ERR_NO_MEMORY */
+			gflog_error(GFARM_MSG_1005703,
+			    "from %s : %s: db_journal_recvq_enter(): %s",
+			    mdhost_get_name(mh), diag, gfarm_error_string(er));
+	}
+
+	e = gfmdc_server_put_reply_notimeout(mh, peer, xid, diag, er, "");
+	return (e);
+}
+
 static void* gfmdc_journal_first_sync_thread(void *);
 
 static gfarm_error_t
@@ -847,6 +1195,10 @@ gfmdc_protocol_switch(struct abstract_host *h,
 		/* in slave */
 		e = gfmdc_server_journal_send(mh, peer, xid, size);
 		break;
+	case GFM_PROTO_JOURNAL_SEND_PACKED:
+		/* in slave */
+		e = gfmdc_server_journal_send_packed(mh, peer, xid, size);
+		break;
 	default:
 		*unknown_request = 1;
 		e = GFARM_ERR_PROTOCOL;
@@ -1048,7 +1400,7 @@ gfmdc_connect(void)
 	}
 
 	if ((e = gfm_client_switch_gfmd_channel(gfm_server,
-	    GFM_INTER_GFMD_PROTOCOL_VERSION,
+	    GFM_INTER_GFMD_PROTOCOL_VERSION | GFMDC_INTER_GFMD_FEATURES,
 	    (gfarm_int64_t)hack_to_make_cookie_not_work,
 	    &gfmd_knows_me))
 	    != GFARM_ERR_NO_ERROR) {
@@ -1154,8 +1506,13 @@ gfmdc_journal_mdhost_can_sync(struct mdhost *mh,
 	    gfmdc_peer_get_journal_file_reader(gfmdc_peer) != NULL);
 }
 
+/*
+ * if `wait' is 0, GFARM_ERR_RESOURCE_TEMPORARILY_UNAVAILABLE is returned
+ * when the send window to the slave is full.
+ */
 static gfarm_error_t
-gfmdc_journal_asyncsend(struct mdhost *mh, struct peer *peer, int *exist_recsp)
+gfmdc_journal_asyncsend(struct mdhost *mh, struct peer *peer, int *exist_recsp,
+	int wait)
 {
 	gfarm_error_t e;
 	struct gfmdc_peer_record *gfmdc_peer = peer_get_gfmdc_record(peer);
@@ -1173,6 +1530,13 @@ gfmdc_journal_asyncsend(struct mdhost *mh, struct peer *peer, int *exist_recsp)
 		    "%s", gfarm_error_string(e));
 		return (e);
 	}
+	if (!gfmdc_peer_send_window_acquire(gfmdc_peer, mh, wait)) {
+		gfmdc_journal_asyncsend_free(c);
+		return (wait ? GFARM_ERR_CONNECTION_ABORTED :
+		    GFARM_ERR_RESOURCE_TEMPORARILY_UNAVAILABLE);
+	}
+	c->gfmdc_peer = gfmdc_peer;
+	c->windowed = 1;
 	if ((e = gfmdc_client_journal_asyncsend(peer, c, &to_sn))
 	    != GFARM_ERR_NO_ERROR) {
 		gfmdc_journal_asyncsend_free(c);
@@ -1190,14 +1554,16 @@ gfmdc_journal_asyncsend(struct mdhost *mh, struct peer *peer, int *exist_recsp)
 static int
 gfmdc_journal_asyncsend_each_mdhost(struct mdhost *mh, void *closure)
 {
-	int exist_recs;
+	int exist_recs, *blockedp = closure;
 	struct mdhost *self = mdhost_lookup_self();
 	struct peer *peer;
 
 	if (mh != self && !mdhost_is_sync_replication(mh)) {
 		peer = mdhost_get_peer(mh); /* increment refcount */
 		if (peer != NULL) {
-			(void)gfmdc_journal_asyncsend(mh, peer, &exist_recs);
+			if (gfmdc_journal_asyncsend(mh, peer, &exist_recs, 0)
+			    == GFARM_ERR_RESOURCE_TEMPORARILY_UNAVAILABLE)
+				*blockedp = 1;
 			mdhost_put_peer(mh, peer); /* decrement refcount */
 		}
 	}
@@ -1208,8 +1574,11 @@ void *
 gfmdc_journal_asyncsend_thread(void *arg)
 {
 	static const char diag[] = "gfmdc_journal_asyncsend_thread";
+	int blocked;
+	struct timespec ts;
 
 	for (;;) {
+		blocked = 0;
 		gfarm_mutex_lock(&journal_sync_info.async_mutex, diag,
 		    ASYNC_MUTEX_DIAG);
 		while (!mdhost_has_async_replication_target()) {
@@ -1217,10 +1586,19 @@ gfmdc_journal_asyncsend_thread(void *arg)
 			    &journal_sync_info.async_mutex,
 			    diag, ASYNC_WAIT_COND_DIAG);
 		}
-		mdhost_foreach(gfmdc_journal_asyncsend_each_mdhost, NULL);
+		mdhost_foreach(gfmdc_journal_asyncsend_each_mdhost, &blocked);
+		if (blocked) {
+			/* wait for acknowledgements from slaves */
+			gfarm_gettime(&ts);
+			ts.tv_sec += GFMDC_JOURNAL_SEND_WINDOW_WAIT;
+			gfarm_cond_timedwait(&journal_sync_info.async_wait_cond,
+			    &journal_sync_info.async_mutex, &ts,
+			    diag, ASYNC_WAIT_COND_DIAG);
+		}
 		gfarm_mutex_unlock(&journal_sync_info.async_mutex, diag,
 		    ASYNC_MUTEX_DIAG);
-		db_journal_wait_until_readable();
+		if (!blocked)
+			db_journal_wait_until_readable();
 	}
 	return (NULL);
 }
@@ -1443,6 +1821,12 @@ gfmdc_journal_sync_multiple(gfarm_uint64_t seqnum)
 
 	mdhost_foreach(gfmdc_journal_sync_count_host, &nhosts);
 	if (nhosts == 0) {
+		if (gfarm_get_journal_sync_file() &&
+		    gfarm_get_journal_sync_group_commit()) {
+			/* synced by db_journal_group_commit_thread() */
+			db_journal_group_commit_request(seqnum);
+			return (GFARM_ERR_NO_ERROR);
+		}
 		if (gfarm_get_journal_sync_file()) {
 			int e = db_journal_file_writer_sync();
 			if (e != GFARM_ERR_NO_ERROR) {
@@ -1521,7 +1905,7 @@ gfmdc_journal_first_sync_thread(void *closure)
 	}
 
 	while (exist_recs) {
-		if ((e = gfmdc_journal_asyncsend(mh, peer, &exist_recs))
+		if ((e = gfmdc_journal_asyncsend(mh, peer, &exist_recs, 1))
 		    != GFARM_ERR_NO_ERROR) {
 			gflog_error(GFARM_MSG_1003007,
 			    "%s : %s", mdhost_get_name(mh),
@@ -1705,6 +2089,9 @@ gfmdc_sync_init(void)
 
 	si->nrecv_threads = 0;
 	db_journal_set_sync_op(gfmdc_journal_sync_multiple);
+	if (gfarm_get_journal_sync_file() &&
+	    gfarm_get_journal_sync_group_commit())
+		db_journal_group_commit_init();
 }
 
 
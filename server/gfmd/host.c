@@ -47,6 +47,7 @@
 #include "dead_file_copy.h"
 #include "back_channel.h"
 #include "replica_check.h"
+#include "placement.h"
 
 #define HOST_HASHTAB_SIZE	3079	/* prime number */
 
@@ -105,6 +106,7 @@ struct host {
 	int is_readonly;	/* in-memory only */
 	struct host_status status;
 	gfarm_off_t disk_used_change_in_byte; /* in-memory only */
+	int replicating; /* in-memory only, # of incoming replications */
 	struct callout *status_callout;
 	gfarm_time_t last_report;
 	gfarm_time_t disconnect_time;
@@ -630,6 +632,14 @@ host_supports_status2_protocols(struct host *h)
 		>= GFS_PROTOCOL_VERSION_V2_7_13);
 }
 
+/* support GFS_PROTO_FHREMOVE_MULTI */
+int
+host_supports_fhremove_multi_protocols(struct host *h)
+{
+	return (abstract_host_get_protocol_version(&h->ah)
+		>= GFS_PROTOCOL_VERSION_V2_8_4);
+}
+
 #ifdef COMPAT_GFARM_2_3
 
 void
@@ -890,10 +900,15 @@ static struct peer *
 host_get_peer_for_replication(struct host *h)
 {
 	struct peer *peer = host_get_peer(h);
+	static const char diag[] = "host_get_peer_for_replication";
 
 	if (peer != NULL) {
 		peer_add_ref_for_replication(peer);
 		host_put_peer(h, peer);
+
+		abstract_host_mutex_lock(&h->ah, diag);
+		++h->replicating;
+		abstract_host_mutex_unlock(&h->ah, diag);
 	}
 	return (peer);
 }
@@ -901,6 +916,12 @@ host_get_peer_for_replication(struct host *h)
 void
 host_put_peer_for_replication(struct host *h, struct peer *peer)
 {
+	static const char diag[] = "host_put_peer_for_replication";
+
+	abstract_host_mutex_lock(&h->ah, diag);
+	--h->replicating;
+	abstract_host_mutex_unlock(&h->ah, diag);
+
 	peer_del_ref_for_replication(peer);
 }
 
@@ -1242,6 +1263,7 @@ host_new(struct gfarm_host_info *hi, struct callout *callout)
 	h->status.loadavg_1min =
 	h->status.loadavg_5min =
 	h->status.loadavg_15min = 0.0;
+	h->replicating = 0;
 	h->status.disk_used =
 	h->status.disk_avail = 0;
 	h->disk_used_change_in_byte = 0;
@@ -1417,12 +1439,80 @@ host_number()
 }
 
 /*
- * just select randomly		XXX FIXME: needs to improve
+ * PREREQUISITE: giant_lock (for h->hi and gfarm_get_minimum_free_disk_space())
+ * LOCKS: host::acstract_host::mutex
+ * SLEEPS: no
+ *
+ * the weight used by "replica_placement", see placement.c.
+ * free space above minimum_free_disk_space is taken into account,
+ * only if `is_destination'.
+ */
+static double
+host_placement_weight(struct host *h, int is_destination)
+{
+	gfarm_uint64_t avail = 0;
+	gfarm_off_t minfree = gfarm_get_minimum_free_disk_space();
+	struct host_status status;
+	int replicating;
+	static const char diag[] = "host_placement_weight";
+
+	abstract_host_mutex_lock(&h->ah, diag);
+	host_status_get_unlocked(h, &status, 0);
+	if (host_is_up_unlocked(h))
+		avail = AVAIL_SUB(status.disk_avail * 1024,
+		    h->disk_used_change_in_byte);
+	replicating = h->replicating;
+	abstract_host_mutex_unlock(&h->ah, diag);
+
+	if (!is_destination)
+		return (placement_source_weight(status.loadavg_1min,
+		    h->hi.ncpu, replicating));
+	avail = avail > minfree ? avail - minfree : 0;
+	return (placement_weight(avail, status.loadavg_1min, h->hi.ncpu,
+	    replicating));
+}
+
+/*
+ * select hosts[results[0 ... nresults-1]] from hosts[0 ... nhosts-1]
+ * by the policy of the "replica_placement" directive.
+ * returns 0, if memory is exhausted.
+ */
+static int
+host_placement_select(int policy, int nhosts, struct host **hosts,
+	int is_destination, int nresults, int *results)
+{
+	double *weights;
+	int i, *index;
+
+	GFARM_MALLOC_ARRAY(weights, nhosts);
+	GFARM_MALLOC_ARRAY(index, nhosts);
+	if (weights == NULL || index == NULL) {
+		free(weights);
+		free(index);
+		return (0);
+	}
+	for (i = 0; i < nhosts; i++)
+		weights[i] = host_placement_weight(hosts[i], is_destination);
+	placement_select(policy, nhosts, weights, index, nresults, results);
+	free(index);
+	free(weights);
+	return (1);
+}
+
+/*
+ * select a replication source by the "replica_placement" policy,
+ * which prefers a less loaded host if it's not "random".
  */
 int
 host_select_one(int nhosts, struct host **hosts, const char *diag)
 {
+	int i;
+
 	if (nhosts > 1) {
+		if (gfarm_replica_placement != GFARM_REPLICA_PLACEMENT_RANDOM
+		    && host_placement_select(gfarm_replica_placement,
+		    nhosts, hosts, 0, 1, &i))
+			return (i);
 		return (gfarm_random() % nhosts);
 	}
 	if (nhosts <= 0) {
@@ -2845,7 +2935,7 @@ hostset_collect_host_id(struct hostset *hs, int *host_id_array)
 
 
 /*
- * just select randomly		XXX FIXME: needs to improve
+ * just select randomly, used by "replica_placement random"
  */
 static void
 select_hosts(int nsrc, int *src, int nresults, int *results)
@@ -2861,7 +2951,7 @@ select_hosts(int nsrc, int *src, int nresults, int *results)
 }
 
 static gfarm_error_t
-hostset_select_n(struct hostset *scope, int n_shortage,
+hostset_select_n(struct hostset *scope, int n_shortage, int policy,
 	int *n_targetsp, struct host ***targetsp)
 {
 	int n_scope = hostset_count_hosts(scope);
@@ -2876,7 +2966,35 @@ hostset_select_n(struct hostset *scope, int n_shortage,
 		hostset_to_hosts(scope, targets);
 		*n_targetsp = n_scope;
 
-	} else { /* too enough targets */
+	} else if (policy != GFARM_REPLICA_PLACEMENT_RANDOM) {
+		struct host **scope_hosts;
+		int *results;
+
+		GFARM_MALLOC_ARRAY(scope_hosts, n_scope);
+		GFARM_MALLOC_ARRAY(results, n_shortage);
+		GFARM_MALLOC_ARRAY(targets, n_shortage);
+		if (scope_hosts == NULL || results == NULL || targets == NULL) {
+			free(targets);
+			free(results);
+			free(scope_hosts);
+			return (GFARM_ERR_NO_MEMORY);
+		}
+		hostset_to_hosts(scope, scope_hosts);
+		if (!host_placement_select(policy, n_scope, scope_hosts, 1,
+		    n_shortage, results)) {
+			free(targets);
+			free(results);
+			free(scope_hosts);
+			return (GFARM_ERR_NO_MEMORY);
+		}
+		for (i = 0; i < n_shortage; i++)
+			targets[i] = scope_hosts[results[i]];
+		free(results);
+		free(scope_hosts);
+
+		*n_targetsp = n_shortage;
+
+	} else { /* too enough targets, select randomly */
 
 		GFARM_MALLOC_ARRAY(scope_host_id_array, n_scope);
 		if (scope_host_id_array == NULL)
@@ -2918,6 +3036,9 @@ hostset_select_n(struct hostset *scope, int n_shortage,
  * *n_validp > n_desired: already too enough
  * n_desired <= *n_validp + *n_taregetsp: will be enough
  * n_desired >  *n_validp + *n_taregetsp: shortage
+ *
+ * `fsngroup' is used to choose the "replica_placement" policy,
+ * NULL means the default policy.
  */
 gfarm_error_t
 hostset_schedule_n_except(
@@ -2925,7 +3046,7 @@ hostset_schedule_n_except(
 	struct hostset *existing, gfarm_time_t grace,
 	struct hostset *being_removed,
 	int (*filter)(struct host *, void *), void *closure,
-	int n_desired,
+	int n_desired, const char *fsngroup,
 	int *n_targetsp, struct host ***targetsp, int *n_validp)
 {
 	int n_shortage, n_up = 0;
@@ -2952,7 +3073,9 @@ hostset_schedule_n_except(
 	hostset_except(scope, existing);
 
 	hostset_filter(scope, filter, closure);
-	return (hostset_select_n(scope, n_shortage, n_targetsp, targetsp));
+	return (hostset_select_n(scope, n_shortage,
+	    gfarm_replica_placement_of_fsngroup(fsngroup),
+	    n_targetsp, targetsp));
 }
 
 /*
@@ -43,6 +43,7 @@ char *host_fsngroup(struct host *);
 int host_supports_async_protocols(struct host *);
 int host_supports_cksum_protocols(struct host *);
 int host_supports_status2_protocols(struct host *);
+int host_supports_fhremove_multi_protocols(struct host *);
 int host_is_disk_available(struct host *, gfarm_off_t);
 int host_is_readonly(struct host *);
 int host_is_file_removable(struct host *);
@@ -146,5 +147,5 @@ gfarm_error_t hostset_schedule_n_except(struct hostset *,
 	struct hostset *, gfarm_time_t grace,
 	struct hostset *,
 	int (*)(struct host *, void *), void *,
-	int,
+	int, const char *,
 	int *, struct host ***, int *);
@@ -36,6 +36,7 @@
 #include "subr.h"
 #include "inum_string_list.h"
 #include "db_access.h"
+#include "db_snapshot.h"
 #include "tenant.h"
 #include "host.h"
 #include "user.h"
@@ -49,6 +50,8 @@
 #include "back_channel.h"
 #include "acl.h"
 #include "xattr.h"
+#include "xattr_name.h"
+#include "xattr_index.h"
 #include "fsngroup.h"
 #include "dirset.h"
 #include "quota_dir.h"
@@ -61,8 +64,40 @@
 #define DIR_DEPTH_BUF_INIT			1024	/* == GFARM_PATH_MAX */
 
 #define ROOT_INUMBER			2
-#define INODE_TABLE_SIZE_INITIAL	1024
-#define INODE_TABLE_SIZE_MULTIPLY	2
+
+/*
+ * the inode table consists of segments of INODE_TABLE_SEGMENT_SIZE entries.
+ * a segment is never moved once allocated, thus the table grows without
+ * copying entries, and inode_lookup() can read a slot without the giant lock.
+ * segments are always allocated from the lowest one without a hole.
+ */
+#define INODE_TABLE_SEGMENT_SHIFT	16
+#define INODE_TABLE_SEGMENT_SIZE	((gfarm_ino_t)1 << INODE_TABLE_SEGMENT_SHIFT)
+#define INODE_TABLE_SEGMENT_MASK	(INODE_TABLE_SEGMENT_SIZE - 1)
+#define INODE_TABLE_SEGMENTS_MAX	((gfarm_ino_t)1 << 20)
+
+/*
+ * publish/subscribe a slot of the inode table, without the giant lock.
+ * INODE_TABLE_LOCK() is only necessary where the compiler doesn't provide
+ * atomic builtins.
+ */
+#ifdef __GNUC__
+#define INODE_TABLE_LOAD(var)		__atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#define INODE_TABLE_STORE(var, val) \
+	__atomic_store_n(&(var), (val), __ATOMIC_RELEASE)
+#define INODE_TABLE_LOCK(diag)
+#define INODE_TABLE_UNLOCK(diag)
+#else
+static pthread_mutex_t inode_table_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char inode_table_diag[] = "inode_table";
+
+#define INODE_TABLE_LOAD(var)		(var)
+#define INODE_TABLE_STORE(var, val)	((var) = (val))
+#define INODE_TABLE_LOCK(diag) \
+	gfarm_mutex_lock(&inode_table_mutex, diag, inode_table_diag)
+#define INODE_TABLE_UNLOCK(diag) \
+	gfarm_mutex_unlock(&inode_table_mutex, diag, inode_table_diag)
+#endif
 
 #define INODE_MODE_FREE			0	/* struct inode:i_mode */
 
@@ -96,17 +131,33 @@ static const char xattr_ncopy[] = GFARM_EA_NCOPY;
 static const char xattr_repattr[] = GFARM_EA_REPATTR;
 static const char xattr_all[] = "*";
 
+/*
+ * extended attributes of an inode are kept in an array in the order of
+ * their creation, which listxattr reports, and XATTRS_SORTED() holds the
+ * indexes of the entries sorted by the interned name id (see xattr_name.c)
+ * for lookups.  the sorted indexes are allocated in the same block after
+ * the entries, so that struct xattrs of every inode stays small.
+ * a cached value which fits in a pointer is stored in the entry itself.
+ */
+#define XATTR_INLINE_VALUE_SIZE	sizeof(void *)
+
 struct xattr_entry {
-	struct xattr_entry *prev, *next;
-	char *name;
-	void *cached_attrvalue;
-	int cached_attrsize;
+	int name_id;
+	int cached_attrsize;	/* -1, if the value is not cached */
+	union {
+		void *ptr;	/* if the value doesn't fit in the union */
+		char inline_value[XATTR_INLINE_VALUE_SIZE];
+	} v;
 };
 
 struct xattrs {
-	struct xattr_entry *head, *tail;
+	struct xattr_entry *entries;	/* in the order of creation */
+	int n, nalloc;
 };
 
+/* indexes of entries, by name_id */
+#define XATTRS_SORTED(xattrs)	((int *)&(xattrs)->entries[(xattrs)->nalloc])
+
 struct inode {
 	gfarm_ino_t i_number;
 	gfarm_uint64_t i_gen;
@@ -188,9 +239,9 @@ static void file_replicating_free(struct file_replicating *);
 static void file_replicating_free_by_error_before_request(
 	struct file_replicating *);
 
-struct inode **inode_table = NULL;
-gfarm_ino_t inode_table_size = 0;
-gfarm_ino_t inode_free_index = ROOT_INUMBER;
+static struct inode **inode_table[INODE_TABLE_SEGMENTS_MAX];
+static gfarm_ino_t inode_table_size = 0; /* # of entries in the segments */
+static gfarm_ino_t inode_free_index = ROOT_INUMBER;
 
 static char TENANT_BASE_NAME[] = ".tenants"; /* for /.tenants/${TENANT_NAME} */
 
@@ -638,26 +689,75 @@ inode_cksum_get_on_host(struct inode *inode, struct host *spool_host,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+static const char *
+xattr_entry_name(struct xattr_entry *entry)
+{
+	return (xattr_name_get(entry->name_id));
+}
+
+/* returns NULL, if the value is not cached */
+static void *
+xattr_entry_value(struct xattr_entry *entry)
+{
+	if (entry->cached_attrsize < 0)
+		return (NULL);
+	if (entry->cached_attrsize <= (int)XATTR_INLINE_VALUE_SIZE)
+		return (entry->v.inline_value);
+	return (entry->v.ptr);
+}
+
+static size_t
+xattr_entry_value_size(struct xattr_entry *entry)
+{
+	return (entry->cached_attrsize < 0 ? 0 : entry->cached_attrsize);
+}
+
+static void
+xattr_entry_uncache(struct xattr_entry *entry)
+{
+	if (entry->cached_attrsize > (int)XATTR_INLINE_VALUE_SIZE)
+		free(entry->v.ptr);
+	entry->cached_attrsize = -1;
+}
+
+/* returns 0, if no memory */
+static int
+xattr_entry_cache(struct xattr_entry *entry, const void *value, size_t size)
+{
+	void *p;
+
+	xattr_entry_uncache(entry);
+	if (size <= XATTR_INLINE_VALUE_SIZE) {
+		p = entry->v.inline_value;
+	} else {
+		if ((p = malloc(size)) == NULL)
+			return (0);
+		entry->v.ptr = p;
+	}
+	memcpy(p, value, size);
+	entry->cached_attrsize = size;
+	return (1);
+}
+
 static void
 xattrs_init(struct xattrs *xattrs)
 {
-	xattrs->head = xattrs->tail =NULL;
+	xattrs->entries = NULL;
+	xattrs->n = xattrs->nalloc = 0;
 }
 
 static void
-xattrs_free_entries(struct xattrs *xattrs)
+xattrs_free_entries(struct xattrs *xattrs, int xmlMode, gfarm_ino_t inum)
 {
-	struct xattr_entry *entry = xattrs->head, *next;
-	while (entry != NULL) {
-		free(entry->name);
-		if (entry->cached_attrvalue != NULL)
-			free(entry->cached_attrvalue);
-		next = entry->next;
-		free(entry);
-		entry = next;
+	int i;
+
+	for (i = 0; i < xattrs->n; i++) {
+		xattr_index_remove(xmlMode, xattrs->entries[i].name_id, inum);
+		xattr_entry_uncache(&xattrs->entries[i]);
+		xattr_name_unref(xattrs->entries[i].name_id);
 	}
-	xattrs->head = NULL;
-	xattrs->tail = NULL;
+	free(xattrs->entries);
+	xattrs_init(xattrs);
 }
 
 static void
@@ -670,8 +770,8 @@ inode_xattrs_init(struct inode *inode)
 void
 inode_xattrs_clear(struct inode *inode)
 {
-	xattrs_free_entries(&inode->i_xattrs);
-	xattrs_free_entries(&inode->i_xmlattrs);
+	xattrs_free_entries(&inode->i_xattrs, 0, inode->i_number);
+	xattrs_free_entries(&inode->i_xmlattrs, 1, inode->i_number);
 }
 
 static void
@@ -680,9 +780,9 @@ remove_all_xattrs(struct inode *inode, int xmlMode)
 	gfarm_error_t e;
 	struct xattrs *xattrs = xmlMode ?
 		&inode->i_xmlattrs : &inode->i_xattrs;
-	struct xattr_entry *entry = NULL;
+	int i;
 
-	if (xattrs->head == NULL)
+	if (xattrs->n == 0)
 		return;
 
 	e = db_xattr_removeall(xmlMode, inode->i_number);
@@ -693,13 +793,12 @@ remove_all_xattrs(struct inode *inode, int xmlMode)
 			    gfarm_error_string(e));
 		return;
 	}
-	entry = xattrs->head;
-	while (entry != NULL) {
-		e = db_xattr_remove(xmlMode, inode->i_number, entry->name);
+	for (i = 0; i < xattrs->n; i++) {
+		e = db_xattr_remove(xmlMode, inode->i_number,
+		    xattr_entry_name(&xattrs->entries[i]));
 		if (e != GFARM_ERR_NO_ERROR)
 			gflog_warning(GFARM_MSG_1000299, "remove xattr: %s",
 				gfarm_error_string(e));
-		entry = entry->next;
 	}
 }
 
@@ -801,36 +900,55 @@ inode_free_list_init(void)
 	inode_free_list_initialized = 1;
 }
 
+/* the caller should hold the giant lock */
+static int
+inode_table_grow(gfarm_ino_t inum)
+{
+	gfarm_ino_t seg = inode_table_size >> INODE_TABLE_SEGMENT_SHIFT;
+	struct inode **segment;
+	static const char diag[] = "inode_table_grow";
+
+	if ((inum >> INODE_TABLE_SEGMENT_SHIFT) >= INODE_TABLE_SEGMENTS_MAX) {
+		gflog_error(GFARM_MSG_1005677,
+		    "%s: inode %llu exceeds the limit %llu", diag,
+		    (unsigned long long)inum, (unsigned long long)
+		    (INODE_TABLE_SEGMENTS_MAX * INODE_TABLE_SEGMENT_SIZE));
+		return (0);
+	}
+	for (; inode_table_size <= inum; seg++) {
+		GFARM_CALLOC_ARRAY(segment, INODE_TABLE_SEGMENT_SIZE);
+		if (segment == NULL) {
+			gflog_error(GFARM_MSG_1004329, "%s: no memory", diag);
+			return (0); /* no memory */
+		}
+		INODE_TABLE_LOCK(diag);
+		INODE_TABLE_STORE(inode_table[seg], segment);
+		INODE_TABLE_STORE(inode_table_size,
+		    inode_table_size + INODE_TABLE_SEGMENT_SIZE);
+		INODE_TABLE_UNLOCK(diag);
+	}
+	return (1);
+}
+
+static struct inode **
+inode_table_slot(gfarm_ino_t inum)
+{
+	return (&inode_table[inum >> INODE_TABLE_SEGMENT_SHIFT]
+	    [inum & INODE_TABLE_SEGMENT_MASK]);
+}
+
 struct inode *
 inode_alloc_num(gfarm_ino_t inum)
 {
-	gfarm_ino_t i;
-	struct inode *inode;
+	struct inode *inode, **slot;
 	static const char diag[] = "inode_alloc_num";
 
 	if (inum < ROOT_INUMBER)
 		return (NULL); /* we don't use 0 and 1 as i_number */
-	if (inode_table_size <= inum) {
-		gfarm_ino_t new_table_size;
-		struct inode **p;
-
-		new_table_size = inode_table_size * INODE_TABLE_SIZE_MULTIPLY;
-		if (new_table_size <= inum)
-			new_table_size = inum * INODE_TABLE_SIZE_MULTIPLY;
-		if (new_table_size < INODE_TABLE_SIZE_INITIAL)
-			new_table_size = INODE_TABLE_SIZE_INITIAL;
-		GFARM_REALLOC_ARRAY(p, inode_table, new_table_size);
-		if (p == NULL) {
-			gflog_error(GFARM_MSG_1004329, "%s: no memory", diag);
-			return (NULL); /* no memory */
-		}
-		inode_table = p;
-
-		for (i = inode_table_size; i < new_table_size; i++)
-			inode_table[i] = NULL;
-		inode_table_size = new_table_size;
-	}
-	if ((inode = inode_table[inum]) == NULL) {
+	if (inode_table_size <= inum && !inode_table_grow(inum))
+		return (NULL);
+	slot = inode_table_slot(inum);
+	if ((inode = *slot) == NULL) {
 		GFARM_MALLOC(inode);
 		if (inode == NULL) {
 			gflog_error(GFARM_MSG_1004330, "%s: no memory", diag);
@@ -840,13 +958,16 @@ inode_alloc_num(gfarm_ino_t inum)
 
 		inode->i_number = inum;
 		inode->i_gen = 0;
-		inode_table[inum] = inode;
+		INODE_TABLE_LOCK(diag);
+		INODE_TABLE_STORE(*slot, inode);
+		INODE_TABLE_UNLOCK(diag);
 
 		/* update inode_free_index */
 		if (inum == inode_free_index) { /* always true for now */
 			while (++inode_free_index < inode_table_size) {
 				/* the following is always true for now */
-				if (inode_table[inode_free_index] == NULL)
+				if (*inode_table_slot(inode_free_index)
+				    == NULL)
 					break;
 			}
 		}
@@ -1021,10 +1142,12 @@ static struct gflog_reduced_state rep_fixed_state =
  * and being_removed[] but they may be abled to be used later.
  *
  * srcs[] must be different from existing[].
+ * `fsngroup' is the fsngroup of `scope', or NULL if it's not an fsngroup.
  */
 gfarm_error_t
 inode_schedule_replication_within_scope(
 	struct inode *inode, struct dirset *tdirset, int n_desired,
+	const char *fsngroup,
 	int n_srcs, struct host **srcs, int *next_src_indexp,
 	int *n_scopep, struct hostset *scope,
 	int *n_existingp, struct hostset *existing, gfarm_time_t grace,
@@ -1040,7 +1163,7 @@ inode_schedule_replication_within_scope(
 	necessary_space = inode_get_size(inode);
 	e = hostset_schedule_n_except(scope, existing, grace, being_removed,
 	    host_is_not_busy_and_disk_available_filter, &necessary_space,
-	    n_desired, &n_targets, &targets, &n_valid);
+	    n_desired, fsngroup, &n_targets, &targets, &n_valid);
 	if (e != GFARM_ERR_NO_ERROR) {
 		gflog_warning(GFARM_MSG_1003693,
 		    "%s: inode %lld:%lld: cannot create replicas: "
@@ -1207,7 +1330,7 @@ inode_schedule_replication_from_all(
 	}
 	next_src_index = host_select_one(n_srcs, srcs, diag);
 	e = inode_schedule_replication_within_scope(
-	    inode, tdirset, n_desired, n_srcs, srcs, &next_src_index,
+	    inode, tdirset, n_desired, NULL, n_srcs, srcs, &next_src_index,
 	    &n_all_hosts, all_hosts, n_existingp, existing, grace,
 	    n_being_removedp, being_removed, diag, req_ok_nump);
 	hostset_free(all_hosts);
@@ -1725,17 +1848,26 @@ inode_root_number()
 gfarm_ino_t
 inode_table_current_size()
 {
-	return (inode_table_size);
+	gfarm_ino_t size;
+
+	INODE_TABLE_LOCK(__func__);
+	size = INODE_TABLE_LOAD(inode_table_size);
+	INODE_TABLE_UNLOCK(__func__);
+	return (size);
 }
 
+/* this doesn't require the giant lock to read the table */
 struct inode *
 inode_lookup(gfarm_ino_t inum)
 {
 	struct inode *inode;
 
-	if (inum >= inode_table_size)
-		return (NULL);
-	inode = inode_table[inum];
+	INODE_TABLE_LOCK(__func__);
+	if (inum >= INODE_TABLE_LOAD(inode_table_size))
+		inode = NULL;
+	else
+		inode = INODE_TABLE_LOAD(*inode_table_slot(inum));
+	INODE_TABLE_UNLOCK(__func__);
 	if (inode == NULL)
 		return (NULL);
 	if (inode->i_mode == INODE_MODE_FREE)
@@ -1746,12 +1878,18 @@ inode_lookup(gfarm_ino_t inum)
 void
 inode_lookup_all(void *closure, void (*callback)(void *, struct inode *))
 {
-	gfarm_ino_t i;
-
-	for (i = ROOT_INUMBER; i < inode_table_size; i++) {
-		if (inode_table[i] != NULL &&
-		    inode_table[i]->i_mode != INODE_MODE_FREE)
-			callback(closure, inode_table[i]);
+	gfarm_ino_t seg, i;
+	struct inode **segment, *inode;
+
+	for (seg = 0; seg < inode_table_size >> INODE_TABLE_SEGMENT_SHIFT;
+	    seg++) {
+		segment = inode_table[seg];
+		for (i = seg == 0 ? ROOT_INUMBER : 0;
+		    i < INODE_TABLE_SEGMENT_SIZE; i++) {
+			inode = segment[i];
+			if (inode != NULL && inode->i_mode != INODE_MODE_FREE)
+				callback(closure, inode);
+		}
 	}
 }
 
@@ -2417,21 +2555,28 @@ inode_set_atime_switch(struct inode *inode, struct gfarm_timespec *atime)
 	inode_set_atime(inode, atime);
 }
 
-static void
-inode_set_relatime_main(struct inode *inode, struct gfarm_timespec *atime)
+/* true: relatime doesn't have to update the atime */
+static int
+inode_relatime_is_fresh(struct inode *inode, struct gfarm_timespec *atime)
 {
 	struct gfarm_timespec sub;
 	static struct gfarm_timespec a_day
 		= { .tv_sec = 24 * 60 * 60, .tv_nsec = 0 };
 
-	if (atime == NULL)
-		return;
-
 	sub = *atime;
 	gfarm_timespec_sub(&sub, &inode->i_atimespec);
-	if (gfarm_timespec_cmp(&sub, &a_day) <= 0 &&
+	return (gfarm_timespec_cmp(&sub, &a_day) <= 0 &&
 	    gfarm_timespec_cmp(&inode->i_atimespec, &inode->i_ctimespec) > 0 &&
-	    gfarm_timespec_cmp(&inode->i_atimespec, &inode->i_mtimespec) > 0)
+	    gfarm_timespec_cmp(&inode->i_atimespec, &inode->i_mtimespec) > 0);
+}
+
+static void
+inode_set_relatime_main(struct inode *inode, struct gfarm_timespec *atime)
+{
+	if (atime == NULL)
+		return;
+
+	if (inode_relatime_is_fresh(inode, atime))
 		return;
 
 	inode_set_atime(inode, atime);
@@ -2527,6 +2672,27 @@ inode_accessed(struct inode *inode)
 	inode_set_relatime(inode, &ts);
 }
 
+/*
+ * whether inode_accessed() will update the atime or not.
+ * this doesn't modify the inode, thus giant_lock_shared() is enough.
+ */
+int
+inode_accessed_needs_update(struct inode *inode)
+{
+	struct gfarm_timespec ts;
+
+	switch (gfarm_atime_type_get()) {
+	case GFARM_ATIME_DISABLE:
+		return (0);
+	case GFARM_ATIME_RELATIVE:
+		touch(&ts);
+		return (!inode_relatime_is_fresh(inode, &ts));
+	case GFARM_ATIME_STRICT:
+	default:
+		return (1);
+	}
+}
+
 void
 inode_modified(struct inode *inode)
 {
@@ -3645,6 +3811,116 @@ inode_lookup_by_name(struct inode *base, const char *name,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+/*
+ * lookup relative pathname which may consist of multiple components,
+ * without following any symbolic link.
+ * GFARM_ERR_IS_A_SYMBOLIC_LINK is returned, if an intermediate component
+ * is a symbolic link, since it has to be resolved by the client.
+ */
+gfarm_error_t
+inode_lookup_path_no_follow(struct inode *base, const char *path,
+	struct process *process, struct inode **inp)
+{
+	gfarm_error_t e;
+	struct inode *n = base;
+	char name[GFS_MAXNAMLEN + 1];
+	int len;
+
+	for (;;) {
+		while (*path == '/')
+			path++;
+		if (*path == '\0')
+			break;
+		len = strcspn(path, "/");
+		if (len > GFS_MAXNAMLEN)
+			return (GFARM_ERR_FILE_NAME_TOO_LONG);
+		if (inode_is_symlink(n))
+			return (GFARM_ERR_IS_A_SYMBOLIC_LINK);
+		memcpy(name, path, len);
+		name[len] = '\0';
+		if ((e = inode_lookup_by_name(n, name, process, &n))
+		    != GFARM_ERR_NO_ERROR)
+			return (e);
+		path += len;
+	}
+	*inp = n;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * lookup the directories in a pathname for GFM_PROTO_LOOKUP_PATH.
+ * each component is looked up as GFM_PROTO_OPEN with GFARM_FILE_LOOKUP
+ * does, and the lookup stops after a component which is not a directory.
+ * the inodes looked up are stored in inodes[], which must have room for
+ * strlen(path) / 2 + 1 entries, and *np is set to the number of them.
+ */
+gfarm_error_t
+inode_lookup_dir_path(struct inode *base, const char *path,
+	struct process *process, struct dirset **tdirsetp,
+	struct inode **inodes, int *np)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	struct inode *n = base;
+	char name[GFS_MAXNAMLEN + 1];
+	int i = 0, len;
+
+	for (;;) {
+		while (*path == '/')
+			path++;
+		if (*path == '\0' || !inode_is_dir(n))
+			break;
+		len = strcspn(path, "/");
+		if (len > GFS_MAXNAMLEN) {
+			e = GFARM_ERR_FILE_NAME_TOO_LONG;
+			break;
+		}
+		memcpy(name, path, len);
+		name[len] = '\0';
+		if ((e = inode_lookup_for_open(n, name, process, 0, tdirsetp,
+		    &n)) != GFARM_ERR_NO_ERROR)
+			break;
+		inodes[i++] = n;
+		path += len;
+	}
+	*np = i;
+	return (e);
+}
+
+/*
+ * lookup a directory which a client has cached by its inode number.
+ * every ancestor up to the root of the process must be searchable,
+ * as if the directory were looked up by its pathname.
+ */
+gfarm_error_t
+inode_lookup_cached_dir(gfarm_ino_t inum, gfarm_uint64_t gen,
+	struct process *process, struct inode **inp)
+{
+	gfarm_error_t e;
+	struct inode *inode = inode_lookup(inum), *dir;
+	gfarm_ino_t root_inum = process_get_root_inum(process);
+	DirEntry entry;
+
+	if (inode == NULL || inode->i_gen != gen || !inode_is_dir(inode))
+		return (GFARM_ERR_STALE_FILE_HANDLE);
+	for (dir = inode; dir->i_number != root_inum;) {
+		/* not under the root of the process */
+		if (dir->i_number == ROOT_INUMBER)
+			return (GFARM_ERR_STALE_FILE_HANDLE);
+		entry = dir_lookup(dir->u.c.s.d.entries, DOTDOT, DOTDOT_LEN);
+		if (entry == NULL)
+			return (GFARM_ERR_STALE_FILE_HANDLE);
+		dir = dir_entry_get_inode(entry);
+		if ((e = inode_access(dir, process_get_tenant(process),
+		    process_get_user(process), GFS_X_OK))
+		    != GFARM_ERR_NO_ERROR)
+			return (e);
+	}
+	if (dir->i_gen != process_get_root_igen(process))
+		return (GFARM_ERR_STALE_FILE_HANDLE);
+	*inp = inode;
+	return (GFARM_ERR_NO_ERROR);
+}
+
 gfarm_error_t
 inode_lookup_user_root(struct user *u, struct inode **inodep)
 {
@@ -4892,7 +5168,7 @@ inode_rename(
 		if (sdir != ddir && (inode_is_dir(src) || inode_is_file(src))
 		    && (!inode_has_desired_number(src, &num) &&
 			!inode_has_repattr(src, NULL)))
-			replica_check_start_move();
+			replica_check_start_move(src, ddir);
 	}
 	/* db_inode_nlink_modify() is not necessary, because it's unchanged */
 	return (e);
@@ -8158,71 +8434,73 @@ dir_is_empty(Dir dir)
 	}
 }
 
-static struct xattr_entry *
-xattr_entry_alloc(const char *attrname)
+/*
+ * returns the position in XATTRS_SORTED(xattrs) of the first entry
+ * whose name_id is >= name_id
+ */
+static int
+xattr_search(struct xattrs *xattrs, int name_id)
 {
-	struct xattr_entry *entry;
-	static const char diag[] = "xattr_entry_alloc";
+	int lo = 0, hi = xattrs->n, mid, *sorted = XATTRS_SORTED(xattrs);
 
-	GFARM_CALLOC_ARRAY(entry, 1);
-	if (entry == NULL) {
-		gflog_error(GFARM_MSG_1001777, "no memory");
-		return (NULL);
-	}
-	if ((entry->name = strdup_log(attrname, diag)) == NULL) {
-		free(entry);
-		return (NULL);
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (xattrs->entries[sorted[mid]].name_id < name_id)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-	entry->cached_attrvalue = NULL;
-	entry->cached_attrsize = 0;
-	return (entry);
+	return (lo);
 }
 
-static void
-xattr_entry_free(struct xattr_entry *entry)
-{
-	if (entry != NULL) {
-		free(entry->name);
-		if (entry->cached_attrvalue != NULL)
-			free(entry->cached_attrvalue);
-		free(entry);
-	}
-}
+/* most inodes have only a few extended attributes */
+#define XATTRS_INITIAL_NALLOC	2
 
 static struct xattr_entry *
-xattr_add(struct xattrs *xattrs, int xmlMode, const char *attrname,
+xattr_add(struct inode *inode, int xmlMode, const char *attrname,
 	const void *value, int size)
 {
-	struct xattr_entry *entry, *tail;
+	struct xattrs *xattrs = xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattr_entry *entry, *entries;
+	int name_id, i, nalloc, *sorted;
 
-	entry = xattr_entry_alloc(attrname);
-	if (entry == NULL) {
+	if ((name_id = xattr_name_intern(attrname)) == -1) {
 		gflog_debug(GFARM_MSG_1001778,
 			"allocation of 'xattr_entry' failure");
 		return NULL;
 	}
+	if (xattrs->n >= xattrs->nalloc) {
+		nalloc = xattrs->nalloc == 0 ?
+		    XATTRS_INITIAL_NALLOC : xattrs->nalloc * 2;
+		entries = gfarm_realloc_array(xattrs->entries, nalloc,
+		    sizeof(*entries) + sizeof(*sorted));
+		if (entries == NULL) {
+			gflog_error(GFARM_MSG_1001777, "no memory");
+			xattr_name_unref(name_id);
+			return NULL;
+		}
+		/* move the sorted indexes after the grown entries */
+		memmove(&entries[nalloc], &entries[xattrs->nalloc],
+		    xattrs->n * sizeof(*sorted));
+		xattrs->entries = entries;
+		xattrs->nalloc = nalloc;
+	}
+	sorted = XATTRS_SORTED(xattrs);
+	i = xattr_search(xattrs, name_id);
+	memmove(&sorted[i + 1], &sorted[i], (xattrs->n - i) * sizeof(*sorted));
+	sorted[i] = xattrs->n;
+	entry = &xattrs->entries[xattrs->n++];
+	entry->name_id = name_id;
+	entry->cached_attrsize = -1;
+
 	if (!xmlMode && gfarm_xattr_caching(attrname) && value != NULL) {
-		/* since malloc(0) is not portable */
-		entry->cached_attrvalue = malloc(size == 0 ? 1 : size);
-		if (entry->cached_attrvalue == NULL) {
+		if (!xattr_entry_cache(entry, value, size))
 			gflog_warning(GFARM_MSG_1002494,
 			    "trying to cache %d bytes for attr %s: no memory",
 			    size, attrname);
-		} else {
-			memcpy(entry->cached_attrvalue, value, size);
-			entry->cached_attrsize = size;
-		}
-	}
-
-	if (xattrs->head == NULL) {
-		xattrs->head = xattrs->tail = entry;
-		entry->prev = NULL;
-	} else {
-		tail = xattrs->tail;
-		entry->prev = tail;
-		tail->next = entry;
-		xattrs->tail = entry;
 	}
+	xattr_index_add(xmlMode, name_id, inode->i_number,
+	    xattr_entry_value(entry), entry->cached_attrsize);
 	return entry;
 }
 
@@ -8234,7 +8512,6 @@ void
 xattr_add_one(void *closure, struct xattr_info *info)
 {
 	struct inode *inode = inode_lookup(info->inum);
-	struct xattrs *xattrs;
 	int xmlMode = (closure != NULL) ? *(int*)closure : 0;
 
 	if (inode == NULL) {
@@ -8246,8 +8523,7 @@ xattr_add_one(void *closure, struct xattr_info *info)
 		else
 			xattr_defer_db_removal(info);
 	} else {
-		xattrs = (xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs);
-		if (xattr_add(xattrs, xmlMode, info->attrname,
+		if (xattr_add(inode, xmlMode, info->attrname,
 		    info->attrvalue, info->attrsize) == NULL)
 			gflog_error(GFARM_MSG_1000367, "xattr_add_one: "
 				"cannot add attrname %s to %lld",
@@ -8299,19 +8575,193 @@ xattr_init(void)
 #endif
 }
 
-static struct xattr_entry *
-xattr_find(struct xattrs *xattrs, const char *attrname)
+/*
+ * snapshot of the in-memory filesystem metadata, see db_snapshot.c.
+ * every table is written in its own pass, so that each section of
+ * the image consists of contiguous segments.
+ */
+enum inode_snapshot_pass {
+	INODE_SNAPSHOT_PASS_INODE,
+	INODE_SNAPSHOT_PASS_CKSUM,
+	INODE_SNAPSHOT_PASS_FILECOPY,
+	INODE_SNAPSHOT_PASS_DIRENTRY,
+	INODE_SNAPSHOT_PASS_SYMLINK,
+	INODE_SNAPSHOT_PASS_XATTR,
+#ifdef ENABLE_XMLATTR
+	INODE_SNAPSHOT_PASS_XMLATTR,
+#endif
+	INODE_SNAPSHOT_PASS_MAX
+};
+
+static gfarm_error_t
+inode_snapshot_write_stat(struct db_snapshot_writer *w, struct inode *inode)
+{
+	struct gfs_stat st;
+
+	/* should be consistent with inode_db_init() */
+	st.st_ino = inode->i_number;
+	st.st_gen = inode->i_gen;
+	st.st_mode = inode->i_mode;
+	st.st_nlink = inode->i_nlink;
+	st.st_user = user_tenant_name_even_invalid(inode->i_user);
+	st.st_group = group_tenant_name_even_invalid(inode->i_group);
+	st.st_size = inode->i_size;
+	st.st_ncopy = 0;
+	st.st_atimespec = inode->i_atimespec;
+	st.st_mtimespec = inode->i_mtimespec;
+	st.st_ctimespec = inode->i_ctimespec;
+	return (db_snapshot_put_inode(w, &st));
+}
+
+static gfarm_error_t
+inode_snapshot_write_direntries(struct db_snapshot_writer *w,
+	struct inode *inode)
 {
+	gfarm_error_t e;
+	Dir dir = inode->u.c.s.d.entries;
+	DirCursor cursor;
+	DirEntry entry;
+	char *name;
+	int namelen;
+
+	if (!dir_cursor_set_pos(dir, 0, &cursor))
+		return (GFARM_ERR_NO_ERROR);
+	do {
+		entry = dir_cursor_get_entry(dir, &cursor);
+		name = dir_entry_get_name(entry, &namelen);
+		if ((e = db_snapshot_put_direntry(w, inode->i_number,
+		    name, namelen,
+		    inode_get_number(dir_entry_get_inode(entry))))
+		    != GFARM_ERR_NO_ERROR)
+			return (e);
+	} while (dir_cursor_next(dir, &cursor));
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+inode_snapshot_write_xattrs(struct db_snapshot_writer *w,
+	struct inode *inode, int xmlMode)
+{
+	gfarm_error_t e;
+	struct xattrs *xattrs = xmlMode ?
+		&inode->i_xmlattrs : &inode->i_xattrs;
 	struct xattr_entry *entry;
+	int i;
+
+	for (i = 0; i < xattrs->n; i++) {
+		entry = &xattrs->entries[i];
+		if ((e = db_snapshot_put_xattr(w, xmlMode, inode->i_number,
+		    xattr_entry_name(entry), xattr_entry_value(entry),
+		    xattr_entry_value_size(entry))) != GFARM_ERR_NO_ERROR)
+			return (e);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+inode_snapshot_write_one(struct db_snapshot_writer *w,
+	enum inode_snapshot_pass pass, struct inode *inode)
+{
+	gfarm_error_t e;
+	struct checksum *cs;
+	struct file_copy *copy;
 
-	entry = xattrs->head;
-	while (entry != NULL) {
-		if (strcmp(entry->name, attrname) == 0) {
-			return entry;
+	if (pass == INODE_SNAPSHOT_PASS_INODE) {
+		/* free inodes are also stored to keep i_gen */
+		return (inode_snapshot_write_stat(w, inode));
+	}
+	if (inode->i_mode == INODE_MODE_FREE)
+		return (GFARM_ERR_NO_ERROR);
+
+	switch (pass) {
+	case INODE_SNAPSHOT_PASS_CKSUM:
+		if (!inode_is_file(inode) ||
+		    (cs = inode->u.c.s.f.cksum) == NULL)
+			break;
+		return (db_snapshot_put_inode_cksum(w, inode->i_number,
+		    cs->type, cs->len, cs->sum));
+	case INODE_SNAPSHOT_PASS_FILECOPY:
+		if (!inode_is_file(inode))
+			break;
+		for (copy = inode->u.c.s.f.copies; copy != NULL;
+		    copy = copy->host_next) {
+			/* same as the filecopy table of the backend DB */
+			if (!FILE_COPY_IS_VALID(copy))
+				continue;
+			if ((e = db_snapshot_put_filecopy(w, inode->i_number,
+			    host_name(copy->host))) != GFARM_ERR_NO_ERROR)
+				return (e);
 		}
-		entry = entry->next;
+		break;
+	case INODE_SNAPSHOT_PASS_DIRENTRY:
+		if (!inode_is_dir(inode))
+			break;
+		return (inode_snapshot_write_direntries(w, inode));
+	case INODE_SNAPSHOT_PASS_SYMLINK:
+		if (!inode_is_symlink(inode) ||
+		    inode->u.c.s.l.source_path == NULL)
+			break;
+		return (db_snapshot_put_symlink(w, inode->i_number,
+		    inode->u.c.s.l.source_path));
+	case INODE_SNAPSHOT_PASS_XATTR:
+		return (inode_snapshot_write_xattrs(w, inode, 0));
+#ifdef ENABLE_XMLATTR
+	case INODE_SNAPSHOT_PASS_XMLATTR:
+		return (inode_snapshot_write_xattrs(w, inode, 1));
+#endif
+	default:
+		break;
 	}
-	return NULL;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * PREREQUISITE: giant_lock, or running in a forked child,
+ * so this must not call gflog or take any mutex.
+ */
+gfarm_error_t
+inode_snapshot_write(struct db_snapshot_writer *w)
+{
+	gfarm_error_t e;
+	enum inode_snapshot_pass pass;
+	gfarm_ino_t seg, i;
+	struct inode **segment, *inode;
+
+	for (pass = INODE_SNAPSHOT_PASS_INODE;
+	    pass < INODE_SNAPSHOT_PASS_MAX; pass++) {
+		for (seg = 0;
+		    seg < inode_table_size >> INODE_TABLE_SEGMENT_SHIFT;
+		    seg++) {
+			segment = inode_table[seg];
+			for (i = seg == 0 ? ROOT_INUMBER : 0;
+			    i < INODE_TABLE_SEGMENT_SIZE; i++) {
+				if ((inode = segment[i]) == NULL)
+					continue;
+				if ((e = inode_snapshot_write_one(w, pass,
+				    inode)) != GFARM_ERR_NO_ERROR)
+					return (e);
+			}
+		}
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* the result is valid until the next xattr_add() or inode_xattr_remove() */
+static struct xattr_entry *
+xattr_find(struct xattrs *xattrs, const char *attrname)
+{
+	int name_id, i, *sorted;
+
+	if (xattrs->n == 0)
+		return NULL;
+	/* a name which no inode has isn't interned */
+	if ((name_id = xattr_name_lookup(attrname)) == -1)
+		return NULL;
+	sorted = XATTRS_SORTED(xattrs);
+	i = xattr_search(xattrs, name_id);
+	if (i >= xattrs->n || xattrs->entries[sorted[i]].name_id != name_id)
+		return NULL;
+	return &xattrs->entries[sorted[i]];
 }
 
 int
@@ -8334,7 +8784,7 @@ inode_xattr_add(struct inode *inode, int xmlMode, const char *attrname,
 		gflog_debug(GFARM_MSG_1001779,
 			"xattr of inode already exists: %s", attrname);
 		e = GFARM_ERR_ALREADY_EXISTS;
-	} else if (xattr_add(xattrs, xmlMode, attrname, value, size) != NULL) {
+	} else if (xattr_add(inode, xmlMode, attrname, value, size) != NULL) {
 		e = GFARM_ERR_NO_ERROR;
 	} else {
 		gflog_debug(GFARM_MSG_1001780,
@@ -8351,28 +8801,23 @@ inode_xattr_modify(struct inode *inode, int xmlMode, const char *attrname,
 	struct xattrs *xattrs =
 		xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
 	struct xattr_entry *entry = xattr_find(xattrs, attrname);
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
 
 	if (entry == NULL)
 		return (GFARM_ERR_NO_SUCH_OBJECT);
 
-	if (entry->cached_attrvalue != NULL) {
-		free(entry->cached_attrvalue);
-		entry->cached_attrvalue = NULL;
-		entry->cached_attrsize = 0;
-	}
-	if (!xmlMode && gfarm_xattr_caching(attrname)) {
-		entry->cached_attrvalue = malloc(size);
-		if (entry->cached_attrvalue == NULL) {
-			gflog_warning(GFARM_MSG_1002495,
-			    "trying to cache %d bytes for attr %s: no memory",
-			    (int)size, attrname);
-			return (GFARM_ERR_NO_MEMORY);
-		} else {
-			memcpy(entry->cached_attrvalue, value, size);
-			entry->cached_attrsize = size;
-		}
+	xattr_entry_uncache(entry);
+	if (!xmlMode && gfarm_xattr_caching(attrname) &&
+	    !xattr_entry_cache(entry, value, size)) {
+		gflog_warning(GFARM_MSG_1002495,
+		    "trying to cache %d bytes for attr %s: no memory",
+		    (int)size, attrname);
+		e = GFARM_ERR_NO_MEMORY;
 	}
-	return (GFARM_ERR_NO_ERROR);
+	/* update the hash of the value */
+	xattr_index_add(xmlMode, entry->name_id, inode->i_number,
+	    xattr_entry_value(entry), entry->cached_attrsize);
+	return (e);
 }
 
 gfarm_error_t
@@ -8427,14 +8872,14 @@ inode_xattr_get_cache_with_process(struct inode *inode, int xmlMode,
 	if (entry == NULL)
 		return (GFARM_ERR_NO_SUCH_OBJECT);
 
-	if (entry->cached_attrvalue == NULL) {
+	if (xattr_entry_value(entry) == NULL) {
 		*cached_valuep = NULL;
 		*cached_sizep = 0;
 	} else if ((r = malloc(entry->cached_attrsize)) == NULL) {
 		gflog_error(GFARM_MSG_1004350, "no memory");
 		return (GFARM_ERR_NO_MEMORY);
 	} else {
-		memcpy(r, entry->cached_attrvalue, entry->cached_attrsize);
+		memcpy(r, xattr_entry_value(entry), entry->cached_attrsize);
 		*cached_valuep = r;
 		*cached_sizep = entry->cached_attrsize;
 	}
@@ -8458,7 +8903,7 @@ inode_xattr_cache_is_same(struct inode *inode, int xmlMode,
 		xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
 	struct xattr_entry *entry = xattr_find(xattrs, attrname);
 
-	if (entry == NULL || entry->cached_attrvalue == NULL) {
+	if (entry == NULL || xattr_entry_value(entry) == NULL) {
 		if (size == 0)
 			return (1);
 		else
@@ -8469,7 +8914,7 @@ inode_xattr_cache_is_same(struct inode *inode, int xmlMode,
 	if (entry->cached_attrsize == 0 && size == 0)
 		return (1);
 
-	return (!memcmp(entry->cached_attrvalue, value, size));
+	return (!memcmp(xattr_entry_value(entry), value, size));
 }
 
 void
@@ -8498,7 +8943,8 @@ inode_xattr_list_get_cached_by_patterns(gfarm_ino_t inum,
 	struct xattr_list *list;
 	struct xattrs *xattrs;
 	struct xattr_entry *entry;
-	int i, j, directory_quota = 0, effective_perm = 0;
+	const char *name;
+	int i, j, k, directory_quota = 0, effective_perm = 0;
 	static const char diag[] = "inode_xattr_list_get_cached_by_patterns";
 
 	inode = inode_lookup(inum);
@@ -8528,9 +8974,10 @@ inode_xattr_list_get_cached_by_patterns(gfarm_ino_t inum,
 	if (effective_perm)
 		++nxattrs;
 
-	for (entry = xattrs->head; entry != NULL; entry = entry->next) {
+	for (k = 0; k < xattrs->n; k++) {
+		name = xattr_entry_name(&xattrs->entries[k]);
 		for (j = 0; j < npattern; j++) {
-			if (gfarm_pattern_match(patterns[j], entry->name, 0)) {
+			if (gfarm_pattern_match(patterns[j], name, 0)) {
 				++nxattrs;
 				break;
 			}
@@ -8564,17 +9011,17 @@ inode_xattr_list_get_cached_by_patterns(gfarm_ino_t inum,
 		else
 			i++;
 	}
-	for (entry = xattrs->head;
-	     entry != NULL && i < nxattrs;
-	     entry = entry->next) {
+	for (k = 0; k < xattrs->n && i < nxattrs; k++) {
+		entry = &xattrs->entries[k];
+		name = xattr_entry_name(entry);
 		for (j = 0; j < npattern; j++) {
-			if (gfarm_pattern_match(patterns[j], entry->name, 0)) {
-				list[i].name = strdup_log(entry->name, diag);
+			if (gfarm_pattern_match(patterns[j], name, 0)) {
+				list[i].name = strdup_log(name, diag);
 				if (list[i].name == NULL) {
 					nxattrs = i;
 					break;
 				}
-				if (entry->cached_attrvalue == NULL) {
+				if (xattr_entry_value(entry) == NULL) {
 					/* not cached */
 					list[i].value = NULL;
 					list[i].size = 0;
@@ -8587,7 +9034,7 @@ inode_xattr_list_get_cached_by_patterns(gfarm_ino_t inum,
 						list[i].size = 0;
 					} else {
 						memcpy(list[i].value,
-						    entry->cached_attrvalue,
+						    xattr_entry_value(entry),
 						    entry->cached_attrsize);
 						list[i].size =
 						    entry->cached_attrsize;
@@ -8607,7 +9054,7 @@ int
 inode_xattr_has_xmlattrs(struct inode *inode)
 {
 #ifdef ENABLE_XMLATTR
-	return (inode->i_xmlattrs.head != NULL);
+	return (inode->i_xmlattrs.n > 0);
 #else
 	return 0;
 #endif
@@ -8617,21 +9064,26 @@ gfarm_error_t
 inode_xattr_remove(struct inode *inode, int xmlMode, const char *attrname)
 {
 	struct xattrs *xattrs = xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
-	struct xattr_entry *entry, *prev, *next;
+	struct xattr_entry *entry;
+	int name_id, i, j, k, *sorted;
 
 	entry = xattr_find(xattrs, attrname);
 	if (entry != NULL) {
-		prev = entry->prev; // NULL if entry is head
-		next = entry->next; // NULL if entry is tail
-		if (entry == xattrs->head)
-			xattrs->head = next;
-		else
-			prev->next = next;
-		if (entry == xattrs->tail)
-			xattrs->tail = prev;
-		else
-			next->prev = prev;
-		xattr_entry_free(entry);
+		name_id = entry->name_id;
+		xattr_index_remove(xmlMode, name_id, inode->i_number);
+		xattr_entry_uncache(entry);
+		i = entry - xattrs->entries;
+		memmove(entry, entry + 1,
+		    (xattrs->n - i - 1) * sizeof(*entry));
+		/* keep the indexes of the following entries consistent */
+		sorted = XATTRS_SORTED(xattrs);
+		for (j = k = 0; j < xattrs->n; j++) {
+			if (sorted[j] == i)
+				continue;
+			sorted[k++] = sorted[j] > i ? sorted[j] - 1 : sorted[j];
+		}
+		xattrs->n--;
+		xattr_name_unref(name_id);
 		return GFARM_ERR_NO_ERROR;
 	} else {
 		gflog_debug(GFARM_MSG_1001781,
@@ -8644,31 +9096,27 @@ gfarm_error_t
 inode_xattr_list(struct inode *inode, int xmlMode, char **namesp, size_t *sizep)
 {
 	struct xattrs *xattrs = xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
-	struct xattr_entry *entry = NULL;
+	const char *name;
 	char *names, *p;
-	int size = 0, len;
+	int size = 0, len, i;
 
 	*namesp = NULL;
 	*sizep = 0;
 
-	entry = xattrs->head;
-	while (entry != NULL) {
-		size += (strlen(entry->name) + 1);
-		entry = entry->next;
-	}
+	for (i = 0; i < xattrs->n; i++)
+		size += (strlen(xattr_entry_name(&xattrs->entries[i])) + 1);
 	if (size == 0)
 		return (GFARM_ERR_NO_ERROR);
 	if (GFARM_MALLOC_ARRAY(names, size) == NULL) {
 		gflog_error(GFARM_MSG_1004353, "no memory");
 		return (GFARM_ERR_NO_MEMORY);
 	}
-	entry = xattrs->head;
 	p = names;
-	while (entry != NULL) {
-		len = strlen(entry->name) + 1; // +1 is '\0'
-		memcpy(p, entry->name, len);
+	for (i = 0; i < xattrs->n; i++) {
+		name = xattr_entry_name(&xattrs->entries[i]);
+		len = strlen(name) + 1; // +1 is '\0'
+		memcpy(p, name, len);
 		p += len;
-		entry = entry->next;
 	}
 	*namesp = names;
 	*sizep = size;
@@ -8724,10 +9172,10 @@ inode_has_desired_number(struct inode *inode, int *desired_numberp)
 {
 	struct xattr_entry *ent = xattr_find(&inode->i_xattrs, xattr_ncopy);
 
-	if (ent == NULL || ent->cached_attrvalue == NULL)
+	if (ent == NULL || xattr_entry_value(ent) == NULL)
 		return (0);
 	return (inode_xattr_convert_desired_number(
-	    ent->cached_attrvalue, ent->cached_attrsize, desired_numberp));
+	    xattr_entry_value(ent), ent->cached_attrsize, desired_numberp));
 }
 
 /* And also this assumes that the "gfarm.replicainfo" xattr is cached. */
@@ -73,6 +73,7 @@ void inode_set_mtime_in_cache(struct inode *, struct gfarm_timespec *);
 void inode_set_ctime(struct inode *, struct gfarm_timespec *);
 void inode_set_ctime_in_cache(struct inode *, struct gfarm_timespec *);
 void inode_accessed(struct inode *);
+int inode_accessed_needs_update(struct inode *);
 void inode_modified(struct inode *);
 void inode_status_changed(struct inode *);
 char *inode_get_symlink(struct inode *);
@@ -107,12 +108,20 @@ gfarm_ino_t inode_root_number();
 gfarm_ino_t inode_table_current_size();
 struct inode *inode_lookup(gfarm_ino_t);
 void inode_lookup_all(void *, void (*callback)(void *, struct inode *));
+struct db_snapshot_writer;
+gfarm_error_t inode_snapshot_write(struct db_snapshot_writer *);
 
 gfarm_error_t inode_lookup_root(struct process *, int, struct inode **);
 gfarm_error_t inode_lookup_parent(struct inode *, struct process *, int,
 	struct dirset **, struct inode **);
 gfarm_error_t inode_lookup_for_open(struct inode *, const char *,
 	struct process *, int, struct dirset **, struct inode **);
+gfarm_error_t inode_lookup_path_no_follow(struct inode *, const char *,
+	struct process *, struct inode **);
+gfarm_error_t inode_lookup_dir_path(struct inode *, const char *,
+	struct process *, struct dirset **, struct inode **, int *);
+gfarm_error_t inode_lookup_cached_dir(gfarm_ino_t, gfarm_uint64_t,
+	struct process *, struct inode **);
 gfarm_error_t inode_lookup_user_root(struct user *, struct inode **);
 gfarm_error_t inode_create_file(struct inode *, char *,
 	struct process *, int, gfarm_mode_t, int,
@@ -150,7 +159,7 @@ gfarm_error_t dir_entry_add(gfarm_ino_t, char *, int, gfarm_ino_t);
 
 struct hostset;
 gfarm_error_t inode_schedule_replication_within_scope(
-	struct inode *, struct dirset *, int,
+	struct inode *, struct dirset *, int, const char *,
 	int, struct host **, int *,
 	int *, struct hostset *,
 	int *, struct hostset *, gfarm_time_t,
@@ -114,6 +114,7 @@ struct journal_file_writer {
 	struct journal_file *file;
 	off_t pos;
 	gfarm_uint64_t lap;
+	gfarm_uint64_t written; /* total bytes written, never rewound */
 	struct gfp_xdr *xdr;
 };
 
@@ -425,6 +426,28 @@ journal_file_reader_is_expired(struct journal_file_reader *reader)
 	return (r);
 }
 
+/* bytes which are written by the writer, but not committed by the reader */
+gfarm_uint64_t
+journal_file_reader_lag_bytes(struct journal_file_reader *reader)
+{
+	struct journal_file *jf = reader->file;
+	struct journal_file_writer *writer = &jf->writer;
+	gfarm_uint64_t lag;
+	static const char diag[] = "journal_file_reader_lag_bytes";
+
+	journal_file_mutex_lock(jf, diag);
+	if (journal_file_reader_is_invalid(reader) ||
+	    journal_file_reader_is_expired_unlocked(reader))
+		lag = 0;
+	else if (reader->committed_lap == writer->lap)
+		lag = writer->pos - reader->committed_pos;
+	else /* the reader is a lap behind */
+		lag = (jf->tail - reader->committed_pos) +
+		    (writer->pos - JOURNAL_FILE_HEADER_SIZE);
+	journal_file_mutex_unlock(jf, diag);
+	return (lag);
+}
+
 static void
 journal_file_reader_expire(struct journal_file_reader *reader)
 {
@@ -454,6 +477,12 @@ journal_file_writer_pos(struct journal_file_writer *writer)
 	return (writer->pos);
 }
 
+gfarm_uint64_t
+journal_file_writer_written(struct journal_file_writer *writer)
+{
+	return (writer->written);
+}
+
 static int
 jounal_read_fully(int fd, void *buf, size_t sz, off_t *posp, int *eofp)
 {
@@ -1214,6 +1243,8 @@ journal_blocking_write_op(struct gfarm_iobuffer *b,
 	errno = 0;
 	if ((ssz = journal_write_fully(fd, data, length, &writer->pos)) < 0)
 		gfarm_iobuffer_set_error(b, gfarm_errno_to_error(errno));
+	else
+		writer->written += ssz;
 	if (jf->size < writer->pos)
 		jf->size = writer->pos;
 	if (jf->tail < writer->pos)
@@ -134,8 +134,10 @@ gfarm_error_t journal_file_writer_sync(struct journal_file_writer *writer);
 gfarm_error_t journal_file_writer_flush(struct journal_file_writer *);
 struct gfp_xdr *journal_file_writer_xdr(struct journal_file_writer *);
 off_t journal_file_writer_pos(struct journal_file_writer *);
+gfarm_uint64_t journal_file_writer_written(struct journal_file_writer *);
 
 struct gfp_xdr *journal_file_reader_xdr(struct journal_file_reader *);
+gfarm_uint64_t journal_file_reader_lag_bytes(struct journal_file_reader *);
 void journal_file_reader_committed_pos(struct journal_file_reader *, off_t *,
 	gfarm_uint64_t *);
 void journal_file_reader_committed_pos_unlocked(struct journal_file_reader *,
@@ -39,9 +39,11 @@
 
 #include "subr.h"
 #include "thrpool.h"
+#include "fairshare.h"
 #include "watcher.h"
 #include "db_access.h"
 #include "user.h"
+#include "tenant.h"
 #include "abstract_host.h"
 #include "host.h"
 #include "mdhost.h"
@@ -62,6 +64,7 @@
 struct peer_watcher {
 	struct watcher *w;
 	struct thread_pool *thrpool;
+	struct fairshare *fairshare; /* NULL, if not enabled */
 	void *(*readable_handler)(void *);
 };
 
@@ -97,11 +100,19 @@ peer_watcher_alloc(int thrpool_size, int thrqueue_length,
 		gflog_fatal(GFARM_MSG_1002765, "thrpool(%d, %d) %s: no memory",
 		    thrpool_size, thrqueue_length, diag);
 
+	pw->fairshare = NULL;
 	pw->readable_handler = readable_handler;
 
 	return (pw);
 }
 
+/* jobs are queued to `fs' before the thread pool of `pw' */
+void
+peer_watcher_set_fairshare(struct peer_watcher *pw, struct fairshare *fs)
+{
+	pw->fairshare = fs;
+}
+
 struct watcher *
 peer_watcher_get_watcher(struct peer_watcher *pw)
 {
@@ -870,6 +881,41 @@ peer_get_service_name(struct peer *peer)
 	    "gfmd" : "")));
 }
 
+/*
+ * the key of the fair share scheduling.
+ * requests from gfsd and gfmd are in one class, whose key is NULL.
+ */
+static const void *
+peer_fairshare_key(struct peer *peer, const char **namep)
+{
+	struct tenant *tenant;
+
+	if (peer->user == NULL) {
+		*namep = "-";
+		return (NULL);
+	}
+	if (gfarm_metadb_server_fair_share_key == GFARM_FAIR_SHARE_KEY_TENANT) {
+		tenant = user_get_tenant(peer->user);
+		*namep = tenant_name(tenant);
+		return (tenant);
+	}
+	*namep = user_tenant_name_even_invalid(peer->user);
+	return (peer->user);
+}
+
+static void *
+peer_readable_fairshare(void *arg)
+{
+	struct peer *peer = arg;
+	struct peer_watcher *pw = peer->watcher;
+	const void *key;
+	const char *name;
+
+	key = peer_fairshare_key(peer, &name);
+	fairshare_add_job(pw->fairshare, key, name, pw->readable_handler, peer);
+	return (NULL);
+}
+
 /* caller should allocate the storage for username and hostname */
 void
 peer_authorized(struct peer *peer,
@@ -942,11 +988,13 @@ peer_authorized(struct peer *peer,
 
 	peer->watcher = watcher;
 
-	if (gfp_xdr_recv_is_ready(peer_get_conn(peer)))
+	if (!gfp_xdr_recv_is_ready(peer_get_conn(peer)))
+		peer_watch_access(peer);
+	else if (watcher->fairshare != NULL)
+		peer_readable_fairshare(peer);
+	else
 		thrpool_add_job(watcher->thrpool,
 		    watcher->readable_handler, peer);
-	else
-		peer_watch_access(peer);
 }
 
 static int
@@ -1151,8 +1199,14 @@ void
 peer_watch_access(struct peer *peer)
 {
 	peer_add_ref(peer);
-	watcher_add_event(peer->watcher->w, peer->readable_event,
-	    peer->watcher->thrpool, peer->watcher->readable_handler, peer);
+	if (peer->watcher->fairshare != NULL)
+		/* peer_readable_fairshare() is called by the watcher thread */
+		watcher_add_event(peer->watcher->w, peer->readable_event,
+		    NULL, peer_readable_fairshare, peer);
+	else
+		watcher_add_event(peer->watcher->w, peer->readable_event,
+		    peer->watcher->thrpool, peer->watcher->readable_handler,
+		    peer);
 }
 
 #if 0
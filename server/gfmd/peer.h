@@ -9,6 +9,8 @@ struct peer_watcher *peer_watcher_alloc(int, int, void *(*)(void *),
 	const char *);
 struct watcher *peer_watcher_get_watcher(struct peer_watcher *);
 struct thread_pool *peer_watcher_get_thrpool(struct peer_watcher *);
+struct fairshare;
+void peer_watcher_set_fairshare(struct peer_watcher *, struct fairshare *);
 
 #ifdef PEER_REFCOUNT_DEBUG
 void peer_add_ref_impl(struct peer *, const char *, int, const char *);
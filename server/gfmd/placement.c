@@ -0,0 +1,114 @@
+/*
+ * $Id$
+ */
+
+#include <stdlib.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+
+#include "config.h"
+
+#include "placement.h"
+
+/*
+ * selection of replica destinations (and sources) by weights.
+ *
+ * this doesn't depend on struct host, so that a simulator can use this.
+ * the weight of a host is calculated by the caller, see host.c.
+ */
+
+#define PLACEMENT_RANDOM_RANGE	2147483648.0	/* random(3) < 2^31 */
+
+/* returns [0, 1) */
+static double
+placement_random(void)
+{
+	return (gfarm_random() / PLACEMENT_RANDOM_RANGE);
+}
+
+/* select one of index[0 ... n-1] in proportion to its weight */
+static int
+placement_select_weighted(int n, const int *index, const double *weights)
+{
+	double total = 0, r;
+	int i;
+
+	for (i = 0; i < n; i++)
+		total += weights[index[i]];
+	if (total <= 0) /* all weights are 0, select uniformly */
+		return (gfarm_random() % n);
+
+	r = placement_random() * total;
+	for (i = 0; i < n - 1; i++) {
+		r -= weights[index[i]];
+		if (r < 0)
+			break;
+	}
+	return (i);
+}
+
+/* the power of two choices: the heavier of two random candidates */
+static int
+placement_select_two_choices(int n, const int *index, const double *weights)
+{
+	int i, j;
+
+	if (n == 1)
+		return (0);
+	i = gfarm_random() % n;
+	j = gfarm_random() % (n - 1);
+	if (j >= i)
+		j++;
+	return (weights[index[j]] > weights[index[i]] ? j : i);
+}
+
+/*
+ * select `nresults' different indexes from [0 ... n-1] by `policy',
+ * `weights[i]' is the weight of index i, and it's ignored by
+ * GFARM_REPLICA_PLACEMENT_RANDOM.
+ * `index' is a working area of n elements.
+ */
+void
+placement_select(int policy, int n, const double *weights, int *index,
+	int nresults, int *results)
+{
+	int i, j;
+
+	for (i = 0; i < n; i++)
+		index[i] = i;
+	for (i = 0; i < nresults && n > 0; i++) {
+		switch (policy) {
+		case GFARM_REPLICA_PLACEMENT_WEIGHTED:
+			j = placement_select_weighted(n, index, weights);
+			break;
+		case GFARM_REPLICA_PLACEMENT_TWO_CHOICES:
+			j = placement_select_two_choices(n, index, weights);
+			break;
+		default:
+			j = gfarm_random() % n;
+			break;
+		}
+		results[i] = index[j];
+		index[j] = index[--n];
+	}
+}
+
+/* the weight of a destination, zero if it's unavailable */
+double
+placement_weight(gfarm_uint64_t disk_avail, double loadavg, int ncpu,
+	int nreplicating)
+{
+	return (disk_avail * placement_source_weight(loadavg, ncpu,
+	    nreplicating));
+}
+
+/* the weight of a source, only the load is taken into account */
+double
+placement_source_weight(double loadavg, int ncpu, int nreplicating)
+{
+	if (ncpu < 1)
+		ncpu = 1;
+	return (1.0 / ((1.0 + loadavg / ncpu) * (1.0 + nreplicating)));
+}
@@ -0,0 +1,7 @@
+/*
+ * replica placement by weights
+ */
+
+void placement_select(int, int, const double *, int *, int, int *);
+double placement_weight(gfarm_uint64_t, double, int, int);
+double placement_source_weight(double, int, int);
@@ -42,4 +42,12 @@ struct protocol_state {
 	/* just for error reporting */
 	gfarm_int32_t last_sync_request;
 	gfarm_int32_t last_async_request;
+
+	/*
+	 * the last journal seqnum committed while the requests of this
+	 * peer were processed, which must be durable before the reply
+	 * is flushed.
+	 * 0 if there is nothing to wait for.
+	 */
+	gfarm_uint64_t journal_seqnum;
 };
@@ -144,6 +144,19 @@ replica_check_minimum_interval_locked(void)
 	return (rv);
 }
 
+static int
+replica_check_scan_budget_locked(void)
+{
+	int rv;
+
+	config_var_lock();
+	rv = gfarm_replica_check_scan_budget;
+	config_var_unlock();
+	if (rv < 0)
+		rv = 0;
+	return (rv);
+}
+
 
 #define REDUCED_WARN(msg_no, state, ...)				\
 	{								\
@@ -541,6 +554,117 @@ replica_check_stack_pop(struct replication_info *infop)
 	return (1);
 }
 
+/*
+ * dirty inodes, i.e. inodes whose replica spec or location may have been
+ * changed since they were checked last time.
+ * these are checked without scanning whole namespace.
+ * a directory means all files under the directory.
+ */
+struct replica_check_dirty {
+	gfarm_ino_t inum;
+	gfarm_uint64_t gen;
+	gfarm_ino_t dir_inum; /* parent directory of a file, or 0 */
+};
+
+#define REPLICA_CHECK_DIRTY_INITIAL	1024
+#define REPLICA_CHECK_DIRTY_MAX		1000000
+
+static const char DIRTY_MUTEX_DIAG[] = "replica_check_dirty_mutex";
+static pthread_mutex_t replica_check_dirty_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct replica_check_dirty *dirty_list;
+static size_t dirty_num, dirty_size;
+static int dirty_overflowed; /* whole namespace has to be scanned */
+static gfarm_uint64_t dirty_added_total, dirty_checked_total;
+
+/* returns 0, if the list is full */
+static int
+replica_check_dirty_add(gfarm_ino_t inum, gfarm_uint64_t gen,
+	gfarm_ino_t dir_inum)
+{
+	struct replica_check_dirty *d;
+	size_t n;
+	int ok = 1;
+	static const char diag[] = "replica_check_dirty_add";
+
+	gfarm_mutex_lock(&replica_check_dirty_mutex, diag, DIRTY_MUTEX_DIAG);
+	d = dirty_num == 0 ? NULL : &dirty_list[dirty_num - 1];
+	if (d != NULL && d->inum == inum && d->gen == gen &&
+	    d->dir_inum == dir_inum) {
+		/* same as the last one, e.g. repeated setxattr */
+	} else {
+		if (dirty_num >= dirty_size) {
+			d = NULL;
+			if (dirty_size < REPLICA_CHECK_DIRTY_MAX) {
+				n = dirty_size == 0 ?
+				    REPLICA_CHECK_DIRTY_INITIAL :
+				    dirty_size * 2;
+				if (n > REPLICA_CHECK_DIRTY_MAX)
+					n = REPLICA_CHECK_DIRTY_MAX;
+				d = realloc(dirty_list, sizeof(*d) * n);
+			}
+			if (d == NULL) {
+				dirty_overflowed = 1;
+				ok = 0;
+			} else {
+				dirty_list = d;
+				dirty_size = n;
+			}
+		}
+		if (ok) {
+			d = &dirty_list[dirty_num++];
+			d->inum = inum;
+			d->gen = gen;
+			d->dir_inum = dir_inum;
+			dirty_added_total++;
+		}
+	}
+	gfarm_mutex_unlock(&replica_check_dirty_mutex, diag, DIRTY_MUTEX_DIAG);
+	return (ok);
+}
+
+static int
+replica_check_dirty_pop(struct replica_check_dirty *dirtyp)
+{
+	int found = 0;
+	static const char diag[] = "replica_check_dirty_pop";
+
+	gfarm_mutex_lock(&replica_check_dirty_mutex, diag, DIRTY_MUTEX_DIAG);
+	if (dirty_num > 0) {
+		*dirtyp = dirty_list[--dirty_num];
+		dirty_checked_total++;
+		found = 1;
+	}
+	gfarm_mutex_unlock(&replica_check_dirty_mutex, diag, DIRTY_MUTEX_DIAG);
+	return (found);
+}
+
+/* returns 1, if the list was overflowed since the last call */
+static int
+replica_check_dirty_overflowed(void)
+{
+	int overflowed;
+	static const char diag[] = "replica_check_dirty_overflowed";
+
+	gfarm_mutex_lock(&replica_check_dirty_mutex, diag, DIRTY_MUTEX_DIAG);
+	overflowed = dirty_overflowed;
+	dirty_overflowed = 0;
+	gfarm_mutex_unlock(&replica_check_dirty_mutex, diag, DIRTY_MUTEX_DIAG);
+	return (overflowed);
+}
+
+static void
+replica_check_dirty_stat(size_t *nump,
+	gfarm_uint64_t *added_totalp, gfarm_uint64_t *checked_totalp)
+{
+	static const char diag[] = "replica_check_dirty_stat";
+
+	gfarm_mutex_lock(&replica_check_dirty_mutex, diag, DIRTY_MUTEX_DIAG);
+	*nump = dirty_num;
+	*added_totalp = dirty_added_total;
+	*checked_totalp = dirty_checked_total;
+	gfarm_mutex_unlock(&replica_check_dirty_mutex, diag, DIRTY_MUTEX_DIAG);
+}
+
 struct rep_prioq {
 	pthread_mutex_t mutex;
 	int count;
@@ -844,10 +968,20 @@ replica_check_priority_task()
  * accessed by a signal handler
  */
 static gfarm_ino_t info_inum, info_table_size;
-static time_t info_time_start;
+static time_t info_time_start; /* 0: namespace scan is not in progress */
+static time_t info_time_last_full_pass;
+static gfarm_uint64_t info_file_count; /* files checked in the scan */
+static int info_need_to_retry;
+
+static void replica_check_cond_signal(const char *, long);
 
+/*
+ * if walk_subdirs is set, subdirectories are added to the dirty list
+ * to check the whole subtree.
+ */
 static int
-replica_check_main_dir(gfarm_ino_t inum, gfarm_ino_t *countp, int *stopped)
+replica_check_main_dir(gfarm_ino_t inum, gfarm_ino_t *countp, int *stopped,
+	int walk_subdirs)
 {
 	gfarm_error_t e;
 	struct inode *dir_ino, *file_ino;
@@ -857,7 +991,8 @@ replica_check_main_dir(gfarm_ino_t inum, gfarm_ino_t *countp, int *stopped)
 	DirEntry entry;
 	struct dirset *tdirset;
 	struct replication_info rep_info;
-	int need_to_retry = 0, eod = 0, i;
+	int need_to_retry = 0, eod = 0, i, namelen;
+	char *name;
 
 	*stopped = 0;
 	while (!eod) {
@@ -894,6 +1029,14 @@ replica_check_main_dir(gfarm_ino_t inum, gfarm_ino_t *countp, int *stopped)
 			if (inode_is_file(file_ino))
 				replica_check_stack_push(dir_ino, file_ino,
 				    tdirset);
+			else if (walk_subdirs && inode_is_dir(file_ino)) {
+				name = dir_entry_get_name(entry, &namelen);
+				/* whole namespace is scanned if it fails */
+				if (!name_is_dot_or_dotdot(name, namelen))
+					(void)replica_check_dirty_add(
+					    inode_get_number(file_ino),
+					    inode_get_gen(file_ino), 0);
+			}
 			if (!dir_cursor_next(dir, &cursor)) {
 				eod = 1; /* end of directory */
 				break;
@@ -923,53 +1066,168 @@ replica_check_main_dir(gfarm_ino_t inum, gfarm_ino_t *countp, int *stopped)
 	return (need_to_retry);
 }
 
+/* check dirty inodes only */
+static int
+replica_check_main_dirty(int *stopped)
+{
+	gfarm_error_t e;
+	struct replica_check_dirty dirty;
+	struct inode *inode, *dir_ino;
+	struct replication_info rep_info;
+	gfarm_ino_t count = 0;
+	char *repattr;
+	int desired_number, need_to_retry = 0, need_to_scan = 0;
+
+	*stopped = 0;
+	while (replica_check_dirty_pop(&dirty)) {
+		if (!replica_check_ctrl_enabled()) { /* gfrepcheck stop */
+			*stopped = 1;
+			break;
+		}
+		replica_check_priority_task();
+
+		replica_check_giant_lock();
+		inode = inode_lookup(dirty.inum);
+		if (inode == NULL || inode_get_gen(inode) != dirty.gen) {
+			replica_check_giant_unlock();
+			continue; /* already removed */
+		}
+		if (inode_is_dir(inode)) {
+			replica_check_giant_unlock();
+			if (replica_check_main_dir(dirty.inum, &count, stopped,
+			    1))
+				need_to_retry = 1;
+			if (*stopped)
+				break;
+			continue;
+		}
+		dir_ino = dirty.dir_inum == 0 ? NULL :
+		    inode_lookup(dirty.dir_inum);
+		if (dir_ino != NULL && !inode_is_dir(dir_ino))
+			dir_ino = NULL;
+		if (!inode_is_file(inode) || (dir_ino == NULL &&
+		    !inode_get_replica_spec(inode, &repattr, &desired_number))) {
+			/* the replica spec may be inherited from anywhere */
+			if (inode_is_file(inode))
+				need_to_scan = 1;
+			replica_check_giant_unlock();
+			continue;
+		}
+		replica_check_stack_push(dir_ino, inode, dir_ino == NULL ?
+		    TDIRSET_IS_UNKNOWN : inode_search_tdirset(dir_ino));
+		replica_check_giant_unlock();
+
+		while (replica_check_stack_pop(&rep_info)) {
+			e = replica_check_fix_retry(&rep_info, 0, stopped);
+			if (IS_REPLICA_CHECK_REQUIRED(e)) {
+				need_to_retry = 1; /* try again later */
+				RC_LOG_DEBUG(GFARM_MSG_1005704,
+				    "replica_check_fix(): %s",
+				    gfarm_error_string(e));
+			}
+			count++;
+			replication_info_free(&rep_info);
+		}
+		if (*stopped)
+			break;
+	}
+	if (replica_check_dirty_overflowed())
+		need_to_scan = 1;
+	if (need_to_scan)
+		replica_check_cond_signal("replica_check_main_dirty", 0);
+	if (count > 0)
+		RC_LOG_DEBUG(GFARM_MSG_1005705,
+		    "replica_check: dirty inodes checked, file=%llu",
+		    (unsigned long long)count);
+	return (need_to_retry);
+}
+
 #define REPLICA_CHECK_INTERRUPT_STEP 10000
 
 #define ENABLE_STR(b) ((b) ? "enable" : "disable")
 
 static int
-replica_check_main(void)
+replica_check_scan_is_in_progress(void)
+{
+	int in_progress;
+
+	replica_check_giant_lock();
+	in_progress = info_time_start != 0;
+	replica_check_giant_unlock();
+	return (in_progress);
+}
+
+static void
+replica_check_scan_abort(void)
+{
+	replica_check_giant_lock();
+	info_time_start = 0;  /* stopped */
+	replica_check_giant_unlock();
+}
+
+/*
+ * scan whole namespace.
+ * to avoid competing with clients for a long time, this checks at most
+ * gfarm_replica_check_scan_budget files (in directory granularity)
+ * at a time, and the next call continues from there.
+ * returns 1 if the scan ends with errors which should be retried.
+ */
+static int
+replica_check_main_scan(void)
 {
-	gfarm_ino_t inum, table_size, count = 0;
+	gfarm_ino_t inum, table_size, count = 0, budget;
 	gfarm_ino_t root_inum = inode_root_number();
-	int need_to_retry = 0, stopped;
-	time_t time_total, time_start;
+	int need_to_retry, stopped = 0, starting;
+	time_t time_total, time_start, now;
+
+	budget = replica_check_scan_budget_locked();
 
 	replica_check_giant_lock();
 	info_table_size = table_size = inode_table_current_size();
-	info_time_start = time_start = time(NULL);
+	starting = info_time_start == 0;
+	if (starting) {
+		info_inum = root_inum;
+		info_time_start = time(NULL);
+		info_file_count = 0;
+		info_need_to_retry = 0;
+	}
+	inum = info_inum;
+	time_start = info_time_start;
 	replica_check_giant_unlock();
 
-	lock_sleep_time = retry_sleep_time = 0;
-	total_yield_time = 0;
-	req_ok_num_total = req_ok_size_total = 0;
-	remove_num_total = remove_size_total = 0;
-	RC_LOG_INFO(GFARM_MSG_1003632, "replica_check: start");
-	RC_LOG_INFO(GFARM_MSG_1004277,
-	    "replica_check: remove=%s, reduced_log=%s",
-	    ENABLE_STR(replica_check_remove_enabled()),
-	    ENABLE_STR(replica_check_reduced_log_enabled()));
-	RC_LOG_INFO(GFARM_MSG_1005015,
-	    "replica_check: remove_grace_used_space_ratio=%d, "
-	    "remove_grace_time=%d",
-	    replica_check_remove_grace_used_space_ratio_locked(),
-	    replica_check_remove_grace_time_locked());
-
-	replication_info(); /* acquires giant_lock internally */
+	if (starting) {
+		lock_sleep_time = retry_sleep_time = 0;
+		total_yield_time = 0;
+		req_ok_num_total = req_ok_size_total = 0;
+		remove_num_total = remove_size_total = 0;
+		RC_LOG_INFO(GFARM_MSG_1003632, "replica_check: start");
+		RC_LOG_INFO(GFARM_MSG_1004277,
+		    "replica_check: remove=%s, reduced_log=%s",
+		    ENABLE_STR(replica_check_remove_enabled()),
+		    ENABLE_STR(replica_check_reduced_log_enabled()));
+		RC_LOG_INFO(GFARM_MSG_1005015,
+		    "replica_check: remove_grace_used_space_ratio=%d, "
+		    "remove_grace_time=%d",
+		    replica_check_remove_grace_used_space_ratio_locked(),
+		    replica_check_remove_grace_time_locked());
+
+		replication_info(); /* acquires giant_lock internally */
+	}
 
-	for (inum = root_inum;;) {
+	for (;;) {
 		if (inum % REPLICA_CHECK_INTERRUPT_STEP == 0) {
 			if (!replica_check_ctrl_enabled()) {
 				/* gfrepcheck stop */
 				RC_LOG_INFO(GFARM_MSG_1005016,
 				    "replica_check: stopped (interrupted)");
+				stopped = 1;
 				break;
 			}
 			replica_check_priority_task();
 		}
 
-		if (replica_check_main_dir(inum, &count, &stopped))
-			need_to_retry = 1;
+		if (replica_check_main_dir(inum, &count, &stopped, 0))
+			info_need_to_retry = 1; /* only this thread accesses */
 		if (stopped) { /* gfrepcheck stop */
 			RC_LOG_INFO(GFARM_MSG_1005017,
 			    "replica_check: stopped (interrupted)");
@@ -984,8 +1242,28 @@ replica_check_main(void)
 			if (inum >= table_size)
 				break;
 		}
+		if (budget > 0 && count >= budget) {
+			/* continue in the next cycle */
+			replica_check_giant_lock();
+			info_inum = inum;
+			info_file_count += count;
+			replica_check_giant_unlock();
+			RC_LOG_DEBUG(GFARM_MSG_1005706,
+			    "replica_check: paused, inum=%llu/%llu",
+			    (unsigned long long)inum,
+			    (unsigned long long)table_size);
+			return (0);
+		}
 	}
-	time_total = time(NULL) - time_start;
+	need_to_retry = info_need_to_retry;
+
+	replica_check_giant_lock();
+	info_file_count += count;
+	count = info_file_count;
+	replica_check_giant_unlock();
+
+	now = time(NULL);
+	time_total = now - time_start;
 	RC_LOG_INFO(GFARM_MSG_1005040,
 	    "replica_check: finished, table=%llu, inum=%llu, file=%llu, "
 	    "rep num=%llu, rep size=%llu, remove num=%llu, remove size=%llu, "
@@ -1008,33 +1286,70 @@ replica_check_main(void)
 
 	replica_check_giant_lock();
 	info_time_start = 0;  /* stopped */
+	if (!stopped)
+		info_time_last_full_pass = now;
 	replica_check_giant_unlock();
 
 	return (need_to_retry);
 }
 
+/*
+ * dirty inodes are always checked,
+ * and whole namespace is scanned if `scan' is set.
+ */
+static int
+replica_check_main(int scan)
+{
+	int need_to_retry, stopped;
+
+	need_to_retry = replica_check_main_dirty(&stopped);
+	if (stopped) { /* gfrepcheck stop */
+		RC_LOG_INFO(GFARM_MSG_1005707,
+		    "replica_check: stopped (interrupted)");
+		replica_check_scan_abort();
+		return (need_to_retry);
+	}
+	if (scan && replica_check_main_scan())
+		need_to_retry = 1;
+	return (need_to_retry);
+}
+
 /* this function is called from sigs_handler() in gfmd.c */
 void
 replica_check_info(void)
 {
 	gfarm_ino_t inum, table_size;
-	time_t time_start, elapse;
+	time_t time_start, time_last_full_pass, elapse;
 	float progress;
 	long long estimate;
 	int q_count;
+	size_t dirty_count;
+	gfarm_uint64_t dirty_added, dirty_checked, file_count;
 	static const char diag[] = "replica_check_info";
 
 	q_count = replica_check_queue_count(diag);
 	RC_LOG_INFO(GFARM_MSG_1005661,
 		    "replica_check: priority queue count=%d, max=%d",
 		     q_count, rep_prioq_count_max);
+	replica_check_dirty_stat(&dirty_count, &dirty_added, &dirty_checked);
+	RC_LOG_INFO(GFARM_MSG_1005708,
+	    "replica_check: dirty count=%lld, added=%llu, checked=%llu",
+	    (long long)dirty_count, (unsigned long long)dirty_added,
+	    (unsigned long long)dirty_checked);
 
 	replica_check_giant_lock();
 	table_size = info_table_size;
 	inum = info_inum;
 	time_start = info_time_start;
+	time_last_full_pass = info_time_last_full_pass;
+	file_count = info_file_count;
 	replica_check_giant_unlock();
 
+	if (time_last_full_pass != 0)
+		RC_LOG_INFO(GFARM_MSG_1005709,
+		    "replica_check: last full scan finished %lld sec. ago",
+		    (long long)(time(NULL) - time_last_full_pass));
+
 	if (time_start == 0 || table_size == 0) {
 		RC_LOG_INFO(GFARM_MSG_1003756, "replica_check: standby");
 		return;
@@ -1052,6 +1367,9 @@ replica_check_info(void)
 	    " elapse:estimate=%lld:%lld sec.",
 	    (long long)inum, (long long)table_size, progress * 100,
 	    (long long)elapse, estimate);
+	RC_LOG_INFO(GFARM_MSG_1005710,
+	    "replica_check: files checked in this scan=%llu",
+	    (unsigned long long)file_count);
 }
 
 
@@ -1059,6 +1377,7 @@ static const char REPLICA_CHECK_DIAG[] = "replica_check";
 static pthread_mutex_t replica_check_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t replica_check_cond = PTHREAD_COND_INITIALIZER;
 static int replica_check_initialized = 0; /* ignore cond_signal in startup */
+static int replica_check_dirty_wakeup = 0; /* dirty inodes are added */
 static struct timeval *targets;
 static size_t targets_num, targets_size;
 
@@ -1190,16 +1509,26 @@ replica_check_timedwait(
 	    &ts, diag, REPLICA_CHECK_DIAG));
 }
 
-static void
+/*
+ * returns 1 if whole namespace should be scanned,
+ * 0 if only dirty inodes should be checked.
+ */
+static int
 replica_check_cond_wait(void)
 {
 	static const char diag[] = "replica_check_cond_wait";
 	struct timeval next, now;
 	int minimum_interval = replica_check_minimum_interval_locked(), t;
+	int scan = 1;
 
 	gfarm_mutex_lock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
 	/* do not call giant_lock() in replica_check_mutex */
 	for (;;) {
+		if (replica_check_dirty_wakeup) {
+			replica_check_dirty_wakeup = 0;
+			scan = 0;
+			break; /* execute for dirty inodes only */
+		}
 		gettimeofday(&now, NULL);
 		if (replica_check_targets_next(
 		    &next, &now, minimum_interval)) {
@@ -1254,6 +1583,7 @@ replica_check_cond_wait(void)
 	if (!replica_check_initialized)
 		replica_check_initialized = 1;
 	gfarm_mutex_unlock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+	return (scan);
 }
 
 static void
@@ -1278,6 +1608,35 @@ replica_check_cond_signal(const char *diag, long sec)
 	gfarm_mutex_unlock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
 }
 
+/* wake up replica_check_thread without scanning whole namespace */
+static void
+replica_check_dirty_signal(const char *diag)
+{
+	gfarm_mutex_lock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+	/* do not call giant_lock() in replica_check_mutex */
+	if (replica_check_initialized) {
+		replica_check_dirty_wakeup = 1;
+		gfarm_cond_signal(
+		    &replica_check_cond, diag, REPLICA_CHECK_DIAG);
+	}
+	gfarm_mutex_unlock(&replica_check_mutex, diag, REPLICA_CHECK_DIAG);
+}
+
+/*
+ * PREREQUISITE: giant_lock
+ * `dir' is the parent directory of `inode' if it's a file, or NULL.
+ */
+static void
+replica_check_dirty_inode(struct inode *inode, struct inode *dir,
+	const char *diag)
+{
+	if (replica_check_dirty_add(inode_get_number(inode),
+	    inode_get_gen(inode), dir == NULL ? 0 : inode_get_number(dir)))
+		replica_check_dirty_signal(diag);
+	else /* the dirty list is full */
+		replica_check_cond_signal(diag, 0);
+}
+
 void
 replica_check_start_host_up(void)
 {
@@ -1296,28 +1655,31 @@ replica_check_start_host_down(void)
 	/* NOTE: execute replica_check_main() twice after restarting gfsd */
 }
 
+/* PREREQUISITE: giant_lock */
 void
-replica_check_start_xattr_update(void)
+replica_check_start_xattr_update(struct inode *inode)
 {
 	static const char diag[] = "replica_check_start_xattr_update";
 
-	replica_check_cond_signal(diag, 0);
+	replica_check_dirty_inode(inode, NULL, diag);
 }
 
+/* PREREQUISITE: giant_lock */
 void
-replica_check_start_move(void)
+replica_check_start_move(struct inode *inode, struct inode *new_parent)
 {
 	static const char diag[] = "replica_check_start_move";
 
-	replica_check_cond_signal(diag, 0);
+	replica_check_dirty_inode(inode, new_parent, diag);
 }
 
+/* the inode has been already added by replica_check_enqueue() */
 void
 replica_check_start_rep_request_failed(void)
 {
 	static const char diag[] = "replica_check_start_rep_request_failed";
 
-	replica_check_cond_signal(diag, 0);
+	replica_check_dirty_signal(diag);
 }
 
 void
@@ -1664,6 +2026,7 @@ static void *
 replica_check_thread(void *arg)
 {
 	time_t dfc_scan_time = 0;
+	int scan;
 
 	replica_check_giant_lock_init();
 
@@ -1671,16 +2034,20 @@ replica_check_thread(void *arg)
 		time_t t = time(NULL) +
 		    replica_check_minimum_interval_locked();
 
-		replica_check_cond_wait();
+		if (replica_check_scan_is_in_progress())
+			scan = 1; /* continue the scan */
+		else
+			scan = replica_check_cond_wait();
 		replica_check_is_running_update(1);
 
 		if (replica_check_ctrl_enabled()) {  /* gfrepcheck enable */
-			if (replica_check_main()) {
+			if (replica_check_main(scan)) {
 				/* error occurred */
 				replica_check_cond_signal("retry_by_error",
 				    gfarm_metadb_heartbeat_interval);
 			}
-		}
+		} else
+			replica_check_scan_abort();
 
 		replica_check_priority_task();
 		replica_check_is_running_update(0);
@@ -6,8 +6,8 @@ void replica_check_init(void);
 
 void replica_check_start_host_up(void);
 void replica_check_start_host_down(void);
-void replica_check_start_xattr_update(void);
-void replica_check_start_move(void);
+void replica_check_start_xattr_update(struct inode *);
+void replica_check_start_move(struct inode *, struct inode *);
 void replica_check_start_rep_request_failed(void);
 void replica_check_start_rep_result_failed(void);
 void replica_check_start_fsngroup_modify(void);
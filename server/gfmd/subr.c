@@ -145,12 +145,54 @@ giant_queuelock_unlock(void)
 	gfarm_queuelock_unlock(&giant_queuelock, "giant_unlock", "giant");
 }
 
+/*
+ * with rwqueuelock, giant_lock_shared() allows read-only protocol handlers
+ * to run concurrently.  other lock types treat it as giant_lock().
+ */
+
+static struct gfarm_rwqueuelock giant_rwqueuelock;
+
+static void
+giant_rwqueuelock_init(void)
+{
+	gfarm_rwqueuelock_init(&giant_rwqueuelock, "giant_init", "giant");
+}
+
+static void
+giant_rwqueuelock_wrlock(void)
+{
+	gfarm_rwqueuelock_wrlock(&giant_rwqueuelock, "giant_lock", "giant");
+}
+
+static void
+giant_rwqueuelock_rdlock(void)
+{
+	gfarm_rwqueuelock_rdlock(&giant_rwqueuelock,
+	    "giant_lock_shared", "giant");
+}
+
+/* false: busy */
+static int
+giant_rwqueuelock_trywrlock(void)
+{
+	return (gfarm_rwqueuelock_trywrlock(
+	    &giant_rwqueuelock, "giant_trylock", "giant"));
+}
+
+static void
+giant_rwqueuelock_unlock(void)
+{
+	gfarm_rwqueuelock_unlock(&giant_rwqueuelock, "giant_unlock", "giant");
+}
+
 static struct giant_lock_sw_entry {
 	const char *name;
 	void (*init)(void);
 	void (*lock)(void);
 	int (*trylock)(void);
 	void (*unlock)(void);
+	void (*lock_shared)(void);
+	void (*unlock_shared)(void);
 } giant_lock_sw_table[] = {
 	/* GFARM_LOCK_TYPE_MUTEX */
 	{
@@ -159,6 +201,8 @@ static struct giant_lock_sw_entry {
 		giant_mutex_lock,
 		giant_mutex_trylock,
 		giant_mutex_unlock,
+		giant_mutex_lock,
+		giant_mutex_unlock,
 	},
 	/* GFARM_LOCK_TYPE_TICKETLOCK */
 	{
@@ -167,6 +211,8 @@ static struct giant_lock_sw_entry {
 		giant_ticketlock_lock,
 		giant_ticketlock_trylock,
 		giant_ticketlock_unlock,
+		giant_ticketlock_lock,
+		giant_ticketlock_unlock,
 	},
 	/* GFARM_LOCK_TYPE_QUEUELOCK */
 	{
@@ -175,6 +221,18 @@ static struct giant_lock_sw_entry {
 		giant_queuelock_lock,
 		giant_queuelock_trylock,
 		giant_queuelock_unlock,
+		giant_queuelock_lock,
+		giant_queuelock_unlock,
+	},
+	/* GFARM_LOCK_TYPE_RWQUEUELOCK */
+	{
+		"rwqueuelock",
+		giant_rwqueuelock_init,
+		giant_rwqueuelock_wrlock,
+		giant_rwqueuelock_trywrlock,
+		giant_rwqueuelock_unlock,
+		giant_rwqueuelock_rdlock,
+		giant_rwqueuelock_unlock,
 	},
 };
 
@@ -214,6 +272,22 @@ giant_unlock(void)
 	giant_lock_sw->unlock();
 }
 
+/*
+ * the caller must not modify any metadata shared with other peers
+ * while holding the giant lock in the shared mode.
+ */
+void
+giant_lock_shared(void)
+{
+	giant_lock_sw->lock_shared();
+}
+
+void
+giant_unlock_shared(void)
+{
+	giant_lock_sw->unlock_shared();
+}
+
 
 static pthread_mutex_t config_var_mutex;
 
@@ -5,6 +5,8 @@ void giant_type_log(void);
 void giant_lock(void);
 int giant_trylock(void);
 void giant_unlock(void);
+void giant_lock_shared(void);
+void giant_unlock_shared(void);
 
 void config_var_init(void);
 void config_var_lock(void);
@@ -1,4 +1,5 @@
 #include <pthread.h>
+#include <sched.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -10,6 +11,8 @@
 #include "gfutil.h"
 #include "thrsubr.h"
 
+#include "config.h"
+
 #include "subr.h"
 #include "thrpool.h"
 
@@ -89,22 +92,306 @@ thrjobq_get_job(struct thread_jobq *q, struct thread_job *job)
 	gfarm_mutex_unlock(&q->mutex, diag, "thrjobq");
 }
 
+#ifdef __GNUC__ /* the work stealing type requires __atomic builtins */
+
+/*
+ * GFARM_THREAD_POOL_TYPE_WORK_STEALING:
+ *
+ * each worker has its own bounded lock-free queue, and a job is added
+ * to the queues in round robin.  an idle worker takes a job from its own
+ * queue first, and steals one from the others if it's empty.
+ * thus adding and getting a job don't take any mutex, unless a worker
+ * is sleeping or the queues are full.
+ * an idle worker spins a while before it sleeps, and a woken worker
+ * wakes another one if there are still jobs, so that a burst of jobs
+ * wakes up workers in a batch.
+ *
+ * each queue is the bounded MPMC queue by Dmitry Vyukov.
+ * the owner takes jobs from the same end as thieves, because jobs
+ * should be processed in FIFO order as the mutex type does.
+ */
+
+#define THRPOOL_WS_SPIN		100	/* times to scan queues before sleep */
+#define THRPOOL_CACHE_LINE	64
+
+struct thrpool_ws_cell {
+	unsigned long seq;
+	struct thread_job job;
+};
+
+struct thrpool_ws_queue {
+	unsigned long enqueue_pos;
+	char pad0[THRPOOL_CACHE_LINE - sizeof(unsigned long)];
+	unsigned long dequeue_pos;
+	char pad1[THRPOOL_CACHE_LINE - sizeof(unsigned long)];
+	unsigned long mask;
+	struct thrpool_ws_cell *cells;
+	char pad2[THRPOOL_CACHE_LINE - sizeof(unsigned long) - sizeof(void *)];
+};
+
+struct thrpool_ws {
+	int nqueues, size, low_priority_limit;
+	struct thrpool_ws_queue *queues;
+
+	/* the followings are accessed by __atomic builtins */
+	int njobs;	/* including jobs which are being added */
+	unsigned int next_queue;
+	int sleepers, full_waiters;
+
+	pthread_mutex_t sleep_mutex;
+	pthread_cond_t nonempty;
+	pthread_mutex_t full_mutex;
+	pthread_cond_t nonfull;
+};
+
+static void
+thrpool_ws_queue_init(struct thrpool_ws_queue *q, int size)
+{
+	unsigned long i, n;
+
+	for (n = 1; n < size; n <<= 1)
+		;
+	GFARM_MALLOC_ARRAY(q->cells, n);
+	if (q->cells == NULL)
+		gflog_fatal(GFARM_MSG_1005802,
+		    "thrpool_ws_queue_init: queue size %lu: %s",
+		    n, strerror(ENOMEM));
+	for (i = 0; i < n; i++)
+		q->cells[i].seq = i;
+	q->mask = n - 1;
+	q->enqueue_pos = 0;
+	q->dequeue_pos = 0;
+}
+
+/* returns 0, if the queue is full */
+static int
+thrpool_ws_queue_put(struct thrpool_ws_queue *q, struct thread_job *job)
+{
+	struct thrpool_ws_cell *cell;
+	unsigned long pos, seq;
+	long diff;
+
+	pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+	for (;;) {
+		cell = &q->cells[pos & q->mask];
+		seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+		diff = (long)seq - (long)pos;
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&q->enqueue_pos,
+			    &pos, pos + 1, 1,
+			    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			return (0);
+		} else {
+			pos = __atomic_load_n(&q->enqueue_pos,
+			    __ATOMIC_RELAXED);
+		}
+	}
+	cell->job = *job;
+	__atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+	return (1);
+}
+
+/* returns 0, if the queue is empty */
+static int
+thrpool_ws_queue_get(struct thrpool_ws_queue *q, struct thread_job *job)
+{
+	struct thrpool_ws_cell *cell;
+	unsigned long pos, seq;
+	long diff;
+
+	pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+	for (;;) {
+		cell = &q->cells[pos & q->mask];
+		seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+		diff = (long)seq - (long)(pos + 1);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&q->dequeue_pos,
+			    &pos, pos + 1, 1,
+			    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			return (0);
+		} else {
+			pos = __atomic_load_n(&q->dequeue_pos,
+			    __ATOMIC_RELAXED);
+		}
+	}
+	*job = cell->job;
+	__atomic_store_n(&cell->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+	return (1);
+}
+
+static void
+thrpool_ws_init(struct thrpool_ws *ws, int nqueues, int size)
+{
+	int i;
+	static const char diag[] = "thrpool_ws_init";
+
+	if (nqueues < 1)
+		nqueues = 1;
+	GFARM_MALLOC_ARRAY(ws->queues, nqueues);
+	if (ws->queues == NULL)
+		gflog_fatal(GFARM_MSG_1005803,
+		    "%s: %d queues: %s", diag, nqueues, strerror(ENOMEM));
+	/* twice, so that a job can be added even if it's unbalanced */
+	for (i = 0; i < nqueues; i++)
+		thrpool_ws_queue_init(&ws->queues[i],
+		    (size * 2 + nqueues - 1) / nqueues);
+	ws->nqueues = nqueues;
+	ws->size = size;
+	ws->low_priority_limit = size;
+	ws->njobs = 0;
+	ws->next_queue = 0;
+	ws->sleepers = 0;
+	ws->full_waiters = 0;
+	gfarm_mutex_init(&ws->sleep_mutex, diag, "sleep");
+	gfarm_cond_init(&ws->nonempty, diag, "nonempty");
+	gfarm_mutex_init(&ws->full_mutex, diag, "full");
+	gfarm_cond_init(&ws->nonfull, diag, "nonfull");
+}
+
+static void
+thrpool_ws_set_low_priority_limit(struct thrpool_ws *ws, int limit)
+{
+	/* a limit greater than size would overflow the queues */
+	ws->low_priority_limit = limit < ws->size ? limit : ws->size;
+}
+
+static void
+thrpool_ws_wakeup(struct thrpool_ws *ws)
+{
+	static const char diag[] = "thrpool_ws_wakeup";
+
+	if (__atomic_load_n(&ws->sleepers, __ATOMIC_SEQ_CST) > 0) {
+		gfarm_mutex_lock(&ws->sleep_mutex, diag, "sleep");
+		gfarm_cond_signal(&ws->nonempty, diag, "nonempty");
+		gfarm_mutex_unlock(&ws->sleep_mutex, diag, "sleep");
+	}
+}
+
+static void
+thrpool_ws_add_job(struct thrpool_ws *ws, int low_priority,
+	void *(*thread_main)(void *), void *arg)
+{
+	struct thread_job job;
+	int n, i, limit = low_priority ? ws->low_priority_limit : ws->size;
+	static const char diag[] = "thrpool_ws_add_job";
+
+	/* reserve a slot */
+	n = __atomic_load_n(&ws->njobs, __ATOMIC_RELAXED);
+	for (;;) {
+		if (n < limit) {
+			if (__atomic_compare_exchange_n(&ws->njobs, &n, n + 1,
+			    1, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+				break;
+			continue;
+		}
+		gfarm_mutex_lock(&ws->full_mutex, diag, "full");
+		__atomic_add_fetch(&ws->full_waiters, 1, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&ws->njobs, __ATOMIC_SEQ_CST) >= limit)
+			gfarm_cond_wait(&ws->nonfull, &ws->full_mutex,
+			    diag, "nonfull");
+		__atomic_sub_fetch(&ws->full_waiters, 1, __ATOMIC_SEQ_CST);
+		gfarm_mutex_unlock(&ws->full_mutex, diag, "full");
+		n = __atomic_load_n(&ws->njobs, __ATOMIC_RELAXED);
+	}
+
+	job.thread_main = thread_main;
+	job.arg = arg;
+	i = __atomic_fetch_add(&ws->next_queue, 1, __ATOMIC_RELAXED) %
+	    ws->nqueues;
+	/* always succeeds, since the total capacity is twice of the size */
+	while (!thrpool_ws_queue_put(&ws->queues[i], &job))
+		i = (i + 1) % ws->nqueues;
+
+	thrpool_ws_wakeup(ws);
+}
+
+static int
+thrpool_ws_try_get_job(struct thrpool_ws *ws, int self,
+	struct thread_job *job)
+{
+	int i, n;
+	static const char diag[] = "thrpool_ws_try_get_job";
+
+	if (__atomic_load_n(&ws->njobs, __ATOMIC_SEQ_CST) <= 0)
+		return (0);
+	for (i = 0; i < ws->nqueues; i++) {
+		if (thrpool_ws_queue_get(
+		    &ws->queues[(self + i) % ws->nqueues], job))
+			break;
+	}
+	if (i >= ws->nqueues) /* the job is still being added */
+		return (0);
+
+	n = __atomic_sub_fetch(&ws->njobs, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ws->full_waiters, __ATOMIC_SEQ_CST) > 0) {
+		gfarm_mutex_lock(&ws->full_mutex, diag, "full");
+		gfarm_cond_broadcast(&ws->nonfull, diag, "nonfull");
+		gfarm_mutex_unlock(&ws->full_mutex, diag, "full");
+	}
+	if (n > 0) /* wake up workers in a batch */
+		thrpool_ws_wakeup(ws);
+	return (1);
+}
+
+static void
+thrpool_ws_get_job(struct thrpool_ws *ws, int self, struct thread_job *job)
+{
+	int spin;
+	static const char diag[] = "thrpool_ws_get_job";
+
+	for (;;) {
+		for (spin = 0; spin < THRPOOL_WS_SPIN; spin++) {
+			if (thrpool_ws_try_get_job(ws, self, job))
+				return;
+			if (spin >= THRPOOL_WS_SPIN / 2)
+				sched_yield();
+		}
+
+		gfarm_mutex_lock(&ws->sleep_mutex, diag, "sleep");
+		__atomic_add_fetch(&ws->sleepers, 1, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&ws->njobs, __ATOMIC_SEQ_CST) <= 0)
+			gfarm_cond_wait(&ws->nonempty, &ws->sleep_mutex,
+			    diag, "nonempty");
+		__atomic_sub_fetch(&ws->sleepers, 1, __ATOMIC_SEQ_CST);
+		gfarm_mutex_unlock(&ws->sleep_mutex, diag, "sleep");
+	}
+}
+
+#endif /* __GNUC__ */
+
 struct thread_pool {
 	pthread_mutex_t mutex;
 	int pool_size;
 	int threads;
 	int idles;
-	struct thread_jobq jobq;
+	int type;	/* enum gfarm_thread_pool_type */
+	struct thread_jobq jobq;	/* GFARM_THREAD_POOL_TYPE_MUTEX */
+#ifdef __GNUC__
+	struct thrpool_ws ws;	/* GFARM_THREAD_POOL_TYPE_WORK_STEALING */
+#endif
 
 	const char *name;
 	struct thread_pool *next;
 };
 
+#ifdef __GNUC__
+/* the argument of thrpool_ws_worker() */
+struct thrpool_ws_worker {
+	struct thread_pool *pool;
+	int id;
+};
+#endif
+
 static pthread_mutex_t all_thrpools_mutex = PTHREAD_MUTEX_INITIALIZER;
 static struct thread_pool *all_thrpools = NULL;
 
 struct thread_pool *
-thrpool_new(int pool_size, int queue_length, const char *pool_name)
+thrpool_new_by_type(int type, int pool_size, int queue_length,
+	const char *pool_name)
 {
 	struct thread_pool *p;
 	static const char diag[] = "thrpool_new";
@@ -113,7 +400,21 @@ thrpool_new(int pool_size, int queue_length, const char *pool_name)
 	if (p == NULL)
 		return (NULL);
 
-	thrjobq_init(&p->jobq, queue_length);
+#ifndef __GNUC__
+	if (type == GFARM_THREAD_POOL_TYPE_WORK_STEALING) {
+		gflog_warning(GFARM_MSG_1005828,
+		    "%s: work_stealing thread pool is not supported "
+		    "by this compiler, mutex is used instead", pool_name);
+		type = GFARM_THREAD_POOL_TYPE_MUTEX;
+	}
+#endif
+	p->type = type;
+#ifdef __GNUC__
+	if (type == GFARM_THREAD_POOL_TYPE_WORK_STEALING)
+		thrpool_ws_init(&p->ws, pool_size, queue_length);
+	else
+#endif
+		thrjobq_init(&p->jobq, queue_length);
 
 	gfarm_mutex_init(&p->mutex, diag, "thrpool");
 	p->pool_size = pool_size;
@@ -129,6 +430,13 @@ thrpool_new(int pool_size, int queue_length, const char *pool_name)
 	return (p);
 }
 
+struct thread_pool *
+thrpool_new(int pool_size, int queue_length, const char *pool_name)
+{
+	return (thrpool_new_by_type(gfarm_metadb_server_thread_pool_type,
+	    pool_size, queue_length, pool_name));
+}
+
 void *
 thrpool_worker(void *arg)
 {
@@ -155,6 +463,72 @@ thrpool_worker(void *arg)
 	return (NULL);
 }
 
+#ifdef __GNUC__
+static void *
+thrpool_ws_worker(void *arg)
+{
+	struct thrpool_ws_worker *w = arg;
+	struct thread_pool *p = w->pool;
+	struct thread_job job;
+	int id = w->id;
+
+	free(w);
+	for (;;) {
+		/* p->threads and p->idles are not protected by p->mutex */
+		__atomic_add_fetch(&p->idles, 1, __ATOMIC_RELAXED);
+		thrpool_ws_get_job(&p->ws, id, &job);
+		__atomic_sub_fetch(&p->idles, 1, __ATOMIC_RELAXED);
+
+		(*job.thread_main)(job.arg);
+	}
+	/*NOTREACHED*/
+
+	/* this return value won't be used, because this thread is detached */
+	return (NULL);
+}
+
+static void
+thrpool_ws_add_job0(struct thread_pool *p, int low_priority,
+	void *(*thread_main)(void *), void *arg)
+{
+	static const char diag[] = "thrpool_ws_add_job";
+	struct thrpool_ws_worker *w;
+	gfarm_error_t e;
+
+	/* p->mutex is only taken to create a thread */
+	if (__atomic_load_n(&p->threads, __ATOMIC_RELAXED) < p->pool_size &&
+	    __atomic_load_n(&p->idles, __ATOMIC_RELAXED) <= 0) {
+		gfarm_mutex_lock(&p->mutex, diag, "thrpool");
+		if (p->threads < p->pool_size &&
+		    __atomic_load_n(&p->idles, __ATOMIC_RELAXED) <= 0) {
+			GFARM_MALLOC(w);
+			if (w == NULL) {
+				e = GFARM_ERR_NO_MEMORY;
+			} else {
+				w->pool = p;
+				w->id = p->threads;
+				e = create_detached_thread(thrpool_ws_worker,
+				    w);
+				if (e != GFARM_ERR_NO_ERROR)
+					free(w);
+			}
+			if (e == GFARM_ERR_NO_ERROR) {
+				__atomic_add_fetch(&p->threads, 1,
+				    __ATOMIC_RELAXED);
+			} else {
+				gflog_warning(GFARM_MSG_1005804,
+				    "%s: create thread (currently %d out of "
+				    "%d threads in %s): %s", diag, p->threads,
+				    p->pool_size, p->name,
+				    gfarm_error_string(e));
+			}
+		}
+		gfarm_mutex_unlock(&p->mutex, diag, "thrpool");
+	}
+
+	thrpool_ws_add_job(&p->ws, low_priority, thread_main, arg);
+}
+#endif /* __GNUC__ */
 
 static void
 thrpool_add_job0(struct thread_pool *p, int low_priority,
@@ -163,6 +537,13 @@ thrpool_add_job0(struct thread_pool *p, int low_priority,
 	static const char diag[] = "thrpool_add_job";
 	gfarm_error_t e;
 
+#ifdef __GNUC__
+	if (p->type == GFARM_THREAD_POOL_TYPE_WORK_STEALING) {
+		thrpool_ws_add_job0(p, low_priority, thread_main, arg);
+		return;
+	}
+#endif
+
 	gfarm_mutex_lock(&p->mutex, diag, "thrpool");
 	if (p->threads < p->pool_size && p->idles <= 0) {
 		e = create_detached_thread(thrpool_worker, p);
@@ -196,7 +577,12 @@ thrpool_add_job_low_priority(struct thread_pool *p,
 void
 thrpool_set_jobq_low_priority_limit(struct thread_pool *p, int n)
 {
-	thrjobq_set_jobq_low_priority_limit(&p->jobq, n);
+#ifdef __GNUC__
+	if (p->type == GFARM_THREAD_POOL_TYPE_WORK_STEALING)
+		thrpool_ws_set_low_priority_limit(&p->ws, n);
+	else
+#endif
+		thrjobq_set_jobq_low_priority_limit(&p->jobq, n);
 }
 
 void
@@ -214,8 +600,13 @@ thrpool_info(void)
 	/* this implementation depends on that p->next will be never changed */
 	for (; p != NULL; p = p->next) {
 		gfarm_mutex_lock(&p->mutex, diag, "thrpool");
+#ifdef __GNUC__
+		n = __atomic_load_n(&p->threads, __ATOMIC_RELAXED);
+		i = __atomic_load_n(&p->idles, __ATOMIC_RELAXED);
+#else
 		n = p->threads;
 		i = p->idles;
+#endif
 		name = p->name;
 		gfarm_mutex_unlock(&p->mutex, diag, "thrpool");
 
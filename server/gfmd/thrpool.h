@@ -1,5 +1,6 @@
 struct thread_pool;
 struct thread_pool *thrpool_new(int, int, const char *);
+struct thread_pool *thrpool_new_by_type(int, int, int, const char *);
 void thrpool_add_job(struct thread_pool *, void *(*)(void *), void *);
 void thrpool_add_job_low_priority(struct thread_pool *,
 	void *(*)(void *), void *);
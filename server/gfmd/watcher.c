@@ -68,7 +68,10 @@ watcher_event_callback(int events, int fd, void *closure,
 	h = wev->handler; wev->handler = NULL;
 	c = wev->closure; wev->closure = NULL;
 	gfarm_mutex_unlock(&wev->mutex, module_name, "event callback");
-	thrpool_add_job(p, h, c);
+	if (p == NULL) /* the handler only queues the job somewhere else */
+		(*h)(c);
+	else
+		thrpool_add_job(p, h, c);
 }
 
 static void
@@ -421,6 +424,10 @@ watcher_alloc(int size, struct watcher **wp)
 	return (e);
 }
 
+/*
+ * if `thrpool' is NULL, `handler' is called by the watcher thread itself,
+ * thus it must not block except like thrpool_add_job() does.
+ */
 void
 watcher_add_event(struct watcher *w, struct watcher_event *wev,
 	struct thread_pool *thrpool, void *(*handler)(void *), void *closure)
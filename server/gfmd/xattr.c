@@ -38,6 +38,7 @@
 #include "user.h"
 #include "host.h"
 #include "replica_check.h"
+#include "xattr_index.h"
 #include "gfm_proto.h"
 
 static gfarm_error_t
@@ -502,7 +503,7 @@ xattr_set(int xmlMode, struct peer *peer, struct tenant *tenant,
 		}
 	}
 	if (change_replica_spec)
-		replica_check_start_xattr_update();
+		replica_check_start_xattr_update(inode);
 
 	if (mode_updated)
 		inode_set_mode(inode, new_mode);
@@ -669,7 +670,8 @@ gfm_server_getxattr(struct peer *peer, int from_client, int skip, int xmlMode)
 		return (gfm_server_put_reply(peer, diag, e, ""));
 	}
 #endif
-	giant_lock();
+	/* this doesn't modify any metadata */
+	giant_lock_shared();
 	if ((process = peer_get_process(peer)) == NULL) {
 		e = GFARM_ERR_OPERATION_NOT_PERMITTED;
 		gflog_debug(GFARM_MSG_1002081,
@@ -719,7 +721,7 @@ gfm_server_getxattr(struct peer *peer, int from_client, int skip, int xmlMode)
 				gfarm_error_string(e));
 	}
 
-	giant_unlock();
+	giant_unlock_shared();
 	if (e == GFARM_ERR_NO_ERROR && !cached)
 		e = dbq_waitret(&waitctx);
 	if (waitctx_initialized)
@@ -752,7 +754,8 @@ gfm_server_listxattr(struct peer *peer, int from_client, int skip, int xmlMode)
 				GFARM_ERR_OPERATION_NOT_SUPPORTED, "");
 #endif
 
-	giant_lock();
+	/* this doesn't modify any metadata */
+	giant_lock_shared();
 	if ((process = peer_get_process(peer)) == NULL) {
 		e = GFARM_ERR_OPERATION_NOT_PERMITTED;
 		gflog_debug(GFARM_MSG_1002085,
@@ -778,7 +781,7 @@ gfm_server_listxattr(struct peer *peer, int from_client, int skip, int xmlMode)
 		// NOTE: inode_xattrname_list() doesn't access to DB.
 		e = inode_xattr_list(inode, xmlMode, &value, &size);
 	}
-	giant_unlock();
+	giant_unlock_shared();
 
 	e = gfm_server_put_reply(peer, diag, e, "b", size, value);
 	free(value);
@@ -871,14 +874,12 @@ gfm_server_removexattr(struct peer *peer, int from_client, int skip,
 		    (long long)inode_get_number(inode),
 		    (long long)inode_get_gen(inode));
 		e = GFARM_ERR_READ_ONLY_FILE_SYSTEM;
-	} else
-		e = removexattr(xmlMode, inode, attrname);
-	giant_unlock();
-
-	if (e == GFARM_ERR_NO_ERROR && !xmlMode &&
+	} else if ((e = removexattr(xmlMode, inode, attrname))
+	    == GFARM_ERR_NO_ERROR && !xmlMode &&
 	    (strcmp(attrname, GFARM_EA_NCOPY) == 0 ||
 	     strcmp(attrname, GFARM_EA_REPATTR) == 0))
-		replica_check_start_xattr_update();
+		replica_check_start_xattr_update(inode);
+	giant_unlock();
 
 	free(attrname);
 	return (gfm_server_put_reply(peer, diag, e, ""));
@@ -1319,6 +1320,12 @@ findxmlattr_make_patharray(struct inode *inode,
 	if (toppath == NULL)
 		return (GFARM_ERR_NO_MEMORY);
 
+	/* no need to walk the tree, if no inode has XML attributes */
+	if (xattr_index_is_empty(1)) {
+		free(toppath);
+		return (GFARM_ERR_NO_ERROR);
+	}
+
 	e = findxmlattr_add_selfpath(inode, tenant, user, toppath, array);
 
 	if ((e == GFARM_ERR_NO_ERROR) && inode_is_dir(inode)) {
@@ -1651,3 +1658,100 @@ quit:
 			GFARM_ERR_OPERATION_NOT_SUPPORTED, "");
 #endif
 }
+
+/* the maximum number of inodes returned by one GFM_PROTO_XATTR_FIND */
+#define XATTR_FIND_MAX_NENTRIES	1024
+
+/*
+ * find inodes having the attribute by the index, instead of walking
+ * the directory tree.  since a path of a file cannot be determined
+ * from its inode, inode numbers and generations are returned, which
+ * can be opened by GFM_PROTO_FHOPEN.  thus this is only allowed for
+ * gfarmroot as well.
+ */
+gfarm_error_t
+gfm_server_findxattr(struct peer *peer, int from_client, int skip)
+{
+	gfarm_error_t e;
+	gfarm_int32_t xmlMode, match_value, nalloc;
+	char *attrname = NULL;
+	void *value = NULL;
+	size_t size;
+	gfarm_ino_t cookie, next_cookie = 0, *inums = NULL;
+	gfarm_uint64_t *gens = NULL;
+	struct process *process;
+	struct user *user;
+	struct inode *inode;
+	int i, nfound = 0, n = 0, eof = 1;
+	static const char diag[] = "GFM_PROTO_XATTR_FIND";
+
+	e = gfm_server_get_request(peer, diag, "isiBli", &xmlMode, &attrname,
+	    &match_value, &size, &value, &cookie, &nalloc);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_1005753,
+		    "%s request failed: %s", diag, gfarm_error_string(e));
+		return (e);
+	}
+	if (skip) {
+		free(attrname);
+		free(value);
+		return (GFARM_ERR_NO_ERROR);
+	}
+	next_cookie = cookie;
+	if (nalloc <= 0 || nalloc > XATTR_FIND_MAX_NENTRIES)
+		nalloc = XATTR_FIND_MAX_NENTRIES;
+
+	/* this doesn't modify any metadata */
+	giant_lock_shared();
+	if (!from_client || (process = peer_get_process(peer)) == NULL) {
+		e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+	} else if ((user = process_get_user(process)) == NULL ||
+	    !user_is_super_root(user)) {
+		e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+	} else if (match_value && (xmlMode || !gfarm_xattr_caching(attrname))) {
+		/* the index only knows the hash of a cached value */
+		e = GFARM_ERR_OPERATION_NOT_SUPPORTED;
+	} else if (GFARM_MALLOC_ARRAY(inums, nalloc) == NULL ||
+	    GFARM_MALLOC_ARRAY(gens, nalloc) == NULL) {
+		e = GFARM_ERR_NO_MEMORY;
+	} else if ((e = xattr_index_find(xmlMode != 0, attrname,
+	    match_value ? value : NULL, size, cookie, nalloc,
+	    inums, &nfound, &eof)) == GFARM_ERR_NO_ERROR) {
+		for (i = 0; i < nfound; i++) {
+			next_cookie = inums[i];
+			inode = inode_lookup(inums[i]);
+			if (inode == NULL)
+				continue;
+			/* the index only compares the hash of the value */
+			if (match_value && !inode_xattr_cache_is_same(inode, 0,
+			    attrname, value, size))
+				continue;
+			inums[n] = inums[i];
+			gens[n] = inode_get_gen(inode);
+			n++;
+		}
+	}
+	giant_unlock();
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_1005754, "%s: %s: %s",
+		    diag, attrname, gfarm_error_string(e));
+
+	/*
+	 * next_cookie is returned, since the last candidates may be
+	 * dropped above.
+	 */
+	e = gfm_server_put_reply(peer, diag, e, "iil", eof, n, next_cookie);
+	for (i = 0; e == GFARM_ERR_NO_ERROR && i < n; i++) {
+		e = gfp_xdr_send(peer_get_conn(peer), "ll", inums[i], gens[i]);
+		if (e != GFARM_ERR_NO_ERROR)
+			gflog_warning(GFARM_MSG_1005755,
+			    "%s@%s: %s: %s", peer_get_username(peer),
+			    peer_get_hostname(peer), diag,
+			    gfarm_error_string(e));
+	}
+	free(inums);
+	free(gens);
+	free(attrname);
+	free(value);
+	return (e);
+}
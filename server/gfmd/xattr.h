@@ -17,3 +17,4 @@ gfarm_error_t gfm_server_listxattr(struct peer *, int, int, int);
 gfarm_error_t gfm_server_removexattr(struct peer *, int, int, int);
 
 gfarm_error_t gfm_server_findxmlattr(struct peer *, int, int);
+gfarm_error_t gfm_server_findxattr(struct peer *, int, int);
@@ -0,0 +1,257 @@
+/*
+ * $Id$
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "hash.h"
+#include "tree.h"
+
+#include "config.h"
+
+#include "xattr_name.h"
+#include "xattr_index.h"
+
+/*
+ * inverted index from extended attribute names to inodes.
+ *
+ * for each interned name (see xattr_name.c), the set of inodes which
+ * have the attribute is kept, so that inodes having an attribute can be
+ * found without walking the directory tree and without asking the
+ * backend database.
+ * for a cached value, its hash is kept too, so that inodes having
+ * an attribute with a specific value can be found.
+ * the set is a red-black tree ordered by the inode number, so that
+ * a page of the result can be resumed from the cookie in O(log n).
+ * this is enabled by the "xattr_index" directive.
+ *
+ * PREREQUISITE: giant_lock
+ */
+
+#define XATTR_INDEX_SET_SIZE	8	/* initial, grows */
+
+struct xattr_index_member {
+	RB_ENTRY(xattr_index_member) node;
+	gfarm_ino_t inum;
+	int value_cached;
+	int value_hash;	/* only valid if value_cached */
+};
+
+struct xattr_index_set {
+	RB_HEAD(xattr_index_members, xattr_index_member) members;
+	long nmembers;
+};
+
+static int
+xattr_index_member_compare(
+	struct xattr_index_member *a, struct xattr_index_member *b)
+{
+	if (a->inum < b->inum)
+		return (-1);
+	else if (a->inum > b->inum)
+		return (1);
+	else
+		return (0);
+}
+
+RB_PROTOTYPE(xattr_index_members, xattr_index_member,
+	node, xattr_index_member_compare)
+RB_GENERATE(xattr_index_members, xattr_index_member,
+	node, xattr_index_member_compare)
+
+/* [xmlMode][name_id] */
+static struct xattr_index_set **xattr_index_sets[2];
+static int xattr_index_nsets[2];
+static gfarm_uint64_t xattr_index_nmembers[2];
+
+/* cleared if memory is exhausted, since the index becomes incomplete */
+static int xattr_index_ok = 1;
+
+int
+xattr_index_is_available(void)
+{
+	return (gfarm_xattr_index && xattr_index_ok);
+}
+
+static void
+xattr_index_disable(const char *diag)
+{
+	gflog_error(GFARM_MSG_1005751,
+	    "%s: no memory, xattr index is disabled", diag);
+	xattr_index_ok = 0;
+}
+
+static int
+xattr_index_value_hash(const void *value, int size)
+{
+	return (gfarm_hash_fast(value, size));
+}
+
+static struct xattr_index_set *
+xattr_index_set_enter(int xmlMode, int name_id)
+{
+	struct xattr_index_set **sets, *set;
+	int n;
+
+	if (name_id >= xattr_index_nsets[xmlMode]) {
+		n = xattr_index_nsets[xmlMode] == 0 ?
+		    XATTR_INDEX_SET_SIZE : xattr_index_nsets[xmlMode] * 2;
+		while (name_id >= n)
+			n *= 2;
+		GFARM_REALLOC_ARRAY(sets, xattr_index_sets[xmlMode], n);
+		if (sets == NULL)
+			return (NULL);
+		memset(&sets[xattr_index_nsets[xmlMode]], 0,
+		    (n - xattr_index_nsets[xmlMode]) * sizeof(*sets));
+		xattr_index_sets[xmlMode] = sets;
+		xattr_index_nsets[xmlMode] = n;
+	}
+	set = xattr_index_sets[xmlMode][name_id];
+	if (set != NULL)
+		return (set);
+
+	GFARM_MALLOC(set);
+	if (set == NULL)
+		return (NULL);
+	RB_INIT(&set->members);
+	set->nmembers = 0;
+	xattr_index_sets[xmlMode][name_id] = set;
+	return (set);
+}
+
+static struct xattr_index_set *
+xattr_index_set_lookup(int xmlMode, int name_id)
+{
+	if (name_id < 0 || name_id >= xattr_index_nsets[xmlMode])
+		return (NULL);
+	return (xattr_index_sets[xmlMode][name_id]);
+}
+
+/* value is NULL, if it's not cached. this also updates the value */
+void
+xattr_index_add(int xmlMode, int name_id, gfarm_ino_t inum,
+	const void *value, int size)
+{
+	struct xattr_index_set *set;
+	struct xattr_index_member key, *m;
+	static const char diag[] = "xattr_index_add";
+
+	if (!xattr_index_is_available())
+		return;
+	if ((set = xattr_index_set_enter(xmlMode, name_id)) == NULL) {
+		xattr_index_disable(diag);
+		return;
+	}
+	key.inum = inum;
+	m = RB_FIND(xattr_index_members, &set->members, &key);
+	if (m == NULL) {
+		GFARM_MALLOC(m);
+		if (m == NULL) {
+			xattr_index_disable(diag);
+			return;
+		}
+		m->inum = inum;
+		RB_INSERT(xattr_index_members, &set->members, m);
+		set->nmembers++;
+		xattr_index_nmembers[xmlMode]++;
+	}
+	m->value_cached = value != NULL;
+	m->value_hash = value != NULL ? xattr_index_value_hash(value, size) : 0;
+}
+
+void
+xattr_index_remove(int xmlMode, int name_id, gfarm_ino_t inum)
+{
+	struct xattr_index_set *set;
+	struct xattr_index_member key, *m;
+
+	if (!xattr_index_is_available())
+		return;
+	set = xattr_index_set_lookup(xmlMode, name_id);
+	if (set == NULL)
+		return;
+	key.inum = inum;
+	m = RB_FIND(xattr_index_members, &set->members, &key);
+	if (m == NULL)
+		return;
+	RB_REMOVE(xattr_index_members, &set->members, m);
+	free(m);
+	xattr_index_nmembers[xmlMode]--;
+	if (--set->nmembers > 0)
+		return;
+	/* the name_id may be reused for another name */
+	free(set);
+	xattr_index_sets[xmlMode][name_id] = NULL;
+}
+
+/* returns true, if no inode has any attribute */
+int
+xattr_index_is_empty(int xmlMode)
+{
+	return (xattr_index_is_available() &&
+	    xattr_index_nmembers[xmlMode] == 0);
+}
+
+/* returns the first member whose inode number is greater than `cookie' */
+static struct xattr_index_member *
+xattr_index_member_next(struct xattr_index_set *set, gfarm_ino_t cookie)
+{
+	struct xattr_index_member *m = RB_ROOT(&set->members), *next = NULL;
+
+	while (m != NULL) {
+		if (m->inum > cookie) {
+			next = m;
+			m = RB_LEFT(m, node);
+		} else {
+			m = RB_RIGHT(m, node);
+		}
+	}
+	return (next);
+}
+
+/*
+ * returns up to nalloc inode numbers greater than `cookie' in ascending
+ * order.  if value isn't NULL, only inodes which have a cached value
+ * with the same hash are returned, the caller has to compare the value.
+ * GFARM_ERR_OPERATION_NOT_SUPPORTED is returned in that case, if
+ * a value to be examined is not cached.
+ */
+gfarm_error_t
+xattr_index_find(int xmlMode, const char *attrname,
+	const void *value, size_t size, gfarm_ino_t cookie, int nalloc,
+	gfarm_ino_t *inums, int *np, int *eofp)
+{
+	struct xattr_index_set *set;
+	struct xattr_index_member *m;
+	int value_hash = 0, n = 0;
+
+	if (!xattr_index_is_available())
+		return (GFARM_ERR_OPERATION_NOT_SUPPORTED);
+
+	set = xattr_index_set_lookup(xmlMode, xattr_name_lookup(attrname));
+	if (set == NULL) {
+		*np = 0;
+		*eofp = 1;
+		return (GFARM_ERR_NO_ERROR);
+	}
+	if (value != NULL)
+		value_hash = xattr_index_value_hash(value, size);
+	for (m = xattr_index_member_next(set, cookie);
+	    m != NULL && n < nalloc;
+	    m = RB_NEXT(xattr_index_members, &set->members, m)) {
+		if (value != NULL) {
+			if (!m->value_cached)
+				return (GFARM_ERR_OPERATION_NOT_SUPPORTED);
+			if (m->value_hash != value_hash)
+				continue;
+		}
+		inums[n++] = m->inum;
+	}
+	*eofp = m == NULL;
+	*np = n;
+	return (GFARM_ERR_NO_ERROR);
+}
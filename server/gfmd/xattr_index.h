@@ -0,0 +1,10 @@
+/*
+ * inverted index from extended attribute names to inodes
+ */
+
+void xattr_index_add(int, int, gfarm_ino_t, const void *, int);
+void xattr_index_remove(int, int, gfarm_ino_t);
+int xattr_index_is_available(void);
+int xattr_index_is_empty(int);
+gfarm_error_t xattr_index_find(int, const char *, const void *, size_t,
+	gfarm_ino_t, int, gfarm_ino_t *, int *, int *);
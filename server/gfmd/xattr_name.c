@@ -0,0 +1,158 @@
+/*
+ * $Id$
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "hash.h"
+
+#include "xattr_name.h"
+
+/*
+ * interned names of extended attributes.
+ *
+ * thousands of inodes usually share a few dozens of attribute names,
+ * so each inode keeps a small integer id instead of its own copy of
+ * the name, and the comparison of names becomes the comparison of ids.
+ * an id is freed and reused when the last reference is removed.
+ *
+ * PREREQUISITE: giant_lock
+ */
+
+#define XATTR_NAME_HASHTAB_SIZE		256	/* initial, grows */
+
+struct xattr_name {
+	int id;
+	int refcount;
+};
+
+static struct gfarm_hash_table *xattr_name_hashtab = NULL;
+
+/* id -> hash entry, NULL if the id is free */
+static struct gfarm_hash_entry **xattr_name_by_id = NULL;
+static int xattr_name_nids = 0, xattr_name_nids_alloc = 0;
+
+/* free ids */
+static int *xattr_name_free_ids = NULL;
+static int xattr_name_nfree_ids = 0;
+
+static int
+xattr_name_table_init(void)
+{
+	if (xattr_name_hashtab != NULL)
+		return (1);
+	xattr_name_hashtab = gfarm_hash_table_alloc_resizable(
+	    XATTR_NAME_HASHTAB_SIZE,
+	    gfarm_hash_fast, gfarm_hash_key_equal_default);
+	return (xattr_name_hashtab != NULL);
+}
+
+/*
+ * the key of the hash entry includes '\0',
+ * so that it can be used as the name itself.
+ */
+#define XATTR_NAME_KEYLEN(name)	(strlen(name) + 1)
+
+/* returns -1, if the name isn't interned */
+int
+xattr_name_lookup(const char *name)
+{
+	struct gfarm_hash_entry *entry;
+
+	if (xattr_name_hashtab == NULL)
+		return (-1);
+	entry = gfarm_hash_lookup(xattr_name_hashtab,
+	    name, XATTR_NAME_KEYLEN(name));
+	if (entry == NULL)
+		return (-1);
+	return (((struct xattr_name *)gfarm_hash_entry_data(entry))->id);
+}
+
+static int
+xattr_name_id_alloc(struct gfarm_hash_entry *entry)
+{
+	int id, n;
+	struct gfarm_hash_entry **by_id;
+	int *free_ids;
+
+	if (xattr_name_nfree_ids > 0) {
+		id = xattr_name_free_ids[--xattr_name_nfree_ids];
+		xattr_name_by_id[id] = entry;
+		return (id);
+	}
+	if (xattr_name_nids >= xattr_name_nids_alloc) {
+		n = xattr_name_nids_alloc == 0 ?
+		    XATTR_NAME_HASHTAB_SIZE : xattr_name_nids_alloc * 2;
+		GFARM_REALLOC_ARRAY(by_id, xattr_name_by_id, n);
+		if (by_id == NULL)
+			return (-1);
+		xattr_name_by_id = by_id;
+		/* so that xattr_name_unref() never fails */
+		GFARM_REALLOC_ARRAY(free_ids, xattr_name_free_ids, n);
+		if (free_ids == NULL)
+			return (-1);
+		xattr_name_free_ids = free_ids;
+		xattr_name_nids_alloc = n;
+	}
+	id = xattr_name_nids++;
+	xattr_name_by_id[id] = entry;
+	return (id);
+}
+
+/* returns -1, if no memory */
+int
+xattr_name_intern(const char *name)
+{
+	struct gfarm_hash_entry *entry;
+	struct xattr_name *xn;
+	int created;
+
+	if (!xattr_name_table_init()) {
+		gflog_error(GFARM_MSG_1005748, "xattr name table: no memory");
+		return (-1);
+	}
+	entry = gfarm_hash_enter(xattr_name_hashtab,
+	    name, XATTR_NAME_KEYLEN(name), sizeof(*xn), &created);
+	if (entry == NULL) {
+		gflog_error(GFARM_MSG_1005749, "xattr name %s: no memory",
+		    name);
+		return (-1);
+	}
+	xn = gfarm_hash_entry_data(entry);
+	if (created) {
+		if ((xn->id = xattr_name_id_alloc(entry)) == -1) {
+			gfarm_hash_purge(xattr_name_hashtab,
+			    name, XATTR_NAME_KEYLEN(name));
+			gflog_error(GFARM_MSG_1005750,
+			    "xattr name id for %s: no memory", name);
+			return (-1);
+		}
+		xn->refcount = 0;
+	}
+	xn->refcount++;
+	return (xn->id);
+}
+
+void
+xattr_name_unref(int id)
+{
+	struct gfarm_hash_entry *entry = xattr_name_by_id[id];
+	struct xattr_name *xn = gfarm_hash_entry_data(entry);
+
+	if (--xn->refcount > 0)
+		return;
+	xattr_name_by_id[id] = NULL;
+	xattr_name_free_ids[xattr_name_nfree_ids++] = id;
+	gfarm_hash_purge(xattr_name_hashtab, gfarm_hash_entry_key(entry),
+	    gfarm_hash_entry_key_length(entry));
+}
+
+const char *
+xattr_name_get(int id)
+{
+	return (gfarm_hash_entry_key(xattr_name_by_id[id]));
+}
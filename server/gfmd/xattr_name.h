@@ -0,0 +1,8 @@
+/*
+ * interned names of extended attributes
+ */
+
+int xattr_name_lookup(const char *);
+int xattr_name_intern(const char *);
+void xattr_name_unref(int);
+const char *xattr_name_get(int);
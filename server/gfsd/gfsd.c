@@ -67,6 +67,7 @@
 #include "hash.h"
 #define GFARM_USE_OPENSSL
 #include "msgdigest.h"
+#include "msgdigest_engine.h"
 #include "nanosec.h"
 #include "proctitle.h"
 #include "timer.h"
@@ -75,6 +76,7 @@
 #include "context.h"
 #include "gfp_xdr.h"
 #include "io_fd.h"
+#include "io_tls.h"
 #include "sockopt.h"
 #include "hostspec.h"
 #include "host.h"
@@ -181,6 +183,22 @@ static struct gfarm_iostat_spec iostat_spec[] =  {
 static char *iostat_dirbuf;
 static int iostat_dirlen;
 
+/* latency histograms per operation and per spool directory */
+enum iostat_hist_op {
+	IOSTAT_HIST_READ,
+	IOSTAT_HIST_WRITE,
+	IOSTAT_HIST_BULKREAD,
+	IOSTAT_HIST_BULKWRITE,
+	IOSTAT_HIST_FSYNC,
+	IOSTAT_HIST_NOP
+};
+static const char *const iostat_hist_op_names[IOSTAT_HIST_NOP] = {
+	"read", "write", "bulkread", "bulkwrite", "fsync",
+};
+static struct gfarm_iostat_hist
+	*iostat_hists[IOSTAT_HIST_NOP][GFARM_SPOOL_ROOT_NUM];
+static int iostat_hist_enabled;
+
 struct rdma_context *rdma_ctx = NULL;
 
 static volatile sig_atomic_t write_open_count = 0;
@@ -204,6 +222,30 @@ struct accepting_sockets {
 	struct local_socket *local_socks;
 } accepting;
 
+/*
+ * client worker pool, used if spool_server_worker_pool_size > 0.
+ * a worker is a type_client process which serves client connections
+ * one after another, keeping its gfmd connection.
+ * the listener passes an accepted socket to an idle worker via ctl_fd,
+ * and the worker writes one byte to ctl_fd when it becomes idle again.
+ *
+ * this saves fork(2) and the authentication to gfmd at connection setup,
+ * but not memory: a worker serves only one client at a time, so every
+ * concurrent client still has its own process, file table and
+ * gfmd connection, and idle workers keep theirs.
+ */
+struct client_worker {
+	pid_t pid; /* 0: unused slot */
+	int ctl_fd;
+	int busy;
+};
+static struct client_worker *client_workers = NULL;
+
+struct client_worker_request {
+	int is_local;
+	struct sockaddr_in client_addr;
+};
+
 
 /* this routine should be called before the accepting server calls exit(). */
 void
@@ -241,22 +283,70 @@ cleanup_iostat(int sighandler)
 		iostat_dirbuf = NULL;
 	}
 }
+
+static void
+gfsd_setup_iostat_hist(void)
+{
+	int op, i;
+	char name[GFARM_IOSTAT_NAME_MAX + 1];
+
+	for (op = 0; op < IOSTAT_HIST_NOP; op++) {
+		for (i = 0; i < gfarm_spool_root_num; i++) {
+			snprintf(name, sizeof(name), "%s:%d",
+			    iostat_hist_op_names[op], i);
+			iostat_hists[op][i] = gfarm_iostat_get_hist(
+			    op * gfarm_spool_root_num + i, name);
+		}
+	}
+	iostat_hist_enabled = 1;
+}
+
 void
-gfsd_setup_iostat(const char *name, unsigned int row)
+gfsd_setup_iostat(const char *name, unsigned int row, int with_hist)
 {
 	if (iostat_dirbuf) {
 		gfarm_error_t e;
+		unsigned int nhist =
+		    with_hist ? IOSTAT_HIST_NOP * gfarm_spool_root_num : 0;
+
 		strncpy(&iostat_dirbuf[iostat_dirlen], name,
 				IOSTAT_PATH_NAME_MAX);
-		e = gfarm_iostat_mmap(iostat_dirbuf, iostat_spec,
-			GFARM_IOSTAT_IO_NITEM, row);
+		e = gfarm_iostat_mmap_hist(iostat_dirbuf, iostat_spec,
+			GFARM_IOSTAT_IO_NITEM, row, nhist);
 		if (e != GFARM_ERR_NO_ERROR)
 			gflog_error(GFARM_MSG_1004507,
 				"gfarm_iostat_mmap('%s', %d): %s",
 				iostat_dirbuf, row, gfarm_error_string(e));
-
+		else if (nhist > 0)
+			gfsd_setup_iostat_hist();
 	}
 }
+
+static void
+iostat_hist_begin(struct timespec *start)
+{
+	if (iostat_hist_enabled)
+		gfarm_gettime(start);
+}
+
+static void
+iostat_hist_end(enum iostat_hist_op op, int spool_index,
+	const struct timespec *start)
+{
+	struct timespec now;
+	gfarm_int64_t usec;
+
+	if (!iostat_hist_enabled)
+		return;
+	gfarm_gettime(&now);
+	usec = (gfarm_int64_t)(now.tv_sec - start->tv_sec) *
+	    GFARM_SECOND_BY_MICROSEC +
+	    (now.tv_nsec - start->tv_nsec) / GFARM_MICROSEC_BY_NANOSEC;
+	if (usec < 0) /* the clock was adjusted */
+		usec = 0;
+	gfarm_iostat_hist_add(iostat_hists[op][spool_index], usec);
+}
+
 static void close_all_fd(struct gfp_xdr *);
 static int close_all_fd_for_process_reset(struct gfp_xdr *);
 static struct gfp_xdr *current_client = NULL;
@@ -957,6 +1047,12 @@ do_fork(enum gfsd_type new_type)
 				close(accepting.local_socks[i].sock);
 				accepting.local_socks[i].sock = -1;
 			}
+			for (i = 0; client_workers != NULL &&
+			    i < gfarm_spool_server_worker_pool_size; i++) {
+				if (client_workers[i].ctl_fd != -1)
+					close(client_workers[i].ctl_fd);
+				client_workers[i].ctl_fd = -1;
+			}
 			close(accepting.tcp_sock);
 			accepting.tcp_sock = -1;
 			for (i = 0; i < accepting.udp_socks_count; i++) {
@@ -968,9 +1064,9 @@ do_fork(enum gfsd_type new_type)
 		if (new_type == type_back_channel) {
 			/* this should be set before fatal() */
 			back_channel_gfsd_pid = getpid();
-			gfsd_setup_iostat("bcs", gfarm_iostat_max_client);
+			gfsd_setup_iostat("bcs", gfarm_iostat_max_client, 0);
 		} else if (new_type == type_write_verify_controller)
-			gfsd_setup_iostat("wv", 2);
+			gfsd_setup_iostat("wv", 2, 0);
 
 		my_type = new_type; /* this should be set before fatal() */
 		if (USING_PIPE_FOR_FAILOVER_SIGNAL(my_type)) {
@@ -1461,6 +1557,7 @@ struct file_entry {
 	int local_fd;
 	int local_fd_rdonly; /* only for register_to_lost_found() */
 	int flags, local_flags;
+	int spool_index; /* index of gfarm_spool_root[] */
 #define FILE_FLAG_LOCAL		0x01
 #define FILE_FLAG_CREATED	0x02
 #define FILE_FLAG_WRITABLE	0x04
@@ -1703,8 +1800,9 @@ file_table_add(gfarm_int32_t net_fd,
 		free(path);
 		return (gfarm_errno_to_error(save_errno));
 	}
-	free(path);
 	fe = &file_table[net_fd];
+	fe->spool_index = gfsd_spool_root_index(path);
+	free(path);
 	fe->local_fd = *local_fdp = local_fd;
 	fe->local_fd_rdonly = local_fd_rdonly;
 	fe->local_flags = flags;
@@ -2011,6 +2109,20 @@ gfsd_make_path(const char *relpath, const char *diag)
 	return (p);
 }
 
+int
+gfsd_spool_root_index(const char *path)
+{
+	int i, len;
+
+	for (i = 0; i < gfarm_spool_root_num; ++i) {
+		len = strlen(gfarm_spool_root[i]);
+		if (strncmp(gfarm_spool_root[i], path, len) == 0 &&
+		    path[len] == '/')
+			return (i);
+	}
+	return (0);
+}
+
 char *
 gfsd_skip_spool_root(char *path)
 {
@@ -2804,6 +2916,14 @@ fhclose_result(struct file_entry *fe, gfarm_uint64_t *cookie_p,
 	}
 }
 
+static void
+calc_digest_iostat(void *closure, ssize_t sz)
+{
+	gfarm_iostat_local_add(GFARM_IOSTAT_IO_RCOUNT, 1);
+	gfarm_iostat_local_add(GFARM_IOSTAT_IO_RBYTES, sz);
+}
+
+/* data_bufsize is split into GFARM_MSGDIGEST_ENGINE_NBUF chunks */
 gfarm_error_t
 calc_digest(int fd,
 	const char *md_type_name, char *md_string, size_t *md_strlenp,
@@ -2811,7 +2931,7 @@ calc_digest(int fd,
 	char *data_buf, size_t data_bufsize,
 	const char *diag, gfarm_ino_t diag_ino, gfarm_uint64_t diag_gen)
 {
-	ssize_t sz;
+	int save_errno;
 	gfarm_off_t calc_len = 0;
 	gfarm_error_t e = GFARM_ERR_NO_ERROR;
 
@@ -2827,15 +2947,14 @@ calc_digest(int fd,
 	if (md_ctx == NULL)
 		return (GFARM_ERR_OPERATION_NOT_SUPPORTED);
 
-	while ((sz = read(fd, data_buf, data_bufsize)) > 0) {
-		EVP_DigestUpdate(md_ctx, data_buf, sz);
-		calc_len += sz;
-		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RCOUNT, 1);
-		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RBYTES, sz);
+	/* reading the next chunk is overlapped with hashing */
+	save_errno = gfarm_msgdigest_fd(md_ctx, fd, data_buf, data_bufsize,
+	    &calc_len, calc_digest_iostat, NULL);
+	if (save_errno != 0) {
+		errno = save_errno;
+		io_error_check_errno("calc_digest");
+		e = gfarm_errno_to_error(save_errno);
 	}
-	io_error_check_errno("calc_digest");
-	if (sz == -1)
-		e = gfarm_errno_to_error(errno);
 
 	md_len = gfarm_msgdigest_free(md_ctx, md_value);
 	if (e == GFARM_ERR_NO_ERROR) {
@@ -3398,6 +3517,7 @@ gfs_server_pread(struct gfp_xdr *client)
 	struct file_entry *fe;
 	gfarm_error_t e = GFARM_ERR_NO_ERROR;
 	gfarm_timerval_t t1, t2;
+	struct timespec start;
 	static const char diag[] = "GFS_PROTO_PREAD";
 
 	gfs_server_get_request(client, diag, "iil", &fd, &size, &offset);
@@ -3414,6 +3534,7 @@ gfs_server_pread(struct gfp_xdr *client)
 	}
 	GFARM_TIMEVAL_FIX_INITIALIZE_WARNING(t1);
 	gfs_profile(gfarm_gettimerval(&t1));
+	iostat_hist_begin(&start);
 
 	/* We truncatef i/o size bigger than GFS_PROTO_MAX_IOSIZE. */
 	if (size > GFS_PROTO_MAX_IOSIZE)
@@ -3441,6 +3562,7 @@ gfs_server_pread(struct gfp_xdr *client)
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RCOUNT, 1);
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RBYTES, rv);
 	}
+	iostat_hist_end(IOSTAT_HIST_READ, fe->spool_index, &start);
 	gfs_profile(
 		gfarm_gettimerval(&t2);
 		fe->nread++;
@@ -3473,6 +3595,7 @@ gfs_server_pwrite(struct gfp_xdr *client)
 	unsigned char buffer[GFS_PROTO_MAX_IOSIZE];
 	struct file_entry *fe;
 	gfarm_timerval_t t1, t2;
+	struct timespec start;
 	static const char diag[] = "GFS_PROTO_PWRITE";
 
 	gfs_server_get_request(client, diag, "ibl",
@@ -3490,6 +3613,7 @@ gfs_server_pwrite(struct gfp_xdr *client)
 	}
 	GFARM_TIMEVAL_FIX_INITIALIZE_WARNING(t1);
 	gfs_profile(gfarm_gettimerval(&t1));
+	iostat_hist_begin(&start);
 	/*
 	 * We truncate i/o size bigger than GFS_PROTO_MAX_IOSIZE.
 	 * This is inefficient because passed extra data are just
@@ -3527,6 +3651,7 @@ gfs_server_pwrite(struct gfp_xdr *client)
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_WCOUNT, 1);
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_WBYTES, rv);
 	}
+	iostat_hist_end(IOSTAT_HIST_WRITE, fe->spool_index, &start);
 	gfs_profile(
 		gfarm_gettimerval(&t2);
 		fe->nwrite++;
@@ -3548,6 +3673,7 @@ gfs_server_write(struct gfp_xdr *client)
 	char buffer[GFS_PROTO_MAX_IOSIZE];
 	struct file_entry *fe;
 	gfarm_timerval_t t1, t2;
+	struct timespec start;
 	static const char diag[] = "GFS_PROTO_WRITE";
 
 #ifdef __GNUC__ /* workaround gcc warning: may be used uninitialized */
@@ -3569,6 +3695,7 @@ gfs_server_write(struct gfp_xdr *client)
 
 	GFARM_TIMEVAL_FIX_INITIALIZE_WARNING(t1);
 	gfs_profile(gfarm_gettimerval(&t1));
+	iostat_hist_begin(&start);
 	/*
 	 * We truncate i/o size bigger than GFS_PROTO_MAX_IOSIZE.
 	 * This is inefficient because passed extra data are just
@@ -3604,6 +3731,7 @@ gfs_server_write(struct gfp_xdr *client)
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_WCOUNT, 1);
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_WBYTES, rv);
 	}
+	iostat_hist_end(IOSTAT_HIST_WRITE, fe->spool_index, &start);
 	gfs_profile(
 		gfarm_gettimerval(&t2);
 		fe->nwrite++;
@@ -3614,6 +3742,35 @@ gfs_server_write(struct gfp_xdr *client)
 	    "ill", (gfarm_int32_t)rv, written_offset, total_file_size);
 }
 
+#if defined(HAVE_LINUX_SENDFILE) || defined(HAVE_LINUX_SPLICE)
+/*
+ * sendfile(2) and splice(2) can be used only with a plain TCP connection,
+ * and only if the digest doesn't have to be calculated in the userland.
+ */
+static int
+zerocopy_is_available(struct gfp_xdr *conn, EVP_MD_CTX *md_ctx)
+{
+	return (gfarm_spool_server_zerocopy && md_ctx == NULL &&
+	    gfp_xdr_is_socket(conn));
+}
+#endif
+
+#ifdef HAVE_LINUX_SENDFILE
+/*
+ * sendfile(2) can be used with kTLS as well, see "tls_ktls".
+ */
+static int
+sendfile_is_available(struct gfp_xdr *conn, EVP_MD_CTX *md_ctx)
+{
+#ifdef HAVE_TLS_1_3
+	if (gfarm_spool_server_zerocopy && md_ctx == NULL &&
+	    gfp_xdr_tls_is_ktls_send(conn))
+		return (1);
+#endif
+	return (zerocopy_is_available(conn, md_ctx));
+}
+#endif
+
 void
 gfs_server_bulkread(struct gfp_xdr *client)
 {
@@ -3624,6 +3781,7 @@ gfs_server_bulkread(struct gfp_xdr *client)
 	struct file_entry *fe;
 	EVP_MD_CTX *md_ctx;
 	gfarm_timerval_t t1, t2;
+	struct timespec start;
 	static const char diag[] = "GFS_PROTO_BULKREAD";
 
 	gfs_server_get_request(client, diag, "ill", &fd, &len, &offset);
@@ -3647,6 +3805,7 @@ gfs_server_bulkread(struct gfp_xdr *client)
 	if (e == GFARM_ERR_NO_ERROR) {
 		GFARM_TIMEVAL_FIX_INITIALIZE_WARNING(t1);
 		gfs_profile(gfarm_gettimerval(&t1));
+		iostat_hist_begin(&start);
 
 		/* update checksum? */
 		if ((fe->flags &
@@ -3660,6 +3819,12 @@ gfs_server_bulkread(struct gfp_xdr *client)
 			md_ctx = fe->md_ctx;
 		}
 
+#ifdef HAVE_LINUX_SENDFILE
+		if (sendfile_is_available(client, md_ctx))
+			e = gfs_sendfile_zerocopy(client, &src_err,
+			    fe->local_fd, offset, len, &sent);
+		else
+#endif
 		e = gfs_sendfile_common(client, &src_err,
 		    fe->local_fd, offset, len, md_ctx, &sent);
 		io_error_check(src_err, diag);
@@ -3679,6 +3844,7 @@ gfs_server_bulkread(struct gfp_xdr *client)
 		}
 		if (sent > 0)
 			file_table_set_read(fe->local_fd);
+		iostat_hist_end(IOSTAT_HIST_BULKREAD, fe->spool_index, &start);
 
 		gfs_profile(
 			gfarm_gettimerval(&t2);
@@ -3705,8 +3871,9 @@ gfs_server_bulkwrite(struct gfp_xdr *client)
 	gfarm_off_t written = 0;
 	struct file_entry *fe;
 	EVP_MD_CTX *md_ctx;
-	int md_aborted;
+	int md_aborted = 0;
 	gfarm_timerval_t t1, t2;
+	struct timespec start;
 	static const char diag[] = "GFS_PROTO_BULKWRITE";
 
 	gfs_server_get_request(client, diag, "il", &fd, &offset);
@@ -3733,6 +3900,7 @@ gfs_server_bulkwrite(struct gfp_xdr *client)
 	if (e == GFARM_ERR_NO_ERROR) {
 		GFARM_TIMEVAL_FIX_INITIALIZE_WARNING(t1);
 		gfs_profile(gfarm_gettimerval(&t1));
+		iostat_hist_begin(&start);
 
 		/* update checksum? */
 		if ((fe->flags &
@@ -3750,6 +3918,13 @@ gfs_server_bulkwrite(struct gfp_xdr *client)
 			md_ctx = fe->md_ctx;
 		}
 
+#ifdef HAVE_LINUX_SPLICE
+		if ((fe->local_flags & O_APPEND) == 0 &&
+		    zerocopy_is_available(client, md_ctx))
+			e = gfs_recvfile_zerocopy(client, &dst_err,
+			    fe->local_fd, offset, &written);
+		else
+#endif
 		e = gfs_recvfile_common(client, &dst_err, fe->local_fd, offset,
 		    (fe->local_flags & O_APPEND) != 0, md_ctx, &md_aborted,
 		    &written);
@@ -3765,6 +3940,8 @@ gfs_server_bulkwrite(struct gfp_xdr *client)
 			if (e != GFARM_ERR_NO_ERROR || md_aborted)
 				fe->flags &= ~FILE_FLAG_DIGEST_CALC;
 		}
+		iostat_hist_end(IOSTAT_HIST_BULKWRITE, fe->spool_index,
+		    &start);
 
 		gfs_profile(
 			gfarm_gettimerval(&t2);
@@ -3841,6 +4018,8 @@ gfs_server_fsync(struct gfp_xdr *client)
 	int fd;
 	int operation;
 	int save_errno = 0;
+	struct file_entry *fe;
+	struct timespec start;
 	static const char diag[] = "GFS_PROTO_FSYNC";
 
 	gfs_server_get_request(client, diag, "ii", &fd, &operation);
@@ -3851,6 +4030,7 @@ gfs_server_fsync(struct gfp_xdr *client)
 		return;
 	}
 
+	iostat_hist_begin(&start);
 	switch (operation) {
 	case GFS_PROTO_FSYNC_WITHOUT_METADATA:
 #ifdef HAVE_FDATASYNC
@@ -3868,6 +4048,8 @@ gfs_server_fsync(struct gfp_xdr *client)
 		save_errno = EINVAL;
 		break;
 	}
+	if (save_errno == 0 && (fe = file_table_entry(fd)) != NULL)
+		iostat_hist_end(IOSTAT_HIST_FSYNC, fe->spool_index, &start);
 
 	gfs_server_put_reply_with_errno(client, diag, save_errno, "");
 }
@@ -3913,7 +4095,8 @@ gfs_server_cksum(struct gfp_xdr *client)
 	char *type = NULL, cksum[GFARM_MSGDIGEST_STRSIZE];
 	size_t len = 0;
 	gfarm_error_t e;
-#define DATA_BUFSIZE	65536 /* small size is better, because of read-ahead */
+	/* small size is better, because of read-ahead */
+#define DATA_BUFSIZE	(GFARM_MSGDIGEST_ENGINE_NBUF * 65536)
 	char data_buf[DATA_BUFSIZE];
 	static const char diag[] = "GFS_PROTO_CKSUM";
 
@@ -4458,6 +4641,12 @@ gfs_server_replica_recv(struct gfp_xdr *client,
 
 	error = GFARM_ERR_NO_ERROR;
 	/* data transfer */
+#ifdef HAVE_LINUX_SENDFILE
+	if (sendfile_is_available(client, md_ctx))
+		e = gfs_sendfile_zerocopy(client, &src_err, local_fd, 0, -1,
+		    &sent);
+	else
+#endif
 	e = gfs_sendfile_common(client, &src_err, local_fd, 0, -1,
 	    md_ctx, &sent);
 	io_error_check(src_err, diag);
@@ -4572,6 +4761,72 @@ gfs_async_server_fhremove(struct gfp_xdr *conn, gfp_xdr_xid_t xid, size_t size)
 	    "fhremove", save_errno, ""));
 }
 
+static gfarm_error_t
+gfs_async_server_fhremove_multi_recv_item(struct gfp_xdr *conn, size_t *sizep,
+	int i, void *closure)
+{
+	gfarm_int32_t *errs = closure;
+	gfarm_error_t e;
+	gfarm_ino_t ino;
+	gfarm_uint64_t gen;
+	int eof;
+	char *path;
+
+	e = gfp_xdr_recv_sized(conn, 0, 1, sizep, &eof, "ll", &ino, &gen);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (eof)
+		return (GFARM_ERR_UNEXPECTED_EOF);
+
+	gfsd_local_path(ino, gen, "fhremove_multi", &path);
+	errs[i] = gfarm_errno_to_error(unlink(path) == -1 ? errno : 0);
+	free(path);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+gfs_async_server_fhremove_multi_send_item(struct gfp_xdr *conn, size_t *sizep,
+	int i, void *closure)
+{
+	gfarm_int32_t *errs = closure;
+
+	if (conn == NULL)
+		return (gfp_xdr_send_size_add(sizep, "i", errs[i]));
+	return (gfp_xdr_send_notimeout(conn, "i", errs[i]));
+}
+
+gfarm_error_t
+gfs_async_server_fhremove_multi(struct gfp_xdr *conn, gfp_xdr_xid_t xid,
+	size_t size)
+{
+	gfarm_error_t e;
+	int n;
+	gfarm_int32_t errs[GFS_PROTO_MAX_FHREMOVE_MULTI];
+	static const char diag[] = "fhremove_multi";
+
+	e = gfp_xdr_recv_items_sized(conn, 0, 1, &size,
+	    GFS_PROTO_MAX_FHREMOVE_MULTI, &n,
+	    gfs_async_server_fhremove_multi_recv_item, errs);
+	if (e == GFARM_ERR_NO_ERROR && size != 0)
+		e = GFARM_ERR_PROTOCOL;
+	if (e != GFARM_ERR_NO_ERROR) {
+		/* XXX FIXME: should handle GFARM_ERR_NO_MEMORY gracefully */
+		gflog_error(GFARM_MSG_1005784, "%s get request: %s",
+		    diag, gfarm_error_string(e));
+		return (e);
+	}
+
+	e = gfp_xdr_send_async_result_items_notimeout(conn, xid,
+	    GFARM_ERR_NO_ERROR, n, gfs_async_server_fhremove_multi_send_item,
+	    errs);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = gfp_xdr_flush_notimeout(conn);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_error(GFARM_MSG_1005831, "%s put reply: %s",
+		    diag, gfarm_error_string(e));
+	return (e);
+}
+
 /* a * b / 1024 */
 static gfarm_off_t
 multiply_and_divide_by_1024(gfarm_off_t a, gfarm_off_t b)
@@ -5698,12 +5953,17 @@ wait_fd_with_failover_pipe(int waiting_fd, const char *diag)
 	}
 }
 
-void
-server(int client_fd, char *client_name, struct sockaddr *client_addr)
+/*
+ * serve a client connection until the client disconnects.
+ * this exits the process on errors.
+ */
+static void
+server_session(int client_fd, char *client_name,
+	struct sockaddr *client_addr)
 {
 	gfarm_error_t e;
 	struct gfp_xdr *client;
-	int eof;
+	int eof, client_name_allocated = 0;
 	gfarm_int32_t request, last_request = -1;
 	char *aux, addr_string[GFARM_SOCKADDR_STRLEN];
 	enum gfarm_auth_id_role peer_role;
@@ -5711,13 +5971,16 @@ server(int client_fd, char *client_name, struct sockaddr *client_addr)
 
 	(void)gfarm_proctitle_set("client");
 
-	if ((e = connect_gfm_server("gfsd-for-client")) != GFARM_ERR_NO_ERROR)
+	/* a client worker keeps the connection for the previous client */
+	if (gfm_server == NULL &&
+	    (e = connect_gfm_server("gfsd-for-client")) != GFARM_ERR_NO_ERROR)
 		fatal(GFARM_MSG_1003361, "die");
 
 	if (client_name == NULL) { /* i.e. not UNIX domain socket case */
 		char *s;
 		int port;
 
+		client_name_allocated = 1;
 		e = gfarm_sockaddr_to_name(client_addr, &client_name);
 		if (e != GFARM_ERR_NO_ERROR) {
 			gfarm_sockaddr_to_string(client_addr,
@@ -5796,13 +6059,9 @@ server(int client_fd, char *client_name, struct sockaddr *client_addr)
 			    gfarm_error_string(e));
 		}
 		if (eof) {
-			/*
-			 * XXX FIXME update metadata of all opened
-			 * file descriptor before exit.
-			 */
-
-			cleanup(0);
-			exit(0);
+			if (client_name_allocated)
+				free(client_name);
+			return;
 		}
 		switch (request) {
 		case GFS_PROTO_PROCESS_SET:
@@ -5865,6 +6124,319 @@ server(int client_fd, char *client_name, struct sockaddr *client_addr)
 	}
 }
 
+void
+server(int client_fd, char *client_name, struct sockaddr *client_addr)
+{
+	server_session(client_fd, client_name, client_addr);
+
+	/*
+	 * XXX FIXME update metadata of all opened
+	 * file descriptor before exit.
+	 */
+	cleanup(0);
+	exit(0);
+}
+
+/*
+ * credentials of a client worker at its start.
+ * gfsd doesn't switch credentials for a client, but a worker verifies
+ * that no client leaves them changed before it serves the next client.
+ */
+static struct {
+	uid_t euid;
+	gid_t egid;
+	int ngroups;
+	gid_t *groups;
+} client_worker_cred;
+
+static void
+client_worker_cred_save(void)
+{
+	int n = getgroups(0, NULL);
+
+	client_worker_cred.euid = geteuid();
+	client_worker_cred.egid = getegid();
+	if (n > 0)
+		GFARM_MALLOC_ARRAY(client_worker_cred.groups, n);
+	if (n < 0 || (n > 0 && client_worker_cred.groups == NULL) ||
+	    (n = getgroups(n, client_worker_cred.groups)) < 0)
+		fatal_errno(GFARM_MSG_1005822, "client worker: getgroups");
+	client_worker_cred.ngroups = n;
+}
+
+/* returns 0, if the credentials cannot be restored */
+static int
+client_worker_cred_restore(void)
+{
+	int n, same;
+	gid_t *groups;
+
+	if (geteuid() != client_worker_cred.euid) {
+		gflog_warning(GFARM_MSG_1005823,
+		    "client worker: euid %ld is left, restoring %ld",
+		    (long)geteuid(), (long)client_worker_cred.euid);
+		/* setegid() below may need the privilege */
+		(void)seteuid(0);
+	}
+	if (getegid() != client_worker_cred.egid &&
+	    setegid(client_worker_cred.egid) == -1)
+		return (0);
+	if (geteuid() != client_worker_cred.euid &&
+	    seteuid(client_worker_cred.euid) == -1)
+		return (0);
+	if ((n = getgroups(0, NULL)) != client_worker_cred.ngroups)
+		return (0);
+	if (n == 0)
+		return (1);
+	GFARM_MALLOC_ARRAY(groups, n);
+	if (groups == NULL)
+		return (0);
+	same = getgroups(n, groups) == n && memcmp(groups,
+	    client_worker_cred.groups, sizeof(*groups) * n) == 0;
+	free(groups);
+	return (same);
+}
+
+/*
+ * a client worker calls this after the client disconnected,
+ * to clear everything about the client before serving the next one.
+ * returns 0, if the worker cannot be reused.
+ */
+static int
+client_session_end(void)
+{
+	gfarm_error_t e;
+	char *aux = gflog_get_auxiliary_info();
+	int i, reusable = 1;
+
+	close_all_fd(current_client);
+	for (i = 0; i < file_table_size; i++) {
+		if (file_table[i].local_fd != -1) {
+			gflog_error(GFARM_MSG_1005824,
+			    "client worker: fd %d is left open", i);
+			reusable = 0;
+		}
+	}
+	if (write_open_count != 0 || terminate_flag)
+		reusable = 0;
+#ifdef HAVE_INFINIBAND
+	gfs_rdma_finish(rdma_ctx);
+	rdma_ctx = NULL;
+#endif
+	if (gfm_server != NULL && gfm_client_process_is_set(gfm_server) &&
+	    (e = gfm_client_process_free(gfm_server)) != GFARM_ERR_NO_ERROR) {
+		gflog_notice(GFARM_MSG_1005682,
+		    "gfm_client_process_free: %s, reconnecting to gfmd",
+		    gfarm_error_string(e));
+		free_gfm_server(); /* reconnected by the next client */
+	}
+	/* file descriptors given by gfmd to the next client are usable */
+	fd_usable_to_gfmd = 1;
+	client_failover_count = 0;
+	/* connections to other gfsd, e.g. for GFS_PROTO_REPLICA_ADD_FROM */
+	gfs_client_connection_gc();
+	gfp_xdr_free(current_client);
+	current_client = NULL;
+	gflog_notice(GFARM_MSG_1005683, "disconnected");
+
+	gflog_set_auxiliary_info(NULL);
+	free(aux);
+	free(username);
+	username = NULL;
+
+	if (!client_worker_cred_restore()) {
+		gflog_error(GFARM_MSG_1005825,
+		    "client worker: credentials cannot be restored");
+		reusable = 0;
+	}
+	return (reusable);
+}
+
+static void
+client_worker_main(int ctl_fd)
+{
+	struct client_worker_request req;
+	int rv, client;
+	char idle = 0;
+	static const char diag[] = "client worker";
+
+	client_worker_cred_save();
+	for (;;) {
+		(void)gfarm_proctitle_set("client worker");
+		wait_fd_with_failover_pipe(ctl_fd, diag);
+		client = -1;
+		rv = gfarm_fd_receive_message(ctl_fd, &req, sizeof(req),
+		    1, &client);
+		if (rv == -1) { /* EOF, i.e. the listener has exited */
+			gflog_debug(GFARM_MSG_1005684,
+			    "%s: listener has gone", diag);
+			exit(0);
+		}
+		if (rv != 0)
+			fatal(GFARM_MSG_1005685, "%s: receiving a client: %s",
+			    diag, strerror(rv));
+		if (client == -1)
+			fatal(GFARM_MSG_1005686,
+			    "%s: client descriptor is not passed", diag);
+
+		server_session(client,
+		    req.is_local ? canonical_self_name : NULL,
+		    (struct sockaddr *)&req.client_addr);
+		/* the listener forks another worker, if necessary */
+		if (!client_session_end())
+			exit(0);
+
+		if (write(ctl_fd, &idle, sizeof(idle)) != sizeof(idle))
+			fatal_errno(GFARM_MSG_1005687, "%s: notify idle", diag);
+	}
+}
+
+static void
+client_worker_gone(struct client_worker *w)
+{
+	close(w->ctl_fd);
+	w->ctl_fd = -1;
+	w->pid = 0;
+	w->busy = 0;
+}
+
+static struct client_worker *
+client_worker_spawn(void)
+{
+	int i, sv[2];
+	pid_t pid;
+	struct client_worker *w = NULL;
+
+	for (i = 0; i < gfarm_spool_server_worker_pool_size; i++) {
+		if (client_workers[i].pid == 0) {
+			w = &client_workers[i];
+			break;
+		}
+	}
+	if (w == NULL) /* the pool is full */
+		return (NULL);
+	if (socketpair(PF_UNIX, SOCK_STREAM, 0, sv) == -1) {
+		gflog_warning_errno(GFARM_MSG_1005688,
+		    "client worker: socketpair");
+		return (NULL);
+	}
+	if (sv[0] >= FD_SETSIZE) {
+		gflog_warning(GFARM_MSG_1005689,
+		    "client worker: too big socket file descriptor: %d",
+		    sv[0]);
+		close(sv[0]);
+		close(sv[1]);
+		return (NULL);
+	}
+	switch ((pid = do_fork(type_client))) {
+	case 0:
+		close(sv[0]);
+		client_worker_main(sv[1]);
+		/*NOTREACHED*/
+	case -1:
+		gflog_warning_errno(GFARM_MSG_1005690, "client worker: fork");
+		close(sv[0]);
+		close(sv[1]);
+		return (NULL);
+	default:
+		close(sv[1]);
+		w->pid = pid;
+		w->ctl_fd = sv[0];
+		w->busy = 0;
+		return (w);
+	}
+}
+
+/*
+ * pass the client connection to an idle client worker.
+ * returns 0, if all workers are busy and the pool is full.
+ */
+static int
+client_worker_dispatch(int client, struct sockaddr *client_addr,
+	char *client_name)
+{
+	int i, rv;
+	struct client_worker *w;
+	struct client_worker_request req;
+
+	if (client_workers == NULL) {
+		GFARM_MALLOC_ARRAY(client_workers,
+		    gfarm_spool_server_worker_pool_size);
+		if (client_workers == NULL) {
+			gflog_warning(GFARM_MSG_1005691,
+			    "client worker pool: no memory");
+			gfarm_spool_server_worker_pool_size = 0;
+			return (0);
+		}
+		for (i = 0; i < gfarm_spool_server_worker_pool_size; i++) {
+			client_workers[i].pid = 0;
+			client_workers[i].ctl_fd = -1;
+			client_workers[i].busy = 0;
+		}
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.is_local = client_name != NULL;
+	memcpy(&req.client_addr, client_addr, sizeof(req.client_addr));
+	for (;;) {
+		w = NULL;
+		for (i = 0; i < gfarm_spool_server_worker_pool_size; i++) {
+			if (client_workers[i].pid != 0 &&
+			    !client_workers[i].busy) {
+				w = &client_workers[i];
+				break;
+			}
+		}
+		if (w == NULL && (w = client_worker_spawn()) == NULL)
+			return (0);
+		rv = fd_send_message(w->ctl_fd, &req, sizeof(req), 1, &client);
+		if (rv == 0) {
+			w->busy = 1;
+			return (1);
+		}
+		/* the worker may have died */
+		gflog_notice(GFARM_MSG_1005692, "client worker %ld: %s",
+		    (long)w->pid, strerror(rv));
+		client_worker_gone(w);
+	}
+}
+
+static void
+client_workers_fd_set(fd_set *fds, int *max_fdp)
+{
+	int i;
+
+	for (i = 0; client_workers != NULL &&
+	    i < gfarm_spool_server_worker_pool_size; i++) {
+		if (client_workers[i].pid == 0)
+			continue;
+		FD_SET(client_workers[i].ctl_fd, fds);
+		if (*max_fdp < client_workers[i].ctl_fd)
+			*max_fdp = client_workers[i].ctl_fd;
+	}
+}
+
+static void
+client_workers_check(fd_set *fds)
+{
+	int i;
+	ssize_t rv;
+	char buf[16];
+	struct client_worker *w;
+
+	for (i = 0; client_workers != NULL &&
+	    i < gfarm_spool_server_worker_pool_size; i++) {
+		w = &client_workers[i];
+		if (w->pid == 0 || !FD_ISSET(w->ctl_fd, fds))
+			continue;
+		rv = read(w->ctl_fd, buf, sizeof(buf));
+		if (rv > 0)
+			w->busy = 0;
+		else if (rv == 0 || (errno != EINTR && errno != EAGAIN))
+			client_worker_gone(w); /* the worker has exited */
+	}
+}
+
 void
 start_server(int accepting_sock,
 	struct sockaddr *client_addr_storage, socklen_t client_addr_size,
@@ -5887,6 +6459,11 @@ start_server(int accepting_sock,
 		fatal_errno(GFARM_MSG_1000559, "accept");
 	}
 #ifndef GFSD_DEBUG
+	if (gfarm_spool_server_worker_pool_size > 0 &&
+	    client_worker_dispatch(client, client_addr, client_name)) {
+		close(client);
+		return;
+	}
 	switch ((pid = do_fork(type_client))) {
 	case 0:
 #endif
@@ -6700,6 +7277,10 @@ back_channel_server(void)
 				e = gfs_async_server_fhremove(
 				    bc_conn, xid, size);
 				break;
+			case GFS_PROTO_FHREMOVE_MULTI:
+				e = gfs_async_server_fhremove_multi(
+				    bc_conn, xid, size);
+				break;
 			case GFS_PROTO_STATUS:
 				e = gfs_async_server_status(
 				    bc_conn, xid, size, 0);
@@ -7013,7 +7594,7 @@ main(int argc, char **argv)
 	int syslog_level = -1;
 	char *syslog_file = NULL;
 	struct in_addr *self_addresses, listen_address;
-	int table_size, self_addresses_count, ch, i, nfound, max_fd, p;
+	int table_size, self_addresses_count, ch, i, nfound, max_fd, nfds, p;
 	int save_errno;
 	struct sigaction sa;
 	fd_set requests;
@@ -7393,6 +7974,11 @@ main(int argc, char **argv)
 	 */
 	gfarm_sigpipe_ignore();
 
+#ifdef HAVE_TLS_1_3
+	/* so that the children accept the session tickets of each other */
+	gfp_xdr_tls_initialize();
+#endif
+
 	/* call before start_back_channel_server() */
 	if (gfarm_write_verify)
 		start_write_verify_controller();
@@ -7406,7 +7992,7 @@ main(int argc, char **argv)
 		    table_size);
 	file_table_init(table_size);
 
-	gfsd_setup_iostat("gfsd", gfarm_iostat_max_client);
+	gfsd_setup_iostat("gfsd", gfarm_iostat_max_client, 1);
 
 	/*
 	 * Because SA_NOCLDWAIT is not implemented on some OS,
@@ -7438,7 +8024,9 @@ main(int argc, char **argv)
 			FD_SET(accepting.local_socks[i].sock, &requests);
 		for (i = 0; i < accepting.udp_socks_count; i++)
 			FD_SET(accepting.udp_socks[i], &requests);
-		nfound = select(max_fd + 1, &requests, NULL, NULL, NULL);
+		nfds = max_fd;
+		client_workers_fd_set(&requests, &nfds);
+		nfound = select(nfds + 1, &requests, NULL, NULL, NULL);
 		if (nfound <= 0) {
 			save_errno = errno;
 			if (got_sigchld)
@@ -7449,6 +8037,8 @@ main(int argc, char **argv)
 			errno = save_errno;
 			fatal_errno(GFARM_MSG_1000600, "select");
 		}
+		/* should be before start_server() to find idle workers */
+		client_workers_check(&requests);
 
 		if (FD_ISSET(accepting.tcp_sock, &requests)) {
 			start_server(accepting.tcp_sock,
@@ -55,6 +55,7 @@ void free_gfm_server(void);
 pid_t do_fork(enum gfsd_type);
 int open_data(char *, int);
 char *gfsd_make_path(const char *, const char *);
+int gfsd_spool_root_index(const char *);
 char *gfsd_skip_spool_root(char *);
 void gfsd_local_path(gfarm_ino_t, gfarm_uint64_t, const char *, char **);
 void gfsd_local_path2(gfarm_ino_t, gfarm_uint64_t, const char *, char **,
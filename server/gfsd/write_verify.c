@@ -30,6 +30,7 @@
 #include "timer.h"
 #include "tree.h"
 #include "msgdigest.h"
+#include "msgdigest_engine.h"
 #include "proctitle.h"
 
 #include "crc32.h"
@@ -697,12 +698,15 @@ replica_lost_move_to_lost_found_by_fd(gfarm_ino_t ino, gfarm_uint64_t gen,
 
 #ifdef O_DIRECT
 #define WRITE_VERIFY_OPEN_MODE	(O_RDONLY|O_DIRECT)
-/* larger buffer size is better, because direct I/O doesn't do read-ahead */
-#define WRITE_VERIFY_BUFSIZE	(1024*1024)
+/*
+ * larger buffer size is better, because direct I/O doesn't do read-ahead.
+ * calc_digest() reads one chunk ahead by itself instead.
+ */
+#define WRITE_VERIFY_BUFSIZE	(GFARM_MSGDIGEST_ENGINE_NBUF * 1024*1024)
 #else
 #define WRITE_VERIFY_OPEN_MODE	(O_RDONLY)
 /* small size is better, because of read-ahead */
-#define WRITE_VERIFY_BUFSIZE	65536
+#define WRITE_VERIFY_BUFSIZE	(GFARM_MSGDIGEST_ENGINE_NBUF * 65536)
 #endif
 
 #define LINUX_RAWIO_ALIGNMENT	512	/* Linux O_DIRECT feature needs this */
@@ -30,7 +30,7 @@ class gfarm_iostat_head(Structure):
 		("s_rowmax",c_uint),
 		("s_item_size",c_uint),
 		("s_ncolumn",c_uint),
-		("s_dummy",c_uint),
+		("s_nhist",c_uint),
 		("s_start_sec",c_ulonglong),
 		("s_update_sec",c_ulonglong),
 		("s_item_off",c_ulonglong),
@@ -44,7 +44,7 @@ class gfarm_iostat_head(Structure):
 		s += ' rowmax=' + repr(self.s_rowmax)
 		s += ' item_size=' + repr(self.s_item_size)
 		s += ' ncolumn=' + repr(self.s_ncolumn)
-		s += ' dummy=' + repr(self.s_dummy)
+		s += ' nhist=' + repr(self.s_nhist)
 		s += ' start_sec=' + repr(self.s_start_sec)
 		s += ' update_sec=' + repr(self.s_update_sec)
 		s += ' item_off=' + repr(self.s_item_off)
@@ -35,7 +35,7 @@ class gfarm_iostat_head(Structure):
 		("s_rowmax",c_uint),
 		("s_item_size",c_uint),
 		("s_ncolumn",c_uint),
-		("s_dummy",c_uint),
+		("s_nhist",c_uint),
 		("s_start_sec",c_ulonglong),
 		("s_update_sec",c_ulonglong),
 		("s_item_off",c_ulonglong),
@@ -49,7 +49,7 @@ class gfarm_iostat_head(Structure):
 		s += ' rowmax=' + repr(self.s_rowmax)
 		s += ' item_size=' + repr(self.s_item_size)
 		s += ' ncolumn=' + repr(self.s_ncolumn)
-		s += ' dummy=' + repr(self.s_dummy)
+		s += ' nhist=' + repr(self.s_nhist)
 		s += ' start_sec=' + repr(self.s_start_sec)
 		s += ' update_sec=' + repr(self.s_update_sec)
 		s += ' item_off=' + repr(self.s_item_off)
@@ -71,6 +71,50 @@ class gfarm_iostat_items(Structure):
 	def diff(self, new):
 		return  new.s_vals - self.svals
 
+GFARM_IOSTAT_HIST_SUB_BITS = 3
+GFARM_IOSTAT_HIST_NBUCKET = 248
+
+class gfarm_iostat_hist(Structure):
+	_fields_ = [("h_name",c_char * 32),
+		("h_count",c_ulonglong),
+		("h_sum",c_ulonglong),
+		("h_max",c_ulonglong),
+		("h_reserved",c_ulonglong),
+		("h_buckets",c_ulonglong * GFARM_IOSTAT_HIST_NBUCKET)]
+	def __str__(self):
+		return self.h_name + ' count=' + repr(self.h_count) + \
+			' sum=' + repr(self.h_sum) + ' max=' + repr(self.h_max)
+
+# lower bound [usec] of the bucket, see gfarm_iostat_hist_index()
+def hist_bucket_lower(i):
+	nsub = 1 << GFARM_IOSTAT_HIST_SUB_BITS
+	if i < nsub:
+		return i
+	return (nsub + i % nsub) << (i / nsub - 1)
+
+# p-th percentile [usec] of the bucket counts, upper bound of the bucket
+def hist_percentile(buckets, p):
+	total = sum(buckets)
+	if total == 0:
+		return 0
+	acc = 0
+	for i in range(0, len(buckets)):
+		acc += buckets[i]
+		if acc >= total * p:
+			return hist_bucket_lower(i + 1)
+	return hist_bucket_lower(len(buckets))
+
+# maximum [usec] of the bucket counts, upper bound of the highest bucket.
+# h_max is the maximum since the start, thus it's only used to tighten it.
+def hist_max(buckets, h_max):
+	for i in range(len(buckets) - 1, -1, -1):
+		if buckets[i] == 0:
+			continue
+		if i == len(buckets) - 1:
+			return h_max
+		return min(hist_bucket_lower(i + 1), h_max)
+	return 0
+
 def sread(fd,cobj,size):
 	memmove(pointer(cobj),c_char_p(fd.read(size)),size)
 
@@ -93,6 +137,12 @@ class gfarm_iostat:
 			aitems = items()
 			fd.seek(head.s_item_off)
 			sread(fd, aitems, sizeof(items))
+			hists = gfarm_iostat_hist * head.s_nhist
+			ahists = hists()
+			if head.s_nhist > 0:
+				fd.seek(head.s_item_off +
+					head.s_item_size * head.s_row)
+				sread(fd, ahists, sizeof(hists))
 		except:
 			logging.execption('sread')
 			fd.close()
@@ -101,6 +151,8 @@ class gfarm_iostat:
 		self.ahead = head
 		self.aspec = aspec
 		self.aitems = aitems
+		self.ahists = ahists
+		self.time = time.time()
 		fd.close()
 	def isvalid(self):
 		if self.file == '' :
@@ -172,6 +224,38 @@ class gfarm_iostat:
 		t += map((lambda o,n: n.s_vals - o.s_vals), old, new)
 		return t
 
+	def hists(self):
+		if self.file == '' :
+			return
+		return self.ahists
+
+	# rate and latency percentiles of each histogram since `self'
+	def histdiff(self, new):
+		t = []
+		restarted = new.ahead.s_start_sec > self.ahead.s_start_sec
+		interval = new.time - self.time
+		if interval <= 0:
+			interval = 1
+		for i in range(0, new.ahead.s_nhist):
+			n = new.ahists[i]
+			if n.h_name == '':
+				continue
+			if restarted or i >= self.ahead.s_nhist:
+				count = n.h_count
+				buckets = list(n.h_buckets)
+			else:
+				o = self.ahists[i]
+				count = n.h_count - o.h_count
+				buckets = map((lambda x,y: y - x),
+					o.h_buckets, n.h_buckets)
+			buckets = list(buckets)
+			t.append((n.h_name, count / interval,
+				hist_percentile(buckets, 0.5),
+				hist_percentile(buckets, 0.99),
+				hist_percentile(buckets, 0.999),
+				hist_max(buckets, n.h_max), n.h_max))
+		return t
+
 	def diff(self, new):
 		if new.ahead.s_start_sec > self.ahead.s_start_sec:
 			return new.sumup(0)
@@ -195,10 +279,26 @@ if __name__ == '__main__':
 	parser = OptionParser()
 	parser.add_option('-i', '--infile', dest='infile', default='', help='infile to explicitly check')
 	parser.add_option('-s', '--step', dest='step', default=1, help='interval step to check')
+	parser.add_option('-l', '--latency', dest='latency', action='store_true', default=False, help='show rate, latency percentiles and maximum [usec] of each operation in the interval, and the maximum since the start')
 
 	(options, args) = parser.parse_args()
 
 	old = gfarm_iostat(options.infile)
+	if options.latency:
+		while True:
+			time.sleep(float(options.step))
+			stat = gfarm_iostat(options.infile)
+			if not stat.isvalid() :
+				continue
+			if not old.isvalid() :
+				old = stat
+				continue
+			print '%-16s %10s %10s %10s %10s %10s %10s' % \
+				('name', 'ops/s', 'p50', 'p99', 'p999', 'max',
+				'max(all)')
+			for h in old.histdiff(stat):
+				print '%-16s %10.1f %10d %10d %10d %10d %10d' % h
+			old = stat
 	for i in range(1, 100):
 		stat = gfarm_iostat(options.infile)
 		if stat.isvalid() :